@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup blkload
+ * @{
+ */
+
+/**
+ * @file
+ * @brief Block device load generator
+ *
+ * Runs a number of jobs against a block device, each with its own session
+ * and a number of fibrils issuing requests, and reports the achieved
+ * IOPS, throughput and the distribution of request latencies.
+ */
+
+#include <bd.h>
+#include <errno.h>
+#include <fibril.h>
+#include <fibril_synch.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <ipc/bd.h>
+#include <loc.h>
+#include <macros.h>
+#include <mem.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <time.h>
+
+#define NAME	"blkload"
+
+#define MAX_JOBS	16
+
+/*
+ * Latencies are recorded in a log-linear histogram: values below
+ * HIST_SUB microseconds have a bucket each, above that every power of two
+ * is split into HIST_SUB buckets, which bounds the error of the reported
+ * percentiles to 1 / HIST_SUB.
+ */
+#define HIST_SUB_BITS	4
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	(64 * HIST_SUB)
+
+typedef struct {
+	uint64_t bucket[HIST_BUCKETS];
+	uint64_t count;
+	uint64_t errors;
+	usec_t sum;
+	usec_t min;
+	usec_t max;
+} lat_hist_t;
+
+typedef struct {
+	/** Percentage of reads */
+	unsigned read_pct;
+	bool sequential;
+	/** Blocks per request */
+	size_t blocks;
+	/** Requests in flight per job */
+	size_t qd;
+	size_t jobs;
+	/** Run time in seconds, unless limited by count */
+	unsigned seconds;
+	/** Number of requests per job or zero */
+	uint64_t count;
+} load_cfg_t;
+
+struct job;
+
+typedef struct {
+	struct job *job;
+	lat_hist_t hist;
+} worker_t;
+
+typedef struct job {
+	load_cfg_t *cfg;
+	async_sess_t *sess;
+	bd_t *bd;
+	size_t bsize;
+	aoff64_t nblocks;
+
+	fibril_mutex_t lock;
+	fibril_condvar_t done_cv;
+	/** Next block for sequential access */
+	aoff64_t next_ba;
+	/** Requests yet to be issued if limited by count */
+	uint64_t left;
+	/** Number of workers still running */
+	size_t running;
+
+	worker_t *workers;
+} job_t;
+
+static struct timespec deadline;
+
+static void syntax_print(void)
+{
+	printf("Usage: %s [options] <device>\n", NAME);
+	printf("-r, --read            Read only (default)\n");
+	printf("-w, --write           Write only (destroys data on the device)\n");
+	printf("-m, --mix PCT         Mix reads and writes, PCT %% of reads\n");
+	printf("-s, --sequential      Sequential instead of random access\n");
+	printf("-b, --blocks N        Blocks per request (default 1)\n");
+	printf("-q, --depth N         Requests in flight per job (default 1)\n");
+	printf("-j, --jobs N          Number of jobs, each with its own "
+	    "session (default 1)\n");
+	printf("-t, --time SECONDS    Run time (default 10)\n");
+	printf("-n, --count N         Number of requests per job instead "
+	    "of run time\n");
+}
+
+static void hist_init(lat_hist_t *hist)
+{
+	memset(hist, 0, sizeof(lat_hist_t));
+	hist->min = INT64_MAX;
+}
+
+static size_t hist_index(usec_t lat)
+{
+	uint64_t v = lat < 0 ? 0 : (uint64_t) lat;
+	unsigned msb;
+
+	if (v < HIST_SUB)
+		return v;
+
+	msb = 63 - __builtin_clzll(v);
+	return (msb - HIST_SUB_BITS + 1) * HIST_SUB +
+	    ((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/** Get the middle of the range of latencies recorded in a bucket. */
+static usec_t hist_value(size_t idx)
+{
+	unsigned shift;
+
+	if (idx < HIST_SUB)
+		return idx;
+
+	shift = idx / HIST_SUB - 1;
+	return (((usec_t) HIST_SUB + idx % HIST_SUB) << shift) +
+	    ((1ll << shift) - 1) / 2;
+}
+
+static void hist_add(lat_hist_t *hist, usec_t lat)
+{
+	hist->bucket[hist_index(lat)]++;
+	hist->count++;
+	hist->sum += lat;
+	if (lat < hist->min)
+		hist->min = lat;
+	if (lat > hist->max)
+		hist->max = lat;
+}
+
+static void hist_merge(lat_hist_t *dst, lat_hist_t *src)
+{
+	for (size_t i = 0; i < HIST_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+
+	dst->count += src->count;
+	dst->errors += src->errors;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/** Get latency below which @a permille per mille of requests completed. */
+static usec_t hist_percentile(lat_hist_t *hist, unsigned permille)
+{
+	uint64_t target = (hist->count * permille + 999) / 1000;
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < HIST_BUCKETS; i++) {
+		seen += hist->bucket[i];
+		if (seen >= target && seen > 0)
+			return min(hist_value(i), hist->max);
+	}
+
+	return hist->max;
+}
+
+/** Pick the block and direction of the next request.
+ *
+ * @return @c false if the job has issued all its requests
+ */
+static bool job_next(job_t *job, aoff64_t *ba, bool *read)
+{
+	load_cfg_t *cfg = job->cfg;
+	aoff64_t span = job->nblocks - cfg->blocks + 1;
+	bool more = true;
+
+	fibril_mutex_lock(&job->lock);
+
+	if (cfg->count != 0) {
+		if (job->left == 0)
+			more = false;
+		else
+			job->left--;
+	} else {
+		struct timespec now;
+
+		getuptime(&now);
+		if (ts_gteq(&now, &deadline))
+			more = false;
+	}
+
+	if (cfg->sequential) {
+		if (job->next_ba >= span)
+			job->next_ba = 0;
+		*ba = job->next_ba;
+		job->next_ba += cfg->blocks;
+	} else {
+		*ba = ((((aoff64_t) rand()) << 32) ^
+		    (((aoff64_t) rand()) << 16) ^ rand()) % span;
+	}
+
+	*read = (unsigned) (rand() % 100) < cfg->read_pct;
+
+	fibril_mutex_unlock(&job->lock);
+	return more;
+}
+
+static errno_t worker_fibril(void *arg)
+{
+	worker_t *worker = (worker_t *) arg;
+	job_t *job = worker->job;
+	size_t size = job->cfg->blocks * job->bsize;
+	struct timespec start;
+	struct timespec end;
+	aoff64_t ba;
+	bool read;
+	void *buf;
+	errno_t rc;
+
+	buf = malloc(size);
+	if (buf != NULL) {
+		memset(buf, 0xa5, size);
+
+		while (job_next(job, &ba, &read)) {
+			getuptime(&start);
+			if (read) {
+				rc = bd_read_blocks(job->bd, ba,
+				    job->cfg->blocks, buf, size);
+			} else {
+				rc = bd_write_blocks(job->bd, ba,
+				    job->cfg->blocks, buf, size);
+			}
+			getuptime(&end);
+
+			if (rc != EOK) {
+				worker->hist.errors++;
+				continue;
+			}
+
+			hist_add(&worker->hist,
+			    NSEC2USEC(ts_sub_diff(&end, &start)));
+		}
+
+		free(buf);
+	} else {
+		worker->hist.errors++;
+	}
+
+	fibril_mutex_lock(&job->lock);
+	job->running--;
+	fibril_condvar_broadcast(&job->done_cv);
+	fibril_mutex_unlock(&job->lock);
+
+	return EOK;
+}
+
+static errno_t job_open(job_t *job, load_cfg_t *cfg, service_id_t sid)
+{
+	size_t qdepth;
+	errno_t rc;
+
+	job->cfg = cfg;
+	fibril_mutex_initialize(&job->lock);
+	fibril_condvar_initialize(&job->done_cv);
+	job->left = cfg->count;
+
+	job->workers = calloc(cfg->qd, sizeof(worker_t));
+	if (job->workers == NULL)
+		return ENOMEM;
+
+	for (size_t i = 0; i < cfg->qd; i++) {
+		job->workers[i].job = job;
+		hist_init(&job->workers[i].hist);
+	}
+
+	job->sess = loc_service_connect(sid, INTERFACE_BLOCK, 0);
+	if (job->sess == NULL)
+		return EIO;
+
+	rc = bd_open(job->sess, &job->bd);
+	if (rc != EOK)
+		return rc;
+
+	rc = bd_get_block_size(job->bd, &job->bsize);
+	if (rc != EOK)
+		return rc;
+
+	rc = bd_get_num_blocks(job->bd, &job->nblocks);
+	if (rc != EOK)
+		return rc;
+
+	if (job->nblocks < cfg->blocks)
+		return EINVAL;
+
+	/* Let the server process up to qd requests of this session at once */
+	if (bd_get_queue_depth(job->bd, cfg->qd, &qdepth) == EOK &&
+	    qdepth < cfg->qd) {
+		printf(NAME ": Warning, device processes only %zu requests "
+		    "at once.\n", qdepth);
+	}
+
+	return EOK;
+}
+
+static void job_close(job_t *job)
+{
+	if (job->bd != NULL)
+		bd_close(job->bd);
+	if (job->sess != NULL)
+		async_hangup(job->sess);
+	free(job->workers);
+}
+
+static void report(load_cfg_t *cfg, lat_hist_t *hist, size_t bsize,
+    nsec_t elapsed)
+{
+	usec_t us = NSEC2USEC(elapsed);
+	uint64_t iops;
+	uint64_t kibps;
+
+	if (us <= 0)
+		us = 1;
+
+	iops = hist->count * 1000000 / us;
+	kibps = hist->count * cfg->blocks * bsize / 1024 * 1000000 / us;
+
+	printf("requests: %" PRIu64 ", errors: %" PRIu64 ", time: %lld.%03lld s\n",
+	    hist->count, hist->errors, us / 1000000, (us / 1000) % 1000);
+	printf("IOPS: %" PRIu64 ", throughput: %" PRIu64 " KiB/s\n",
+	    iops, kibps);
+
+	if (hist->count == 0)
+		return;
+
+	printf("latency (us): min %lld, avg %lld, max %lld\n",
+	    hist->min, hist->sum / (usec_t) hist->count, hist->max);
+	printf("percentiles (us): 50%%: %lld, 90%%: %lld, 99%%: %lld, "
+	    "99.9%%: %lld\n", hist_percentile(hist, 500),
+	    hist_percentile(hist, 900), hist_percentile(hist, 990),
+	    hist_percentile(hist, 999));
+}
+
+static int parse_size(const char *arg, size_t lo, size_t hi, size_t *val)
+{
+	uint64_t v;
+
+	if (str_uint64_t(arg, NULL, 10, true, &v) != EOK || v < lo || v > hi)
+		return EINVAL;
+
+	*val = v;
+	return EOK;
+}
+
+int main(int argc, char **argv)
+{
+	load_cfg_t cfg = {
+		.read_pct = 100,
+		.sequential = false,
+		.blocks = 1,
+		.qd = 1,
+		.jobs = 1,
+		.seconds = 10,
+		.count = 0
+	};
+	job_t jobs[MAX_JOBS];
+	lat_hist_t *total;
+	service_id_t sid;
+	struct timespec start;
+	struct timespec end;
+	size_t val;
+	errno_t rc;
+	int opt;
+
+	const char *short_options = "rwm:sb:q:j:t:n:h";
+	struct option long_options[] = {
+		{ "read", no_argument, NULL, 'r' },
+		{ "write", no_argument, NULL, 'w' },
+		{ "mix", required_argument, NULL, 'm' },
+		{ "sequential", no_argument, NULL, 's' },
+		{ "blocks", required_argument, NULL, 'b' },
+		{ "depth", required_argument, NULL, 'q' },
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "time", required_argument, NULL, 't' },
+		{ "count", required_argument, NULL, 'n' },
+		{ "help", no_argument, NULL, 'h' },
+		{ 0, 0, NULL, 0 }
+	};
+
+	while ((opt = getopt_long(argc, argv, short_options, long_options,
+	    NULL)) > 0) {
+		switch (opt) {
+		case 'r':
+			cfg.read_pct = 100;
+			break;
+		case 'w':
+			cfg.read_pct = 0;
+			break;
+		case 'm':
+			if (parse_size(optarg, 0, 100, &val) != EOK) {
+				printf(NAME ": Error, invalid mix.\n");
+				return 1;
+			}
+			cfg.read_pct = val;
+			break;
+		case 's':
+			cfg.sequential = true;
+			break;
+		case 'b':
+			if (parse_size(optarg, 1, 1024, &cfg.blocks) != EOK) {
+				printf(NAME ": Error, invalid block count.\n");
+				return 1;
+			}
+			break;
+		case 'q':
+			if (parse_size(optarg, 1, BD_QUEUE_DEPTH_MAX,
+			    &cfg.qd) != EOK) {
+				printf(NAME ": Error, invalid queue depth.\n");
+				return 1;
+			}
+			break;
+		case 'j':
+			if (parse_size(optarg, 1, MAX_JOBS, &cfg.jobs) != EOK) {
+				printf(NAME ": Error, invalid number of jobs.\n");
+				return 1;
+			}
+			break;
+		case 't':
+			if (parse_size(optarg, 1, 86400, &val) != EOK) {
+				printf(NAME ": Error, invalid time.\n");
+				return 1;
+			}
+			cfg.seconds = val;
+			break;
+		case 'n':
+			if (str_uint64_t(optarg, NULL, 10, true,
+			    &cfg.count) != EOK || cfg.count == 0) {
+				printf(NAME ": Error, invalid count.\n");
+				return 1;
+			}
+			break;
+		case 'h':
+			syntax_print();
+			return 0;
+		default:
+			syntax_print();
+			return 1;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		printf(NAME ": Error, specify one device.\n");
+		syntax_print();
+		return 1;
+	}
+
+	rc = loc_service_get_id(argv[optind], &sid, 0);
+	if (rc != EOK) {
+		printf(NAME ": Error resolving device '%s': %s.\n",
+		    argv[optind], str_error(rc));
+		return 2;
+	}
+
+	total = malloc(sizeof(lat_hist_t));
+	if (total == NULL) {
+		printf(NAME ": Out of memory.\n");
+		return 2;
+	}
+
+	hist_init(total);
+	memset(jobs, 0, sizeof(jobs));
+
+	for (size_t i = 0; i < cfg.jobs; i++) {
+		rc = job_open(&jobs[i], &cfg, sid);
+		if (rc != EOK) {
+			printf(NAME ": Error opening '%s': %s.\n",
+			    argv[optind], str_error(rc));
+			goto out;
+		}
+
+		/* Spread sequential jobs over the device */
+		if (cfg.sequential) {
+			jobs[i].next_ba = jobs[i].nblocks / cfg.jobs * i;
+			jobs[i].next_ba -= jobs[i].next_ba % cfg.blocks;
+		}
+	}
+
+	printf(NAME ": %s, %u%% reads, %s, %zu x %zu bytes per request, "
+	    "%zu job(s) x depth %zu\n", argv[optind], cfg.read_pct,
+	    cfg.sequential ? "sequential" : "random", cfg.blocks,
+	    jobs[0].bsize, cfg.jobs, cfg.qd);
+
+	getuptime(&start);
+	deadline = start;
+	ts_add_diff(&deadline, SEC2NSEC(cfg.seconds));
+
+	for (size_t i = 0; i < cfg.jobs; i++) {
+		for (size_t w = 0; w < cfg.qd; w++) {
+			fid_t fid;
+
+			fid = fibril_create(worker_fibril, &jobs[i].workers[w]);
+			if (fid == 0) {
+				printf(NAME ": Out of memory.\n");
+				break;
+			}
+
+			jobs[i].running++;
+			fibril_add_ready(fid);
+		}
+	}
+
+	for (size_t i = 0; i < cfg.jobs; i++) {
+		fibril_mutex_lock(&jobs[i].lock);
+		while (jobs[i].running > 0)
+			fibril_condvar_wait(&jobs[i].done_cv, &jobs[i].lock);
+		fibril_mutex_unlock(&jobs[i].lock);
+
+		for (size_t w = 0; w < cfg.qd; w++)
+			hist_merge(total, &jobs[i].workers[w].hist);
+	}
+
+	getuptime(&end);
+	report(&cfg, total, jobs[0].bsize, ts_sub_diff(&end, &start));
+
+out:
+	for (size_t i = 0; i < cfg.jobs; i++)
+		job_close(&jobs[i]);
+
+	free(total);
+	return rc == EOK ? 0 : 2;
+}
+
+/** @}
+ */
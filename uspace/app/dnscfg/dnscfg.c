@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <inttypes.h>
 #include <inet/addr.h>
 #include <inet/dnsr.h>
 #include <ipc/services.h>
@@ -53,6 +54,7 @@ static void print_syntax(void)
 	printf("\t%s get-ns\n", NAME);
 	printf("\t%s set-ns <server-addr>\n", NAME);
 	printf("\t%s unset-ns\n", NAME);
+	printf("\t%s stats\n", NAME);
 }
 
 static errno_t dnscfg_set_ns(int argc, char *argv[])
@@ -125,6 +127,50 @@ static errno_t dnscfg_print(void)
 	return EOK;
 }
 
+static errno_t dnscfg_stats(void)
+{
+	dnsr_stats_t stats;
+	uint64_t cached;
+	uint64_t other;
+
+	errno_t rc = dnsr_get_stats(&stats);
+	if (rc != EOK) {
+		printf("%s: Failed getting resolver statistics (%s).\n", NAME,
+		    str_error(rc));
+		return rc;
+	}
+
+	cached = stats.hits + stats.neg_hits;
+	other = stats.queries - cached;
+
+	printf("Cache entries: %" PRIu64 "/%" PRIu64 "\n", stats.entries,
+	    stats.max_entries);
+	printf("Queries: %" PRIu64 "\n", stats.queries);
+	printf("  Cache hits: %" PRIu64 " (negative: %" PRIu64 ")\n",
+	    cached, stats.neg_hits);
+	printf("  Cache misses: %" PRIu64 "\n", stats.misses);
+	printf("  Coalesced: %" PRIu64 "\n", stats.coalesced);
+	printf("  Stale answers: %" PRIu64 "\n", stats.stale);
+
+	if (stats.queries > 0) {
+		printf("Hit ratio: %" PRIu64 ".%" PRIu64 " %%\n",
+		    cached * 100 / stats.queries,
+		    cached * 1000 / stats.queries % 10);
+	}
+
+	if (cached > 0) {
+		printf("Average hit latency: %" PRIu64 " us\n",
+		    stats.hit_usec / cached);
+	}
+
+	if (other > 0) {
+		printf("Average miss latency: %" PRIu64 " us\n",
+		    stats.miss_usec / other);
+	}
+
+	return EOK;
+}
+
 int main(int argc, char *argv[])
 {
 	if ((argc < 2) || (str_cmp(argv[1], "get-ns") == 0))
@@ -133,6 +179,8 @@ int main(int argc, char *argv[])
 		return dnscfg_set_ns(argc - 2, argv + 2);
 	else if (str_cmp(argv[1], "unset-ns") == 0)
 		return dnscfg_unset_ns();
+	else if (str_cmp(argv[1], "stats") == 0)
+		return dnscfg_stats();
 	else {
 		printf("%s: Unknown command '%s'.\n", NAME, argv[1]);
 		print_syntax();
@@ -68,9 +68,9 @@ int main(int argc, char *argv[])
 	int i;
 	char *ofname = NULL;
 	FILE *ofile = NULL;
-	size_t buf_size = 4096;
-	void *buf = NULL;
 	uri_t *uri = NULL;
+	http_pool_t *pool = NULL;
+	http_request_t *req = NULL;
 	http_t *http = NULL;
 	errno_t rc;
 	int ret;
@@ -163,7 +163,7 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	http_request_t *req = http_request_create("GET", server_path);
+	req = http_request_create("GET", server_path);
 	free(server_path);
 	if (req == NULL) {
 		fprintf(stderr, "Failed creating request\n");
@@ -183,50 +183,31 @@ int main(int argc, char *argv[])
 		goto error;
 	}
 
-	http = http_create(uri->host, port);
-	if (http == NULL) {
-		fprintf(stderr, "Failed creating HTTP object\n");
-		rc = ENOMEM;
-		goto error;
-	}
-
-	rc = http_connect(http);
-	if (rc != EOK) {
-		fprintf(stderr, "Failed connecting: %s\n", str_error(rc));
-		rc = EIO;
-		goto error;
-	}
-
-	rc = http_send_request(http, req);
+	rc = http_pool_create(&pool);
 	if (rc != EOK) {
-		fprintf(stderr, "Failed sending request: %s\n", str_error(rc));
-		rc = EIO;
+		fprintf(stderr, "Failed creating connection pool\n");
 		goto error;
 	}
 
-	http_response_t *response = NULL;
-	rc = http_receive_response(&http->recv_buffer, &response, 16 * 1024,
-	    100);
+	rc = http_pool_request(pool, uri->host, port, req, &http);
+	http_request_destroy(req);
+	req = NULL;
 	if (rc != EOK) {
 		fprintf(stderr, "Failed receiving response: %s\n", str_error(rc));
 		rc = EIO;
 		goto error;
 	}
 
-	if (response->status != 200) {
-		fprintf(stderr, "Server returned status %d %s\n", response->status,
-		    response->message);
+	if (http->head.status != 200) {
+		fprintf(stderr, "Server returned status %d %.*s\n",
+		    http->head.status, (int) http->head.message.len,
+		    http->head.message.str);
 	} else {
-		buf = malloc(buf_size);
-		if (buf == NULL) {
-			fprintf(stderr, "Failed allocating buffer\n)");
-			rc = ENOMEM;
-			goto error;
-		}
-
+		const void *body;
 		size_t body_size;
-		while ((rc = recv_buffer(&http->recv_buffer, buf, buf_size, &body_size)) == EOK && body_size > 0) {
-			fwrite(buf, 1, body_size, ofile != NULL ? ofile : stdout);
+		while ((rc = http_receive_body(http, &body, &body_size)) == EOK &&
+		    body_size > 0) {
+			fwrite(body, 1, body_size, ofile != NULL ? ofile : stdout);
 		}
 
 		if (rc != EOK) {
@@ -234,8 +215,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	free(buf);
-	http_destroy(http);
+	http_pool_put(pool, http);
+	http_pool_destroy(pool);
 	uri_destroy(uri);
 	if (ofile != NULL && fclose(ofile) != 0) {
 		printf("Error writing '%s'.\n", ofname);
@@ -244,9 +225,11 @@ int main(int argc, char *argv[])
 
 	return EOK;
 error:
-	free(buf);
+	if (req != NULL)
+		http_request_destroy(req);
 	if (http != NULL)
 		http_destroy(http);
+	http_pool_destroy(pool);
 	if (uri != NULL)
 		uri_destroy(uri);
 	if (ofile != NULL)
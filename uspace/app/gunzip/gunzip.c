@@ -37,13 +37,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/** Size of the decompression output buffer */
+#define BUFFER_SIZE  65536
+
+/** Input callback reading compressed data from a file */
+static errno_t gunzip_read(void *arg, void *buf, size_t size, size_t *nread)
+{
+	FILE *f = (FILE *) arg;
+
+	*nread = fread(buf, 1, size, f);
+	if ((*nread < size) && (ferror(f)))
+		return EIO;
+
+	return EOK;
+}
+
 int main(int argc, char *argv[])
 {
 	errno_t rc;
-	void *data, *ddata;
-	size_t size, dsize;
+	gzip_reader_t *reader;
+	void *buffer;
 	size_t nread, nwr;
-	long len;
 	FILE *f, *wf;
 
 	if (argc != 3) {
@@ -57,68 +71,59 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (fseek(f, 0, SEEK_END) < 0) {
-		printf("Error determining size of '%s'\n", argv[1]);
-		fclose(f);
-		return 1;
-	}
-
-	len = ftell(f);
-	if (len < 0) {
-		printf("Error determining size of '%s'\n", argv[1]);
-		fclose(f);
-		return 1;
-	}
-
-	if (fseek(f, 0, SEEK_SET) < 0) {
-		printf ("Error rewinding '%s'\n", argv[1]);
+	buffer = malloc(BUFFER_SIZE);
+	if (buffer == NULL) {
+		printf("Error allocating %d bytes.\n", BUFFER_SIZE);
 		fclose(f);
 		return 1;
 	}
 
-	data = malloc(len);
-	if (data == NULL) {
-		printf("Error allocating %ld bytes.\n", len);
-		fclose(f);
-		return 1;
-	}
-
-	nread = fread(data, 1, len, f);
-	if (nread != (size_t)len) {
-		printf("Error reading '%s'\n", argv[1]);
-		fclose(f);
-		return 1;
-	}
-
-	fclose(f);
-
-	size = (size_t) len;
-
-	rc = gzip_expand(data, size, &ddata, &dsize);
+	rc = gzip_reader_create(gunzip_read, f, &reader);
 	if (rc != EOK) {
 		printf("Error decompressing data.\n");
+		free(buffer);
+		fclose(f);
 		return 1;
 	}
 
 	wf = fopen(argv[2], "wb");
 	if (wf == NULL) {
 		printf("Error creating file '%s'\n", argv[2]);
+		gzip_reader_destroy(reader);
+		free(buffer);
+		fclose(f);
 		return 1;
 	}
 
-	nwr = fwrite(ddata, 1, dsize, wf);
-	if (nwr != dsize) {
-		printf("Error writing '%s'\n", argv[2]);
-		fclose(wf);
-		return 1;
-	}
+	/*
+	 * Decompress the data in constant memory, writing out each chunk
+	 * as soon as it has been produced.
+	 */
+	do {
+		rc = gzip_reader_read(reader, buffer, BUFFER_SIZE, &nread);
+		if (rc != EOK) {
+			printf("Error decompressing data.\n");
+			break;
+		}
+
+		nwr = fwrite(buffer, 1, nread, wf);
+		if (nwr != nread) {
+			printf("Error writing '%s'\n", argv[2]);
+			rc = EIO;
+			break;
+		}
+	} while (nread > 0);
+
+	gzip_reader_destroy(reader);
+	free(buffer);
+	fclose(f);
 
 	if (fclose(wf) != 0) {
 		printf("Error writing '%s'\n", argv[2]);
 		return 1;
 	}
 
-	return 0;
+	return (rc == EOK) ? 0 : 1;
 }
 
 /** @}
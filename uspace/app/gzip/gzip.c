@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup gzip
+ * @{
+ */
+/** @file
+ */
+
+#include <deflate.h>
+#include <errno.h>
+#include <gzip.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+
+/** Size of the input buffer */
+#define BUFFER_SIZE  65536
+
+/** Output callback writing compressed data to a file */
+static errno_t gzip_write(void *arg, const void *buf, size_t size)
+{
+	FILE *f = (FILE *) arg;
+
+	if (fwrite(buf, 1, size, f) != size)
+		return EIO;
+
+	return EOK;
+}
+
+static void print_syntax(void)
+{
+	printf("syntax: gzip [-1 .. -9] <src> <dest.gz>\n");
+}
+
+int main(int argc, char *argv[])
+{
+	errno_t rc;
+	gzip_writer_t *writer;
+	void *buffer;
+	size_t nread;
+	int level = DEFLATE_LEVEL_DEFAULT;
+	int i = 1;
+	FILE *f, *wf;
+
+	if ((argc > 1) && (argv[1][0] == '-')) {
+		if ((str_length(argv[1]) != 2) || (argv[1][1] < '1') ||
+		    (argv[1][1] > '9')) {
+			print_syntax();
+			return 1;
+		}
+
+		level = argv[1][1] - '0';
+		i++;
+	}
+
+	if (argc - i != 2) {
+		print_syntax();
+		return 1;
+	}
+
+	f = fopen(argv[i], "rb");
+	if (f == NULL) {
+		printf("Error opening '%s'\n", argv[i]);
+		return 1;
+	}
+
+	buffer = malloc(BUFFER_SIZE);
+	if (buffer == NULL) {
+		printf("Error allocating %d bytes.\n", BUFFER_SIZE);
+		fclose(f);
+		return 1;
+	}
+
+	wf = fopen(argv[i + 1], "wb");
+	if (wf == NULL) {
+		printf("Error creating file '%s'\n", argv[i + 1]);
+		free(buffer);
+		fclose(f);
+		return 1;
+	}
+
+	rc = gzip_writer_create(gzip_write, wf, level, &writer);
+	if (rc != EOK) {
+		printf("Error compressing data.\n");
+		fclose(wf);
+		free(buffer);
+		fclose(f);
+		return 1;
+	}
+
+	while (true) {
+		nread = fread(buffer, 1, BUFFER_SIZE, f);
+		if (ferror(f)) {
+			printf("Error reading '%s'\n", argv[i]);
+			rc = EIO;
+			break;
+		}
+
+		if (nread == 0)
+			rc = gzip_writer_finish(writer);
+		else
+			rc = gzip_writer_write(writer, buffer, nread);
+
+		if (rc != EOK) {
+			printf("Error writing '%s'\n", argv[i + 1]);
+			break;
+		}
+
+		if (nread == 0)
+			break;
+	}
+
+	gzip_writer_destroy(writer);
+	free(buffer);
+	fclose(f);
+
+	if (fclose(wf) != 0) {
+		printf("Error writing '%s'\n", argv[i + 1]);
+		return 1;
+	}
+
+	return (rc == EOK) ? 0 : 1;
+}
+
+/** @}
+ */
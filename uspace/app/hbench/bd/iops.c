@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <bd.h>
+#include <errno.h>
+#include <ipc/bd.h>
+#include <loc.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include "../hbench.h"
+
+/*
+ * Random read IOPS benchmark. Keeps 'qd' single-block reads in flight
+ * against a block device using the asynchronous bd interface, so running
+ * it with qd=1, 2, ..., 32 shows how well the device and its driver make
+ * use of queued requests. The size of the workload is the number of reads.
+ */
+
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	const char *device = bench_env_param_get(env, "device", NULL);
+	const char *qd_str = bench_env_param_get(env, "qd", "1");
+	bd_aio_t aio[BD_QUEUE_DEPTH_MAX];
+	service_id_t sid;
+	async_sess_t *sess = NULL;
+	bd_t *bd = NULL;
+	uint8_t *buf = NULL;
+	size_t bsize;
+	aoff64_t nblocks;
+	size_t qdepth;
+	uint64_t qd;
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	bool ok = false;
+	errno_t rc;
+
+	if (device == NULL) {
+		return bench_run_fail(run,
+		    "no block device given (use 'device' param)");
+	}
+
+	rc = str_uint64_t(qd_str, NULL, 10, true, &qd);
+	if ((rc != EOK) || (qd == 0) || (qd > BD_QUEUE_DEPTH_MAX)) {
+		return bench_run_fail(run, "invalid queue depth '%s'",
+		    qd_str);
+	}
+
+	rc = loc_service_get_id(device, &sid, 0);
+	if (rc != EOK) {
+		return bench_run_fail(run, "failed to resolve %s: %s",
+		    device, str_error(rc));
+	}
+
+	sess = loc_service_connect(sid, INTERFACE_BLOCK, 0);
+	if (sess == NULL)
+		return bench_run_fail(run, "failed to connect to %s", device);
+
+	rc = bd_open(sess, &bd);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to open %s: %s", device,
+		    str_error(rc));
+		goto out;
+	}
+
+	rc = bd_get_block_size(bd, &bsize);
+	if (rc == EOK)
+		rc = bd_get_num_blocks(bd, &nblocks);
+	if (rc != EOK || nblocks == 0) {
+		bench_run_fail(run, "failed to get geometry of %s: %s", device,
+		    str_error(rc));
+		goto out;
+	}
+
+	/* Let the server execute up to qd requests at once. */
+	if (bd_get_queue_depth(bd, qd, &qdepth) != EOK)
+		qdepth = 1;
+
+	buf = malloc(qd * bsize);
+	if (buf == NULL) {
+		bench_run_fail(run, "failed to allocate buffers");
+		goto out;
+	}
+
+	bench_run_start(run);
+
+	while (completed < size) {
+		if (submitted < size && submitted - completed < qd) {
+			size_t slot = submitted % qd;
+			aoff64_t ba = (((aoff64_t) rand() << 16) ^ rand()) %
+			    nblocks;
+
+			rc = bd_read_blocks_submit(bd, ba, 1, buf + slot * bsize,
+			    bsize, &aio[slot]);
+			if (rc != EOK)
+				break;
+
+			submitted++;
+			continue;
+		}
+
+		rc = bd_aio_wait(&aio[completed % qd]);
+		completed++;
+		if (rc != EOK)
+			break;
+	}
+
+	/* Reap reads still in flight after an error. */
+	while (completed < submitted) {
+		(void) bd_aio_wait(&aio[completed % qd]);
+		completed++;
+	}
+
+	bench_run_stop(run);
+
+	if (rc != EOK) {
+		bench_run_fail(run, "reading from %s failed: %s", device,
+		    str_error(rc));
+		goto out;
+	}
+
+	ok = true;
+out:
+	free(buf);
+	if (bd != NULL)
+		bd_close(bd);
+	async_hangup(sess);
+	return ok;
+}
+
+benchmark_t benchmark_bd_iops = {
+	.name = "bd_iops",
+	.desc = "Random single-block reads from a block device with 'qd' reads in flight (use 'device' and 'qd' params).",
+	.entry = &runner,
+	.setup = NULL,
+	.teardown = NULL
+};
+
+/**
+ * @}
+ */
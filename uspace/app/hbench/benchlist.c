@@ -38,13 +38,22 @@
 #include "hbench.h"
 
 benchmark_t *benchmarks[] = {
+	&benchmark_bd_iops,
+	&benchmark_deflate,
 	&benchmark_dir_read,
 	&benchmark_fibril_mutex,
 	&benchmark_file_read,
+	&benchmark_file_read_parallel,
+	&benchmark_file_write,
+	&benchmark_hash,
+	&benchmark_http_parse,
+	&benchmark_inflate,
 	&benchmark_malloc1,
 	&benchmark_malloc2,
 	&benchmark_ns_ping,
-	&benchmark_ping_pong
+	&benchmark_ping_pong,
+	&benchmark_tcp_xfer,
+	&benchmark_udp_pps
 };
 
 size_t benchmark_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+/**
+ * @file
+ */
+
+#include <deflate.h>
+#include <stdlib.h>
+#include "../hbench.h"
+#include "data.h"
+
+static const char *words[] = {
+	"the ", "kernel ", "task ", "thread ", "fibril ", "IPC ", "call ",
+	"answer ", "phone ", "memory ", "area ", "page ", "frame ", "device ",
+	"driver ", "server ", "client ", "file ", "system ", "block ",
+	"cache ", "of ", "and ", "to ", "is ", "a ", "in ", "with ", "\n"
+};
+
+/** Generate deterministic text-like test data.
+ *
+ * @param data Buffer to fill.
+ * @param size Size of the buffer.
+ */
+void compress_data_fill(uint8_t *data, size_t size)
+{
+	uint32_t seed = 1;
+	size_t pos = 0;
+
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		const char *word = words[(seed >> 16) %
+		    (sizeof(words) / sizeof(words[0]))];
+
+		while ((*word != 0) && (pos < size))
+			data[pos++] = *word++;
+	}
+}
+
+/** Get compression level from the 'level' parameter.
+ *
+ * @param env Benchmark environment.
+ * @param run Run to report the error to.
+ * @param level Where to store the compression level.
+ * @return EOK on success, EINVAL on invalid level.
+ */
+errno_t compress_data_level(bench_env_t *env, bench_run_t *run, int *level)
+{
+	const char *str = bench_env_param_get(env, "level", "6");
+	char *end;
+
+	long val = strtol(str, &end, 10);
+	if ((*end != 0) || (val < DEFLATE_LEVEL_MIN) ||
+	    (val > DEFLATE_LEVEL_MAX)) {
+		bench_run_fail(run, "invalid compression level '%s'", str);
+		return EINVAL;
+	}
+
+	*level = val;
+	return EOK;
+}
+
+/**
+ * @}
+ */
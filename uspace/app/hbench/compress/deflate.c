@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <deflate.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str_error.h>
+#include "../hbench.h"
+#include "data.h"
+
+/** Size of the buffer the test data is compressed into */
+#define BUFFER_SIZE  65536
+
+static uint8_t *data;
+static uint8_t *buffer;
+static int level;
+
+/** Compress the test data once
+ *
+ * @param deflated_size Where to store the size of compressed data.
+ *
+ * @return EOK on success, error code otherwise.
+ *
+ */
+static errno_t deflate_data(uint64_t *deflated_size)
+{
+	deflate_stream_t stream;
+	errno_t rc = deflate_init(&stream, level);
+	if (rc != EOK)
+		return rc;
+
+	stream.next_in = data;
+	stream.avail_in = COMPRESS_DATA_SIZE;
+
+	while (!stream.done) {
+		stream.next_out = buffer;
+		stream.avail_out = BUFFER_SIZE;
+
+		rc = deflate_step(&stream, true);
+		if (rc != EOK)
+			break;
+	}
+
+	*deflated_size = stream.total_out;
+
+	deflate_end(&stream);
+	return rc;
+}
+
+static bool setup(bench_env_t *env, bench_run_t *run)
+{
+	errno_t rc = compress_data_level(env, run, &level);
+	if (rc != EOK)
+		return false;
+
+	data = malloc(COMPRESS_DATA_SIZE);
+	buffer = malloc(BUFFER_SIZE);
+
+	if ((data == NULL) || (buffer == NULL))
+		return bench_run_fail(run, "failed to allocate buffers");
+
+	compress_data_fill(data, COMPRESS_DATA_SIZE);
+
+	uint64_t deflated_size;
+	rc = deflate_data(&deflated_size);
+	if (rc != EOK) {
+		return bench_run_fail(run, "failed to compress data: %s",
+		    str_error(rc));
+	}
+
+	printf("Level %d compresses %d bytes to %" PRIu64 " bytes (%" PRIu64
+	    "%%).\n", level, COMPRESS_DATA_SIZE, deflated_size,
+	    deflated_size * 100 / COMPRESS_DATA_SIZE);
+
+	return true;
+}
+
+static bool teardown(bench_env_t *env, bench_run_t *run)
+{
+	free(data);
+	free(buffer);
+
+	data = NULL;
+	buffer = NULL;
+
+	return true;
+}
+
+/** Execute streaming compression benchmark.
+ *
+ * Each iteration compresses 1 MiB of text-like data through a
+ * 64 KiB output buffer.
+ */
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	uint64_t deflated_size;
+
+	bench_run_start(run);
+	for (uint64_t i = 0; i < size; i++) {
+		errno_t rc = deflate_data(&deflated_size);
+		if (rc != EOK) {
+			return bench_run_fail(run, "failed to compress data: %s",
+			    str_error(rc));
+		}
+	}
+	bench_run_stop(run);
+
+	return true;
+}
+
+benchmark_t benchmark_deflate = {
+	.name = "deflate",
+	.desc = "Compress 1 MiB of text through a 64 KiB buffer (use 'level' param to alter the compression level).",
+	.entry = &runner,
+	.setup = &setup,
+	.teardown = &teardown
+};
+
+/**
+ * @}
+ */
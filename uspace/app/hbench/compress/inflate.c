@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <deflate.h>
+#include <inflate.h>
+#include <mem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str_error.h>
+#include "../hbench.h"
+#include "data.h"
+
+/** Size of the buffer the test data is decompressed into */
+#define BUFFER_SIZE  65536
+
+static uint8_t *data;
+static uint8_t *deflated;
+static size_t deflated_size;
+static uint8_t *buffer;
+
+/** Decompress the test data once
+ *
+ * @param verify Compare the output against the original data.
+ *
+ * @return EOK on success, error code otherwise.
+ *
+ */
+static errno_t inflate_data(bool verify)
+{
+	inflate_stream_t stream;
+	errno_t rc = inflate_init(&stream);
+	if (rc != EOK)
+		return rc;
+
+	stream.next_in = deflated;
+	stream.avail_in = deflated_size;
+
+	while (!stream.done) {
+		uint64_t offset = stream.total_out;
+
+		stream.next_out = buffer;
+		stream.avail_out = BUFFER_SIZE;
+
+		rc = inflate_step(&stream);
+		if (rc != EOK)
+			break;
+
+		if (verify) {
+			size_t produced = stream.total_out - offset;
+			if ((stream.total_out > COMPRESS_DATA_SIZE) ||
+			    (memcmp(buffer, data + offset, produced) != 0)) {
+				rc = EINVAL;
+				break;
+			}
+		}
+	}
+
+	if ((rc == EOK) && (stream.total_out != COMPRESS_DATA_SIZE))
+		rc = EINVAL;
+
+	inflate_end(&stream);
+	return rc;
+}
+
+static bool setup(bench_env_t *env, bench_run_t *run)
+{
+	int level;
+	errno_t rc = compress_data_level(env, run, &level);
+	if (rc != EOK)
+		return false;
+
+	data = malloc(COMPRESS_DATA_SIZE);
+	deflated = malloc(deflate_bound(COMPRESS_DATA_SIZE));
+	buffer = malloc(BUFFER_SIZE);
+
+	if ((data == NULL) || (deflated == NULL) || (buffer == NULL))
+		return bench_run_fail(run, "failed to allocate buffers");
+
+	compress_data_fill(data, COMPRESS_DATA_SIZE);
+
+	rc = deflate(data, COMPRESS_DATA_SIZE, deflated,
+	    deflate_bound(COMPRESS_DATA_SIZE), &deflated_size, level);
+	if (rc != EOK) {
+		return bench_run_fail(run, "failed to compress test data: %s",
+		    str_error(rc));
+	}
+
+	rc = inflate_data(true);
+	if (rc != EOK) {
+		return bench_run_fail(run, "failed to verify test data: %s",
+		    str_error(rc));
+	}
+
+	return true;
+}
+
+static bool teardown(bench_env_t *env, bench_run_t *run)
+{
+	free(data);
+	free(deflated);
+	free(buffer);
+
+	data = NULL;
+	deflated = NULL;
+	buffer = NULL;
+
+	return true;
+}
+
+/** Execute streaming decompression benchmark.
+ *
+ * Each iteration decompresses 1 MiB of text-like data through a
+ * 64 KiB output buffer.
+ */
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	bench_run_start(run);
+	for (uint64_t i = 0; i < size; i++) {
+		errno_t rc = inflate_data(false);
+		if (rc != EOK) {
+			return bench_run_fail(run, "failed to decompress data: %s",
+			    str_error(rc));
+		}
+	}
+	bench_run_stop(run);
+
+	return true;
+}
+
+benchmark_t benchmark_inflate = {
+	.name = "inflate",
+	.desc = "Decompress 1 MiB of deflated text through a 64 KiB buffer (use 'level' param to alter the compression level).",
+	.entry = &runner,
+	.setup = &setup,
+	.teardown = &teardown
+};
+
+/**
+ * @}
+ */
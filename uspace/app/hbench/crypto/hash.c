@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <crypto.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include "../hbench.h"
+
+/** Size of the hashed data */
+#define DATA_SIZE  (1024 * 1024)
+
+/** Size of chunks the data are passed to the hash function in */
+#define CHUNK_SIZE  4096
+
+static uint8_t *data;
+static hash_func_t func;
+
+static bool setup(bench_env_t *env, bench_run_t *run)
+{
+	const char *algo = bench_env_param_get(env, "algo", "sha256");
+
+	if (str_cmp(algo, "md5") == 0)
+		func = HASH_MD5;
+	else if (str_cmp(algo, "sha1") == 0)
+		func = HASH_SHA1;
+	else if (str_cmp(algo, "sha256") == 0)
+		func = HASH_SHA256;
+	else if (str_cmp(algo, "sha512") == 0)
+		func = HASH_SHA512;
+	else
+		return bench_run_fail(run, "unknown hash function '%s'", algo);
+
+	data = malloc(DATA_SIZE);
+	if (data == NULL)
+		return bench_run_fail(run, "failed to allocate buffer");
+
+	for (size_t i = 0; i < DATA_SIZE; i++)
+		data[i] = i * 7 + (i >> 8);
+
+	return true;
+}
+
+static bool teardown(bench_env_t *env, bench_run_t *run)
+{
+	free(data);
+	data = NULL;
+
+	return true;
+}
+
+/** Execute hashing benchmark.
+ *
+ * Each iteration hashes 1 MiB of data passed in 4 KiB chunks.
+ */
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	uint8_t hash[HASH_MAX_LENGTH];
+	hash_ctx_t ctx;
+
+	bench_run_start(run);
+	for (uint64_t i = 0; i < size; i++) {
+		errno_t rc = hash_init(&ctx, func);
+		if (rc != EOK)
+			return bench_run_fail(run, "failed to initialize hash");
+
+		for (size_t pos = 0; pos < DATA_SIZE; pos += CHUNK_SIZE)
+			hash_update(&ctx, data + pos, CHUNK_SIZE);
+
+		hash_final(&ctx, hash);
+	}
+	bench_run_stop(run);
+
+	return true;
+}
+
+benchmark_t benchmark_hash = {
+	.name = "hash",
+	.desc = "Hash 1 MiB of data (use 'algo' param to select md5, sha1, sha256 or sha512).",
+	.entry = &runner,
+	.setup = &setup,
+	.teardown = &teardown
+};
+
+/**
+ * @}
+ */
@@ -32,9 +32,11 @@
  */
 
 #include <dirent.h>
+#include <str.h>
 #include <str_error.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vfs/vfs.h>
 #include "../hbench.h"
 
 /** Execute directory listing benchmark.
@@ -42,34 +44,72 @@
  * Note that while this benchmark tries to measure speed of direct
  * read, it rather measures speed of FS cache as it is highly probable
  * that the corresponding blocks would be cached after first run.
+ *
+ * The 'stat' parameter selects whether attributes of each entry are
+ * retrieved as well: 'none' (default) only lists names, 'path' calls
+ * vfs_stat_path() for every entry (the way ls used to do it) and
+ * 'inline' uses readdir_stat().
  */
 static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
 {
 	const char *path = bench_env_param_get(env, "dirname", "/");
+	const char *mode = bench_env_param_get(env, "stat", "none");
+	char *entry_path;
+	vfs_stat_t st;
+
+	if (str_cmp(mode, "none") != 0 && str_cmp(mode, "path") != 0 &&
+	    str_cmp(mode, "inline") != 0) {
+		return bench_run_fail(run, "unknown stat mode '%s'", mode);
+	}
+
+	entry_path = malloc(MAX_PATH_LEN);
+	if (entry_path == NULL)
+		return bench_run_fail(run, "failed to allocate path buffer");
 
 	bench_run_start(run);
 	for (uint64_t i = 0; i < size; i++) {
 		DIR *dir = opendir(path);
 		if (dir == NULL) {
-			return bench_run_fail(run, "failed to open %s for reading: %s",
+			bench_run_fail(run, "failed to open %s for reading: %s",
 			    path, str_error(errno));
+			free(entry_path);
+			return false;
 		}
 
 		struct dirent *dp;
-		while ((dp = readdir(dir))) {
-			/* Do nothing */
+		if (str_cmp(mode, "inline") == 0) {
+			while ((dp = readdir_stat(dir, &st))) {
+				/* Do nothing */
+			}
+		} else if (str_cmp(mode, "path") == 0) {
+			while ((dp = readdir(dir))) {
+				snprintf(entry_path, MAX_PATH_LEN, "%s/%s",
+				    path, dp->d_name);
+				if (vfs_stat_path(entry_path, &st) != EOK) {
+					closedir(dir);
+					bench_run_fail(run, "failed to stat %s",
+					    entry_path);
+					free(entry_path);
+					return false;
+				}
+			}
+		} else {
+			while ((dp = readdir(dir))) {
+				/* Do nothing */
+			}
 		}
 
 		closedir(dir);
 	}
 	bench_run_stop(run);
 
+	free(entry_path);
 	return true;
 }
 
 benchmark_t benchmark_dir_read = {
 	.name = "dir_read",
-	.desc = "Read contents of a directory (use 'dirname' param to alter the default).",
+	.desc = "Read contents of a directory (use 'dirname' param to alter the default, 'stat' to fetch attributes).",
 	.entry = &runner,
 	.setup = NULL,
 	.teardown = NULL
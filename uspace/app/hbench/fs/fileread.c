@@ -34,23 +34,40 @@
 #include <str_error.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <str.h>
 #include "../hbench.h"
 
-#define BUFFER_SIZE 4096
+/** Largest buffer the file can be read into */
+#define BUFFER_SIZE_MAX (1024 * 1024)
 
 /** Execute file reading benchmark.
  *
  * Note that while this benchmark tries to measure speed of file reading,
  * it rather measures speed of FS cache as it is highly probable that the
  * corresponding blocks would be cached after first run.
+ *
+ * The file is read without stdio buffering, each read request asks
+ * the file system for 'bufsize' bytes. Pointing 'filename' to a file
+ * on an ext4 volume and using a large 'bufsize' measures multi-block
+ * transfers of the file system server.
  */
 static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
 {
 	const char *path = bench_env_param_get(env, "filename", "/data/web/helenos.png");
+	const char *bufsize_str = bench_env_param_get(env, "bufsize", "4096");
+
+	uint64_t bufsize;
+	errno_t rc = str_uint64_t(bufsize_str, NULL, 10, true, &bufsize);
+	if ((rc != EOK) || (bufsize == 0) || (bufsize > BUFFER_SIZE_MAX)) {
+		return bench_run_fail(run, "invalid buffer size '%s'",
+		    bufsize_str);
+	}
 
-	char *buf = malloc(BUFFER_SIZE);
+	char *buf = malloc(bufsize);
 	if (buf == NULL) {
-		return bench_run_fail(run, "failed to allocate %dB buffer", BUFFER_SIZE);
+		return bench_run_fail(run, "failed to allocate %" PRIu64 "B buffer",
+		    bufsize);
 	}
 
 	bool ret = true;
@@ -63,17 +80,18 @@ static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
 		goto leave_free_buf;
 	}
 
+	setvbuf(file, NULL, _IONBF, 0);
+
 	bench_run_start(run);
 	for (uint64_t i = 0; i < size; i++) {
-		int rc = fseek(file, 0, SEEK_SET);
-		if (rc != 0) {
+		if (fseek(file, 0, SEEK_SET) != 0) {
 			bench_run_fail(run, "failed to rewind %s: %s",
 			    path, str_error(errno));
 			ret = false;
 			goto leave_close;
 		}
 		while (!feof(file)) {
-			fread(buf, 1, BUFFER_SIZE, file);
+			fread(buf, 1, bufsize, file);
 			if (ferror(file)) {
 				bench_run_fail(run, "failed to read from %s: %s",
 				    path, str_error(errno));
@@ -95,7 +113,7 @@ leave_free_buf:
 
 benchmark_t benchmark_file_read = {
 	.name = "file_read",
-	.desc = "Sequentially read contents of a file (use 'filename' param to alter the default).",
+	.desc = "Sequentially read contents of a file (use 'filename' and 'bufsize' params to alter the defaults).",
 	.entry = &runner,
 	.setup = NULL,
 	.teardown = NULL
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <errno.h>
+#include <fibril.h>
+#include <fibril_synch.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <vfs/vfs.h>
+#include "../hbench.h"
+
+/** Largest buffer the file can be read into */
+#define BUFFER_SIZE_MAX (1024 * 1024)
+
+/** Largest number of concurrent readers */
+#define READERS_MAX 64
+
+/*
+ * Parallel file reading benchmark. Several fibrils read the same file at
+ * the same time, each with its own open file and buffer, so the file system
+ * server always has that many requests to work on. Comparing the results
+ * for different values of 'fibrils' shows how well the server scales.
+ */
+
+typedef struct {
+	const char *path;
+	size_t bufsize;
+
+	fibril_mutex_t lock;
+	fibril_condvar_t done_cv;
+	/** Number of passes over the file not yet claimed by a reader */
+	uint64_t todo;
+	/** Number of readers which have not finished yet */
+	unsigned active;
+	/** First error hit by any of the readers */
+	errno_t rc;
+	const char *failed_op;
+} shared_t;
+
+/** Claim the next pass over the file.
+ *
+ * @return True if there is work left and no reader has failed
+ */
+static bool claim_pass(shared_t *shared)
+{
+	bool claimed = false;
+
+	fibril_mutex_lock(&shared->lock);
+	if (shared->todo > 0 && shared->rc == EOK) {
+		shared->todo--;
+		claimed = true;
+	}
+	fibril_mutex_unlock(&shared->lock);
+
+	return claimed;
+}
+
+static errno_t reader(void *arg)
+{
+	shared_t *shared = arg;
+	const char *failed_op = NULL;
+	char *buf = NULL;
+	int fd = -1;
+	errno_t rc;
+
+	buf = malloc(shared->bufsize);
+	if (buf == NULL) {
+		rc = ENOMEM;
+		failed_op = "allocate buffer";
+		goto out;
+	}
+
+	rc = vfs_lookup_open(shared->path, WALK_REGULAR, MODE_READ, &fd);
+	if (rc != EOK) {
+		failed_op = "open";
+		goto out;
+	}
+
+	while (claim_pass(shared)) {
+		aoff64_t pos = 0;
+		size_t nread;
+
+		do {
+			rc = vfs_read(fd, &pos, buf, shared->bufsize, &nread);
+			if (rc != EOK) {
+				failed_op = "read";
+				goto out;
+			}
+		} while (nread > 0);
+	}
+
+out:
+	if (fd >= 0)
+		vfs_put(fd);
+	free(buf);
+
+	fibril_mutex_lock(&shared->lock);
+	if (rc != EOK && shared->rc == EOK) {
+		shared->rc = rc;
+		shared->failed_op = failed_op;
+	}
+	shared->active--;
+	fibril_condvar_broadcast(&shared->done_cv);
+	fibril_mutex_unlock(&shared->lock);
+
+	return rc;
+}
+
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	const char *bufsize_str = bench_env_param_get(env, "bufsize", "4096");
+	const char *fibrils_str = bench_env_param_get(env, "fibrils", "4");
+	shared_t shared;
+	uint64_t bufsize;
+	uint64_t fibrils;
+	errno_t rc;
+
+	shared.path = bench_env_param_get(env, "filename",
+	    "/data/web/helenos.png");
+
+	rc = str_uint64_t(bufsize_str, NULL, 10, true, &bufsize);
+	if ((rc != EOK) || (bufsize == 0) || (bufsize > BUFFER_SIZE_MAX)) {
+		return bench_run_fail(run, "invalid buffer size '%s'",
+		    bufsize_str);
+	}
+
+	rc = str_uint64_t(fibrils_str, NULL, 10, true, &fibrils);
+	if ((rc != EOK) || (fibrils == 0) || (fibrils > READERS_MAX)) {
+		return bench_run_fail(run, "invalid number of fibrils '%s'",
+		    fibrils_str);
+	}
+
+	shared.bufsize = bufsize;
+	fibril_mutex_initialize(&shared.lock);
+	fibril_condvar_initialize(&shared.done_cv);
+	shared.todo = size;
+	shared.active = 0;
+	shared.rc = EOK;
+	shared.failed_op = NULL;
+
+	bench_run_start(run);
+
+	for (uint64_t i = 0; i < fibrils; i++) {
+		fid_t fid = fibril_create(reader, &shared);
+		if (fid == 0) {
+			fibril_mutex_lock(&shared.lock);
+			if (shared.rc == EOK) {
+				shared.rc = ENOMEM;
+				shared.failed_op = "create fibril";
+			}
+			fibril_mutex_unlock(&shared.lock);
+			break;
+		}
+
+		fibril_mutex_lock(&shared.lock);
+		shared.active++;
+		fibril_mutex_unlock(&shared.lock);
+		fibril_add_ready(fid);
+	}
+
+	fibril_mutex_lock(&shared.lock);
+	while (shared.active > 0)
+		fibril_condvar_wait(&shared.done_cv, &shared.lock);
+	fibril_mutex_unlock(&shared.lock);
+
+	bench_run_stop(run);
+
+	if (shared.rc != EOK) {
+		return bench_run_fail(run, "failed to %s %s: %s",
+		    shared.failed_op, shared.path, str_error(shared.rc));
+	}
+
+	return true;
+}
+
+benchmark_t benchmark_file_read_parallel = {
+	.name = "file_read_parallel",
+	.desc = "Read a file from several fibrils at once (use 'filename', 'bufsize' and 'fibrils' params to alter the defaults).",
+	.entry = &runner,
+	.setup = NULL,
+	.teardown = NULL
+};
+
+/**
+ * @}
+ */
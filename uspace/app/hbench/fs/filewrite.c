@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <macros.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <vfs/vfs.h>
+#include "../hbench.h"
+
+/** Maximum number of files written at once */
+#define FILES_MAX  64
+
+/** Largest buffer the data can be written from */
+#define BUFFER_SIZE_MAX (1024 * 1024)
+
+static bool parse_param(bench_env_t *env, bench_run_t *run, const char *name,
+    const char *def, uint64_t max, uint64_t *value)
+{
+	const char *str = bench_env_param_get(env, name, def);
+
+	errno_t rc = str_uint64_t(str, NULL, 10, true, value);
+	if ((rc != EOK) || (*value == 0) || (*value > max))
+		return bench_run_fail(run, "invalid value '%s' of '%s'", str, name);
+
+	return true;
+}
+
+/** Execute file writing benchmark.
+ *
+ * Each iteration writes 'files' files of 'filesize' bytes in 'dirname'
+ * directory. The files are written concurrently, one 'bufsize' chunk
+ * to each file in turn, and closed at the end. Interleaved appending
+ * shows how well the file system keeps the files contiguous.
+ */
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	const char *dirname = bench_env_param_get(env, "dirname", "/tmp");
+	uint64_t files;
+	uint64_t filesize;
+	uint64_t bufsize;
+
+	if (!parse_param(env, run, "files", "4", FILES_MAX, &files))
+		return false;
+	if (!parse_param(env, run, "filesize", "1048576", UINT32_MAX, &filesize))
+		return false;
+	if (!parse_param(env, run, "bufsize", "4096", BUFFER_SIZE_MAX, &bufsize))
+		return false;
+
+	char *buf = malloc(bufsize);
+	if (buf == NULL) {
+		return bench_run_fail(run, "failed to allocate %" PRIu64 "B buffer",
+		    bufsize);
+	}
+
+	for (uint64_t i = 0; i < bufsize; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	char *paths[FILES_MAX];
+	FILE *file[FILES_MAX];
+	bool ret = true;
+
+	for (uint64_t f = 0; f < files; f++) {
+		file[f] = NULL;
+		if (asprintf(&paths[f], "%s/hbench%" PRIu64, dirname, f) < 0) {
+			while (f-- > 0)
+				free(paths[f]);
+			free(buf);
+			return bench_run_fail(run, "failed to allocate file name");
+		}
+	}
+
+	bench_run_start(run);
+	for (uint64_t i = 0; i < size; i++) {
+		for (uint64_t f = 0; f < files; f++) {
+			file[f] = fopen(paths[f], "w");
+			if (file[f] == NULL) {
+				bench_run_fail(run, "failed to open %s for writing: %s",
+				    paths[f], str_error(errno));
+				ret = false;
+				goto leave;
+			}
+
+			setvbuf(file[f], NULL, _IONBF, 0);
+		}
+
+		for (uint64_t pos = 0; pos < filesize; pos += bufsize) {
+			size_t chunk = min(bufsize, filesize - pos);
+
+			for (uint64_t f = 0; f < files; f++) {
+				if (fwrite(buf, 1, chunk, file[f]) != chunk) {
+					bench_run_fail(run, "failed to write to %s: %s",
+					    paths[f], str_error(errno));
+					ret = false;
+					goto leave;
+				}
+			}
+		}
+
+		for (uint64_t f = 0; f < files; f++) {
+			int rc = fclose(file[f]);
+			file[f] = NULL;
+			if (rc != 0) {
+				bench_run_fail(run, "failed to close %s: %s",
+				    paths[f], str_error(errno));
+				ret = false;
+				goto leave;
+			}
+		}
+	}
+	bench_run_stop(run);
+
+leave:
+	for (uint64_t f = 0; f < files; f++) {
+		if (file[f] != NULL)
+			fclose(file[f]);
+		vfs_unlink_path(paths[f]);
+		free(paths[f]);
+	}
+
+	free(buf);
+	return ret;
+}
+
+benchmark_t benchmark_file_write = {
+	.name = "file_write",
+	.desc = "Write files concurrently (use 'dirname', 'files', 'filesize' and 'bufsize' params to alter the defaults).",
+	.entry = &runner,
+	.setup = NULL,
+	.teardown = NULL
+};
+
+/**
+ * @}
+ */
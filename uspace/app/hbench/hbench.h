@@ -131,13 +131,22 @@ extern benchmark_t *benchmarks[];
 extern size_t benchmark_count;
 
 /* Put your benchmark descriptors here (and also to benchlist.c). */
+extern benchmark_t benchmark_bd_iops;
+extern benchmark_t benchmark_deflate;
 extern benchmark_t benchmark_dir_read;
 extern benchmark_t benchmark_fibril_mutex;
 extern benchmark_t benchmark_file_read;
+extern benchmark_t benchmark_file_read_parallel;
+extern benchmark_t benchmark_file_write;
+extern benchmark_t benchmark_hash;
+extern benchmark_t benchmark_http_parse;
+extern benchmark_t benchmark_inflate;
 extern benchmark_t benchmark_malloc1;
 extern benchmark_t benchmark_malloc2;
 extern benchmark_t benchmark_ns_ping;
 extern benchmark_t benchmark_ping_pong;
+extern benchmark_t benchmark_tcp_xfer;
+extern benchmark_t benchmark_udp_pps;
 
 #endif
 
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <errno.h>
+#include <http/parser.h>
+#include <mem.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include "../hbench.h"
+
+/** Number of copies of the response corpus in the test stream */
+#define CORPUS_COPIES  64
+
+/** Recorded responses, as they appear on a persistent connection */
+static const char *corpus[] = {
+	"HTTP/1.1 200 OK\r\n"
+	"Date: Mon, 19 Oct 2026 10:00:00 GMT\r\n"
+	"Server: websrv\r\n"
+	"Content-Type: text/html\r\n"
+	"Content-Length: 48\r\n"
+	"ETag: \"3f2a9c01\"\r\n"
+	"Connection: keep-alive\r\n"
+	"\r\n"
+	"<html><body><h1>It works!</h1></body></html>\r\n\r\n",
+
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Type: application/json\r\n"
+	"Transfer-Encoding: chunked\r\n"
+	"Cache-Control: no-cache\r\n"
+	"\r\n"
+	"1a\r\n"
+	"{\"name\": \"helenos\", \"id\": \r\n"
+	"4;ext=1\r\n"
+	"1234\r\n"
+	"10\r\n"
+	", \"tags\": [\"os\"]\r\n"
+	"1\r\n"
+	"}\r\n"
+	"0\r\n"
+	"X-Checksum: 1234\r\n"
+	"\r\n",
+
+	"HTTP/1.1 304 Not Modified\r\n"
+	"Date: Mon, 19 Oct 2026 10:00:01 GMT\r\n"
+	"Server: websrv\r\n"
+	"ETag: \"3f2a9c01\"\r\n"
+	"Cache-Control: max-age=3600, public\r\n"
+	"Expires: Mon, 19 Oct 2026 11:00:01 GMT\r\n"
+	"Last-Modified: Sun, 18 Oct 2026 08:00:00 GMT\r\n"
+	"Vary: Accept-Encoding\r\n"
+	"Accept-Ranges: bytes\r\n"
+	"X-Content-Type-Options: nosniff\r\n"
+	"X-Frame-Options: DENY\r\n"
+	"Strict-Transport-Security: max-age=31536000\r\n"
+	"Set-Cookie: session=0123456789abcdef; Path=/; HttpOnly\r\n"
+	"Connection: keep-alive\r\n"
+	"\r\n"
+};
+
+/** Size of body data in the corpus (after chunked decoding) */
+#define CORPUS_BODY_SIZE  (48 + 0x1a + 4 + 0x10 + 1)
+
+#define CORPUS_COUNT  (sizeof(corpus) / sizeof(corpus[0]))
+
+static char *stream;
+static char *work;
+static size_t stream_size;
+
+/** Parse all responses in the work buffer.
+ *
+ * @param rbody Place to store total size of body data
+ * @param rresp Place to store number of responses
+ * @return EOK on success, error code otherwise.
+ */
+static errno_t parse_stream(size_t *rbody, size_t *rresp)
+{
+	http_parser_t parser;
+	http_chunked_t chunked;
+	http_head_t head;
+	http_view_t value;
+	uint64_t length;
+	size_t consumed;
+	size_t decoded;
+	size_t body = 0;
+	size_t nresp = 0;
+	size_t pos = 0;
+	errno_t rc;
+
+	while (pos < stream_size) {
+		http_parser_init(&parser);
+		rc = http_parse_response(&parser, work + pos, stream_size - pos,
+		    &head, &consumed);
+		if (rc != EOK)
+			return rc;
+
+		pos += consumed;
+		++nresp;
+
+		if (head.status == 304)
+			continue;
+
+		rc = http_head_find(&head, "Transfer-Encoding", &value);
+		if (rc == EOK && http_view_has_token(&value, "chunked")) {
+			http_chunked_init(&chunked);
+			rc = http_chunked_decode(&chunked, work + pos,
+			    stream_size - pos, &decoded, &consumed);
+			if (rc != EOK)
+				return rc;
+			if (!http_chunked_done(&chunked))
+				return EINVAL;
+
+			pos += consumed;
+			body += decoded;
+			continue;
+		}
+
+		rc = http_head_find(&head, "Content-Length", &value);
+		if (rc != EOK)
+			return rc;
+
+		rc = http_view_uint64(&value, &length);
+		if (rc != EOK)
+			return rc;
+		if (length > stream_size - pos)
+			return EINVAL;
+
+		pos += length;
+		body += length;
+	}
+
+	*rbody = body;
+	*rresp = nresp;
+	return EOK;
+}
+
+static bool setup(bench_env_t *env, bench_run_t *run)
+{
+	size_t body;
+	size_t nresp;
+	size_t pos;
+	size_t len;
+	size_t i, j;
+	errno_t rc;
+
+	stream_size = 0;
+	for (j = 0; j < CORPUS_COUNT; j++)
+		stream_size += str_size(corpus[j]);
+	stream_size *= CORPUS_COPIES;
+
+	stream = malloc(stream_size);
+	work = malloc(stream_size);
+	if ((stream == NULL) || (work == NULL))
+		return bench_run_fail(run, "failed to allocate buffers");
+
+	pos = 0;
+	for (i = 0; i < CORPUS_COPIES; i++) {
+		for (j = 0; j < CORPUS_COUNT; j++) {
+			len = str_size(corpus[j]);
+			memcpy(stream + pos, corpus[j], len);
+			pos += len;
+		}
+	}
+
+	memcpy(work, stream, stream_size);
+	rc = parse_stream(&body, &nresp);
+	if (rc != EOK) {
+		return bench_run_fail(run, "failed to parse test data: %s",
+		    str_error(rc));
+	}
+
+	if ((nresp != CORPUS_COUNT * CORPUS_COPIES) ||
+	    (body != CORPUS_BODY_SIZE * CORPUS_COPIES))
+		return bench_run_fail(run, "test data parsed incorrectly");
+
+	return true;
+}
+
+static bool teardown(bench_env_t *env, bench_run_t *run)
+{
+	free(stream);
+	free(work);
+
+	stream = NULL;
+	work = NULL;
+
+	return true;
+}
+
+/** Execute HTTP response parsing benchmark.
+ *
+ * Each iteration parses a stream of recorded responses with
+ * content-length, chunked and header-only bodies. Chunked bodies are
+ * decoded in place, so the stream is restored before parsing.
+ */
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	size_t body;
+	size_t nresp;
+
+	bench_run_start(run);
+	for (uint64_t i = 0; i < size; i++) {
+		memcpy(work, stream, stream_size);
+		errno_t rc = parse_stream(&body, &nresp);
+		if (rc != EOK) {
+			return bench_run_fail(run, "failed to parse data: %s",
+			    str_error(rc));
+		}
+	}
+	bench_run_stop(run);
+
+	return true;
+}
+
+benchmark_t benchmark_http_parse = {
+	.name = "http_parse",
+	.desc = "Parse a stream of recorded HTTP responses and decode chunked bodies.",
+	.entry = &runner,
+	.setup = &setup,
+	.teardown = &teardown
+};
+
+/**
+ * @}
+ */
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <errno.h>
+#include <fibril_synch.h>
+#include <inet/addr.h>
+#include <inet/endpoint.h>
+#include <inet/tcp.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include "../hbench.h"
+
+/*
+ * Single-flow TCP throughput benchmark. Connects to a listener within
+ * the same task and pushes 'size' buffers of 'bufsize' bytes through the
+ * connection. With the default address the data go through the loopback
+ * link (loopip), so the result shows how fast the TCP stack itself can
+ * move data, including window growth and ACK processing.
+ */
+
+/** Largest supported buffer size */
+#define BUFFER_SIZE_MAX (1024 * 1024)
+
+/** Receiving side of the transfer */
+typedef struct {
+	fibril_mutex_t lock;
+	fibril_condvar_t cv;
+	/** Bytes we expect to receive */
+	uint64_t expected;
+	/** Bytes received so far */
+	uint64_t received;
+	/** Receiver has finished */
+	bool done;
+	/** Result of the transfer */
+	errno_t rc;
+	/** Receive buffer */
+	char *buf;
+	size_t bufsize;
+} xfer_t;
+
+static void xfer_new_conn(tcp_listener_t *, tcp_conn_t *);
+
+static tcp_listen_cb_t xfer_listen_cb = {
+	.new_conn = xfer_new_conn
+};
+
+/** No connection callbacks, both sides use the blocking interface */
+static tcp_cb_t xfer_conn_cb;
+
+/** Receive all data on the accepted connection. */
+static void xfer_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
+{
+	xfer_t *xfer = (xfer_t *) tcp_listener_userptr(lst);
+	size_t nrecv;
+	errno_t rc = EOK;
+
+	while (xfer->received < xfer->expected) {
+		rc = tcp_conn_recv_wait(conn, xfer->buf, xfer->bufsize, &nrecv);
+		if (rc != EOK)
+			break;
+		if (nrecv == 0) {
+			/* Peer closed the connection prematurely */
+			rc = EIO;
+			break;
+		}
+
+		xfer->received += nrecv;
+	}
+
+	fibril_mutex_lock(&xfer->lock);
+	xfer->rc = rc;
+	xfer->done = true;
+	fibril_condvar_broadcast(&xfer->cv);
+	fibril_mutex_unlock(&xfer->lock);
+}
+
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	const char *addr_str = bench_env_param_get(env, "addr", "127.0.0.1");
+	const char *port_str = bench_env_param_get(env, "port", "5800");
+	const char *bufsize_str = bench_env_param_get(env, "bufsize", "65536");
+	const char *cc_str = bench_env_param_get(env, "cc", NULL);
+	tcp_t *tcp = NULL;
+	tcp_listener_t *lst = NULL;
+	tcp_conn_t *conn = NULL;
+	inet_ep_t ep;
+	inet_ep2_t epp;
+	xfer_t xfer;
+	char *sbuf = NULL;
+	uint64_t bufsize;
+	uint16_t port;
+	uint64_t i;
+	bool ok = false;
+	errno_t rc;
+
+	rc = str_uint64_t(bufsize_str, NULL, 10, true, &bufsize);
+	if ((rc != EOK) || (bufsize == 0) || (bufsize > BUFFER_SIZE_MAX)) {
+		return bench_run_fail(run, "invalid buffer size '%s'",
+		    bufsize_str);
+	}
+
+	rc = str_uint16_t(port_str, NULL, 10, true, &port);
+	if (rc != EOK || port == 0)
+		return bench_run_fail(run, "invalid port '%s'", port_str);
+
+	inet_ep2_init(&epp);
+	rc = inet_addr_parse(addr_str, &epp.remote.addr, NULL);
+	if (rc != EOK)
+		return bench_run_fail(run, "invalid address '%s'", addr_str);
+	epp.remote.port = port;
+
+	fibril_mutex_initialize(&xfer.lock);
+	fibril_condvar_initialize(&xfer.cv);
+	xfer.expected = size * bufsize;
+	xfer.received = 0;
+	xfer.done = false;
+	xfer.rc = EOK;
+	xfer.bufsize = bufsize;
+	xfer.buf = malloc(bufsize);
+	sbuf = calloc(1, bufsize);
+	if (xfer.buf == NULL || sbuf == NULL) {
+		bench_run_fail(run, "failed to allocate buffers");
+		goto out;
+	}
+
+	rc = tcp_create(&tcp);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to initialize TCP: %s",
+		    str_error(rc));
+		goto out;
+	}
+
+	inet_ep_init(&ep);
+	ep.port = port;
+
+	rc = tcp_listener_create(tcp, &ep, &xfer_listen_cb, &xfer,
+	    &xfer_conn_cb, NULL, &lst);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to listen on port %" PRIu16 ": %s",
+		    port, str_error(rc));
+		goto out;
+	}
+
+	rc = tcp_conn_create(tcp, &epp, &xfer_conn_cb, NULL, &conn);
+	if (rc == EOK)
+		rc = tcp_conn_wait_connected(conn);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to connect to %s:%" PRIu16 ": %s",
+		    addr_str, port, str_error(rc));
+		goto out;
+	}
+
+	if (cc_str != NULL) {
+		if (str_cmp(cc_str, "newreno") == 0) {
+			rc = tcp_conn_set_cc(conn, tcp_cc_newreno);
+		} else if (str_cmp(cc_str, "cubic") == 0) {
+			rc = tcp_conn_set_cc(conn, tcp_cc_cubic);
+		} else {
+			bench_run_fail(run, "unknown congestion control '%s'",
+			    cc_str);
+			goto out;
+		}
+
+		if (rc != EOK) {
+			bench_run_fail(run, "failed to set congestion "
+			    "control: %s", str_error(rc));
+			goto out;
+		}
+	}
+
+	bench_run_start(run);
+
+	for (i = 0; i < size; i++) {
+		rc = tcp_conn_send(conn, sbuf, bufsize);
+		if (rc != EOK)
+			break;
+	}
+
+	if (rc == EOK)
+		rc = tcp_conn_push(conn);
+
+	fibril_mutex_lock(&xfer.lock);
+	while (rc == EOK && !xfer.done)
+		fibril_condvar_wait(&xfer.cv, &xfer.lock);
+	fibril_mutex_unlock(&xfer.lock);
+
+	bench_run_stop(run);
+
+	if (rc != EOK) {
+		bench_run_fail(run, "sending failed: %s", str_error(rc));
+		goto out;
+	}
+
+	if (xfer.rc != EOK) {
+		bench_run_fail(run, "receiving failed after %" PRIu64
+		    " bytes: %s", xfer.received, str_error(xfer.rc));
+		goto out;
+	}
+
+	ok = true;
+out:
+	if (conn != NULL)
+		tcp_conn_destroy(conn);
+	if (lst != NULL)
+		tcp_listener_destroy(lst);
+	if (tcp != NULL)
+		tcp_destroy(tcp);
+	free(sbuf);
+	free(xfer.buf);
+	return ok;
+}
+
+benchmark_t benchmark_tcp_xfer = {
+	.name = "tcp_xfer",
+	.desc = "Single-flow TCP transfer of 'size' buffers over loopback (use 'addr', 'port', 'bufsize' and 'cc' params).",
+	.entry = &runner,
+	.setup = NULL,
+	.teardown = NULL
+};
+
+/**
+ * @}
+ */
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <errno.h>
+#include <fibril_synch.h>
+#include <inet/addr.h>
+#include <inet/endpoint.h>
+#include <inet/udp.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include "../hbench.h"
+
+/*
+ * UDP packet rate benchmark. Sends 'size' datagrams of 'psize' bytes to
+ * a receiver within the same task, keeping at most 'window' datagrams
+ * in flight. Small datagrams make the per-packet cost of the stack
+ * (IPC hops, buffer management, demultiplexing) dominate, so the result
+ * is best read as packets per second.
+ */
+
+/** Largest supported datagram size */
+#define PACKET_SIZE_MAX 65507
+
+/** Give up if no datagram arrives for this long (usec) */
+#define RECV_TIMEOUT_USEC (1000 * 1000)
+
+/** Receiving side of the benchmark */
+typedef struct {
+	fibril_mutex_t lock;
+	fibril_condvar_t cv;
+	/** Datagrams received so far */
+	uint64_t received;
+} pps_t;
+
+static void pps_recv_msg(udp_assoc_t *, udp_rmsg_t *);
+
+static udp_cb_t pps_recv_cb = {
+	.recv_msg = pps_recv_msg
+};
+
+/** The sending association does not expect any datagrams */
+static udp_cb_t pps_send_cb;
+
+/** Count received datagram. */
+static void pps_recv_msg(udp_assoc_t *assoc, udp_rmsg_t *rmsg)
+{
+	pps_t *pps = (pps_t *) udp_assoc_userptr(assoc);
+
+	fibril_mutex_lock(&pps->lock);
+	++pps->received;
+	fibril_condvar_broadcast(&pps->cv);
+	fibril_mutex_unlock(&pps->lock);
+}
+
+/** Wait until at most @a inflight of @a sent datagrams are outstanding.
+ *
+ * @return EOK on success, ETIMEOUT if datagrams seem to be lost
+ */
+static errno_t pps_wait(pps_t *pps, uint64_t sent, uint64_t inflight)
+{
+	uint64_t last;
+	errno_t rc = EOK;
+
+	fibril_mutex_lock(&pps->lock);
+	while (sent - pps->received > inflight) {
+		last = pps->received;
+		rc = fibril_condvar_wait_timeout(&pps->cv, &pps->lock,
+		    RECV_TIMEOUT_USEC);
+		if (rc == ETIMEOUT && pps->received == last)
+			break;
+		rc = EOK;
+	}
+	fibril_mutex_unlock(&pps->lock);
+
+	return rc;
+}
+
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t size)
+{
+	const char *addr_str = bench_env_param_get(env, "addr", "127.0.0.1");
+	const char *port_str = bench_env_param_get(env, "port", "5801");
+	const char *psize_str = bench_env_param_get(env, "psize", "64");
+	const char *window_str = bench_env_param_get(env, "window", "64");
+	udp_t *udp = NULL;
+	udp_assoc_t *rassoc = NULL;
+	udp_assoc_t *sassoc = NULL;
+	inet_ep2_t repp;
+	inet_ep2_t sepp;
+	inet_ep_t dest;
+	pps_t pps;
+	char *buf = NULL;
+	uint64_t psize;
+	uint64_t window;
+	uint16_t port;
+	uint64_t i;
+	bool ok = false;
+	errno_t rc;
+
+	rc = str_uint64_t(psize_str, NULL, 10, true, &psize);
+	if ((rc != EOK) || (psize == 0) || (psize > PACKET_SIZE_MAX)) {
+		return bench_run_fail(run, "invalid packet size '%s'",
+		    psize_str);
+	}
+
+	rc = str_uint64_t(window_str, NULL, 10, true, &window);
+	if (rc != EOK || window == 0)
+		return bench_run_fail(run, "invalid window '%s'", window_str);
+
+	rc = str_uint16_t(port_str, NULL, 10, true, &port);
+	if (rc != EOK || port == 0)
+		return bench_run_fail(run, "invalid port '%s'", port_str);
+
+	inet_ep_init(&dest);
+	rc = inet_addr_parse(addr_str, &dest.addr, NULL);
+	if (rc != EOK)
+		return bench_run_fail(run, "invalid address '%s'", addr_str);
+	dest.port = port;
+
+	fibril_mutex_initialize(&pps.lock);
+	fibril_condvar_initialize(&pps.cv);
+	pps.received = 0;
+
+	buf = calloc(1, psize);
+	if (buf == NULL) {
+		bench_run_fail(run, "failed to allocate buffer");
+		goto out;
+	}
+
+	rc = udp_create(&udp);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to initialize UDP: %s",
+		    str_error(rc));
+		goto out;
+	}
+
+	inet_ep2_init(&repp);
+	repp.local.port = port;
+
+	rc = udp_assoc_create(udp, &repp, &pps_recv_cb, &pps, &rassoc);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to listen on port %" PRIu16 ": %s",
+		    port, str_error(rc));
+		goto out;
+	}
+
+	inet_ep2_init(&sepp);
+
+	rc = udp_assoc_create(udp, &sepp, &pps_send_cb, NULL, &sassoc);
+	if (rc != EOK) {
+		bench_run_fail(run, "failed to create association: %s",
+		    str_error(rc));
+		goto out;
+	}
+
+	bench_run_start(run);
+
+	for (i = 0; i < size; i++) {
+		rc = pps_wait(&pps, i, window - 1);
+		if (rc != EOK)
+			break;
+
+		rc = udp_assoc_send_msg(sassoc, &dest, buf, psize);
+		if (rc != EOK)
+			break;
+	}
+
+	if (rc == EOK)
+		rc = pps_wait(&pps, size, 0);
+
+	bench_run_stop(run);
+
+	if (rc == ETIMEOUT) {
+		bench_run_fail(run, "lost datagrams, received %" PRIu64
+		    " of %" PRIu64, pps.received, i);
+		goto out;
+	}
+
+	if (rc != EOK) {
+		bench_run_fail(run, "sending to %s:%" PRIu16 " failed: %s",
+		    addr_str, port, str_error(rc));
+		goto out;
+	}
+
+	ok = true;
+out:
+	if (sassoc != NULL)
+		udp_assoc_destroy(sassoc);
+	if (rassoc != NULL)
+		udp_assoc_destroy(rassoc);
+	if (udp != NULL)
+		udp_destroy(udp);
+	free(buf);
+	return ok;
+}
+
+benchmark_t benchmark_udp_pps = {
+	.name = "udp_pps",
+	.desc = "UDP packet rate with 'size' datagrams over loopback (use 'addr', 'port', 'psize' and 'window' params).",
+	.entry = &runner,
+	.setup = NULL,
+	.teardown = NULL
+};
+
+/**
+ * @}
+ */
@@ -32,6 +32,7 @@
 /** @file
  */
 
+#include <assert.h>
 #include <byteorder.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -73,6 +74,11 @@ static void comm_udp_recv_msg(udp_assoc_t *assoc, udp_rmsg_t *rmsg)
 	size_t now;
 	errno_t rc;
 
+	if (netecho_count_only()) {
+		netecho_counted();
+		return;
+	}
+
 	size = udp_rmsg_size(rmsg);
 	pos = 0;
 	while (pos < size) {
@@ -191,5 +197,48 @@ errno_t comm_send(void *data, size_t size)
 	return EOK;
 }
 
+/** Send the same datagram several times.
+ *
+ * The datagrams are passed to the UDP service in a single batch.
+ *
+ * @param data  Datagram data
+ * @param size  Datagram size
+ * @param count Number of datagrams to send (at most COMM_BURST_MAX)
+ * @return EOK on success or an error code
+ */
+errno_t comm_send_burst(void *data, size_t size, size_t count)
+{
+	udp_smsg_t msgs[COMM_BURST_MAX];
+	size_t i;
+
+	assert(count <= COMM_BURST_MAX);
+
+	for (i = 0; i < count; i++) {
+		msgs[i].dest = NULL;
+		msgs[i].data = data;
+		msgs[i].size = size;
+	}
+
+	return udp_assoc_send_batch(assoc, msgs, count, NULL);
+}
+
+/** Get number of received datagrams dropped by the UDP service.
+ *
+ * @param rdrops Place to store number of dropped datagrams
+ * @return EOK on success or an error code
+ */
+errno_t comm_get_drops(uint64_t *rdrops)
+{
+	udp_assoc_stats_t stats;
+	errno_t rc;
+
+	rc = udp_assoc_get_stats(assoc, &stats);
+	if (rc != EOK)
+		return rc;
+
+	*rdrops = stats.drops;
+	return EOK;
+}
+
 /** @}
  */
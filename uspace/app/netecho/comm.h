@@ -37,11 +37,17 @@
 #define COMM_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of datagrams passed to comm_send_burst() */
+#define COMM_BURST_MAX 64
 
 extern errno_t comm_open_listen(const char *);
 extern errno_t comm_open_talkto(const char *);
 extern void comm_close(void);
 extern errno_t comm_send(void *, size_t);
+extern errno_t comm_send_burst(void *, size_t, size_t);
+extern errno_t comm_get_drops(uint64_t *);
 
 #endif
 
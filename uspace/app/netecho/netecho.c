@@ -34,18 +34,47 @@
 
 #include <stdbool.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <io/console.h>
+#include <macros.h>
+#include <mem.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <str.h>
+#include <time.h>
 
 #include "comm.h"
 #include "netecho.h"
 
 #define NAME "netecho"
 
+/** Default number of datagrams sent in packet rate mode */
+#define PPS_COUNT_DEF 100000
+/** Default datagram size in packet rate mode */
+#define PPS_SIZE_DEF 64
+/** Largest datagram size in packet rate mode */
+#define PPS_SIZE_MAX 1024
+
 static console_ctrl_t *con;
 static bool done;
 
+/** Only count received datagrams (packet rate sink) */
+static bool count_only;
+/** Number of datagrams received in packet rate sink mode */
+static uint64_t pps_received;
+
+/** Determine if received datagrams should only be counted. */
+bool netecho_count_only(void)
+{
+	return count_only;
+}
+
+/** Count received datagram in packet rate sink mode. */
+void netecho_counted(void)
+{
+	++pps_received;
+}
+
 void netecho_received(void *data, size_t size)
 {
 	char *p;
@@ -114,6 +143,14 @@ static void print_syntax(void)
 	printf("syntax:\n");
 	printf("\t%s -l <port>\n", NAME);
 	printf("\t%s -d <host>:<port> [<message> [<message...>]]\n", NAME);
+	printf("\t%s -P <port>\n", NAME);
+	printf("\t%s -p <host>:<port> [<count> [<size>]]\n", NAME);
+	printf("\n");
+	printf("-P receives datagrams and prints packet rate once a second.\n");
+	printf("-p sends <count> datagrams of <size> bytes in bursts of %d\n",
+	    COMM_BURST_MAX);
+	printf("   and prints packet rate (default %d datagrams of %d bytes).\n",
+	    PPS_COUNT_DEF, PPS_SIZE_DEF);
 }
 
 /* Interactive mode */
@@ -133,6 +170,77 @@ static void netecho_interact(void)
 	}
 }
 
+/* Packet rate sink mode */
+static void netecho_pps_sink(void)
+{
+	cons_event_t ev;
+	uint64_t last = 0;
+	uint64_t drops = 0;
+	usec_t timeout;
+
+	printf("Counting datagrams. Press Ctrl-Q to quit.\n");
+
+	count_only = true;
+	con = console_init(stdin, stdout);
+
+	done = false;
+	while (!done) {
+		timeout = 1000 * 1000;
+		while (timeout > 0 && !done) {
+			if (!console_get_event_timeout(con, &ev, &timeout))
+				break;
+			if (ev.type == CEV_KEY && ev.ev.key.type == KEY_PRESS)
+				key_handle(&ev.ev.key);
+		}
+
+		(void) comm_get_drops(&drops);
+		printf("%" PRIu64 " pkt/s, %" PRIu64 " received, "
+		    "%" PRIu64 " dropped\n", pps_received - last, pps_received,
+		    drops);
+		last = pps_received;
+	}
+}
+
+/* Packet rate source mode */
+static errno_t netecho_pps_source(size_t count, size_t size)
+{
+	char data[PPS_SIZE_MAX];
+	struct timespec start;
+	struct timespec end;
+	uint64_t usec;
+	size_t sent;
+	size_t now;
+	errno_t rc;
+
+	memset(data, 'x', size);
+
+	printf("Sending %zu datagrams of %zu bytes.\n", count, size);
+
+	getuptime(&start);
+
+	sent = 0;
+	while (sent < count) {
+		now = min(count - sent, (size_t) COMM_BURST_MAX);
+		rc = comm_send_burst(data, size, now);
+		if (rc != EOK) {
+			printf("Error sending data.\n");
+			return rc;
+		}
+
+		sent += now;
+	}
+
+	getuptime(&end);
+
+	usec = NSEC2USEC(ts_sub_diff(&end, &start));
+	if (usec == 0)
+		usec = 1;
+
+	printf("Sent %zu datagrams in %" PRIu64 " ms, %" PRIu64 " pkt/s.\n",
+	    sent, usec / 1000, (uint64_t) sent * 1000000 / usec);
+	return EOK;
+}
+
 static void netecho_send_messages(char **msgs)
 {
 	errno_t rc;
@@ -152,6 +260,11 @@ int main(int argc, char *argv[])
 	char *hostport;
 	char *port;
 	char **msgs;
+	bool pps_sink = false;
+	bool pps_source = false;
+	size_t pps_count = PPS_COUNT_DEF;
+	size_t pps_size = PPS_SIZE_DEF;
+	char *endptr;
 	errno_t rc;
 
 	if (argc < 2) {
@@ -188,12 +301,64 @@ int main(int argc, char *argv[])
 			printf("Error setting up communication.\n");
 			return 1;
 		}
+	} else if (str_cmp(argv[1], "-P") == 0) {
+		if (argc != 3) {
+			print_syntax();
+			return 1;
+		}
+
+		msgs = NULL;
+		pps_sink = true;
+
+		rc = comm_open_listen(argv[2]);
+		if (rc != EOK) {
+			printf("Error setting up communication.\n");
+			return 1;
+		}
+	} else if (str_cmp(argv[1], "-p") == 0) {
+		if (argc < 3 || argc > 5) {
+			print_syntax();
+			return 1;
+		}
+
+		if (argc > 3) {
+			pps_count = strtoul(argv[3], &endptr, 10);
+			if (*endptr != '\0' || pps_count == 0) {
+				printf("Invalid count %s\n", argv[3]);
+				return 1;
+			}
+		}
+
+		if (argc > 4) {
+			pps_size = strtoul(argv[4], &endptr, 10);
+			if (*endptr != '\0' || pps_size == 0 ||
+			    pps_size > PPS_SIZE_MAX) {
+				printf("Invalid size %s (1-%d)\n", argv[4],
+				    PPS_SIZE_MAX);
+				return 1;
+			}
+		}
+
+		msgs = NULL;
+		pps_source = true;
+
+		rc = comm_open_talkto(argv[2]);
+		if (rc != EOK) {
+			printf("Error setting up communication.\n");
+			return 1;
+		}
 	} else {
 		print_syntax();
 		return 1;
 	}
 
-	if (msgs != NULL && *msgs != NULL) {
+	if (pps_sink) {
+		netecho_pps_sink();
+	} else if (pps_source) {
+		rc = netecho_pps_source(pps_count, pps_size);
+		comm_close();
+		return rc == EOK ? 0 : 1;
+	} else if (msgs != NULL && *msgs != NULL) {
 		/* Just send messages and quit */
 		netecho_send_messages(msgs);
 	} else {
@@ -36,9 +36,12 @@
 #ifndef NETECHO_H
 #define NETECHO_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 extern void netecho_received(void *, size_t);
+extern bool netecho_count_only(void);
+extern void netecho_counted(void);
 
 #endif
 
@@ -0,0 +1,4 @@
+/** @addtogroup webload webload
+ * @brief HTTP load generator
+ * @ingroup apps
+ */
@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup webload
+ * @{
+ */
+/**
+ * @file HTTP load generator.
+ *
+ * Sends GET requests for one path over several persistent connections,
+ * optionally pipelining them, and reports requests per second.
+ */
+
+#include <errno.h>
+#include <fibril.h>
+#include <fibril_synch.h>
+#include <inet/endpoint.h>
+#include <inet/hostport.h>
+#include <inet/tcp.h>
+#include <mem.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <time.h>
+
+#define NAME "webload"
+
+/** Default number of requests */
+#define DEFAULT_REQUESTS  1000
+
+/** Default number of connections */
+#define DEFAULT_CONNS  4
+
+/** Default number of requests in flight per connection */
+#define DEFAULT_DEPTH  1
+
+/** Size of receive buffer */
+#define RECV_BUF_SIZE  16384
+
+/** Maximum length of response header line */
+#define LINE_SIZE_MAX  1024
+
+/** One client connection */
+typedef struct {
+	tcp_conn_t *conn;
+	/** Number of requests to complete */
+	unsigned quota;
+	/** Number of requests completed */
+	unsigned done;
+	/** Number of responses other than 200 or 304 */
+	unsigned errors;
+	/** Number of body bytes received */
+	uint64_t bytes;
+	/** Error which stopped the client */
+	errno_t rc;
+
+	char rbuf[RECV_BUF_SIZE];
+	size_t rbuf_out;
+	size_t rbuf_in;
+	char lbuf[LINE_SIZE_MAX + 1];
+} client_t;
+
+static tcp_t *tcp;
+static inet_ep2_t epp;
+/** Request to send (repeated for pipelining) */
+static char *request;
+static size_t request_size;
+static unsigned depth = DEFAULT_DEPTH;
+
+static FIBRIL_MUTEX_INITIALIZE(done_lock);
+static FIBRIL_CONDVAR_INITIALIZE(done_cv);
+/** Number of clients which finished */
+static unsigned clients_done;
+
+static void syntax_print(void)
+{
+	fprintf(stderr, "Usage: " NAME " [-n <requests>] [-c <connections>] "
+	    "[-d <depth>] <host>:<port> [<path>]\n");
+	fprintf(stderr, "  -n  Total number of requests (default %u)\n",
+	    DEFAULT_REQUESTS);
+	fprintf(stderr, "  -c  Number of concurrent connections "
+	    "(default %u)\n", DEFAULT_CONNS);
+	fprintf(stderr, "  -d  Number of pipelined requests per connection "
+	    "(default %u)\n", DEFAULT_DEPTH);
+}
+
+/** Receive one response line, stripping line terminator. */
+static errno_t client_recv_line(client_t *client, char **rline)
+{
+	size_t used = 0;
+	size_t nrecv;
+	char c;
+	errno_t rc;
+
+	while (true) {
+		if (client->rbuf_out == client->rbuf_in) {
+			rc = tcp_conn_recv_wait(client->conn, client->rbuf,
+			    RECV_BUF_SIZE, &nrecv);
+			if (rc != EOK)
+				return rc;
+			if (nrecv == 0)
+				return EPIPE;
+
+			client->rbuf_out = 0;
+			client->rbuf_in = nrecv;
+		}
+
+		c = client->rbuf[client->rbuf_out++];
+		if (c == '\n')
+			break;
+
+		if (used >= LINE_SIZE_MAX)
+			return ELIMIT;
+
+		client->lbuf[used++] = c;
+	}
+
+	if (used > 0 && client->lbuf[used - 1] == '\r')
+		--used;
+	client->lbuf[used] = '\0';
+
+	*rline = client->lbuf;
+	return EOK;
+}
+
+/** Receive and discard response body. */
+static errno_t client_recv_body(client_t *client, size_t size)
+{
+	size_t nrecv;
+	size_t n;
+	errno_t rc;
+
+	while (size > 0) {
+		if (client->rbuf_out == client->rbuf_in) {
+			rc = tcp_conn_recv_wait(client->conn, client->rbuf,
+			    RECV_BUF_SIZE, &nrecv);
+			if (rc != EOK)
+				return rc;
+			if (nrecv == 0)
+				return EPIPE;
+
+			client->rbuf_out = 0;
+			client->rbuf_in = nrecv;
+		}
+
+		n = min(size, client->rbuf_in - client->rbuf_out);
+		client->rbuf_out += n;
+		client->bytes += n;
+		size -= n;
+	}
+
+	return EOK;
+}
+
+/** Receive one response.
+ *
+ * @param client Client
+ * @param rclose Place to store @c true if the server is closing
+ *               the connection
+ */
+static errno_t client_recv_response(client_t *client, bool *rclose)
+{
+	char *line;
+	char *value;
+	size_t size = 0;
+	int status;
+	errno_t rc;
+
+	rc = client_recv_line(client, &line);
+	if (rc != EOK)
+		return rc;
+
+	/* HTTP/1.x NNN Reason */
+	if (str_lcmp(line, "HTTP/1.", 7) != 0 || str_length(line) < 12)
+		return EIO;
+
+	status = atoi(line + 9);
+	if (status != 200 && status != 304)
+		++client->errors;
+
+	/* HTTP/1.0 server closes the connection unless told otherwise */
+	*rclose = str_lcmp(line, "HTTP/1.0", 8) == 0;
+
+	while (true) {
+		rc = client_recv_line(client, &line);
+		if (rc != EOK)
+			return rc;
+
+		if (*line == '\0')
+			break;
+
+		value = str_chr(line, ':');
+		if (value == NULL)
+			continue;
+
+		*value++ = '\0';
+		while (*value == ' ')
+			++value;
+
+		if (str_casecmp(line, "Content-Length") == 0)
+			size = strtoul(value, NULL, 10);
+		else if (str_casecmp(line, "Connection") == 0)
+			*rclose = str_casecmp(value, "keep-alive") != 0;
+	}
+
+	/* 304 response carries no body */
+	if (status == 304)
+		size = 0;
+
+	return client_recv_body(client, size);
+}
+
+static errno_t client_connect(client_t *client)
+{
+	errno_t rc;
+
+	rc = tcp_conn_create(tcp, &epp, NULL, NULL, &client->conn);
+	if (rc != EOK)
+		return rc;
+
+	rc = tcp_conn_wait_connected(client->conn);
+	if (rc != EOK) {
+		tcp_conn_destroy(client->conn);
+		client->conn = NULL;
+		return rc;
+	}
+
+	client->rbuf_out = 0;
+	client->rbuf_in = 0;
+	return EOK;
+}
+
+/** Client fibril. */
+static errno_t client_fibril(void *arg)
+{
+	client_t *client = (client_t *) arg;
+	unsigned nreq;
+	unsigned i;
+	bool close;
+	errno_t rc = EOK;
+
+	while (client->done < client->quota) {
+		if (client->conn == NULL) {
+			rc = client_connect(client);
+			if (rc != EOK)
+				break;
+		}
+
+		/* Send up to depth requests at once */
+		nreq = min(depth, client->quota - client->done);
+		for (i = 0; i < nreq; i++) {
+			rc = tcp_conn_send(client->conn, request,
+			    request_size);
+			if (rc != EOK)
+				break;
+		}
+
+		close = false;
+		for (i = 0; i < nreq && rc == EOK && !close; i++) {
+			rc = client_recv_response(client, &close);
+			if (rc == EOK)
+				++client->done;
+		}
+
+		if (rc != EOK)
+			break;
+
+		/* Server closed the connection, requests not answered are resent */
+		if (close) {
+			tcp_conn_destroy(client->conn);
+			client->conn = NULL;
+		}
+	}
+
+	if (client->conn != NULL) {
+		tcp_conn_send_fin(client->conn);
+		tcp_conn_destroy(client->conn);
+		client->conn = NULL;
+	}
+
+	client->rc = rc;
+
+	fibril_mutex_lock(&done_lock);
+	++clients_done;
+	fibril_condvar_broadcast(&done_cv);
+	fibril_mutex_unlock(&done_lock);
+
+	return EOK;
+}
+
+static errno_t parse_uint(const char *str, unsigned *rval)
+{
+	char *end;
+	unsigned long val;
+
+	val = strtoul(str, &end, 10);
+	if (*str == '\0' || *end != '\0' || val == 0 || val > UINT32_MAX)
+		return EINVAL;
+
+	*rval = val;
+	return EOK;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned nrequests = DEFAULT_REQUESTS;
+	unsigned nconns = DEFAULT_CONNS;
+	client_t *clients = NULL;
+	const char *errmsg;
+	const char *path;
+	struct timespec start, end;
+	uint64_t done, errors, bytes;
+	uint64_t usec;
+	unsigned *opt;
+	unsigned i;
+	fid_t fid;
+	errno_t rc;
+	int argi;
+
+	argi = 1;
+	while (argi < argc && argv[argi][0] == '-') {
+		if (str_cmp(argv[argi], "-n") == 0)
+			opt = &nrequests;
+		else if (str_cmp(argv[argi], "-c") == 0)
+			opt = &nconns;
+		else if (str_cmp(argv[argi], "-d") == 0)
+			opt = &depth;
+		else {
+			syntax_print();
+			return 1;
+		}
+
+		if (argi + 1 >= argc || parse_uint(argv[argi + 1], opt) != EOK) {
+			syntax_print();
+			return 1;
+		}
+
+		argi += 2;
+	}
+
+	if (argi != argc - 1 && argi != argc - 2) {
+		syntax_print();
+		return 1;
+	}
+
+	path = (argi == argc - 2) ? argv[argi + 1] : "/";
+
+	inet_ep2_init(&epp);
+	rc = inet_hostport_plookup_one(argv[argi], ip_any, &epp.remote, NULL,
+	    &errmsg);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: %s (host:port %s).\n", NAME, errmsg,
+		    argv[argi]);
+		return 1;
+	}
+
+	if (asprintf(&request, "GET %s HTTP/1.1\r\n"
+	    "Host: %s\r\n"
+	    "User-Agent: HelenOS-" NAME "\r\n"
+	    "\r\n", path, argv[argi]) < 0) {
+		fprintf(stderr, "%s: Out of memory.\n", NAME);
+		return 1;
+	}
+
+	request_size = str_size(request);
+
+	if (nconns > nrequests)
+		nconns = nrequests;
+
+	clients = calloc(nconns, sizeof(client_t));
+	if (clients == NULL) {
+		fprintf(stderr, "%s: Out of memory.\n", NAME);
+		rc = ENOMEM;
+		goto error;
+	}
+
+	rc = tcp_create(&tcp);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Error initializing TCP.\n", NAME);
+		goto error;
+	}
+
+	printf("%s: %u requests over %u connections, depth %u\n", NAME,
+	    nrequests, nconns, depth);
+
+	getuptime(&start);
+
+	for (i = 0; i < nconns; i++) {
+		/* Spread requests evenly */
+		clients[i].quota = nrequests / nconns +
+		    (i < nrequests % nconns ? 1 : 0);
+
+		fid = fibril_create(client_fibril, &clients[i]);
+		if (fid == 0) {
+			/* Count the client as finished right away */
+			clients[i].rc = ENOMEM;
+			fibril_mutex_lock(&done_lock);
+			++clients_done;
+			fibril_mutex_unlock(&done_lock);
+			continue;
+		}
+
+		fibril_add_ready(fid);
+	}
+
+	fibril_mutex_lock(&done_lock);
+	while (clients_done < nconns)
+		fibril_condvar_wait(&done_cv, &done_lock);
+	fibril_mutex_unlock(&done_lock);
+
+	getuptime(&end);
+
+	done = 0;
+	errors = 0;
+	bytes = 0;
+	rc = EOK;
+	for (i = 0; i < nconns; i++) {
+		done += clients[i].done;
+		errors += clients[i].errors;
+		bytes += clients[i].bytes;
+		if (clients[i].rc != EOK)
+			rc = clients[i].rc;
+	}
+
+	usec = NSEC2USEC(ts_sub_diff(&end, &start));
+	if (usec == 0)
+		usec = 1;
+
+	printf("Completed %" PRIu64 " requests in %" PRIu64 " ms, %" PRIu64
+	    " errors\n", done, usec / 1000, errors);
+	printf("%" PRIu64 " requests/s, %" PRIu64 " KiB/s\n",
+	    done * 1000000 / usec, bytes * 1000000 / usec / 1024);
+
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Some connections failed (%s).\n", NAME,
+		    str_error(rc));
+	}
+
+	tcp_destroy(tcp);
+	free(clients);
+	free(request);
+	return rc == EOK ? 0 : 1;
+error:
+	free(clients);
+	free(request);
+	return 1;
+}
+
+/** @}
+ */
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup websrv
+ * @{
+ */
+/**
+ * @file In-memory cache of small files.
+ *
+ * Hot small files are served from memory. A cached file is re-read once
+ * it is older than CACHE_TTL, so changes to the file show up shortly.
+ * The entity tag is derived from file contents, as the file system does
+ * not provide modification times.
+ */
+
+#include <adt/hash.h>
+#include <fibril_synch.h>
+#include <mem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <vfs/vfs.h>
+
+#include "cache.h"
+
+/** Cached file is considered fresh for this long (s) */
+#define CACHE_TTL  2
+
+static hash_table_t cache;
+/** Cached files, most recently used first */
+static LIST_INITIALIZE(cache_lru);
+/** Total size of cached file data */
+static size_t cache_size;
+static FIBRIL_MUTEX_INITIALIZE(cache_lock);
+
+static size_t cache_name_hash(const char *name)
+{
+	size_t hash = 0;
+
+	while (*name != '\0')
+		hash = hash_combine(hash, (uint8_t) *name++);
+
+	return hash;
+}
+
+static size_t cache_key_hash(const void *key)
+{
+	return cache_name_hash((const char *) key);
+}
+
+static size_t cache_entry_hash(const ht_link_t *item)
+{
+	cache_entry_t *entry = hash_table_get_inst(item, cache_entry_t, lhash);
+	return cache_name_hash(entry->fname);
+}
+
+static bool cache_key_equal(const void *key, const ht_link_t *item)
+{
+	cache_entry_t *entry = hash_table_get_inst(item, cache_entry_t, lhash);
+	return str_cmp(entry->fname, (const char *) key) == 0;
+}
+
+static void cache_entry_destroy(cache_entry_t *entry)
+{
+	free(entry->fname);
+	free(entry->data);
+	free(entry);
+}
+
+static void cache_entry_remove(ht_link_t *item)
+{
+	cache_entry_t *entry = hash_table_get_inst(item, cache_entry_t, lhash);
+
+	list_remove(&entry->llru);
+	cache_size -= entry->size;
+	entry->cached = false;
+
+	/* Entry being sent is destroyed when released */
+	if (entry->refcnt == 0)
+		cache_entry_destroy(entry);
+}
+
+static hash_table_ops_t cache_ops = {
+	.hash = cache_entry_hash,
+	.key_hash = cache_key_hash,
+	.key_equal = cache_key_equal,
+	.equal = NULL,
+	.remove_callback = cache_entry_remove
+};
+
+/** Initialize file cache.
+ *
+ * @return EOK on success or ENOMEM
+ */
+errno_t cache_init(void)
+{
+	if (!hash_table_create(&cache, 0, 0, &cache_ops))
+		return ENOMEM;
+
+	return EOK;
+}
+
+/** Look up fresh cached file.
+ *
+ * @param fname File name
+ * @param rentry Place to store reference to the entry, which must be
+ *               released using cache_release()
+ * @return EOK on success, ENOENT if the file is not cached or is stale
+ */
+errno_t cache_get(const char *fname, cache_entry_t **rentry)
+{
+	struct timespec now;
+	cache_entry_t *entry;
+	ht_link_t *link;
+
+	fibril_mutex_lock(&cache_lock);
+
+	link = hash_table_find(&cache, fname);
+	if (link == NULL) {
+		fibril_mutex_unlock(&cache_lock);
+		return ENOENT;
+	}
+
+	entry = hash_table_get_inst(link, cache_entry_t, lhash);
+
+	getuptime(&now);
+	if (ts_sub_diff(&now, &entry->loaded) >= SEC2NSEC(CACHE_TTL)) {
+		hash_table_remove_item(&cache, link);
+		fibril_mutex_unlock(&cache_lock);
+		return ENOENT;
+	}
+
+	list_remove(&entry->llru);
+	list_prepend(&entry->llru, &cache_lru);
+	++entry->refcnt;
+
+	fibril_mutex_unlock(&cache_lock);
+
+	*rentry = entry;
+	return EOK;
+}
+
+/** Read file and enter it into cache.
+ *
+ * @param fname File name (cache key)
+ * @param fd    Open file
+ * @param size  File size, at most CACHE_FILE_MAX
+ * @param rentry Place to store reference to the entry, which must be
+ *               released using cache_release()
+ * @return EOK on success, ENOMEM if out of memory or an error code
+ *         from reading the file
+ */
+errno_t cache_load(const char *fname, int fd, size_t size,
+    cache_entry_t **rentry)
+{
+	cache_entry_t *entry;
+	ht_link_t *link;
+	aoff64_t pos;
+	uint64_t hash;
+	size_t nread;
+	size_t i;
+	errno_t rc;
+
+	assert(size <= CACHE_FILE_MAX);
+
+	entry = calloc(1, sizeof(cache_entry_t));
+	if (entry == NULL)
+		return ENOMEM;
+
+	entry->fname = str_dup(fname);
+	entry->data = malloc(max(size, 1));
+	if (entry->fname == NULL || entry->data == NULL) {
+		cache_entry_destroy(entry);
+		return ENOMEM;
+	}
+
+	pos = 0;
+	rc = vfs_read(fd, &pos, entry->data, size, &nread);
+	if (rc != EOK) {
+		cache_entry_destroy(entry);
+		return rc;
+	}
+
+	/* FNV-1a hash of contents and size */
+	hash = 0xcbf29ce484222325ULL;
+	for (i = 0; i < nread; i++) {
+		hash ^= entry->data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	entry->size = nread;
+	snprintf(entry->etag, CACHE_ETAG_SIZE, "\"%016" PRIx64 "\"",
+	    hash ^ nread);
+	getuptime(&entry->loaded);
+	entry->refcnt = 1;
+	entry->cached = true;
+
+	fibril_mutex_lock(&cache_lock);
+
+	/* Replace older version of the file */
+	link = hash_table_find(&cache, fname);
+	if (link != NULL)
+		hash_table_remove_item(&cache, link);
+
+	/* Make room */
+	while (cache_size + entry->size > CACHE_SIZE_MAX &&
+	    !list_empty(&cache_lru)) {
+		cache_entry_t *old = list_get_instance(list_last(&cache_lru),
+		    cache_entry_t, llru);
+		hash_table_remove_item(&cache, &old->lhash);
+	}
+
+	hash_table_insert(&cache, &entry->lhash);
+	list_prepend(&entry->llru, &cache_lru);
+	cache_size += entry->size;
+
+	fibril_mutex_unlock(&cache_lock);
+
+	*rentry = entry;
+	return EOK;
+}
+
+/** Release reference to cached file.
+ *
+ * @param entry Cache entry
+ */
+void cache_release(cache_entry_t *entry)
+{
+	fibril_mutex_lock(&cache_lock);
+
+	assert(entry->refcnt > 0);
+	if (--entry->refcnt == 0 && !entry->cached)
+		cache_entry_destroy(entry);
+
+	fibril_mutex_unlock(&cache_lock);
+}
+
+/** @}
+ */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup websrv
+ * @{
+ */
+/**
+ * @file In-memory cache of small files.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/** Files up to this size are cached */
+#define CACHE_FILE_MAX  (64 * 1024)
+
+/** Total size of cached file data */
+#define CACHE_SIZE_MAX  (4 * 1024 * 1024)
+
+/** Size of entity tag buffer (including quotes and terminator) */
+#define CACHE_ETAG_SIZE  20
+
+/** Cached file */
+typedef struct {
+	/** Link in cache hash table */
+	ht_link_t lhash;
+	/** Link in LRU list */
+	link_t llru;
+	/** File name */
+	char *fname;
+	/** File contents */
+	uint8_t *data;
+	/** File size */
+	size_t size;
+	/** Entity tag (quoted) */
+	char etag[CACHE_ETAG_SIZE];
+	/** Time when the file was read */
+	struct timespec loaded;
+	/** Number of users of the entry */
+	unsigned refcnt;
+	/** Entry is in the cache */
+	bool cached;
+} cache_entry_t;
+
+extern errno_t cache_init(void);
+extern errno_t cache_get(const char *, cache_entry_t **);
+extern errno_t cache_load(const char *, int, size_t, cache_entry_t **);
+extern void cache_release(cache_entry_t *);
+
+#endif
+
+/** @}
+ */
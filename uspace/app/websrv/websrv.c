@@ -35,6 +35,8 @@
 
 #include <errno.h>
 #include <assert.h>
+#include <fibril_synch.h>
+#include <mem.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -53,14 +55,28 @@
 #include <str.h>
 #include <str_error.h>
 
+#include "cache.h"
+
 #define NAME  "websrv"
 
 #define DEFAULT_PORT  8080
 
+/** Default maximum number of connections served at the same time */
+#define DEFAULT_WORKERS  16
+
 #define WEB_ROOT  "/data/web"
 
-/** Buffer for receiving the request. */
-#define BUFFER_SIZE  1024
+/** Buffer for receiving requests. */
+#define BUFFER_SIZE  16384
+
+/** Maximum length of request line or header line. */
+#define LINE_SIZE_MAX  4096
+
+/** Maximum number of requests served over one connection. */
+#define KEEPALIVE_MAX_REQS  1000
+
+/** Idle connection is closed after this time (usec). */
+#define KEEPALIVE_TIMEOUT  (15 * 1000 * 1000)
 
 static void websrv_new_conn(tcp_listener_t *, tcp_conn_t *);
 
@@ -73,6 +89,10 @@ static tcp_cb_t conn_cb = {
 };
 
 static uint16_t port = DEFAULT_PORT;
+static int nworkers = DEFAULT_WORKERS;
+
+/** Limits the number of connections served at the same time */
+static fibril_semaphore_t workers;
 
 typedef struct {
 	tcp_conn_t *conn;
@@ -81,21 +101,32 @@ typedef struct {
 	size_t rbuf_out;
 	size_t rbuf_in;
 
-	char lbuf[BUFFER_SIZE + 1];
+	char lbuf[LINE_SIZE_MAX + 1];
 	size_t lbuf_used;
+
+	/** Protects @c idle */
+	fibril_mutex_t lock;
+	/** Closes the connection if the client is idle for too long */
+	fibril_timer_t *idle_timer;
+	/** Waiting for the next request */
+	bool idle;
 } recv_t;
 
-static bool verbose = false;
+/** Parsed request */
+typedef struct {
+	/** HEAD request, send headers only */
+	bool head;
+	/** Keep connection open after the response */
+	bool keep_alive;
+	/** Value of If-None-Match header or empty string */
+	char if_none_match[CACHE_ETAG_SIZE];
+} req_t;
 
-/** Responses to send to client. */
+static bool verbose = false;
 
-static const char *msg_ok =
-    "HTTP/1.0 200 OK\r\n"
-    "\r\n";
+/** Bodies of error responses. */
 
 static const char *msg_bad_request =
-    "HTTP/1.0 400 Bad Request\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>400 Bad Request</title>\r\n"
@@ -107,8 +138,6 @@ static const char *msg_bad_request =
     "</html>\r\n";
 
 static const char *msg_not_found =
-    "HTTP/1.0 404 Not Found\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>404 Not Found</title>\r\n"
@@ -120,8 +149,6 @@ static const char *msg_not_found =
     "</html>\r\n";
 
 static const char *msg_not_implemented =
-    "HTTP/1.0 501 Not Implemented\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>501 Not Implemented</title>\r\n"
@@ -132,6 +159,8 @@ static const char *msg_not_implemented =
     "</body>\r\n"
     "</html>\r\n";
 
+static void recv_idle_timeout(void *);
+
 static errno_t recv_create(tcp_conn_t *conn, recv_t **rrecv)
 {
 	recv_t *recv;
@@ -145,61 +174,134 @@ static errno_t recv_create(tcp_conn_t *conn, recv_t **rrecv)
 	recv->rbuf_in = 0;
 	recv->lbuf_used = 0;
 
+	fibril_mutex_initialize(&recv->lock);
+	recv->idle_timer = fibril_timer_create(&recv->lock);
+	if (recv->idle_timer == NULL) {
+		free(recv);
+		return ENOMEM;
+	}
+
 	*rrecv = recv;
 	return EOK;
 }
 
 static void recv_destroy(recv_t *recv)
 {
+	if (recv == NULL)
+		return;
+
+	fibril_timer_clear(recv->idle_timer);
+	fibril_timer_destroy(recv->idle_timer);
 	free(recv);
 }
 
-/** Receive one character (with buffering) */
-static errno_t recv_char(recv_t *recv, char *c)
+/** Start or stop waiting for the next request on a connection.
+ *
+ * @param recv Receive structure
+ * @param idle @c true if the connection is waiting for a request
+ */
+static void recv_set_idle(recv_t *recv, bool idle)
+{
+	fibril_mutex_lock(&recv->lock);
+	recv->idle = idle;
+	if (idle) {
+		fibril_timer_set_locked(recv->idle_timer, KEEPALIVE_TIMEOUT,
+		    recv_idle_timeout, recv);
+	} else {
+		fibril_timer_clear_locked(recv->idle_timer);
+	}
+	fibril_mutex_unlock(&recv->lock);
+}
+
+/** Close connection which stayed idle for too long. */
+static void recv_idle_timeout(void *arg)
+{
+	recv_t *recv = (recv_t *) arg;
+	bool idle;
+
+	fibril_mutex_lock(&recv->lock);
+	idle = recv->idle;
+	fibril_mutex_unlock(&recv->lock);
+
+	/* Resetting the connection wakes up the receiving fibril */
+	if (idle) {
+		if (verbose)
+			fprintf(stderr, "Idle connection timed out\n");
+		tcp_conn_reset(recv->conn);
+	}
+}
+
+/** Receive more data into the (empty) receive buffer.
+ *
+ * @return EOK on success, EPIPE if the client has closed the connection
+ *         or an error code
+ */
+static errno_t recv_fill(recv_t *recv)
 {
 	size_t nrecv;
 	errno_t rc;
 
-	if (recv->rbuf_out == recv->rbuf_in) {
-		recv->rbuf_out = 0;
-		recv->rbuf_in = 0;
+	assert(recv->rbuf_out == recv->rbuf_in);
 
-		rc = tcp_conn_recv_wait(recv->conn, recv->rbuf, BUFFER_SIZE, &nrecv);
-		if (rc != EOK) {
-			fprintf(stderr, "tcp_conn_recv() failed: %s\n", str_error(rc));
-			return rc;
-		}
+	recv->rbuf_out = 0;
+	recv->rbuf_in = 0;
 
-		recv->rbuf_in = nrecv;
+	rc = tcp_conn_recv_wait(recv->conn, recv->rbuf, BUFFER_SIZE, &nrecv);
+	if (rc != EOK) {
+		fprintf(stderr, "tcp_conn_recv() failed: %s\n", str_error(rc));
+		return rc;
 	}
 
-	*c = recv->rbuf[recv->rbuf_out++];
+	if (nrecv == 0)
+		return EPIPE;
+
+	recv->rbuf_in = nrecv;
 	return EOK;
 }
 
-/** Receive one line with length limit */
+/** Receive one line with length limit.
+ *
+ * The line terminator is stripped.
+ */
 static errno_t recv_line(recv_t *recv, char **rbuf)
 {
-	char *bp = recv->lbuf;
-	char c = '\0';
+	char *start;
+	char *nl;
+	size_t avail;
+	size_t n;
+	errno_t rc;
 
-	while (bp < recv->lbuf + BUFFER_SIZE) {
-		char prev = c;
-		errno_t rc = recv_char(recv, &c);
+	recv->lbuf_used = 0;
 
-		if (rc != EOK)
-			return rc;
+	while (true) {
+		if (recv->rbuf_out == recv->rbuf_in) {
+			rc = recv_fill(recv);
+			if (rc != EOK)
+				return rc;
+		}
+
+		/* Take data up to end of line or all buffered data */
+		start = recv->rbuf + recv->rbuf_out;
+		avail = recv->rbuf_in - recv->rbuf_out;
+		nl = memchr(start, '\n', avail);
+		n = (nl != NULL) ? (size_t) (nl - start) + 1 : avail;
+
+		if (recv->lbuf_used + n > LINE_SIZE_MAX)
+			return ELIMIT;
+
+		memcpy(recv->lbuf + recv->lbuf_used, start, n);
+		recv->lbuf_used += n;
+		recv->rbuf_out += n;
 
-		*bp++ = c;
-		if ((prev == '\r') && (c == '\n'))
+		if (nl != NULL)
 			break;
 	}
 
-	recv->lbuf_used = bp - recv->lbuf;
-	*bp = '\0';
-
-	if (bp == recv->lbuf + BUFFER_SIZE)
-		return ELIMIT;
+	/* Strip CRLF (or a lone LF) */
+	n = recv->lbuf_used - 1;
+	if (n > 0 && recv->lbuf[n - 1] == '\r')
+		--n;
+	recv->lbuf[n] = '\0';
 
 	*rbuf = recv->lbuf;
 	return EOK;
@@ -224,14 +326,44 @@ static bool uri_is_valid(char *uri)
 	return true;
 }
 
-static errno_t send_response(tcp_conn_t *conn, const char *msg)
+/** Send response header.
+ *
+ * @param conn   Connection
+ * @param req    Request
+ * @param status Status code and reason phrase
+ * @param size   Size of response body or @c SIZE_MAX to omit Content-Length
+ *               (e.g. in a 304 response, RFC 7232 4.1)
+ * @param etag   Entity tag or @c NULL
+ */
+static errno_t send_header(tcp_conn_t *conn, req_t *req, const char *status,
+    size_t size, const char *etag)
 {
-	size_t response_size = str_size(msg);
+	char hdr[256];
+	char clen[48];
+	int len;
 
 	if (verbose)
 		fprintf(stderr, "Sending response\n");
 
-	errno_t rc = tcp_conn_send(conn, (void *) msg, response_size);
+	if (size != SIZE_MAX)
+		snprintf(clen, sizeof(clen), "Content-Length: %zu\r\n", size);
+	else
+		clen[0] = '\0';
+
+	len = snprintf(hdr, sizeof(hdr),
+	    "HTTP/1.1 %s\r\n"
+	    "%s"
+	    "%s%s%s"
+	    "Connection: %s\r\n"
+	    "\r\n",
+	    status, clen,
+	    etag != NULL ? "ETag: " : "",
+	    etag != NULL ? etag : "",
+	    etag != NULL ? "\r\n" : "",
+	    req->keep_alive ? "keep-alive" : "close");
+	assert(len > 0 && (size_t) len < sizeof(hdr));
+
+	errno_t rc = tcp_conn_send(conn, hdr, len);
 	if (rc != EOK) {
 		fprintf(stderr, "tcp_conn_send() failed\n");
 		return rc;
@@ -240,20 +372,78 @@ static errno_t send_response(tcp_conn_t *conn, const char *msg)
 	return EOK;
 }
 
-static errno_t uri_get(const char *uri, tcp_conn_t *conn)
+/** Send response with a static body. */
+static errno_t send_response(tcp_conn_t *conn, req_t *req,
+    const char *status, const char *msg)
+{
+	size_t size = str_size(msg);
+
+	errno_t rc = send_header(conn, req, status, size, NULL);
+	if (rc != EOK || req->head)
+		return rc;
+
+	rc = tcp_conn_send(conn, (void *) msg, size);
+	if (rc != EOK) {
+		fprintf(stderr, "tcp_conn_send() failed\n");
+		return rc;
+	}
+
+	return EOK;
+}
+
+/** Send cached file.
+ *
+ * @param conn  Connection
+ * @param req   Request
+ * @param entry Cache entry
+ */
+static errno_t send_cached(tcp_conn_t *conn, req_t *req, cache_entry_t *entry)
 {
-	char *fbuf = NULL;
-	char *fname = NULL;
 	errno_t rc;
-	size_t nr;
-	int fd = -1;
 
-	fbuf = calloc(BUFFER_SIZE, 1);
-	if (fbuf == NULL) {
-		rc = ENOMEM;
-		goto out;
+	/* Client already has this version of the file */
+	if (str_cmp(req->if_none_match, entry->etag) == 0)
+		return send_header(conn, req, "304 Not Modified", SIZE_MAX,
+		    entry->etag);
+
+	rc = send_header(conn, req, "200 OK", entry->size, entry->etag);
+	if (rc != EOK || req->head || entry->size == 0)
+		return rc;
+
+	rc = tcp_conn_send(conn, entry->data, entry->size);
+	if (rc != EOK) {
+		fprintf(stderr, "tcp_conn_send() failed\n");
+		return rc;
 	}
 
+	return EOK;
+}
+
+/** File being sent */
+typedef struct {
+	int fd;
+	aoff64_t pos;
+} file_send_t;
+
+/** Read file data directly into the connection send buffer. */
+static errno_t file_send_fill(void *arg, void *buf, size_t size,
+    size_t *nread)
+{
+	file_send_t *fsend = (file_send_t *) arg;
+
+	return vfs_read(fsend->fd, &fsend->pos, buf, size, nread);
+}
+
+static errno_t uri_get(const char *uri, tcp_conn_t *conn, req_t *req)
+{
+	cache_entry_t *entry;
+	char *fname = NULL;
+	file_send_t fsend;
+	vfs_stat_t stat;
+	size_t nsent;
+	errno_t rc;
+	int fd = -1;
+
 	if (str_cmp(uri, "/") == 0)
 		uri = "/index.html";
 
@@ -262,79 +452,199 @@ static errno_t uri_get(const char *uri, tcp_conn_t *conn)
 		goto out;
 	}
 
+	rc = cache_get(fname, &entry);
+	if (rc == EOK) {
+		rc = send_cached(conn, req, entry);
+		cache_release(entry);
+		goto out;
+	}
+
 	rc = vfs_lookup_open(fname, WALK_REGULAR, MODE_READ, &fd);
 	if (rc != EOK) {
-		rc = send_response(conn, msg_not_found);
+		rc = send_response(conn, req, "404 Not Found", msg_not_found);
 		goto out;
 	}
 
-	free(fname);
-	fname = NULL;
-
-	rc = send_response(conn, msg_ok);
+	rc = vfs_stat(fd, &stat);
 	if (rc != EOK)
 		goto out;
 
-	aoff64_t pos = 0;
-	while (true) {
-		rc = vfs_read(fd, &pos, fbuf, BUFFER_SIZE, &nr);
+	if (stat.size <= CACHE_FILE_MAX) {
+		/* Small file, keep it in memory for next time */
+		rc = cache_load(fname, fd, stat.size, &entry);
 		if (rc != EOK)
 			goto out;
 
-		if (nr == 0)
-			break;
+		rc = send_cached(conn, req, entry);
+		cache_release(entry);
+		goto out;
+	}
 
-		rc = tcp_conn_send(conn, fbuf, nr);
-		if (rc != EOK) {
-			fprintf(stderr, "tcp_conn_send() failed\n");
-			goto out;
-		}
+	if (stat.size > SIZE_MAX) {
+		rc = EFBIG;
+		goto out;
 	}
 
-	rc = EOK;
+	rc = send_header(conn, req, "200 OK", stat.size, NULL);
+	if (rc != EOK || req->head)
+		goto out;
+
+	/* Move file data to the TCP service without an intermediate buffer */
+	fsend.fd = fd;
+	fsend.pos = 0;
+	rc = tcp_conn_send_fill(conn, file_send_fill, &fsend, stat.size,
+	    &nsent);
+	if (rc != EOK) {
+		fprintf(stderr, "Error sending file (%s)\n", str_error(rc));
+		goto out;
+	}
+
+	/* File shrank, we cannot deliver promised Content-Length */
+	if (nsent != stat.size)
+		rc = EIO;
 out:
 	if (fd >= 0)
 		vfs_put(fd);
 	free(fname);
-	free(fbuf);
 	return rc;
 }
 
-static errno_t req_process(tcp_conn_t *conn, recv_t *recv)
+/** Receive request headers.
+ *
+ * @param recv Receive structure
+ * @param req  Request to update with information from headers
+ */
+static errno_t req_headers(recv_t *recv, req_t *req)
+{
+	char *line;
+	char *value;
+	errno_t rc;
+
+	while (true) {
+		rc = recv_line(recv, &line);
+		if (rc != EOK)
+			return rc;
+
+		/* Empty line terminates headers */
+		if (*line == '\0')
+			break;
+
+		value = str_chr(line, ':');
+		if (value == NULL)
+			continue;
+
+		*value++ = '\0';
+		while (*value == ' ' || *value == '\t')
+			++value;
+
+		if (verbose)
+			fprintf(stderr, "Header: %s: %s\n", line, value);
+
+		if (str_casecmp(line, "Connection") == 0) {
+			if (str_casecmp(value, "close") == 0)
+				req->keep_alive = false;
+			else if (str_casecmp(value, "keep-alive") == 0)
+				req->keep_alive = true;
+		} else if (str_casecmp(line, "If-None-Match") == 0) {
+			str_cpy(req->if_none_match, CACHE_ETAG_SIZE, value);
+		}
+	}
+
+	return EOK;
+}
+
+/** Receive and process one request.
+ *
+ * @param conn       Connection
+ * @param recv       Receive structure
+ * @param last       This is the last request served over the connection
+ * @param keep_alive Place to store @c true if the connection stays open
+ */
+static errno_t req_process(tcp_conn_t *conn, recv_t *recv, bool last,
+    bool *keep_alive)
 {
 	char *reqline = NULL;
+	char *uri;
+	char *version;
+	bool implemented;
+	req_t req;
+
+	*keep_alive = false;
 
 	errno_t rc = recv_line(recv, &reqline);
 	if (rc != EOK) {
-		fprintf(stderr, "recv_line() failed\n");
+		if (rc != EPIPE)
+			fprintf(stderr, "recv_line() failed\n");
 		return rc;
 	}
 
+	recv_set_idle(recv, false);
+
 	if (verbose)
-		fprintf(stderr, "Request: %s", reqline);
+		fprintf(stderr, "Request: %s\n", reqline);
+
+	memset(&req, 0, sizeof(req));
+
+	implemented = true;
+	if (str_lcmp(reqline, "GET ", 4) == 0) {
+		uri = reqline + 4;
+	} else if (str_lcmp(reqline, "HEAD ", 5) == 0) {
+		uri = reqline + 5;
+		req.head = true;
+	} else {
+		uri = reqline;
+		implemented = false;
+	}
 
-	if (str_lcmp(reqline, "GET ", 4) != 0) {
-		rc = send_response(conn, msg_not_implemented);
-		return rc;
+	/* HTTP/1.1 connections are persistent by default */
+	version = str_chr(uri, ' ');
+	if (version != NULL) {
+		*version++ = '\0';
+		req.keep_alive = str_cmp(version, "HTTP/1.1") == 0;
 	}
 
-	char *uri = reqline + 4;
-	char *end_uri = str_chr(uri, ' ');
-	if (end_uri == NULL) {
-		end_uri = reqline + str_size(reqline) - 2;
-		assert(*end_uri == '\r');
+	/* The request line is overwritten by the headers */
+	uri = str_dup(uri);
+	if (uri == NULL)
+		return ENOMEM;
+
+	/* An HTTP/0.9 request has no headers */
+	if (version != NULL) {
+		rc = req_headers(recv, &req);
+		if (rc != EOK) {
+			free(uri);
+			return rc;
+		}
+	}
+
+	if (last)
+		req.keep_alive = false;
+
+	if (!implemented) {
+		req.keep_alive = false;
+		rc = send_response(conn, &req, "501 Not Implemented",
+		    msg_not_implemented);
+		free(uri);
+		return rc;
 	}
 
-	*end_uri = '\0';
 	if (verbose)
 		fprintf(stderr, "Requested URI: %s\n", uri);
 
 	if (!uri_is_valid(uri)) {
-		rc = send_response(conn, msg_bad_request);
+		rc = send_response(conn, &req, "400 Bad Request",
+		    msg_bad_request);
+		free(uri);
 		return rc;
 	}
 
-	return uri_get(uri, conn);
+	rc = uri_get(uri, conn, &req);
+	free(uri);
+	if (rc != EOK)
+		return rc;
+
+	*keep_alive = req.keep_alive;
+	return EOK;
 }
 
 static void usage(void)
@@ -347,6 +657,10 @@ static void usage(void)
 	    "-p port_number | --port=port_number\n"
 	    "\tListening port (default " STRING(DEFAULT_PORT) ").\n"
 	    "\n"
+	    "-w count | --workers=count\n"
+	    "\tMaximum number of connections served at the same time\n"
+	    "\t(default " STRING(DEFAULT_WORKERS) ").\n"
+	    "\n"
 	    "-h | --help\n"
 	    "\tShow this application help.\n"
 	    "-v | --verbose\n"
@@ -373,6 +687,13 @@ static errno_t parse_option(int argc, char *argv[], int *index)
 	case 'v':
 		verbose = true;
 		break;
+	case 'w':
+		rc = arg_parse_int(argc, argv, index, &value, 0);
+		if (rc != EOK || value < 1)
+			return EINVAL;
+
+		nworkers = value;
+		break;
 	case '-':
 		/* Long options with double dash */
 		if (str_lcmp(argv[*index] + 2, "help", 5) == 0) {
@@ -384,6 +705,12 @@ static errno_t parse_option(int argc, char *argv[], int *index)
 				return rc;
 
 			port = (uint16_t) value;
+		} else if (str_lcmp(argv[*index] + 2, "workers=", 8) == 0) {
+			rc = arg_parse_int(argc, argv, index, &value, 10);
+			if (rc != EOK || value < 1)
+				return EINVAL;
+
+			nworkers = value;
 		} else if (str_cmp(argv[*index] + 2, "verbose") == 0) {
 			verbose = true;
 		} else {
@@ -403,6 +730,11 @@ static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 {
 	errno_t rc;
 	recv_t *recv = NULL;
+	bool keep_alive;
+	int nreqs;
+
+	/* Wait for a free worker */
+	fibril_semaphore_down(&workers);
 
 	if (verbose)
 		fprintf(stderr, "New connection, waiting for request\n");
@@ -413,12 +745,28 @@ static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 		goto error;
 	}
 
-	rc = req_process(conn, recv);
-	if (rc != EOK) {
-		fprintf(stderr, "Error processing request (%s)\n",
-		    str_error(rc));
-		goto error;
-	}
+	/*
+	 * Serve requests until the client asks to close the connection.
+	 * Pipelined requests are already waiting in the receive buffer.
+	 */
+	nreqs = 0;
+	do {
+		recv_set_idle(recv, true);
+		rc = req_process(conn, recv, nreqs + 1 >= KEEPALIVE_MAX_REQS,
+		    &keep_alive);
+		if (rc == EPIPE && nreqs > 0) {
+			/* Client closed the connection between requests */
+			break;
+		}
+
+		if (rc != EOK) {
+			fprintf(stderr, "Error processing request (%s)\n",
+			    str_error(rc));
+			goto error;
+		}
+	} while (keep_alive && ++nreqs < KEEPALIVE_MAX_REQS);
+
+	recv_set_idle(recv, false);
 
 	rc = tcp_conn_send_fin(conn);
 	if (rc != EOK) {
@@ -427,13 +775,18 @@ static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 	}
 
 	recv_destroy(recv);
+	fibril_semaphore_up(&workers);
 	return;
 error:
+	if (recv != NULL)
+		recv_set_idle(recv, false);
+
 	rc = tcp_conn_reset(conn);
 	if (rc != EOK)
 		fprintf(stderr, "Error resetting connection.\n");
 
 	recv_destroy(recv);
+	fibril_semaphore_up(&workers);
 }
 
 int main(int argc, char *argv[])
@@ -457,6 +810,14 @@ int main(int argc, char *argv[])
 
 	printf("%s: HelenOS web server\n", NAME);
 
+	fibril_semaphore_initialize(&workers, nworkers);
+
+	rc = cache_init();
+	if (rc != EOK) {
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+
 	if (verbose)
 		fprintf(stderr, "Creating listener\n");
 
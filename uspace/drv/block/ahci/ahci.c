@@ -31,6 +31,7 @@
  */
 
 #include <as.h>
+#include <macros.h>
 #include <errno.h>
 #include <stdio.h>
 #include <ddf/interrupt.h>
@@ -113,11 +114,14 @@ static errno_t get_num_blocks(ddf_fun_t *, uint64_t *);
 static errno_t get_block_size(ddf_fun_t *, size_t *);
 static errno_t read_blocks(ddf_fun_t *, uint64_t, size_t, void *);
 static errno_t write_blocks(ddf_fun_t *, uint64_t, size_t, void *);
+static errno_t get_queue_depth(ddf_fun_t *, size_t *);
 
 static errno_t ahci_identify_device(sata_dev_t *);
 static errno_t ahci_set_highest_ultra_dma_mode(sata_dev_t *);
-static errno_t ahci_rb_fpdma(sata_dev_t *, uintptr_t, uint64_t);
-static errno_t ahci_wb_fpdma(sata_dev_t *, uintptr_t, uint64_t);
+static unsigned int ahci_slot_get(sata_dev_t *);
+static void ahci_slot_put(sata_dev_t *, unsigned int);
+static errno_t ahci_rw_fpdma(sata_dev_t *, unsigned int, bool, uint64_t,
+    size_t);
 
 static void ahci_sata_devices_create(ahci_dev_t *, ddf_dev_t *);
 static ahci_dev_t *ahci_ahci_create(ddf_dev_t *);
@@ -139,7 +143,8 @@ static ahci_iface_t ahci_interface = {
 	.get_num_blocks = &get_num_blocks,
 	.get_block_size = &get_block_size,
 	.read_blocks = &read_blocks,
-	.write_blocks = &write_blocks
+	.write_blocks = &write_blocks,
+	.get_queue_depth = &get_queue_depth
 };
 
 static ddf_dev_ops_t ahci_ops = {
@@ -215,6 +220,9 @@ static errno_t get_block_size(ddf_fun_t *fun, size_t *block_size)
 }
 
 /** Read data blocks into SATA device.
+ *
+ * Several requests may be executed concurrently, each one occupying
+ * an NCQ command slot while its commands are outstanding.
  *
  * @param fun      Device function handling the call.
  * @param blocknum Number of first block.
@@ -228,32 +236,24 @@ static errno_t read_blocks(ddf_fun_t *fun, uint64_t blocknum,
     size_t count, void *buf)
 {
 	sata_dev_t *sata = fun_sata_dev(fun);
+	size_t max_cnt = AHCI_SLOT_BUF_SIZE / sata->block_size;
+	errno_t rc = EOK;
 
-	uintptr_t phys;
-	void *ibuf = AS_AREA_ANY;
-	errno_t rc = dmamem_map_anonymous(sata->block_size, DMAMEM_4GiB,
-	    AS_AREA_READ | AS_AREA_WRITE, 0, &phys, &ibuf);
-	if (rc != EOK) {
-		ddf_msg(LVL_ERROR, "Cannot allocate read buffer.");
-		return rc;
-	}
-
-	memset(buf, 0, sata->block_size);
+	unsigned int slot = ahci_slot_get(sata);
+	uint8_t *ibuf = sata->slot_buf + slot * AHCI_SLOT_BUF_SIZE;
 
-	fibril_mutex_lock(&sata->lock);
+	for (size_t cur = 0; cur < count; cur += max_cnt) {
+		size_t cnt = min(max_cnt, count - cur);
 
-	for (size_t cur = 0; cur < count; cur++) {
-		rc = ahci_rb_fpdma(sata, phys, blocknum + cur);
+		rc = ahci_rw_fpdma(sata, slot, false, blocknum + cur, cnt);
 		if (rc != EOK)
 			break;
 
 		memcpy((void *) (((uint8_t *) buf) + (sata->block_size * cur)),
-		    ibuf, sata->block_size);
+		    ibuf, sata->block_size * cnt);
 	}
 
-	fibril_mutex_unlock(&sata->lock);
-	dmamem_unmap_anonymous(ibuf);
-
+	ahci_slot_put(sata, slot);
 	return rc;
 }
 
@@ -271,32 +271,43 @@ static errno_t write_blocks(ddf_fun_t *fun, uint64_t blocknum,
     size_t count, void *buf)
 {
 	sata_dev_t *sata = fun_sata_dev(fun);
+	size_t max_cnt = AHCI_SLOT_BUF_SIZE / sata->block_size;
+	errno_t rc = EOK;
 
-	uintptr_t phys;
-	void *ibuf = AS_AREA_ANY;
-	errno_t rc = dmamem_map_anonymous(sata->block_size, DMAMEM_4GiB,
-	    AS_AREA_READ | AS_AREA_WRITE, 0, &phys, &ibuf);
-	if (rc != EOK) {
-		ddf_msg(LVL_ERROR, "Cannot allocate write buffer.");
-		return rc;
-	}
+	unsigned int slot = ahci_slot_get(sata);
+	uint8_t *ibuf = sata->slot_buf + slot * AHCI_SLOT_BUF_SIZE;
 
-	fibril_mutex_lock(&sata->lock);
+	for (size_t cur = 0; cur < count; cur += max_cnt) {
+		size_t cnt = min(max_cnt, count - cur);
+
+		memcpy(ibuf,
+		    (void *) (((uint8_t *) buf) + (sata->block_size * cur)),
+		    sata->block_size * cnt);
 
-	for (size_t cur = 0; cur < count; cur++) {
-		memcpy(ibuf, (void *) (((uint8_t *) buf) + (sata->block_size * cur)),
-		    sata->block_size);
-		rc = ahci_wb_fpdma(sata, phys, blocknum + cur);
+		rc = ahci_rw_fpdma(sata, slot, true, blocknum + cur, cnt);
 		if (rc != EOK)
 			break;
 	}
 
-	fibril_mutex_unlock(&sata->lock);
-	dmamem_unmap_anonymous(ibuf);
-
+	ahci_slot_put(sata, slot);
 	return rc;
 }
 
+/** Get number of requests the SATA device can execute concurrently.
+ *
+ * @param fun    Device function handling the call.
+ * @param qdepth Return number of NCQ command slots.
+ *
+ * @return EOK.
+ *
+ */
+static errno_t get_queue_depth(ddf_fun_t *fun, size_t *qdepth)
+{
+	sata_dev_t *sata = fun_sata_dev(fun);
+	*qdepth = sata->ncq_slots;
+	return EOK;
+}
+
 /*----------------------------------------------------------------------------*/
 /*-- AHCI Commands -----------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
@@ -469,6 +480,15 @@ static errno_t ahci_identify_device(sata_dev_t *sata)
 
 	ahci_get_model_name(idata->model_name, sata->model);
 
+	/*
+	 * Use as many NCQ command slots as both the HBA and
+	 * the device support.
+	 */
+	ahci_ghc_cap_t cap;
+	cap.u32 = sata->ahci->memregs->ghc.cap;
+	sata->ncq_slots = min((unsigned int) cap.ncs + 1,
+	    (unsigned int) (idata->queue_depth & 0x1f) + 1);
+
 	/*
 	 * Due to QEMU limitation (as of 2012-06-22),
 	 * only NCQ FPDMA mode is supported.
@@ -668,110 +688,75 @@ error:
 	return EINTR;
 }
 
-/** Set AHCI registers for reading one sector from the SATA device using FPDMA.
+/** Allocate a free NCQ command slot, waiting for one if necessary.
  *
- * @param sata     SATA device structure.
- * @param phys     Physical address of buffer for sector data.
- * @param blocknum Block number to read.
+ * @param sata SATA device structure.
+ *
+ * @return Number of the allocated slot.
  *
  */
-static void ahci_rb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
-    uint64_t blocknum)
+static unsigned int ahci_slot_get(sata_dev_t *sata)
 {
-	volatile sata_ncq_command_frame_t *cmd =
-	    (sata_ncq_command_frame_t *) sata->cmd_table;
-
-	cmd->fis_type = SATA_CMD_FIS_TYPE;
-	cmd->c = SATA_CMD_FIS_COMMAND_INDICATOR;
-	cmd->command = 0x60;
-	cmd->tag = 0;
-	cmd->control = 0;
-
-	cmd->reserved1 = 0;
-	cmd->reserved2 = 0;
-	cmd->reserved3 = 0;
-	cmd->reserved4 = 0;
-	cmd->reserved5 = 0;
-	cmd->reserved6 = 0;
+	uint32_t all = (sata->ncq_slots == 32) ? 0xffffffff :
+	    (((uint32_t) 1 << sata->ncq_slots) - 1);
 
-	cmd->sector_count_low = 1;
-	cmd->sector_count_high = 0;
+	fibril_mutex_lock(&sata->event_lock);
 
-	cmd->lba0 = blocknum & 0xff;
-	cmd->lba1 = (blocknum >> 8) & 0xff;
-	cmd->lba2 = (blocknum >> 16) & 0xff;
-	cmd->lba3 = (blocknum >> 24) & 0xff;
-	cmd->lba4 = (blocknum >> 32) & 0xff;
-	cmd->lba5 = (blocknum >> 40) & 0xff;
+	while ((sata->slot_busy & all) == all)
+		fibril_condvar_wait(&sata->slot_condvar, &sata->event_lock);
 
-	volatile ahci_cmd_prdt_t *prdt =
-	    (ahci_cmd_prdt_t *) (&sata->cmd_table[0x20]);
+	unsigned int slot = 0;
+	while ((sata->slot_busy & ((uint32_t) 1 << slot)) != 0)
+		slot++;
 
-	prdt->data_address_low = LO(phys);
-	prdt->data_address_upper = HI(phys);
-	prdt->reserved1 = 0;
-	prdt->dbc = sata->block_size - 1;
-	prdt->reserved2 = 0;
-	prdt->ioc = 0;
+	sata->slot_busy |= (uint32_t) 1 << slot;
 
-	sata->cmd_header->prdtl = 1;
-	sata->cmd_header->flags =
-	    AHCI_CMDHDR_FLAGS_CLEAR_BUSY_UPON_OK |
-	    AHCI_CMDHDR_FLAGS_5DWCMD;
-	sata->cmd_header->bytesprocessed = 0;
+	fibril_mutex_unlock(&sata->event_lock);
 
-	sata->port->pxsact |= 1;
-	sata->port->pxci |= 1;
+	return slot;
 }
 
-/** Read one sector from the SATA device using FPDMA.
+/** Release an NCQ command slot.
  *
- * @param sata     SATA device structure.
- * @param phys     Physical address of buffer for sector data.
- * @param blocknum Block number to read.
- *
- * @return EOK if succeed, error code otherwise
+ * @param sata SATA device structure.
+ * @param slot Slot allocated by ahci_slot_get().
  *
  */
-static errno_t ahci_rb_fpdma(sata_dev_t *sata, uintptr_t phys, uint64_t blocknum)
+static void ahci_slot_put(sata_dev_t *sata, unsigned int slot)
 {
-	if (sata->is_invalid_device) {
-		ddf_msg(LVL_ERROR,
-		    "%s: FPDMA read from invalid device", sata->model);
-		return EINTR;
-	}
-
-	ahci_rb_fpdma_cmd(sata, phys, blocknum);
-	ahci_port_is_t pxis = ahci_wait_event(sata);
-
-	if ((sata->is_invalid_device) || (ahci_port_is_error(pxis))) {
-		ddf_msg(LVL_ERROR,
-		    "%s: Unrecoverable error during FPDMA read", sata->model);
-		return EINTR;
-	}
-
-	return EOK;
+	fibril_mutex_lock(&sata->event_lock);
+	sata->slot_busy &= ~((uint32_t) 1 << slot);
+	fibril_condvar_signal(&sata->slot_condvar);
+	fibril_mutex_unlock(&sata->event_lock);
 }
 
-/** Set AHCI registers for writing one sector to the SATA device, use FPDMA.
+/** Set AHCI registers for an FPDMA transfer in an NCQ command slot.
  *
- * @param sata     SATA device structure.
- * @param phys     Physical address of buffer with sector data.
- * @param blocknum Block number to write.
+ * Called with the event lock held, so that the interrupt handler sees
+ * the slot as issued no later than the hardware does.
  *
- * @return EOK if succeed, error code otherwise
+ * @param sata     SATA device structure.
+ * @param slot     NCQ command slot, also used as the NCQ tag.
+ * @param write    Write to the device instead of reading from it.
+ * @param blocknum Number of the first block.
+ * @param count    Number of blocks to transfer.
  *
  */
-static void ahci_wb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
-    uint64_t blocknum)
+static void ahci_rw_fpdma_cmd(sata_dev_t *sata, unsigned int slot,
+    bool write, uint64_t blocknum, size_t count)
 {
+	volatile uint32_t *table = (volatile uint32_t *)
+	    (((uint8_t *) sata->cmd_table) + slot * AHCI_CMD_TABLE_SIZE);
+	volatile ahci_cmdhdr_t *header = sata->cmd_header + slot;
+	uintptr_t phys = sata->slot_buf_phys + slot * AHCI_SLOT_BUF_SIZE;
+
 	volatile sata_ncq_command_frame_t *cmd =
-	    (sata_ncq_command_frame_t *) sata->cmd_table;
+	    (sata_ncq_command_frame_t *) table;
 
 	cmd->fis_type = SATA_CMD_FIS_TYPE;
 	cmd->c = SATA_CMD_FIS_COMMAND_INDICATOR;
-	cmd->command = 0x61;
-	cmd->tag = 0;
+	cmd->command = write ? 0x61 : 0x60;
+	cmd->tag = slot << 3;
 	cmd->control = 0;
 
 	cmd->reserved1 = 0;
@@ -781,8 +766,8 @@ static void ahci_wb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
 	cmd->reserved5 = 0;
 	cmd->reserved6 = 0;
 
-	cmd->sector_count_low = 1;
-	cmd->sector_count_high = 0;
+	cmd->sector_count_low = count & 0xff;
+	cmd->sector_count_high = (count >> 8) & 0xff;
 
 	cmd->lba0 = blocknum & 0xff;
 	cmd->lba1 = (blocknum >> 8) & 0xff;
@@ -792,49 +777,68 @@ static void ahci_wb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
 	cmd->lba5 = (blocknum >> 40) & 0xff;
 
 	volatile ahci_cmd_prdt_t *prdt =
-	    (ahci_cmd_prdt_t *) (&sata->cmd_table[0x20]);
+	    (ahci_cmd_prdt_t *) (&table[0x20]);
 
 	prdt->data_address_low = LO(phys);
 	prdt->data_address_upper = HI(phys);
 	prdt->reserved1 = 0;
-	prdt->dbc = sata->block_size - 1;
+	prdt->dbc = sata->block_size * count - 1;
 	prdt->reserved2 = 0;
 	prdt->ioc = 0;
 
-	sata->cmd_header->prdtl = 1;
-	sata->cmd_header->flags =
+	header->prdtl = 1;
+	header->flags =
 	    AHCI_CMDHDR_FLAGS_CLEAR_BUSY_UPON_OK |
-	    AHCI_CMDHDR_FLAGS_WRITE |
+	    (write ? AHCI_CMDHDR_FLAGS_WRITE : 0) |
 	    AHCI_CMDHDR_FLAGS_5DWCMD;
-	sata->cmd_header->bytesprocessed = 0;
+	header->bytesprocessed = 0;
 
-	sata->port->pxsact |= 1;
-	sata->port->pxci |= 1;
+	sata->slot_issued |= (uint32_t) 1 << slot;
+
+	/* Writing zero bits to PxSACT and PxCI has no effect. */
+	sata->port->pxsact = (uint32_t) 1 << slot;
+	sata->port->pxci = (uint32_t) 1 << slot;
 }
 
-/** Write one sector into the SATA device, use FPDMA.
+/** Transfer blocks between the SATA device and a slot buffer using FPDMA.
  *
  * @param sata     SATA device structure.
- * @param phys     Physical address of buffer with sector data.
- * @param blocknum Block number to write.
+ * @param slot     NCQ command slot allocated by ahci_slot_get().
+ * @param write    Write to the device instead of reading from it.
+ * @param blocknum Number of the first block.
+ * @param count    Number of blocks to transfer, at most
+ *                 AHCI_SLOT_BUF_SIZE / block_size.
  *
  * @return EOK if succeed, error code otherwise
  *
  */
-static errno_t ahci_wb_fpdma(sata_dev_t *sata, uintptr_t phys, uint64_t blocknum)
+static errno_t ahci_rw_fpdma(sata_dev_t *sata, unsigned int slot,
+    bool write, uint64_t blocknum, size_t count)
 {
+	uint32_t mask = (uint32_t) 1 << slot;
+
+	fibril_mutex_lock(&sata->event_lock);
+
 	if (sata->is_invalid_device) {
-		ddf_msg(LVL_ERROR,
-		    "%s: FPDMA write to invalid device", sata->model);
+		fibril_mutex_unlock(&sata->event_lock);
+		ddf_msg(LVL_ERROR, "%s: FPDMA %s invalid device", sata->model,
+		    write ? "write to" : "read from");
 		return EINTR;
 	}
 
-	ahci_wb_fpdma_cmd(sata, phys, blocknum);
-	ahci_port_is_t pxis = ahci_wait_event(sata);
+	ahci_rw_fpdma_cmd(sata, slot, write, blocknum, count);
 
-	if ((sata->is_invalid_device) || (ahci_port_is_error(pxis))) {
-		ddf_msg(LVL_ERROR,
-		    "%s: Unrecoverable error during FPDMA write", sata->model);
+	while ((sata->slot_issued & mask) != 0)
+		fibril_condvar_wait(&sata->event_condvar, &sata->event_lock);
+
+	bool failed = (sata->slot_failed & mask) != 0;
+	sata->slot_failed &= ~mask;
+
+	fibril_mutex_unlock(&sata->event_lock);
+
+	if ((sata->is_invalid_device) || (failed)) {
+		ddf_msg(LVL_ERROR, "%s: Unrecoverable error during FPDMA %s",
+		    sata->model, write ? "write" : "read");
 		return EINTR;
 	}
 
@@ -912,7 +916,22 @@ static void ahci_interrupt(ipc_call_t *icall, ddf_dev_t *dev)
 		fibril_mutex_lock(&sata->event_lock);
 
 		sata->event_pxis = pxis;
-		fibril_condvar_signal(&sata->event_condvar);
+
+		/*
+		 * NCQ commands complete by clearing their bit in PxSACT,
+		 * possibly several of them per interrupt. An error aborts
+		 * all outstanding commands.
+		 */
+		uint32_t done = sata->slot_issued & ~sata->port->pxsact;
+		if (ahci_port_is_error(pxis)) {
+			done = sata->slot_issued;
+			sata->slot_failed |= done;
+			if (ahci_port_is_permanent_error(pxis))
+				sata->is_invalid_device = true;
+		}
+
+		sata->slot_issued &= ~done;
+		fibril_condvar_broadcast(&sata->event_condvar);
 
 		fibril_mutex_unlock(&sata->event_lock);
 	}
@@ -932,10 +951,13 @@ static void ahci_interrupt(ipc_call_t *icall, ddf_dev_t *dev)
 static sata_dev_t *ahci_sata_allocate(ahci_dev_t *ahci, volatile ahci_port_t *port)
 {
 	size_t size = 4096;
+	size_t table_size = AHCI_NCQ_SLOTS * AHCI_CMD_TABLE_SIZE;
+	size_t buf_size = AHCI_NCQ_SLOTS * AHCI_SLOT_BUF_SIZE;
 	uintptr_t phys = 0;
 	void *virt_fb = AS_AREA_ANY;
 	void *virt_cmd = AS_AREA_ANY;
 	void *virt_table = AS_AREA_ANY;
+	void *virt_buf = AS_AREA_ANY;
 	ddf_fun_t *fun;
 
 	fun = ddf_fun_create(ahci->dev, fun_exposed, NULL);
@@ -968,19 +990,32 @@ static sata_dev_t *ahci_sata_allocate(ahci_dev_t *ahci, volatile ahci_port_t *po
 	sata->port->pxclb = LO(phys);
 	sata->cmd_header = (ahci_cmdhdr_t *) virt_cmd;
 
-	/* Allocate and init command table structure. */
-	rc = dmamem_map_anonymous(size, DMAMEM_4GiB,
+	/* Allocate and init command table structures, one per slot. */
+	rc = dmamem_map_anonymous(table_size, DMAMEM_4GiB,
 	    AS_AREA_READ | AS_AREA_WRITE, 0, &phys, &virt_table);
 	if (rc != EOK)
 		goto error_table;
 
-	memset(virt_table, 0, size);
-	sata->cmd_header->cmdtableu = HI(phys);
-	sata->cmd_header->cmdtable = LO(phys);
+	memset(virt_table, 0, table_size);
+	for (unsigned int slot = 0; slot < AHCI_NCQ_SLOTS; slot++) {
+		uintptr_t slot_phys = phys + slot * AHCI_CMD_TABLE_SIZE;
+		sata->cmd_header[slot].cmdtableu = HI(slot_phys);
+		sata->cmd_header[slot].cmdtable = LO(slot_phys);
+	}
 	sata->cmd_table = (uint32_t *) virt_table;
 
+	/* Allocate DMA buffers of NCQ command slots. */
+	rc = dmamem_map_anonymous(buf_size, DMAMEM_4GiB,
+	    AS_AREA_READ | AS_AREA_WRITE, 0, &sata->slot_buf_phys, &virt_buf);
+	if (rc != EOK)
+		goto error_buf;
+
+	sata->slot_buf = (uint8_t *) virt_buf;
+
 	return sata;
 
+error_buf:
+	dmamem_unmap(virt_table, table_size);
 error_table:
 	dmamem_unmap(virt_cmd, size);
 error_cmd:
@@ -1056,6 +1091,7 @@ static errno_t ahci_sata_create(ahci_dev_t *ahci, ddf_dev_t *dev,
 	fibril_mutex_initialize(&sata->lock);
 	fibril_mutex_initialize(&sata->event_lock);
 	fibril_condvar_initialize(&sata->event_condvar);
+	fibril_condvar_initialize(&sata->slot_condvar);
 
 	ahci_sata_hw_start(sata);
 
@@ -40,6 +40,15 @@
 #include <stdint.h>
 #include "ahci_hw.h"
 
+/** Maximum number of NCQ commands outstanding on a port. */
+#define AHCI_NCQ_SLOTS  32
+
+/** Size of a command table with a single PRD entry (128 B aligned). */
+#define AHCI_CMD_TABLE_SIZE  256
+
+/** Size of the DMA buffer of one NCQ command slot. */
+#define AHCI_SLOT_BUF_SIZE  4096
+
 /** AHCI Device. */
 typedef struct {
 	/** Pointer to ddf device. */
@@ -90,6 +99,27 @@ typedef struct {
 	/** Event interrupt state. */
 	ahci_port_is_t event_pxis;
 
+	/** Number of usable NCQ command slots. */
+	unsigned int ncq_slots;
+
+	/** NCQ command slots allocated to a request (protected by event_lock). */
+	uint32_t slot_busy;
+
+	/** NCQ command slots with a command outstanding. */
+	uint32_t slot_issued;
+
+	/** NCQ command slots whose command completed with an error. */
+	uint32_t slot_failed;
+
+	/** Signalled when an NCQ command slot is released. */
+	fibril_condvar_t slot_condvar;
+
+	/** Physical address of the NCQ slot DMA buffers. */
+	uintptr_t slot_buf_phys;
+
+	/** NCQ slot DMA buffers, AHCI_SLOT_BUF_SIZE bytes per slot. */
+	uint8_t *slot_buf;
+
 	/** Number of device data blocks. */
 	uint64_t blocks;
 
@@ -37,6 +37,8 @@
 #include <ddf/log.h>
 #include <pci_dev_iface.h>
 #include <fibril_synch.h>
+#include <macros.h>
+#include <barrier.h>
 
 #include <bd_srv.h>
 
@@ -44,23 +46,26 @@
 
 #define NAME	"virtio-blk"
 
-#define VIRTIO_BLK_NUM_QUEUES	1
-
-#define RQ_QUEUE	0
-
 /*
  * VIRTIO_BLK requests need at least two descriptors so that device-read-only
- * buffers are separated from device-writable buffers. For convenience, we
- * always use three descriptors for the request header, buffer and footer.
- * We therefore organize the virtque so that first RQ_BUFFERS descriptors are
- * used for request headers, the following RQ_BUFFERS descriptors are used
- * for in/out buffers and the last RQ_BUFFERS descriptors are used for request
- * footers.
+ * buffers are separated from device-writable buffers. Without indirect
+ * descriptors, we always use three descriptors for the request header,
+ * buffer and footer. We therefore organize the virtque so that first
+ * RQ_BUFFERS descriptors are used for request headers, the following
+ * RQ_BUFFERS descriptors are used for in/out buffers and the last RQ_BUFFERS
+ * descriptors are used for request footers.
+ *
+ * With indirect descriptors, each request occupies just one descriptor in
+ * the virtqueue, which points to the request's table holding the header,
+ * up to RQ_SEGS data segments and the footer.
  */
 #define REQ_HEADER_DESC(descno)	(0 * RQ_BUFFERS + (descno))
 #define REQ_BUFFER_DESC(descno)	(1 * RQ_BUFFERS + (descno))
 #define REQ_FOOTER_DESC(descno)	(2 * RQ_BUFFERS + (descno))
 
+/** Maximum number of requests submitted by one transfer before waiting */
+#define RQ_BATCH	(RQ_BUFFERS / 4)
+
 static errno_t virtio_blk_dev_add(ddf_dev_t *dev);
 
 static driver_ops_t virtio_blk_driver_ops = {
@@ -80,11 +85,18 @@ static void virtio_blk_irq_handler(ipc_call_t *icall, ddf_dev_t *dev)
 	uint16_t descno;
 	uint32_t len;
 
-	while (virtio_virtq_consume_used(vdev, RQ_QUEUE, &descno, &len)) {
-		assert(descno < RQ_BUFFERS);
-		fibril_mutex_lock(&virtio_blk->completion_lock[descno]);
-		fibril_condvar_signal(&virtio_blk->completion_cv[descno]);
-		fibril_mutex_unlock(&virtio_blk->completion_lock[descno]);
+	/* All request queues share the INT#x interrupt */
+	for (unsigned i = 0; i < virtio_blk->num_rqs; i++) {
+		virtio_blk_queue_t *rq = &virtio_blk->rqs[i];
+
+		while (virtio_virtq_consume_used(vdev, rq->num, &descno,
+		    &len)) {
+			assert(descno < RQ_BUFFERS);
+			fibril_mutex_lock(&rq->completion_lock[descno]);
+			rq->completed[descno] = true;
+			fibril_condvar_signal(&rq->completion_cv[descno]);
+			fibril_mutex_unlock(&rq->completion_lock[descno]);
+		}
 	}
 }
 
@@ -149,6 +161,14 @@ static errno_t virtio_blk_register_interrupt(ddf_dev_t *dev)
 
 static errno_t virtio_blk_bd_open(bd_srvs_t *bds, bd_srv_t *bd)
 {
+	virtio_blk_t *virtio_blk = (virtio_blk_t *) bds->sarg;
+
+	/* Spread client sessions over the request queues */
+	fibril_mutex_lock(&virtio_blk->next_rq_lock);
+	bd->carg = &virtio_blk->rqs[virtio_blk->next_rq];
+	virtio_blk->next_rq = (virtio_blk->next_rq + 1) % virtio_blk->num_rqs;
+	fibril_mutex_unlock(&virtio_blk->next_rq_lock);
+
 	return EOK;
 }
 
@@ -157,34 +177,48 @@ static errno_t virtio_blk_bd_close(bd_srv_t *bd)
 	return EOK;
 }
 
-static errno_t virtio_blk_rw_block(virtio_blk_t *virtio_blk, bool read,
-    aoff64_t ba, void *buf)
+/** Submit a request without notifying the device.
+ *
+ * @param virtio_blk	Device.
+ * @param rq		Request queue.
+ * @param read		Read or write.
+ * @param ba		First block.
+ * @param buf		Buffer with data to write.
+ * @param size		Number of bytes, at most virtio_blk->max_xfer.
+ *
+ * @return		Descriptor of the request.
+ */
+static uint16_t virtio_blk_rq_submit(virtio_blk_t *virtio_blk,
+    virtio_blk_queue_t *rq, bool read, aoff64_t ba, const void *buf,
+    size_t size)
 {
 	virtio_dev_t *vdev = &virtio_blk->virtio_dev;
 
+	assert(size <= virtio_blk->max_xfer);
+
 	/*
 	 * Allocate a descriptor.
 	 *
 	 * The allocated descno will determine the header descriptor
 	 * (REQ_HEADER_DESC), the buffer descriptor (REQ_BUFFER_DESC) and the
-	 * footer (REQ_FOOTER_DESC) descriptor.
+	 * footer (REQ_FOOTER_DESC) descriptor or the indirect table. Requests
+	 * submitted but not yet announced to the device must be announced
+	 * before waiting for a descriptor to be freed.
 	 */
-	fibril_mutex_lock(&virtio_blk->free_lock);
-	uint16_t descno = virtio_alloc_desc(vdev, RQ_QUEUE,
-	    &virtio_blk->rq_free_head);
+	fibril_mutex_lock(&rq->free_lock);
+	uint16_t descno = virtio_alloc_desc(vdev, rq->num, &rq->rq_free_head);
 	while (descno == (uint16_t) -1U) {
-		fibril_condvar_wait(&virtio_blk->free_cv,
-		    &virtio_blk->free_lock);
-		descno = virtio_alloc_desc(vdev, RQ_QUEUE,
-		    &virtio_blk->rq_free_head);
+		virtio_virtq_kick(vdev, rq->num);
+		fibril_condvar_wait(&rq->free_cv, &rq->free_lock);
+		descno = virtio_alloc_desc(vdev, rq->num, &rq->rq_free_head);
 	}
-	fibril_mutex_unlock(&virtio_blk->free_lock);
+	fibril_mutex_unlock(&rq->free_lock);
 
 	assert(descno < RQ_BUFFERS);
 
 	/* Setup the request header */
 	virtio_blk_req_header_t *req_header =
-	    (virtio_blk_req_header_t *) virtio_blk->rq_header[descno];
+	    (virtio_blk_req_header_t *) rq->rq_header[descno];
 	memset(req_header, 0, sizeof(virtio_blk_req_header_t));
 	pio_write_le32(&req_header->type,
 	    read ? VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT);
@@ -192,36 +226,85 @@ static errno_t virtio_blk_rw_block(virtio_blk_t *virtio_blk, bool read,
 
 	/* Copy write data to the request. */
 	if (!read)
-		memcpy(virtio_blk->rq_buf[descno], buf, VIRTIO_BLK_BLOCK_SIZE);
+		memcpy(rq->rq_buf[descno], buf, size);
 
-	fibril_mutex_lock(&virtio_blk->completion_lock[descno]);
+	fibril_mutex_lock(&rq->completion_lock[descno]);
+	rq->completed[descno] = false;
+	fibril_mutex_unlock(&rq->completion_lock[descno]);
 
-	/*
-	 * Set the descriptors, chain them in the virtqueue and notify the
-	 * device.
-	 */
-	virtio_virtq_desc_set(vdev, RQ_QUEUE, REQ_HEADER_DESC(descno),
-	    virtio_blk->rq_header_p[descno], sizeof(virtio_blk_req_header_t),
-	    VIRTQ_DESC_F_NEXT, REQ_BUFFER_DESC(descno));
-	virtio_virtq_desc_set(vdev, RQ_QUEUE, REQ_BUFFER_DESC(descno),
-	    virtio_blk->rq_buf_p[descno], VIRTIO_BLK_BLOCK_SIZE,
-	    VIRTQ_DESC_F_NEXT | (read ? VIRTQ_DESC_F_WRITE : 0),
-	    REQ_FOOTER_DESC(descno));
-	virtio_virtq_desc_set(vdev, RQ_QUEUE, REQ_FOOTER_DESC(descno),
-	    virtio_blk->rq_footer_p[descno], sizeof(virtio_blk_req_footer_t),
-	    VIRTQ_DESC_F_WRITE, 0);
-	virtio_virtq_produce_available(vdev, RQ_QUEUE, descno);
+	uint16_t buf_flags = read ? VIRTQ_DESC_F_WRITE : 0;
+
+	if (virtio_blk->indirect) {
+		/* Describe the request in its indirect table */
+		virtq_desc_t *table = rq->rq_indirect[descno];
+		uint16_t i = 0;
+
+		virtio_indirect_desc_set(table, i, rq->rq_header_p[descno],
+		    sizeof(virtio_blk_req_header_t), VIRTQ_DESC_F_NEXT, i + 1);
+		i++;
+
+		for (size_t off = 0; off < size; off += virtio_blk->seg_size) {
+			size_t seg = min(size - off, virtio_blk->seg_size);
+			virtio_indirect_desc_set(table, i,
+			    rq->rq_buf_p[descno] + off, seg,
+			    VIRTQ_DESC_F_NEXT | buf_flags, i + 1);
+			i++;
+		}
+
+		virtio_indirect_desc_set(table, i, rq->rq_footer_p[descno],
+		    sizeof(virtio_blk_req_footer_t), VIRTQ_DESC_F_WRITE, 0);
+		i++;
+
+		write_barrier();
+		virtio_virtq_desc_set_indirect(vdev, rq->num, descno,
+		    rq->rq_indirect_p[descno], i);
+	} else {
+		/* Set the descriptors and chain them in the virtqueue */
+		virtio_virtq_desc_set(vdev, rq->num, REQ_HEADER_DESC(descno),
+		    rq->rq_header_p[descno], sizeof(virtio_blk_req_header_t),
+		    VIRTQ_DESC_F_NEXT, REQ_BUFFER_DESC(descno));
+		virtio_virtq_desc_set(vdev, rq->num, REQ_BUFFER_DESC(descno),
+		    rq->rq_buf_p[descno], size, VIRTQ_DESC_F_NEXT | buf_flags,
+		    REQ_FOOTER_DESC(descno));
+		virtio_virtq_desc_set(vdev, rq->num, REQ_FOOTER_DESC(descno),
+		    rq->rq_footer_p[descno], sizeof(virtio_blk_req_footer_t),
+		    VIRTQ_DESC_F_WRITE, 0);
+	}
+
+	virtio_virtq_add_available(vdev, rq->num, descno);
+	return descno;
+}
+
+/** Wait for a request to complete and free its descriptor.
+ *
+ * @param virtio_blk	Device.
+ * @param rq		Request queue.
+ * @param descno	Descriptor of the request.
+ * @param read		Read or write.
+ * @param buf		Buffer receiving read data.
+ * @param size		Number of bytes.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t virtio_blk_rq_complete(virtio_blk_t *virtio_blk,
+    virtio_blk_queue_t *rq, uint16_t descno, bool read, void *buf,
+    size_t size)
+{
+	virtio_dev_t *vdev = &virtio_blk->virtio_dev;
 
 	/*
 	 * Wait for the completion of the request.
 	 */
-	fibril_condvar_wait(&virtio_blk->completion_cv[descno],
-	    &virtio_blk->completion_lock[descno]);
-	fibril_mutex_unlock(&virtio_blk->completion_lock[descno]);
+	fibril_mutex_lock(&rq->completion_lock[descno]);
+	while (!rq->completed[descno]) {
+		fibril_condvar_wait(&rq->completion_cv[descno],
+		    &rq->completion_lock[descno]);
+	}
+	fibril_mutex_unlock(&rq->completion_lock[descno]);
 
 	errno_t rc;
 	virtio_blk_req_footer_t *footer =
-	    (virtio_blk_req_footer_t *) virtio_blk->rq_footer[descno];
+	    (virtio_blk_req_footer_t *) rq->rq_footer[descno];
 	switch (footer->status) {
 	case VIRTIO_BLK_S_OK:
 		rc = EOK;
@@ -241,13 +324,13 @@ static errno_t virtio_blk_rw_block(virtio_blk_t *virtio_blk, bool read,
 
 	/* Copy read data from the request */
 	if (rc == EOK && read)
-		memcpy(buf, virtio_blk->rq_buf[descno], VIRTIO_BLK_BLOCK_SIZE);
+		memcpy(buf, rq->rq_buf[descno], size);
 
 	/* Free the descriptor and buffer */
-	fibril_mutex_lock(&virtio_blk->free_lock);
-	virtio_free_desc(vdev, RQ_QUEUE, &virtio_blk->rq_free_head, descno);
-	fibril_condvar_signal(&virtio_blk->free_cv);
-	fibril_mutex_unlock(&virtio_blk->free_lock);
+	fibril_mutex_lock(&rq->free_lock);
+	virtio_free_desc(vdev, rq->num, &rq->rq_free_head, descno);
+	fibril_condvar_signal(&rq->free_cv);
+	fibril_mutex_unlock(&rq->free_lock);
 
 	return rc;
 }
@@ -256,20 +339,48 @@ static errno_t virtio_blk_bd_rw_blocks(bd_srv_t *bd, aoff64_t ba, size_t cnt,
     void *buf, size_t size, bool read)
 {
 	virtio_blk_t *virtio_blk = (virtio_blk_t *) bd->srvs->sarg;
-	aoff64_t i;
-	errno_t rc;
+	virtio_blk_queue_t *rq = (virtio_blk_queue_t *) bd->carg;
+	size_t max_blocks = virtio_blk->max_xfer / VIRTIO_BLK_BLOCK_SIZE;
+	uint16_t descno[RQ_BATCH];
+	void *rq_data[RQ_BATCH];
+	size_t rq_size[RQ_BATCH];
+	errno_t rc = EOK;
 
 	if (size != cnt * VIRTIO_BLK_BLOCK_SIZE)
 		return EINVAL;
 
-	for (i = 0; i < cnt; i++) {
-		rc = virtio_blk_rw_block(virtio_blk, read, ba + i,
-		    buf + i * VIRTIO_BLK_BLOCK_SIZE);
-		if (rc != EOK)
-			return rc;
+	while (cnt > 0 && rc == EOK) {
+		unsigned n = 0;
+
+		/*
+		 * Submit a batch of requests and notify the device about all
+		 * of them at once.
+		 */
+		while (cnt > 0 && n < RQ_BATCH) {
+			size_t blocks = min(cnt, max_blocks);
+
+			rq_data[n] = buf;
+			rq_size[n] = blocks * VIRTIO_BLK_BLOCK_SIZE;
+			descno[n] = virtio_blk_rq_submit(virtio_blk, rq, read,
+			    ba, buf, rq_size[n]);
+			n++;
+
+			ba += blocks;
+			buf += blocks * VIRTIO_BLK_BLOCK_SIZE;
+			cnt -= blocks;
+		}
+
+		virtio_virtq_kick(&virtio_blk->virtio_dev, rq->num);
+
+		for (unsigned i = 0; i < n; i++) {
+			errno_t rrc = virtio_blk_rq_complete(virtio_blk, rq,
+			    descno[i], read, rq_data[i], rq_size[i]);
+			if (rrc != EOK && rc == EOK)
+				rc = rrc;
+		}
 	}
 
-	return EOK;
+	return rc;
 }
 
 static errno_t virtio_blk_bd_read_blocks(bd_srv_t *bd, aoff64_t ba, size_t cnt,
@@ -298,6 +409,13 @@ static errno_t virtio_blk_bd_get_num_blocks(bd_srv_t *bd, aoff64_t *nb)
 	return EOK;
 }
 
+static errno_t virtio_blk_bd_get_queue_depth(bd_srv_t *bd, size_t *qdepth)
+{
+	/* Each request in flight occupies one buffer of the session's queue */
+	*qdepth = RQ_BUFFERS;
+	return EOK;
+}
+
 bd_ops_t virtio_blk_bd_ops = {
 	.open = virtio_blk_bd_open,
 	.close = virtio_blk_bd_close,
@@ -305,8 +423,87 @@ bd_ops_t virtio_blk_bd_ops = {
 	.write_blocks = virtio_blk_bd_write_blocks,
 	.get_block_size = virtio_blk_bd_get_block_size,
 	.get_num_blocks = virtio_blk_bd_get_num_blocks,
+	.get_queue_depth = virtio_blk_bd_get_queue_depth,
 };
 
+/** Set up a request queue and its DMA buffers */
+static errno_t virtio_blk_rq_setup(virtio_blk_t *virtio_blk,
+    virtio_blk_queue_t *rq, uint16_t num)
+{
+	virtio_dev_t *vdev = &virtio_blk->virtio_dev;
+	errno_t rc;
+
+	rq->num = num;
+	fibril_mutex_initialize(&rq->free_lock);
+	fibril_condvar_initialize(&rq->free_cv);
+
+	for (unsigned i = 0; i < RQ_BUFFERS; i++) {
+		fibril_mutex_initialize(&rq->completion_lock[i]);
+		fibril_condvar_initialize(&rq->completion_cv[i]);
+	}
+
+	/*
+	 * For each in/out request we need 3 descriptors or just one with
+	 * indirect descriptors
+	 */
+	rc = virtio_virtq_setup(vdev, num,
+	    virtio_blk->indirect ? RQ_BUFFERS : 3 * RQ_BUFFERS);
+	if (rc != EOK)
+		return rc;
+
+	/*
+	 * Setup DMA buffers
+	 */
+	rc = virtio_setup_dma_bufs(RQ_BUFFERS, sizeof(virtio_blk_req_header_t),
+	    true, rq->rq_header, rq->rq_header_p);
+	if (rc != EOK)
+		return rc;
+	rc = virtio_setup_dma_bufs(RQ_BUFFERS, RQ_BUF_SIZE,
+	    true, rq->rq_buf, rq->rq_buf_p);
+	if (rc != EOK)
+		return rc;
+	rc = virtio_setup_dma_bufs(RQ_BUFFERS, sizeof(virtio_blk_req_footer_t),
+	    false, rq->rq_footer, rq->rq_footer_p);
+	if (rc != EOK)
+		return rc;
+	if (virtio_blk->indirect) {
+		rc = virtio_setup_dma_bufs(RQ_BUFFERS,
+		    sizeof(virtq_desc_t[RQ_SEGS + 2]), true, rq->rq_indirect,
+		    rq->rq_indirect_p);
+		if (rc != EOK)
+			return rc;
+	}
+
+	/*
+	 * Put all request descriptors on a free list. Because of the
+	 * correspondence between the request, buffer and footer descriptors,
+	 * we only need to manage allocations for one set: the request header
+	 * descriptors.
+	 */
+	virtio_create_desc_free_list(vdev, num, RQ_BUFFERS, &rq->rq_free_head);
+	return EOK;
+}
+
+static void virtio_blk_rq_teardown(virtio_blk_queue_t *rq)
+{
+	virtio_teardown_dma_bufs(rq->rq_header);
+	virtio_teardown_dma_bufs(rq->rq_buf);
+	virtio_teardown_dma_bufs(rq->rq_footer);
+	virtio_teardown_dma_bufs(rq->rq_indirect);
+}
+
+static void virtio_blk_teardown(virtio_blk_t *virtio_blk)
+{
+	if (virtio_blk->rqs == NULL)
+		return;
+
+	for (unsigned i = 0; i < virtio_blk->num_rqs; i++)
+		virtio_blk_rq_teardown(&virtio_blk->rqs[i]);
+
+	free(virtio_blk->rqs);
+	virtio_blk->rqs = NULL;
+}
+
 static errno_t virtio_blk_initialize(ddf_dev_t *dev)
 {
 	virtio_blk_t *virtio_blk = ddf_dev_data_alloc(dev,
@@ -314,13 +511,7 @@ static errno_t virtio_blk_initialize(ddf_dev_t *dev)
 	if (!virtio_blk)
 		return ENOMEM;
 
-	fibril_mutex_initialize(&virtio_blk->free_lock);
-	fibril_condvar_initialize(&virtio_blk->free_cv);
-
-	for (unsigned i = 0; i < RQ_BUFFERS; i++) {
-		fibril_mutex_initialize(&virtio_blk->completion_lock[i]);
-		fibril_condvar_initialize(&virtio_blk->completion_cv[i]);
-	}
+	fibril_mutex_initialize(&virtio_blk->next_rq_lock);
 
 	bd_srvs_init(&virtio_blk->bds);
 	virtio_blk->bds.ops = &virtio_blk_bd_ops;
@@ -332,6 +523,7 @@ static errno_t virtio_blk_initialize(ddf_dev_t *dev)
 
 	virtio_dev_t *vdev = &virtio_blk->virtio_dev;
 	virtio_pci_common_cfg_t *cfg = virtio_blk->virtio_dev.common_cfg;
+	virtio_blk_cfg_t *blkcfg = virtio_blk->virtio_dev.device_cfg;
 
 	/*
 	 * Register IRQ
@@ -341,58 +533,82 @@ static errno_t virtio_blk_initialize(ddf_dev_t *dev)
 		goto fail;
 
 	/* Reset the device and negotiate the feature bits */
-	rc = virtio_device_setup_start(vdev, 0);
+	rc = virtio_device_setup_negotiate(vdev, 0,
+	    VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_MQ |
+	    VIRTIO_F_RING_INDIRECT_DESC | VIRTIO_F_RING_EVENT_IDX);
 	if (rc != EOK)
 		goto fail;
 
 	/* Perform device-specific setup */
 
 	/*
-	 * Discover and configure the virtqueue
+	 * Determine how large requests can be. Without indirect descriptors
+	 * the data are always described by a single descriptor.
+	 */
+	virtio_blk->indirect =
+	    (vdev->features & VIRTIO_F_RING_INDIRECT_DESC) != 0;
+
+	virtio_blk->seg_size = RQ_BUF_SIZE;
+	if (vdev->features & VIRTIO_BLK_F_SIZE_MAX) {
+		uint32_t size_max = pio_read_le32(&blkcfg->size_max);
+		if (size_max >= VIRTIO_BLK_BLOCK_SIZE)
+			virtio_blk->seg_size = min(size_max, RQ_BUF_SIZE);
+	}
+
+	virtio_blk->segs = 1;
+	if (virtio_blk->indirect && (vdev->features & VIRTIO_BLK_F_SEG_MAX)) {
+		uint32_t seg_max = pio_read_le32(&blkcfg->seg_max);
+		if (seg_max > 1)
+			virtio_blk->segs = min(seg_max, RQ_SEGS);
+	}
+
+	/*
+	 * Segments must not split blocks. Round the segment size down first
+	 * so that max_xfer never exceeds what segs segments can describe.
+	 */
+	virtio_blk->seg_size -= virtio_blk->seg_size % VIRTIO_BLK_BLOCK_SIZE;
+	virtio_blk->max_xfer = min(virtio_blk->seg_size * virtio_blk->segs,
+	    RQ_BUF_SIZE);
+	virtio_blk->max_xfer -= virtio_blk->max_xfer % VIRTIO_BLK_BLOCK_SIZE;
+
+	/*
+	 * Discover and configure the virtqueues
 	 */
 	uint16_t num_queues = pio_read_le16(&cfg->num_queues);
-	if (num_queues != VIRTIO_BLK_NUM_QUEUES) {
+	uint16_t num_rqs = 1;
+	if (vdev->features & VIRTIO_BLK_F_MQ)
+		num_rqs = pio_read_le16(&blkcfg->num_queues);
+	num_rqs = min(min(num_rqs, num_queues), VIRTIO_BLK_MAX_QUEUES);
+	if (num_rqs < 1) {
 		ddf_msg(LVL_NOTE, "Unsupported number of virtqueues: %u",
 		    num_queues);
 		rc = ELIMIT;
 		goto fail;
 	}
 
+	ddf_msg(LVL_NOTE, "%u request queue(s), %zu bytes per request%s%s",
+	    num_rqs, virtio_blk->max_xfer,
+	    virtio_blk->indirect ? ", indirect descriptors" : "",
+	    (vdev->features & VIRTIO_F_RING_EVENT_IDX) ? ", event index" : "");
+
 	vdev->queues = calloc(sizeof(virtq_t), num_queues);
 	if (!vdev->queues) {
 		rc = ENOMEM;
 		goto fail;
 	}
 
-	/* For each in/out request we need 3 descriptors */
-	rc = virtio_virtq_setup(vdev, RQ_QUEUE, 3 * RQ_BUFFERS);
-	if (rc != EOK)
-		goto fail;
-
-	/*
-	 * Setup DMA buffers
-	 */
-	rc = virtio_setup_dma_bufs(RQ_BUFFERS, sizeof(virtio_blk_req_header_t),
-	    true, virtio_blk->rq_header, virtio_blk->rq_header_p);
-	if (rc != EOK)
-		goto fail;
-	rc = virtio_setup_dma_bufs(RQ_BUFFERS, VIRTIO_BLK_BLOCK_SIZE,
-	    true, virtio_blk->rq_buf, virtio_blk->rq_buf_p);
-	if (rc != EOK)
-		goto fail;
-	rc = virtio_setup_dma_bufs(RQ_BUFFERS, sizeof(virtio_blk_req_footer_t),
-	    false, virtio_blk->rq_footer, virtio_blk->rq_footer_p);
-	if (rc != EOK)
+	virtio_blk->rqs = calloc(sizeof(virtio_blk_queue_t), num_rqs);
+	if (!virtio_blk->rqs) {
+		rc = ENOMEM;
 		goto fail;
+	}
+	virtio_blk->num_rqs = num_rqs;
 
-	/*
-	 * Put all request descriptors on a free list. Because of the
-	 * correspondence between the request, buffer and footer descriptors,
-	 * we only need to manage allocations for one set: the request header
-	 * descriptors.
-	 */
-	virtio_create_desc_free_list(vdev, RQ_QUEUE, RQ_BUFFERS,
-	    &virtio_blk->rq_free_head);
+	for (uint16_t i = 0; i < num_rqs; i++) {
+		rc = virtio_blk_rq_setup(virtio_blk, &virtio_blk->rqs[i], i);
+		if (rc != EOK)
+			goto fail;
+	}
 
 	/*
 	 * Enable IRQ
@@ -412,9 +628,7 @@ static errno_t virtio_blk_initialize(ddf_dev_t *dev)
 	return EOK;
 
 fail:
-	virtio_teardown_dma_bufs(virtio_blk->rq_header);
-	virtio_teardown_dma_bufs(virtio_blk->rq_buf);
-	virtio_teardown_dma_bufs(virtio_blk->rq_footer);
+	virtio_blk_teardown(virtio_blk);
 
 	virtio_device_setup_fail(vdev);
 	virtio_pci_dev_cleanup(vdev);
@@ -425,9 +639,7 @@ static void virtio_blk_uninitialize(ddf_dev_t *dev)
 {
 	virtio_blk_t *virtio_blk = (virtio_blk_t *) ddf_dev_data_get(dev);
 
-	virtio_teardown_dma_bufs(virtio_blk->rq_header);
-	virtio_teardown_dma_bufs(virtio_blk->rq_buf);
-	virtio_teardown_dma_bufs(virtio_blk->rq_footer);
+	virtio_blk_teardown(virtio_blk);
 
 	virtio_device_setup_fail(&virtio_blk->virtio_dev);
 	virtio_pci_dev_cleanup(&virtio_blk->virtio_dev);
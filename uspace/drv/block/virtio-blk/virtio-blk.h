@@ -46,10 +46,26 @@
 #define VIRTIO_BLK_S_IOERR	1
 #define VIRTIO_BLK_S_UNSUPP	2
 
+/** Number of requests in flight per request queue */
 #define RQ_BUFFERS	32
 
+/** Size of the data buffer of one request */
+#define RQ_BUF_SIZE	(64 * 1024)
+
+/** Maximum number of data segments of one request */
+#define RQ_SEGS		16
+
+/** Maximum number of request queues we use */
+#define VIRTIO_BLK_MAX_QUEUES	8
+
+/** Maximum size of any single segment is in size_max. */
+#define VIRTIO_BLK_F_SIZE_MAX	(1U << 1)
+/** Maximum number of segments in a request is in seg_max. */
+#define VIRTIO_BLK_F_SEG_MAX	(1U << 2)
 /** Device is read-only. */
 #define VIRTIO_BLK_F_RO		(1U << 5)
+/** Device supports multiqueue. */
+#define VIRTIO_BLK_F_MQ		(1U << 12)
 
 typedef struct {
 	uint32_t type;
@@ -61,12 +77,32 @@ typedef struct {
 	uint8_t status;
 } virtio_blk_req_footer_t;
 
+/** Device configuration layout as per VIRTIO version 1.0 */
 typedef struct {
-	uint64_t capacity;
+	ioport64_t capacity;
+	ioport32_t size_max;
+	ioport32_t seg_max;
+	struct {
+		ioport16_t cylinders;
+		ioport8_t heads;
+		ioport8_t sectors;
+	} geometry;
+	ioport32_t blk_size;
+	struct {
+		ioport8_t physical_block_exp;
+		ioport8_t alignment_offset;
+		ioport16_t min_io_size;
+		ioport32_t opt_io_size;
+	} topology;
+	ioport8_t writeback;
+	ioport8_t unused0;
+	ioport16_t num_queues;
 } virtio_blk_cfg_t;
 
+/** Request queue */
 typedef struct {
-	virtio_dev_t virtio_dev;
+	/** Index of the virtqueue */
+	uint16_t num;
 
 	void *rq_header[RQ_BUFFERS];
 	uintptr_t rq_header_p[RQ_BUFFERS];
@@ -77,18 +113,43 @@ typedef struct {
 	void *rq_footer[RQ_BUFFERS];
 	uintptr_t rq_footer_p[RQ_BUFFERS];
 
-	uint16_t rq_free_head;
-
-	int irq;
-	cap_irq_handle_t irq_handle;
+	/** Indirect descriptor tables */
+	void *rq_indirect[RQ_BUFFERS];
+	uintptr_t rq_indirect_p[RQ_BUFFERS];
 
-	bd_srvs_t bds;
+	uint16_t rq_free_head;
 
 	fibril_mutex_t free_lock;
 	fibril_condvar_t free_cv;
 
 	fibril_mutex_t completion_lock[RQ_BUFFERS];
 	fibril_condvar_t completion_cv[RQ_BUFFERS];
+	bool completed[RQ_BUFFERS];
+} virtio_blk_queue_t;
+
+typedef struct {
+	virtio_dev_t virtio_dev;
+
+	/** Request queues */
+	virtio_blk_queue_t *rqs;
+	unsigned num_rqs;
+	/** Request queue to be assigned to the next client session */
+	unsigned next_rq;
+	fibril_mutex_t next_rq_lock;
+
+	/** Requests are described by indirect descriptor tables */
+	bool indirect;
+	/** Maximum size of one data segment */
+	size_t seg_size;
+	/** Maximum number of data segments of one request */
+	size_t segs;
+	/** Maximum number of bytes transferred by one request */
+	size_t max_xfer;
+
+	int irq;
+	cap_irq_handle_t irq_handle;
+
+	bd_srvs_t bds;
 } virtio_blk_t;
 
 #endif
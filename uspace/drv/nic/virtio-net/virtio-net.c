@@ -32,12 +32,17 @@
 #include <stdint.h>
 
 #include <as.h>
+#include <byteorder.h>
 #include <ddf/driver.h>
 #include <ddf/interrupt.h>
 #include <ddf/log.h>
+#include <fibril.h>
+#include <macros.h>
 #include <ops/nic.h>
 #include <pci_dev_iface.h>
 #include <nic/nic.h>
+#include <str_error.h>
+#include <types/inet.h>
 
 #include <nic.h>
 
@@ -45,16 +50,22 @@
 
 #define NAME	"virtio-net"
 
-#define VIRTIO_NET_NUM_QUEUES	3
+/** Receive buffer size when receive buffers can be merged */
+#define RX_BUF_SIZE		2048
+/** Receive buffer size for large segments without mergeable buffers */
+#define RX_BIG_BUF_SIZE		(68 * 1024)
+#define TX_BUF_SIZE		2048
+/** Transmit buffer size when the device does segmentation offload */
+#define TX_TSO_BUF_SIZE		(68 * 1024)
+#define CT_BUF_SIZE		2048
 
-#define RX_QUEUE_1	0
-#define TX_QUEUE_1	1
-#define CT_QUEUE_1	2
+#define ETH_HDR_SIZE		14
+#define ETYPE_IP		0x0800
+#define ETYPE_IPV6		0x86dd
 
-#define BUFFER_SIZE	2048
-#define RX_BUF_SIZE	BUFFER_SIZE
-#define TX_BUF_SIZE	BUFFER_SIZE
-#define CT_BUF_SIZE	BUFFER_SIZE
+/** Wait for acknowledgement of a control command */
+#define CT_POLL_USEC		1000
+#define CT_POLL_COUNT		100
 
 static ddf_dev_ops_t virtio_net_dev_ops;
 
@@ -69,44 +80,110 @@ static driver_t virtio_net_driver = {
 	.driver_ops = &virtio_net_driver_ops
 };
 
-static void virtio_net_irq_handler(ipc_call_t *icall, ddf_dev_t *dev)
+/** Pass received buffers of a queue pair to the NIC framework.
+ *
+ * Frames spanning multiple mergeable buffers are assembled before they
+ * are passed on. All consumed buffers are returned to the device with
+ * a single notification.
+ */
+static void virtio_net_rx(nic_t *nic, virtio_net_t *virtio_net,
+    virtio_net_pair_t *pair)
 {
-	nic_t *nic = ddf_dev_data_get(dev);
-	virtio_net_t *virtio_net = nic_get_specific(nic);
 	virtio_dev_t *vdev = &virtio_net->virtio_dev;
+	bool refill = false;
 
 	uint16_t descno;
 	uint32_t len;
-	while (virtio_virtq_consume_used(vdev, RX_QUEUE_1, &descno, &len)) {
-		virtio_net_hdr_t *hdr =
-		    (virtio_net_hdr_t *) virtio_net->rx_buf[descno];
-		if (len <= sizeof(*hdr)) {
-			ddf_msg(LVL_WARN,
-			    "RX data length too short, packet dropped");
-			virtio_virtq_produce_available(vdev, RX_QUEUE_1,
-			    descno);
-			continue;
+	while (virtio_virtq_consume_used(vdev, pair->rx_num, &descno, &len)) {
+		uint8_t *data = pair->rx_buf[descno];
+		size_t hdr_size = 0;
+		nic_frame_t *frame;
+
+		if (pair->rx_frame_bufs == 0) {
+			/* First buffer of a frame starts with the header */
+			virtio_net_hdr_t *hdr = (virtio_net_hdr_t *) data;
+			if (len <= sizeof(*hdr)) {
+				ddf_msg(LVL_WARN,
+				    "RX data length too short, packet dropped");
+				goto recycle;
+			}
+
+			hdr_size = sizeof(*hdr);
+			pair->rx_frame_bufs = 1;
+			if ((virtio_net->virtio_dev.features &
+			    VIRTIO_NET_F_MRG_RXBUF) != 0) {
+				pair->rx_frame_bufs = max(1,
+				    uint16_t_le2host(hdr->num_buffers));
+			}
+
+			pair->rx_frame = nic_alloc_frame(nic,
+			    pair->rx_frame_bufs * virtio_net->rx_buf_size);
+			if (pair->rx_frame == NULL) {
+				ddf_msg(LVL_WARN,
+				    "Cannot allocate RX frame, packet dropped");
+			} else {
+				pair->rx_frame->size = 0;
+				if ((hdr->flags & (VIRTIO_NET_HDR_F_DATA_VALID |
+				    VIRTIO_NET_HDR_F_NEEDS_CSUM)) != 0) {
+					pair->rx_frame->offload =
+					    INET_OFFLOAD_CSUM_VALID;
+				}
+			}
 		}
 
-		nic_frame_t *frame = nic_alloc_frame(nic, len - sizeof(*hdr));
-		if (frame) {
-			memcpy(frame->data, &hdr[1], len - sizeof(*hdr));
+		frame = pair->rx_frame;
+		if (frame != NULL) {
+			memcpy((uint8_t *) frame->data + frame->size,
+			    data + hdr_size, len - hdr_size);
+			frame->size += len - hdr_size;
+		}
+
+		if (--pair->rx_frame_bufs == 0 && frame != NULL) {
+			pair->rx_frame = NULL;
 			nic_received_frame(nic, frame);
-		} else {
-			ddf_msg(LVL_WARN,
-			    "Cannot allocate RX frame, packet dropped");
 		}
 
-		virtio_virtq_produce_available(vdev, RX_QUEUE_1, descno);
+	recycle:
+		virtio_virtq_add_available(vdev, pair->rx_num, descno);
+		refill = true;
 	}
 
-	while (virtio_virtq_consume_used(vdev, TX_QUEUE_1, &descno, &len)) {
-		virtio_free_desc(vdev, TX_QUEUE_1, &virtio_net->tx_free_head,
-		    descno);
+	if (refill)
+		virtio_virtq_kick(vdev, pair->rx_num);
+}
+
+static void virtio_net_irq_handler(ipc_call_t *icall, ddf_dev_t *dev)
+{
+	nic_t *nic = ddf_dev_data_get(dev);
+	virtio_net_t *virtio_net = nic_get_specific(nic);
+	virtio_dev_t *vdev = &virtio_net->virtio_dev;
+
+	uint16_t descno;
+	uint32_t len;
+
+	for (unsigned i = 0; i < virtio_net->num_pairs; i++) {
+		virtio_net_pair_t *pair = &virtio_net->pairs[i];
+
+		virtio_net_rx(nic, virtio_net, pair);
+
+		while (virtio_virtq_consume_used(vdev, pair->tx_num, &descno,
+		    &len)) {
+			virtio_free_desc(vdev, pair->tx_num,
+			    &pair->tx_free_head, descno);
+		}
 	}
-	while (virtio_virtq_consume_used(vdev, CT_QUEUE_1, &descno, &len)) {
-		virtio_free_desc(vdev, CT_QUEUE_1, &virtio_net->ct_free_head,
-		    descno);
+
+	while (virtio_virtq_consume_used(vdev, virtio_net->ct_num, &descno,
+	    &len)) {
+		/* Control commands are chains of two descriptors */
+		uint16_t next = virtio_virtq_desc_get_next(vdev,
+		    virtio_net->ct_num, descno);
+		if (next != (uint16_t) -1U) {
+			virtio_free_desc(vdev, virtio_net->ct_num,
+			    &virtio_net->ct_free_head, next);
+		}
+		virtio_free_desc(vdev, virtio_net->ct_num,
+		    &virtio_net->ct_free_head, descno);
 	}
 }
 
@@ -166,6 +243,125 @@ static errno_t virtio_net_register_interrupt(ddf_dev_t *dev)
 	    virtio_net_irq_handler, &irq_code, &virtio_net->irq_handle);
 }
 
+/** Send a command over the control virtqueue and wait for its completion.
+ *
+ * @param virtio_net Device
+ * @param class      Command class
+ * @param command    Command
+ * @param data       Command-specific data
+ * @param size       Size of command-specific data
+ *
+ * @return EOK on success, EIO if the device rejected the command,
+ *         ETIMEOUT if it did not answer in time
+ */
+static errno_t virtio_net_ctrl_cmd(virtio_net_t *virtio_net, uint8_t class,
+    uint8_t command, const void *data, size_t size)
+{
+	virtio_dev_t *vdev = &virtio_net->virtio_dev;
+	uint16_t num = virtio_net->ct_num;
+
+	if (sizeof(virtio_net_ctrl_hdr_t) + size > CT_BUF_SIZE)
+		return EINVAL;
+
+	uint16_t cmd_desc = virtio_alloc_desc(vdev, num,
+	    &virtio_net->ct_free_head);
+	if (cmd_desc == (uint16_t) -1U)
+		return EBUSY;
+	uint16_t ack_desc = virtio_alloc_desc(vdev, num,
+	    &virtio_net->ct_free_head);
+	if (ack_desc == (uint16_t) -1U) {
+		virtio_free_desc(vdev, num, &virtio_net->ct_free_head,
+		    cmd_desc);
+		return EBUSY;
+	}
+
+	virtio_net_ctrl_hdr_t *hdr = virtio_net->ct_buf[cmd_desc];
+	hdr->class = class;
+	hdr->command = command;
+	memcpy(&hdr[1], data, size);
+
+	volatile uint8_t *ack = virtio_net->ct_buf[ack_desc];
+	*ack = VIRTIO_NET_ERR;
+
+	/* Device-readable command followed by device-writable status */
+	virtio_virtq_desc_set(vdev, num, cmd_desc,
+	    virtio_net->ct_buf_p[cmd_desc],
+	    sizeof(virtio_net_ctrl_hdr_t) + size, VIRTQ_DESC_F_NEXT, ack_desc);
+	virtio_virtq_desc_set(vdev, num, ack_desc,
+	    virtio_net->ct_buf_p[ack_desc], sizeof(uint8_t),
+	    VIRTQ_DESC_F_WRITE, 0);
+
+	/*
+	 * The interrupt handler returns both descriptors to the free list
+	 * once the device is done with the command.
+	 */
+	virtio_virtq_produce_available(vdev, num, cmd_desc);
+
+	for (unsigned i = 0; i < CT_POLL_COUNT; i++) {
+		if (*ack == VIRTIO_NET_OK)
+			return EOK;
+		fibril_usleep(CT_POLL_USEC);
+	}
+
+	return *ack == VIRTIO_NET_OK ? EOK : ETIMEOUT;
+}
+
+/** Allocate DMA buffers of a queue pair and give receive buffers to device */
+static errno_t virtio_net_pair_setup(virtio_net_t *virtio_net,
+    virtio_net_pair_t *pair)
+{
+	virtio_dev_t *vdev = &virtio_net->virtio_dev;
+
+	errno_t rc = virtio_virtq_setup(vdev, pair->rx_num, RX_BUFFERS);
+	if (rc != EOK)
+		return rc;
+	rc = virtio_virtq_setup(vdev, pair->tx_num, TX_BUFFERS);
+	if (rc != EOK)
+		return rc;
+
+	rc = virtio_setup_dma_bufs(RX_BUFFERS, virtio_net->rx_buf_size, false,
+	    pair->rx_buf, pair->rx_buf_p);
+	if (rc != EOK)
+		return rc;
+	rc = virtio_setup_dma_bufs(TX_BUFFERS, virtio_net->tx_buf_size, true,
+	    pair->tx_buf, pair->tx_buf_p);
+	if (rc != EOK)
+		return rc;
+
+	/*
+	 * Give all RX buffers to the NIC, notify it only once
+	 */
+	for (unsigned i = 0; i < RX_BUFFERS; i++) {
+		virtio_virtq_desc_set(vdev, pair->rx_num, i,
+		    pair->rx_buf_p[i], virtio_net->rx_buf_size,
+		    VIRTQ_DESC_F_WRITE, 0);
+		virtio_virtq_add_available(vdev, pair->rx_num, i);
+	}
+	virtio_virtq_kick(vdev, pair->rx_num);
+
+	/*
+	 * Put all TX buffers on a free list
+	 */
+	virtio_create_desc_free_list(vdev, pair->tx_num, TX_BUFFERS,
+	    &pair->tx_free_head);
+
+	return EOK;
+}
+
+static void virtio_net_pairs_teardown(virtio_net_t *virtio_net)
+{
+	if (virtio_net->pairs == NULL)
+		return;
+
+	for (unsigned i = 0; i < virtio_net->num_pairs; i++) {
+		virtio_teardown_dma_bufs(virtio_net->pairs[i].rx_buf);
+		virtio_teardown_dma_bufs(virtio_net->pairs[i].tx_buf);
+	}
+
+	free(virtio_net->pairs);
+	virtio_net->pairs = NULL;
+}
+
 static errno_t virtio_net_initialize(ddf_dev_t *dev)
 {
 	nic_t *nic = nic_create_and_bind(dev);
@@ -196,49 +392,88 @@ static errno_t virtio_net_initialize(ddf_dev_t *dev)
 		goto fail;
 
 	/* Reset the device and negotiate the feature bits */
-	rc = virtio_device_setup_start(vdev,
-	    VIRTIO_NET_F_MAC | VIRTIO_NET_F_CTRL_VQ);
+	rc = virtio_device_setup_negotiate(vdev,
+	    VIRTIO_NET_F_MAC | VIRTIO_NET_F_CTRL_VQ,
+	    VIRTIO_NET_F_CSUM | VIRTIO_NET_F_GUEST_CSUM |
+	    VIRTIO_NET_F_HOST_TSO4 | VIRTIO_NET_F_HOST_TSO6 |
+	    VIRTIO_NET_F_GUEST_TSO4 | VIRTIO_NET_F_GUEST_TSO6 |
+	    VIRTIO_NET_F_MRG_RXBUF | VIRTIO_NET_F_MQ |
+	    VIRTIO_F_RING_EVENT_IDX);
 	if (rc != EOK)
 		goto fail;
 
 	/* Perform device-specific setup */
+	uint32_t features = vdev->features;
+
+	if ((features & VIRTIO_NET_F_CSUM) != 0)
+		virtio_net->offload |= NIC_OFFLOAD_TX_CSUM;
+	if ((features & VIRTIO_NET_F_GUEST_CSUM) != 0)
+		virtio_net->offload |= NIC_OFFLOAD_RX_CSUM;
+	if ((features & VIRTIO_NET_F_HOST_TSO4) != 0)
+		virtio_net->offload |= NIC_OFFLOAD_TSO4;
+	if ((features & VIRTIO_NET_F_HOST_TSO6) != 0)
+		virtio_net->offload |= NIC_OFFLOAD_TSO6;
+	if ((features & (VIRTIO_NET_F_GUEST_TSO4 |
+	    VIRTIO_NET_F_GUEST_TSO6)) != 0)
+		virtio_net->offload |= NIC_OFFLOAD_LRO;
+
+	/*
+	 * Large received segments either span several mergeable buffers or
+	 * need big buffers.
+	 */
+	virtio_net->rx_buf_size = RX_BUF_SIZE;
+	if ((virtio_net->offload & NIC_OFFLOAD_LRO) != 0 &&
+	    (features & VIRTIO_NET_F_MRG_RXBUF) == 0)
+		virtio_net->rx_buf_size = RX_BIG_BUF_SIZE;
+
+	virtio_net->tx_buf_size = TX_BUF_SIZE;
+	if ((virtio_net->offload & (NIC_OFFLOAD_TSO4 | NIC_OFFLOAD_TSO6)) != 0)
+		virtio_net->tx_buf_size = TX_TSO_BUF_SIZE;
 
 	/*
-	 * Discover and configure the virtqueues
+	 * Discover and configure the virtqueues. With multiqueue, the control
+	 * queue follows the maximum number of queue pairs.
 	 */
+	uint16_t max_pairs = 1;
+	if ((features & VIRTIO_NET_F_MQ) != 0)
+		max_pairs = max(1, pio_read_le16(&netcfg->max_virtqueue_pairs));
+
 	uint16_t num_queues = pio_read_le16(&cfg->num_queues);
-	if (num_queues != VIRTIO_NET_NUM_QUEUES) {
+	if (num_queues < 2 * max_pairs + 1) {
 		ddf_msg(LVL_NOTE, "Unsupported number of virtqueues: %u",
 		    num_queues);
 		rc = ELIMIT;
 		goto fail;
 	}
 
+	virtio_net->num_pairs = min(max_pairs, VIRTIO_NET_MAX_PAIRS);
+	virtio_net->ct_num = 2 * max_pairs;
+
 	vdev->queues = calloc(sizeof(virtq_t), num_queues);
 	if (!vdev->queues) {
 		rc = ENOMEM;
 		goto fail;
 	}
 
-	rc = virtio_virtq_setup(vdev, RX_QUEUE_1, RX_BUFFERS);
-	if (rc != EOK)
-		goto fail;
-	rc = virtio_virtq_setup(vdev, TX_QUEUE_1, TX_BUFFERS);
-	if (rc != EOK)
-		goto fail;
-	rc = virtio_virtq_setup(vdev, CT_QUEUE_1, CT_BUFFERS);
-	if (rc != EOK)
+	virtio_net->pairs = calloc(virtio_net->num_pairs,
+	    sizeof(virtio_net_pair_t));
+	if (virtio_net->pairs == NULL) {
+		rc = ENOMEM;
 		goto fail;
+	}
 
-	/*
-	 * Setup DMA buffers
-	 */
-	rc = virtio_setup_dma_bufs(RX_BUFFERS, RX_BUF_SIZE, false,
-	    virtio_net->rx_buf, virtio_net->rx_buf_p);
-	if (rc != EOK)
-		goto fail;
-	rc = virtio_setup_dma_bufs(TX_BUFFERS, TX_BUF_SIZE, true,
-	    virtio_net->tx_buf, virtio_net->tx_buf_p);
+	for (unsigned i = 0; i < virtio_net->num_pairs; i++) {
+		virtio_net_pair_t *pair = &virtio_net->pairs[i];
+
+		pair->rx_num = 2 * i;
+		pair->tx_num = 2 * i + 1;
+
+		rc = virtio_net_pair_setup(virtio_net, pair);
+		if (rc != EOK)
+			goto fail;
+	}
+
+	rc = virtio_virtq_setup(vdev, virtio_net->ct_num, CT_BUFFERS);
 	if (rc != EOK)
 		goto fail;
 	rc = virtio_setup_dma_bufs(CT_BUFFERS, CT_BUF_SIZE, true,
@@ -246,30 +481,7 @@ static errno_t virtio_net_initialize(ddf_dev_t *dev)
 	if (rc != EOK)
 		goto fail;
 
-	/*
-	 * Give all RX buffers to the NIC
-	 */
-	for (unsigned i = 0; i < RX_BUFFERS; i++) {
-		/*
-		 * Associtate the buffer with the descriptor, set length and
-		 * flags.
-		 */
-		virtio_virtq_desc_set(vdev, RX_QUEUE_1, i,
-		    virtio_net->rx_buf_p[i], RX_BUF_SIZE, VIRTQ_DESC_F_WRITE,
-		    0);
-		/*
-		 * Put the set descriptor into the available ring of the RX
-		 * queue.
-		 */
-		virtio_virtq_produce_available(vdev, RX_QUEUE_1, i);
-	}
-
-	/*
-	 * Put all TX and CT buffers on a free list
-	 */
-	virtio_create_desc_free_list(vdev, TX_QUEUE_1, TX_BUFFERS,
-	    &virtio_net->tx_free_head);
-	virtio_create_desc_free_list(vdev, CT_QUEUE_1, CT_BUFFERS,
+	virtio_create_desc_free_list(vdev, virtio_net->ct_num, CT_BUFFERS,
 	    &virtio_net->ct_free_head);
 
 	/*
@@ -299,11 +511,28 @@ static errno_t virtio_net_initialize(ddf_dev_t *dev)
 	/* Go live */
 	virtio_device_setup_finalize(vdev);
 
+	/*
+	 * The device uses only the first queue pair until told otherwise,
+	 * it then steers received flows among the pairs by itself.
+	 */
+	if (virtio_net->num_pairs > 1) {
+		uint16_t pairs = host2uint16_t_le(virtio_net->num_pairs);
+		rc = virtio_net_ctrl_cmd(virtio_net, VIRTIO_NET_CTRL_MQ,
+		    VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &pairs, sizeof(pairs));
+		if (rc != EOK) {
+			ddf_msg(LVL_WARN, "Failed enabling %u queue pairs: %s",
+			    virtio_net->num_pairs, str_error(rc));
+			virtio_net->num_pairs = 1;
+		}
+	}
+
+	ddf_msg(LVL_NOTE, "Using %u queue pair(s), offload capabilities 0x%"
+	    PRIx32, virtio_net->num_pairs, virtio_net->offload);
+
 	return EOK;
 
 fail:
-	virtio_teardown_dma_bufs(virtio_net->rx_buf);
-	virtio_teardown_dma_bufs(virtio_net->tx_buf);
+	virtio_net_pairs_teardown(virtio_net);
 	virtio_teardown_dma_bufs(virtio_net->ct_buf);
 
 	virtio_device_setup_fail(vdev);
@@ -316,26 +545,72 @@ static void virtio_net_uninitialize(ddf_dev_t *dev)
 	nic_t *nic = ddf_dev_data_get(dev);
 	virtio_net_t *virtio_net = (virtio_net_t *) nic_get_specific(nic);
 
-	virtio_teardown_dma_bufs(virtio_net->rx_buf);
-	virtio_teardown_dma_bufs(virtio_net->tx_buf);
+	virtio_net_pairs_teardown(virtio_net);
 	virtio_teardown_dma_bufs(virtio_net->ct_buf);
 
 	virtio_device_setup_fail(&virtio_net->virtio_dev);
 	virtio_pci_dev_cleanup(&virtio_net->virtio_dev);
 }
 
-static void virtio_net_send(nic_t *nic, void *data, size_t size)
+/** Choose transmit queue pair for a frame.
+ *
+ * Frames of one transport flow always use the same pair so that they
+ * are not reordered. The flow is identified by the IP addresses and
+ * the first four bytes of the transport header (the ports).
+ */
+static virtio_net_pair_t *virtio_net_tx_pair(virtio_net_t *virtio_net,
+    const uint8_t *data, size_t size)
+{
+	size_t start;
+	size_t end;
+
+	if (virtio_net->num_pairs == 1 || size < ETH_HDR_SIZE)
+		return &virtio_net->pairs[0];
+
+	uint16_t etype = ((uint16_t) data[12] << 8) | data[13];
+	switch (etype) {
+	case ETYPE_IP:
+		/* Source and destination address, transport ports */
+		start = ETH_HDR_SIZE + 12;
+		end = ETH_HDR_SIZE + (data[ETH_HDR_SIZE] & 0x0f) * 4 + 4;
+		break;
+	case ETYPE_IPV6:
+		start = ETH_HDR_SIZE + 8;
+		end = ETH_HDR_SIZE + 40 + 4;
+		break;
+	default:
+		return &virtio_net->pairs[0];
+	}
+
+	end = min(end, size);
+
+	/* FNV-1a */
+	uint32_t hash = 2166136261U;
+	for (size_t i = start; i < end; i++) {
+		hash ^= data[i];
+		hash *= 16777619U;
+	}
+
+	return &virtio_net->pairs[hash % virtio_net->num_pairs];
+}
+
+/** Send frame, possibly with checksum or segmentation left to the device */
+static void virtio_net_send_offload(nic_t *nic, void *data, size_t size,
+    const inet_offload_t *offload)
 {
 	virtio_net_t *virtio_net = nic_get_specific(nic);
 	virtio_dev_t *vdev = &virtio_net->virtio_dev;
+	uint8_t *frame = data;
 
-	if (size > sizeof(virtio_net) + TX_BUF_SIZE) {
+	if (sizeof(virtio_net_hdr_t) + size > virtio_net->tx_buf_size) {
 		ddf_msg(LVL_WARN, "TX data too big, frame dropped");
 		return;
 	}
 
-	uint16_t descno = virtio_alloc_desc(vdev, TX_QUEUE_1,
-	    &virtio_net->tx_free_head);
+	virtio_net_pair_t *pair = virtio_net_tx_pair(virtio_net, frame, size);
+
+	uint16_t descno = virtio_alloc_desc(vdev, pair->tx_num,
+	    &pair->tx_free_head);
 	if (descno == (uint16_t) -1U) {
 		ddf_msg(LVL_WARN, "No TX buffers available, frame dropped");
 		return;
@@ -343,20 +618,44 @@ static void virtio_net_send(nic_t *nic, void *data, size_t size)
 	assert(descno < TX_BUFFERS);
 
 	/* Setup the packet header */
-	virtio_net_hdr_t *hdr = (virtio_net_hdr_t *) virtio_net->tx_buf[descno];
+	virtio_net_hdr_t *hdr = (virtio_net_hdr_t *) pair->tx_buf[descno];
 	memset(hdr, 0, sizeof(virtio_net_hdr_t));
 	hdr->gso_type = VIRTIO_NET_HDR_GSO_NONE;
 	hdr->num_buffers = 0;
 
+	if (offload != NULL && (offload->flags & INET_OFFLOAD_CSUM) != 0) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = host2uint16_t_le(offload->csum_start);
+		hdr->csum_offset = host2uint16_t_le(offload->csum_offset);
+	}
+
+	if (offload != NULL && (offload->flags & INET_OFFLOAD_TSO) != 0 &&
+	    offload->csum_start + 13u <= size) {
+		uint16_t etype = ((uint16_t) frame[12] << 8) | frame[13];
+		/* Headers replicated in each segment end with TCP header */
+		size_t thdr_size = (frame[offload->csum_start + 12] >> 4) * 4;
+
+		hdr->gso_type = (etype == ETYPE_IPV6) ?
+		    VIRTIO_NET_HDR_GSO_TCPV6 : VIRTIO_NET_HDR_GSO_TCPV4;
+		hdr->gso_size = host2uint16_t_le(offload->gso_size);
+		hdr->hdr_len = host2uint16_t_le(offload->csum_start +
+		    thdr_size);
+	}
+
 	/* Copy packet data into the buffer just past the header */
 	memcpy(&hdr[1], data, size);
 
 	/*
 	 * Set the descriptor, put it into the virtqueue and notify the device
 	 */
-	virtio_virtq_desc_set(vdev, TX_QUEUE_1, descno,
-	    virtio_net->tx_buf_p[descno], sizeof(virtio_net_hdr_t) + size, 0, 0);
-	virtio_virtq_produce_available(vdev, TX_QUEUE_1, descno);
+	virtio_virtq_desc_set(vdev, pair->tx_num, descno,
+	    pair->tx_buf_p[descno], sizeof(virtio_net_hdr_t) + size, 0, 0);
+	virtio_virtq_produce_available(vdev, pair->tx_num, descno);
+}
+
+static void virtio_net_send(nic_t *nic, void *data, size_t size)
+{
+	virtio_net_send_offload(nic, data, size, NULL);
 }
 
 static errno_t virtio_net_on_multicast_mode_change(nic_t *nic,
@@ -411,6 +710,7 @@ static errno_t virtio_net_dev_add(ddf_dev_t *dev)
 	ddf_fun_set_ops(fun, &virtio_net_dev_ops);
 
 	nic_set_send_frame_handler(nic, virtio_net_send);
+	nic_set_send_frame_offload_handler(nic, virtio_net_send_offload);
 	nic_set_filtering_change_handlers(nic, NULL,
 	    virtio_net_on_multicast_mode_change,
 	    virtio_net_on_broadcast_mode_change, NULL, NULL);
@@ -471,10 +771,26 @@ static errno_t virtio_net_get_operation_mode(ddf_fun_t *fun, int *speed,
 	return EOK;
 }
 
+static errno_t virtio_net_offload_probe(ddf_fun_t *fun, uint32_t *supported,
+    uint32_t *active)
+{
+	nic_t *nic = nic_get_from_ddf_fun(fun);
+	if (!nic)
+		return ENOENT;
+
+	virtio_net_t *virtio_net = nic_get_specific(nic);
+
+	/* Offloads are fixed by feature negotiation */
+	*supported = virtio_net->offload;
+	*active = virtio_net->offload;
+	return EOK;
+}
+
 static nic_iface_t virtio_net_nic_iface = {
 	.get_device_info = virtio_net_get_device_info,
 	.get_cable_state = virtio_net_get_cable_state,
 	.get_operation_mode = virtio_net_get_operation_mode,
+	.offload_probe = virtio_net_offload_probe,
 };
 
 int main(void)
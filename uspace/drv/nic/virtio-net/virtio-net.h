@@ -32,21 +32,46 @@
 #include <virtio-pci.h>
 #include <abi/cap.h>
 #include <nic/nic.h>
+#include <nic.h>
 
-#define RX_BUFFERS	8
-#define TX_BUFFERS	8
+/** Number of buffers in each receive, transmit and control virtqueue */
+#define RX_BUFFERS	32
+#define TX_BUFFERS	16
 #define CT_BUFFERS	4
 
+/** Maximum number of receive/transmit queue pairs we use */
+#define VIRTIO_NET_MAX_PAIRS	4
+
 /** Device handles packets with partial checksum. */
 #define VIRTIO_NET_F_CSUM		(1U << 0)
 /** Driver handles packets with partial checksum. */
 #define VIRTIO_NET_F_GUEST_CSUM		(1U << 2)
 /** Device has given MAC address. */
 #define VIRTIO_NET_F_MAC		(1U << 5)
+/** Driver can receive TSOv4. */
+#define VIRTIO_NET_F_GUEST_TSO4		(1U << 7)
+/** Driver can receive TSOv6. */
+#define VIRTIO_NET_F_GUEST_TSO6		(1U << 8)
+/** Device can receive TSOv4. */
+#define VIRTIO_NET_F_HOST_TSO4		(1U << 11)
+/** Device can receive TSOv6. */
+#define VIRTIO_NET_F_HOST_TSO6		(1U << 12)
+/** Driver can merge receive buffers. */
+#define VIRTIO_NET_F_MRG_RXBUF		(1U << 15)
 /** Control channel is available */
 #define VIRTIO_NET_F_CTRL_VQ		(1U << 17)
+/** Device supports multiqueue with automatic receive steering. */
+#define VIRTIO_NET_F_MQ			(1U << 22)
+
+/** Checksum is to be completed from csum_start to the end of the packet */
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM	1
+/** Checksum of the received packet was validated */
+#define VIRTIO_NET_HDR_F_DATA_VALID	2
+
+#define VIRTIO_NET_HDR_GSO_NONE		0
+#define VIRTIO_NET_HDR_GSO_TCPV4	1
+#define VIRTIO_NET_HDR_GSO_TCPV6	4
 
-#define VIRTIO_NET_HDR_GSO_NONE 0
 typedef struct {
 	uint8_t flags;
 	uint8_t gso_type;
@@ -57,22 +82,63 @@ typedef struct {
 	uint16_t num_buffers;
 } virtio_net_hdr_t;
 
+/* Control virtqueue command classes, commands and acknowledgements */
+#define VIRTIO_NET_CTRL_MQ			4
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET		0
+
+#define VIRTIO_NET_OK		0
+#define VIRTIO_NET_ERR		1
+
+typedef struct {
+	uint8_t class;
+	uint8_t command;
+} virtio_net_ctrl_hdr_t;
+
 typedef struct {
 	uint8_t mac[ETH_ADDR];
+	ioport16_t status;
+	ioport16_t max_virtqueue_pairs;
 } virtio_net_cfg_t;
 
+/** Receive/transmit virtqueue pair */
 typedef struct {
-	virtio_dev_t virtio_dev;
+	/** Indices of the receive and transmit virtqueues */
+	uint16_t rx_num;
+	uint16_t tx_num;
+
 	void *rx_buf[RX_BUFFERS];
 	uintptr_t rx_buf_p[RX_BUFFERS];
 	void *tx_buf[TX_BUFFERS];
 	uintptr_t tx_buf_p[TX_BUFFERS];
-	void *ct_buf[CT_BUFFERS];
-	uintptr_t ct_buf_p[CT_BUFFERS];
 
 	uint16_t tx_free_head;
+
+	/** Frame being assembled from mergeable receive buffers */
+	nic_frame_t *rx_frame;
+	/** Receive buffers still belonging to the frame being assembled */
+	uint16_t rx_frame_bufs;
+} virtio_net_pair_t;
+
+typedef struct {
+	virtio_dev_t virtio_dev;
+
+	/** Receive/transmit queue pairs */
+	virtio_net_pair_t *pairs;
+	unsigned num_pairs;
+
+	/** Index of the control virtqueue */
+	uint16_t ct_num;
+	void *ct_buf[CT_BUFFERS];
+	uintptr_t ct_buf_p[CT_BUFFERS];
 	uint16_t ct_free_head;
 
+	/** Size of the receive and transmit buffers */
+	size_t rx_buf_size;
+	size_t tx_buf_size;
+
+	/** Offload capabilities (NIC_OFFLOAD_* flags) */
+	uint32_t offload;
+
 	int irq;
 	cap_irq_handle_t irq_handle;
 } virtio_net_t;
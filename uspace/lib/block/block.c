@@ -46,6 +46,7 @@
 #include <fibril_synch.h>
 #include <adt/list.h>
 #include <adt/hash_table.h>
+#include <align.h>
 #include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
@@ -72,6 +73,12 @@ typedef struct {
 	hash_table_t block_hash;
 	list_t free_list;
 	enum cache_mode mode;
+	block_dirty_hook_t dirty_hook;  /**< Called when releasing dirty blocks */
+	void *dirty_hook_arg;           /**< Argument for dirty_hook */
+	/** Changed whenever a write bypassing the cache starts or ends */
+	uint64_t write_seq;
+	/** Number of writes bypassing the cache in progress */
+	unsigned writes_active;
 } cache_t;
 
 typedef struct {
@@ -83,11 +90,36 @@ typedef struct {
 	aoff64_t bb_addr;
 	aoff64_t pblocks;    /**< Number of physical blocks */
 	size_t pblock_size;  /**< Physical block size. */
+	size_t qdepth;       /**< Number of requests kept in flight. */
 	cache_t *cache;
+	/** Memory pool shared with the device or NULL */
+	void *pool;
+	unsigned pool_id;        /**< ID of the pool at the device. */
+	size_t pool_slot_size;   /**< Size of one transfer slot of the pool. */
+	size_t pool_slots;       /**< Number of transfer slots. */
+	uint32_t pool_busy;      /**< Bitmap of slots in use. */
+	fibril_mutex_t pool_lock;
 } devcon_t;
 
+/** Block transfer in progress */
+typedef struct {
+	bd_aio_t aio;
+	/** Client buffer */
+	void *buf;
+	size_t size;
+	bool write;
+	/** Pool slot holding the data or POOL_NO_SLOT */
+	size_t slot;
+} devcon_xfer_t;
+
+#define POOL_NO_SLOT ((size_t) -1)
+
 static errno_t read_blocks(devcon_t *, aoff64_t, size_t, void *, size_t);
 static errno_t write_blocks(devcon_t *, aoff64_t, size_t, void *, size_t);
+static size_t xfer_blocks(devcon_t *);
+static errno_t devcon_xfer_submit(devcon_t *, aoff64_t, size_t, void *, size_t,
+    bool, devcon_xfer_t *);
+static errno_t devcon_xfer_wait(devcon_t *, devcon_xfer_t *);
 static aoff64_t ba_ltop(devcon_t *, aoff64_t);
 
 static devcon_t *devcon_search(service_id_t service_id)
@@ -106,7 +138,7 @@ static devcon_t *devcon_search(service_id_t service_id)
 }
 
 static errno_t devcon_add(service_id_t service_id, async_sess_t *sess,
-    size_t bsize, aoff64_t dev_size, bd_t *bd)
+    size_t bsize, aoff64_t dev_size, size_t qdepth, bd_t *bd)
 {
 	devcon_t *devcon;
 
@@ -122,7 +154,11 @@ static errno_t devcon_add(service_id_t service_id, async_sess_t *sess,
 	devcon->bb_addr = 0;
 	devcon->pblock_size = bsize;
 	devcon->pblocks = dev_size;
+	devcon->qdepth = qdepth;
 	devcon->cache = NULL;
+	devcon->pool = NULL;
+	devcon->pool_busy = 0;
+	fibril_mutex_initialize(&devcon->pool_lock);
 
 	fibril_mutex_lock(&dcl_lock);
 	list_foreach(dcl, link, devcon_t, d) {
@@ -144,6 +180,53 @@ static void devcon_remove(devcon_t *devcon)
 	fibril_mutex_unlock(&dcl_lock);
 }
 
+/** Share a memory pool with the device.
+ *
+ * The pool has one slot per request kept in flight, each large enough for
+ * the largest transfer. Data are then moved between the device and the
+ * pool directly instead of being copied through IPC at every layer of the
+ * block device stack. Servers which do not support pools are used the
+ * old way.
+ *
+ * @param devcon	Device connection.
+ * @param comm_size	Minimum size of a pool slot.
+ */
+static void devcon_pool_create(devcon_t *devcon, size_t comm_size)
+{
+	size_t slot_size;
+	size_t slots;
+	void *pool;
+
+	slot_size = ALIGN_UP(max(comm_size,
+	    xfer_blocks(devcon) * devcon->pblock_size), PAGE_SIZE);
+	slots = min(devcon->qdepth, BD_QUEUE_DEPTH_MAX);
+
+	pool = as_area_create(AS_AREA_ANY, slots * slot_size,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (pool == AS_MAP_FAILED)
+		return;
+
+	if (bd_pool_share(devcon->bd, pool, &devcon->pool_id) != EOK) {
+		as_area_destroy(pool);
+		return;
+	}
+
+	devcon->pool_slot_size = slot_size;
+	devcon->pool_slots = slots;
+	devcon->pool = pool;
+}
+
+/** Stop sharing the memory pool with the device. */
+static void devcon_pool_destroy(devcon_t *devcon)
+{
+	if (devcon->pool == NULL)
+		return;
+
+	(void) bd_pool_unshare(devcon->bd, devcon->pool_id);
+	as_area_destroy(devcon->pool);
+	devcon->pool = NULL;
+}
+
 errno_t block_init(service_id_t service_id, size_t comm_size)
 {
 	bd_t *bd;
@@ -176,13 +259,22 @@ errno_t block_init(service_id_t service_id, size_t comm_size)
 		return rc;
 	}
 
-	rc = devcon_add(service_id, sess, bsize, dev_size, bd);
+	/*
+	 * Servers which cannot execute several transfers at once
+	 * do not implement the request.
+	 */
+	size_t qdepth;
+	if (bd_get_queue_depth(bd, BD_QUEUE_DEPTH_MAX, &qdepth) != EOK)
+		qdepth = 1;
+
+	rc = devcon_add(service_id, sess, bsize, dev_size, qdepth, bd);
 	if (rc != EOK) {
 		bd_close(bd);
 		async_hangup(sess);
 		return rc;
 	}
 
+	devcon_pool_create(devcon_search(service_id), comm_size);
 	return EOK;
 }
 
@@ -201,6 +293,7 @@ void block_fini(service_id_t service_id)
 	if (devcon->bb_buf)
 		free(devcon->bb_buf);
 
+	devcon_pool_destroy(devcon);
 	bd_close(devcon->bd);
 	async_hangup(devcon->sess);
 
@@ -286,6 +379,10 @@ errno_t block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
 	cache->block_count = blocks;
 	cache->blocks_cached = 0;
 	cache->mode = mode;
+	cache->dirty_hook = NULL;
+	cache->dirty_hook_arg = NULL;
+	cache->write_seq = 0;
+	cache->writes_active = 0;
 
 	/* Allow 1:1 or small-to-large block size translation */
 	if (cache->lblock_size % devcon->pblock_size != 0) {
@@ -346,6 +443,33 @@ errno_t block_cache_fini(service_id_t service_id)
 	return EOK;
 }
 
+/** Set hook called whenever a dirty block is released.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param hook		Hook to call or NULL to remove the hook.
+ * @param arg		Argument passed to the hook.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_cache_set_dirty_hook(service_id_t service_id,
+    block_dirty_hook_t hook, void *arg)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	cache_t *cache;
+
+	if (!devcon)
+		return ENOENT;
+	if (!devcon->cache)
+		return ENOENT;
+	cache = devcon->cache;
+
+	fibril_mutex_lock(&cache->lock);
+	cache->dirty_hook = hook;
+	cache->dirty_hook_arg = arg;
+	fibril_mutex_unlock(&cache->lock);
+	return EOK;
+}
+
 #define CACHE_LO_WATERMARK	10
 #define CACHE_HI_WATERMARK	20
 static bool cache_can_grow(cache_t *cache)
@@ -368,45 +492,32 @@ static void block_initialize(block_t *b)
 	link_initialize(&b->free_link);
 }
 
-/** Instantiate a block in memory and get a reference to it.
+/** Look up a block in the cache or instantiate it.
  *
- * @param block			Pointer to where the function will store the
- * 				block pointer on success.
- * @param service_id		Service ID of the block device.
- * @param ba			Block address (logical).
- * @param flags			If BLOCK_FLAGS_NOREAD is specified, block_get()
- * 				will not read the contents of the block from the
- *				device.
+ * @param devcon	Device connection.
+ * @param ba		Block address (logical).
+ * @param block		Place to store the referenced block or NULL if
+ *			no block could be instantiated.
+ * @param fresh		Place to store true if the block has just been
+ *			instantiated. Such a block is returned locked and
+ *			its contents are not valid yet.
+ * @param seq		If not NULL, a block which is not cached is only
+ *			instantiated if cache->write_seq still equals
+ *			@a *seq, i.e. no write bypassing the cache has
+ *			started or ended since @a *seq was sampled.
  *
- * @return			EOK on success or an error code.
+ * @return		EOK on success, EIO if the cached block is toxic,
+ *			ENOMEM if there is no block to recycle or EAGAIN
+ *			if @a seq is out of date.
  */
-errno_t block_get(block_t **block, service_id_t service_id, aoff64_t ba, int flags)
+static errno_t block_instantiate(devcon_t *devcon, aoff64_t ba,
+    block_t **block, bool *fresh, const uint64_t *seq)
 {
-	devcon_t *devcon;
-	cache_t *cache;
+	cache_t *cache = devcon->cache;
 	block_t *b;
 	link_t *link;
-	aoff64_t p_ba;
 	errno_t rc;
 
-	devcon = devcon_search(service_id);
-
-	assert(devcon);
-	assert(devcon->cache);
-
-	cache = devcon->cache;
-
-	/*
-	 * Check whether the logical block (or part of it) is beyond
-	 * the end of the device or not.
-	 */
-	p_ba = ba_ltop(devcon, ba);
-	p_ba += cache->blocks_cluster;
-	if (p_ba >= devcon->pblocks) {
-		/* This request cannot be satisfied */
-		return EIO;
-	}
-
 retry:
 	rc = EOK;
 	b = NULL;
@@ -426,10 +537,17 @@ retry:
 			rc = EIO;
 		fibril_mutex_unlock(&b->lock);
 		fibril_mutex_unlock(&cache->lock);
+		*fresh = false;
 	} else {
 		/*
 		 * The block was not found in the cache.
 		 */
+		if (seq != NULL && cache->write_seq != *seq) {
+			fibril_mutex_unlock(&cache->lock);
+			*block = NULL;
+			return EAGAIN;
+		}
+
 		if (cache_can_grow(cache)) {
 			/*
 			 * We can grow the cache by allocating new blocks.
@@ -453,8 +571,8 @@ retry:
 		recycle:
 			if (list_empty(&cache->free_list)) {
 				fibril_mutex_unlock(&cache->lock);
-				rc = ENOMEM;
-				goto out;
+				*block = NULL;
+				return ENOMEM;
 			}
 			link = list_first(&cache->free_list);
 			b = list_get_instance(link, block_t, free_link);
@@ -518,6 +636,12 @@ retry:
 					fibril_mutex_unlock(&b->lock);
 					goto found;
 				}
+				if (seq != NULL && cache->write_seq != *seq) {
+					fibril_mutex_unlock(&b->lock);
+					fibril_mutex_unlock(&cache->lock);
+					*block = NULL;
+					return EAGAIN;
+				}
 
 			}
 			fibril_mutex_unlock(&b->lock);
@@ -531,7 +655,7 @@ retry:
 		}
 
 		block_initialize(b);
-		b->service_id = service_id;
+		b->service_id = devcon->service_id;
 		b->size = cache->lblock_size;
 		b->lba = ba;
 		b->pba = ba_ltop(devcon, b->lba);
@@ -544,7 +668,54 @@ retry:
 		 */
 		fibril_mutex_lock(&b->lock);
 		fibril_mutex_unlock(&cache->lock);
+		*fresh = true;
+	}
+
+	*block = b;
+	return rc;
+}
+
+/** Instantiate a block in memory and get a reference to it.
+ *
+ * @param block			Pointer to where the function will store the
+ * 				block pointer on success.
+ * @param service_id		Service ID of the block device.
+ * @param ba			Block address (logical).
+ * @param flags			If BLOCK_FLAGS_NOREAD is specified, block_get()
+ * 				will not read the contents of the block from the
+ *				device.
+ *
+ * @return			EOK on success or an error code.
+ */
+errno_t block_get(block_t **block, service_id_t service_id, aoff64_t ba, int flags)
+{
+	devcon_t *devcon;
+	cache_t *cache;
+	block_t *b;
+	aoff64_t p_ba;
+	bool fresh;
+	errno_t rc;
 
+	devcon = devcon_search(service_id);
+
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+
+	/*
+	 * Check whether the logical block (or part of it) is beyond
+	 * the end of the device or not.
+	 */
+	p_ba = ba_ltop(devcon, ba);
+	p_ba += cache->blocks_cluster;
+	if (p_ba >= devcon->pblocks) {
+		/* This request cannot be satisfied */
+		return EIO;
+	}
+
+	rc = block_instantiate(devcon, ba, &b, &fresh, NULL);
+	if (b != NULL && fresh) {
 		if (!(flags & BLOCK_FLAGS_NOREAD)) {
 			/*
 			 * The block contains old or no data. We need to read
@@ -559,7 +730,7 @@ retry:
 
 		fibril_mutex_unlock(&b->lock);
 	}
-out:
+
 	if ((rc != EOK) && b) {
 		assert(b->toxic);
 		(void) block_put(b);
@@ -569,6 +740,119 @@ out:
 	return rc;
 }
 
+/** Wait for read-ahead transfers and move the data into the cache.
+ *
+ * Blocks which have been instantiated by someone else in the meantime
+ * are left alone, their data may be newer than what has been read.
+ * The data are dropped if a write bypassing the cache started or ended
+ * after the transfer was submitted, as the data may predate the write.
+ *
+ * @param devcon	Device connection.
+ * @param ba		Addresses of the blocks (logical).
+ * @param seq		Values of cache->write_seq when submitting transfers.
+ * @param buf		Buffer with the data of the blocks.
+ * @param xfer		Transfers of the blocks.
+ * @param cnt		Number of blocks.
+ */
+static void block_readahead_wait(devcon_t *devcon, aoff64_t *ba,
+    uint64_t *seq, void *buf, devcon_xfer_t *xfer, size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	block_t *b;
+	bool fresh;
+
+	for (size_t i = 0; i < cnt; i++) {
+		if (devcon_xfer_wait(devcon, &xfer[i]) != EOK)
+			continue;
+
+		(void) block_instantiate(devcon, ba[i], &b, &fresh, &seq[i]);
+		if (b == NULL)
+			continue;
+
+		if (fresh) {
+			memcpy(b->data, buf + i * cache->lblock_size,
+			    cache->lblock_size);
+			fibril_mutex_unlock(&b->lock);
+		}
+
+		(void) block_put(b);
+	}
+}
+
+/** Read a range of blocks into the cache.
+ *
+ * Blocks which are not cached yet are read using up to the negotiated
+ * number of concurrent device requests, so that subsequent block_get()
+ * calls find them in the cache. Blocks already cached are left alone.
+ * No block is kept locked while the transfers are in progress.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ *
+ * @return		EOK on success or an error code.
+ */
+errno_t block_readahead(service_id_t service_id, aoff64_t ba, size_t cnt)
+{
+	aoff64_t lba[BD_QUEUE_DEPTH_MAX];
+	uint64_t seq[BD_QUEUE_DEPTH_MAX];
+	devcon_xfer_t xfer[BD_QUEUE_DEPTH_MAX];
+	devcon_t *devcon;
+	cache_t *cache;
+	size_t qdepth;
+	size_t n = 0;
+	void *buf;
+	errno_t rc = EOK;
+
+	devcon = devcon_search(service_id);
+
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+	qdepth = min(devcon->qdepth, BD_QUEUE_DEPTH_MAX);
+
+	buf = malloc(qdepth * cache->lblock_size);
+	if (buf == NULL)
+		return ENOMEM;
+
+	for (size_t i = 0; i < cnt; i++) {
+		aoff64_t key = ba + i;
+		aoff64_t pba = ba_ltop(devcon, key);
+		if (pba + cache->blocks_cluster >= devcon->pblocks)
+			break;
+
+		/*
+		 * Skip blocks which are cached. Also skip blocks while a write
+		 * bypassing the cache is in progress, reading them could
+		 * return data older than the write.
+		 */
+		fibril_mutex_lock(&cache->lock);
+		bool cached = hash_table_find(&cache->block_hash, &key) != NULL;
+		bool writing = cache->writes_active > 0;
+		seq[n] = cache->write_seq;
+		fibril_mutex_unlock(&cache->lock);
+		if (cached || writing)
+			continue;
+
+		rc = devcon_xfer_submit(devcon, pba, cache->blocks_cluster,
+		    buf + n * cache->lblock_size, cache->lblock_size, false,
+		    &xfer[n]);
+		if (rc != EOK)
+			break;
+
+		lba[n++] = key;
+		if (n == qdepth) {
+			block_readahead_wait(devcon, lba, seq, buf, xfer, n);
+			n = 0;
+		}
+	}
+
+	block_readahead_wait(devcon, lba, seq, buf, xfer, n);
+	free(buf);
+	return rc;
+}
+
 /** Release a reference to a block.
  *
  * If the last reference is dropped, the block is put on the free list.
@@ -583,6 +867,7 @@ errno_t block_put(block_t *block)
 	cache_t *cache;
 	unsigned blocks_cached;
 	enum cache_mode mode;
+	errno_t hook_rc = EOK;
 	errno_t rc = EOK;
 
 	assert(devcon);
@@ -591,6 +876,15 @@ errno_t block_put(block_t *block)
 
 	cache = devcon->cache;
 
+	/*
+	 * Let the hook take over the modified block before the reference is
+	 * dropped. The hook may acquire its own reference to the block, in
+	 * which case the block is not written back below. If the hook fails,
+	 * the block is released as usual and the error is reported.
+	 */
+	if (cache->dirty_hook != NULL && block->dirty && !block->toxic)
+		hook_rc = cache->dirty_hook(cache->dirty_hook_arg, block);
+
 retry:
 	fibril_mutex_lock(&cache->lock);
 	blocks_cached = cache->blocks_cached;
@@ -660,7 +954,7 @@ retry:
 			free(block);
 			cache->blocks_cached--;
 			fibril_mutex_unlock(&cache->lock);
-			return rc;
+			return (rc != EOK) ? rc : hook_rc;
 		}
 		/*
 		 * Put the block on the free list.
@@ -680,7 +974,7 @@ retry:
 	fibril_mutex_unlock(&block->lock);
 	fibril_mutex_unlock(&cache->lock);
 
-	return rc;
+	return (rc != EOK) ? rc : hook_rc;
 }
 
 /** Read sequential data from a block device.
@@ -787,6 +1081,240 @@ errno_t block_write_direct(service_id_t service_id, aoff64_t ba, size_t cnt,
 	return write_blocks(devcon, ba, cnt, (void *)data, devcon->pblock_size * cnt);
 }
 
+/** Maximum number of physical blocks moved in one transfer. */
+static size_t xfer_blocks(devcon_t *devcon)
+{
+	return max(DATA_XFER_LIMIT / devcon->pblock_size, 1);
+}
+
+/** Transfer a range of physical blocks in as few requests as possible.
+ *
+ * The range is split into transfers of at most xfer_blocks() blocks and
+ * up to the negotiated queue depth of them are kept in flight at once.
+ *
+ * @param devcon	Device connection.
+ * @param pba		Address of first block (physical).
+ * @param cnt		Number of blocks.
+ * @param buf		Data buffer.
+ * @param write		Write the data instead of reading them.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+static errno_t xfer_range(devcon_t *devcon, aoff64_t pba, size_t cnt,
+    void *buf, bool write)
+{
+	devcon_xfer_t xfer[BD_QUEUE_DEPTH_MAX];
+	size_t max_blocks = xfer_blocks(devcon);
+	size_t qdepth = min(devcon->qdepth, BD_QUEUE_DEPTH_MAX);
+	size_t head = 0;
+	size_t tail = 0;
+	errno_t rc = EOK;
+
+	if (qdepth <= 1 || cnt <= max_blocks) {
+		/* Nothing to overlap */
+		while (cnt > 0) {
+			size_t blocks = min(cnt, max_blocks);
+			size_t size = blocks * devcon->pblock_size;
+
+			if (write)
+				rc = write_blocks(devcon, pba, blocks, buf, size);
+			else
+				rc = read_blocks(devcon, pba, blocks, buf, size);
+			if (rc != EOK)
+				return rc;
+
+			pba += blocks;
+			buf += size;
+			cnt -= blocks;
+		}
+
+		return EOK;
+	}
+
+	while (cnt > 0 || tail < head) {
+		if (cnt > 0 && rc == EOK && head - tail < qdepth) {
+			size_t blocks = min(cnt, max_blocks);
+			size_t size = blocks * devcon->pblock_size;
+			rc = devcon_xfer_submit(devcon, pba, blocks, buf, size,
+			    write, &xfer[head % BD_QUEUE_DEPTH_MAX]);
+
+			if (rc == EOK)
+				head++;
+
+			pba += blocks;
+			buf += size;
+			cnt -= blocks;
+			continue;
+		}
+
+		if (rc != EOK)
+			cnt = 0;
+
+		if (tail < head) {
+			errno_t xrc = devcon_xfer_wait(devcon,
+			    &xfer[tail % BD_QUEUE_DEPTH_MAX]);
+			if (xrc != EOK && rc == EOK)
+				rc = xrc;
+			tail++;
+		}
+	}
+
+	if (rc != EOK) {
+		printf("Error %s %s blocks of device handle %" PRIun "\n",
+		    str_error_name(rc), write ? "writing" : "reading",
+		    devcon->service_id);
+	}
+
+	return rc;
+}
+
+/** Write back dirty cached blocks in a range of logical blocks.
+ *
+ * @param devcon	Device connection.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+static errno_t cache_sync_range(devcon_t *devcon, aoff64_t ba, size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	errno_t rc = EOK;
+
+	for (size_t i = 0; i < cnt; i++) {
+		aoff64_t lba = ba + i;
+
+		fibril_mutex_lock(&cache->lock);
+		ht_link_t *hlink = hash_table_find(&cache->block_hash, &lba);
+		if (hlink == NULL) {
+			fibril_mutex_unlock(&cache->lock);
+			continue;
+		}
+
+		block_t *b = hash_table_get_inst(hlink, block_t, hash_link);
+		fibril_mutex_lock(&b->lock);
+		fibril_mutex_unlock(&cache->lock);
+
+		if (b->dirty && !b->toxic) {
+			rc = write_blocks(devcon, b->pba, cache->blocks_cluster,
+			    b->data, b->size);
+			if (rc == EOK) {
+				b->write_failures = 0;
+				b->dirty = false;
+			}
+		}
+
+		fibril_mutex_unlock(&b->lock);
+
+		if (rc != EOK)
+			break;
+	}
+
+	return rc;
+}
+
+/** Read a range of logical blocks bypassing the cache.
+ *
+ * The data are transferred directly from the device using as few
+ * requests as possible. Dirty blocks of the range held in the cache
+ * are written back first so that the result is coherent with
+ * block_get().
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param buf		Buffer for storing the data.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_read_range(service_id_t service_id, aoff64_t ba, size_t cnt,
+    void *buf)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache_t *cache = devcon->cache;
+
+	if (ba_ltop(devcon, ba + cnt) > devcon->pblocks)
+		return EIO;
+
+	if (cache->mode == CACHE_MODE_WB) {
+		errno_t rc = cache_sync_range(devcon, ba, cnt);
+		if (rc != EOK)
+			return rc;
+	}
+
+	return xfer_range(devcon, ba_ltop(devcon, ba),
+	    cnt * cache->blocks_cluster, buf, false);
+}
+
+/** Write a range of logical blocks bypassing the cache.
+ *
+ * The data are transferred directly to the device using as few
+ * requests as possible. Copies of the blocks held in the cache
+ * are updated with the new contents (and become clean) before
+ * the device is written so that a concurrent write-back cannot
+ * overwrite the new data. Read-ahead transfers overlapping the write
+ * are prevented from entering the cache (see block_readahead()).
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param data		The data to be written.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_write_range(service_id_t service_id, aoff64_t ba, size_t cnt,
+    const void *data)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache_t *cache = devcon->cache;
+
+	if (ba_ltop(devcon, ba + cnt) > devcon->pblocks)
+		return EIO;
+
+	fibril_mutex_lock(&cache->lock);
+	cache->write_seq++;
+	cache->writes_active++;
+	fibril_mutex_unlock(&cache->lock);
+
+	for (size_t i = 0; i < cnt; i++) {
+		aoff64_t lba = ba + i;
+
+		fibril_mutex_lock(&cache->lock);
+		ht_link_t *hlink = hash_table_find(&cache->block_hash, &lba);
+		if (hlink != NULL) {
+			block_t *b = hash_table_get_inst(hlink, block_t,
+			    hash_link);
+
+			fibril_mutex_lock(&b->lock);
+			/* The data may come right from the cached block */
+			if (b->data != data + i * cache->lblock_size) {
+				memcpy(b->data, data + i * cache->lblock_size,
+				    cache->lblock_size);
+			}
+			b->dirty = false;
+			b->toxic = false;
+			fibril_mutex_unlock(&b->lock);
+		}
+		fibril_mutex_unlock(&cache->lock);
+	}
+
+	errno_t rc = xfer_range(devcon, ba_ltop(devcon, ba),
+	    cnt * cache->blocks_cluster, (void *) data, true);
+
+	fibril_mutex_lock(&cache->lock);
+	cache->write_seq++;
+	cache->writes_active--;
+	fibril_mutex_unlock(&cache->lock);
+
+	return rc;
+}
+
 /** Synchronize blocks to persistent storage.
  *
  * @param service_id	Service ID of the block device.
@@ -837,6 +1365,110 @@ errno_t block_get_nblocks(service_id_t service_id, aoff64_t *nblocks)
 	return bd_get_num_blocks(devcon->bd, nblocks);
 }
 
+/** Get number of transfers kept in flight on the device.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param qdepth	Output queue depth negotiated with the device.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_get_queue_depth(service_id_t service_id, size_t *qdepth)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	assert(devcon);
+
+	*qdepth = devcon->qdepth;
+	return EOK;
+}
+
+/** Pass a shared memory pool on to the device.
+ *
+ * Used by servers stacked on top of another block device, the pool
+ * received from a client is shared with the device below so that data
+ * move between the client and the bottom device without being copied
+ * at each layer.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param pool		Start of the address space area.
+ * @param id		Place to store ID of the pool at the device.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_pool_attach(service_id_t service_id, void *pool, unsigned *id)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	assert(devcon);
+
+	return bd_pool_share(devcon->bd, pool, id);
+}
+
+/** Stop sharing a memory pool with the device.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param id		ID of the pool at the device.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_pool_detach(service_id_t service_id, unsigned id)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	assert(devcon);
+
+	return bd_pool_unshare(devcon->bd, id);
+}
+
+/** Read blocks directly into a pool shared with the device (bypass cache).
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (physical).
+ * @param cnt		Number of blocks.
+ * @param id		ID of the pool at the device.
+ * @param off		Offset of the data in the pool.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_pool_read(service_id_t service_id, aoff64_t ba, size_t cnt,
+    unsigned id, size_t off)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	bd_aio_t aio;
+	errno_t rc;
+
+	assert(devcon);
+
+	rc = bd_pool_read_blocks_submit(devcon->bd, ba, cnt, id, off, &aio);
+	if (rc != EOK)
+		return rc;
+
+	return bd_aio_wait(&aio);
+}
+
+/** Write blocks directly from a pool shared with the device (bypass cache).
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (physical).
+ * @param cnt		Number of blocks.
+ * @param id		ID of the pool at the device.
+ * @param off		Offset of the data in the pool.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_pool_write(service_id_t service_id, aoff64_t ba, size_t cnt,
+    unsigned id, size_t off)
+{
+	devcon_t *devcon = devcon_search(service_id);
+	bd_aio_t aio;
+	errno_t rc;
+
+	assert(devcon);
+
+	rc = bd_pool_write_blocks_submit(devcon->bd, ba, cnt, id, off, &aio);
+	if (rc != EOK)
+		return rc;
+
+	return bd_aio_wait(&aio);
+}
+
 /** Read bytes directly from the device (bypass cache)
  *
  * @param service_id	Service ID of the block device.
@@ -907,6 +1539,98 @@ errno_t block_read_toc(service_id_t service_id, uint8_t session, void *buf,
 	return bd_read_toc(devcon->bd, session, buf, bufsize);
 }
 
+/** Start a block transfer.
+ *
+ * The data go through a free slot of the shared pool if there is one,
+ * otherwise they are copied by IPC. No slot is waited for, a fibril
+ * holding slots of several pipelined transfers could deadlock otherwise.
+ *
+ * @param devcon	Device connection.
+ * @param ba		Address of first block (physical).
+ * @param cnt		Number of blocks.
+ * @param buf		Data buffer, valid until devcon_xfer_wait().
+ * @param size		Size of the buffer.
+ * @param write		Write the data instead of reading them.
+ * @param x		Transfer structure to be passed to devcon_xfer_wait().
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+static errno_t devcon_xfer_submit(devcon_t *devcon, aoff64_t ba, size_t cnt,
+    void *buf, size_t size, bool write, devcon_xfer_t *x)
+{
+	errno_t rc;
+
+	x->buf = buf;
+	x->size = size;
+	x->write = write;
+	x->slot = POOL_NO_SLOT;
+
+	if (devcon->pool != NULL && size == cnt * devcon->pblock_size &&
+	    size <= devcon->pool_slot_size) {
+		fibril_mutex_lock(&devcon->pool_lock);
+		for (size_t i = 0; i < devcon->pool_slots; i++) {
+			if ((devcon->pool_busy & ((uint32_t) 1 << i)) == 0) {
+				devcon->pool_busy |= (uint32_t) 1 << i;
+				x->slot = i;
+				break;
+			}
+		}
+		fibril_mutex_unlock(&devcon->pool_lock);
+	}
+
+	if (x->slot == POOL_NO_SLOT) {
+		if (write)
+			return bd_write_blocks_submit(devcon->bd, ba, cnt, buf,
+			    size, &x->aio);
+		else
+			return bd_read_blocks_submit(devcon->bd, ba, cnt, buf,
+			    size, &x->aio);
+	}
+
+	size_t off = x->slot * devcon->pool_slot_size;
+	if (write) {
+		memcpy(devcon->pool + off, buf, size);
+		rc = bd_pool_write_blocks_submit(devcon->bd, ba, cnt,
+		    devcon->pool_id, off, &x->aio);
+	} else {
+		rc = bd_pool_read_blocks_submit(devcon->bd, ba, cnt,
+		    devcon->pool_id, off, &x->aio);
+	}
+
+	if (rc != EOK) {
+		fibril_mutex_lock(&devcon->pool_lock);
+		devcon->pool_busy &= ~((uint32_t) 1 << x->slot);
+		fibril_mutex_unlock(&devcon->pool_lock);
+	}
+
+	return rc;
+}
+
+/** Wait for a block transfer to complete.
+ *
+ * @param devcon	Device connection.
+ * @param x		Transfer started by devcon_xfer_submit().
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+static errno_t devcon_xfer_wait(devcon_t *devcon, devcon_xfer_t *x)
+{
+	errno_t rc = bd_aio_wait(&x->aio);
+
+	if (x->slot != POOL_NO_SLOT) {
+		if (rc == EOK && !x->write) {
+			memcpy(x->buf, devcon->pool +
+			    x->slot * devcon->pool_slot_size, x->size);
+		}
+
+		fibril_mutex_lock(&devcon->pool_lock);
+		devcon->pool_busy &= ~((uint32_t) 1 << x->slot);
+		fibril_mutex_unlock(&devcon->pool_lock);
+	}
+
+	return rc;
+}
+
 /** Read blocks from block device.
  *
  * @param devcon	Device connection.
@@ -921,7 +1645,10 @@ static errno_t read_blocks(devcon_t *devcon, aoff64_t ba, size_t cnt, void *buf,
 {
 	assert(devcon);
 
-	errno_t rc = bd_read_blocks(devcon->bd, ba, cnt, buf, size);
+	devcon_xfer_t x;
+	errno_t rc = devcon_xfer_submit(devcon, ba, cnt, buf, size, false, &x);
+	if (rc == EOK)
+		rc = devcon_xfer_wait(devcon, &x);
 	if (rc != EOK) {
 		printf("Error %s reading %zu blocks starting at block %" PRIuOFF64
 		    " from device handle %" PRIun "\n", str_error_name(rc), cnt, ba,
@@ -948,7 +1675,10 @@ static errno_t write_blocks(devcon_t *devcon, aoff64_t ba, size_t cnt, void *dat
 {
 	assert(devcon);
 
-	errno_t rc = bd_write_blocks(devcon->bd, ba, cnt, data, size);
+	devcon_xfer_t x;
+	errno_t rc = devcon_xfer_submit(devcon, ba, cnt, data, size, true, &x);
+	if (rc == EOK)
+		rc = devcon_xfer_wait(devcon, &x);
 	if (rc != EOK) {
 		printf("Error %s writing %zu blocks starting at block %" PRIuOFF64
 		    " to device handle %" PRIun "\n", str_error_name(rc), cnt, ba, devcon->service_id);
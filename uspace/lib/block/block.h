@@ -98,6 +98,15 @@ enum cache_mode {
 	CACHE_MODE_WB
 };
 
+/** Callback invoked when a modified block is being released.
+ *
+ * The callback is called from block_put() before the reference is dropped
+ * and may take its own reference to the block in order to hold it back
+ * from being written back (e.g. until a journal transaction commits).
+ * An error returned by the callback is returned by block_put().
+ */
+typedef errno_t (*block_dirty_hook_t)(void *, block_t *);
+
 extern errno_t block_init(service_id_t, size_t);
 extern void block_fini(service_id_t);
 
@@ -106,20 +115,32 @@ extern void *block_bb_get(service_id_t);
 
 extern errno_t block_cache_init(service_id_t, size_t, unsigned, enum cache_mode);
 extern errno_t block_cache_fini(service_id_t);
+extern errno_t block_cache_set_dirty_hook(service_id_t, block_dirty_hook_t,
+    void *);
 
 extern errno_t block_get(block_t **, service_id_t, aoff64_t, int);
 extern errno_t block_put(block_t *);
+extern errno_t block_readahead(service_id_t, aoff64_t, size_t);
 
 extern errno_t block_seqread(service_id_t, void *, size_t *, size_t *, aoff64_t *,
     void *, size_t);
 
 extern errno_t block_get_bsize(service_id_t, size_t *);
 extern errno_t block_get_nblocks(service_id_t, aoff64_t *);
+extern errno_t block_get_queue_depth(service_id_t, size_t *);
 extern errno_t block_read_toc(service_id_t, uint8_t, void *, size_t);
 extern errno_t block_read_direct(service_id_t, aoff64_t, size_t, void *);
 extern errno_t block_read_bytes_direct(service_id_t, aoff64_t, size_t, void *);
 extern errno_t block_write_direct(service_id_t, aoff64_t, size_t, const void *);
+extern errno_t block_read_range(service_id_t, aoff64_t, size_t, void *);
+extern errno_t block_write_range(service_id_t, aoff64_t, size_t, const void *);
 extern errno_t block_sync_cache(service_id_t, aoff64_t, size_t);
+extern errno_t block_pool_attach(service_id_t, void *, unsigned *);
+extern errno_t block_pool_detach(service_id_t, unsigned);
+extern errno_t block_pool_read(service_id_t, aoff64_t, size_t, unsigned,
+    size_t);
+extern errno_t block_pool_write(service_id_t, aoff64_t, size_t, unsigned,
+    size_t);
 
 #endif
 
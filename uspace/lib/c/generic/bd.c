@@ -34,6 +34,7 @@
  * @brief Block device client interface
  */
 
+#include <as.h>
 #include <async.h>
 #include <assert.h>
 #include <bd.h>
@@ -84,26 +85,14 @@ void bd_close(bd_t *bd)
 
 errno_t bd_read_blocks(bd_t *bd, aoff64_t ba, size_t cnt, void *data, size_t size)
 {
-	async_exch_t *exch = async_exchange_begin(bd->sess);
+	bd_aio_t aio;
+	errno_t rc;
 
-	ipc_call_t answer;
-	aid_t req = async_send_3(exch, BD_READ_BLOCKS, LOWER32(ba),
-	    UPPER32(ba), cnt, &answer);
-	errno_t rc = async_data_read_start(exch, data, size);
-	async_exchange_end(exch);
-
-	if (rc != EOK) {
-		async_forget(req);
+	rc = bd_read_blocks_submit(bd, ba, cnt, data, size, &aio);
+	if (rc != EOK)
 		return rc;
-	}
 
-	errno_t retval;
-	async_wait_for(req, &retval);
-
-	if (retval != EOK)
-		return retval;
-
-	return EOK;
+	return bd_aio_wait(&aio);
 }
 
 errno_t bd_read_toc(bd_t *bd, uint8_t session, void *buf, size_t size)
@@ -132,25 +121,173 @@ errno_t bd_read_toc(bd_t *bd, uint8_t session, void *buf, size_t size)
 errno_t bd_write_blocks(bd_t *bd, aoff64_t ba, size_t cnt, const void *data,
     size_t size)
 {
+	bd_aio_t aio;
+	errno_t rc;
+
+	rc = bd_write_blocks_submit(bd, ba, cnt, data, size, &aio);
+	if (rc != EOK)
+		return rc;
+
+	return bd_aio_wait(&aio);
+}
+
+/** Submit a vectored read without waiting for its completion.
+ *
+ * The blocks are stored into the buffers in turn. Several requests may be
+ * outstanding at the same time, up to the queue depth negotiated with
+ * bd_get_queue_depth(), and they may complete in any order.
+ *
+ * @param bd	Block device
+ * @param ba	Address of the first block
+ * @param cnt	Number of blocks
+ * @param iov	Buffers, which must stay valid until the request is reaped
+ * @param niov	Number of buffers, at most BD_IOV_MAX
+ * @param aio	Request structure to be passed to bd_aio_wait()
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_readv_blocks_submit(bd_t *bd, aoff64_t ba, size_t cnt,
+    const bd_iov_t *iov, size_t niov, bd_aio_t *aio)
+{
+	if (niov == 0 || niov > BD_IOV_MAX)
+		return EINVAL;
+
 	async_exch_t *exch = async_exchange_begin(bd->sess);
 
-	ipc_call_t answer;
-	aid_t req = async_send_3(exch, BD_WRITE_BLOCKS, LOWER32(ba),
-	    UPPER32(ba), cnt, &answer);
-	errno_t rc = async_data_write_start(exch, data, size);
+	/* Plain reads go through the original method old servers know */
+	if (niov == 1) {
+		aio->req = async_send_3(exch, BD_READ_BLOCKS, LOWER32(ba),
+		    UPPER32(ba), cnt, NULL);
+	} else {
+		aio->req = async_send_4(exch, BD_READV_BLOCKS, LOWER32(ba),
+		    UPPER32(ba), cnt, niov, NULL);
+	}
+
+	for (size_t i = 0; i < niov; i++) {
+		aio->xfer[i] = async_data_read(exch, iov[i].buf, iov[i].size,
+		    NULL);
+	}
+
+	async_exchange_end(exch);
+
+	aio->nxfer = niov;
+	return EOK;
+}
+
+/** Submit a read without waiting for its completion.
+ *
+ * @param bd	Block device
+ * @param ba	Address of the first block
+ * @param cnt	Number of blocks
+ * @param data	Buffer, which must stay valid until the request is reaped
+ * @param size	Size of the buffer
+ * @param aio	Request structure to be passed to bd_aio_wait()
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_read_blocks_submit(bd_t *bd, aoff64_t ba, size_t cnt, void *data,
+    size_t size, bd_aio_t *aio)
+{
+	bd_iov_t iov = {
+		.buf = data,
+		.size = size
+	};
+
+	return bd_readv_blocks_submit(bd, ba, cnt, &iov, 1, aio);
+}
+
+/** Submit a vectored write without waiting for its completion.
+ *
+ * The data are handed over to the server before this function returns,
+ * so the buffers can be reused right away.
+ *
+ * @param bd	Block device
+ * @param ba	Address of the first block
+ * @param cnt	Number of blocks
+ * @param iov	Buffers holding the data in turn
+ * @param niov	Number of buffers, at most BD_IOV_MAX
+ * @param aio	Request structure to be passed to bd_aio_wait()
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_writev_blocks_submit(bd_t *bd, aoff64_t ba, size_t cnt,
+    const bd_iov_t *iov, size_t niov, bd_aio_t *aio)
+{
+	errno_t rc = EOK;
+
+	if (niov == 0 || niov > BD_IOV_MAX)
+		return EINVAL;
+
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	if (niov == 1) {
+		aio->req = async_send_3(exch, BD_WRITE_BLOCKS, LOWER32(ba),
+		    UPPER32(ba), cnt, NULL);
+	} else {
+		aio->req = async_send_4(exch, BD_WRITEV_BLOCKS, LOWER32(ba),
+		    UPPER32(ba), cnt, niov, NULL);
+	}
+
+	for (size_t i = 0; i < niov; i++) {
+		rc = async_data_write_start(exch, iov[i].buf, iov[i].size);
+		if (rc != EOK)
+			break;
+	}
+
 	async_exchange_end(exch);
 
 	if (rc != EOK) {
-		async_forget(req);
+		async_forget(aio->req);
 		return rc;
 	}
 
+	aio->nxfer = 0;
+	return EOK;
+}
+
+/** Submit a write without waiting for its completion.
+ *
+ * @param bd	Block device
+ * @param ba	Address of the first block
+ * @param cnt	Number of blocks
+ * @param data	Data to be written
+ * @param size	Size of the data
+ * @param aio	Request structure to be passed to bd_aio_wait()
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_write_blocks_submit(bd_t *bd, aoff64_t ba, size_t cnt,
+    const void *data, size_t size, bd_aio_t *aio)
+{
+	bd_iov_t iov = {
+		.buf = (void *) data,
+		.size = size
+	};
+
+	return bd_writev_blocks_submit(bd, ba, cnt, &iov, 1, aio);
+}
+
+/** Wait for a submitted transfer to complete.
+ *
+ * @param aio	Submitted request
+ *
+ * @return EOK if the transfer succeeded or an error code
+ */
+errno_t bd_aio_wait(bd_aio_t *aio)
+{
+	errno_t xrc = EOK;
 	errno_t retval;
-	async_wait_for(req, &retval);
-	if (retval != EOK)
-		return retval;
 
-	return EOK;
+	for (size_t i = 0; i < aio->nxfer; i++) {
+		async_wait_for(aio->xfer[i], &retval);
+		if (retval != EOK && xrc == EOK)
+			xrc = retval;
+	}
+
+	aio->nxfer = 0;
+	async_wait_for(aio->req, &retval);
+
+	return retval != EOK ? retval : xrc;
 }
 
 errno_t bd_sync_cache(bd_t *bd, aoff64_t ba, size_t cnt)
@@ -195,6 +332,130 @@ errno_t bd_get_num_blocks(bd_t *bd, aoff64_t *rnb)
 	return EOK;
 }
 
+/** Share a memory pool with the server.
+ *
+ * Blocks can then be transferred between the device and the pool without
+ * copying the data through IPC messages. The pool is shared read-write,
+ * so the server and the drivers below it access it directly.
+ *
+ * @param bd	Block device
+ * @param pool	Address space area to share, as returned by as_area_create()
+ * @param rid	Place to store the ID of the pool
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_pool_share(bd_t *bd, void *pool, unsigned *rid)
+{
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	ipc_call_t answer;
+	aid_t req = async_send_0(exch, BD_POOL_SHARE, &answer);
+	errno_t rc = async_share_out_start(exch, pool,
+	    AS_AREA_READ | AS_AREA_WRITE);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		return rc;
+	}
+
+	errno_t retval;
+	async_wait_for(req, &retval);
+	if (retval != EOK)
+		return retval;
+
+	*rid = ipc_get_arg1(&answer);
+	return EOK;
+}
+
+/** Stop sharing a memory pool with the server.
+ *
+ * @param bd	Block device
+ * @param id	ID of the pool
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_pool_unshare(bd_t *bd, unsigned id)
+{
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+	errno_t rc = async_req_1_0(exch, BD_POOL_UNSHARE, id);
+	async_exchange_end(exch);
+
+	return rc;
+}
+
+/** Submit a read into a shared pool without waiting for its completion.
+ *
+ * @param bd	Block device
+ * @param ba	Address of the first block
+ * @param cnt	Number of blocks
+ * @param id	ID of the pool
+ * @param off	Offset of the data in the pool
+ * @param aio	Request structure to be passed to bd_aio_wait()
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_pool_read_blocks_submit(bd_t *bd, aoff64_t ba, size_t cnt,
+    unsigned id, size_t off, bd_aio_t *aio)
+{
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+	aio->req = async_send_5(exch, BD_POOL_READ_BLOCKS, LOWER32(ba),
+	    UPPER32(ba), cnt, id, off, NULL);
+	async_exchange_end(exch);
+
+	aio->nxfer = 0;
+	return EOK;
+}
+
+/** Submit a write from a shared pool without waiting for its completion.
+ *
+ * The data must not be modified until the request is reaped.
+ *
+ * @param bd	Block device
+ * @param ba	Address of the first block
+ * @param cnt	Number of blocks
+ * @param id	ID of the pool
+ * @param off	Offset of the data in the pool
+ * @param aio	Request structure to be passed to bd_aio_wait()
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_pool_write_blocks_submit(bd_t *bd, aoff64_t ba, size_t cnt,
+    unsigned id, size_t off, bd_aio_t *aio)
+{
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+	aio->req = async_send_5(exch, BD_POOL_WRITE_BLOCKS, LOWER32(ba),
+	    UPPER32(ba), cnt, id, off, NULL);
+	async_exchange_end(exch);
+
+	aio->nxfer = 0;
+	return EOK;
+}
+
+/** Negotiate the number of requests which can be queued at the server.
+ *
+ * @param bd	Block device
+ * @param want	Number of requests the client would like to have queued
+ * @param rqd	Place to store the number of requests the server will
+ *		process concurrently
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_get_queue_depth(bd_t *bd, size_t want, size_t *rqd)
+{
+	sysarg_t qd;
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	errno_t rc = async_req_1_1(exch, BD_GET_QUEUE_DEPTH, want, &qd);
+	async_exchange_end(exch);
+
+	if (rc != EOK)
+		return rc;
+
+	*rqd = qd;
+	return EOK;
+}
+
 static void bd_cb_conn(ipc_call_t *icall, void *arg)
 {
 	bd_t *bd = (bd_t *)arg;
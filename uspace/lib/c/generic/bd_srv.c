@@ -33,7 +33,9 @@
  * @file
  * @brief Block device server stub
  */
+#include <as.h>
 #include <errno.h>
+#include <fibril.h>
 #include <ipc/bd.h>
 #include <macros.h>
 #include <stdlib.h>
@@ -42,48 +44,394 @@
 
 #include <bd_srv.h>
 
-static void bd_read_blocks_srv(bd_srv_t *srv, ipc_call_t *call)
-{
+/** Block transfer received from a client */
+typedef struct {
+	bd_srv_t *srv;
+	/** Transfer request */
+	ipc_call_t call;
+	/** Data read requests for the individual buffers of a read */
+	ipc_call_t xfer[BD_IOV_MAX];
+	/** Sizes of the individual buffers */
+	size_t xsize[BD_IOV_MAX];
+	size_t niov;
+	bool read;
 	aoff64_t ba;
 	size_t cnt;
+	/** Data of the whole transfer */
 	void *buf;
 	size_t size;
+	/** Pool holding the data or NULL if the data are transferred by IPC */
+	bd_pool_t *pool;
+	/** Offset of the data in the pool */
+	size_t off;
+} bd_xfer_t;
+
+/** Fail a transfer whose buffers have been received only partially.
+ *
+ * @param x	Transfer
+ * @param nrecv	Number of data read requests received so far
+ * @param rc	Error code to answer with
+ */
+static void bd_xfer_fail(bd_xfer_t *x, size_t nrecv, errno_t rc)
+{
+	for (size_t i = 0; i < nrecv; i++)
+		async_answer_0(&x->xfer[i], rc);
+
+	async_answer_0(&x->call, rc);
+	if (x->pool == NULL)
+		free(x->buf);
+	free(x);
+}
+
+/** Receive the buffers of a read or write transfer.
+ *
+ * This must be done by the connection fibril before it fetches the next
+ * request, because the data transfers are part of the same exchange.
+ *
+ * @param srv	Server structure
+ * @param call	Transfer request
+ * @param read	True for a read, false for a write
+ * @param niov	Number of buffers
+ *
+ * @return	Transfer ready to be executed or NULL if it has been
+ *		answered already
+ */
+static bd_xfer_t *bd_xfer_receive(bd_srv_t *srv, ipc_call_t *call, bool read,
+    size_t niov)
+{
+	bd_xfer_t *x;
+
+	x = calloc(1, sizeof(bd_xfer_t));
+	if (x == NULL) {
+		async_answer_0(call, ENOMEM);
+		return NULL;
+	}
+
+	x->srv = srv;
+	x->call = *call;
+	x->read = read;
+	x->niov = niov;
+	x->ba = MERGE_LOUP32(ipc_get_arg1(call), ipc_get_arg2(call));
+	x->cnt = ipc_get_arg3(call);
+
+	if (niov == 0 || niov > BD_IOV_MAX) {
+		bd_xfer_fail(x, 0, EINVAL);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < niov; i++) {
+		if (read) {
+			if (!async_data_read_receive(&x->xfer[i],
+			    &x->xsize[i])) {
+				/* Answer the unexpected call as well */
+				bd_xfer_fail(x, i + 1, EINVAL);
+				return NULL;
+			}
+
+			x->size += x->xsize[i];
+		} else {
+			ipc_call_t wcall;
+			size_t size;
+			void *nbuf;
+
+			if (!async_data_write_receive(&wcall, &size)) {
+				async_answer_0(&wcall, EINVAL);
+				bd_xfer_fail(x, 0, EINVAL);
+				return NULL;
+			}
+
+			nbuf = realloc(x->buf, x->size + size);
+			if (nbuf == NULL) {
+				async_answer_0(&wcall, ENOMEM);
+				bd_xfer_fail(x, 0, ENOMEM);
+				return NULL;
+			}
+
+			x->buf = nbuf;
+			errno_t rc = async_data_write_finalize(&wcall,
+			    x->buf + x->size, size);
+			if (rc != EOK) {
+				bd_xfer_fail(x, 0, rc);
+				return NULL;
+			}
+
+			x->size += size;
+		}
+	}
+
+	if (read) {
+		x->buf = malloc(x->size);
+		if (x->buf == NULL) {
+			bd_xfer_fail(x, niov, ENOMEM);
+			return NULL;
+		}
+	}
+
+	return x;
+}
+
+/** Carry out a received transfer and answer the client.
+ *
+ * @param x	Transfer, freed by this function
+ */
+static void bd_xfer_execute(bd_xfer_t *x)
+{
+	bd_ops_t *ops = x->srv->srvs->ops;
 	errno_t rc;
 
-	ba = MERGE_LOUP32(ipc_get_arg1(call), ipc_get_arg2(call));
+	if (x->pool != NULL && x->read && ops->pool_read_blocks != NULL) {
+		rc = ops->pool_read_blocks(x->srv, x->ba, x->cnt, x->pool, x->off);
+		if (rc != EOK) {
+			bd_xfer_fail(x, 0, rc);
+			return;
+		}
+	} else if (x->pool != NULL && !x->read &&
+	    ops->pool_write_blocks != NULL) {
+		rc = ops->pool_write_blocks(x->srv, x->ba, x->cnt, x->pool,
+		    x->off);
+		if (rc != EOK) {
+			bd_xfer_fail(x, 0, rc);
+			return;
+		}
+	} else if (x->read) {
+		if (ops->read_blocks == NULL) {
+			bd_xfer_fail(x, x->niov, ENOTSUP);
+			return;
+		}
+
+		rc = ops->read_blocks(x->srv, x->ba, x->cnt, x->buf, x->size);
+		if (rc != EOK) {
+			bd_xfer_fail(x, x->niov, rc);
+			return;
+		}
+
+		size_t off = 0;
+		for (size_t i = 0; i < x->niov; i++) {
+			async_data_read_finalize(&x->xfer[i], x->buf + off,
+			    x->xsize[i]);
+			off += x->xsize[i];
+		}
+	} else {
+		if (ops->write_blocks == NULL) {
+			bd_xfer_fail(x, 0, ENOTSUP);
+			return;
+		}
+
+		rc = ops->write_blocks(x->srv, x->ba, x->cnt, x->buf, x->size);
+		if (rc != EOK) {
+			bd_xfer_fail(x, 0, rc);
+			return;
+		}
+	}
+
+	async_answer_0(&x->call, EOK);
+	if (x->pool == NULL)
+		free(x->buf);
+	free(x);
+}
+
+static errno_t bd_xfer_fibril(void *arg)
+{
+	bd_xfer_t *x = (bd_xfer_t *) arg;
+	bd_srv_t *srv = x->srv;
+
+	bd_xfer_execute(x);
+
+	fibril_mutex_lock(&srv->qlock);
+	srv->inflight--;
+	fibril_condvar_broadcast(&srv->qcv);
+	fibril_mutex_unlock(&srv->qlock);
+
+	return EOK;
+}
+
+/** Execute a transfer, in a separate fibril if requests can be queued.
+ *
+ * Waits while the negotiated number of transfers is in progress, so that
+ * the device is never handed more requests than it can queue.
+ *
+ * @param srv	Server structure
+ * @param x	Received transfer
+ */
+static void bd_xfer_dispatch(bd_srv_t *srv, bd_xfer_t *x)
+{
+	if (srv->qdepth <= 1) {
+		bd_xfer_execute(x);
+		return;
+	}
+
+	fibril_mutex_lock(&srv->qlock);
+	while (srv->inflight >= srv->qdepth)
+		fibril_condvar_wait(&srv->qcv, &srv->qlock);
+	srv->inflight++;
+	fibril_mutex_unlock(&srv->qlock);
+
+	fid_t fid = fibril_create(bd_xfer_fibril, x);
+	if (fid == 0) {
+		/* Fall back to doing it ourselves */
+		bd_xfer_fibril(x);
+		return;
+	}
+
+	fibril_add_ready(fid);
+}
+
+/** Wait until all transfers in progress complete.
+ *
+ * @param srv	Server structure
+ */
+static void bd_xfer_drain(bd_srv_t *srv)
+{
+	fibril_mutex_lock(&srv->qlock);
+	while (srv->inflight > 0)
+		fibril_condvar_wait(&srv->qcv, &srv->qlock);
+	fibril_mutex_unlock(&srv->qlock);
+}
+
+static void bd_rw_blocks_srv(bd_srv_t *srv, ipc_call_t *call, bool read,
+    size_t niov)
+{
+	bd_xfer_t *x;
+
+	x = bd_xfer_receive(srv, call, read, niov);
+	if (x != NULL)
+		bd_xfer_dispatch(srv, x);
+}
+
+/** Transfer blocks between the device and a pool shared by the client.
+ *
+ * Only the block address, count and position in the pool are sent, the
+ * data are stored right where the client expects them.
+ */
+static void bd_pool_rw_blocks_srv(bd_srv_t *srv, ipc_call_t *call, bool read)
+{
+	bd_pool_t *pool;
+	bd_xfer_t *x;
+	sysarg_t id;
+	size_t off;
+	size_t cnt;
+
+	id = ipc_get_arg4(call);
+	off = ipc_get_arg5(call);
 	cnt = ipc_get_arg3(call);
 
-	ipc_call_t rcall;
-	if (!async_data_read_receive(&rcall, &size)) {
+	if (id >= BD_POOL_MAX || srv->pool[id].addr == NULL) {
 		async_answer_0(call, EINVAL);
 		return;
 	}
 
-	buf = malloc(size);
-	if (buf == NULL) {
-		async_answer_0(&rcall, ENOMEM);
+	pool = &srv->pool[id];
+	if (cnt > SIZE_MAX / srv->block_size || off > pool->size ||
+	    cnt * srv->block_size > pool->size - off) {
+		async_answer_0(call, ELIMIT);
+		return;
+	}
+
+	x = calloc(1, sizeof(bd_xfer_t));
+	if (x == NULL) {
 		async_answer_0(call, ENOMEM);
 		return;
 	}
 
-	if (srv->srvs->ops->read_blocks == NULL) {
-		async_answer_0(&rcall, ENOTSUP);
-		async_answer_0(call, ENOTSUP);
-		free(buf);
+	x->srv = srv;
+	x->call = *call;
+	x->read = read;
+	x->ba = MERGE_LOUP32(ipc_get_arg1(call), ipc_get_arg2(call));
+	x->cnt = cnt;
+	x->pool = pool;
+	x->off = off;
+	x->buf = pool->addr + off;
+	x->size = cnt * srv->block_size;
+
+	bd_xfer_dispatch(srv, x);
+}
+
+/** Accept a memory pool shared by the client. */
+static void bd_pool_share_srv(bd_srv_t *srv, ipc_call_t *call)
+{
+	bd_ops_t *ops = srv->srvs->ops;
+	ipc_call_t data;
+	bd_pool_t *pool;
+	unsigned int flags;
+	size_t size;
+	void *addr;
+	unsigned id;
+	errno_t rc;
+
+	if (!async_share_out_receive(&data, &size, &flags)) {
+		async_answer_0(&data, EINVAL);
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	for (id = 0; id < BD_POOL_MAX; id++) {
+		if (srv->pool[id].addr == NULL)
+			break;
+	}
+
+	if (id == BD_POOL_MAX) {
+		async_answer_0(&data, ELIMIT);
+		async_answer_0(call, ELIMIT);
 		return;
 	}
 
-	rc = srv->srvs->ops->read_blocks(srv, ba, cnt, buf, size);
+	if (srv->block_size == 0) {
+		if (ops->get_block_size == NULL ||
+		    ops->get_block_size(srv, &srv->block_size) != EOK ||
+		    srv->block_size == 0) {
+			srv->block_size = 0;
+			async_answer_0(&data, ENOTSUP);
+			async_answer_0(call, ENOTSUP);
+			return;
+		}
+	}
+
+	rc = async_share_out_finalize(&data, &addr);
 	if (rc != EOK) {
-		async_answer_0(&rcall, ENOMEM);
-		async_answer_0(call, ENOMEM);
-		free(buf);
+		async_answer_0(call, rc);
 		return;
 	}
 
-	async_data_read_finalize(&rcall, buf, size);
+	pool = &srv->pool[id];
+	pool->addr = addr;
+	pool->size = size;
+	pool->arg = 0;
+
+	if (ops->pool_share != NULL) {
+		rc = ops->pool_share(srv, pool);
+		if (rc != EOK) {
+			as_area_destroy(addr);
+			pool->addr = NULL;
+			async_answer_0(call, rc);
+			return;
+		}
+	}
 
-	free(buf);
+	async_answer_1(call, EOK, id);
+}
+
+/** Release a pool once no transfer uses it. */
+static void bd_pool_remove(bd_srv_t *srv, bd_pool_t *pool)
+{
+	if (srv->srvs->ops->pool_unshare != NULL)
+		srv->srvs->ops->pool_unshare(srv, pool);
+
+	as_area_destroy(pool->addr);
+	pool->addr = NULL;
+}
+
+static void bd_pool_unshare_srv(bd_srv_t *srv, ipc_call_t *call)
+{
+	sysarg_t id;
+
+	id = ipc_get_arg1(call);
+	if (id >= BD_POOL_MAX || srv->pool[id].addr == NULL) {
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	bd_xfer_drain(srv);
+	bd_pool_remove(srv, &srv->pool[id]);
 	async_answer_0(call, EOK);
 }
 
@@ -144,34 +492,10 @@ static void bd_sync_cache_srv(bd_srv_t *srv, ipc_call_t *call)
 		return;
 	}
 
-	rc = srv->srvs->ops->sync_cache(srv, ba, cnt);
-	async_answer_0(call, rc);
-}
-
-static void bd_write_blocks_srv(bd_srv_t *srv, ipc_call_t *call)
-{
-	aoff64_t ba;
-	size_t cnt;
-	void *data;
-	size_t size;
-	errno_t rc;
-
-	ba = MERGE_LOUP32(ipc_get_arg1(call), ipc_get_arg2(call));
-	cnt = ipc_get_arg3(call);
-
-	rc = async_data_write_accept(&data, false, 0, 0, 0, &size);
-	if (rc != EOK) {
-		async_answer_0(call, rc);
-		return;
-	}
-
-	if (srv->srvs->ops->write_blocks == NULL) {
-		async_answer_0(call, ENOTSUP);
-		return;
-	}
+	/* Flush only after the writes which are still in progress. */
+	bd_xfer_drain(srv);
 
-	rc = srv->srvs->ops->write_blocks(srv, ba, cnt, data, size);
-	free(data);
+	rc = srv->srvs->ops->sync_cache(srv, ba, cnt);
 	async_answer_0(call, rc);
 }
 
@@ -203,6 +527,25 @@ static void bd_get_num_blocks_srv(bd_srv_t *srv, ipc_call_t *call)
 	async_answer_2(call, rc, LOWER32(num_blocks), UPPER32(num_blocks));
 }
 
+static void bd_get_queue_depth_srv(bd_srv_t *srv, ipc_call_t *call)
+{
+	size_t want;
+	size_t qdepth;
+
+	want = ipc_get_arg1(call);
+
+	if (srv->srvs->ops->get_queue_depth == NULL ||
+	    srv->srvs->ops->get_queue_depth(srv, &qdepth) != EOK)
+		qdepth = 1;
+
+	qdepth = min(qdepth, min(want, BD_QUEUE_DEPTH_MAX));
+	if (qdepth == 0)
+		qdepth = 1;
+
+	srv->qdepth = qdepth;
+	async_answer_1(call, EOK, qdepth);
+}
+
 static bd_srv_t *bd_srv_create(bd_srvs_t *srvs)
 {
 	bd_srv_t *srv;
@@ -212,6 +555,9 @@ static bd_srv_t *bd_srv_create(bd_srvs_t *srvs)
 		return NULL;
 
 	srv->srvs = srvs;
+	srv->qdepth = 1;
+	fibril_mutex_initialize(&srv->qlock);
+	fibril_condvar_initialize(&srv->qcv);
 	return srv;
 }
 
@@ -256,7 +602,11 @@ errno_t bd_conn(ipc_call_t *icall, bd_srvs_t *srvs)
 
 		switch (method) {
 		case BD_READ_BLOCKS:
-			bd_read_blocks_srv(srv, &call);
+			bd_rw_blocks_srv(srv, &call, true, 1);
+			break;
+		case BD_READV_BLOCKS:
+			bd_rw_blocks_srv(srv, &call, true,
+			    ipc_get_arg4(&call));
 			break;
 		case BD_READ_TOC:
 			bd_read_toc_srv(srv, &call);
@@ -265,7 +615,11 @@ errno_t bd_conn(ipc_call_t *icall, bd_srvs_t *srvs)
 			bd_sync_cache_srv(srv, &call);
 			break;
 		case BD_WRITE_BLOCKS:
-			bd_write_blocks_srv(srv, &call);
+			bd_rw_blocks_srv(srv, &call, false, 1);
+			break;
+		case BD_WRITEV_BLOCKS:
+			bd_rw_blocks_srv(srv, &call, false,
+			    ipc_get_arg4(&call));
 			break;
 		case BD_GET_BLOCK_SIZE:
 			bd_get_block_size_srv(srv, &call);
@@ -273,11 +627,33 @@ errno_t bd_conn(ipc_call_t *icall, bd_srvs_t *srvs)
 		case BD_GET_NUM_BLOCKS:
 			bd_get_num_blocks_srv(srv, &call);
 			break;
+		case BD_GET_QUEUE_DEPTH:
+			bd_get_queue_depth_srv(srv, &call);
+			break;
+		case BD_POOL_SHARE:
+			bd_pool_share_srv(srv, &call);
+			break;
+		case BD_POOL_UNSHARE:
+			bd_pool_unshare_srv(srv, &call);
+			break;
+		case BD_POOL_READ_BLOCKS:
+			bd_pool_rw_blocks_srv(srv, &call, true);
+			break;
+		case BD_POOL_WRITE_BLOCKS:
+			bd_pool_rw_blocks_srv(srv, &call, false);
+			break;
 		default:
 			async_answer_0(&call, EINVAL);
 		}
 	}
 
+	bd_xfer_drain(srv);
+
+	for (size_t i = 0; i < BD_POOL_MAX; i++) {
+		if (srv->pool[i].addr != NULL)
+			bd_pool_remove(srv, &srv->pool[i]);
+	}
+
 	rc = srvs->ops->close(srv);
 	free(srv);
 
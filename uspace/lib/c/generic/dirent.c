@@ -39,11 +39,25 @@
 #include <errno.h>
 #include <assert.h>
 #include <string.h>
+#include <str.h>
+
+/** Size of the buffer for entries read ahead by vfs_readdir(). */
+#define DIR_BUF_SIZE	(16 * 1024)
 
 struct __dirstream {
 	int fd;
 	struct dirent res;
 	aoff64_t pos;
+	/** Entries read ahead by vfs_readdir(). */
+	char *buf;
+	/** Offset of the next buffered entry. */
+	size_t buf_off;
+	/** Number of buffered entries not returned yet. */
+	size_t buf_count;
+	/** Whether the buffered entries carry attributes. */
+	bool buf_stat;
+	/** The file system does not support batched directory reads. */
+	bool nobatch;
 };
 
 /** Open directory.
@@ -60,9 +74,17 @@ DIR *opendir(const char *dirname)
 		return NULL;
 	}
 
+	dirp->buf = malloc(DIR_BUF_SIZE);
+	if (!dirp->buf) {
+		free(dirp);
+		errno = ENOMEM;
+		return NULL;
+	}
+
 	int fd;
 	errno_t rc = vfs_lookup(dirname, WALK_DIRECTORY, &fd);
 	if (rc != EOK) {
+		free(dirp->buf);
 		free(dirp);
 		errno = rc;
 		return NULL;
@@ -70,6 +92,7 @@ DIR *opendir(const char *dirname)
 
 	rc = vfs_open(fd, MODE_READ);
 	if (rc != EOK) {
+		free(dirp->buf);
 		free(dirp);
 		vfs_put(fd);
 		errno = rc;
@@ -78,9 +101,52 @@ DIR *opendir(const char *dirname)
 
 	dirp->fd = fd;
 	dirp->pos = 0;
+	dirp->buf_off = 0;
+	dirp->buf_count = 0;
+	dirp->buf_stat = false;
+	dirp->nobatch = false;
 	return dirp;
 }
 
+/** Get the next buffered directory entry, refilling the buffer if needed.
+ *
+ * @param dirp Open directory
+ * @param stat Whether the entry needs to carry its attributes
+ * @param rd   Place to store pointer to the entry record
+ * @return EOK on success, ENOENT at the end of the directory, ENOTSUP if
+ *         the file system does not support batched reads or another error
+ *         code.
+ */
+static errno_t readdir_batch(DIR *dirp, bool stat, vfs_dirent_t **rd)
+{
+	vfs_dirent_t *d;
+	errno_t rc;
+
+	if (dirp->buf_count == 0 || (stat && !dirp->buf_stat)) {
+		aoff64_t pos = dirp->pos;
+		size_t count;
+
+		rc = vfs_readdir(dirp->fd, &pos, stat ? VFS_READDIR_STAT : 0,
+		    dirp->buf, DIR_BUF_SIZE, &count);
+		if (rc != EOK)
+			return rc;
+		if (count == 0)
+			return ENOENT;
+
+		dirp->buf_off = 0;
+		dirp->buf_count = count;
+		dirp->buf_stat = stat;
+	}
+
+	d = (vfs_dirent_t *) (dirp->buf + dirp->buf_off);
+	dirp->buf_off += d->reclen;
+	dirp->buf_count--;
+	dirp->pos = d->next_pos;
+
+	*rd = d;
+	return EOK;
+}
+
 /** Read directory entry.
  *
  * @param dirp Open directory
@@ -89,9 +155,27 @@ DIR *opendir(const char *dirname)
  */
 struct dirent *readdir(DIR *dirp)
 {
+	vfs_dirent_t *d;
 	errno_t rc;
 	ssize_t len = 0;
 
+	if (!dirp->nobatch) {
+		rc = readdir_batch(dirp, false, &d);
+		if (rc == EOK) {
+			str_cpy(dirp->res.d_name, sizeof(dirp->res.d_name),
+			    d->name);
+			return &dirp->res;
+		}
+
+		if (rc != ENOTSUP) {
+			errno = rc;
+			return NULL;
+		}
+
+		/* Fall back to reading one entry at a time. */
+		dirp->nobatch = true;
+	}
+
 	rc = vfs_read_short(dirp->fd, dirp->pos, dirp->res.d_name,
 	    sizeof(dirp->res.d_name), &len);
 	if (rc != EOK) {
@@ -113,6 +197,67 @@ struct dirent *readdir(DIR *dirp)
 void rewinddir(DIR *dirp)
 {
 	dirp->pos = 0;
+	dirp->buf_count = 0;
+}
+
+/** Read directory entry together with its attributes.
+ *
+ * Unlike calling readdir() followed by vfs_stat_path() on each entry, this
+ * retrieves the names and attributes of many entries in a single request
+ * when the file system supports it.
+ *
+ * @param dirp Open directory
+ * @param stat Place to store the attributes of the entry
+ * @return Non-NULL pointer to directory entry on success. On error returns
+ *         @c NULL and sets errno.
+ */
+struct dirent *readdir_stat(DIR *dirp, vfs_stat_t *stat)
+{
+	struct dirent *dp;
+	vfs_dirent_t *d;
+	errno_t rc;
+	int fd;
+
+	if (!dirp->nobatch) {
+		rc = readdir_batch(dirp, true, &d);
+		if (rc == EOK) {
+			str_cpy(dirp->res.d_name, sizeof(dirp->res.d_name),
+			    d->name);
+			if (d->has_stat) {
+				*stat = d->stat;
+				return &dirp->res;
+			}
+			dp = &dirp->res;
+			goto walk;
+		}
+
+		if (rc != ENOTSUP) {
+			errno = rc;
+			return NULL;
+		}
+
+		dirp->nobatch = true;
+	}
+
+	dp = readdir(dirp);
+	if (dp == NULL)
+		return NULL;
+
+walk:
+	rc = vfs_walk(dirp->fd, dp->d_name, 0, &fd);
+	if (rc != EOK) {
+		errno = rc;
+		return NULL;
+	}
+
+	rc = vfs_stat(fd, stat);
+	vfs_put(fd);
+	if (rc != EOK) {
+		errno = rc;
+		return NULL;
+	}
+
+	return dp;
 }
 
 /** Close directory.
@@ -123,6 +268,7 @@ void rewinddir(DIR *dirp)
 int closedir(DIR *dirp)
 {
 	errno_t rc = vfs_put(dirp->fd);
+	free(dirp->buf);
 	free(dirp);
 
 	if (rc == EOK) {
@@ -33,6 +33,7 @@
 #include <ipc/inet.h>
 #include <ipc/services.h>
 #include <loc.h>
+#include <mem.h>
 #include <stdlib.h>
 
 static void inet_cb_conn(ipc_call_t *icall, void *arg);
@@ -114,8 +115,10 @@ errno_t inet_send(inet_dgram_t *dgram, uint8_t ttl, inet_df_t df)
 	async_exch_t *exch = async_exchange_begin(inet_sess);
 
 	ipc_call_t answer;
-	aid_t req = async_send_4(exch, INET_SEND, dgram->iplink, dgram->tos,
-	    ttl, df, &answer);
+	/* The transport header starts the datagram, csum_start is zero */
+	aid_t req = async_send_5(exch, INET_SEND, dgram->iplink, dgram->tos,
+	    ttl, df, dgram->offload.flags | (dgram->offload.csum_offset << 8) |
+	    ((sysarg_t) dgram->offload.gso_size << 16), &answer);
 
 	errno_t rc = async_data_write_start(exch, &dgram->src, sizeof(inet_addr_t));
 	if (rc != EOK) {
@@ -181,6 +184,8 @@ static void inet_ev_recv(ipc_call_t *icall)
 
 	dgram.tos = ipc_get_arg1(icall);
 	dgram.iplink = ipc_get_arg2(icall);
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
+	dgram.offload.flags = ipc_get_arg3(icall);
 
 	ipc_call_t call;
 	size_t size;
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file Packet buffer pool
+ *
+ * The pool area starts with an array of buffer reference counts followed
+ * by the buffers. Both the owner and the servers attached to the pool
+ * compute the same layout from the number and size of buffers.
+ */
+
+#include <align.h>
+#include <as.h>
+#include <assert.h>
+#include <errno.h>
+#include <inet/pbuf.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/** Alignment of the first buffer in the pool area */
+#define PBUF_DATA_ALIGN	64
+
+/** Offset of buffer data in pool area.
+ *
+ * @param count Number of buffers
+ * @return Offset in bytes
+ */
+static size_t pbuf_pool_data_off(size_t count)
+{
+	return ALIGN_UP(count * sizeof(atomic_uint), PBUF_DATA_ALIGN);
+}
+
+/** Get size of the area needed for a pool.
+ *
+ * @param count Number of buffers
+ * @param size  Size of one buffer
+ * @return Size in bytes
+ */
+size_t pbuf_pool_area_size(size_t count, size_t size)
+{
+	return pbuf_pool_data_off(count) + count * size;
+}
+
+/** Initialize pool structure over an area.
+ *
+ * @param area  Pool area
+ * @param count Number of buffers
+ * @param size  Size of one buffer
+ * @param owner @c true if we own the pool
+ * @param rpool Place to store pointer to pool
+ *
+ * @return EOK on success or ENOMEM
+ */
+static errno_t pbuf_pool_init(void *area, size_t count, size_t size,
+    bool owner, pbuf_pool_t **rpool)
+{
+	pbuf_pool_t *pool;
+
+	pool = calloc(1, sizeof(pbuf_pool_t));
+	if (pool == NULL)
+		return ENOMEM;
+
+	pool->area = area;
+	pool->refcnt = (atomic_uint *) area;
+	pool->data = (uint8_t *) area + pbuf_pool_data_off(count);
+	pool->count = count;
+	pool->size = size;
+	pool->owner = owner;
+	fibril_mutex_initialize(&pool->lock);
+	pool->next = 0;
+
+	*rpool = pool;
+	return EOK;
+}
+
+/** Create packet buffer pool.
+ *
+ * The pool area can be shared with other servers, which then attach to it
+ * using pbuf_pool_attach().
+ *
+ * @param count Number of buffers
+ * @param size  Size of one buffer
+ * @param rpool Place to store pointer to new pool
+ *
+ * @return EOK on success or an error code
+ */
+errno_t pbuf_pool_create(size_t count, size_t size, pbuf_pool_t **rpool)
+{
+	void *area;
+	errno_t rc;
+
+	if (count == 0 || size == 0 || count > UINT32_MAX ||
+	    size > UINT32_MAX)
+		return EINVAL;
+
+	area = as_area_create(AS_AREA_ANY, pbuf_pool_area_size(count, size),
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (area == AS_MAP_FAILED)
+		return ENOMEM;
+
+	/* Anonymous memory is zeroed, all buffers are free */
+	rc = pbuf_pool_init(area, count, size, true, rpool);
+	if (rc != EOK) {
+		as_area_destroy(area);
+		return rc;
+	}
+
+	return EOK;
+}
+
+/** Attach to packet buffer pool shared by another server.
+ *
+ * @param area  Shared pool area
+ * @param count Number of buffers
+ * @param size  Size of one buffer
+ * @param rpool Place to store pointer to pool
+ *
+ * @return EOK on success or an error code
+ */
+errno_t pbuf_pool_attach(void *area, size_t count, size_t size,
+    pbuf_pool_t **rpool)
+{
+	if (count == 0 || size == 0 || count > UINT32_MAX ||
+	    size > UINT32_MAX)
+		return EINVAL;
+
+	return pbuf_pool_init(area, count, size, false, rpool);
+}
+
+/** Destroy packet buffer pool.
+ *
+ * Unmaps the pool area. Servers the pool is shared with keep their
+ * mapping.
+ *
+ * @param pool Pool
+ */
+void pbuf_pool_destroy(pbuf_pool_t *pool)
+{
+	if (pool == NULL)
+		return;
+
+	as_area_destroy(pool->area);
+	free(pool);
+}
+
+/** Allocate packet buffer.
+ *
+ * Only the owner of the pool can allocate buffers. The new packet holds
+ * one reference to the buffer.
+ *
+ * @param pool     Pool
+ * @param headroom Space to leave before the packet for prepending headers
+ * @param len      Packet length
+ * @param pbuf     Place to store packet
+ *
+ * @return EOK on success, EINVAL if the packet does not fit in a buffer,
+ *         ENOMEM if all buffers are in use
+ */
+errno_t pbuf_alloc(pbuf_pool_t *pool, size_t headroom, size_t len,
+    pbuf_t *pbuf)
+{
+	size_t i;
+	size_t idx;
+
+	assert(pool->owner);
+
+	if (headroom > pool->size || len > pool->size - headroom)
+		return EINVAL;
+
+	fibril_mutex_lock(&pool->lock);
+
+	/* Holders only ever drop references of buffers in use */
+	for (i = 0; i < pool->count; i++) {
+		idx = (pool->next + i) % pool->count;
+		if (atomic_load_explicit(&pool->refcnt[idx],
+		    memory_order_acquire) == 0)
+			break;
+	}
+
+	if (i == pool->count) {
+		fibril_mutex_unlock(&pool->lock);
+		return ENOMEM;
+	}
+
+	atomic_store_explicit(&pool->refcnt[idx], 1, memory_order_relaxed);
+	pool->next = (idx + 1) % pool->count;
+	fibril_mutex_unlock(&pool->lock);
+
+	pbuf->pool = pool;
+	pbuf->idx = idx;
+	pbuf->off = headroom;
+	pbuf->len = len;
+	return EOK;
+}
+
+/** Get packet passed to us by reference.
+ *
+ * The caller takes over the reference held by the sender.
+ *
+ * @param pool Pool
+ * @param idx  Buffer index
+ * @param off  Offset of packet data in buffer
+ * @param len  Packet length
+ * @param pbuf Place to store packet
+ *
+ * @return EOK on success, EINVAL if the packet is not within the pool
+ */
+errno_t pbuf_get(pbuf_pool_t *pool, uint32_t idx, uint32_t off, uint32_t len,
+    pbuf_t *pbuf)
+{
+	if (idx >= pool->count || off > pool->size || len > pool->size - off)
+		return EINVAL;
+
+	pbuf->pool = pool;
+	pbuf->idx = idx;
+	pbuf->off = off;
+	pbuf->len = len;
+	return EOK;
+}
+
+/** Add reference to packet buffer.
+ *
+ * @param pbuf Packet
+ */
+void pbuf_ref(pbuf_t *pbuf)
+{
+	atomic_fetch_add_explicit(&pbuf->pool->refcnt[pbuf->idx], 1,
+	    memory_order_relaxed);
+}
+
+/** Drop reference to packet buffer.
+ *
+ * The buffer is free once the last reference is dropped.
+ *
+ * @param pbuf Packet
+ */
+void pbuf_release(pbuf_t *pbuf)
+{
+	atomic_fetch_sub_explicit(&pbuf->pool->refcnt[pbuf->idx], 1,
+	    memory_order_release);
+}
+
+/** Get pointer to packet data.
+ *
+ * @param pbuf Packet
+ * @return Pointer to first byte of packet
+ */
+void *pbuf_data(pbuf_t *pbuf)
+{
+	return pbuf->pool->data + (size_t) pbuf->idx * pbuf->pool->size +
+	    pbuf->off;
+}
+
+/** Prepend space for a header to packet.
+ *
+ * @param pbuf Packet
+ * @param size Header size
+ * @return EOK on success, ELIMIT if there is not enough headroom
+ */
+errno_t pbuf_push(pbuf_t *pbuf, size_t size)
+{
+	if (size > pbuf->off)
+		return ELIMIT;
+
+	pbuf->off -= size;
+	pbuf->len += size;
+	return EOK;
+}
+
+/** Strip header from packet.
+ *
+ * @param pbuf Packet
+ * @param size Header size
+ * @return EOK on success, EINVAL if the packet is shorter than @a size
+ */
+errno_t pbuf_pull(pbuf_t *pbuf, size_t size)
+{
+	if (size > pbuf->len)
+		return EINVAL;
+
+	pbuf->off += size;
+	pbuf->len -= size;
+	return EOK;
+}
+
+/** Strip trailing data (e.g. padding) from packet.
+ *
+ * @param pbuf Packet
+ * @param len  New packet length
+ * @return EOK on success, EINVAL if the packet is shorter than @a len
+ */
+errno_t pbuf_trim(pbuf_t *pbuf, size_t len)
+{
+	if (len > pbuf->len)
+		return EINVAL;
+
+	pbuf->len = len;
+	return EOK;
+}
+
+/** @}
+ */
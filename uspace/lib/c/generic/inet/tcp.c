@@ -32,16 +32,76 @@
 /** @file TCP API
  */
 
+#include <as.h>
 #include <errno.h>
 #include <fibril.h>
 #include <inet/endpoint.h>
 #include <inet/tcp.h>
 #include <ipc/services.h>
 #include <ipc/tcp.h>
+#include <macros.h>
+#include <mem.h>
 #include <stdlib.h>
 
+/** Size of each of the data rings shared with the TCP service */
+#define TCP_CONN_RING_SIZE	(256 * 1024)
+
+/** Size of bounce buffer for tcp_conn_send_fill() without data rings */
+#define TCP_CONN_FILL_BUF_SIZE	(64 * 1024)
+
+static size_t tcp_conn_ht_key_hash(const void *key)
+{
+	const sysarg_t *id = key;
+	return *id;
+}
+
+static size_t tcp_conn_ht_hash(const ht_link_t *item)
+{
+	tcp_conn_t *conn = hash_table_get_inst(item, tcp_conn_t, ltcp);
+	return conn->id;
+}
+
+static bool tcp_conn_ht_key_equal(const void *key, const ht_link_t *item)
+{
+	const sysarg_t *id = key;
+	tcp_conn_t *conn = hash_table_get_inst(item, tcp_conn_t, ltcp);
+	return conn->id == *id;
+}
+
+/** Connections by ID, the connection is freed by its owner */
+static hash_table_ops_t tcp_conn_ht_ops = {
+	.hash = tcp_conn_ht_hash,
+	.key_hash = tcp_conn_ht_key_hash,
+	.key_equal = tcp_conn_ht_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+static size_t tcp_listener_ht_hash(const ht_link_t *item)
+{
+	tcp_listener_t *lst = hash_table_get_inst(item, tcp_listener_t, ltcp);
+	return lst->id;
+}
+
+static bool tcp_listener_ht_key_equal(const void *key, const ht_link_t *item)
+{
+	const sysarg_t *id = key;
+	tcp_listener_t *lst = hash_table_get_inst(item, tcp_listener_t, ltcp);
+	return lst->id == *id;
+}
+
+/** Listeners by ID, the listener is freed by its owner */
+static hash_table_ops_t tcp_listener_ht_ops = {
+	.hash = tcp_listener_ht_hash,
+	.key_hash = tcp_conn_ht_key_hash,
+	.key_equal = tcp_listener_ht_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
 static void tcp_cb_conn(ipc_call_t *, void *);
 static errno_t tcp_conn_fibril(void *);
+static void tcp_conn_ring_setup(tcp_conn_t *);
 
 /** Incoming TCP connection info
  *
@@ -94,13 +154,20 @@ errno_t tcp_create(tcp_t **rtcp)
 	errno_t rc;
 
 	tcp = calloc(1, sizeof(tcp_t));
-	if (tcp == NULL) {
-		rc = ENOMEM;
-		goto error;
+	if (tcp == NULL)
+		return ENOMEM;
+
+	if (!hash_table_create(&tcp->conn, 0, 0, &tcp_conn_ht_ops)) {
+		free(tcp);
+		return ENOMEM;
+	}
+
+	if (!hash_table_create(&tcp->listener, 0, 0, &tcp_listener_ht_ops)) {
+		hash_table_destroy(&tcp->conn);
+		free(tcp);
+		return ENOMEM;
 	}
 
-	list_initialize(&tcp->conn);
-	list_initialize(&tcp->listener);
 	fibril_mutex_initialize(&tcp->lock);
 	fibril_condvar_initialize(&tcp->cv);
 
@@ -127,6 +194,8 @@ errno_t tcp_create(tcp_t **rtcp)
 	*rtcp = tcp;
 	return EOK;
 error:
+	hash_table_destroy(&tcp->conn);
+	hash_table_destroy(&tcp->listener);
 	free(tcp);
 	return rc;
 }
@@ -147,6 +216,8 @@ void tcp_destroy(tcp_t *tcp)
 		fibril_condvar_wait(&tcp->cv, &tcp->lock);
 	fibril_mutex_unlock(&tcp->lock);
 
+	hash_table_destroy(&tcp->conn);
+	hash_table_destroy(&tcp->listener);
 	free(tcp);
 }
 
@@ -178,7 +249,10 @@ static errno_t tcp_conn_new(tcp_t *tcp, sysarg_t id, tcp_cb_t *cb, void *arg,
 	conn->cb = cb;
 	conn->cb_arg = arg;
 
-	list_append(&conn->ltcp, &tcp->conn);
+	fibril_mutex_lock(&tcp->lock);
+	hash_table_insert(&tcp->conn, &conn->ltcp);
+	fibril_mutex_unlock(&tcp->lock);
+
 	*rconn = conn;
 
 	return EOK;
@@ -237,6 +311,7 @@ errno_t tcp_conn_create(tcp_t *tcp, inet_ep2_t *epp, tcp_cb_t *cb, void *arg,
 	if (rc != EOK)
 		return rc;
 
+	tcp_conn_ring_setup(*rconn);
 	return EOK;
 error:
 	return (errno_t) rc;
@@ -256,16 +331,281 @@ void tcp_conn_destroy(tcp_conn_t *conn)
 	if (conn == NULL)
 		return;
 
-	list_remove(&conn->ltcp);
+	fibril_mutex_lock(&conn->tcp->lock);
+	hash_table_remove_item(&conn->tcp->conn, &conn->ltcp);
+	fibril_mutex_unlock(&conn->tcp->lock);
 
 	exch = async_exchange_begin(conn->tcp->sess);
 	errno_t rc = async_req_1_0(exch, TCP_CONN_DESTROY, conn->id);
 	async_exchange_end(exch);
 
+	/* The service keeps its own mapping until it has sent all data */
+	if (conn->ring != NULL)
+		as_area_destroy(conn->ring);
+
 	free(conn);
 	(void) rc;
 }
 
+/** Set up data rings shared with the TCP service.
+ *
+ * Once set up, data is passed between the client and the service through
+ * memory shared for the lifetime of the connection instead of being copied
+ * through IPC messages. If the rings cannot be set up, data keeps being
+ * passed in IPC messages.
+ *
+ * @param conn Connection
+ */
+static void tcp_conn_ring_setup(tcp_conn_t *conn)
+{
+	async_exch_t *exch;
+	void *area;
+	errno_t rc;
+
+	area = as_area_create(AS_AREA_ANY,
+	    TCP_RING_AREA_SIZE(TCP_CONN_RING_SIZE),
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (area == AS_MAP_FAILED)
+		return;
+
+	exch = async_exchange_begin(conn->tcp->sess);
+	aid_t req = async_send_2(exch, TCP_CONN_RING_SHARE, conn->id,
+	    TCP_CONN_RING_SIZE, NULL);
+	rc = async_share_out_start(exch, area, AS_AREA_READ | AS_AREA_WRITE);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		as_area_destroy(area);
+		return;
+	}
+
+	async_wait_for(req, &rc);
+	if (rc != EOK) {
+		as_area_destroy(area);
+		return;
+	}
+
+	fibril_mutex_lock(&conn->lock);
+	conn->ring = area;
+	conn->ring_size = TCP_CONN_RING_SIZE;
+	fibril_mutex_unlock(&conn->lock);
+}
+
+/** Ring the doorbell of the TCP service.
+ *
+ * Tell the service that the data rings of a connection have advanced.
+ * Does not wait for the service to process the message.
+ *
+ * @param conn Connection
+ */
+static void tcp_conn_ring_kick(tcp_conn_t *conn)
+{
+	async_exch_t *exch;
+
+	exch = async_exchange_begin(conn->tcp->sess);
+	async_msg_1(exch, TCP_CONN_RING_KICK, conn->id);
+	async_exchange_end(exch);
+}
+
+/** Reserve contiguous free space in the shared send ring.
+ *
+ * Waits until the ring has free space. The space is not consumed until
+ * it is published with tcp_conn_ring_produce(). The connection must be
+ * locked.
+ *
+ * @param conn  Connection
+ * @param max   Maximum number of bytes to reserve
+ * @param rpos  Place to store offset of the free space in the ring data
+ * @param rsize Place to store size of the free space (at most @a max)
+ *
+ * @return EOK on success, EIO if the connection was reset
+ */
+static errno_t tcp_conn_ring_reserve(tcp_conn_t *conn, size_t max,
+    size_t *rpos, size_t *rsize)
+{
+	tcp_ring_ctl_t *ctl = &conn->ring->snd;
+	unsigned prod, cons;
+	size_t pos;
+
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	while (true) {
+		if (conn->conn_reset)
+			return EIO;
+
+		prod = atomic_load_explicit(&ctl->prod, memory_order_relaxed);
+		cons = atomic_load_explicit(&ctl->cons, memory_order_acquire);
+		if (prod - cons < conn->ring_size)
+			break;
+
+		/* Ring is full, ask to be notified about free space */
+		conn->space_avail = false;
+		atomic_store(&ctl->want_space, 1);
+		cons = atomic_load(&ctl->cons);
+		if (prod - cons < conn->ring_size)
+			continue;
+
+		while (!conn->space_avail && !conn->conn_reset)
+			fibril_condvar_wait(&conn->cv, &conn->lock);
+	}
+
+	/* Contiguous free space up to the end of the ring */
+	pos = prod & (conn->ring_size - 1);
+	*rpos = pos;
+	*rsize = min(min(max, conn->ring_size - (prod - cons)),
+	    conn->ring_size - pos);
+	return EOK;
+}
+
+/** Publish data written to space reserved in the shared send ring.
+ *
+ * The connection must be locked.
+ *
+ * @param conn  Connection
+ * @param n     Number of bytes written
+ */
+static void tcp_conn_ring_produce(tcp_conn_t *conn, size_t n)
+{
+	tcp_ring_ctl_t *ctl = &conn->ring->snd;
+	unsigned prod;
+
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	prod = atomic_load_explicit(&ctl->prod, memory_order_relaxed);
+	atomic_store_explicit(&ctl->prod, prod + n, memory_order_release);
+
+	/* Wake up the service if it ran out of data to send */
+	if (atomic_exchange(&ctl->want_data, 0) != 0)
+		tcp_conn_ring_kick(conn);
+}
+
+/** Send data over TCP connection using the shared send ring.
+ *
+ * @param conn  Connection
+ * @param data  Data
+ * @param bytes Data size in bytes
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t tcp_conn_ring_send(tcp_conn_t *conn, const void *data,
+    size_t bytes)
+{
+	uint8_t *rdata = (uint8_t *)conn->ring + TCP_RING_DATA_OFF;
+	const uint8_t *dp = data;
+	size_t pos, n;
+	errno_t rc;
+
+	fibril_mutex_lock(&conn->lock);
+
+	while (bytes > 0) {
+		rc = tcp_conn_ring_reserve(conn, bytes, &pos, &n);
+		if (rc != EOK) {
+			fibril_mutex_unlock(&conn->lock);
+			return rc;
+		}
+
+		memcpy(rdata + pos, dp, n);
+		tcp_conn_ring_produce(conn, n);
+		dp += n;
+		bytes -= n;
+	}
+
+	fibril_mutex_unlock(&conn->lock);
+	return EOK;
+}
+
+/** Read received data from the shared receive ring.
+ *
+ * Copies data until @a bsize bytes are read or the ring is empty. Before
+ * returning with less than @a bsize bytes the service is asked to notify
+ * us about more data, so a TCP_EV_DATA event follows any data produced
+ * after that.
+ *
+ * @param conn  Connection
+ * @param buf   Buffer
+ * @param bsize Buffer size
+ * @param nrecv Place to store actual number of received bytes
+ * @param wait  @c true to wait for data if none is available
+ *
+ * @return EOK on success, EAGAIN if no data is available and @a wait
+ *         is @c false, EIO if the connection was reset
+ */
+static errno_t tcp_conn_ring_recv(tcp_conn_t *conn, void *buf, size_t bsize,
+    size_t *nrecv, bool wait)
+{
+	tcp_ring_ctl_t *ctl = &conn->ring->rcv;
+	uint8_t *rdata = (uint8_t *)conn->ring + TCP_RING_DATA_OFF +
+	    conn->ring_size;
+	uint8_t *bp = buf;
+	unsigned prod, cons;
+	size_t pos, n, n1;
+	size_t nread;
+	bool armed;
+
+	fibril_mutex_lock(&conn->lock);
+
+	nread = 0;
+	armed = false;
+	while (nread < bsize) {
+		cons = atomic_load_explicit(&ctl->cons, memory_order_relaxed);
+		prod = atomic_load_explicit(&ctl->prod, memory_order_acquire);
+
+		if (prod != cons) {
+			n = min(bsize - nread, prod - cons);
+			pos = cons & (conn->ring_size - 1);
+			n1 = min(n, conn->ring_size - pos);
+			memcpy(bp + nread, rdata + pos, n1);
+			memcpy(bp + nread + n1, rdata, n - n1);
+			nread += n;
+
+			atomic_store_explicit(&ctl->cons, cons + n,
+			    memory_order_release);
+
+			/* Let the service open the receive window */
+			if (atomic_exchange(&ctl->want_space, 0) != 0)
+				tcp_conn_ring_kick(conn);
+			continue;
+		}
+
+		if (!armed) {
+			/* Ring is empty, ask to be notified, then look again */
+			conn->data_avail = false;
+			atomic_store(&ctl->want_data, 1);
+			armed = true;
+			continue;
+		}
+
+		if (nread > 0)
+			break;
+
+		/* FIN is only set after all data has been produced */
+		if (atomic_load_explicit(&ctl->fin, memory_order_acquire) != 0) {
+			if (atomic_load(&ctl->prod) != cons)
+				continue;
+			break;
+		}
+
+		if (conn->conn_reset) {
+			fibril_mutex_unlock(&conn->lock);
+			return EIO;
+		}
+
+		if (!wait) {
+			fibril_mutex_unlock(&conn->lock);
+			return EAGAIN;
+		}
+
+		while (!conn->data_avail && !conn->conn_reset)
+			fibril_condvar_wait(&conn->cv, &conn->lock);
+		armed = false;
+	}
+
+	*nrecv = nread;
+	fibril_mutex_unlock(&conn->lock);
+	return EOK;
+}
+
 /** Get connection based on its ID.
  *
  * @param tcp   TCP client
@@ -276,14 +616,17 @@ void tcp_conn_destroy(tcp_conn_t *conn)
  */
 static errno_t tcp_conn_get(tcp_t *tcp, sysarg_t id, tcp_conn_t **rconn)
 {
-	list_foreach(tcp->conn, ltcp, tcp_conn_t, conn) {
-		if (conn->id == id) {
-			*rconn = conn;
-			return EOK;
-		}
-	}
+	ht_link_t *link;
 
-	return EINVAL;
+	fibril_mutex_lock(&tcp->lock);
+	link = hash_table_find(&tcp->conn, &id);
+	fibril_mutex_unlock(&tcp->lock);
+
+	if (link == NULL)
+		return EINVAL;
+
+	*rconn = hash_table_get_inst(link, tcp_conn_t, ltcp);
+	return EOK;
 }
 
 /** Get the user/callback argument for a connection.
@@ -353,7 +696,10 @@ errno_t tcp_listener_create(tcp_t *tcp, inet_ep_t *ep, tcp_listen_cb_t *lcb,
 	lst->cb = cb;
 	lst->cb_arg = arg;
 
-	list_append(&lst->ltcp, &tcp->listener);
+	fibril_mutex_lock(&tcp->lock);
+	hash_table_insert(&tcp->listener, &lst->ltcp);
+	fibril_mutex_unlock(&tcp->lock);
+
 	*rlst = lst;
 
 	return EOK;
@@ -373,7 +719,9 @@ void tcp_listener_destroy(tcp_listener_t *lst)
 	if (lst == NULL)
 		return;
 
-	list_remove(&lst->ltcp);
+	fibril_mutex_lock(&lst->tcp->lock);
+	hash_table_remove_item(&lst->tcp->listener, &lst->ltcp);
+	fibril_mutex_unlock(&lst->tcp->lock);
 
 	exch = async_exchange_begin(lst->tcp->sess);
 	errno_t rc = async_req_1_0(exch, TCP_LISTENER_DESTROY, lst->id);
@@ -393,14 +741,17 @@ void tcp_listener_destroy(tcp_listener_t *lst)
  */
 static errno_t tcp_listener_get(tcp_t *tcp, sysarg_t id, tcp_listener_t **rlst)
 {
-	list_foreach(tcp->listener, ltcp, tcp_listener_t, lst) {
-		if (lst->id == id) {
-			*rlst = lst;
-			return EOK;
-		}
-	}
+	ht_link_t *link;
+
+	fibril_mutex_lock(&tcp->lock);
+	link = hash_table_find(&tcp->listener, &id);
+	fibril_mutex_unlock(&tcp->lock);
 
-	return EINVAL;
+	if (link == NULL)
+		return EINVAL;
+
+	*rlst = hash_table_get_inst(link, tcp_listener_t, ltcp);
+	return EOK;
 }
 
 /** Get callback/user argument associated with listener.
@@ -452,6 +803,9 @@ errno_t tcp_conn_send(tcp_conn_t *conn, const void *data, size_t bytes)
 	async_exch_t *exch;
 	errno_t rc;
 
+	if (conn->ring != NULL)
+		return tcp_conn_ring_send(conn, data, bytes);
+
 	exch = async_exchange_begin(conn->tcp->sess);
 	aid_t req = async_send_1(exch, TCP_CONN_SEND, conn->id, NULL);
 	rc = async_data_write_start(exch, data, bytes);
@@ -471,6 +825,91 @@ errno_t tcp_conn_send(tcp_conn_t *conn, const void *data, size_t bytes)
 	return rc;
 }
 
+/** Send data produced by a callback over TCP connection.
+ *
+ * If the connection has a shared send ring, @a fill writes the data
+ * directly into the ring. This allows sending e.g. file contents without
+ * copying it through an intermediate buffer. Otherwise the data is passed
+ * via a bounce buffer.
+ *
+ * The connection lock is not held while @a fill is running. The caller
+ * must not send other data over the connection at the same time.
+ *
+ * @param conn  Connection
+ * @param fill  Callback filling a buffer with data, storing zero bytes
+ *              means there is no more data
+ * @param arg   Argument to @a fill
+ * @param bytes Maximum number of bytes to send
+ * @param nsent Place to store number of bytes sent or @c NULL
+ *
+ * @return EOK on success or an error code (either from the connection
+ *         or from @a fill)
+ */
+errno_t tcp_conn_send_fill(tcp_conn_t *conn, tcp_conn_fill_t fill,
+    void *arg, size_t bytes, size_t *nsent)
+{
+	uint8_t *rdata;
+	size_t pos, n, nf;
+	size_t total;
+	void *buf;
+	errno_t rc;
+
+	total = 0;
+
+	if (conn->ring == NULL) {
+		buf = malloc(min(bytes, TCP_CONN_FILL_BUF_SIZE));
+		if (buf == NULL)
+			return ENOMEM;
+
+		rc = EOK;
+		while (total < bytes) {
+			rc = fill(arg, buf, min(bytes - total,
+			    TCP_CONN_FILL_BUF_SIZE), &nf);
+			if (rc != EOK || nf == 0)
+				break;
+
+			rc = tcp_conn_send(conn, buf, nf);
+			if (rc != EOK)
+				break;
+
+			total += nf;
+		}
+
+		free(buf);
+		if (nsent != NULL)
+			*nsent = total;
+		return rc;
+	}
+
+	rdata = (uint8_t *)conn->ring + TCP_RING_DATA_OFF;
+	rc = EOK;
+
+	fibril_mutex_lock(&conn->lock);
+
+	while (total < bytes) {
+		rc = tcp_conn_ring_reserve(conn, bytes - total, &pos, &n);
+		if (rc != EOK)
+			break;
+
+		fibril_mutex_unlock(&conn->lock);
+		rc = fill(arg, rdata + pos, n, &nf);
+		fibril_mutex_lock(&conn->lock);
+
+		if (rc != EOK || nf == 0)
+			break;
+
+		assert(nf <= n);
+		tcp_conn_ring_produce(conn, nf);
+		total += nf;
+	}
+
+	fibril_mutex_unlock(&conn->lock);
+
+	if (nsent != NULL)
+		*nsent = total;
+	return rc;
+}
+
 /** Send FIN.
  *
  * Send FIN, indicating no more data will be send over the connection.
@@ -521,6 +960,23 @@ errno_t tcp_conn_reset(tcp_conn_t *conn)
 	return rc;
 }
 
+/** Select congestion control algorithm for connection.
+ *
+ * @param conn Connection
+ * @param alg  Congestion control algorithm
+ * @return EOK on success or an error code
+ */
+errno_t tcp_conn_set_cc(tcp_conn_t *conn, tcp_cc_alg_t alg)
+{
+	async_exch_t *exch;
+
+	exch = async_exchange_begin(conn->tcp->sess);
+	errno_t rc = async_req_2_0(exch, TCP_CONN_SET_CC, conn->id, alg);
+	async_exchange_end(exch);
+
+	return rc;
+}
+
 /** Read received data from connection without blocking.
  *
  * If any received data is pending on the connection, up to @a bsize bytes
@@ -543,6 +999,9 @@ errno_t tcp_conn_recv(tcp_conn_t *conn, void *buf, size_t bsize, size_t *nrecv)
 	async_exch_t *exch;
 	ipc_call_t answer;
 
+	if (conn->ring != NULL)
+		return tcp_conn_ring_recv(conn, buf, bsize, nrecv, false);
+
 	fibril_mutex_lock(&conn->lock);
 	if (!conn->data_avail) {
 		fibril_mutex_unlock(&conn->lock);
@@ -592,6 +1051,9 @@ errno_t tcp_conn_recv_wait(tcp_conn_t *conn, void *buf, size_t bsize,
 	async_exch_t *exch;
 	ipc_call_t answer;
 
+	if (conn->ring != NULL)
+		return tcp_conn_ring_recv(conn, buf, bsize, nrecv, true);
+
 again:
 	fibril_mutex_lock(&conn->lock);
 	while (!conn->data_avail) {
@@ -742,6 +1204,34 @@ static void tcp_ev_data(tcp_t *tcp, ipc_call_t *icall)
 	async_answer_0(icall, EOK);
 }
 
+/** Send space available event.
+ *
+ * @param tcp   TCP client
+ * @param icall Call data
+ *
+ */
+static void tcp_ev_space(tcp_t *tcp, ipc_call_t *icall)
+{
+	tcp_conn_t *conn;
+	sysarg_t conn_id;
+	errno_t rc;
+
+	conn_id = ipc_get_arg1(icall);
+
+	rc = tcp_conn_get(tcp, conn_id, &conn);
+	if (rc != EOK) {
+		async_answer_0(icall, ENOENT);
+		return;
+	}
+
+	fibril_mutex_lock(&conn->lock);
+	conn->space_avail = true;
+	fibril_condvar_broadcast(&conn->cv);
+	fibril_mutex_unlock(&conn->lock);
+
+	async_answer_0(icall, EOK);
+}
+
 /** Urgent data event.
  *
  * @param tcp   TCP client
@@ -844,6 +1334,9 @@ static void tcp_cb_conn(ipc_call_t *icall, void *arg)
 		case TCP_EV_NEW_CONN:
 			tcp_ev_new_conn(tcp, &call);
 			break;
+		case TCP_EV_SPACE:
+			tcp_ev_space(tcp, &call);
+			break;
 		default:
 			async_answer_0(&call, ENOTSUP);
 			break;
@@ -865,6 +1358,9 @@ static errno_t tcp_conn_fibril(void *arg)
 {
 	tcp_in_conn_t *cinfo = (tcp_in_conn_t *)arg;
 
+	/* Cannot set up the rings from the callback connection fibril */
+	tcp_conn_ring_setup(cinfo->conn);
+
 	cinfo->lst->lcb->new_conn(cinfo->lst, cinfo->conn);
 	tcp_conn_destroy(cinfo->conn);
 
@@ -32,14 +32,20 @@
 /** @file UDP API
  */
 
+#include <align.h>
 #include <errno.h>
 #include <inet/endpoint.h>
 #include <inet/udp.h>
 #include <ipc/services.h>
 #include <ipc/udp.h>
 #include <loc.h>
+#include <macros.h>
+#include <mem.h>
 #include <stdlib.h>
 
+/** Size of buffer for receiving and sending batches of messages */
+#define UDP_BATCH_BUF_SIZE DATA_XFER_LIMIT
+
 static void udp_cb_conn(ipc_call_t *, void *);
 
 /** Create callback connection from UDP service.
@@ -90,6 +96,12 @@ errno_t udp_create(udp_t **rudp)
 	fibril_mutex_initialize(&udp->lock);
 	fibril_condvar_initialize(&udp->cv);
 
+	udp->rbuf = malloc(UDP_BATCH_BUF_SIZE);
+	if (udp->rbuf == NULL) {
+		rc = ENOMEM;
+		goto error;
+	}
+
 	rc = loc_service_get_id(SERVICE_NAME_UDP, &udp_svcid,
 	    IPC_FLAG_BLOCKING);
 	if (rc != EOK) {
@@ -113,6 +125,8 @@ errno_t udp_create(udp_t **rudp)
 	*rudp = udp;
 	return EOK;
 error:
+	if (udp != NULL)
+		free(udp->rbuf);
 	free(udp);
 	return rc;
 }
@@ -133,6 +147,7 @@ void udp_destroy(udp_t *udp)
 		fibril_condvar_wait(&udp->cv, &udp->lock);
 	fibril_mutex_unlock(&udp->lock);
 
+	free(udp->rbuf);
 	free(udp);
 }
 
@@ -284,6 +299,118 @@ errno_t udp_assoc_send_msg(udp_assoc_t *assoc, inet_ep_t *dest, void *data,
 	return rc;
 }
 
+/** Send batch of messages via UDP association.
+ *
+ * Messages are passed to the UDP service in as few IPC calls as
+ * possible. Sending stops at the first message that fails.
+ *
+ * @param assoc Association
+ * @param msgs  Array of messages
+ * @param count Number of messages
+ * @param nsent Place to store number of messages sent or @c NULL
+ *
+ * @return EOK if all messages were sent or an error code
+ */
+errno_t udp_assoc_send_batch(udp_assoc_t *assoc, udp_smsg_t *msgs,
+    size_t count, size_t *nsent)
+{
+	async_exch_t *exch;
+	ipc_call_t answer;
+	udp_batch_hdr_t *hdr;
+	uint8_t *buf;
+	size_t sent = 0;
+	size_t bcount;
+	size_t used;
+	size_t rsize;
+	errno_t rc = EOK;
+
+	buf = malloc(UDP_BATCH_BUF_SIZE);
+	if (buf == NULL)
+		return ENOMEM;
+
+	while (sent < count) {
+		/* Pack as many messages as fit into the buffer */
+		bcount = 0;
+		used = 0;
+		while (sent + bcount < count) {
+			udp_smsg_t *msg = &msgs[sent + bcount];
+
+			rsize = ALIGN_UP(sizeof(udp_batch_hdr_t) + msg->size,
+			    UDP_BATCH_ALIGN);
+			if (rsize > UDP_BATCH_BUF_SIZE - used)
+				break;
+
+			hdr = (udp_batch_hdr_t *) (buf + used);
+			memset(hdr, 0, sizeof(udp_batch_hdr_t));
+			if (msg->dest != NULL)
+				hdr->remote = *msg->dest;
+			hdr->size = msg->size;
+			memcpy(hdr + 1, msg->data, msg->size);
+
+			used += rsize;
+			++bcount;
+		}
+
+		if (bcount == 0) {
+			/* Message too large to be batched */
+			rc = udp_assoc_send_msg(assoc, msgs[sent].dest,
+			    (void *) msgs[sent].data, msgs[sent].size);
+			if (rc != EOK)
+				break;
+
+			++sent;
+			continue;
+		}
+
+		exch = async_exchange_begin(assoc->udp->sess);
+		aid_t req = async_send_2(exch, UDP_ASSOC_SEND_BATCH, assoc->id,
+		    bcount, &answer);
+		rc = async_data_write_start(exch, buf, used);
+		async_exchange_end(exch);
+
+		if (rc != EOK) {
+			async_forget(req);
+			break;
+		}
+
+		async_wait_for(req, &rc);
+		sent += ipc_get_arg1(&answer);
+		if (rc != EOK)
+			break;
+	}
+
+	free(buf);
+	if (nsent != NULL)
+		*nsent = sent;
+	return rc;
+}
+
+/** Get UDP association statistics.
+ *
+ * @param assoc Association
+ * @param stats Place to store statistics
+ *
+ * @return EOK on success or an error code
+ */
+errno_t udp_assoc_get_stats(udp_assoc_t *assoc, udp_assoc_stats_t *stats)
+{
+	async_exch_t *exch;
+	sysarg_t queued;
+	sysarg_t drops;
+
+	exch = async_exchange_begin(assoc->udp->sess);
+	errno_t rc = async_req_1_2(exch, UDP_ASSOC_GET_STATS, assoc->id,
+	    &queued, &drops);
+	async_exchange_end(exch);
+
+	if (rc != EOK)
+		return rc;
+
+	stats->queued = queued;
+	stats->drops = drops;
+	return EOK;
+}
+
 /** Get the user/callback argument for an association.
  *
  * @param assoc UDP association
@@ -322,6 +449,16 @@ errno_t udp_rmsg_read(udp_rmsg_t *rmsg, size_t off, void *buf, size_t bsize)
 	async_exch_t *exch;
 	ipc_call_t answer;
 
+	if (rmsg->data != NULL) {
+		/* Message was received in a batch */
+		if (off > rmsg->size)
+			return EINVAL;
+
+		memcpy(buf, (const uint8_t *) rmsg->data + off,
+		    min(rmsg->size - off, bsize));
+		return EOK;
+	}
+
 	exch = async_exchange_begin(rmsg->udp->sess);
 	aid_t req = async_send_1(exch, UDP_RMSG_READ, off, &answer);
 	errno_t rc = async_data_read_start(exch, buf, bsize);
@@ -406,6 +543,7 @@ static errno_t udp_rmsg_info(udp_t *udp, udp_rmsg_t *rmsg)
 	rmsg->assoc_id = ipc_get_arg1(&answer);
 	rmsg->size = ipc_get_arg2(&answer);
 	rmsg->remote_ep = ep;
+	rmsg->data = NULL;
 	return EOK;
 }
 
@@ -425,6 +563,41 @@ static errno_t udp_rmsg_discard(udp_t *udp)
 	return rc;
 }
 
+/** Read batch of received messages from UDP service.
+ *
+ * @param udp    UDP client
+ * @param rcount Place to store number of messages read. Zero if the
+ *               next message is too large to be read in a batch.
+ * @param rused  Place to store number of bytes of @c udp->rbuf used
+ *
+ * @return EOK on success, ENOENT if there are no more messages or
+ *         an error code
+ */
+static errno_t udp_rmsg_read_batch(udp_t *udp, size_t *rcount, size_t *rused)
+{
+	async_exch_t *exch;
+	ipc_call_t answer;
+
+	exch = async_exchange_begin(udp->sess);
+	aid_t req = async_send_0(exch, UDP_RMSG_READ_BATCH, &answer);
+	errno_t rc = async_data_read_start(exch, udp->rbuf, UDP_BATCH_BUF_SIZE);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		return rc;
+	}
+
+	errno_t retval;
+	async_wait_for(req, &retval);
+	if (retval != EOK)
+		return retval;
+
+	*rcount = ipc_get_arg1(&answer);
+	*rused = ipc_get_arg2(&answer);
+	return EOK;
+}
+
 /** Get association based on its ID.
  *
  * @param udp    UDP client
@@ -447,8 +620,9 @@ static errno_t udp_assoc_get(udp_t *udp, sysarg_t id, udp_assoc_t **rassoc)
 
 /** Handle 'data' event, i.e. some message(s) arrived.
  *
- * For each received message, get information about it, call @c recv_msg
- * callback and discard it.
+ * Read received messages from the service in batches and call @c recv_msg
+ * callback for each of them. Messages too large to fit in a batch are
+ * read piece-wise.
  *
  * @param udp   UDP client
  * @param icall IPC message
@@ -456,27 +630,55 @@ static errno_t udp_assoc_get(udp_t *udp, sysarg_t id, udp_assoc_t **rassoc)
  */
 static void udp_ev_data(udp_t *udp, ipc_call_t *icall)
 {
+	udp_batch_hdr_t *hdr;
 	udp_rmsg_t rmsg;
 	udp_assoc_t *assoc;
+	size_t count;
+	size_t used;
+	size_t off;
+	size_t i;
 	errno_t rc;
 
 	while (true) {
-		rc = udp_rmsg_info(udp, &rmsg);
-		if (rc != EOK) {
+		rc = udp_rmsg_read_batch(udp, &count, &used);
+		if (rc != EOK)
 			break;
-		}
 
-		rc = udp_assoc_get(udp, rmsg.assoc_id, &assoc);
-		if (rc != EOK) {
+		if (count == 0) {
+			/* Message too large for a batch, read it piece-wise */
+			rc = udp_rmsg_info(udp, &rmsg);
+			if (rc != EOK)
+				break;
+
+			rc = udp_assoc_get(udp, rmsg.assoc_id, &assoc);
+			if (rc == EOK && assoc->cb != NULL &&
+			    assoc->cb->recv_msg != NULL)
+				assoc->cb->recv_msg(assoc, &rmsg);
+
+			rc = udp_rmsg_discard(udp);
+			if (rc != EOK)
+				break;
+
 			continue;
 		}
 
-		if (assoc->cb != NULL && assoc->cb->recv_msg != NULL)
-			assoc->cb->recv_msg(assoc, &rmsg);
+		off = 0;
+		for (i = 0; i < count; i++) {
+			hdr = (udp_batch_hdr_t *) ((uint8_t *) udp->rbuf + off);
 
-		rc = udp_rmsg_discard(udp);
-		if (rc != EOK) {
-			break;
+			rmsg.udp = udp;
+			rmsg.assoc_id = hdr->assoc_id;
+			rmsg.size = hdr->size;
+			rmsg.remote_ep = hdr->remote;
+			rmsg.data = hdr + 1;
+
+			rc = udp_assoc_get(udp, rmsg.assoc_id, &assoc);
+			if (rc == EOK && assoc->cb != NULL &&
+			    assoc->cb->recv_msg != NULL)
+				assoc->cb->recv_msg(assoc, &rmsg);
+
+			off += ALIGN_UP(sizeof(udp_batch_hdr_t) + hdr->size,
+			    UDP_BATCH_ALIGN);
 		}
 	}
 
@@ -34,11 +34,13 @@
  * @brief IP link client stub
  */
 
+#include <as.h>
 #include <async.h>
 #include <assert.h>
 #include <errno.h>
 #include <inet/iplink.h>
 #include <inet/addr.h>
+#include <inet/pbuf.h>
 #include <ipc/iplink.h>
 #include <ipc/services.h>
 #include <loc.h>
@@ -81,6 +83,7 @@ error:
 void iplink_close(iplink_t *iplink)
 {
 	/* XXX Synchronize with iplink_cb_conn */
+	pbuf_pool_destroy(iplink->pool);
 	free(iplink);
 }
 
@@ -89,8 +92,11 @@ errno_t iplink_send(iplink_t *iplink, iplink_sdu_t *sdu)
 	async_exch_t *exch = async_exchange_begin(iplink->sess);
 
 	ipc_call_t answer;
-	aid_t req = async_send_2(exch, IPLINK_SEND, (sysarg_t) sdu->src,
-	    (sysarg_t) sdu->dest, &answer);
+	aid_t req = async_send_4(exch, IPLINK_SEND, (sysarg_t) sdu->src,
+	    (sysarg_t) sdu->dest,
+	    sdu->offload.flags | ((sysarg_t) sdu->offload.gso_size << 16),
+	    sdu->offload.csum_start |
+	    ((sysarg_t) sdu->offload.csum_offset << 16), &answer);
 
 	errno_t rc = async_data_write_start(exch, sdu->data, sdu->size);
 
@@ -112,7 +118,10 @@ errno_t iplink_send6(iplink_t *iplink, iplink_sdu6_t *sdu)
 	async_exch_t *exch = async_exchange_begin(iplink->sess);
 
 	ipc_call_t answer;
-	aid_t req = async_send_0(exch, IPLINK_SEND6, &answer);
+	aid_t req = async_send_2(exch, IPLINK_SEND6,
+	    sdu->offload.flags | ((sysarg_t) sdu->offload.gso_size << 16),
+	    sdu->offload.csum_start |
+	    ((sysarg_t) sdu->offload.csum_offset << 16), &answer);
 
 	errno_t rc = async_data_write_start(exch, &sdu->dest, sizeof(addr48_t));
 	if (rc != EOK) {
@@ -152,6 +161,28 @@ errno_t iplink_get_mtu(iplink_t *iplink, size_t *rmtu)
 	return EOK;
 }
 
+/** Get offload capabilities of the link.
+ *
+ * @param iplink	IP link
+ * @param rcaps		Place to store IPLINK_OFFLOAD_* capabilities
+ *
+ * @return EOK on success, ENOTSUP if the link offloads nothing
+ */
+errno_t iplink_get_offload(iplink_t *iplink, uint32_t *rcaps)
+{
+	sysarg_t caps;
+	async_exch_t *exch = async_exchange_begin(iplink->sess);
+
+	errno_t rc = async_req_0_1(exch, IPLINK_GET_OFFLOAD, &caps);
+	async_exchange_end(exch);
+
+	if (rc != EOK)
+		return rc;
+
+	*rcaps = caps;
+	return EOK;
+}
+
 errno_t iplink_get_mac48(iplink_t *iplink, addr48_t *mac)
 {
 	async_exch_t *exch = async_exchange_begin(iplink->sess);
@@ -248,6 +279,7 @@ static void iplink_ev_recv(iplink_t *iplink, ipc_call_t *icall)
 	iplink_recv_sdu_t sdu;
 
 	ip_ver_t ver = ipc_get_arg1(icall);
+	sdu.offload = ipc_get_arg2(icall);
 
 	errno_t rc = async_data_write_accept(&sdu.data, false, 0, 0, 0,
 	    &sdu.size);
@@ -261,6 +293,93 @@ static void iplink_ev_recv(iplink_t *iplink, ipc_call_t *icall)
 	async_answer_0(icall, rc);
 }
 
+static void iplink_ev_pool(iplink_t *iplink, ipc_call_t *icall)
+{
+	size_t count = ipc_get_arg1(icall);
+	size_t bsize = ipc_get_arg2(icall);
+	ipc_call_t call;
+	size_t size;
+	unsigned int flags;
+	void *area;
+	pbuf_pool_t *pool;
+	errno_t rc;
+
+	if (!async_share_out_receive(&call, &size, &flags)) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(icall, EINVAL);
+		return;
+	}
+
+	if (iplink->pool != NULL || size != pbuf_pool_area_size(count, bsize) ||
+	    (flags & AS_AREA_WRITE) == 0) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(icall, EINVAL);
+		return;
+	}
+
+	rc = async_share_out_finalize(&call, &area);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	rc = pbuf_pool_attach(area, count, bsize, &pool);
+	if (rc != EOK) {
+		as_area_destroy(area);
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	iplink->pool = pool;
+	async_answer_0(icall, EOK);
+}
+
+static void iplink_ev_recv_batch(iplink_t *iplink, ipc_call_t *icall)
+{
+	iplink_pbuf_desc_t *desc;
+	iplink_recv_sdu_t sdu;
+	size_t cnt = ipc_get_arg1(icall);
+	size_t size;
+	size_t i;
+	pbuf_t pbuf;
+	errno_t rc;
+
+	if (iplink->pool == NULL || cnt == 0 || cnt > IPLINK_BATCH_MAX) {
+		async_answer_0(icall, EINVAL);
+		return;
+	}
+
+	rc = async_data_write_accept((void **) &desc, false,
+	    cnt * sizeof(iplink_pbuf_desc_t), cnt * sizeof(iplink_pbuf_desc_t),
+	    0, &size);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	/*
+	 * From now on we hold the references to all packets in the batch
+	 * and must release them once processed.
+	 */
+	async_answer_0(icall, EOK);
+
+	for (i = 0; i < cnt; i++) {
+		rc = pbuf_get(iplink->pool, desc[i].idx, desc[i].off,
+		    desc[i].len, &pbuf);
+		if (rc != EOK)
+			continue;
+
+		sdu.data = pbuf_data(&pbuf);
+		sdu.size = pbuf.len;
+		sdu.offload = desc[i].offload;
+
+		(void) iplink->ev_ops->recv(iplink, &sdu, desc[i].ver);
+		pbuf_release(&pbuf);
+	}
+
+	free(desc);
+}
+
 static void iplink_ev_change_addr(iplink_t *iplink, ipc_call_t *icall)
 {
 	addr48_t *addr;
@@ -298,6 +417,12 @@ static void iplink_cb_conn(ipc_call_t *icall, void *arg)
 		case IPLINK_EV_CHANGE_ADDR:
 			iplink_ev_change_addr(iplink, &call);
 			break;
+		case IPLINK_EV_POOL:
+			iplink_ev_pool(iplink, &call);
+			break;
+		case IPLINK_EV_RECV_BATCH:
+			iplink_ev_recv_batch(iplink, &call);
+			break;
 		default:
 			async_answer_0(&call, ENOTSUP);
 		}
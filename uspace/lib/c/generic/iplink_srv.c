@@ -34,12 +34,17 @@
  * @brief IP link server stub
  */
 
+#include <as.h>
+#include <assert.h>
 #include <errno.h>
+#include <fibril.h>
 #include <ipc/iplink.h>
+#include <mem.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <inet/addr.h>
 #include <inet/iplink_srv.h>
+#include <inet/pbuf.h>
 
 static void iplink_get_mtu_srv(iplink_srv_t *srv, ipc_call_t *call)
 {
@@ -48,6 +53,17 @@ static void iplink_get_mtu_srv(iplink_srv_t *srv, ipc_call_t *call)
 	async_answer_1(call, rc, mtu);
 }
 
+static void iplink_get_offload_srv(iplink_srv_t *srv, ipc_call_t *call)
+{
+	uint32_t caps = 0;
+	errno_t rc = EOK;
+
+	if (srv->ops->get_offload != NULL)
+		rc = srv->ops->get_offload(srv, &caps);
+
+	async_answer_1(call, rc, caps);
+}
+
 static void iplink_get_mac48_srv(iplink_srv_t *srv, ipc_call_t *icall)
 {
 	addr48_t mac;
@@ -163,6 +179,10 @@ static void iplink_send_srv(iplink_srv_t *srv, ipc_call_t *icall)
 
 	sdu.src = ipc_get_arg1(icall);
 	sdu.dest = ipc_get_arg2(icall);
+	sdu.offload.flags = ipc_get_arg3(icall) & 0xffff;
+	sdu.offload.gso_size = ipc_get_arg3(icall) >> 16;
+	sdu.offload.csum_start = ipc_get_arg4(icall) & 0xffff;
+	sdu.offload.csum_offset = ipc_get_arg4(icall) >> 16;
 
 	errno_t rc = async_data_write_accept(&sdu.data, false, 0, 0, 0,
 	    &sdu.size);
@@ -180,6 +200,11 @@ static void iplink_send6_srv(iplink_srv_t *srv, ipc_call_t *icall)
 {
 	iplink_sdu6_t sdu;
 
+	sdu.offload.flags = ipc_get_arg1(icall) & 0xffff;
+	sdu.offload.gso_size = ipc_get_arg1(icall) >> 16;
+	sdu.offload.csum_start = ipc_get_arg2(icall) & 0xffff;
+	sdu.offload.csum_offset = ipc_get_arg2(icall) >> 16;
+
 	ipc_call_t call;
 	size_t size;
 	if (!async_data_write_receive(&call, &size)) {
@@ -219,6 +244,24 @@ void iplink_srv_init(iplink_srv_t *srv)
 	srv->ops = NULL;
 	srv->arg = NULL;
 	srv->client_sess = NULL;
+	srv->pool = NULL;
+	srv->pool_shared = false;
+	srv->batch_cnt = 0;
+	fibril_condvar_initialize(&srv->batch_cv);
+	srv->batch_fibril = false;
+}
+
+/** Set pool of received packets.
+ *
+ * Packets allocated from @a pool can be passed to the client by reference
+ * using iplink_ev_recv_pbuf(). Must be called before the client connects.
+ *
+ * @param srv  IP link server
+ * @param pool Packet buffer pool owned by the server
+ */
+void iplink_srv_set_pool(iplink_srv_t *srv, pbuf_pool_t *pool)
+{
+	srv->pool = pool;
 }
 
 errno_t iplink_conn(ipc_call_t *icall, void *arg)
@@ -243,7 +286,10 @@ errno_t iplink_conn(ipc_call_t *icall, void *arg)
 	if (sess == NULL)
 		return ENOMEM;
 
+	fibril_mutex_lock(&srv->lock);
 	srv->client_sess = sess;
+	srv->pool_shared = false;
+	fibril_mutex_unlock(&srv->lock);
 
 	rc = srv->ops->open(srv);
 	if (rc != EOK)
@@ -285,6 +331,9 @@ errno_t iplink_conn(ipc_call_t *icall, void *arg)
 		case IPLINK_ADDR_REMOVE:
 			iplink_addr_remove_srv(srv, &call);
 			break;
+		case IPLINK_GET_OFFLOAD:
+			iplink_get_offload_srv(srv, &call);
+			break;
 		default:
 			async_answer_0(&call, EINVAL);
 		}
@@ -302,8 +351,8 @@ errno_t iplink_ev_recv(iplink_srv_t *srv, iplink_recv_sdu_t *sdu, ip_ver_t ver)
 	async_exch_t *exch = async_exchange_begin(srv->client_sess);
 
 	ipc_call_t answer;
-	aid_t req = async_send_1(exch, IPLINK_EV_RECV, (sysarg_t)ver,
-	    &answer);
+	aid_t req = async_send_2(exch, IPLINK_EV_RECV, (sysarg_t)ver,
+	    sdu->offload, &answer);
 
 	errno_t rc = async_data_write_start(exch, sdu->data, sdu->size);
 	async_exchange_end(exch);
@@ -321,6 +370,169 @@ errno_t iplink_ev_recv(iplink_srv_t *srv, iplink_recv_sdu_t *sdu, ip_ver_t ver)
 	return EOK;
 }
 
+/** Share pool of received packets with the client.
+ *
+ * @param srv  IP link server
+ * @param sess Client callback session
+ * @return EOK on success or an error code
+ */
+static errno_t iplink_ev_pool(iplink_srv_t *srv, async_sess_t *sess)
+{
+	async_exch_t *exch = async_exchange_begin(sess);
+
+	aid_t req = async_send_2(exch, IPLINK_EV_POOL, srv->pool->count,
+	    srv->pool->size, NULL);
+	errno_t rc = async_share_out_start(exch, srv->pool->area,
+	    AS_AREA_READ | AS_AREA_WRITE);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		return rc;
+	}
+
+	errno_t retval;
+	async_wait_for(req, &retval);
+	return retval;
+}
+
+/** Pass a batch of received packets to the client.
+ *
+ * If the client cannot map our pool, the packets are copied.
+ *
+ * @param srv  IP link server
+ * @param sess Client callback session
+ * @param desc Packets
+ * @param cnt  Number of packets
+ */
+static void iplink_ev_recv_batch(iplink_srv_t *srv, async_sess_t *sess,
+    iplink_pbuf_desc_t *desc, size_t cnt)
+{
+	iplink_recv_sdu_t sdu;
+	pbuf_t pbuf;
+	errno_t rc;
+	size_t i;
+
+	if (!srv->pool_shared && iplink_ev_pool(srv, sess) == EOK)
+		srv->pool_shared = true;
+
+	if (srv->pool_shared) {
+		async_exch_t *exch = async_exchange_begin(sess);
+		aid_t req = async_send_1(exch, IPLINK_EV_RECV_BATCH, cnt, NULL);
+		rc = async_data_write_start(exch, desc,
+		    cnt * sizeof(iplink_pbuf_desc_t));
+		async_exchange_end(exch);
+
+		if (rc == EOK) {
+			/* The client has taken over the references */
+			async_wait_for(req, NULL);
+			return;
+		}
+
+		async_forget(req);
+	}
+
+	for (i = 0; i < cnt; i++) {
+		(void) pbuf_get(srv->pool, desc[i].idx, desc[i].off,
+		    desc[i].len, &pbuf);
+		sdu.data = pbuf_data(&pbuf);
+		sdu.size = pbuf.len;
+		sdu.offload = desc[i].offload;
+		(void) iplink_ev_recv(srv, &sdu, desc[i].ver);
+		pbuf_release(&pbuf);
+	}
+}
+
+/** Fibril passing received packets to the client in batches.
+ *
+ * While the client processes one batch, further packets accumulate
+ * and are passed in the next batch.
+ *
+ * @param arg IP link server
+ * @return EOK
+ */
+static errno_t iplink_batch_fibril(void *arg)
+{
+	iplink_srv_t *srv = (iplink_srv_t *) arg;
+	iplink_pbuf_desc_t desc[IPLINK_BATCH_MAX];
+	async_sess_t *sess;
+	size_t cnt;
+
+	while (true) {
+		fibril_mutex_lock(&srv->lock);
+		while (srv->batch_cnt == 0)
+			fibril_condvar_wait(&srv->batch_cv, &srv->lock);
+
+		cnt = srv->batch_cnt;
+		memcpy(desc, srv->batch, cnt * sizeof(iplink_pbuf_desc_t));
+		srv->batch_cnt = 0;
+		sess = srv->client_sess;
+		fibril_condvar_broadcast(&srv->batch_cv);
+		fibril_mutex_unlock(&srv->lock);
+
+		iplink_ev_recv_batch(srv, sess, desc, cnt);
+	}
+
+	return EOK;
+}
+
+/** Pass received packet to the client by reference.
+ *
+ * The packet is queued and passed to the client together with other
+ * packets received in the meantime. The reference to the packet buffer
+ * is passed on, the caller must not use @a pbuf afterwards.
+ *
+ * @param srv     IP link server
+ * @param pbuf    Packet from the pool set with iplink_srv_set_pool()
+ * @param ver     IP version
+ * @param offload INET_OFFLOAD_* flags
+ *
+ * @return EOK on success or an error code
+ */
+errno_t iplink_ev_recv_pbuf(iplink_srv_t *srv, pbuf_t *pbuf, ip_ver_t ver,
+    uint16_t offload)
+{
+	iplink_pbuf_desc_t *desc;
+	fid_t fid;
+
+	assert(pbuf->pool == srv->pool);
+
+	fibril_mutex_lock(&srv->lock);
+
+	if (srv->client_sess == NULL) {
+		fibril_mutex_unlock(&srv->lock);
+		pbuf_release(pbuf);
+		return EIO;
+	}
+
+	if (!srv->batch_fibril) {
+		fid = fibril_create(iplink_batch_fibril, srv);
+		if (fid == 0) {
+			fibril_mutex_unlock(&srv->lock);
+			pbuf_release(pbuf);
+			return ENOMEM;
+		}
+
+		fibril_add_ready(fid);
+		srv->batch_fibril = true;
+	}
+
+	/* Apply back-pressure if the client does not keep up */
+	while (srv->batch_cnt == IPLINK_BATCH_MAX)
+		fibril_condvar_wait(&srv->batch_cv, &srv->lock);
+
+	desc = &srv->batch[srv->batch_cnt++];
+	desc->idx = pbuf->idx;
+	desc->off = pbuf->off;
+	desc->len = pbuf->len;
+	desc->offload = offload;
+	desc->ver = ver;
+
+	fibril_condvar_broadcast(&srv->batch_cv);
+	fibril_mutex_unlock(&srv->lock);
+	return EOK;
+}
+
 errno_t iplink_ev_change_addr(iplink_srv_t *srv, addr48_t *addr)
 {
 	if (srv->client_sess == NULL)
@@ -906,6 +906,56 @@ errno_t vfs_read_short(int file, aoff64_t pos, void *buf, size_t nbyte,
 	return EOK;
 }
 
+/** Read a batch of directory entries
+ *
+ * Read as many entries as fit into @a buf starting at directory position
+ * @a pos. The entries are returned as a sequence of vfs_dirent_t records.
+ * If @a flags contains VFS_READDIR_STAT, the attributes of each entry are
+ * returned as well, saving a separate walk and stat for every entry.
+ *
+ * @param file          Handle of a directory open for reading
+ * @param[in,out] pos   Position to read from, updated to the position
+ *                      following the last entry returned
+ * @param flags         Flags (VFS_READDIR_*)
+ * @param buf           Buffer for the entry records
+ * @param size          Size of @a buf in bytes
+ * @param[out] count    Number of entries returned (zero at the end of the
+ *                      directory)
+ *
+ * @return              EOK on success, ENOTSUP if the file system does not
+ *                      support batched directory reads or another error code
+ */
+errno_t vfs_readdir(int file, aoff64_t *pos, unsigned flags, void *buf,
+    size_t size, size_t *count)
+{
+	errno_t rc;
+	ipc_call_t answer;
+	aid_t req;
+
+	if (size > DATA_XFER_LIMIT)
+		size = DATA_XFER_LIMIT;
+
+	async_exch_t *exch = vfs_exchange_begin();
+
+	req = async_send_4(exch, VFS_IN_READDIR, file, LOWER32(*pos),
+	    UPPER32(*pos), flags, &answer);
+	rc = async_data_read_start(exch, buf, size);
+
+	vfs_exchange_end(exch);
+
+	if (rc == EOK)
+		async_wait_for(req, &rc);
+	else
+		async_forget(req);
+
+	if (rc != EOK)
+		return rc;
+
+	*count = ipc_get_arg1(&answer);
+	*pos = MERGE_LOUP32(ipc_get_arg2(&answer), ipc_get_arg3(&answer));
+	return EOK;
+}
+
 /** Rename a file or directory
  *
  * There is no file-handle-based variant to disallow attempts to introduce loops
@@ -36,12 +36,34 @@
 #define _LIBC_BD_H_
 
 #include <async.h>
+#include <ipc/bd.h>
 #include <offset.h>
 
 typedef struct {
 	async_sess_t *sess;
 } bd_t;
 
+/** One buffer of a vectored transfer */
+typedef struct {
+	void *buf;
+	size_t size;
+} bd_iov_t;
+
+/** Block transfer submitted with bd_read*_submit() or bd_write*_submit().
+ *
+ * The request is identified by its IPC call, so the server may complete
+ * requests in any order. The structure must stay valid until the request
+ * is reaped by bd_aio_wait().
+ */
+typedef struct {
+	/** Block transfer request */
+	aid_t req;
+	/** Number of pending data transfers */
+	size_t nxfer;
+	/** Data transfers carrying the individual buffers of a read */
+	aid_t xfer[BD_IOV_MAX];
+} bd_aio_t;
+
 extern errno_t bd_open(async_sess_t *, bd_t **);
 extern void bd_close(bd_t *);
 extern errno_t bd_read_blocks(bd_t *, aoff64_t, size_t, void *, size_t);
@@ -50,6 +72,24 @@ extern errno_t bd_write_blocks(bd_t *, aoff64_t, size_t, const void *, size_t);
 extern errno_t bd_sync_cache(bd_t *, aoff64_t, size_t);
 extern errno_t bd_get_block_size(bd_t *, size_t *);
 extern errno_t bd_get_num_blocks(bd_t *, aoff64_t *);
+extern errno_t bd_get_queue_depth(bd_t *, size_t, size_t *);
+
+extern errno_t bd_read_blocks_submit(bd_t *, aoff64_t, size_t, void *, size_t,
+    bd_aio_t *);
+extern errno_t bd_readv_blocks_submit(bd_t *, aoff64_t, size_t,
+    const bd_iov_t *, size_t, bd_aio_t *);
+extern errno_t bd_write_blocks_submit(bd_t *, aoff64_t, size_t, const void *,
+    size_t, bd_aio_t *);
+extern errno_t bd_writev_blocks_submit(bd_t *, aoff64_t, size_t,
+    const bd_iov_t *, size_t, bd_aio_t *);
+extern errno_t bd_aio_wait(bd_aio_t *);
+
+extern errno_t bd_pool_share(bd_t *, void *, unsigned *);
+extern errno_t bd_pool_unshare(bd_t *, unsigned);
+extern errno_t bd_pool_read_blocks_submit(bd_t *, aoff64_t, size_t, unsigned,
+    size_t, bd_aio_t *);
+extern errno_t bd_pool_write_blocks_submit(bd_t *, aoff64_t, size_t, unsigned,
+    size_t, bd_aio_t *);
 
 #endif
 
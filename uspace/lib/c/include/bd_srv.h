@@ -38,11 +38,22 @@
 #include <adt/list.h>
 #include <async.h>
 #include <fibril_synch.h>
+#include <ipc/bd.h>
 #include <stdbool.h>
 #include <offset.h>
 
 typedef struct bd_ops bd_ops_t;
 
+/** Memory pool shared by a client (per client session) */
+typedef struct {
+	/** Address of the pool or NULL if the slot is free */
+	void *addr;
+	/** Size of the pool in bytes */
+	size_t size;
+	/** Driver argument, e.g. the ID of the pool shared further down */
+	sysarg_t arg;
+} bd_pool_t;
+
 /** Service setup (per sevice) */
 typedef struct {
 	bd_ops_t *ops;
@@ -54,6 +65,18 @@ typedef struct {
 	bd_srvs_t *srvs;
 	async_sess_t *client_sess;
 	void *carg;
+	/** Number of transfers processed concurrently */
+	size_t qdepth;
+	/** Protects @c inflight */
+	fibril_mutex_t qlock;
+	/** Signalled when a transfer completes */
+	fibril_condvar_t qcv;
+	/** Number of transfers in progress */
+	size_t inflight;
+	/** Memory pools shared by the client */
+	bd_pool_t pool[BD_POOL_MAX];
+	/** Block size used to check pool transfers */
+	size_t block_size;
 } bd_srv_t;
 
 struct bd_ops {
@@ -65,6 +88,25 @@ struct bd_ops {
 	errno_t (*write_blocks)(bd_srv_t *, aoff64_t, size_t, const void *, size_t);
 	errno_t (*get_block_size)(bd_srv_t *, size_t *);
 	errno_t (*get_num_blocks)(bd_srv_t *, aoff64_t *);
+	/**
+	 * Get the number of transfers the device can have in flight. Drivers
+	 * which implement this operation allow read_blocks and write_blocks
+	 * to be called concurrently from several fibrils.
+	 */
+	errno_t (*get_queue_depth)(bd_srv_t *, size_t *);
+	/**
+	 * Shared memory pools. All of these are optional. Transfers into or
+	 * out of a pool are passed to read_blocks and write_blocks with
+	 * a pointer into the pool unless pool_read_blocks and
+	 * pool_write_blocks are provided, which allows a driver to forward
+	 * them without touching the data.
+	 */
+	errno_t (*pool_share)(bd_srv_t *, bd_pool_t *);
+	void (*pool_unshare)(bd_srv_t *, bd_pool_t *);
+	errno_t (*pool_read_blocks)(bd_srv_t *, aoff64_t, size_t, bd_pool_t *,
+	    size_t);
+	errno_t (*pool_write_blocks)(bd_srv_t *, aoff64_t, size_t, bd_pool_t *,
+	    size_t);
 };
 
 extern void bd_srvs_init(bd_srvs_t *);
@@ -37,6 +37,10 @@
 
 #include <_bits/decls.h>
 
+#ifdef _HELENOS_SOURCE
+#include <vfs/vfs.h>
+#endif
+
 __C_DECLS_BEGIN;
 
 struct dirent {
@@ -50,6 +54,10 @@ extern struct dirent *readdir(DIR *);
 extern void rewinddir(DIR *);
 extern int closedir(DIR *);
 
+#ifdef _HELENOS_SOURCE
+extern struct dirent *readdir_stat(DIR *, vfs_stat_t *);
+#endif
+
 __C_DECLS_END;
 
 #endif
@@ -37,13 +37,26 @@
 
 #include <async.h>
 #include <inet/addr.h>
+#include <types/inet.h>
+
+/** Link completes transport checksums (INET_OFFLOAD_CSUM) */
+#define IPLINK_OFFLOAD_TX_CSUM	0x01
+/** Link verifies transport checksums (INET_OFFLOAD_CSUM_VALID) */
+#define IPLINK_OFFLOAD_RX_CSUM	0x02
+/** Link segments TCP over IPv4 (INET_OFFLOAD_TSO) */
+#define IPLINK_OFFLOAD_TSO4	0x04
+/** Link segments TCP over IPv6 (INET_OFFLOAD_TSO) */
+#define IPLINK_OFFLOAD_TSO6	0x08
 
 struct iplink_ev_ops;
+struct pbuf_pool;
 
 typedef struct {
 	async_sess_t *sess;
 	struct iplink_ev_ops *ev_ops;
 	void *arg;
+	/** Pool of received packets shared by the link or @c NULL */
+	struct pbuf_pool *pool;
 } iplink_t;
 
 /** IPv4 link Service Data Unit */
@@ -56,6 +69,8 @@ typedef struct {
 	void *data;
 	/** Size of @c data in bytes */
 	size_t size;
+	/** Offloaded work */
+	inet_offload_t offload;
 } iplink_sdu_t;
 
 /** IPv6 link Service Data Unit */
@@ -66,6 +81,8 @@ typedef struct {
 	void *data;
 	/** Size of @c data in bytes */
 	size_t size;
+	/** Offloaded work */
+	inet_offload_t offload;
 } iplink_sdu6_t;
 
 /** Internet link receive Service Data Unit */
@@ -74,6 +91,8 @@ typedef struct {
 	void *data;
 	/** Size of @c data in bytes */
 	size_t size;
+	/** INET_OFFLOAD_* flags describing work done by the link */
+	uint16_t offload;
 } iplink_recv_sdu_t;
 
 typedef struct iplink_ev_ops {
@@ -88,6 +107,7 @@ extern errno_t iplink_send6(iplink_t *, iplink_sdu6_t *);
 extern errno_t iplink_addr_add(iplink_t *, inet_addr_t *);
 extern errno_t iplink_addr_remove(iplink_t *, inet_addr_t *);
 extern errno_t iplink_get_mtu(iplink_t *, size_t *);
+extern errno_t iplink_get_offload(iplink_t *, uint32_t *);
 extern errno_t iplink_get_mac48(iplink_t *, addr48_t *);
 extern errno_t iplink_set_mac48(iplink_t *, addr48_t);
 extern void *iplink_get_userptr(iplink_t *);
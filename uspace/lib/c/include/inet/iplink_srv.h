@@ -40,6 +40,8 @@
 #include <stdbool.h>
 #include <inet/addr.h>
 #include <inet/iplink.h>
+#include <inet/pbuf.h>
+#include <ipc/iplink.h>
 
 struct iplink_ops;
 
@@ -49,6 +51,18 @@ typedef struct {
 	struct iplink_ops *ops;
 	void *arg;
 	async_sess_t *client_sess;
+	/** Pool of received packets or @c NULL */
+	pbuf_pool_t *pool;
+	/** Pool has been shared with the client */
+	bool pool_shared;
+	/** Received packets waiting to be passed to the client */
+	iplink_pbuf_desc_t batch[IPLINK_BATCH_MAX];
+	/** Number of entries in @c batch */
+	size_t batch_cnt;
+	/** Signalled when @c batch changes */
+	fibril_condvar_t batch_cv;
+	/** Batch sending fibril has been started */
+	bool batch_fibril;
 } iplink_srv_t;
 
 typedef struct iplink_ops {
@@ -61,12 +75,17 @@ typedef struct iplink_ops {
 	errno_t (*set_mac48)(iplink_srv_t *, addr48_t *);
 	errno_t (*addr_add)(iplink_srv_t *, inet_addr_t *);
 	errno_t (*addr_remove)(iplink_srv_t *, inet_addr_t *);
+	/** Get IPLINK_OFFLOAD_* capabilities of the link (optional) */
+	errno_t (*get_offload)(iplink_srv_t *, uint32_t *);
 } iplink_ops_t;
 
 extern void iplink_srv_init(iplink_srv_t *);
 
 extern errno_t iplink_conn(ipc_call_t *, void *);
+extern void iplink_srv_set_pool(iplink_srv_t *, pbuf_pool_t *);
 extern errno_t iplink_ev_recv(iplink_srv_t *, iplink_recv_sdu_t *, ip_ver_t);
+extern errno_t iplink_ev_recv_pbuf(iplink_srv_t *, pbuf_t *, ip_ver_t,
+    uint16_t);
 extern errno_t iplink_ev_change_addr(iplink_srv_t *, addr48_t *);
 
 #endif
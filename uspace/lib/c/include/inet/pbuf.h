@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file Packet buffer pool
+ */
+
+#ifndef _LIBC_INET_PBUF_H_
+#define _LIBC_INET_PBUF_H_
+
+#include <errno.h>
+#include <fibril_synch.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Pool of fixed-size packet buffers in memory shared between servers.
+ *
+ * The pool is created by one server (the owner) which allocates buffers.
+ * Other servers map the pool and are handed buffers by reference. Every
+ * buffer has a reference count in the shared memory; the last holder
+ * releases the buffer by dropping its reference, no message is needed
+ * to return it to the owner.
+ */
+typedef struct pbuf_pool {
+	/** Shared area */
+	void *area;
+	/** Reference counts of buffers (in @c area) */
+	atomic_uint *refcnt;
+	/** Buffer data (in @c area) */
+	uint8_t *data;
+	/** Number of buffers */
+	size_t count;
+	/** Size of one buffer */
+	size_t size;
+	/** This is the owner of the pool (can allocate buffers) */
+	bool owner;
+	/** Synchronizes allocation */
+	fibril_mutex_t lock;
+	/** Next buffer to try when allocating */
+	size_t next;
+} pbuf_pool_t;
+
+/** Reference to a packet in a pool buffer.
+ *
+ * The packet occupies @c len bytes starting at offset @c off in the buffer.
+ * Space before the packet (headroom) can be used to prepend headers.
+ */
+typedef struct {
+	/** Pool */
+	pbuf_pool_t *pool;
+	/** Buffer index */
+	uint32_t idx;
+	/** Offset of packet data in buffer */
+	uint32_t off;
+	/** Packet length */
+	uint32_t len;
+} pbuf_t;
+
+extern size_t pbuf_pool_area_size(size_t, size_t);
+extern errno_t pbuf_pool_create(size_t, size_t, pbuf_pool_t **);
+extern errno_t pbuf_pool_attach(void *, size_t, size_t, pbuf_pool_t **);
+extern void pbuf_pool_destroy(pbuf_pool_t *);
+
+extern errno_t pbuf_alloc(pbuf_pool_t *, size_t, size_t, pbuf_t *);
+extern errno_t pbuf_get(pbuf_pool_t *, uint32_t, uint32_t, uint32_t,
+    pbuf_t *);
+extern void pbuf_ref(pbuf_t *);
+extern void pbuf_release(pbuf_t *);
+extern void *pbuf_data(pbuf_t *);
+extern errno_t pbuf_push(pbuf_t *, size_t);
+extern errno_t pbuf_pull(pbuf_t *, size_t);
+extern errno_t pbuf_trim(pbuf_t *, size_t);
+
+#endif
+
+/** @}
+ */
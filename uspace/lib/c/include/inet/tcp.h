@@ -35,9 +35,11 @@
 #ifndef _LIBC_INET_TCP_H_
 #define _LIBC_INET_TCP_H_
 
+#include <adt/hash_table.h>
 #include <fibril_synch.h>
 #include <inet/addr.h>
 #include <inet/endpoint.h>
+#include <types/inet/tcp.h>
 #include <inet/inet.h>
 
 /** TCP connection */
@@ -45,7 +47,8 @@ typedef struct {
 	fibril_mutex_t lock;
 	fibril_condvar_t cv;
 	struct tcp *tcp;
-	link_t ltcp;
+	/** Link to tcp_t.conn */
+	ht_link_t ltcp;
 	sysarg_t id;
 	struct tcp_cb *cb;
 	void *cb_arg;
@@ -54,12 +57,26 @@ typedef struct {
 	bool connected;
 	bool conn_failed;
 	bool conn_reset;
+	/** Some space was made available in the send ring */
+	bool space_avail;
+	/** Shared data rings or @c NULL if data is passed in IPC messages */
+	struct tcp_ring_area *ring;
+	/** Size of each data ring */
+	size_t ring_size;
 } tcp_conn_t;
 
+/** Callback producing data for tcp_conn_send_fill().
+ *
+ * Arguments are the callback argument, buffer, buffer size and place to
+ * store number of bytes written to the buffer.
+ */
+typedef errno_t (*tcp_conn_fill_t)(void *, void *, size_t, size_t *);
+
 /** TCP connection listener */
 typedef struct {
 	struct tcp *tcp;
-	link_t ltcp;
+	/** Link to tcp_t.listener */
+	ht_link_t ltcp;
 	sysarg_t id;
 	struct tcp_listen_cb *lcb;
 	void *lcb_arg;
@@ -85,11 +102,11 @@ typedef struct tcp_listen_cb {
 typedef struct tcp {
 	/** TCP session */
 	async_sess_t *sess;
-	/** List of connections */
-	list_t conn; /* of tcp_conn_t */
-	/** List of listeners */
-	list_t listener; /* of tcp_listener_t */
-	/** TCP service lock */
+	/** Connections by ID */
+	hash_table_t conn; /* of tcp_conn_t */
+	/** Listeners by ID */
+	hash_table_t listener; /* of tcp_listener_t */
+	/** TCP service lock, protects @c conn and @c listener */
 	fibril_mutex_t lock;
 	/** For waiting on cb_done */
 	fibril_condvar_t cv;
@@ -110,9 +127,12 @@ extern void *tcp_listener_userptr(tcp_listener_t *);
 
 extern errno_t tcp_conn_wait_connected(tcp_conn_t *);
 extern errno_t tcp_conn_send(tcp_conn_t *, const void *, size_t);
+extern errno_t tcp_conn_send_fill(tcp_conn_t *, tcp_conn_fill_t, void *,
+    size_t, size_t *);
 extern errno_t tcp_conn_send_fin(tcp_conn_t *);
 extern errno_t tcp_conn_push(tcp_conn_t *);
 extern errno_t tcp_conn_reset(tcp_conn_t *);
+extern errno_t tcp_conn_set_cc(tcp_conn_t *, tcp_cc_alg_t);
 
 extern errno_t tcp_conn_recv(tcp_conn_t *, void *, size_t, size_t *);
 extern errno_t tcp_conn_recv_wait(tcp_conn_t *, void *, size_t, size_t *);
@@ -54,6 +54,8 @@ typedef struct {
 	sysarg_t assoc_id;
 	size_t size;
 	inet_ep_t remote_ep;
+	/** Message data if received in a batch, @c NULL otherwise */
+	const void *data;
 } udp_rmsg_t;
 
 /** UDP received error */
@@ -69,6 +71,24 @@ typedef struct {
 	void *cb_arg;
 } udp_assoc_t;
 
+/** UDP message to send in a batch */
+typedef struct {
+	/** Destination endpoint or @c NULL to use association's remote ep. */
+	inet_ep_t *dest;
+	/** Message data */
+	const void *data;
+	/** Message size in bytes */
+	size_t size;
+} udp_smsg_t;
+
+/** UDP association statistics */
+typedef struct {
+	/** Number of received messages waiting to be delivered */
+	size_t queued;
+	/** Number of received messages dropped because the queue was full */
+	uint64_t drops;
+} udp_assoc_stats_t;
+
 /** UDP callbacks */
 typedef struct udp_cb {
 	void (*recv_msg)(udp_assoc_t *, udp_rmsg_t *);
@@ -88,6 +108,8 @@ typedef struct udp {
 	fibril_condvar_t cv;
 	/** Set to @a true when callback connection handler has terminated */
 	bool cb_done;
+	/** Buffer for receiving batches of messages */
+	void *rbuf;
 } udp_t;
 
 extern errno_t udp_create(udp_t **);
@@ -97,6 +119,9 @@ extern errno_t udp_assoc_create(udp_t *, inet_ep2_t *, udp_cb_t *, void *,
 extern errno_t udp_assoc_set_nolocal(udp_assoc_t *);
 extern void udp_assoc_destroy(udp_assoc_t *);
 extern errno_t udp_assoc_send_msg(udp_assoc_t *, inet_ep_t *, void *, size_t);
+extern errno_t udp_assoc_send_batch(udp_assoc_t *, udp_smsg_t *, size_t,
+    size_t *);
+extern errno_t udp_assoc_get_stats(udp_assoc_t *, udp_assoc_stats_t *);
 extern void *udp_assoc_userptr(udp_assoc_t *);
 extern size_t udp_rmsg_size(udp_rmsg_t *);
 extern errno_t udp_rmsg_read(udp_rmsg_t *, size_t, void *, size_t);
@@ -43,9 +43,25 @@ typedef enum {
 	BD_READ_BLOCKS,
 	BD_SYNC_CACHE,
 	BD_WRITE_BLOCKS,
-	BD_READ_TOC
+	BD_READ_TOC,
+	BD_READV_BLOCKS,
+	BD_WRITEV_BLOCKS,
+	BD_GET_QUEUE_DEPTH,
+	BD_POOL_SHARE,
+	BD_POOL_UNSHARE,
+	BD_POOL_READ_BLOCKS,
+	BD_POOL_WRITE_BLOCKS
 } bd_request_t;
 
+/** Maximum number of buffers of one vectored transfer */
+#define BD_IOV_MAX	8
+
+/** Maximum number of requests a client can have queued at a server */
+#define BD_QUEUE_DEPTH_MAX	32
+
+/** Maximum number of memory pools a client can share with a server */
+#define BD_POOL_MAX	4
+
 #endif
 
 /** @}
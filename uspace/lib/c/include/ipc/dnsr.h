@@ -38,7 +38,8 @@
 typedef enum {
 	DNSR_NAME2HOST = IPC_FIRST_USER_METHOD,
 	DNSR_GET_SRVADDR,
-	DNSR_SET_SRVADDR
+	DNSR_SET_SRVADDR,
+	DNSR_GET_STATS
 } dnsr_request_t;
 
 #endif
@@ -36,6 +36,7 @@
 #define _LIBC_IPC_IPLINK_H_
 
 #include <ipc/common.h>
+#include <stdint.h>
 
 typedef enum {
 	IPLINK_GET_MTU = IPC_FIRST_USER_METHOD,
@@ -44,14 +45,34 @@ typedef enum {
 	IPLINK_SEND,
 	IPLINK_SEND6,
 	IPLINK_ADDR_ADD,
-	IPLINK_ADDR_REMOVE
+	IPLINK_ADDR_REMOVE,
+	IPLINK_GET_OFFLOAD
 } iplink_request_t;
 
 typedef enum {
 	IPLINK_EV_RECV = IPC_FIRST_USER_METHOD,
 	IPLINK_EV_CHANGE_ADDR,
+	IPLINK_EV_POOL,
+	IPLINK_EV_RECV_BATCH
 } iplink_event_t;
 
+/** Maximum number of packets passed in one IPLINK_EV_RECV_BATCH */
+#define IPLINK_BATCH_MAX	32
+
+/** Received packet passed by reference to a buffer of the shared pool */
+typedef struct {
+	/** Buffer index */
+	uint32_t idx;
+	/** Offset of packet in buffer */
+	uint32_t off;
+	/** Packet length */
+	uint32_t len;
+	/** INET_OFFLOAD_* flags */
+	uint16_t offload;
+	/** IP version (ip_ver_t) */
+	uint16_t ver;
+} iplink_pbuf_desc_t;
+
 #endif
 
 /**
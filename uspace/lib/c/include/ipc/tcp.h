@@ -36,6 +36,7 @@
 #define _LIBC_IPC_TCP_H_
 
 #include <ipc/common.h>
+#include <stdatomic.h>
 
 typedef enum {
 	TCP_CALLBACK_CREATE = IPC_FIRST_USER_METHOD,
@@ -48,7 +49,10 @@ typedef enum {
 	TCP_CONN_PUSH,
 	TCP_CONN_RESET,
 	TCP_CONN_RECV,
-	TCP_CONN_RECV_WAIT
+	TCP_CONN_RECV_WAIT,
+	TCP_CONN_SET_CC,
+	TCP_CONN_RING_SHARE,
+	TCP_CONN_RING_KICK
 } tcp_request_t;
 
 typedef enum {
@@ -57,9 +61,54 @@ typedef enum {
 	TCP_EV_CONN_RESET,
 	TCP_EV_DATA,
 	TCP_EV_URG_DATA,
-	TCP_EV_NEW_CONN
+	TCP_EV_NEW_CONN,
+	TCP_EV_SPACE
 } tcp_event_t;
 
+/** Offset of the data rings from the start of a shared ring area */
+#define TCP_RING_DATA_OFF	4096
+
+/** Smallest size of one data ring */
+#define TCP_RING_SIZE_MIN	4096
+/** Largest size of one data ring */
+#define TCP_RING_SIZE_MAX	(4 * 1024 * 1024)
+
+/** Size of a shared ring area with data rings of @a rsize bytes each */
+#define TCP_RING_AREA_SIZE(rsize)	(TCP_RING_DATA_OFF + 2 * (rsize))
+
+/** Control block of one data ring shared by a TCP client and the service.
+ *
+ * @c prod and @c cons are free-running byte counters, the position in
+ * the ring is the counter modulo the ring size (a power of two). Each
+ * side only advances its own counter. A side that runs out of work sets
+ * @c want_data or @c want_space before going idle; the other side clears
+ * the flag and rings the doorbell (TCP_CONN_RING_KICK or an event).
+ */
+typedef struct {
+	/** Number of bytes produced so far */
+	atomic_uint prod;
+	/** Number of bytes consumed so far */
+	atomic_uint cons;
+	/** Consumer waits to be notified about new data */
+	atomic_uint want_data;
+	/** Producer waits to be notified about free space */
+	atomic_uint want_space;
+	/** Producer will not produce any more data */
+	atomic_uint fin;
+} tcp_ring_ctl_t;
+
+/** Memory area shared by a TCP client and the service for one connection.
+ *
+ * The send ring data follows at TCP_RING_DATA_OFF, the receive ring data
+ * follows the send ring data.
+ */
+typedef struct tcp_ring_area {
+	/** Send ring (client produces, service consumes) */
+	tcp_ring_ctl_t snd;
+	/** Receive ring (service produces, client consumes) */
+	tcp_ring_ctl_t rcv;
+} tcp_ring_area_t;
+
 #endif
 
 /** @}
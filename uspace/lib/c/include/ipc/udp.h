@@ -35,6 +35,7 @@
 #ifndef _LIBC_IPC_UDP_H_
 #define _LIBC_IPC_UDP_H_
 
+#include <inet/endpoint.h>
 #include <ipc/common.h>
 
 typedef enum {
@@ -45,13 +46,32 @@ typedef enum {
 	UDP_ASSOC_SEND_MSG,
 	UDP_RMSG_INFO,
 	UDP_RMSG_READ,
-	UDP_RMSG_DISCARD
+	UDP_RMSG_DISCARD,
+	UDP_RMSG_READ_BATCH,
+	UDP_ASSOC_SEND_BATCH,
+	UDP_ASSOC_GET_STATS
 } udp_request_t;
 
 typedef enum {
 	UDP_EV_DATA = IPC_FIRST_USER_METHOD
 } udp_event_t;
 
+/** Message header in UDP_RMSG_READ_BATCH and UDP_ASSOC_SEND_BATCH buffers.
+ *
+ * Each header is followed by message data padded to UDP_BATCH_ALIGN bytes.
+ */
+typedef struct {
+	/** Remote endpoint (source or destination) */
+	inet_ep_t remote;
+	/** Association ID (received messages only) */
+	sysarg_t assoc_id;
+	/** Size of message data */
+	sysarg_t size;
+} udp_batch_hdr_t;
+
+/** Alignment of message headers in batch buffers */
+#define UDP_BATCH_ALIGN 8
+
 #endif
 
 /** @}
@@ -77,6 +77,7 @@ typedef enum {
 	VFS_IN_OPEN,
 	VFS_IN_PUT,
 	VFS_IN_READ,
+	VFS_IN_READDIR,
 	VFS_IN_REGISTER,
 	VFS_IN_RENAME,
 	VFS_IN_RESIZE,
@@ -100,6 +101,8 @@ typedef enum {
 	VFS_OUT_MOUNTED,
 	VFS_OUT_OPEN_NODE,
 	VFS_OUT_READ,
+	VFS_OUT_READDIR,
+	VFS_OUT_READDIR_STAT,
 	VFS_OUT_STAT,
 	VFS_OUT_STATFS,
 	VFS_OUT_SYNC,
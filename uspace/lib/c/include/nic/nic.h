@@ -75,6 +75,13 @@
 #define NIC_DEFECTIVE_BAD_TCP_CHECKSUM   0x0080
 #define NIC_DEFECTIVE_BAD_UDP_CHECKSUM   0x0100
 
+/** Offload capabilities reported by nic_offload_probe() */
+#define NIC_OFFLOAD_TX_CSUM  0x0001
+#define NIC_OFFLOAD_RX_CSUM  0x0002
+#define NIC_OFFLOAD_TSO4     0x0004
+#define NIC_OFFLOAD_TSO6     0x0008
+#define NIC_OFFLOAD_LRO      0x0010
+
 /**
  * The bitmap uses single bit for each of the 2^12 = 4096 possible VLAN tags.
  * This means its size is 4096/8 = 512 bytes.
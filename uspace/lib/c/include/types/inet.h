@@ -42,6 +42,32 @@
 
 #define INET_TTL_MAX 255
 
+/** Transport checksum is to be completed over csum_start..end (transmit) */
+#define INET_OFFLOAD_CSUM	0x01
+/** Transport checksum has been verified by the link (receive) */
+#define INET_OFFLOAD_CSUM_VALID	0x02
+/** TCP segment may be split into segments of gso_size bytes (transmit) */
+#define INET_OFFLOAD_TSO	0x04
+
+/** Work on a packet left to or already done by a lower layer
+ *
+ * With INET_OFFLOAD_CSUM, the checksum field holds the one's complement sum
+ * of the pseudo-header and the layer which can complete the checksum (the
+ * NIC or, as a fallback, inetsrv) does so. csum_start is relative to the
+ * data at the current layer, i.e. zero for the transport protocol and the
+ * length of the headers added below.
+ */
+typedef struct {
+	/** INET_OFFLOAD_* flags */
+	uint16_t flags;
+	/** Offset of the transport header */
+	uint16_t csum_start;
+	/** Offset of the checksum field from csum_start */
+	uint16_t csum_offset;
+	/** Payload size of the segments with INET_OFFLOAD_TSO */
+	uint16_t gso_size;
+} inet_offload_t;
+
 typedef struct {
 	/** Local IP link service ID (optional) */
 	service_id_t iplink;
@@ -50,6 +76,8 @@ typedef struct {
 	uint8_t tos;
 	void *data;
 	size_t size;
+	/** Offloaded work */
+	inet_offload_t offload;
 } inet_dgram_t;
 
 typedef struct {
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libc
+ * @{
+ */
+/** @file
+ */
+
+#ifndef _LIBC_TYPES_INET_DNSR_H_
+#define _LIBC_TYPES_INET_DNSR_H_
+
+#include <stdint.h>
+
+/** Resolver statistics */
+typedef struct {
+	/** Number of queries (one per address family looked up) */
+	uint64_t queries;
+	/** Queries answered from cache with an address */
+	uint64_t hits;
+	/** Queries answered with a cached negative answer */
+	uint64_t neg_hits;
+	/** Queries answered with expired data as the server failed */
+	uint64_t stale;
+	/** Queries which joined an identical query already in progress */
+	uint64_t coalesced;
+	/** Queries sent to the server */
+	uint64_t misses;
+	/** Total time spent on queries answered from cache (usec) */
+	uint64_t hit_usec;
+	/** Total time spent on other queries (usec) */
+	uint64_t miss_usec;
+	/** Number of cached answers */
+	uint64_t entries;
+	/** Maximum number of cached answers */
+	uint64_t max_entries;
+} dnsr_stats_t;
+
+#endif
+
+/** @}
+ */
@@ -64,6 +64,32 @@ typedef struct {
 	service_id_t service;
 } vfs_stat_t;
 
+/** Flags for vfs_readdir(). */
+enum {
+	/** Return the attributes of each entry along with its name. */
+	VFS_READDIR_STAT = 1
+};
+
+/** Directory entry record returned by vfs_readdir().
+ *
+ * Records are packed one after another in the buffer, each starting at
+ * an offset aligned to VFS_DIRENT_ALIGN.
+ */
+typedef struct {
+	/** Directory position following this entry. */
+	aoff64_t next_pos;
+	/** Size of the whole record including the name and padding. */
+	uint32_t reclen;
+	/** Whether all fields of @c stat are valid, not just the index. */
+	bool has_stat;
+	/** Attributes of the entry. */
+	vfs_stat_t stat;
+	/** Null-terminated name of the entry. */
+	char name[];
+} vfs_dirent_t;
+
+#define VFS_DIRENT_ALIGN	8
+
 typedef struct {
 	char fs_name[FS_NAME_MAXLEN + 1];
 	uint32_t f_bsize;    /* fundamental file system block size */
@@ -102,6 +128,8 @@ extern errno_t vfs_pass_handle(async_exch_t *, int, async_exch_t *);
 extern errno_t vfs_put(int);
 extern errno_t vfs_read(int, aoff64_t *, void *, size_t, size_t *);
 extern errno_t vfs_read_short(int, aoff64_t, void *, size_t, ssize_t *);
+extern errno_t vfs_readdir(int, aoff64_t *, unsigned, void *, size_t,
+    size_t *);
 extern errno_t vfs_receive_handle(bool, int *);
 extern errno_t vfs_rename_path(const char *, const char *);
 extern errno_t vfs_resize(int, aoff64_t);
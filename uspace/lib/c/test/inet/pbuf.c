@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <inet/pbuf.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(pbuf);
+
+enum {
+	pool_count = 4,
+	pool_size = 128
+};
+
+/** Allocating packets, adjusting headers and data access */
+PCUT_TEST(alloc_push_pull)
+{
+	pbuf_pool_t *pool;
+	pbuf_t pbuf;
+	uint8_t *data;
+	errno_t rc;
+
+	rc = pbuf_pool_create(pool_count, pool_size, &pool);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	/* Packet does not fit in a buffer */
+	rc = pbuf_alloc(pool, 64, pool_size - 63, &pbuf);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+
+	rc = pbuf_alloc(pool, 16, 100, &pbuf);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(100, pbuf.len);
+
+	data = pbuf_data(&pbuf);
+	data[0] = 42;
+
+	/* Prepend header */
+	rc = pbuf_push(&pbuf, 16);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(116, pbuf.len);
+	PCUT_ASSERT_TRUE((uint8_t *) pbuf_data(&pbuf) + 16 == data);
+
+	/* No more headroom */
+	rc = pbuf_push(&pbuf, 1);
+	PCUT_ASSERT_ERRNO_VAL(ELIMIT, rc);
+
+	/* Strip header */
+	rc = pbuf_pull(&pbuf, 16);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(42, *(uint8_t *) pbuf_data(&pbuf));
+
+	rc = pbuf_pull(&pbuf, 101);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+
+	/* Trim trailing data */
+	rc = pbuf_trim(&pbuf, 101);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+	rc = pbuf_trim(&pbuf, 50);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(50, pbuf.len);
+
+	pbuf_release(&pbuf);
+	pbuf_pool_destroy(pool);
+}
+
+/** Buffers are reused only after all references are released */
+PCUT_TEST(exhaust_release)
+{
+	pbuf_pool_t *pool;
+	pbuf_t pbuf[pool_count];
+	pbuf_t extra;
+	pbuf_t copy;
+	int i;
+	errno_t rc;
+
+	rc = pbuf_pool_create(pool_count, pool_size, &pool);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	for (i = 0; i < pool_count; i++) {
+		rc = pbuf_alloc(pool, 0, pool_size, &pbuf[i]);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	}
+
+	rc = pbuf_alloc(pool, 0, 1, &extra);
+	PCUT_ASSERT_ERRNO_VAL(ENOMEM, rc);
+
+	/* Second reference, as held by a client */
+	rc = pbuf_get(pool, pbuf[1].idx, 0, pool_size, &copy);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	pbuf_ref(&copy);
+
+	pbuf_release(&pbuf[1]);
+	rc = pbuf_alloc(pool, 0, 1, &extra);
+	PCUT_ASSERT_ERRNO_VAL(ENOMEM, rc);
+
+	pbuf_release(&copy);
+	rc = pbuf_alloc(pool, 0, 1, &extra);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(pbuf[1].idx, extra.idx);
+
+	/* Descriptor out of range */
+	rc = pbuf_get(pool, pool_count, 0, 1, &copy);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+	rc = pbuf_get(pool, 0, pool_size - 1, 2, &copy);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+
+	pbuf_pool_destroy(pool);
+}
+
+PCUT_EXPORT(pbuf);
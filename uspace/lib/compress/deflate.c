@@ -0,0 +1,1251 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ * @brief Implementation of deflate compression
+ *
+ * An incremental deflate compressor (producing `deflate' streams as
+ * described by RFC 1951).
+ *
+ * Matches are found using hash chains over three-byte prefixes in a
+ * 32 KiB sliding window. Lower compression levels use greedy matching
+ * with short chains, higher levels use lazy matching (a match is only
+ * taken if the next position does not yield a longer one) and longer
+ * chains. For each block the encoder picks the smallest of a stored
+ * block, a block using the fixed Huffman codes and a block using
+ * dynamic Huffman codes built from the symbol frequencies.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <mem.h>
+#include <stdlib.h>
+#include "deflate.h"
+
+/** Size of the sliding window */
+#define WINDOW_SIZE  32768
+/** Window index mask */
+#define WINDOW_MASK  (WINDOW_SIZE - 1)
+
+/** Minimal match length */
+#define MIN_MATCH  3
+/** Maximal match length */
+#define MAX_MATCH  258
+
+/** Minimal lookahead required to find the longest possible match */
+#define MIN_LOOKAHEAD  (MAX_MATCH + MIN_MATCH + 1)
+/** Maximal match distance (keeps matches inside the window when sliding) */
+#define MAX_DISTANCE   (WINDOW_SIZE - MIN_LOOKAHEAD)
+/** Matches of minimal length further than this are not worth it */
+#define TOO_FAR        4096
+
+/** Number of bits of the hash of a match prefix */
+#define HASH_BITS  15
+/** Number of hash chain heads */
+#define HASH_SIZE  (1 << HASH_BITS)
+/** Hash index mask */
+#define HASH_MASK  (HASH_SIZE - 1)
+
+/** Maximal number of symbols per block */
+#define SYMBOL_BUFFER_SIZE  16384
+/** Maximal amount of input per block (excluding the last match) */
+#define BLOCK_INPUT_SIZE    WINDOW_SIZE
+/** Size of the pending output buffer (holds a single encoded block) */
+#define PENDING_SIZE        (BLOCK_INPUT_SIZE + MAX_MATCH + 64)
+
+/** Maximum bits in the Huffman code */
+#define MAX_HUFFMAN_BIT  15
+/** Maximum bits in the code length code */
+#define MAX_ORDER_BIT    7
+
+/** Number of length codes */
+#define MAX_LEN           29
+/** Number of distance codes */
+#define MAX_DIST          30
+/** Number of order codes */
+#define MAX_ORDER         19
+/** Number of literal/length codes */
+#define MAX_LITLEN        286
+/** Number of fixed literal/length codes */
+#define MAX_FIXED_LITLEN  288
+
+/** Number of all codes */
+#define MAX_CODE  (MAX_LITLEN + MAX_DIST)
+
+/** End of block symbol */
+#define END_OF_BLOCK  256
+
+/** Code length repeat symbols */
+#define REPEAT_PREV    16
+#define REPEAT_ZERO    17
+#define REPEAT_ZERO_L  18
+
+/** Compression level parameters */
+typedef struct {
+	/** Reduce chain length once a match of this length is found */
+	uint16_t good_length;
+	/** Lazy matching: do not look for a better match above this length,
+	 *  greedy matching: do not index strings inside longer matches */
+	uint16_t max_lazy;
+	/** Stop searching once a match of this length is found */
+	uint16_t nice_length;
+	/** Maximal number of hash chain entries to examine */
+	uint16_t max_chain;
+	/** Use lazy matching */
+	bool lazy;
+} deflate_config_t;
+
+/** Compression level parameters indexed by level
+ *
+ */
+static const deflate_config_t configs[DEFLATE_LEVEL_MAX + 1] = {
+	{ 0, 0, 0, 0, false },
+	{ 4, 4, 8, 4, false },
+	{ 4, 5, 16, 8, false },
+	{ 4, 6, 32, 32, false },
+	{ 4, 4, 16, 16, true },
+	{ 8, 16, 32, 32, true },
+	{ 8, 16, 128, 128, true },
+	{ 8, 32, 128, 256, true },
+	{ 32, 128, 258, 1024, true },
+	{ 32, 258, 258, 4096, true }
+};
+
+/** Deflate algorithm state
+ *
+ */
+struct deflate_state {
+	const deflate_config_t *config;  /**< Compression level parameters */
+	bool finished;        /**< Final block has been encoded */
+
+	uint8_t window[2 * WINDOW_SIZE];  /**< Sliding window */
+	size_t strstart;      /**< Current position in the window */
+	size_t lookahead;     /**< Number of valid bytes from strstart */
+	size_t block_start;   /**< Window position of the current block */
+	size_t block_end;     /**< Window position after the last symbol */
+
+	uint16_t head[HASH_SIZE];   /**< Hash chain heads */
+	uint16_t prev[WINDOW_SIZE]; /**< Hash chain links */
+
+	size_t match_length;  /**< Length of the current match */
+	size_t match_start;   /**< Window position of the current match */
+	size_t prev_length;   /**< Length of the match at the previous position */
+	size_t prev_match;    /**< Window position of the previous match */
+	bool match_available; /**< Previous position is yet to be encoded */
+
+	uint8_t sym_lit[SYMBOL_BUFFER_SIZE];    /**< Literals or lengths - 3 */
+	uint16_t sym_dist[SYMBOL_BUFFER_SIZE];  /**< Distances (0 for literals) */
+	size_t sym_count;     /**< Number of buffered symbols */
+
+	uint32_t lit_freq[MAX_LITLEN];  /**< Literal/length frequencies */
+	uint32_t dist_freq[MAX_DIST];   /**< Distance frequencies */
+
+	uint8_t lit_len[MAX_FIXED_LITLEN];  /**< Literal/length code lengths */
+	uint16_t lit_code[MAX_FIXED_LITLEN]; /**< Literal/length codes */
+	uint8_t dist_len[MAX_DIST];         /**< Distance code lengths */
+	uint16_t dist_code[MAX_DIST];       /**< Distance codes */
+
+	uint8_t fixed_lit_len[MAX_FIXED_LITLEN];   /**< Fixed code lengths */
+	uint16_t fixed_lit_code[MAX_FIXED_LITLEN]; /**< Fixed codes */
+	uint8_t fixed_dist_len[MAX_DIST];          /**< Fixed code lengths */
+	uint16_t fixed_dist_code[MAX_DIST];        /**< Fixed codes */
+
+	uint8_t length_symbol[MAX_MATCH - MIN_MATCH + 1];  /**< Length codes */
+	uint8_t dist_symbol[512];  /**< Distance codes */
+
+	uint32_t hold;        /**< Bit buffer */
+	unsigned bits;        /**< Number of bits in the bit buffer */
+
+	uint8_t pending[PENDING_SIZE];  /**< Encoded data not yet output */
+	size_t pending_start; /**< First pending byte */
+	size_t pending_end;   /**< End of pending data */
+};
+
+/** Length codes
+ *
+ */
+static const uint16_t lens[MAX_LEN] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+/** Extended length codes
+ *
+ */
+static const uint16_t lens_ext[MAX_LEN] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+/** Distance codes
+ *
+ */
+static const uint16_t dists[MAX_DIST] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+
+/** Extended distance codes
+ *
+ */
+static const uint16_t dists_ext[MAX_DIST] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+	12, 12, 13, 13
+};
+
+/** Order codes
+ *
+ */
+static const short order[MAX_ORDER] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/** Reverse bits of a Huffman code
+ *
+ * Huffman codes are stored starting with the most significant bit,
+ * whereas all other values are stored starting with the least
+ * significant bit.
+ *
+ * @param code Code to reverse.
+ * @param len  Number of bits in the code.
+ *
+ * @return Reversed code.
+ *
+ */
+static inline unsigned reverse_bits(unsigned code, unsigned len)
+{
+	unsigned rev = 0;
+
+	while (len > 0) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+		len--;
+	}
+
+	return rev;
+}
+
+/** Compute length-limited Huffman code lengths
+ *
+ * The code is built by the two-queue method from symbols sorted
+ * by frequency. If the resulting code exceeds the length limit, the
+ * frequencies are flattened and the code is rebuilt.
+ *
+ * At least two symbols are always assigned a code so that the
+ * resulting code is complete.
+ *
+ * @param freq   Symbol frequencies.
+ * @param n      Number of symbols.
+ * @param limit  Maximal code length.
+ * @param length Output code lengths (zero for unused symbols).
+ *
+ */
+static void huffman_lengths(const uint32_t *freq, size_t n, unsigned limit,
+    uint8_t *length)
+{
+	uint32_t weight[2 * MAX_LITLEN];
+	uint16_t parent[2 * MAX_LITLEN];
+	uint8_t depth[2 * MAX_LITLEN];
+	uint16_t symbol[MAX_LITLEN];
+	uint32_t scaled[MAX_LITLEN];
+	size_t cnt = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		scaled[i] = freq[i];
+		length[i] = 0;
+		if (freq[i] > 0)
+			cnt++;
+	}
+
+	/* Make sure there are at least two codes */
+	for (size_t i = 0; (cnt < 2) && (i < n); i++) {
+		if (scaled[i] == 0) {
+			scaled[i] = 1;
+			cnt++;
+		}
+	}
+
+	while (true) {
+		/* Sort used symbols by frequency (insertion sort) */
+		cnt = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (scaled[i] == 0)
+				continue;
+
+			size_t j = cnt;
+			while ((j > 0) && (scaled[symbol[j - 1]] > scaled[i])) {
+				symbol[j] = symbol[j - 1];
+				j--;
+			}
+
+			symbol[j] = i;
+			cnt++;
+		}
+
+		for (size_t i = 0; i < cnt; i++)
+			weight[i] = scaled[symbol[i]];
+
+		/*
+		 * Leaves are taken from the sorted list, internal nodes
+		 * are created in non-decreasing order of weight, so the
+		 * two lightest nodes are always at the heads of the two
+		 * queues.
+		 */
+		size_t leaf = 0;
+		size_t node = cnt;
+		size_t next = cnt;
+
+		while (next < 2 * cnt - 1) {
+			size_t pick[2];
+
+			for (unsigned k = 0; k < 2; k++) {
+				if ((leaf < cnt) &&
+				    ((node >= next) || (weight[leaf] <= weight[node])))
+					pick[k] = leaf++;
+				else
+					pick[k] = node++;
+			}
+
+			weight[next] = weight[pick[0]] + weight[pick[1]];
+			parent[pick[0]] = next;
+			parent[pick[1]] = next;
+			next++;
+		}
+
+		/* Parents are always created after their children */
+		unsigned max_depth = 0;
+		depth[2 * cnt - 2] = 0;
+		for (size_t i = 2 * cnt - 2; i > 0; i--) {
+			depth[i - 1] = depth[parent[i - 1]] + 1;
+			if (depth[i - 1] > max_depth)
+				max_depth = depth[i - 1];
+		}
+
+		if (max_depth <= limit) {
+			for (size_t i = 0; i < cnt; i++)
+				length[symbol[i]] = depth[i];
+
+			return;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			if (scaled[i] > 0)
+				scaled[i] = (scaled[i] >> 1) | 1;
+		}
+	}
+}
+
+/** Assign canonical Huffman codes
+ *
+ * The codes are stored bit-reversed so that they can be output
+ * directly into the least significant bit first bit stream.
+ *
+ * @param length Code lengths.
+ * @param n      Number of symbols.
+ * @param code   Output codes.
+ *
+ */
+static void huffman_codes(const uint8_t *length, size_t n, uint16_t *code)
+{
+	uint16_t count[MAX_HUFFMAN_BIT + 1];
+	uint16_t next[MAX_HUFFMAN_BIT + 1];
+
+	memset(count, 0, sizeof(count));
+	for (size_t i = 0; i < n; i++)
+		count[length[i]]++;
+
+	count[0] = 0;
+	next[0] = 0;
+	for (unsigned len = 1; len <= MAX_HUFFMAN_BIT; len++)
+		next[len] = (next[len - 1] + count[len - 1]) << 1;
+
+	for (size_t i = 0; i < n; i++) {
+		if (length[i] != 0)
+			code[i] = reverse_bits(next[length[i]]++, length[i]);
+	}
+}
+
+/** Append bits to the output
+ *
+ * @param state Deflate state.
+ * @param value Value to output (least significant bit first).
+ * @param cnt   Number of bits (at most 16).
+ *
+ */
+static inline void put_bits(struct deflate_state *state, uint32_t value,
+    unsigned cnt)
+{
+	state->hold |= value << state->bits;
+	state->bits += cnt;
+
+	while (state->bits >= 8) {
+		state->pending[state->pending_end++] = state->hold & 0xff;
+		state->hold >>= 8;
+		state->bits -= 8;
+	}
+}
+
+/** Pad the output to a byte boundary
+ *
+ * @param state Deflate state.
+ *
+ */
+static void put_align(struct deflate_state *state)
+{
+	if (state->bits > 0) {
+		state->pending[state->pending_end++] = state->hold & 0xff;
+		state->hold = 0;
+		state->bits = 0;
+	}
+}
+
+/** Get distance code of a distance
+ *
+ * @param state Deflate state.
+ * @param dist  Match distance.
+ *
+ * @return Distance code.
+ *
+ */
+static inline unsigned dist_symbol(struct deflate_state *state, size_t dist)
+{
+	dist--;
+	if (dist < 256)
+		return state->dist_symbol[dist];
+
+	return state->dist_symbol[256 + (dist >> 7)];
+}
+
+/** Prepare the fixed codes and the symbol lookup tables
+ *
+ * @param state Deflate state.
+ *
+ */
+static void deflate_tables(struct deflate_state *state)
+{
+	size_t sym;
+
+	for (sym = 0; sym < 144; sym++)
+		state->fixed_lit_len[sym] = 8;
+
+	for (; sym < 256; sym++)
+		state->fixed_lit_len[sym] = 9;
+
+	for (; sym < 280; sym++)
+		state->fixed_lit_len[sym] = 7;
+
+	for (; sym < MAX_FIXED_LITLEN; sym++)
+		state->fixed_lit_len[sym] = 8;
+
+	for (sym = 0; sym < MAX_DIST; sym++)
+		state->fixed_dist_len[sym] = 5;
+
+	huffman_codes(state->fixed_lit_len, MAX_FIXED_LITLEN,
+	    state->fixed_lit_code);
+	huffman_codes(state->fixed_dist_len, MAX_DIST, state->fixed_dist_code);
+
+	for (sym = 0; sym < MAX_LEN; sym++) {
+		size_t end = (sym + 1 < MAX_LEN) ? lens[sym + 1] : MAX_MATCH + 1;
+
+		/* Length 258 has its own code */
+		if (sym == MAX_LEN - 2)
+			end = MAX_MATCH;
+
+		for (size_t len = lens[sym]; len < end; len++)
+			state->length_symbol[len - MIN_MATCH] = sym;
+	}
+
+	for (sym = 0; sym < MAX_DIST; sym++) {
+		size_t end = (sym + 1 < MAX_DIST) ? dists[sym + 1] :
+		    WINDOW_SIZE + 1;
+
+		for (size_t dist = dists[sym]; dist < end; dist++) {
+			if (dist <= 256)
+				state->dist_symbol[dist - 1] = sym;
+			else
+				state->dist_symbol[256 + ((dist - 1) >> 7)] = sym;
+		}
+	}
+}
+
+/** Insert a string into the hash chains
+ *
+ * @param state Deflate state.
+ * @param pos   Window position of the string (at least three bytes
+ *              have to be available).
+ *
+ * @return Previous head of the hash chain (0 if empty).
+ *
+ */
+static inline size_t insert_string(struct deflate_state *state, size_t pos)
+{
+	const uint8_t *str = state->window + pos;
+	unsigned hash = ((str[0] << 10) ^ (str[1] << 5) ^ str[2]) & HASH_MASK;
+	size_t head = state->head[hash];
+
+	state->prev[pos & WINDOW_MASK] = head;
+	state->head[hash] = pos;
+	return head;
+}
+
+/** Find the longest match
+ *
+ * Walks the hash chain starting at cur_match looking for a match
+ * longer than state->prev_length.
+ *
+ * @param state     Deflate state.
+ * @param cur_match Head of the hash chain.
+ *
+ * @return Length of the longest match found (the match position is
+ *         stored in state->match_start if it is longer than
+ *         state->prev_length).
+ *
+ */
+static size_t longest_match(struct deflate_state *state, size_t cur_match)
+{
+	const deflate_config_t *config = state->config;
+	const uint8_t *scan = state->window + state->strstart;
+	unsigned chain = config->max_chain;
+	size_t best_len = state->prev_length;
+	size_t max_len = MAX_MATCH;
+	size_t nice_len = config->nice_length;
+
+	if (max_len > state->lookahead)
+		max_len = state->lookahead;
+
+	if (nice_len > max_len)
+		nice_len = max_len;
+
+	if (best_len >= max_len)
+		return best_len;
+
+	if (best_len >= config->good_length)
+		chain >>= 2;
+
+	const size_t limit = (state->strstart > MAX_DISTANCE) ?
+	    state->strstart - MAX_DISTANCE : 0;
+
+	do {
+		const uint8_t *match = state->window + cur_match;
+
+		if ((match[best_len] != scan[best_len]) ||
+		    (match[0] != scan[0]) || (match[1] != scan[1]))
+			continue;
+
+		size_t len = 2;
+		while ((len < max_len) && (match[len] == scan[len]))
+			len++;
+
+		if (len > best_len) {
+			state->match_start = cur_match;
+			best_len = len;
+			if (len >= nice_len)
+				break;
+		}
+	} while (((cur_match = state->prev[cur_match & WINDOW_MASK]) > limit) &&
+	    (--chain != 0));
+
+	return best_len;
+}
+
+/** Record a literal
+ *
+ * @param state Deflate state.
+ * @param lit   Literal byte.
+ *
+ * @return True if the block is full.
+ *
+ */
+static inline bool tally_literal(struct deflate_state *state, uint8_t lit)
+{
+	state->sym_lit[state->sym_count] = lit;
+	state->sym_dist[state->sym_count] = 0;
+	state->sym_count++;
+	state->lit_freq[lit]++;
+	state->block_end++;
+
+	return (state->sym_count == SYMBOL_BUFFER_SIZE) ||
+	    (state->block_end - state->block_start >= BLOCK_INPUT_SIZE);
+}
+
+/** Record a match
+ *
+ * @param state Deflate state.
+ * @param dist  Match distance.
+ * @param len   Match length.
+ *
+ * @return True if the block is full.
+ *
+ */
+static inline bool tally_match(struct deflate_state *state, size_t dist,
+    size_t len)
+{
+	state->sym_lit[state->sym_count] = len - MIN_MATCH;
+	state->sym_dist[state->sym_count] = dist;
+	state->sym_count++;
+	state->lit_freq[END_OF_BLOCK + 1 +
+	    state->length_symbol[len - MIN_MATCH]]++;
+	state->dist_freq[dist_symbol(state, dist)]++;
+	state->block_end += len;
+
+	return (state->sym_count == SYMBOL_BUFFER_SIZE) ||
+	    (state->block_end - state->block_start >= BLOCK_INPUT_SIZE);
+}
+
+/** Compute the size of the block symbols using given codes
+ *
+ * @param state    Deflate state.
+ * @param lit_len  Literal/length code lengths.
+ * @param dist_len Distance code lengths.
+ *
+ * @return Size in bits.
+ *
+ */
+static size_t block_bits(struct deflate_state *state, const uint8_t *lit_len,
+    const uint8_t *dist_len)
+{
+	size_t bits = 0;
+
+	for (size_t sym = 0; sym < MAX_LITLEN; sym++) {
+		bits += (size_t) state->lit_freq[sym] * lit_len[sym];
+		if (sym > END_OF_BLOCK) {
+			bits += (size_t) state->lit_freq[sym] *
+			    lens_ext[sym - END_OF_BLOCK - 1];
+		}
+	}
+
+	for (size_t sym = 0; sym < MAX_DIST; sym++) {
+		bits += (size_t) state->dist_freq[sym] *
+		    (dist_len[sym] + dists_ext[sym]);
+	}
+
+	return bits;
+}
+
+/** Output the block symbols
+ *
+ * @param state     Deflate state.
+ * @param lit_len   Literal/length code lengths.
+ * @param lit_code  Literal/length codes.
+ * @param dist_len  Distance code lengths.
+ * @param dist_code Distance codes.
+ *
+ */
+static void compress_block(struct deflate_state *state,
+    const uint8_t *lit_len, const uint16_t *lit_code,
+    const uint8_t *dist_len, const uint16_t *dist_code)
+{
+	for (size_t i = 0; i < state->sym_count; i++) {
+		const size_t dist = state->sym_dist[i];
+
+		if (dist == 0) {
+			const uint8_t lit = state->sym_lit[i];
+			put_bits(state, lit_code[lit], lit_len[lit]);
+			continue;
+		}
+
+		const size_t len = state->sym_lit[i] + MIN_MATCH;
+		const unsigned lsym = state->length_symbol[len - MIN_MATCH];
+		const unsigned code = END_OF_BLOCK + 1 + lsym;
+
+		put_bits(state, lit_code[code], lit_len[code]);
+		if (lens_ext[lsym] > 0)
+			put_bits(state, len - lens[lsym], lens_ext[lsym]);
+
+		const unsigned dsym = dist_symbol(state, dist);
+
+		put_bits(state, dist_code[dsym], dist_len[dsym]);
+		if (dists_ext[dsym] > 0)
+			put_bits(state, dist - dists[dsym], dists_ext[dsym]);
+	}
+
+	put_bits(state, lit_code[END_OF_BLOCK], lit_len[END_OF_BLOCK]);
+}
+
+/** Encode the current block
+ *
+ * The block type yielding the smallest output is selected.
+ *
+ * @param state Deflate state.
+ * @param last  Final block of the stream.
+ *
+ */
+static void deflate_emit_block(struct deflate_state *state, bool last)
+{
+	uint8_t lengths[MAX_CODE];
+	uint8_t rle_sym[MAX_CODE];
+	uint8_t rle_extra[MAX_CODE];
+	uint32_t order_freq[MAX_ORDER];
+	uint8_t order_len[MAX_ORDER];
+	uint16_t order_code[MAX_ORDER];
+	size_t nrle = 0;
+
+	state->lit_freq[END_OF_BLOCK] = 1;
+
+	/* Dynamic codes */
+	huffman_lengths(state->lit_freq, MAX_LITLEN, MAX_HUFFMAN_BIT,
+	    state->lit_len);
+	huffman_lengths(state->dist_freq, MAX_DIST, MAX_HUFFMAN_BIT,
+	    state->dist_len);
+
+	size_t nlen = MAX_LITLEN;
+	while ((nlen > END_OF_BLOCK + 1) && (state->lit_len[nlen - 1] == 0))
+		nlen--;
+
+	size_t ndist = MAX_DIST;
+	while ((ndist > 1) && (state->dist_len[ndist - 1] == 0))
+		ndist--;
+
+	memcpy(lengths, state->lit_len, nlen);
+	memcpy(lengths + nlen, state->dist_len, ndist);
+
+	/* Run-length encode the code lengths */
+	memset(order_freq, 0, sizeof(order_freq));
+	for (size_t i = 0; i < nlen + ndist;) {
+		const uint8_t cur = lengths[i];
+		size_t run = 1;
+
+		while ((i + run < nlen + ndist) && (lengths[i + run] == cur))
+			run++;
+
+		i += run;
+
+		if (cur == 0) {
+			while (run >= 11) {
+				size_t rep = (run > 138) ? 138 : run;
+				rle_sym[nrle] = REPEAT_ZERO_L;
+				rle_extra[nrle++] = rep - 11;
+				run -= rep;
+			}
+
+			if (run >= 3) {
+				rle_sym[nrle] = REPEAT_ZERO;
+				rle_extra[nrle++] = run - 3;
+				run = 0;
+			}
+		} else {
+			rle_sym[nrle] = cur;
+			rle_extra[nrle++] = 0;
+			run--;
+
+			while (run >= 3) {
+				size_t rep = (run > 6) ? 6 : run;
+				rle_sym[nrle] = REPEAT_PREV;
+				rle_extra[nrle++] = rep - 3;
+				run -= rep;
+			}
+		}
+
+		while (run > 0) {
+			rle_sym[nrle] = cur;
+			rle_extra[nrle++] = 0;
+			run--;
+		}
+	}
+
+	for (size_t i = 0; i < nrle; i++)
+		order_freq[rle_sym[i]]++;
+
+	huffman_lengths(order_freq, MAX_ORDER, MAX_ORDER_BIT, order_len);
+	huffman_codes(order_len, MAX_ORDER, order_code);
+
+	size_t ncode = MAX_ORDER;
+	while ((ncode > 4) && (order_len[order[ncode - 1]] == 0))
+		ncode--;
+
+	size_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * ncode +
+	    block_bits(state, state->lit_len, state->dist_len);
+	for (size_t sym = 0; sym < MAX_ORDER; sym++)
+		dynamic_bits += (size_t) order_freq[sym] * order_len[sym];
+
+	dynamic_bits += 2 * order_freq[REPEAT_PREV] +
+	    3 * order_freq[REPEAT_ZERO] + 7 * order_freq[REPEAT_ZERO_L];
+
+	/* Fixed codes */
+	const size_t fixed_bits = 3 +
+	    block_bits(state, state->fixed_lit_len, state->fixed_dist_len);
+
+	/* Stored block (header, padding, length and its complement) */
+	const size_t stored_len = state->block_end - state->block_start;
+	const size_t stored_bits = 3 + ((8 - ((state->bits + 3) & 7)) & 7) +
+	    32 + 8 * stored_len;
+
+	if ((stored_bits <= fixed_bits) && (stored_bits <= dynamic_bits)) {
+		put_bits(state, last ? 1 : 0, 3);
+		put_align(state);
+		put_bits(state, stored_len, 16);
+		put_bits(state, (~stored_len) & 0xffff, 16);
+
+		memcpy(state->pending + state->pending_end,
+		    state->window + state->block_start, stored_len);
+		state->pending_end += stored_len;
+	} else if (fixed_bits <= dynamic_bits) {
+		put_bits(state, (last ? 1 : 0) | (1 << 1), 3);
+		compress_block(state, state->fixed_lit_len, state->fixed_lit_code,
+		    state->fixed_dist_len, state->fixed_dist_code);
+	} else {
+		huffman_codes(state->lit_len, MAX_LITLEN, state->lit_code);
+		huffman_codes(state->dist_len, MAX_DIST, state->dist_code);
+
+		put_bits(state, (last ? 1 : 0) | (2 << 1), 3);
+		put_bits(state, nlen - 257, 5);
+		put_bits(state, ndist - 1, 5);
+		put_bits(state, ncode - 4, 4);
+
+		for (size_t i = 0; i < ncode; i++)
+			put_bits(state, order_len[order[i]], 3);
+
+		for (size_t i = 0; i < nrle; i++) {
+			const uint8_t sym = rle_sym[i];
+
+			put_bits(state, order_code[sym], order_len[sym]);
+			if (sym == REPEAT_PREV)
+				put_bits(state, rle_extra[i], 2);
+			else if (sym == REPEAT_ZERO)
+				put_bits(state, rle_extra[i], 3);
+			else if (sym == REPEAT_ZERO_L)
+				put_bits(state, rle_extra[i], 7);
+		}
+
+		compress_block(state, state->lit_len, state->lit_code,
+		    state->dist_len, state->dist_code);
+	}
+
+	if (last)
+		put_align(state);
+
+	memset(state->lit_freq, 0, sizeof(state->lit_freq));
+	memset(state->dist_freq, 0, sizeof(state->dist_freq));
+	state->sym_count = 0;
+	state->block_start = state->block_end;
+}
+
+/** Move pending output to the output buffer
+ *
+ * @param stream Deflate stream.
+ *
+ */
+static void deflate_flush_pending(deflate_stream_t *stream)
+{
+	struct deflate_state *state = stream->state;
+	size_t cnt = state->pending_end - state->pending_start;
+
+	if (cnt > stream->avail_out)
+		cnt = stream->avail_out;
+
+	memcpy(stream->next_out, state->pending + state->pending_start, cnt);
+	stream->next_out += cnt;
+	stream->avail_out -= cnt;
+	stream->total_out += cnt;
+	state->pending_start += cnt;
+
+	if (state->pending_start == state->pending_end) {
+		state->pending_start = 0;
+		state->pending_end = 0;
+	}
+}
+
+/** Slide the window and fill it with input data
+ *
+ * @param stream Deflate stream.
+ *
+ * @return True if the window was filled.
+ * @return False if the current block had to be encoded first to keep
+ *         its data in the window.
+ *
+ */
+static bool deflate_fill(deflate_stream_t *stream)
+{
+	struct deflate_state *state = stream->state;
+
+	if (state->strstart >= 2 * WINDOW_SIZE - MIN_LOOKAHEAD) {
+		if (state->block_start < WINDOW_SIZE) {
+			deflate_emit_block(state, false);
+			return false;
+		}
+
+		memcpy(state->window, state->window + WINDOW_SIZE, WINDOW_SIZE);
+		state->strstart -= WINDOW_SIZE;
+		state->block_start -= WINDOW_SIZE;
+		state->block_end -= WINDOW_SIZE;
+		state->match_start = (state->match_start >= WINDOW_SIZE) ?
+		    state->match_start - WINDOW_SIZE : 0;
+
+		for (size_t i = 0; i < HASH_SIZE; i++) {
+			state->head[i] = (state->head[i] >= WINDOW_SIZE) ?
+			    state->head[i] - WINDOW_SIZE : 0;
+		}
+
+		for (size_t i = 0; i < WINDOW_SIZE; i++) {
+			state->prev[i] = (state->prev[i] >= WINDOW_SIZE) ?
+			    state->prev[i] - WINDOW_SIZE : 0;
+		}
+	}
+
+	size_t cnt = 2 * WINDOW_SIZE - state->strstart - state->lookahead;
+	if (cnt > stream->avail_in)
+		cnt = stream->avail_in;
+
+	if (cnt > 0) {
+		memcpy(state->window + state->strstart + state->lookahead,
+		    stream->next_in, cnt);
+		stream->next_in += cnt;
+		stream->avail_in -= cnt;
+		stream->total_in += cnt;
+		state->lookahead += cnt;
+	}
+
+	return true;
+}
+
+/** Compress the window data using greedy matching
+ *
+ * @param state  Deflate state.
+ * @param finish No more input data will follow.
+ *
+ * @return True if a block has been encoded.
+ *
+ */
+static bool deflate_fast(struct deflate_state *state, bool finish)
+{
+	while ((state->lookahead >= MIN_LOOKAHEAD) ||
+	    ((finish) && (state->lookahead > 0))) {
+		size_t hash_head = 0;
+		bool full;
+
+		if (state->lookahead >= MIN_MATCH)
+			hash_head = insert_string(state, state->strstart);
+
+		state->match_length = 0;
+		if ((hash_head != 0) &&
+		    (state->strstart - hash_head <= MAX_DISTANCE)) {
+			state->prev_length = MIN_MATCH - 1;
+			state->match_length = longest_match(state, hash_head);
+		}
+
+		if (state->match_length >= MIN_MATCH) {
+			full = tally_match(state,
+			    state->strstart - state->match_start,
+			    state->match_length);
+			state->lookahead -= state->match_length;
+
+			if ((state->match_length <= state->config->max_lazy) &&
+			    (state->lookahead >= MIN_MATCH)) {
+				/* Index the strings inside the match */
+				state->match_length--;
+				do {
+					state->strstart++;
+					insert_string(state, state->strstart);
+				} while (--state->match_length != 0);
+
+				state->strstart++;
+			} else {
+				state->strstart += state->match_length;
+				state->match_length = 0;
+			}
+		} else {
+			full = tally_literal(state,
+			    state->window[state->strstart]);
+			state->strstart++;
+			state->lookahead--;
+		}
+
+		if (full) {
+			deflate_emit_block(state, false);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/** Compress the window data using lazy matching
+ *
+ * A match found at a position is only used if the match found at the
+ * following position is not longer. Otherwise a literal is output
+ * and the following match is considered instead.
+ *
+ * @param state  Deflate state.
+ * @param finish No more input data will follow.
+ *
+ * @return True if a block has been encoded.
+ *
+ */
+static bool deflate_slow(struct deflate_state *state, bool finish)
+{
+	while ((state->lookahead >= MIN_LOOKAHEAD) ||
+	    ((finish) && (state->lookahead > 0))) {
+		size_t hash_head = 0;
+
+		if (state->lookahead >= MIN_MATCH)
+			hash_head = insert_string(state, state->strstart);
+
+		state->prev_length = state->match_length;
+		state->prev_match = state->match_start;
+		state->match_length = MIN_MATCH - 1;
+
+		if ((hash_head != 0) &&
+		    (state->prev_length < state->config->max_lazy) &&
+		    (state->strstart - hash_head <= MAX_DISTANCE)) {
+			state->match_length = longest_match(state, hash_head);
+
+			if ((state->match_length == MIN_MATCH) &&
+			    (state->strstart - state->match_start > TOO_FAR))
+				state->match_length = MIN_MATCH - 1;
+		}
+
+		if ((state->prev_length >= MIN_MATCH) &&
+		    (state->match_length <= state->prev_length)) {
+			/* Use the match found at the previous position */
+			const size_t max_insert = state->strstart +
+			    state->lookahead - MIN_MATCH;
+
+			bool full = tally_match(state,
+			    state->strstart - 1 - state->prev_match,
+			    state->prev_length);
+
+			state->lookahead -= state->prev_length - 1;
+			state->prev_length -= 2;
+			do {
+				if (++state->strstart <= max_insert)
+					insert_string(state, state->strstart);
+			} while (--state->prev_length != 0);
+
+			state->match_available = false;
+			state->match_length = MIN_MATCH - 1;
+			state->strstart++;
+
+			if (full) {
+				deflate_emit_block(state, false);
+				return true;
+			}
+		} else if (state->match_available) {
+			/* No better match, output the previous position */
+			bool full = tally_literal(state,
+			    state->window[state->strstart - 1]);
+			state->strstart++;
+			state->lookahead--;
+
+			if (full) {
+				deflate_emit_block(state, false);
+				return true;
+			}
+		} else {
+			/* Defer the decision to the next position */
+			state->match_available = true;
+			state->strstart++;
+			state->lookahead--;
+		}
+	}
+
+	return false;
+}
+
+/** Initialize deflate stream
+ *
+ * @param stream Deflate stream.
+ * @param level  Compression level (DEFLATE_LEVEL_MIN to
+ *               DEFLATE_LEVEL_MAX).
+ *
+ * @return EOK on success.
+ * @return EINVAL on invalid compression level.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t deflate_init(deflate_stream_t *stream, int level)
+{
+	if ((level < DEFLATE_LEVEL_MIN) || (level > DEFLATE_LEVEL_MAX))
+		return EINVAL;
+
+	stream->state = malloc(sizeof(struct deflate_state));
+	if (stream->state == NULL)
+		return ENOMEM;
+
+	stream->state->config = &configs[level];
+	deflate_tables(stream->state);
+	deflate_reset(stream);
+	return EOK;
+}
+
+/** Reset deflate stream to encode a new deflate stream
+ *
+ * The input and output buffers and the compression level are left
+ * intact.
+ *
+ * @param stream Initialized deflate stream.
+ *
+ */
+void deflate_reset(deflate_stream_t *stream)
+{
+	struct deflate_state *state = stream->state;
+
+	stream->total_in = 0;
+	stream->total_out = 0;
+	stream->done = false;
+
+	state->finished = false;
+	state->strstart = 0;
+	state->lookahead = 0;
+	state->block_start = 0;
+	state->block_end = 0;
+	state->match_length = MIN_MATCH - 1;
+	state->match_start = 0;
+	state->prev_length = MIN_MATCH - 1;
+	state->prev_match = 0;
+	state->match_available = false;
+	state->sym_count = 0;
+	state->hold = 0;
+	state->bits = 0;
+	state->pending_start = 0;
+	state->pending_end = 0;
+
+	memset(state->head, 0, sizeof(state->head));
+	memset(state->lit_freq, 0, sizeof(state->lit_freq));
+	memset(state->dist_freq, 0, sizeof(state->dist_freq));
+}
+
+/** Compress as much data as possible
+ *
+ * Compression stops when the input is exhausted or the output buffer
+ * is full. Input data may be retained in the stream state until more
+ * input is available, unless finish is set. Once finish is set, the
+ * stream has to be stepped with finish set (and no new input) until
+ * stream->done is set.
+ *
+ * @param stream Deflate stream.
+ * @param finish All input data have been provided.
+ *
+ * @return EOK on success (including the need for more input or output).
+ *
+ */
+errno_t deflate_step(deflate_stream_t *stream, bool finish)
+{
+	struct deflate_state *state = stream->state;
+
+	while (true) {
+		deflate_flush_pending(stream);
+		if (state->pending_end > 0)
+			return EOK;
+
+		if (state->finished) {
+			stream->done = true;
+			return EOK;
+		}
+
+		if (!deflate_fill(stream))
+			continue;
+
+		if ((finish) && (state->lookahead == 0) &&
+		    (stream->avail_in == 0)) {
+			if (state->match_available) {
+				tally_literal(state,
+				    state->window[state->strstart - 1]);
+				state->match_available = false;
+			}
+
+			deflate_emit_block(state, true);
+			state->finished = true;
+			continue;
+		}
+
+		if ((!finish) && (state->lookahead < MIN_LOOKAHEAD))
+			return EOK;
+
+		if (state->config->lazy)
+			deflate_slow(state, finish);
+		else
+			deflate_fast(state, finish);
+	}
+}
+
+/** Release deflate stream resources
+ *
+ * @param stream Deflate stream.
+ *
+ */
+void deflate_end(deflate_stream_t *stream)
+{
+	free(stream->state);
+	stream->state = NULL;
+}
+
+/** Compute the maximal size of compressed data
+ *
+ * @param srclen Source data size (bytes).
+ *
+ * @return Maximal size of the compressed data (bytes).
+ *
+ */
+size_t deflate_bound(size_t srclen)
+{
+	/* Incompressible data is stored with 5 bytes of overhead per block */
+	return srclen + (srclen >> 10) + 32;
+}
+
+/** Deflate data
+ *
+ * @param[in]  src     Source data buffer.
+ * @param[in]  srclen  Source buffer size (bytes).
+ * @param[in]  dest    Destination data buffer.
+ * @param[in]  destlen Destination buffer size (bytes).
+ * @param[out] dsize   Size of the compressed data (bytes).
+ * @param[in]  level   Compression level.
+ *
+ * @return EOK on success.
+ * @return EINVAL on invalid compression level.
+ * @return ENOMEM on output buffer overrun or if out of memory.
+ *
+ */
+errno_t deflate(void *src, size_t srclen, void *dest, size_t destlen,
+    size_t *dsize, int level)
+{
+	deflate_stream_t stream;
+
+	errno_t ret = deflate_init(&stream, level);
+	if (ret != EOK)
+		return ret;
+
+	stream.next_in = (const uint8_t *) src;
+	stream.avail_in = srclen;
+	stream.next_out = (uint8_t *) dest;
+	stream.avail_out = destlen;
+
+	ret = deflate_step(&stream, true);
+	if ((ret == EOK) && (!stream.done))
+		ret = ENOMEM;
+
+	*dsize = stream.total_out;
+
+	deflate_end(&stream);
+	return ret;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIBCOMPRESS_DEFLATE_H_
+#define LIBCOMPRESS_DEFLATE_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Fastest compression level */
+#define DEFLATE_LEVEL_MIN      1
+/** Best compression level */
+#define DEFLATE_LEVEL_MAX      9
+/** Default compression level */
+#define DEFLATE_LEVEL_DEFAULT  6
+
+struct deflate_state;
+
+/** Incremental deflate stream
+ *
+ * The caller provides input and output space by setting next_in/avail_in
+ * and next_out/avail_out and calls deflate_step() repeatedly. Both
+ * pointers and counters are advanced by the amount of data consumed
+ * and produced.
+ *
+ */
+typedef struct {
+	const uint8_t *next_in;  /**< Next input byte */
+	size_t avail_in;         /**< Number of bytes available at next_in */
+	uint64_t total_in;       /**< Total number of input bytes consumed */
+
+	uint8_t *next_out;       /**< Next output byte */
+	size_t avail_out;        /**< Remaining free space at next_out */
+	uint64_t total_out;      /**< Total number of bytes output */
+
+	bool done;               /**< Final block has been output */
+
+	struct deflate_state *state;  /**< Internal state */
+} deflate_stream_t;
+
+extern errno_t deflate_init(deflate_stream_t *, int);
+extern errno_t deflate_step(deflate_stream_t *, bool);
+extern void deflate_reset(deflate_stream_t *);
+extern void deflate_end(deflate_stream_t *);
+
+extern size_t deflate_bound(size_t);
+extern errno_t deflate(void *, size_t, void *, size_t, size_t *, int);
+
+#endif
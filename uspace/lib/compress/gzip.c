@@ -32,8 +32,11 @@
 #include <mem.h>
 #include <byteorder.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <adt/checksum.h>
 #include "gzip.h"
 #include "inflate.h"
+#include "deflate.h"
 
 #define GZIP_ID1  UINT8_C(0x1f)
 #define GZIP_ID2  UINT8_C(0x8b)
@@ -46,6 +49,11 @@
 #define GZIP_FLAG_FNAME     UINT8_C(1 << 3)
 #define GZIP_FLAG_FCOMMENT  UINT8_C(1 << 4)
 
+#define GZIP_XFL_BEST     UINT8_C(2)
+#define GZIP_XFL_FASTEST  UINT8_C(4)
+
+#define GZIP_OS_UNKNOWN  UINT8_C(255)
+
 typedef struct {
 	uint8_t id1;
 	uint8_t id2;
@@ -61,6 +69,79 @@ typedef struct {
 	uint32_t size;
 } __attribute__((packed)) gzip_footer_t;
 
+/** Size of the streaming reader input buffer */
+#define GZIP_READER_BUFFER_SIZE  65536
+
+/** Streaming gzip reader */
+struct gzip_reader {
+	/** Input callback */
+	gzip_read_t read;
+	/** Input callback argument */
+	void *arg;
+
+	/** Input buffer */
+	uint8_t *buffer;
+	/** Inflate stream, reads from the input buffer */
+	inflate_stream_t stream;
+	/** No more input available from the callback */
+	bool eof;
+
+	/** Member header has to be parsed */
+	bool need_header;
+	/** All members have been read */
+	bool finished;
+	/** CRC32 of the data of the current member */
+	uint32_t crc;
+	/** Size of the data of the current member */
+	uint32_t size;
+};
+
+/** Size of the streaming writer output buffer */
+#define GZIP_WRITER_BUFFER_SIZE  65536
+
+/** Streaming gzip writer */
+struct gzip_writer {
+	/** Output callback */
+	gzip_write_t write;
+	/** Output callback argument */
+	void *arg;
+
+	/** Output buffer */
+	uint8_t *buffer;
+	/** Deflate stream, writes to the output buffer */
+	deflate_stream_t stream;
+
+	/** Member footer has been written */
+	bool finished;
+	/** CRC32 of the data written so far */
+	uint32_t crc;
+	/** Size of the data written so far */
+	uint32_t size;
+};
+
+/** Prepare member header
+ *
+ * @param header Header to fill in.
+ * @param level  Compression level.
+ *
+ */
+static void gzip_header_init(gzip_header_t *header, int level)
+{
+	header->id1 = GZIP_ID1;
+	header->id2 = GZIP_ID2;
+	header->method = GZIP_METHOD_DEFLATE;
+	header->flags = 0;
+	header->mtime = 0;
+	header->os = GZIP_OS_UNKNOWN;
+
+	if (level == DEFLATE_LEVEL_MAX)
+		header->extra_flags = GZIP_XFL_BEST;
+	else if (level == DEFLATE_LEVEL_MIN)
+		header->extra_flags = GZIP_XFL_FASTEST;
+	else
+		header->extra_flags = 0;
+}
+
 /** Expand GZIP compressed data
  *
  * The routine allocates the output buffer based
@@ -69,7 +150,7 @@ typedef struct {
  * data to 4 GiB (expanding input streams that actually
  * encode more data will always fail).
  *
- * So far, no CRC is perfomed.
+ * The CRC32 of the expanded data is verified.
  *
  * @param[in]  src     Source data buffer.
  * @param[in]  srclen  Source buffer size (bytes).
@@ -79,7 +160,8 @@ typedef struct {
  * @return EOK on success.
  * @return ENOENT on distance too large.
  * @return EINVAL on invalid Huffman code, invalid deflate data,
- *                   invalid compression method or invalid stream.
+ *                   invalid compression method, invalid stream or
+ *                   checksum mismatch.
  * @return ELIMIT on input buffer overrun.
  * @return ENOMEM on output buffer overrun.
  *
@@ -174,10 +256,556 @@ errno_t gzip_expand(void *src, size_t srclen, void **dest, size_t *destlen)
 		return ENOMEM;
 
 	errno_t ret = inflate(stream, stream_length, *dest, *destlen);
+	if ((ret == EOK) &&
+	    (compute_crc32(*dest, *destlen) != uint32_t_le2host(footer.crc32)))
+		ret = EINVAL;
+
 	if (ret != EOK) {
-		free(dest);
+		free(*dest);
+		*dest = NULL;
 		return ret;
 	}
 
 	return EOK;
 }
+
+/** Refill the input buffer of the reader
+ *
+ * @param reader Streaming gzip reader.
+ *
+ * @return EOK on success (also at the end of input).
+ * @return Error code of the input callback.
+ *
+ */
+static errno_t gzip_reader_fill(gzip_reader_t *reader)
+{
+	if ((reader->stream.avail_in > 0) || (reader->eof))
+		return EOK;
+
+	size_t nread;
+	errno_t ret = reader->read(reader->arg, reader->buffer,
+	    GZIP_READER_BUFFER_SIZE, &nread);
+	if (ret != EOK)
+		return ret;
+
+	if (nread == 0)
+		reader->eof = true;
+
+	reader->stream.next_in = reader->buffer;
+	reader->stream.avail_in = nread;
+	return EOK;
+}
+
+/** Read raw bytes from the reader input
+ *
+ * @param reader Streaming gzip reader.
+ * @param buf    Destination buffer or NULL to skip the data.
+ * @param size   Number of bytes to read.
+ *
+ * @return EOK on success.
+ * @return EINVAL on truncated input.
+ * @return Error code of the input callback.
+ *
+ */
+static errno_t gzip_reader_raw(gzip_reader_t *reader, void *buf, size_t size)
+{
+	uint8_t *dest = (uint8_t *) buf;
+
+	while (size > 0) {
+		errno_t ret = gzip_reader_fill(reader);
+		if (ret != EOK)
+			return ret;
+
+		if (reader->stream.avail_in == 0)
+			return EINVAL;
+
+		size_t cnt = reader->stream.avail_in;
+		if (cnt > size)
+			cnt = size;
+
+		if (dest != NULL) {
+			memcpy(dest, reader->stream.next_in, cnt);
+			dest += cnt;
+		}
+
+		reader->stream.next_in += cnt;
+		reader->stream.avail_in -= cnt;
+		size -= cnt;
+	}
+
+	return EOK;
+}
+
+/** Skip a zero-terminated string in the reader input
+ *
+ * @param reader Streaming gzip reader.
+ *
+ * @return EOK on success.
+ * @return EINVAL on truncated input.
+ * @return Error code of the input callback.
+ *
+ */
+static errno_t gzip_reader_skip_string(gzip_reader_t *reader)
+{
+	uint8_t c;
+
+	do {
+		errno_t ret = gzip_reader_raw(reader, &c, 1);
+		if (ret != EOK)
+			return ret;
+	} while (c != 0);
+
+	return EOK;
+}
+
+/** Parse a member header
+ *
+ * @param reader Streaming gzip reader.
+ *
+ * @return EOK on success (reader->finished is set if there are no
+ *         more members).
+ * @return EINVAL on invalid or truncated header.
+ * @return Error code of the input callback.
+ *
+ */
+static errno_t gzip_reader_header(gzip_reader_t *reader)
+{
+	gzip_header_t header;
+
+	/* End of input at a member boundary is a regular end */
+	errno_t ret = gzip_reader_fill(reader);
+	if (ret != EOK)
+		return ret;
+
+	if (reader->stream.avail_in == 0) {
+		reader->finished = true;
+		return EOK;
+	}
+
+	ret = gzip_reader_raw(reader, &header, sizeof(header));
+	if (ret != EOK)
+		return ret;
+
+	if ((header.id1 != GZIP_ID1) ||
+	    (header.id2 != GZIP_ID2) ||
+	    (header.method != GZIP_METHOD_DEFLATE) ||
+	    ((header.flags & (~GZIP_FLAGS_MASK)) != 0))
+		return EINVAL;
+
+	/* Ignore extra metadata */
+
+	if ((header.flags & GZIP_FLAG_FEXTRA) != 0) {
+		uint16_t extra_length;
+
+		ret = gzip_reader_raw(reader, &extra_length,
+		    sizeof(extra_length));
+		if (ret != EOK)
+			return ret;
+
+		ret = gzip_reader_raw(reader, NULL,
+		    uint16_t_le2host(extra_length));
+		if (ret != EOK)
+			return ret;
+	}
+
+	if ((header.flags & GZIP_FLAG_FNAME) != 0) {
+		ret = gzip_reader_skip_string(reader);
+		if (ret != EOK)
+			return ret;
+	}
+
+	if ((header.flags & GZIP_FLAG_FCOMMENT) != 0) {
+		ret = gzip_reader_skip_string(reader);
+		if (ret != EOK)
+			return ret;
+	}
+
+	if ((header.flags & GZIP_FLAG_FHCRC) != 0) {
+		ret = gzip_reader_raw(reader, NULL, 2);
+		if (ret != EOK)
+			return ret;
+	}
+
+	inflate_reset(&reader->stream);
+	reader->crc = 0;
+	reader->size = 0;
+	reader->need_header = false;
+	return EOK;
+}
+
+/** Create streaming gzip reader
+ *
+ * The reader decompresses data as they are requested using a constant
+ * amount of memory regardless of the size of the stream. Concatenated
+ * gzip members are decompressed as a single stream.
+ *
+ * @param[in]  read   Input callback.
+ * @param[in]  arg    Input callback argument.
+ * @param[out] reader New streaming gzip reader.
+ *
+ * @return EOK on success.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t gzip_reader_create(gzip_read_t read, void *arg,
+    gzip_reader_t **reader)
+{
+	gzip_reader_t *new_reader = calloc(1, sizeof(gzip_reader_t));
+	if (new_reader == NULL)
+		return ENOMEM;
+
+	new_reader->buffer = malloc(GZIP_READER_BUFFER_SIZE);
+	if (new_reader->buffer == NULL) {
+		free(new_reader);
+		return ENOMEM;
+	}
+
+	errno_t ret = inflate_init(&new_reader->stream);
+	if (ret != EOK) {
+		free(new_reader->buffer);
+		free(new_reader);
+		return ret;
+	}
+
+	new_reader->read = read;
+	new_reader->arg = arg;
+	new_reader->stream.next_in = new_reader->buffer;
+	new_reader->stream.avail_in = 0;
+	new_reader->eof = false;
+	new_reader->need_header = true;
+	new_reader->finished = false;
+
+	*reader = new_reader;
+	return EOK;
+}
+
+/** Read decompressed data
+ *
+ * The CRC32 and size of each member are verified when its end is
+ * reached.
+ *
+ * @param[in]  reader Streaming gzip reader.
+ * @param[out] buf    Destination buffer.
+ * @param[in]  size   Size of the destination buffer (bytes).
+ * @param[out] nread  Number of bytes read (zero at the end of data).
+ *
+ * @return EOK on success.
+ * @return ENOENT on distance too large.
+ * @return EINVAL on invalid Huffman code, invalid deflate data,
+ *                   invalid compression method, invalid or truncated
+ *                   stream or checksum mismatch.
+ * @return Error code of the input callback.
+ *
+ */
+errno_t gzip_reader_read(gzip_reader_t *reader, void *buf, size_t size,
+    size_t *nread)
+{
+	uint8_t *dest = (uint8_t *) buf;
+	size_t cnt = 0;
+	errno_t ret = EOK;
+
+	while ((cnt < size) && (!reader->finished)) {
+		if (reader->need_header) {
+			ret = gzip_reader_header(reader);
+			if (ret != EOK)
+				break;
+
+			continue;
+		}
+
+		ret = gzip_reader_fill(reader);
+		if (ret != EOK)
+			break;
+
+		if ((reader->stream.avail_in == 0) && (reader->eof)) {
+			/* Truncated deflate stream */
+			ret = EINVAL;
+			break;
+		}
+
+		reader->stream.next_out = dest + cnt;
+		reader->stream.avail_out = size - cnt;
+
+		ret = inflate_step(&reader->stream);
+		if (ret != EOK)
+			break;
+
+		const size_t produced = reader->stream.next_out - (dest + cnt);
+		reader->crc = compute_crc32_seed(dest + cnt, produced,
+		    reader->crc);
+		reader->size += produced;
+		cnt += produced;
+
+		if (reader->stream.done) {
+			gzip_footer_t footer;
+
+			ret = gzip_reader_raw(reader, &footer, sizeof(footer));
+			if (ret != EOK)
+				break;
+
+			if ((uint32_t_le2host(footer.crc32) != reader->crc) ||
+			    (uint32_t_le2host(footer.size) != reader->size)) {
+				ret = EINVAL;
+				break;
+			}
+
+			reader->need_header = true;
+		}
+	}
+
+	*nread = cnt;
+	return ret;
+}
+
+/** Destroy streaming gzip reader
+ *
+ * @param reader Streaming gzip reader.
+ *
+ */
+void gzip_reader_destroy(gzip_reader_t *reader)
+{
+	inflate_end(&reader->stream);
+	free(reader->buffer);
+	free(reader);
+}
+
+/** Compress data into GZIP format
+ *
+ * The routine allocates the output buffer large enough
+ * to hold the compressed data in the worst case.
+ *
+ * @param[in]  src     Source data buffer.
+ * @param[in]  srclen  Source buffer size (bytes).
+ * @param[in]  level   Compression level.
+ * @param[out] dest    Destination data buffer.
+ * @param[out] destlen Destination data size (bytes).
+ *
+ * @return EOK on success.
+ * @return EINVAL on invalid compression level.
+ * @return ELIMIT if the source data is larger than 4 GiB.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t gzip_compress(void *src, size_t srclen, int level, void **dest,
+    size_t *destlen)
+{
+	gzip_header_t header;
+	gzip_footer_t footer;
+
+	if ((level < DEFLATE_LEVEL_MIN) || (level > DEFLATE_LEVEL_MAX))
+		return EINVAL;
+
+	if (srclen > UINT32_MAX)
+		return ELIMIT;
+
+	const size_t bound = sizeof(header) + deflate_bound(srclen) +
+	    sizeof(footer);
+
+	uint8_t *buffer = malloc(bound);
+	if (buffer == NULL)
+		return ENOMEM;
+
+	gzip_header_init(&header, level);
+	memcpy(buffer, &header, sizeof(header));
+
+	size_t dsize;
+	errno_t ret = deflate(src, srclen, buffer + sizeof(header),
+	    bound - sizeof(header) - sizeof(footer), &dsize, level);
+	if (ret != EOK) {
+		free(buffer);
+		return ret;
+	}
+
+	footer.crc32 = host2uint32_t_le(compute_crc32(src, srclen));
+	footer.size = host2uint32_t_le(srclen);
+	memcpy(buffer + sizeof(header) + dsize, &footer, sizeof(footer));
+
+	*dest = buffer;
+	*destlen = sizeof(header) + dsize + sizeof(footer);
+	return EOK;
+}
+
+/** Pass the output buffer contents to the output callback
+ *
+ * @param writer Streaming gzip writer.
+ *
+ * @return EOK on success.
+ * @return Error code of the output callback.
+ *
+ */
+static errno_t gzip_writer_flush(gzip_writer_t *writer)
+{
+	const size_t cnt = writer->stream.next_out - writer->buffer;
+
+	writer->stream.next_out = writer->buffer;
+	writer->stream.avail_out = GZIP_WRITER_BUFFER_SIZE;
+
+	if (cnt == 0)
+		return EOK;
+
+	return writer->write(writer->arg, writer->buffer, cnt);
+}
+
+/** Compress data through the writer
+ *
+ * @param writer Streaming gzip writer.
+ * @param buf    Source data or NULL.
+ * @param size   Size of the source data.
+ * @param finish Finish the deflate stream.
+ *
+ * @return EOK on success.
+ * @return Error code of the output callback.
+ *
+ */
+static errno_t gzip_writer_deflate(gzip_writer_t *writer, const void *buf,
+    size_t size, bool finish)
+{
+	writer->stream.next_in = (const uint8_t *) buf;
+	writer->stream.avail_in = size;
+
+	while (true) {
+		errno_t ret = deflate_step(&writer->stream, finish);
+		if (ret != EOK)
+			return ret;
+
+		if (writer->stream.avail_out == 0) {
+			ret = gzip_writer_flush(writer);
+			if (ret != EOK)
+				return ret;
+
+			continue;
+		}
+
+		if ((writer->stream.avail_in == 0) &&
+		    ((!finish) || (writer->stream.done)))
+			return EOK;
+	}
+}
+
+/** Create streaming gzip writer
+ *
+ * The writer compresses data as they are written using a constant
+ * amount of memory regardless of the size of the stream. The output
+ * forms a single gzip member.
+ *
+ * @param[in]  write  Output callback.
+ * @param[in]  arg    Output callback argument.
+ * @param[in]  level  Compression level.
+ * @param[out] writer New streaming gzip writer.
+ *
+ * @return EOK on success.
+ * @return EINVAL on invalid compression level.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t gzip_writer_create(gzip_write_t write, void *arg, int level,
+    gzip_writer_t **writer)
+{
+	gzip_header_t header;
+
+	gzip_writer_t *new_writer = calloc(1, sizeof(gzip_writer_t));
+	if (new_writer == NULL)
+		return ENOMEM;
+
+	new_writer->buffer = malloc(GZIP_WRITER_BUFFER_SIZE);
+	if (new_writer->buffer == NULL) {
+		free(new_writer);
+		return ENOMEM;
+	}
+
+	errno_t ret = deflate_init(&new_writer->stream, level);
+	if (ret != EOK) {
+		free(new_writer->buffer);
+		free(new_writer);
+		return ret;
+	}
+
+	/* The header is output along with the first compressed data */
+	gzip_header_init(&header, level);
+	memcpy(new_writer->buffer, &header, sizeof(header));
+
+	new_writer->write = write;
+	new_writer->arg = arg;
+	new_writer->stream.next_out = new_writer->buffer + sizeof(header);
+	new_writer->stream.avail_out = GZIP_WRITER_BUFFER_SIZE - sizeof(header);
+	new_writer->finished = false;
+	new_writer->crc = 0;
+	new_writer->size = 0;
+
+	*writer = new_writer;
+	return EOK;
+}
+
+/** Write data to be compressed
+ *
+ * @param writer Streaming gzip writer.
+ * @param buf    Source data.
+ * @param size   Size of the source data (bytes).
+ *
+ * @return EOK on success.
+ * @return EINVAL if the writer has already been finished.
+ * @return Error code of the output callback.
+ *
+ */
+errno_t gzip_writer_write(gzip_writer_t *writer, const void *buf, size_t size)
+{
+	if (writer->finished)
+		return EINVAL;
+
+	writer->crc = compute_crc32_seed((uint8_t *) buf, size, writer->crc);
+	writer->size += size;
+
+	return gzip_writer_deflate(writer, buf, size, false);
+}
+
+/** Finish the compressed stream
+ *
+ * Outputs all remaining compressed data and the member footer.
+ *
+ * @param writer Streaming gzip writer.
+ *
+ * @return EOK on success.
+ * @return EINVAL if the writer has already been finished.
+ * @return Error code of the output callback.
+ *
+ */
+errno_t gzip_writer_finish(gzip_writer_t *writer)
+{
+	gzip_footer_t footer;
+
+	if (writer->finished)
+		return EINVAL;
+
+	errno_t ret = gzip_writer_deflate(writer, NULL, 0, true);
+	if (ret != EOK)
+		return ret;
+
+	if (writer->stream.avail_out < sizeof(footer)) {
+		ret = gzip_writer_flush(writer);
+		if (ret != EOK)
+			return ret;
+	}
+
+	footer.crc32 = host2uint32_t_le(writer->crc);
+	footer.size = host2uint32_t_le(writer->size);
+	memcpy(writer->stream.next_out, &footer, sizeof(footer));
+	writer->stream.next_out += sizeof(footer);
+	writer->stream.avail_out -= sizeof(footer);
+
+	writer->finished = true;
+	return gzip_writer_flush(writer);
+}
+
+/** Destroy streaming gzip writer
+ *
+ * Data not yet finished by gzip_writer_finish() are discarded.
+ *
+ * @param writer Streaming gzip writer.
+ *
+ */
+void gzip_writer_destroy(gzip_writer_t *writer)
+{
+	deflate_end(&writer->stream);
+	free(writer->buffer);
+	free(writer);
+}
@@ -29,8 +29,39 @@
 #ifndef LIBCOMPRESS_GZIP_H_
 #define LIBCOMPRESS_GZIP_H_
 
+#include <errno.h>
 #include <stddef.h>
 
+/** Input callback of the streaming gzip reader
+ *
+ * Reads at most size bytes into the buffer and stores the number of
+ * bytes actually read. Zero bytes read indicates end of input.
+ *
+ */
+typedef errno_t (*gzip_read_t)(void *, void *, size_t, size_t *);
+
+typedef struct gzip_reader gzip_reader_t;
+
+/** Output callback of the streaming gzip writer
+ *
+ * Writes size bytes from the buffer.
+ *
+ */
+typedef errno_t (*gzip_write_t)(void *, const void *, size_t);
+
+typedef struct gzip_writer gzip_writer_t;
+
 extern errno_t gzip_expand(void *, size_t, void **, size_t *);
 
+extern errno_t gzip_reader_create(gzip_read_t, void *, gzip_reader_t **);
+extern errno_t gzip_reader_read(gzip_reader_t *, void *, size_t, size_t *);
+extern void gzip_reader_destroy(gzip_reader_t *);
+
+extern errno_t gzip_compress(void *, size_t, int, void **, size_t *);
+
+extern errno_t gzip_writer_create(gzip_write_t, void *, int, gzip_writer_t **);
+extern errno_t gzip_writer_write(gzip_writer_t *, const void *, size_t);
+extern errno_t gzip_writer_finish(gzip_writer_t *);
+extern void gzip_writer_destroy(gzip_writer_t *);
+
 #endif
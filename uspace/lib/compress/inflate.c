@@ -30,12 +30,18 @@
 /** @file
  * @brief Implementation of inflate decompression
  *
- * A simple inflate implementation (decompression of `deflate' stream as
- * described by RFC 1951) based on puff.c by Mark Adler. This code is
- * currently not optimized for speed but for readability.
+ * An incremental inflate implementation (decompression of `deflate'
+ * stream as described by RFC 1951) originally based on puff.c by Mark
+ * Adler.
  *
- * All dynamically allocated memory memory is taken from the stack. The
- * stack usage should be typically bounded by 2 KB.
+ * The decoder is a resumable state machine. It can be suspended whenever
+ * it runs out of input or output space and continued once the caller
+ * provides more. Back-references are resolved against a 32 KiB sliding
+ * window, so neither the whole input nor the whole output needs to be in
+ * memory at once.
+ *
+ * Huffman codes are decoded by a two-level lookup table indexed by the
+ * next bits of the input instead of walking the code one bit at a time.
  *
  * Original copyright notice:
  *
@@ -68,6 +74,7 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <mem.h>
+#include <stdlib.h>
 #include "inflate.h"
 
 /** Maximum bits in the Huffman code */
@@ -83,42 +90,113 @@
 #define MAX_LITLEN        286
 /** Number of fixed literal/length codes */
 #define MAX_FIXED_LITLEN  288
+/** Number of fixed distance codes */
+#define MAX_FIXED_DIST    30
 
 /** Number of all codes */
 #define MAX_CODE  (MAX_LITLEN + MAX_DIST)
 
-/** Check for input buffer overrun condition */
-#define CHECK_OVERRUN(state) \
-	do { \
-		if ((state).overrun) \
-			return ELIMIT; \
-	} while (false)
+/** Bits resolved by the first level of the literal/length table */
+#define LEN_ROOT_BITS    9
+/** Bits resolved by the first level of the distance table */
+#define DIST_ROOT_BITS   6
+/** Bits resolved by the code length table (no second level) */
+#define ORDER_ROOT_BITS  7
+
+/** Literal/length table size (both levels) */
+#define LEN_TABLE_SIZE   4096
+/** Distance table size (both levels) */
+#define DIST_TABLE_SIZE  2048
+/** Code length table size */
+#define ORDER_TABLE_SIZE  (1 << ORDER_ROOT_BITS)
+
+/** Window index mask */
+#define WINDOW_MASK  (INFLATE_WINDOW_SIZE - 1)
+
+/** Huffman table entry types */
+enum {
+	/** Entry decodes a symbol */
+	ENTRY_SYMBOL = 0,
+	/** Entry points to a second level table */
+	ENTRY_LINK = 1,
+	/** No code maps to the entry */
+	ENTRY_INVALID = 2
+};
 
-/** Inflate algorithm state
+/** Compose Huffman table entry
+ *
+ * Bits 0-15 hold the symbol or the offset of the second level table,
+ * bits 16-23 the number of bits consumed by the entry (the index width
+ * of the second level table for links), bits 24-31 the entry type.
  *
  */
-typedef struct {
-	uint8_t *dest;    /**< Output buffer */
-	size_t destlen;   /**< Output buffer size */
-	size_t destcnt;   /**< Position in the output buffer */
-
-	uint8_t *src;     /**< Input buffer */
-	size_t srclen;    /**< Input buffer size */
-	size_t srccnt;    /**< Position in the input buffer */
+#define ENTRY(type, bits, value) \
+	((((uint32_t) (type)) << 24) | (((uint32_t) (bits)) << 16) | \
+	((uint32_t) (value)))
+
+#define ENTRY_TYPE(entry)   ((entry) >> 24)
+#define ENTRY_BITS(entry)   (((entry) >> 16) & 0xff)
+#define ENTRY_VALUE(entry)  ((entry) & 0xffff)
+
+/** Decoder modes */
+typedef enum {
+	/** Block header */
+	MODE_HEADER,
+	/** Length of a stored block */
+	MODE_STORED,
+	/** Copying stored block data */
+	MODE_COPY,
+	/** Sizes of dynamic code tables */
+	MODE_TABLE,
+	/** Code length code lengths */
+	MODE_LENLENS,
+	/** Literal/length and distance code lengths */
+	MODE_CODELENS,
+	/** Literal/length symbol */
+	MODE_LEN,
+	/** Extra length bits */
+	MODE_LENEXT,
+	/** Distance symbol */
+	MODE_DIST,
+	/** Extra distance bits */
+	MODE_DISTEXT,
+	/** Copying a match */
+	MODE_MATCH,
+	/** Final block finished */
+	MODE_DONE,
+	/** Invalid data encountered */
+	MODE_BAD
+} inflate_mode_t;
 
-	uint16_t bitbuf;  /**< Bit buffer */
-	size_t bitlen;    /**< Number of bits in the bit buffer */
-
-	bool overrun;     /**< Overrun condition */
-} inflate_state_t;
-
-/** Huffman code description
+/** Inflate algorithm state
  *
  */
-typedef struct {
-	uint16_t *count;   /**< Array of symbol counts */
-	uint16_t *symbol;  /**< Array of symbols */
-} huffman_t;
+struct inflate_state {
+	inflate_mode_t mode;  /**< Current decoder mode */
+	bool last;            /**< Processing the final block */
+	errno_t error;        /**< Error that stopped decoding */
+
+	uint64_t hold;        /**< Bit buffer */
+	unsigned bits;        /**< Number of bits in the bit buffer */
+
+	size_t length;        /**< Remaining stored or match length */
+	size_t dist;          /**< Match distance */
+	unsigned extra;       /**< Number of extra bits to read */
+
+	unsigned nlen;        /**< Number of literal/length codes */
+	unsigned ndist;       /**< Number of distance codes */
+	unsigned ncode;       /**< Number of code length codes */
+	unsigned have;        /**< Number of code lengths read so far */
+	uint16_t lengths[MAX_CODE];  /**< Code lengths */
+
+	uint32_t order_table[ORDER_TABLE_SIZE];  /**< Code length code */
+	uint32_t len_table[LEN_TABLE_SIZE];      /**< Literal/length code */
+	uint32_t dist_table[DIST_TABLE_SIZE];    /**< Distance code */
+
+	uint8_t window[INFLATE_WINDOW_SIZE];  /**< Sliding window */
+	size_t wnext;         /**< Next write position in the window */
+	size_t whave;         /**< Number of valid bytes in the window */
+};
 
 /** Length codes
  *
@@ -161,454 +239,841 @@ static const short order[MAX_ORDER] = {
 	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
 };
 
-/** Static length symbol counts
+/** Reverse bits of a Huffman code
+ *
+ * Huffman codes are stored starting with the most significant bit,
+ * whereas all other values are stored starting with the least
+ * significant bit.
+ *
+ * @param code Code to reverse.
+ * @param len  Number of bits in the code.
+ *
+ * @return Reversed code.
  *
  */
-static uint16_t len_count[MAX_HUFFMAN_BIT + 1] = {
-	0, 0, 0, 0, 0, 0, 0, 24, 152, 112, 0, 0, 0, 0, 0, 0
-};
+static inline unsigned reverse_bits(unsigned code, unsigned len)
+{
+	unsigned rev = 0;
+
+	while (len > 0) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+		len--;
+	}
+
+	return rev;
+}
 
-/** Static length symbols
+/** Construct Huffman decoding table from canonical Huffman code
+ *
+ * Codes not longer than root bits are resolved by a single lookup.
+ * Longer codes share a first level entry by their first root bits
+ * which links to a second level table indexed by the remaining bits.
+ *
+ * @param table   Table to fill.
+ * @param size    Number of entries available in the table.
+ * @param root    Number of bits resolved by the first level.
+ * @param length  Lengths of the canonical Huffman code.
+ * @param n       Number of lengths.
+ * @param left    Number of unused codes (zero for a complete code).
+ *
+ * @return EOK on success.
+ * @return EINVAL on an over-subscribed code set or table overflow.
  *
  */
-static uint16_t len_symbol[MAX_FIXED_LITLEN] = {
-	256, 257, 258, 259, 260, 261, 262, 263, 264, 265, 266, 267, 268,
-	269, 270, 271, 272, 273, 274, 275, 276, 277, 278, 279, 0, 1, 2,
-	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
-	21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36,
-	37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52,
-	53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
-	69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84,
-	85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100,
-	101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113,
-	114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126,
-	127, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139,
-	140, 141, 142, 143, 280, 281, 282, 283, 284, 285, 286, 287, 144,
-	145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157,
-	158, 159, 160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170,
-	171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181, 182, 183,
-	184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196,
-	197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209,
-	210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222,
-	223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235,
-	236, 237, 238, 239, 240, 241, 242, 243, 244, 245, 246, 247, 248,
-	249, 250, 251, 252, 253, 254, 255
-};
+static errno_t huffman_construct(uint32_t *table, size_t size, unsigned root,
+    const uint16_t *length, size_t n, int *left)
+{
+	uint16_t count[MAX_HUFFMAN_BIT + 1];
+	uint16_t next_code[MAX_HUFFMAN_BIT + 1];
+	uint8_t sub_bits[1 << LEN_ROOT_BITS];
+	size_t len;
+	size_t symbol;
+
+	/* Count number of codes for each length */
+	for (len = 0; len <= MAX_HUFFMAN_BIT; len++)
+		count[len] = 0;
 
-/** Static distance symbol counts
+	for (symbol = 0; symbol < n; symbol++)
+		count[length[symbol]]++;
+
+	/* Check for an over-subscribed or incomplete set of lengths */
+	*left = 1;
+	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
+		*left <<= 1;
+		*left -= count[len];
+		if (*left < 0)
+			return EINVAL;
+	}
+
+	/* First canonical code of each length */
+	unsigned code = 0;
+	count[0] = 0;
+	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
+		code = (code + count[len - 1]) << 1;
+		next_code[len] = code;
+	}
+
+	const size_t root_size = 1 << root;
+	for (size_t i = 0; i < root_size; i++) {
+		table[i] = ENTRY(ENTRY_INVALID, 0, 0);
+		sub_bits[i] = 0;
+	}
+
+	/* Find the longest code behind each first level entry */
+	uint16_t codes[MAX_CODE];
+	for (symbol = 0; symbol < n; symbol++) {
+		len = length[symbol];
+		if (len == 0)
+			continue;
+
+		codes[symbol] = reverse_bits(next_code[len]++, len);
+		if (len > root) {
+			const unsigned prefix = codes[symbol] & (root_size - 1);
+			if (len - root > sub_bits[prefix])
+				sub_bits[prefix] = len - root;
+		}
+	}
+
+	/* Allocate second level tables */
+	size_t used = root_size;
+	for (size_t i = 0; i < root_size; i++) {
+		if (sub_bits[i] == 0)
+			continue;
+
+		const size_t sub_size = 1 << sub_bits[i];
+		if (used + sub_size > size)
+			return EINVAL;
+
+		table[i] = ENTRY(ENTRY_LINK, sub_bits[i], used);
+		for (size_t j = 0; j < sub_size; j++)
+			table[used + j] = ENTRY(ENTRY_INVALID, 0, 0);
+
+		used += sub_size;
+	}
+
+	/* Fill in the symbols, replicating entries for shorter codes */
+	for (symbol = 0; symbol < n; symbol++) {
+		len = length[symbol];
+		if (len == 0)
+			continue;
+
+		if (len <= root) {
+			for (size_t i = codes[symbol]; i < root_size; i += 1 << len)
+				table[i] = ENTRY(ENTRY_SYMBOL, len, symbol);
+		} else {
+			const uint32_t link =
+			    table[codes[symbol] & (root_size - 1)];
+			uint32_t *sub = table + ENTRY_VALUE(link);
+			const size_t sub_size = 1 << ENTRY_BITS(link);
+
+			for (size_t i = codes[symbol] >> root; i < sub_size;
+			    i += 1 << (len - root))
+				sub[i] = ENTRY(ENTRY_SYMBOL, len - root, symbol);
+		}
+	}
+
+	return EOK;
+}
+
+/** Pull one byte from the input into the bit buffer
+ *
+ * @param stream Inflate stream.
+ *
+ * @return True if a byte was available.
  *
  */
-static uint16_t dist_count[MAX_HUFFMAN_BIT + 1] = {
-	0, 0, 0, 0, 0, 30, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-};
+static inline bool pull_byte(inflate_stream_t *stream)
+{
+	struct inflate_state *state = stream->state;
+
+	if (stream->avail_in == 0)
+		return false;
 
-/** Static distance symbols
+	state->hold |= ((uint64_t) *stream->next_in) << state->bits;
+	state->bits += 8;
+	stream->next_in++;
+	stream->avail_in--;
+	stream->total_in++;
+	return true;
+}
+
+/** Make sure the bit buffer holds at least the given number of bits
+ *
+ * @param stream Inflate stream.
+ * @param cnt    Number of bits needed (at most 32).
+ *
+ * @return True if enough bits are available.
  *
  */
-static uint16_t dist_symbol[MAX_DIST] = {
-	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
-	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29
-};
+static inline bool need_bits(inflate_stream_t *stream, unsigned cnt)
+{
+	while (stream->state->bits < cnt) {
+		if (!pull_byte(stream))
+			return false;
+	}
+
+	return true;
+}
 
-/** Huffman code for lengths
+/** Peek bits in the bit buffer
+ *
+ * @param state Inflate state.
+ * @param cnt   Number of bits.
+ *
+ * @return The bits.
  *
  */
-static huffman_t len_code = {
-	.count = len_count,
-	.symbol = len_symbol
-};
+static inline unsigned peek_bits(struct inflate_state *state, unsigned cnt)
+{
+	return (unsigned) (state->hold & ((UINT64_C(1) << cnt) - 1));
+}
 
-/** Huffman code for distances
+/** Drop bits from the bit buffer
+ *
+ * @param state Inflate state.
+ * @param cnt   Number of bits.
  *
  */
-static huffman_t dist_code = {
-	.count = dist_count,
-	.symbol = dist_symbol
-};
+static inline void drop_bits(struct inflate_state *state, unsigned cnt)
+{
+	state->hold >>= cnt;
+	state->bits -= cnt;
+}
 
 /** Get bits from the bit buffer
+ *
+ * The bits must be available.
  *
  * @param state Inflate state.
- * @param cnt   Number of bits to return (at most 16).
+ * @param cnt   Number of bits.
  *
- * @return Returned bits.
+ * @return The bits.
  *
  */
-static inline uint16_t get_bits(inflate_state_t *state, size_t cnt)
+static inline unsigned get_bits(struct inflate_state *state, unsigned cnt)
 {
-	/* Bit accumulator for at least 20 bits */
-	uint32_t val = state->bitbuf;
+	const unsigned val = peek_bits(state, cnt);
+	drop_bits(state, cnt);
+	return val;
+}
 
-	while (state->bitlen < cnt) {
-		if (state->srccnt == state->srclen) {
-			state->overrun = true;
-			return 0;
+/** Look up a Huffman code without consuming it
+ *
+ * Pulls only as many input bytes as needed to resolve the code.
+ *
+ * @param stream Inflate stream.
+ * @param table  Huffman decoding table.
+ * @param root   Number of bits resolved by the first level.
+ * @param entry  Resolved table entry.
+ * @param bits   Total length of the resolved code.
+ *
+ * @return EOK on success.
+ * @return ELIMIT if more input is needed.
+ * @return EINVAL on invalid Huffman code.
+ *
+ */
+static errno_t huffman_peek(inflate_stream_t *stream, const uint32_t *table,
+    unsigned root, uint32_t *entry, unsigned *bits)
+{
+	struct inflate_state *state = stream->state;
+
+	while (true) {
+		uint32_t e = table[peek_bits(state, root)];
+		unsigned len = 0;
+
+		if (ENTRY_TYPE(e) == ENTRY_LINK) {
+			const uint32_t *sub = table + ENTRY_VALUE(e);
+			const unsigned sub_idx = (unsigned)
+			    ((state->hold >> root) &
+			    ((UINT64_C(1) << ENTRY_BITS(e)) - 1));
+			len = root;
+			e = sub[sub_idx];
 		}
 
-		/* Load 8 more bits */
-		val |= ((uint32_t) state->src[state->srccnt]) << state->bitlen;
-		state->srccnt++;
-		state->bitlen += 8;
-	}
+		len += ENTRY_BITS(e);
+
+		if ((ENTRY_TYPE(e) == ENTRY_SYMBOL) && (len <= state->bits)) {
+			*entry = e;
+			*bits = len;
+			return EOK;
+		}
 
-	/* Update bits in the buffer */
-	state->bitbuf = (uint16_t) (val >> cnt);
-	state->bitlen -= cnt;
+		/* Entry may be resolved differently once we have more bits */
+		if (state->bits >= MAX_HUFFMAN_BIT)
+			return EINVAL;
 
-	return ((uint16_t) (val & ((1 << cnt) - 1)));
+		if (!pull_byte(stream))
+			return ELIMIT;
+	}
 }
 
-/** Decode `stored' block
+/** Decode and consume a Huffman code
  *
- * @param state Inflate state.
+ * @param stream Inflate stream.
+ * @param table  Huffman decoding table.
+ * @param root   Number of bits resolved by the first level.
+ * @param symbol Decoded symbol.
  *
  * @return EOK on success.
- * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
- * @return EINVAL on invalid data.
+ * @return ELIMIT if more input is needed.
+ * @return EINVAL on invalid Huffman code.
  *
  */
-static errno_t inflate_stored(inflate_state_t *state)
+static inline errno_t huffman_decode(inflate_stream_t *stream,
+    const uint32_t *table, unsigned root, unsigned *symbol)
 {
-	/* Discard bits in the bit buffer */
-	state->bitbuf = 0;
-	state->bitlen = 0;
+	uint32_t entry;
+	unsigned bits;
 
-	if (state->srccnt + 4 > state->srclen)
-		return ELIMIT;
+	errno_t rc = huffman_peek(stream, table, root, &entry, &bits);
+	if (rc != EOK)
+		return rc;
 
-	uint16_t len =
-	    state->src[state->srccnt] | (state->src[state->srccnt + 1] << 8);
-	uint16_t len_compl =
-	    state->src[state->srccnt + 2] | (state->src[state->srccnt + 3] << 8);
+	drop_bits(stream->state, bits);
+	*symbol = ENTRY_VALUE(entry);
+	return EOK;
+}
 
-	/* Check block length and its complement */
-	if (((int16_t) len) != ~((int16_t) len_compl))
-		return EINVAL;
+/** Build Huffman tables for a `fixed codes' block
+ *
+ * @param state Inflate state.
+ *
+ */
+static void inflate_fixed_tables(struct inflate_state *state)
+{
+	uint16_t *length = state->lengths;
+	size_t symbol;
+	int left;
 
-	state->srccnt += 4;
+	for (symbol = 0; symbol < 144; symbol++)
+		length[symbol] = 8;
+	for (; symbol < 256; symbol++)
+		length[symbol] = 9;
+	for (; symbol < 280; symbol++)
+		length[symbol] = 7;
+	for (; symbol < MAX_FIXED_LITLEN; symbol++)
+		length[symbol] = 8;
 
-	/* Check input buffer size */
-	if (state->srccnt + len > state->srclen)
-		return ELIMIT;
+	(void) huffman_construct(state->len_table, LEN_TABLE_SIZE,
+	    LEN_ROOT_BITS, length, MAX_FIXED_LITLEN, &left);
 
-	/* Check output buffer size */
-	if (state->destcnt + len > state->destlen)
-		return ENOMEM;
+	for (symbol = 0; symbol < MAX_FIXED_DIST; symbol++)
+		length[symbol] = 5;
 
-	/* Copy data */
-	memcpy(state->dest + state->destcnt, state->src + state->srccnt, len);
-	state->srccnt += len;
-	state->destcnt += len;
+	(void) huffman_construct(state->dist_table, DIST_TABLE_SIZE,
+	    DIST_ROOT_BITS, length, MAX_FIXED_DIST, &left);
+}
 
-	return EOK;
+/** Count symbols with a non-zero code length
+ *
+ * @param length Code lengths.
+ * @param n      Number of lengths.
+ *
+ * @return Number of used codes.
+ *
+ */
+static size_t count_codes(const uint16_t *length, size_t n)
+{
+	size_t cnt = 0;
+
+	for (size_t symbol = 0; symbol < n; symbol++) {
+		if (length[symbol] != 0)
+			cnt++;
+	}
+
+	return cnt;
 }
 
-/** Decode a symbol using the Huffman code
+/** Build Huffman tables for a `dynamic codes' block
  *
- * @param state   Inflate state.
- * @param huffman Huffman code.
- * @param symbol  Decoded symbol.
+ * @param state Inflate state with all code lengths read.
  *
- * @param EOK on success.
- * @param EINVAL on invalid Huffman code.
+ * @return EOK on success.
+ * @return EINVAL on invalid code lengths.
  *
  */
-static errno_t huffman_decode(inflate_state_t *state, huffman_t *huffman,
-    uint16_t *symbol)
+static errno_t inflate_dynamic_tables(struct inflate_state *state)
 {
-	/* Decode bits */
-	uint16_t code = 0;
+	int left;
 
-	/* First code of the given length */
-	size_t first = 0;
+	/* Check for end-of-block code */
+	if (state->lengths[256] == 0)
+		return EINVAL;
 
-	/*
-	 * Index of the first code of the given length
-	 * in the symbol table
-	 */
-	size_t index = 0;
+	/* Build Huffman tables for literal/length codes */
+	errno_t rc = huffman_construct(state->len_table, LEN_TABLE_SIZE,
+	    LEN_ROOT_BITS, state->lengths, state->nlen, &left);
+	if (rc != EOK)
+		return rc;
 
-	/* Current number of bits in the code */
-	size_t len;
+	/* Incomplete code is only allowed for a single code */
+	if ((left > 0) && (count_codes(state->lengths, state->nlen) != 1))
+		return EINVAL;
 
-	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
-		/* Get next bit */
-		code |= get_bits(state, 1);
-		CHECK_OVERRUN(*state);
-
-		uint16_t count = huffman->count[len];
-		if (code < first + count) {
-			/* Return decoded symbol */
-			*symbol = huffman->symbol[index + code - first];
-			return EOK;
-		}
+	/* Build Huffman tables for distance codes */
+	rc = huffman_construct(state->dist_table, DIST_TABLE_SIZE,
+	    DIST_ROOT_BITS, state->lengths + state->nlen, state->ndist, &left);
+	if (rc != EOK)
+		return rc;
 
-		/* Update for next length */
-		index += count;
-		first += count;
-		first <<= 1;
-		code <<= 1;
-	}
+	if ((left > 0) &&
+	    (count_codes(state->lengths + state->nlen, state->ndist) > 1))
+		return EINVAL;
 
-	return EINVAL;
+	return EOK;
 }
 
-/** Construct Huffman tables from canonical Huffman code
+/** Copy match data to the output
  *
- * @param huffman Constructed Huffman tables.
- * @param length  Lengths of the canonical Huffman code.
- * @param n       Number of lengths.
+ * Bytes produced in this step are copied from the output buffer, older
+ * bytes are taken from the sliding window.
  *
- * @return 0 if the Huffman code set is complete.
- * @return Negative value for an over-subscribed code set.
- * @return Positive value for an incomplete code set.
+ * @param stream    Inflate stream.
+ * @param out_start Start of the output produced in this step.
  *
  */
-static int16_t huffman_construct(huffman_t *huffman, uint16_t *length, size_t n)
+static void inflate_copy_match(inflate_stream_t *stream,
+    const uint8_t *out_start)
 {
-	/* Count number of codes for each length */
-	size_t len;
-	for (len = 0; len <= MAX_HUFFMAN_BIT; len++)
-		huffman->count[len] = 0;
-
-	/* We assume that the lengths are within bounds */
-	size_t symbol;
-	for (symbol = 0; symbol < n; symbol++)
-		huffman->count[length[symbol]]++;
+	struct inflate_state *state = stream->state;
+	const size_t produced = stream->next_out - out_start;
+
+	if (state->dist > produced) {
+		/* Copy from the window */
+		size_t back = state->dist - produced;
+		size_t cnt = state->length;
+		if (cnt > back)
+			cnt = back;
+		if (cnt > stream->avail_out)
+			cnt = stream->avail_out;
+
+		size_t pos = (state->wnext - back) & WINDOW_MASK;
+		for (size_t i = 0; i < cnt; i++) {
+			stream->next_out[i] = state->window[pos];
+			pos = (pos + 1) & WINDOW_MASK;
+		}
 
-	if (huffman->count[0] == n) {
-		/* The code is complete, but decoding will fail */
-		return 0;
+		stream->next_out += cnt;
+		stream->avail_out -= cnt;
+		state->length -= cnt;
 	}
 
-	/* Check for an over-subscribed or incomplete set of lengths */
-	int16_t left = 1;
-	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
-		left <<= 1;
-		left -= huffman->count[len];
-		if (left < 0) {
-			/* Over-subscribed */
-			return left;
-		}
-	}
+	/* Copy from the output, the regions may overlap */
+	size_t cnt = state->length;
+	if (cnt > stream->avail_out)
+		cnt = stream->avail_out;
 
-	/* Generate offsets into symbol table */
-	uint16_t offs[MAX_HUFFMAN_BIT + 1];
+	const uint8_t *from = stream->next_out - state->dist;
+	for (size_t i = 0; i < cnt; i++)
+		stream->next_out[i] = from[i];
 
-	offs[1] = 0;
-	for (len = 1; len < MAX_HUFFMAN_BIT; len++)
-		offs[len + 1] = offs[len] + huffman->count[len];
+	stream->next_out += cnt;
+	stream->avail_out -= cnt;
+	state->length -= cnt;
+}
 
-	for (symbol = 0; symbol < n; symbol++) {
-		if (length[symbol] != 0) {
-			huffman->symbol[offs[length[symbol]]] = symbol;
-			offs[length[symbol]]++;
-		}
+/** Update the sliding window with the data produced in this step
+ *
+ * @param state     Inflate state.
+ * @param out_start Start of the output produced in this step.
+ * @param cnt       Number of bytes produced.
+ *
+ */
+static void inflate_update_window(struct inflate_state *state,
+    const uint8_t *out_start, size_t cnt)
+{
+	if (cnt >= INFLATE_WINDOW_SIZE) {
+		memcpy(state->window, out_start + cnt - INFLATE_WINDOW_SIZE,
+		    INFLATE_WINDOW_SIZE);
+		state->wnext = 0;
+		state->whave = INFLATE_WINDOW_SIZE;
+		return;
 	}
 
-	return left;
+	size_t first = INFLATE_WINDOW_SIZE - state->wnext;
+	if (first > cnt)
+		first = cnt;
+
+	memcpy(state->window + state->wnext, out_start, first);
+	memcpy(state->window, out_start + first, cnt - first);
+
+	state->wnext = (state->wnext + cnt) & WINDOW_MASK;
+	state->whave += cnt;
+	if (state->whave > INFLATE_WINDOW_SIZE)
+		state->whave = INFLATE_WINDOW_SIZE;
 }
 
-/** Decode literal/length and distance codes
+/** Run the decoder until it needs more input or output space
  *
- * Decode until end-of-block code.
+ * @param stream    Inflate stream.
+ * @param out_start Start of the output produced in this step.
  *
- * @param state     Inflate state.
- * @param len_code  Huffman code for literal/length.
- * @param dist_code Huffman code for distance.
- *
- * @return EOK on success.
+ * @return EOK if the decoder is waiting for input or output space or
+ *         the final block was decoded.
  * @return ENOENT on distance too large.
- * @return EINVAL on invalid Huffman code.
- * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
+ * @return EINVAL on invalid Huffman code or invalid deflate data.
  *
  */
-static errno_t inflate_codes(inflate_state_t *state, huffman_t *len_code,
-    huffman_t *dist_code)
+static errno_t inflate_run(inflate_stream_t *stream, const uint8_t *out_start)
 {
-	uint16_t symbol;
+	struct inflate_state *state = stream->state;
+	unsigned symbol;
+	uint32_t entry;
+	unsigned bits;
+	errno_t rc;
+
+	while (true) {
+		switch (state->mode) {
+		case MODE_HEADER:
+			if (!need_bits(stream, 3))
+				return EOK;
+
+			/* Last block is indicated by a non-zero bit */
+			state->last = get_bits(state, 1);
+
+			/* Block type */
+			switch (get_bits(state, 2)) {
+			case 0:
+				state->mode = MODE_STORED;
+				break;
+			case 1:
+				inflate_fixed_tables(state);
+				state->mode = MODE_LEN;
+				break;
+			case 2:
+				state->mode = MODE_TABLE;
+				break;
+			default:
+				return EINVAL;
+			}
+			break;
+		case MODE_STORED:
+			/* Discard bits up to the byte boundary */
+			drop_bits(state, state->bits & 7);
 
-	do {
-		errno_t err = huffman_decode(state, len_code, &symbol);
-		if (err != EOK) {
-			/* Error decoding */
-			return err;
-		}
+			if (!need_bits(stream, 32))
+				return EOK;
+
+			const unsigned len = get_bits(state, 16);
+			const unsigned len_compl = get_bits(state, 16);
+
+			/* Check block length and its complement */
+			if (len != (~len_compl & 0xffff))
+				return EINVAL;
+
+			state->length = len;
+			state->mode = MODE_COPY;
+			break;
+		case MODE_COPY:
+			/* Bytes already loaded in the bit buffer go first */
+			while ((state->length > 0) && (state->bits >= 8) &&
+			    (stream->avail_out > 0)) {
+				*stream->next_out++ = get_bits(state, 8);
+				stream->avail_out--;
+				state->length--;
+			}
+
+			size_t cnt = state->length;
+			if (cnt > stream->avail_in)
+				cnt = stream->avail_in;
+			if (cnt > stream->avail_out)
+				cnt = stream->avail_out;
+
+			memcpy(stream->next_out, stream->next_in, cnt);
+			stream->next_in += cnt;
+			stream->avail_in -= cnt;
+			stream->total_in += cnt;
+			stream->next_out += cnt;
+			stream->avail_out -= cnt;
+			state->length -= cnt;
+
+			if (state->length > 0)
+				return EOK;
+
+			state->mode = state->last ? MODE_DONE : MODE_HEADER;
+			break;
+		case MODE_TABLE:
+			if (!need_bits(stream, 14))
+				return EOK;
+
+			/* Get number of bits in each table */
+			state->nlen = get_bits(state, 5) + 257;
+			state->ndist = get_bits(state, 5) + 1;
+			state->ncode = get_bits(state, 4) + 4;
+
+			if ((state->nlen > MAX_LITLEN) ||
+			    (state->ndist > MAX_DIST))
+				return EINVAL;
+
+			state->have = 0;
+			state->mode = MODE_LENLENS;
+			break;
+		case MODE_LENLENS:
+			/* Read code length code lengths */
+			while (state->have < state->ncode) {
+				if (!need_bits(stream, 3))
+					return EOK;
+
+				state->lengths[order[state->have]] =
+				    get_bits(state, 3);
+				state->have++;
+			}
+
+			/* Set missing lengths to zero */
+			for (; state->have < MAX_ORDER; state->have++)
+				state->lengths[order[state->have]] = 0;
+
+			/* Build Huffman code */
+			int left;
+			rc = huffman_construct(state->order_table,
+			    ORDER_TABLE_SIZE, ORDER_ROOT_BITS, state->lengths,
+			    MAX_ORDER, &left);
+			if ((rc != EOK) || (left != 0))
+				return EINVAL;
 
-		if (symbol < 256) {
-			/* Write out literal */
-			if (state->destcnt == state->destlen)
-				return ENOMEM;
+			state->have = 0;
+			state->mode = MODE_CODELENS;
+			break;
+		case MODE_CODELENS:
+			/* Read length/literal and distance code length tables */
+			while (state->have < state->nlen + state->ndist) {
+				rc = huffman_peek(stream, state->order_table,
+				    ORDER_ROOT_BITS, &entry, &bits);
+				if (rc == ELIMIT)
+					return EOK;
+				if (rc != EOK)
+					return rc;
+
+				symbol = ENTRY_VALUE(entry);
+				if (symbol < 16) {
+					drop_bits(state, bits);
+					state->lengths[state->have] = symbol;
+					state->have++;
+					continue;
+				}
+
+				/* Consume the code only with its extra bits */
+				unsigned extra;
+				unsigned base;
+				uint16_t rep_len = 0;
+
+				if (symbol == 16) {
+					if (state->have == 0)
+						return EINVAL;
+
+					rep_len = state->lengths[state->have - 1];
+					extra = 2;
+					base = 3;
+				} else if (symbol == 17) {
+					extra = 3;
+					base = 3;
+				} else {
+					extra = 7;
+					base = 11;
+				}
+
+				if (!need_bits(stream, bits + extra))
+					return EOK;
+
+				drop_bits(state, bits);
+				unsigned rep = get_bits(state, extra) + base;
+
+				if (state->have + rep >
+				    state->nlen + state->ndist)
+					return EINVAL;
+
+				while (rep > 0) {
+					state->lengths[state->have] = rep_len;
+					state->have++;
+					rep--;
+				}
+			}
+
+			rc = inflate_dynamic_tables(state);
+			if (rc != EOK)
+				return rc;
+
+			state->mode = MODE_LEN;
+			break;
+		case MODE_LEN:
+			rc = huffman_peek(stream, state->len_table,
+			    LEN_ROOT_BITS, &entry, &bits);
+			if (rc == ELIMIT)
+				return EOK;
+			if (rc != EOK)
+				return rc;
+
+			symbol = ENTRY_VALUE(entry);
+
+			/* Literals need output space */
+			if ((symbol < 256) && (stream->avail_out == 0))
+				return EOK;
+
+			drop_bits(state, bits);
+
+			if (symbol < 256) {
+				/* Write out literal */
+				*stream->next_out++ = (uint8_t) symbol;
+				stream->avail_out--;
+				break;
+			}
+
+			if (symbol == 256) {
+				/* End of block */
+				state->mode = state->last ? MODE_DONE :
+				    MODE_HEADER;
+				break;
+			}
 
-			state->dest[state->destcnt] = (uint8_t) symbol;
-			state->destcnt++;
-		} else if (symbol > 256) {
 			/* Compute length */
 			symbol -= 257;
-			if (symbol >= 29)
+			if (symbol >= MAX_LEN)
 				return EINVAL;
 
-			size_t len = lens[symbol] + get_bits(state, lens_ext[symbol]);
-			CHECK_OVERRUN(*state);
+			state->length = lens[symbol];
+			state->extra = lens_ext[symbol];
+			state->mode = MODE_LENEXT;
+			break;
+		case MODE_LENEXT:
+			if (!need_bits(stream, state->extra))
+				return EOK;
 
+			state->length += get_bits(state, state->extra);
+			state->mode = MODE_DIST;
+			break;
+		case MODE_DIST:
 			/* Get distance */
-			err = huffman_decode(state, dist_code, &symbol);
-			if (err != EOK)
-				return err;
+			rc = huffman_decode(stream, state->dist_table,
+			    DIST_ROOT_BITS, &symbol);
+			if (rc == ELIMIT)
+				return EOK;
+			if (rc != EOK)
+				return rc;
+
+			if (symbol >= MAX_DIST)
+				return EINVAL;
+
+			state->dist = dists[symbol];
+			state->extra = dists_ext[symbol];
+			state->mode = MODE_DISTEXT;
+			break;
+		case MODE_DISTEXT:
+			if (!need_bits(stream, state->extra))
+				return EOK;
 
-			size_t dist = dists[symbol] + get_bits(state, dists_ext[symbol]);
-			if (dist > state->destcnt)
+			state->dist += get_bits(state, state->extra);
+			if (state->dist >
+			    state->whave + (size_t) (stream->next_out - out_start))
 				return ENOENT;
 
-			if (state->destcnt + len > state->destlen)
-				return ENOMEM;
+			state->mode = MODE_MATCH;
+			break;
+		case MODE_MATCH:
+			/* Copy length bytes from distance bytes back */
+			inflate_copy_match(stream, out_start);
+			if (state->length > 0)
+				return EOK;
 
-			while (len > 0) {
-				/* Copy len bytes from distance bytes back */
-				state->dest[state->destcnt] =
-				    state->dest[state->destcnt - dist];
-				state->destcnt++;
-				len--;
-			}
+			state->mode = MODE_LEN;
+			break;
+		case MODE_DONE:
+			stream->done = true;
+			return EOK;
+		case MODE_BAD:
+			return state->error;
 		}
-	} while (symbol != 256);
+	}
+}
 
+/** Initialize inflate stream
+ *
+ * @param stream Inflate stream.
+ *
+ * @return EOK on success.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t inflate_init(inflate_stream_t *stream)
+{
+	stream->state = malloc(sizeof(struct inflate_state));
+	if (stream->state == NULL)
+		return ENOMEM;
+
+	inflate_reset(stream);
 	return EOK;
 }
 
-/** Decode `fixed codes' block
+/** Reset inflate stream to decode a new deflate stream
  *
- * @param state     Inflate state.
- * @param len_code  Huffman code for literal/length.
- * @param dist_code Huffman code for distance.
+ * The input and output buffers are left intact.
  *
- * @return EOK on success.
- * @return ENOENT on distance too large.
- * @return EINVAL on invalid Huffman code.
- * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
+ * @param stream Initialized inflate stream.
  *
  */
-static errno_t inflate_fixed(inflate_state_t *state, huffman_t *len_code,
-    huffman_t *dist_code)
+void inflate_reset(inflate_stream_t *stream)
 {
-	return inflate_codes(state, len_code, dist_code);
+	struct inflate_state *state = stream->state;
+
+	stream->total_in = 0;
+	stream->total_out = 0;
+	stream->done = false;
+
+	state->mode = MODE_HEADER;
+	state->last = false;
+	state->error = EOK;
+	state->hold = 0;
+	state->bits = 0;
+	state->wnext = 0;
+	state->whave = 0;
 }
 
-/** Decode `dynamic codes' block
+/** Decompress as much data as possible
  *
- * @param state     Inflate state.
+ * Decoding stops when the input is exhausted, the output buffer is full
+ * or the final block is decoded (stream->done is set). Bits following
+ * the final block up to the byte boundary are discarded, the following
+ * input bytes are not consumed.
  *
- * @return EOK on success.
+ * @param stream Inflate stream.
+ *
+ * @return EOK on success (including the need for more input or output).
  * @return ENOENT on distance too large.
- * @return EINVAL on invalid Huffman code.
- * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
+ * @return EINVAL on invalid Huffman code or invalid deflate data.
  *
  */
-static errno_t inflate_dynamic(inflate_state_t *state)
+errno_t inflate_step(inflate_stream_t *stream)
 {
-	uint16_t length[MAX_CODE];
-	uint16_t dyn_len_count[MAX_HUFFMAN_BIT + 1];
-	uint16_t dyn_len_symbol[MAX_LITLEN];
-	uint16_t dyn_dist_count[MAX_HUFFMAN_BIT + 1];
-	uint16_t dyn_dist_symbol[MAX_DIST];
-	huffman_t dyn_len_code;
-	huffman_t dyn_dist_code;
-
-	dyn_len_code.count = dyn_len_count;
-	dyn_len_code.symbol = dyn_len_symbol;
-
-	dyn_dist_code.count = dyn_dist_count;
-	dyn_dist_code.symbol = dyn_dist_symbol;
+	struct inflate_state *state = stream->state;
+	uint8_t *out_start = stream->next_out;
 
-	/* Get number of bits in each table */
-	uint16_t nlen = get_bits(state, 5) + 257;
-	CHECK_OVERRUN(*state);
-
-	uint16_t ndist = get_bits(state, 5) + 1;
-	CHECK_OVERRUN(*state);
-
-	uint16_t ncode = get_bits(state, 4) + 4;
-	CHECK_OVERRUN(*state);
-
-	if ((nlen > MAX_LITLEN) || (ndist > MAX_DIST) ||
-	    (ncode > MAX_ORDER))
-		return EINVAL;
-
-	/* Read code length code lengths */
-	uint16_t index;
-	for (index = 0; index < ncode; index++) {
-		length[order[index]] = get_bits(state, 3);
-		CHECK_OVERRUN(*state);
+	errno_t ret = inflate_run(stream, out_start);
+	if (ret != EOK) {
+		state->mode = MODE_BAD;
+		state->error = ret;
 	}
 
-	/* Set missing lengths to zero */
-	for (index = ncode; index < MAX_ORDER; index++)
-		length[order[index]] = 0;
-
-	/* Build Huffman code */
-	int16_t rc = huffman_construct(&dyn_len_code, length, MAX_ORDER);
-	if (rc != 0)
-		return EINVAL;
-
-	/* Read length/literal and distance code length tables */
-	index = 0;
-	while (index < nlen + ndist) {
-		uint16_t symbol;
-		errno_t err = huffman_decode(state, &dyn_len_code, &symbol);
-		if (err != EOK)
-			return EOK;
-
-		if (symbol < 16) {
-			length[index] = symbol;
-			index++;
-		} else {
-			uint16_t len = 0;
-
-			if (symbol == 16) {
-				if (index == 0)
-					return EINVAL;
-
-				len = length[index - 1];
-				symbol = get_bits(state, 2) + 3;
-				CHECK_OVERRUN(*state);
-			} else if (symbol == 17) {
-				symbol = get_bits(state, 3) + 3;
-				CHECK_OVERRUN(*state);
-			} else {
-				symbol = get_bits(state, 7) + 11;
-				CHECK_OVERRUN(*state);
-			}
-
-			if (index + symbol > nlen + ndist)
-				return EINVAL;
+	const size_t produced = stream->next_out - out_start;
+	inflate_update_window(state, out_start, produced);
+	stream->total_out += produced;
 
-			while (symbol > 0) {
-				length[index] = len;
-				index++;
-				symbol--;
-			}
-		}
+	if (stream->done) {
+		/* Discard the padding of the final byte */
+		drop_bits(state, state->bits & 7);
 	}
 
-	/* Check for end-of-block code */
-	if (length[256] == 0)
-		return EINVAL;
-
-	/* Build Huffman tables for literal/length codes */
-	rc = huffman_construct(&dyn_len_code, length, nlen);
-	if ((rc < 0) || ((rc > 0) && (dyn_len_code.count[0] + 1 != nlen)))
-		return EINVAL;
-
-	/* Build Huffman tables for distance codes */
-	rc = huffman_construct(&dyn_dist_code, length + nlen, ndist);
-	if ((rc < 0) || ((rc > 0) && (dyn_dist_code.count[0] + 1 != ndist)))
-		return EINVAL;
+	return ret;
+}
 
-	return inflate_codes(state, &dyn_len_code, &dyn_dist_code);
+/** Release inflate stream resources
+ *
+ * @param stream Inflate stream.
+ *
+ */
+void inflate_end(inflate_stream_t *stream)
+{
+	free(stream->state);
+	stream->state = NULL;
 }
 
 /** Inflate data
@@ -622,53 +1087,26 @@ static errno_t inflate_dynamic(inflate_state_t *state)
  * @return ENOENT on distance too large.
  * @return EINVAL on invalid Huffman code or invalid deflate data.
  * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
+ * @return ENOMEM on output buffer overrun or if out of memory.
  *
  */
 errno_t inflate(void *src, size_t srclen, void *dest, size_t destlen)
 {
-	/* Initialize the state */
-	inflate_state_t state;
-
-	state.dest = (uint8_t *) dest;
-	state.destlen = destlen;
-	state.destcnt = 0;
+	inflate_stream_t stream;
 
-	state.src = (uint8_t *) src;
-	state.srclen = srclen;
-	state.srccnt = 0;
+	errno_t ret = inflate_init(&stream);
+	if (ret != EOK)
+		return ret;
 
-	state.bitbuf = 0;
-	state.bitlen = 0;
+	stream.next_in = (const uint8_t *) src;
+	stream.avail_in = srclen;
+	stream.next_out = (uint8_t *) dest;
+	stream.avail_out = destlen;
 
-	state.overrun = false;
-
-	uint16_t last;
-	errno_t ret = EOK;
-
-	do {
-		/* Last block is indicated by a non-zero bit */
-		last = get_bits(&state, 1);
-		CHECK_OVERRUN(state);
-
-		/* Block type */
-		uint16_t type = get_bits(&state, 2);
-		CHECK_OVERRUN(state);
-
-		switch (type) {
-		case 0:
-			ret = inflate_stored(&state);
-			break;
-		case 1:
-			ret = inflate_fixed(&state, &len_code, &dist_code);
-			break;
-		case 2:
-			ret = inflate_dynamic(&state);
-			break;
-		default:
-			ret = EINVAL;
-		}
-	} while ((!last) && (ret == 0));
+	ret = inflate_step(&stream);
+	if ((ret == EOK) && (!stream.done))
+		ret = (stream.avail_out == 0) ? ENOMEM : ELIMIT;
 
+	inflate_end(&stream);
 	return ret;
 }
@@ -29,7 +29,42 @@
 #ifndef LIBCOMPRESS_INFLATE_H_
 #define LIBCOMPRESS_INFLATE_H_
 
+#include <errno.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/** Size of the inflate sliding window */
+#define INFLATE_WINDOW_SIZE  32768
+
+struct inflate_state;
+
+/** Incremental inflate stream
+ *
+ * The caller provides input and output space by setting next_in/avail_in
+ * and next_out/avail_out and calls inflate_step() repeatedly. Both
+ * pointers and counters are advanced by the amount of data consumed
+ * and produced.
+ *
+ */
+typedef struct {
+	const uint8_t *next_in;  /**< Next input byte */
+	size_t avail_in;         /**< Number of bytes available at next_in */
+	uint64_t total_in;       /**< Total number of input bytes consumed */
+
+	uint8_t *next_out;       /**< Next output byte */
+	size_t avail_out;        /**< Remaining free space at next_out */
+	uint64_t total_out;      /**< Total number of bytes output */
+
+	bool done;               /**< Final block has been decoded */
+
+	struct inflate_state *state;  /**< Internal state */
+} inflate_stream_t;
+
+extern errno_t inflate_init(inflate_stream_t *);
+extern errno_t inflate_step(inflate_stream_t *);
+extern void inflate_reset(inflate_stream_t *);
+extern void inflate_end(inflate_stream_t *);
 
 extern errno_t inflate(void *, size_t, void *, size_t);
 
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <deflate.h>
+#include <inflate.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(deflate);
+
+#define DATA_SIZE  200000
+
+static uint8_t *data;
+static uint8_t *deflated;
+static uint8_t *inflated;
+
+/** Fill buffer with compressible data followed by random data */
+static void fill_data(uint8_t *buf, size_t size)
+{
+	uint32_t seed = 42;
+
+	for (size_t i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+
+		if (i < size / 2)
+			buf[i] = "abcdefgh"[(seed >> 16) % 8];
+		else
+			buf[i] = seed >> 16;
+	}
+}
+
+/** Compress data with the one-shot interface and check round trip */
+static void round_trip(size_t size, int level)
+{
+	size_t dsize;
+
+	errno_t rc = deflate(data, size, deflated, deflate_bound(size),
+	    &dsize, level);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(dsize <= deflate_bound(size));
+
+	rc = inflate(deflated, dsize, inflated, size);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, inflated, size));
+}
+
+PCUT_TEST_BEFORE
+{
+	data = malloc(DATA_SIZE);
+	PCUT_ASSERT_NOT_NULL(data);
+
+	deflated = malloc(deflate_bound(DATA_SIZE));
+	PCUT_ASSERT_NOT_NULL(deflated);
+
+	inflated = malloc(DATA_SIZE);
+	PCUT_ASSERT_NOT_NULL(inflated);
+
+	fill_data(data, DATA_SIZE);
+}
+
+PCUT_TEST_AFTER
+{
+	free(data);
+	free(deflated);
+	free(inflated);
+}
+
+/** All compression levels produce data the inflater accepts */
+PCUT_TEST(levels)
+{
+	for (int level = DEFLATE_LEVEL_MIN; level <= DEFLATE_LEVEL_MAX; level++)
+		round_trip(DATA_SIZE, level);
+}
+
+/** Empty and very short inputs */
+PCUT_TEST(short_input)
+{
+	for (size_t size = 0; size < 8; size++)
+		round_trip(size, DEFLATE_LEVEL_DEFAULT);
+}
+
+/** Repetitive data compresses well */
+PCUT_TEST(ratio)
+{
+	size_t dsize;
+
+	memset(data, 'x', DATA_SIZE);
+
+	errno_t rc = deflate(data, DATA_SIZE, deflated,
+	    deflate_bound(DATA_SIZE), &dsize, DEFLATE_LEVEL_DEFAULT);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(dsize < DATA_SIZE / 100);
+
+	rc = inflate(deflated, dsize, inflated, DATA_SIZE);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, inflated, DATA_SIZE));
+}
+
+/** Invalid compression level is rejected */
+PCUT_TEST(invalid_level)
+{
+	deflate_stream_t stream;
+	size_t dsize;
+
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, deflate_init(&stream, 0));
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, deflate(data, DATA_SIZE, deflated,
+	    deflate_bound(DATA_SIZE), &dsize, DEFLATE_LEVEL_MAX + 1));
+}
+
+/** Too small output buffer is reported */
+PCUT_TEST(output_overrun)
+{
+	size_t dsize;
+
+	errno_t rc = deflate(data, DATA_SIZE, deflated, 100, &dsize,
+	    DEFLATE_LEVEL_DEFAULT);
+	PCUT_ASSERT_ERRNO_VAL(ENOMEM, rc);
+}
+
+/** Streaming compression with small buffers on both sides */
+PCUT_TEST(streaming)
+{
+	deflate_stream_t dstream;
+	inflate_stream_t istream;
+	uint8_t out[7];
+	size_t in_pos = 0;
+	size_t out_pos = 0;
+
+	errno_t rc = deflate_init(&dstream, DEFLATE_LEVEL_DEFAULT);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	while (!dstream.done) {
+		size_t cnt = (in_pos + 1000 <= DATA_SIZE) ? 1000 :
+		    DATA_SIZE - in_pos;
+
+		dstream.next_in = data + in_pos;
+		dstream.avail_in = cnt;
+		dstream.next_out = out;
+		dstream.avail_out = sizeof(out);
+
+		rc = deflate_step(&dstream, in_pos + cnt == DATA_SIZE);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+		in_pos += cnt - dstream.avail_in;
+		memcpy(deflated + out_pos, out, sizeof(out) - dstream.avail_out);
+		out_pos += sizeof(out) - dstream.avail_out;
+	}
+
+	PCUT_ASSERT_INT_EQUALS(DATA_SIZE, dstream.total_in);
+	PCUT_ASSERT_INT_EQUALS(out_pos, dstream.total_out);
+	deflate_end(&dstream);
+
+	rc = inflate_init(&istream);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	istream.next_in = deflated;
+	istream.avail_in = out_pos;
+	istream.next_out = inflated;
+	istream.avail_out = DATA_SIZE;
+
+	rc = inflate_step(&istream);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(istream.done);
+	PCUT_ASSERT_INT_EQUALS(DATA_SIZE, istream.total_out);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, inflated, DATA_SIZE));
+
+	inflate_end(&istream);
+}
+
+PCUT_EXPORT(deflate);
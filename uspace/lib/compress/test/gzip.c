@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <deflate.h>
+#include <gzip.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(gzip);
+
+#define DATA_SIZE  100000
+#define BUFFER_SIZE  (2 * DATA_SIZE)
+
+/** In-memory stream used by the reader and writer callbacks */
+typedef struct {
+	uint8_t *buf;
+	size_t size;
+	size_t pos;
+	size_t chunk;
+} test_stream_t;
+
+static uint8_t *data;
+
+static errno_t test_write(void *arg, const void *buf, size_t size)
+{
+	test_stream_t *stream = (test_stream_t *) arg;
+
+	if (stream->size + size > BUFFER_SIZE)
+		return ENOMEM;
+
+	memcpy(stream->buf + stream->size, buf, size);
+	stream->size += size;
+	return EOK;
+}
+
+static errno_t test_read(void *arg, void *buf, size_t size, size_t *nread)
+{
+	test_stream_t *stream = (test_stream_t *) arg;
+	size_t cnt = stream->size - stream->pos;
+
+	if (cnt > size)
+		cnt = size;
+
+	if (cnt > stream->chunk)
+		cnt = stream->chunk;
+
+	memcpy(buf, stream->buf + stream->pos, cnt);
+	stream->pos += cnt;
+	*nread = cnt;
+	return EOK;
+}
+
+PCUT_TEST_BEFORE
+{
+	uint32_t seed = 1;
+
+	data = malloc(DATA_SIZE);
+	PCUT_ASSERT_NOT_NULL(data);
+
+	for (size_t i = 0; i < DATA_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = "HelenOS "[(seed >> 16) % 8];
+	}
+}
+
+PCUT_TEST_AFTER
+{
+	free(data);
+}
+
+/** One-shot compression and expansion */
+PCUT_TEST(compress_expand)
+{
+	void *gz;
+	size_t gz_size;
+	void *out;
+	size_t out_size;
+
+	errno_t rc = gzip_compress(data, DATA_SIZE, DEFLATE_LEVEL_DEFAULT,
+	    &gz, &gz_size);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(gz_size < DATA_SIZE);
+
+	rc = gzip_expand(gz, gz_size, &out, &out_size);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(DATA_SIZE, out_size);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, out, DATA_SIZE));
+	free(out);
+
+	/* Corrupt the CRC32 in the footer */
+	((uint8_t *) gz)[gz_size - 8] ^= 1;
+	rc = gzip_expand(gz, gz_size, &out, &out_size);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+
+	free(gz);
+}
+
+/** Streaming writer output read back by the streaming reader */
+PCUT_TEST(writer_reader)
+{
+	test_stream_t stream;
+	gzip_writer_t *writer;
+	gzip_reader_t *reader;
+	uint8_t *out;
+	size_t nread;
+
+	stream.buf = malloc(BUFFER_SIZE);
+	PCUT_ASSERT_NOT_NULL(stream.buf);
+	stream.size = 0;
+	stream.pos = 0;
+	stream.chunk = 333;
+
+	out = malloc(DATA_SIZE);
+	PCUT_ASSERT_NOT_NULL(out);
+
+	errno_t rc = gzip_writer_create(test_write, &stream,
+	    DEFLATE_LEVEL_MAX, &writer);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	for (size_t pos = 0; pos < DATA_SIZE; pos += 1000) {
+		rc = gzip_writer_write(writer, data + pos, 1000);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	}
+
+	rc = gzip_writer_finish(writer);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	gzip_writer_destroy(writer);
+
+	rc = gzip_reader_create(test_read, &stream, &reader);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	size_t total = 0;
+	do {
+		rc = gzip_reader_read(reader, out + total,
+		    DATA_SIZE - total, &nread);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		total += nread;
+	} while ((nread > 0) && (total < DATA_SIZE));
+
+	PCUT_ASSERT_INT_EQUALS(DATA_SIZE, total);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, out, DATA_SIZE));
+
+	rc = gzip_reader_read(reader, out, DATA_SIZE, &nread);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, nread);
+
+	gzip_reader_destroy(reader);
+	free(out);
+	free(stream.buf);
+}
+
+PCUT_EXPORT(gzip);
@@ -28,34 +28,33 @@
 
 /** @file aes.c
  *
- * Implementation of AES-128 symmetric cipher cryptographic algorithm.
+ * Implementation of AES symmetric cipher cryptographic algorithm
+ * and its block cipher modes of operation.
  *
- * Based on FIPS 197.
+ * Based on FIPS 197 (AES), NIST SP 800-38A (CBC, CTR),
+ * NIST SP 800-38C (CCM) and NIST SP 800-38D (GCM).
+ *
+ * The key schedule is expanded once into an AES context. Blocks are
+ * processed either using the AES-NI instructions (if the processor
+ * supports them) or using table lookups combining the sub_bytes,
+ * shift_rows and mix_columns transformations of a round.
  */
 
 #include <stdbool.h>
 #include <errno.h>
+#include <macros.h>
 #include <mem.h>
 #include "crypto.h"
+#include "cpu.h"
 
 /* Number of elements in rows/columns in AES arrays. */
 #define ELEMS  4
 
-/* Number of elements (words) in cipher. */
-#define CIPHER_ELEMS  4
-
 /* Length of AES block. */
 #define BLOCK_LEN  16
 
-/* Number of iterations in AES algorithm. */
-#define ROUNDS  10
-
-/** Irreducible polynomial used in AES algorithm.
- *
- * NOTE: x^8 + x^4 + x^3 + x + 1.
- *
- */
-#define AES_IP  0x1b
+/* Length of GHASH multiplication tables. */
+#define GHASH_TABLE_LEN  16
 
 /** Precomputed values for AES sub_byte transformation. */
 static const uint8_t sbox[BLOCK_LEN][BLOCK_LEN] = {
@@ -126,7 +125,7 @@ static const uint8_t sbox[BLOCK_LEN][BLOCK_LEN] = {
 };
 
 /** Precomputed values for AES inv_sub_byte transformation. */
-static uint8_t inv_sbox[BLOCK_LEN][BLOCK_LEN] = {
+static const uint8_t inv_sbox[BLOCK_LEN][BLOCK_LEN] = {
 	{
 		0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38,
 		0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb
@@ -200,254 +199,1217 @@ static const uint32_t r_con_array[] = {
 	0x1b000000, 0x36000000
 };
 
-/** Perform substitution transformation on given byte.
+/** Combined sub_bytes and mix_columns transformation table.
  *
- * @param byte Input byte.
- * @param inv  Flag indicating whether to use inverse table.
+ * Entry for byte x holds column (2 * S(x), S(x), S(x), 3 * S(x)),
+ * the tables for other rows are its byte rotations.
  *
- * @return Substituted value.
+ */
+static const uint32_t te0[256] = {
+	0xc66363a5, 0xf87c7c84, 0xee777799, 0xf67b7b8d,
+	0xfff2f20d, 0xd66b6bbd, 0xde6f6fb1, 0x91c5c554,
+	0x60303050, 0x02010103, 0xce6767a9, 0x562b2b7d,
+	0xe7fefe19, 0xb5d7d762, 0x4dababe6, 0xec76769a,
+	0x8fcaca45, 0x1f82829d, 0x89c9c940, 0xfa7d7d87,
+	0xeffafa15, 0xb25959eb, 0x8e4747c9, 0xfbf0f00b,
+	0x41adadec, 0xb3d4d467, 0x5fa2a2fd, 0x45afafea,
+	0x239c9cbf, 0x53a4a4f7, 0xe4727296, 0x9bc0c05b,
+	0x75b7b7c2, 0xe1fdfd1c, 0x3d9393ae, 0x4c26266a,
+	0x6c36365a, 0x7e3f3f41, 0xf5f7f702, 0x83cccc4f,
+	0x6834345c, 0x51a5a5f4, 0xd1e5e534, 0xf9f1f108,
+	0xe2717193, 0xabd8d873, 0x62313153, 0x2a15153f,
+	0x0804040c, 0x95c7c752, 0x46232365, 0x9dc3c35e,
+	0x30181828, 0x379696a1, 0x0a05050f, 0x2f9a9ab5,
+	0x0e070709, 0x24121236, 0x1b80809b, 0xdfe2e23d,
+	0xcdebeb26, 0x4e272769, 0x7fb2b2cd, 0xea75759f,
+	0x1209091b, 0x1d83839e, 0x582c2c74, 0x341a1a2e,
+	0x361b1b2d, 0xdc6e6eb2, 0xb45a5aee, 0x5ba0a0fb,
+	0xa45252f6, 0x763b3b4d, 0xb7d6d661, 0x7db3b3ce,
+	0x5229297b, 0xdde3e33e, 0x5e2f2f71, 0x13848497,
+	0xa65353f5, 0xb9d1d168, 0x00000000, 0xc1eded2c,
+	0x40202060, 0xe3fcfc1f, 0x79b1b1c8, 0xb65b5bed,
+	0xd46a6abe, 0x8dcbcb46, 0x67bebed9, 0x7239394b,
+	0x944a4ade, 0x984c4cd4, 0xb05858e8, 0x85cfcf4a,
+	0xbbd0d06b, 0xc5efef2a, 0x4faaaae5, 0xedfbfb16,
+	0x864343c5, 0x9a4d4dd7, 0x66333355, 0x11858594,
+	0x8a4545cf, 0xe9f9f910, 0x04020206, 0xfe7f7f81,
+	0xa05050f0, 0x783c3c44, 0x259f9fba, 0x4ba8a8e3,
+	0xa25151f3, 0x5da3a3fe, 0x804040c0, 0x058f8f8a,
+	0x3f9292ad, 0x219d9dbc, 0x70383848, 0xf1f5f504,
+	0x63bcbcdf, 0x77b6b6c1, 0xafdada75, 0x42212163,
+	0x20101030, 0xe5ffff1a, 0xfdf3f30e, 0xbfd2d26d,
+	0x81cdcd4c, 0x180c0c14, 0x26131335, 0xc3ecec2f,
+	0xbe5f5fe1, 0x359797a2, 0x884444cc, 0x2e171739,
+	0x93c4c457, 0x55a7a7f2, 0xfc7e7e82, 0x7a3d3d47,
+	0xc86464ac, 0xba5d5de7, 0x3219192b, 0xe6737395,
+	0xc06060a0, 0x19818198, 0x9e4f4fd1, 0xa3dcdc7f,
+	0x44222266, 0x542a2a7e, 0x3b9090ab, 0x0b888883,
+	0x8c4646ca, 0xc7eeee29, 0x6bb8b8d3, 0x2814143c,
+	0xa7dede79, 0xbc5e5ee2, 0x160b0b1d, 0xaddbdb76,
+	0xdbe0e03b, 0x64323256, 0x743a3a4e, 0x140a0a1e,
+	0x924949db, 0x0c06060a, 0x4824246c, 0xb85c5ce4,
+	0x9fc2c25d, 0xbdd3d36e, 0x43acacef, 0xc46262a6,
+	0x399191a8, 0x319595a4, 0xd3e4e437, 0xf279798b,
+	0xd5e7e732, 0x8bc8c843, 0x6e373759, 0xda6d6db7,
+	0x018d8d8c, 0xb1d5d564, 0x9c4e4ed2, 0x49a9a9e0,
+	0xd86c6cb4, 0xac5656fa, 0xf3f4f407, 0xcfeaea25,
+	0xca6565af, 0xf47a7a8e, 0x47aeaee9, 0x10080818,
+	0x6fbabad5, 0xf0787888, 0x4a25256f, 0x5c2e2e72,
+	0x381c1c24, 0x57a6a6f1, 0x73b4b4c7, 0x97c6c651,
+	0xcbe8e823, 0xa1dddd7c, 0xe874749c, 0x3e1f1f21,
+	0x964b4bdd, 0x61bdbddc, 0x0d8b8b86, 0x0f8a8a85,
+	0xe0707090, 0x7c3e3e42, 0x71b5b5c4, 0xcc6666aa,
+	0x904848d8, 0x06030305, 0xf7f6f601, 0x1c0e0e12,
+	0xc26161a3, 0x6a35355f, 0xae5757f9, 0x69b9b9d0,
+	0x17868691, 0x99c1c158, 0x3a1d1d27, 0x279e9eb9,
+	0xd9e1e138, 0xebf8f813, 0x2b9898b3, 0x22111133,
+	0xd26969bb, 0xa9d9d970, 0x078e8e89, 0x339494a7,
+	0x2d9b9bb6, 0x3c1e1e22, 0x15878792, 0xc9e9e920,
+	0x87cece49, 0xaa5555ff, 0x50282878, 0xa5dfdf7a,
+	0x038c8c8f, 0x59a1a1f8, 0x09898980, 0x1a0d0d17,
+	0x65bfbfda, 0xd7e6e631, 0x844242c6, 0xd06868b8,
+	0x824141c3, 0x299999b0, 0x5a2d2d77, 0x1e0f0f11,
+	0x7bb0b0cb, 0xa85454fc, 0x6dbbbbd6, 0x2c16163a
+};
+
+/** Combined inverse sub_bytes and mix_columns transformation table.
+ *
+ * Entry for byte x holds column (14 * S'(x), 9 * S'(x), 13 * S'(x),
+ * 11 * S'(x)), the tables for other rows are its byte rotations.
  *
  */
-static uint8_t sub_byte(uint8_t byte, bool inv)
+static const uint32_t td0[256] = {
+	0x51f4a750, 0x7e416553, 0x1a17a4c3, 0x3a275e96,
+	0x3bab6bcb, 0x1f9d45f1, 0xacfa58ab, 0x4be30393,
+	0x2030fa55, 0xad766df6, 0x88cc7691, 0xf5024c25,
+	0x4fe5d7fc, 0xc52acbd7, 0x26354480, 0xb562a38f,
+	0xdeb15a49, 0x25ba1b67, 0x45ea0e98, 0x5dfec0e1,
+	0xc32f7502, 0x814cf012, 0x8d4697a3, 0x6bd3f9c6,
+	0x038f5fe7, 0x15929c95, 0xbf6d7aeb, 0x955259da,
+	0xd4be832d, 0x587421d3, 0x49e06929, 0x8ec9c844,
+	0x75c2896a, 0xf48e7978, 0x99583e6b, 0x27b971dd,
+	0xbee14fb6, 0xf088ad17, 0xc920ac66, 0x7dce3ab4,
+	0x63df4a18, 0xe51a3182, 0x97513360, 0x62537f45,
+	0xb16477e0, 0xbb6bae84, 0xfe81a01c, 0xf9082b94,
+	0x70486858, 0x8f45fd19, 0x94de6c87, 0x527bf8b7,
+	0xab73d323, 0x724b02e2, 0xe31f8f57, 0x6655ab2a,
+	0xb2eb2807, 0x2fb5c203, 0x86c57b9a, 0xd33708a5,
+	0x302887f2, 0x23bfa5b2, 0x02036aba, 0xed16825c,
+	0x8acf1c2b, 0xa779b492, 0xf307f2f0, 0x4e69e2a1,
+	0x65daf4cd, 0x0605bed5, 0xd134621f, 0xc4a6fe8a,
+	0x342e539d, 0xa2f355a0, 0x058ae132, 0xa4f6eb75,
+	0x0b83ec39, 0x4060efaa, 0x5e719f06, 0xbd6e1051,
+	0x3e218af9, 0x96dd063d, 0xdd3e05ae, 0x4de6bd46,
+	0x91548db5, 0x71c45d05, 0x0406d46f, 0x605015ff,
+	0x1998fb24, 0xd6bde997, 0x894043cc, 0x67d99e77,
+	0xb0e842bd, 0x07898b88, 0xe7195b38, 0x79c8eedb,
+	0xa17c0a47, 0x7c420fe9, 0xf8841ec9, 0x00000000,
+	0x09808683, 0x322bed48, 0x1e1170ac, 0x6c5a724e,
+	0xfd0efffb, 0x0f853856, 0x3daed51e, 0x362d3927,
+	0x0a0fd964, 0x685ca621, 0x9b5b54d1, 0x24362e3a,
+	0x0c0a67b1, 0x9357e70f, 0xb4ee96d2, 0x1b9b919e,
+	0x80c0c54f, 0x61dc20a2, 0x5a774b69, 0x1c121a16,
+	0xe293ba0a, 0xc0a02ae5, 0x3c22e043, 0x121b171d,
+	0x0e090d0b, 0xf28bc7ad, 0x2db6a8b9, 0x141ea9c8,
+	0x57f11985, 0xaf75074c, 0xee99ddbb, 0xa37f60fd,
+	0xf701269f, 0x5c72f5bc, 0x44663bc5, 0x5bfb7e34,
+	0x8b432976, 0xcb23c6dc, 0xb6edfc68, 0xb8e4f163,
+	0xd731dcca, 0x42638510, 0x13972240, 0x84c61120,
+	0x854a247d, 0xd2bb3df8, 0xaef93211, 0xc729a16d,
+	0x1d9e2f4b, 0xdcb230f3, 0x0d8652ec, 0x77c1e3d0,
+	0x2bb3166c, 0xa970b999, 0x119448fa, 0x47e96422,
+	0xa8fc8cc4, 0xa0f03f1a, 0x567d2cd8, 0x223390ef,
+	0x87494ec7, 0xd938d1c1, 0x8ccaa2fe, 0x98d40b36,
+	0xa6f581cf, 0xa57ade28, 0xdab78e26, 0x3fadbfa4,
+	0x2c3a9de4, 0x5078920d, 0x6a5fcc9b, 0x547e4662,
+	0xf68d13c2, 0x90d8b8e8, 0x2e39f75e, 0x82c3aff5,
+	0x9f5d80be, 0x69d0937c, 0x6fd52da9, 0xcf2512b3,
+	0xc8ac993b, 0x10187da7, 0xe89c636e, 0xdb3bbb7b,
+	0xcd267809, 0x6e5918f4, 0xec9ab701, 0x834f9aa8,
+	0xe6956e65, 0xaaffe67e, 0x21bccf08, 0xef15e8e6,
+	0xbae79bd9, 0x4a6f36ce, 0xea9f09d4, 0x29b07cd6,
+	0x31a4b2af, 0x2a3f2331, 0xc6a59430, 0x35a266c0,
+	0x744ebc37, 0xfc82caa6, 0xe090d0b0, 0x33a7d815,
+	0xf104984a, 0x41ecdaf7, 0x7fcd500e, 0x1791f62f,
+	0x764dd68d, 0x43efb04d, 0xccaa4d54, 0xe49604df,
+	0x9ed1b5e3, 0x4c6a881b, 0xc12c1fb8, 0x4665517f,
+	0x9d5eea04, 0x018c355d, 0xfa877473, 0xfb0b412e,
+	0xb3671d5a, 0x92dbd252, 0xe9105633, 0x6dd64713,
+	0x9ad7618c, 0x37a10c7a, 0x59f8148e, 0xeb133c89,
+	0xcea927ee, 0xb761c935, 0xe11ce5ed, 0x7a47b13c,
+	0x9cd2df59, 0x55f2733f, 0x1814ce79, 0x73c737bf,
+	0x53f7cdea, 0x5ffdaa5b, 0xdf3d6f14, 0x7844db86,
+	0xcaaff381, 0xb968c43e, 0x3824342c, 0xc2a3405f,
+	0x161dc372, 0xbce2250c, 0x283c498b, 0xff0d9541,
+	0x39a80171, 0x080cb3de, 0xd8b4e49c, 0x6456c190,
+	0x7bcb8461, 0xd532b670, 0x486c5c74, 0xd0b85742
+};
+
+/** Reduction values for the GHASH multiplication (4 bits at a time). */
+static const uint64_t ghash_last4[GHASH_TABLE_LEN] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+#define SBOX(byte)      ((uint32_t) sbox[(byte) >> 4][(byte) & 0xf])
+#define INV_SBOX(byte)  ((uint32_t) inv_sbox[(byte) >> 4][(byte) & 0xf])
+
+#define TE0(byte)  (te0[(byte)])
+#define TE1(byte)  (rotr_uint32(te0[(byte)], 8))
+#define TE2(byte)  (rotr_uint32(te0[(byte)], 16))
+#define TE3(byte)  (rotr_uint32(te0[(byte)], 24))
+
+#define TD0(byte)  (td0[(byte)])
+#define TD1(byte)  (rotr_uint32(td0[(byte)], 8))
+#define TD2(byte)  (rotr_uint32(td0[(byte)], 16))
+#define TD3(byte)  (rotr_uint32(td0[(byte)], 24))
+
+#define BYTE0(word)  ((word) >> 24)
+#define BYTE1(word)  (((word) >> 16) & 0xff)
+#define BYTE2(word)  (((word) >> 8) & 0xff)
+#define BYTE3(word)  ((word) & 0xff)
+
+/** Load big-endian word.
+ *
+ * @param data Input data.
+ *
+ * @return Loaded word.
+ *
+ */
+static inline uint32_t load_word(const uint8_t *data)
 {
-	uint8_t i = byte >> 4;
-	uint8_t j = byte & 0xF;
+	return ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) |
+	    ((uint32_t) data[2] << 8) | ((uint32_t) data[3]);
+}
 
-	if (!inv)
-		return sbox[i][j];
+/** Store big-endian word.
+ *
+ * @param data Output data.
+ * @param word Word to be stored.
+ *
+ */
+static inline void store_word(uint8_t *data, uint32_t word)
+{
+	data[0] = word >> 24;
+	data[1] = word >> 16;
+	data[2] = word >> 8;
+	data[3] = word;
+}
 
-	return inv_sbox[i][j];
+/** Perform substitution transformation on given word.
+ *
+ * @param word Input word.
+ *
+ * @return Substituted word.
+ *
+ */
+static uint32_t sub_word(uint32_t word)
+{
+	return (SBOX(BYTE0(word)) << 24) | (SBOX(BYTE1(word)) << 16) |
+	    (SBOX(BYTE2(word)) << 8) | SBOX(BYTE3(word));
 }
 
-/** Perform substitution transformation on state table.
+/** Perform left rotation by one byte on given word.
+ *
+ * @param word Input word.
  *
- * @param state State table to be modified.
- * @param inv   Flag indicating whether to use inverse table.
+ * @return Rotated word.
  *
  */
-static void sub_bytes(uint8_t state[ELEMS][ELEMS], bool inv)
+static uint32_t rot_word(uint32_t word)
 {
-	uint8_t val;
+	return (word << 8 | word >> 24);
+}
 
-	for (size_t i = 0; i < ELEMS; i++) {
+/** Perform inverted mix columns transformation on a round key word.
+ *
+ * @param word Input word.
+ *
+ * @return Transformed word.
+ *
+ */
+static uint32_t inv_mix_column(uint32_t word)
+{
+	/* The td tables apply inverse substitution first, undo it */
+	return TD0(SBOX(BYTE0(word))) ^ TD1(SBOX(BYTE1(word))) ^
+	    TD2(SBOX(BYTE2(word))) ^ TD3(SBOX(BYTE3(word)));
+}
+
+/** Key expansion procedure for AES algorithm.
+ *
+ * Computes both the encryption round keys and the decryption round
+ * keys of the equivalent inverse cipher (in reverse order with the
+ * inverted mix columns transformation applied).
+ *
+ * @param ctx     AES context.
+ * @param key     Input key.
+ * @param key_len Key length in bytes.
+ *
+ */
+static void key_expansion(aes_ctx_t *ctx, const uint8_t *key, size_t key_len)
+{
+	const size_t key_elems = key_len / 4;
+	const size_t total = ELEMS * (ctx->rounds + 1);
+	uint32_t *key_exp = ctx->enc_key;
+	uint32_t temp;
+
+	for (size_t i = 0; i < key_elems; i++)
+		key_exp[i] = load_word(key + 4 * i);
+
+	for (size_t i = key_elems; i < total; i++) {
+		temp = key_exp[i - 1];
+
+		if ((i % key_elems) == 0) {
+			temp = sub_word(rot_word(temp)) ^
+			    r_con_array[i / key_elems - 1];
+		} else if ((key_elems > 6) && ((i % key_elems) == 4))
+			temp = sub_word(temp);
+
+		key_exp[i] = key_exp[i - key_elems] ^ temp;
+	}
+
+	for (size_t round = 0; round <= ctx->rounds; round++) {
 		for (size_t j = 0; j < ELEMS; j++) {
-			val = state[i][j];
-			state[i][j] = sub_byte(val, inv);
+			uint32_t word = key_exp[(ctx->rounds - round) * ELEMS + j];
+
+			if ((round > 0) && (round < ctx->rounds))
+				word = inv_mix_column(word);
+
+			ctx->dec_key[round * ELEMS + j] = word;
 		}
 	}
 }
 
-/** Perform shift rows transformation on state table.
+/** Encrypt block using lookup tables.
  *
- * @param state State table to be modified.
+ * @param ctx    AES context.
+ * @param input  Input block.
+ * @param output Output block.
  *
  */
-static void shift_rows(uint8_t state[ELEMS][ELEMS])
+static void table_encrypt(aes_ctx_t *ctx, const uint8_t *input,
+    uint8_t *output)
 {
-	uint8_t temp[ELEMS];
+	const uint32_t *rk = ctx->enc_key;
+	uint32_t s0 = load_word(input) ^ rk[0];
+	uint32_t s1 = load_word(input + 4) ^ rk[1];
+	uint32_t s2 = load_word(input + 8) ^ rk[2];
+	uint32_t s3 = load_word(input + 12) ^ rk[3];
+	uint32_t t0, t1, t2, t3;
+
+	for (unsigned round = 1; round < ctx->rounds; round++) {
+		rk += ELEMS;
+
+		t0 = TE0(BYTE0(s0)) ^ TE1(BYTE1(s1)) ^ TE2(BYTE2(s2)) ^
+		    TE3(BYTE3(s3)) ^ rk[0];
+		t1 = TE0(BYTE0(s1)) ^ TE1(BYTE1(s2)) ^ TE2(BYTE2(s3)) ^
+		    TE3(BYTE3(s0)) ^ rk[1];
+		t2 = TE0(BYTE0(s2)) ^ TE1(BYTE1(s3)) ^ TE2(BYTE2(s0)) ^
+		    TE3(BYTE3(s1)) ^ rk[2];
+		t3 = TE0(BYTE0(s3)) ^ TE1(BYTE1(s0)) ^ TE2(BYTE2(s1)) ^
+		    TE3(BYTE3(s2)) ^ rk[3];
 
-	for (size_t i = 1; i < ELEMS; i++) {
-		memcpy(temp, state[i], i);
-		memmove(state[i], state[i] + i, ELEMS - i);
-		memcpy(state[i] + ELEMS - i, temp, i);
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
 	}
+
+	/* Last round without mix columns */
+	rk += ELEMS;
+
+	t0 = (SBOX(BYTE0(s0)) << 24) ^ (SBOX(BYTE1(s1)) << 16) ^
+	    (SBOX(BYTE2(s2)) << 8) ^ SBOX(BYTE3(s3)) ^ rk[0];
+	t1 = (SBOX(BYTE0(s1)) << 24) ^ (SBOX(BYTE1(s2)) << 16) ^
+	    (SBOX(BYTE2(s3)) << 8) ^ SBOX(BYTE3(s0)) ^ rk[1];
+	t2 = (SBOX(BYTE0(s2)) << 24) ^ (SBOX(BYTE1(s3)) << 16) ^
+	    (SBOX(BYTE2(s0)) << 8) ^ SBOX(BYTE3(s1)) ^ rk[2];
+	t3 = (SBOX(BYTE0(s3)) << 24) ^ (SBOX(BYTE1(s0)) << 16) ^
+	    (SBOX(BYTE2(s1)) << 8) ^ SBOX(BYTE3(s2)) ^ rk[3];
+
+	store_word(output, t0);
+	store_word(output + 4, t1);
+	store_word(output + 8, t2);
+	store_word(output + 12, t3);
 }
 
-/** Perform inverted shift rows transformation on state table.
+/** Decrypt block using lookup tables.
  *
- * @param state State table to be modified.
+ * @param ctx    AES context.
+ * @param input  Input block.
+ * @param output Output block.
  *
  */
-static void inv_shift_rows(uint8_t state[ELEMS][ELEMS])
+static void table_decrypt(aes_ctx_t *ctx, const uint8_t *input,
+    uint8_t *output)
 {
-	uint8_t temp[ELEMS];
+	const uint32_t *rk = ctx->dec_key;
+	uint32_t s0 = load_word(input) ^ rk[0];
+	uint32_t s1 = load_word(input + 4) ^ rk[1];
+	uint32_t s2 = load_word(input + 8) ^ rk[2];
+	uint32_t s3 = load_word(input + 12) ^ rk[3];
+	uint32_t t0, t1, t2, t3;
 
-	for (size_t i = 1; i < ELEMS; i++) {
-		memcpy(temp, state[i], ELEMS - i);
-		memmove(state[i], state[i] + ELEMS - i, i);
-		memcpy(state[i] + i, temp, ELEMS - i);
+	for (unsigned round = 1; round < ctx->rounds; round++) {
+		rk += ELEMS;
+
+		t0 = TD0(BYTE0(s0)) ^ TD1(BYTE1(s3)) ^ TD2(BYTE2(s2)) ^
+		    TD3(BYTE3(s1)) ^ rk[0];
+		t1 = TD0(BYTE0(s1)) ^ TD1(BYTE1(s0)) ^ TD2(BYTE2(s3)) ^
+		    TD3(BYTE3(s2)) ^ rk[1];
+		t2 = TD0(BYTE0(s2)) ^ TD1(BYTE1(s1)) ^ TD2(BYTE2(s0)) ^
+		    TD3(BYTE3(s3)) ^ rk[2];
+		t3 = TD0(BYTE0(s3)) ^ TD1(BYTE1(s2)) ^ TD2(BYTE2(s1)) ^
+		    TD3(BYTE3(s0)) ^ rk[3];
+
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
 	}
+
+	/* Last round without inverted mix columns */
+	rk += ELEMS;
+
+	t0 = (INV_SBOX(BYTE0(s0)) << 24) ^ (INV_SBOX(BYTE1(s3)) << 16) ^
+	    (INV_SBOX(BYTE2(s2)) << 8) ^ INV_SBOX(BYTE3(s1)) ^ rk[0];
+	t1 = (INV_SBOX(BYTE0(s1)) << 24) ^ (INV_SBOX(BYTE1(s0)) << 16) ^
+	    (INV_SBOX(BYTE2(s3)) << 8) ^ INV_SBOX(BYTE3(s2)) ^ rk[1];
+	t2 = (INV_SBOX(BYTE0(s2)) << 24) ^ (INV_SBOX(BYTE1(s1)) << 16) ^
+	    (INV_SBOX(BYTE2(s0)) << 8) ^ INV_SBOX(BYTE3(s3)) ^ rk[2];
+	t3 = (INV_SBOX(BYTE0(s3)) << 24) ^ (INV_SBOX(BYTE1(s2)) << 16) ^
+	    (INV_SBOX(BYTE2(s1)) << 8) ^ INV_SBOX(BYTE3(s0)) ^ rk[3];
+
+	store_word(output, t0);
+	store_word(output + 4, t1);
+	store_word(output + 8, t2);
+	store_word(output + 12, t3);
 }
 
-/** Multiplication in GF(2^8).
+#ifdef __x86_64__
+
+/** 128-bit vector held in an XMM register. */
+typedef long long xmm_t __attribute__((vector_size(16)));
+
+/** Load 128-bit vector from unaligned memory.
+ *
+ * @param data Input data.
  *
- * @param x First factor.
- * @param y Second factor.
+ * @return Loaded vector.
  *
- * @return Multiplication of given factors in GF(2^8).
+ */
+static inline xmm_t xmm_load(const uint8_t *data)
+{
+	xmm_t val;
+	memcpy(&val, data, sizeof(val));
+	return val;
+}
+
+/** Store 128-bit vector to unaligned memory.
+ *
+ * @param data Output data.
+ * @param val  Vector to be stored.
  *
  */
-static uint8_t galois_mult(uint8_t x, uint8_t y)
+static inline void xmm_store(uint8_t *data, xmm_t val)
 {
-	uint8_t result = 0;
-	uint8_t f_bith;
+	memcpy(data, &val, sizeof(val));
+}
 
-	for (size_t i = 0; i < 8; i++) {
-		if (y & 1)
-			result ^= x;
+/** Encrypt block using AES-NI instructions.
+ *
+ * @param ctx    AES context.
+ * @param input  Input block.
+ * @param output Output block.
+ *
+ */
+static void aesni_encrypt(aes_ctx_t *ctx, const uint8_t *input,
+    uint8_t *output)
+{
+	const uint8_t *rk = ctx->aesni_enc_key;
+	xmm_t state = xmm_load(input) ^ xmm_load(rk);
 
-		f_bith = (x & 0x80);
-		x <<= 1;
+	for (unsigned round = 1; round < ctx->rounds; round++) {
+		rk += BLOCK_LEN;
+		asm (
+		    "aesenc %[key], %[state]\n"
+		    : [state] "+x" (state)
+		    : [key] "x" (xmm_load(rk))
+		);
+	}
 
-		if (f_bith)
-			x ^= AES_IP;
+	rk += BLOCK_LEN;
+	asm (
+	    "aesenclast %[key], %[state]\n"
+	    : [state] "+x" (state)
+	    : [key] "x" (xmm_load(rk))
+	);
 
-		y >>= 1;
+	xmm_store(output, state);
+}
+
+/** Decrypt block using AES-NI instructions.
+ *
+ * @param ctx    AES context.
+ * @param input  Input block.
+ * @param output Output block.
+ *
+ */
+static void aesni_decrypt(aes_ctx_t *ctx, const uint8_t *input,
+    uint8_t *output)
+{
+	const uint8_t *rk = ctx->aesni_dec_key;
+	xmm_t state = xmm_load(input) ^ xmm_load(rk);
+
+	for (unsigned round = 1; round < ctx->rounds; round++) {
+		rk += BLOCK_LEN;
+		asm (
+		    "aesdec %[key], %[state]\n"
+		    : [state] "+x" (state)
+		    : [key] "x" (xmm_load(rk))
+		);
+	}
+
+	rk += BLOCK_LEN;
+	asm (
+	    "aesdeclast %[key], %[state]\n"
+	    : [state] "+x" (state)
+	    : [key] "x" (xmm_load(rk))
+	);
+
+	xmm_store(output, state);
+}
+
+#endif
+
+/** Initialize AES context.
+ *
+ * Expands the key schedule and selects the implementation used for
+ * processing blocks.
+ *
+ * @param ctx     AES context to be initialized.
+ * @param key     Input key.
+ * @param key_len Key length in bytes (16, 24 or 32).
+ *
+ * @return EINVAL when key not specified or of invalid length,
+ *         otherwise EOK.
+ *
+ */
+errno_t aes_init(aes_ctx_t *ctx, const uint8_t *key, size_t key_len)
+{
+	if ((!ctx) || (!key))
+		return EINVAL;
+
+	if ((key_len != 16) && (key_len != 24) && (key_len != 32))
+		return EINVAL;
+
+	ctx->rounds = key_len / 4 + 6;
+	key_expansion(ctx, key, key_len);
+
+	ctx->aesni = cpu_has_aesni();
+
+#ifdef __x86_64__
+	if (ctx->aesni) {
+		for (size_t i = 0; i < ELEMS * (ctx->rounds + 1); i++) {
+			store_word(ctx->aesni_enc_key + 4 * i, ctx->enc_key[i]);
+			store_word(ctx->aesni_dec_key + 4 * i, ctx->dec_key[i]);
+		}
+	}
+#endif
+
+	return EOK;
+}
+
+/** Encrypt single block.
+ *
+ * @param ctx    Initialized AES context.
+ * @param input  Input block (AES_CIPHER_LENGTH bytes).
+ * @param output Output block (may be the same as input).
+ *
+ */
+void aes_encrypt_block(aes_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+#ifdef __x86_64__
+	if (ctx->aesni) {
+		aesni_encrypt(ctx, input, output);
+		return;
+	}
+#endif
+
+	table_encrypt(ctx, input, output);
+}
+
+/** Decrypt single block.
+ *
+ * @param ctx    Initialized AES context.
+ * @param input  Input block (AES_CIPHER_LENGTH bytes).
+ * @param output Output block (may be the same as input).
+ *
+ */
+void aes_decrypt_block(aes_ctx_t *ctx, const uint8_t *input, uint8_t *output)
+{
+#ifdef __x86_64__
+	if (ctx->aesni) {
+		aesni_decrypt(ctx, input, output);
+		return;
 	}
+#endif
 
-	return result;
+	table_decrypt(ctx, input, output);
 }
 
-/** Perform mix columns transformation on state table.
+/** XOR two blocks.
  *
- * @param state State table to be modified.
+ * @param dest Destination block.
+ * @param a    First operand.
+ * @param b    Second operand.
+ * @param len  Number of bytes.
  *
  */
-static void mix_columns(uint8_t state[ELEMS][ELEMS])
+static inline void xor_block(uint8_t *dest, const uint8_t *a,
+    const uint8_t *b, size_t len)
 {
-	uint8_t orig_state[ELEMS][ELEMS];
-	memcpy(orig_state, state, BLOCK_LEN);
+	for (size_t i = 0; i < len; i++)
+		dest[i] = a[i] ^ b[i];
+}
+
+/** CBC mode encryption.
+ *
+ * @param ctx    Initialized AES context.
+ * @param iv     Initialization vector, updated to allow chaining
+ *               of subsequent calls.
+ * @param input  Input data.
+ * @param output Output data (may be the same as input).
+ * @param size   Data size (multiple of AES_CIPHER_LENGTH).
+ *
+ * @return EINVAL when size is not a multiple of the block length,
+ *         otherwise EOK.
+ *
+ */
+errno_t aes_cbc_encrypt(aes_ctx_t *ctx, uint8_t *iv, const uint8_t *input,
+    uint8_t *output, size_t size)
+{
+	if ((size % BLOCK_LEN) != 0)
+		return EINVAL;
 
-	for (size_t j = 0; j < ELEMS; j++) {
-		state[0][j] =
-		    galois_mult(0x2, orig_state[0][j]) ^
-		    galois_mult(0x3, orig_state[1][j]) ^
-		    orig_state[2][j] ^
-		    orig_state[3][j];
-		state[1][j] =
-		    orig_state[0][j] ^
-		    galois_mult(0x2, orig_state[1][j]) ^
-		    galois_mult(0x3, orig_state[2][j]) ^
-		    orig_state[3][j];
-		state[2][j] =
-		    orig_state[0][j] ^
-		    orig_state[1][j] ^
-		    galois_mult(0x2, orig_state[2][j]) ^
-		    galois_mult(0x3, orig_state[3][j]);
-		state[3][j] =
-		    galois_mult(0x3, orig_state[0][j]) ^
-		    orig_state[1][j] ^
-		    orig_state[2][j] ^
-		    galois_mult(0x2, orig_state[3][j]);
+	for (size_t pos = 0; pos < size; pos += BLOCK_LEN) {
+		xor_block(iv, iv, input + pos, BLOCK_LEN);
+		aes_encrypt_block(ctx, iv, iv);
+		memcpy(output + pos, iv, BLOCK_LEN);
 	}
+
+	return EOK;
 }
 
-/** Perform inverted mix columns transformation on state table.
- *
- * @param state State table to be modified.
- *
- */
-static void inv_mix_columns(uint8_t state[ELEMS][ELEMS])
-{
-	uint8_t orig_state[ELEMS][ELEMS];
-	memcpy(orig_state, state, BLOCK_LEN);
-
-	for (size_t j = 0; j < ELEMS; j++) {
-		state[0][j] =
-		    galois_mult(0x0e, orig_state[0][j]) ^
-		    galois_mult(0x0b, orig_state[1][j]) ^
-		    galois_mult(0x0d, orig_state[2][j]) ^
-		    galois_mult(0x09, orig_state[3][j]);
-		state[1][j] =
-		    galois_mult(0x09, orig_state[0][j]) ^
-		    galois_mult(0x0e, orig_state[1][j]) ^
-		    galois_mult(0x0b, orig_state[2][j]) ^
-		    galois_mult(0x0d, orig_state[3][j]);
-		state[2][j] =
-		    galois_mult(0x0d, orig_state[0][j]) ^
-		    galois_mult(0x09, orig_state[1][j]) ^
-		    galois_mult(0x0e, orig_state[2][j]) ^
-		    galois_mult(0x0b, orig_state[3][j]);
-		state[3][j] =
-		    galois_mult(0x0b, orig_state[0][j]) ^
-		    galois_mult(0x0d, orig_state[1][j]) ^
-		    galois_mult(0x09, orig_state[2][j]) ^
-		    galois_mult(0x0e, orig_state[3][j]);
+/** CBC mode decryption.
+ *
+ * @param ctx    Initialized AES context.
+ * @param iv     Initialization vector, updated to allow chaining
+ *               of subsequent calls.
+ * @param input  Input data.
+ * @param output Output data (may be the same as input).
+ * @param size   Data size (multiple of AES_CIPHER_LENGTH).
+ *
+ * @return EINVAL when size is not a multiple of the block length,
+ *         otherwise EOK.
+ *
+ */
+errno_t aes_cbc_decrypt(aes_ctx_t *ctx, uint8_t *iv, const uint8_t *input,
+    uint8_t *output, size_t size)
+{
+	uint8_t block[BLOCK_LEN];
+	uint8_t cipher[BLOCK_LEN];
+
+	if ((size % BLOCK_LEN) != 0)
+		return EINVAL;
+
+	for (size_t pos = 0; pos < size; pos += BLOCK_LEN) {
+		memcpy(cipher, input + pos, BLOCK_LEN);
+		aes_decrypt_block(ctx, cipher, block);
+		xor_block(output + pos, block, iv, BLOCK_LEN);
+		memcpy(iv, cipher, BLOCK_LEN);
 	}
+
+	return EOK;
 }
 
-/** Perform round key transformation on state table.
+/** Increment big-endian counter.
  *
- * @param state     State table to be modified.
- * @param round_key Round key to be applied on state table.
+ * @param counter Counter block.
+ * @param width   Number of trailing bytes forming the counter.
  *
  */
-static void add_round_key(uint8_t state[ELEMS][ELEMS], uint32_t *round_key)
+static inline void counter_inc(uint8_t *counter, size_t width)
 {
-	uint8_t byte_round;
-	uint8_t shift;
-	uint32_t mask = 0xff;
+	for (size_t i = BLOCK_LEN; i > BLOCK_LEN - width; i--) {
+		if (++counter[i - 1] != 0)
+			break;
+	}
+}
+
+/** Counter mode keystream application.
+ *
+ * @param ctx     Initialized AES context.
+ * @param counter Counter block, advanced past the used values.
+ * @param width   Number of trailing counter block bytes to increment.
+ * @param input   Input data.
+ * @param output  Output data (may be the same as input).
+ * @param size    Data size.
+ *
+ */
+static void ctr_crypt(aes_ctx_t *ctx, uint8_t *counter, size_t width,
+    const uint8_t *input, uint8_t *output, size_t size)
+{
+	uint8_t stream[BLOCK_LEN];
+
+	for (size_t pos = 0; pos < size; pos += BLOCK_LEN) {
+		size_t len = min(size - pos, BLOCK_LEN);
+
+		aes_encrypt_block(ctx, counter, stream);
+		counter_inc(counter, width);
+		xor_block(output + pos, input + pos, stream, len);
+	}
+}
+
+/** CTR mode encryption and decryption.
+ *
+ * The counter block is incremented as a 128-bit big-endian number.
+ *
+ * @param ctx     Initialized AES context.
+ * @param counter Initial counter block, updated to allow chaining
+ *                of subsequent calls (a partial last block consumes
+ *                the whole counter value).
+ * @param input   Input data.
+ * @param output  Output data (may be the same as input).
+ * @param size    Data size.
+ *
+ */
+void aes_ctr_crypt(aes_ctx_t *ctx, uint8_t *counter, const uint8_t *input,
+    uint8_t *output, size_t size)
+{
+	ctr_crypt(ctx, counter, BLOCK_LEN, input, output, size);
+}
 
-	for (size_t j = 0; j < ELEMS; j++) {
-		for (size_t i = 0; i < ELEMS; i++) {
-			shift = 24 - 8 * i;
-			byte_round = (round_key[j] & (mask << shift)) >> shift;
-			state[i][j] = state[i][j] ^ byte_round;
+/** Compare authentication tags in constant time.
+ *
+ * @param a   First tag.
+ * @param b   Second tag.
+ * @param len Tag length.
+ *
+ * @return True if the tags are equal.
+ *
+ */
+static bool tag_equal(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	uint8_t diff = 0;
+
+	for (size_t i = 0; i < len; i++)
+		diff |= a[i] ^ b[i];
+
+	return diff == 0;
+}
+
+/** Feed data to CCM CBC-MAC computation.
+ *
+ * The data are zero-padded to a multiple of the block length.
+ *
+ * @param ctx  Initialized AES context.
+ * @param mac  Current MAC value.
+ * @param data Input data.
+ * @param size Data size.
+ *
+ */
+static void ccm_mac(aes_ctx_t *ctx, uint8_t *mac, const uint8_t *data,
+    size_t size)
+{
+	for (size_t pos = 0; pos < size; pos += BLOCK_LEN) {
+		size_t len = min(size - pos, BLOCK_LEN);
+
+		xor_block(mac, mac, data + pos, len);
+		aes_encrypt_block(ctx, mac, mac);
+	}
+}
+
+/** Compute CCM authentication tag.
+ *
+ * @param ctx       Initialized AES context.
+ * @param nonce     Nonce.
+ * @param nonce_len Nonce length (7 to 13 bytes).
+ * @param aad       Additional authenticated data.
+ * @param aad_len   Additional authenticated data length.
+ * @param data      Plaintext.
+ * @param size      Plaintext size.
+ * @param tag_len   Tag length.
+ * @param tag       Output tag (encrypted with the first counter block).
+ *
+ */
+static void ccm_tag(aes_ctx_t *ctx, const uint8_t *nonce, size_t nonce_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *data, size_t size,
+    size_t tag_len, uint8_t *tag)
+{
+	const size_t len_size = BLOCK_LEN - 1 - nonce_len;
+	uint8_t mac[BLOCK_LEN];
+	uint8_t counter[BLOCK_LEN];
+	uint8_t block[BLOCK_LEN];
+
+	/* First block with flags, nonce and message length */
+	mac[0] = ((aad_len > 0) ? 0x40 : 0) | (((tag_len - 2) / 2) << 3) |
+	    (len_size - 1);
+	memcpy(mac + 1, nonce, nonce_len);
+
+	size_t msg_len = size;
+	for (size_t i = BLOCK_LEN; i > 1 + nonce_len; i--) {
+		mac[i - 1] = msg_len & 0xff;
+		msg_len >>= 8;
+	}
+
+	aes_encrypt_block(ctx, mac, mac);
+
+	/* Additional data prefixed by their length */
+	if (aad_len > 0) {
+		size_t hdr_len;
+
+		memset(block, 0, BLOCK_LEN);
+		if (aad_len < 0xff00) {
+			block[0] = aad_len >> 8;
+			block[1] = aad_len;
+			hdr_len = 2;
+		} else {
+			block[0] = 0xff;
+			block[1] = 0xfe;
+			store_word(block + 2, aad_len);
+			hdr_len = 6;
 		}
+
+		size_t first = min(aad_len, BLOCK_LEN - hdr_len);
+		memcpy(block + hdr_len, aad, first);
+
+		ccm_mac(ctx, mac, block, BLOCK_LEN);
+		ccm_mac(ctx, mac, aad + first, aad_len - first);
 	}
+
+	ccm_mac(ctx, mac, data, size);
+
+	/* Encrypt the MAC with counter value zero */
+	memset(counter, 0, BLOCK_LEN);
+	counter[0] = len_size - 1;
+	memcpy(counter + 1, nonce, nonce_len);
+
+	aes_encrypt_block(ctx, counter, block);
+	xor_block(tag, mac, block, tag_len);
 }
 
-/** Perform substitution transformation on given word.
+/** Validate CCM parameters.
  *
- * @param byte Input word.
+ * @param nonce_len Nonce length.
+ * @param size      Message size.
+ * @param tag_len   Tag length.
  *
- * @return Substituted word.
+ * @return True if the parameters are valid.
  *
  */
-static uint32_t sub_word(uint32_t word)
+static bool ccm_valid(size_t nonce_len, size_t size, size_t tag_len)
 {
-	uint32_t temp = word;
-	uint8_t *start = (uint8_t *) &temp;
+	if ((nonce_len < 7) || (nonce_len > 13))
+		return false;
+
+	if ((tag_len < 4) || (tag_len > 16) || ((tag_len % 2) != 0))
+		return false;
 
-	for (size_t i = 0; i < 4; i++)
-		*(start + i) = sub_byte(*(start + i), false);
+	/* The message length has to fit into the length field */
+	const size_t len_size = BLOCK_LEN - 1 - nonce_len;
+	if ((len_size < sizeof(size_t)) && ((size >> (8 * len_size)) != 0))
+		return false;
 
-	return temp;
+	return true;
 }
 
-/** Perform left rotation by one byte on given word.
+/** Prepare the first CCM counter block used for the payload.
  *
- * @param byte Input word.
+ * @param counter   Counter block.
+ * @param nonce     Nonce.
+ * @param nonce_len Nonce length.
  *
- * @return Rotated word.
+ */
+static void ccm_counter(uint8_t *counter, const uint8_t *nonce,
+    size_t nonce_len)
+{
+	memset(counter, 0, BLOCK_LEN);
+	counter[0] = BLOCK_LEN - 2 - nonce_len;
+	memcpy(counter + 1, nonce, nonce_len);
+	counter[BLOCK_LEN - 1] = 1;
+}
+
+/** CCM mode authenticated encryption.
+ *
+ * @param ctx       Initialized AES context.
+ * @param nonce     Nonce.
+ * @param nonce_len Nonce length (7 to 13 bytes).
+ * @param aad       Additional authenticated data.
+ * @param aad_len   Additional authenticated data length.
+ * @param input     Plaintext.
+ * @param output    Ciphertext (may be the same as input).
+ * @param size      Data size.
+ * @param tag       Output authentication tag.
+ * @param tag_len   Tag length (4 to 16 bytes, even).
+ *
+ * @return EINVAL when parameters are invalid, otherwise EOK.
  *
  */
-static uint32_t rot_word(uint32_t word)
+errno_t aes_ccm_encrypt(aes_ctx_t *ctx, const uint8_t *nonce,
+    size_t nonce_len, const uint8_t *aad, size_t aad_len,
+    const uint8_t *input, uint8_t *output, size_t size, uint8_t *tag,
+    size_t tag_len)
 {
-	return (word << 8 | word >> 24);
+	uint8_t counter[BLOCK_LEN];
+
+	if (!ccm_valid(nonce_len, size, tag_len))
+		return EINVAL;
+
+	ccm_tag(ctx, nonce, nonce_len, aad, aad_len, input, size, tag_len,
+	    tag);
+
+	ccm_counter(counter, nonce, nonce_len);
+	ctr_crypt(ctx, counter, BLOCK_LEN - 1 - nonce_len, input, output,
+	    size);
+
+	return EOK;
 }
 
-/** Key expansion procedure for AES algorithm.
+/** CCM mode authenticated decryption.
  *
- * @param key     Input key.
- * @param key_exp Result key expansion.
+ * @param ctx       Initialized AES context.
+ * @param nonce     Nonce.
+ * @param nonce_len Nonce length (7 to 13 bytes).
+ * @param aad       Additional authenticated data.
+ * @param aad_len   Additional authenticated data length.
+ * @param input     Ciphertext.
+ * @param output    Plaintext (may be the same as input).
+ * @param size      Data size.
+ * @param tag       Authentication tag to be verified.
+ * @param tag_len   Tag length (4 to 16 bytes, even).
+ *
+ * @return EINVAL when parameters are invalid,
+ *         EBADCHECKSUM when the authentication fails (the output
+ *         is cleared), otherwise EOK.
  *
  */
-static void key_expansion(uint8_t *key, uint32_t *key_exp)
+errno_t aes_ccm_decrypt(aes_ctx_t *ctx, const uint8_t *nonce,
+    size_t nonce_len, const uint8_t *aad, size_t aad_len,
+    const uint8_t *input, uint8_t *output, size_t size, const uint8_t *tag,
+    size_t tag_len)
 {
-	uint32_t temp;
+	uint8_t counter[BLOCK_LEN];
+	uint8_t computed[BLOCK_LEN];
+
+	if (!ccm_valid(nonce_len, size, tag_len))
+		return EINVAL;
 
-	for (size_t i = 0; i < CIPHER_ELEMS; i++) {
-		key_exp[i] =
-		    (key[4 * i] << 24) +
-		    (key[4 * i + 1] << 16) +
-		    (key[4 * i + 2] << 8) +
-		    (key[4 * i + 3]);
+	ccm_counter(counter, nonce, nonce_len);
+	ctr_crypt(ctx, counter, BLOCK_LEN - 1 - nonce_len, input, output,
+	    size);
+
+	ccm_tag(ctx, nonce, nonce_len, aad, aad_len, output, size, tag_len,
+	    computed);
+
+	if (!tag_equal(tag, computed, tag_len)) {
+		memset(output, 0, size);
+		return EBADCHECKSUM;
 	}
 
-	for (size_t i = CIPHER_ELEMS; i < ELEMS * (ROUNDS + 1); i++) {
-		temp = key_exp[i - 1];
+	return EOK;
+}
 
-		if ((i % CIPHER_ELEMS) == 0) {
-			temp = sub_word(rot_word(temp)) ^
-			    r_con_array[i / CIPHER_ELEMS - 1];
+/** GHASH computation state. */
+typedef struct {
+	/** Multiples of the hash subkey (high halves). */
+	uint64_t hh[GHASH_TABLE_LEN];
+	/** Multiples of the hash subkey (low halves). */
+	uint64_t hl[GHASH_TABLE_LEN];
+	/** Current hash value. */
+	uint8_t value[BLOCK_LEN];
+} ghash_t;
+
+/** Load big-endian 64-bit value.
+ *
+ * @param data Input data.
+ *
+ * @return Loaded value.
+ *
+ */
+static inline uint64_t load_dword(const uint8_t *data)
+{
+	return ((uint64_t) load_word(data) << 32) | load_word(data + 4);
+}
+
+/** Store big-endian 64-bit value.
+ *
+ * @param data  Output data.
+ * @param value Value to be stored.
+ *
+ */
+static inline void store_dword(uint8_t *data, uint64_t value)
+{
+	store_word(data, value >> 32);
+	store_word(data + 4, value);
+}
+
+/** Initialize GHASH state.
+ *
+ * Precomputes the products of the hash subkey with all 4-bit values
+ * so that multiplication in GF(2^128) processes 4 bits at a time.
+ *
+ * @param ghash GHASH state.
+ * @param ctx   Initialized AES context.
+ *
+ */
+static void ghash_init(ghash_t *ghash, aes_ctx_t *ctx)
+{
+	uint8_t h[BLOCK_LEN];
+
+	memset(h, 0, BLOCK_LEN);
+	aes_encrypt_block(ctx, h, h);
+
+	uint64_t vh = load_dword(h);
+	uint64_t vl = load_dword(h + 8);
+
+	ghash->hh[0] = 0;
+	ghash->hl[0] = 0;
+	ghash->hh[8] = vh;
+	ghash->hl[8] = vl;
+
+	for (size_t i = 4; i > 0; i >>= 1) {
+		uint64_t reduce = (vl & 1) ? UINT64_C(0xe100000000000000) : 0;
+
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ reduce;
+
+		ghash->hh[i] = vh;
+		ghash->hl[i] = vl;
+	}
+
+	for (size_t i = 2; i <= 8; i <<= 1) {
+		for (size_t j = 1; j < i; j++) {
+			ghash->hh[i + j] = ghash->hh[i] ^ ghash->hh[j];
+			ghash->hl[i + j] = ghash->hl[i] ^ ghash->hl[j];
+		}
+	}
+
+	memset(ghash->value, 0, BLOCK_LEN);
+}
+
+/** Multiply the GHASH value by the hash subkey.
+ *
+ * @param ghash GHASH state.
+ *
+ */
+static void ghash_mult(ghash_t *ghash)
+{
+	const uint8_t *x = ghash->value;
+	uint8_t lo = x[BLOCK_LEN - 1] & 0xf;
+	uint64_t zh = ghash->hh[lo];
+	uint64_t zl = ghash->hl[lo];
+	uint8_t rem;
+
+	for (size_t i = BLOCK_LEN; i > 0; i--) {
+		lo = x[i - 1] & 0xf;
+		uint8_t hi = x[i - 1] >> 4;
+
+		if (i != BLOCK_LEN) {
+			rem = zl & 0xf;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (ghash_last4[rem] << 48);
+			zh ^= ghash->hh[lo];
+			zl ^= ghash->hl[lo];
 		}
 
-		key_exp[i] = key_exp[i - CIPHER_ELEMS] ^ temp;
+		rem = zl & 0xf;
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (ghash_last4[rem] << 48);
+		zh ^= ghash->hh[hi];
+		zl ^= ghash->hl[hi];
 	}
+
+	store_dword(ghash->value, zh);
+	store_dword(ghash->value + 8, zl);
+}
+
+/** Feed data to GHASH computation.
+ *
+ * The data are zero-padded to a multiple of the block length.
+ *
+ * @param ghash GHASH state.
+ * @param data  Input data.
+ * @param size  Data size.
+ *
+ */
+static void ghash_update(ghash_t *ghash, const uint8_t *data, size_t size)
+{
+	for (size_t pos = 0; pos < size; pos += BLOCK_LEN) {
+		size_t len = min(size - pos, BLOCK_LEN);
+
+		xor_block(ghash->value, ghash->value, data + pos, len);
+		ghash_mult(ghash);
+	}
+}
+
+/** Feed the lengths block to GHASH computation.
+ *
+ * @param ghash   GHASH state.
+ * @param len_a   First length in bytes.
+ * @param len_b   Second length in bytes.
+ *
+ */
+static void ghash_lengths(ghash_t *ghash, uint64_t len_a, uint64_t len_b)
+{
+	uint8_t block[BLOCK_LEN];
+
+	store_dword(block, len_a * 8);
+	store_dword(block + 8, len_b * 8);
+	ghash_update(ghash, block, BLOCK_LEN);
+}
+
+/** Prepare the pre-counter block of GCM.
+ *
+ * @param ghash  Initialized GHASH state (used for non-96-bit IVs).
+ * @param iv     Initialization vector.
+ * @param iv_len Initialization vector length.
+ * @param j0     Output pre-counter block.
+ *
+ */
+static void gcm_j0(ghash_t *ghash, const uint8_t *iv, size_t iv_len,
+    uint8_t *j0)
+{
+	if (iv_len == 12) {
+		memcpy(j0, iv, iv_len);
+		memset(j0 + iv_len, 0, BLOCK_LEN - iv_len);
+		j0[BLOCK_LEN - 1] = 1;
+		return;
+	}
+
+	ghash_update(ghash, iv, iv_len);
+	ghash_lengths(ghash, 0, iv_len);
+	memcpy(j0, ghash->value, BLOCK_LEN);
+	memset(ghash->value, 0, BLOCK_LEN);
+}
+
+/** Compute GCM authentication tag.
+ *
+ * @param ctx     Initialized AES context.
+ * @param ghash   GHASH state.
+ * @param j0      Pre-counter block.
+ * @param aad     Additional authenticated data.
+ * @param aad_len Additional authenticated data length.
+ * @param data    Ciphertext.
+ * @param size    Ciphertext size.
+ * @param tag     Output tag.
+ * @param tag_len Tag length.
+ *
+ */
+static void gcm_tag(aes_ctx_t *ctx, ghash_t *ghash, const uint8_t *j0,
+    const uint8_t *aad, size_t aad_len, const uint8_t *data, size_t size,
+    uint8_t *tag, size_t tag_len)
+{
+	uint8_t block[BLOCK_LEN];
+
+	ghash_update(ghash, aad, aad_len);
+	ghash_update(ghash, data, size);
+	ghash_lengths(ghash, aad_len, size);
+
+	aes_encrypt_block(ctx, j0, block);
+	xor_block(tag, ghash->value, block, tag_len);
+}
+
+/** GCM mode authenticated encryption.
+ *
+ * @param ctx     Initialized AES context.
+ * @param iv      Initialization vector.
+ * @param iv_len  Initialization vector length (12 bytes recommended).
+ * @param aad     Additional authenticated data.
+ * @param aad_len Additional authenticated data length.
+ * @param input   Plaintext.
+ * @param output  Ciphertext (may be the same as input).
+ * @param size    Data size.
+ * @param tag     Output authentication tag.
+ * @param tag_len Tag length (4 to 16 bytes).
+ *
+ * @return EINVAL when parameters are invalid, otherwise EOK.
+ *
+ */
+errno_t aes_gcm_encrypt(aes_ctx_t *ctx, const uint8_t *iv, size_t iv_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *input,
+    uint8_t *output, size_t size, uint8_t *tag, size_t tag_len)
+{
+	ghash_t ghash;
+	uint8_t j0[BLOCK_LEN];
+	uint8_t counter[BLOCK_LEN];
+
+	if ((iv_len == 0) || (tag_len < 4) || (tag_len > BLOCK_LEN))
+		return EINVAL;
+
+	ghash_init(&ghash, ctx);
+	gcm_j0(&ghash, iv, iv_len, j0);
+
+	memcpy(counter, j0, BLOCK_LEN);
+	counter_inc(counter, 4);
+	ctr_crypt(ctx, counter, 4, input, output, size);
+
+	gcm_tag(ctx, &ghash, j0, aad, aad_len, output, size, tag, tag_len);
+	return EOK;
+}
+
+/** GCM mode authenticated decryption.
+ *
+ * @param ctx     Initialized AES context.
+ * @param iv      Initialization vector.
+ * @param iv_len  Initialization vector length.
+ * @param aad     Additional authenticated data.
+ * @param aad_len Additional authenticated data length.
+ * @param input   Ciphertext.
+ * @param output  Plaintext (may be the same as input).
+ * @param size    Data size.
+ * @param tag     Authentication tag to be verified.
+ * @param tag_len Tag length (4 to 16 bytes).
+ *
+ * @return EINVAL when parameters are invalid,
+ *         EBADCHECKSUM when the authentication fails (the output
+ *         is not written), otherwise EOK.
+ *
+ */
+errno_t aes_gcm_decrypt(aes_ctx_t *ctx, const uint8_t *iv, size_t iv_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *input,
+    uint8_t *output, size_t size, const uint8_t *tag, size_t tag_len)
+{
+	ghash_t ghash;
+	uint8_t j0[BLOCK_LEN];
+	uint8_t counter[BLOCK_LEN];
+	uint8_t computed[BLOCK_LEN];
+
+	if ((iv_len == 0) || (tag_len < 4) || (tag_len > BLOCK_LEN))
+		return EINVAL;
+
+	ghash_init(&ghash, ctx);
+	gcm_j0(&ghash, iv, iv_len, j0);
+
+	/* Authenticate the ciphertext before decrypting it */
+	gcm_tag(ctx, &ghash, j0, aad, aad_len, input, size, computed,
+	    tag_len);
+
+	if (!tag_equal(tag, computed, tag_len))
+		return EBADCHECKSUM;
+
+	memcpy(counter, j0, BLOCK_LEN);
+	counter_inc(counter, 4);
+	ctr_crypt(ctx, counter, 4, input, output, size);
+
+	return EOK;
 }
 
 /** AES-128 encryption algorithm.
+ *
+ * Convenience wrapper encrypting a single block. Callers processing
+ * more blocks with the same key should use aes_init() and
+ * aes_encrypt_block() to avoid repeated key expansion.
  *
  * @param key    Input key.
  * @param input  Input data sequence to be encrypted.
@@ -460,46 +1422,27 @@ static void key_expansion(uint8_t *key, uint32_t *key_exp)
  */
 errno_t aes_encrypt(uint8_t *key, uint8_t *input, uint8_t *output)
 {
+	aes_ctx_t ctx;
+
 	if ((!key) || (!input))
 		return EINVAL;
 
 	if (!output)
 		return ENOMEM;
 
-	/* Create key expansion. */
-	uint32_t key_exp[ELEMS * (ROUNDS + 1)];
-	key_expansion(key, key_exp);
-
-	/* Copy input into state array. */
-	uint8_t state[ELEMS][ELEMS];
-	for (size_t i = 0; i < ELEMS; i++) {
-		for (size_t j = 0; j < ELEMS; j++)
-			state[i][j] = input[i + ELEMS * j];
-	}
-
-	/* Processing loop. */
-	add_round_key(state, key_exp);
-
-	for (size_t k = 1; k <= ROUNDS; k++) {
-		sub_bytes(state, false);
-		shift_rows(state);
-
-		if (k < ROUNDS)
-			mix_columns(state);
-
-		add_round_key(state, key_exp + k * ELEMS);
-	}
-
-	/* Copy state array into output. */
-	for (size_t i = 0; i < ELEMS; i++) {
-		for (size_t j = 0; j < ELEMS; j++)
-			output[i + j * ELEMS] = state[i][j];
-	}
+	errno_t rc = aes_init(&ctx, key, AES_CIPHER_LENGTH);
+	if (rc != EOK)
+		return rc;
 
+	aes_encrypt_block(&ctx, input, output);
 	return EOK;
 }
 
 /** AES-128 decryption algorithm.
+ *
+ * Convenience wrapper decrypting a single block. Callers processing
+ * more blocks with the same key should use aes_init() and
+ * aes_decrypt_block() to avoid repeated key expansion.
  *
  * @param key    Input key.
  * @param input  Input data sequence to be decrypted.
@@ -512,40 +1455,18 @@ errno_t aes_encrypt(uint8_t *key, uint8_t *input, uint8_t *output)
  */
 errno_t aes_decrypt(uint8_t *key, uint8_t *input, uint8_t *output)
 {
+	aes_ctx_t ctx;
+
 	if ((!key) || (!input))
 		return EINVAL;
 
 	if (!output)
 		return ENOMEM;
 
-	/* Create key expansion. */
-	uint32_t key_exp[ELEMS * (ROUNDS + 1)];
-	key_expansion(key, key_exp);
-
-	/* Copy input into state array. */
-	uint8_t state[ELEMS][ELEMS];
-	for (size_t i = 0; i < ELEMS; i++) {
-		for (size_t j = 0; j < ELEMS; j++)
-			state[i][j] = input[i + ELEMS * j];
-	}
-
-	/* Processing loop. */
-	add_round_key(state, key_exp + ROUNDS * ELEMS);
-
-	for (int k = ROUNDS - 1; k >= 0; k--) {
-		inv_shift_rows(state);
-		sub_bytes(state, true);
-		add_round_key(state, key_exp + k * ELEMS);
-
-		if (k > 0)
-			inv_mix_columns(state);
-	}
-
-	/* Copy state array into output. */
-	for (size_t i = 0; i < ELEMS; i++) {
-		for (size_t j = 0; j < ELEMS; j++)
-			output[i + j * ELEMS] = state[i][j];
-	}
+	errno_t rc = aes_init(&ctx, key, AES_CIPHER_LENGTH);
+	if (rc != EOK)
+		return rc;
 
+	aes_decrypt_block(&ctx, input, output);
 	return EOK;
 }
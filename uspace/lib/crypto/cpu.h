@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file cpu.h
+ *
+ * Detection of processor extensions used by the cryptographic routines.
+ */
+
+#ifndef LIBCRYPTO_CPU_H
+#define LIBCRYPTO_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __x86_64__
+
+/** CPUID leaf 1, ECX: AES instructions. */
+#define CPUID_1_ECX_AES  (1 << 25)
+
+/** CPUID leaf 7, EBX: SHA extensions. */
+#define CPUID_7_EBX_SHA  (1 << 29)
+
+/** Execute the CPUID instruction.
+ *
+ * @param leaf    CPUID leaf.
+ * @param subleaf CPUID subleaf.
+ * @param regs    Output values of EAX, EBX, ECX and EDX.
+ *
+ */
+static inline void cpu_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *regs)
+{
+	asm volatile (
+	    "cpuid\n"
+	    : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+	    : "a" (leaf), "c" (subleaf)
+	);
+}
+
+/** Check whether the processor supports the AES-NI instructions.
+ *
+ * @return True if AES-NI is supported.
+ *
+ */
+static inline bool cpu_has_aesni(void)
+{
+	uint32_t regs[4];
+
+	cpu_cpuid(0, 0, regs);
+	if (regs[0] < 1)
+		return false;
+
+	cpu_cpuid(1, 0, regs);
+	return (regs[2] & CPUID_1_ECX_AES) != 0;
+}
+
+/** Check whether the processor supports the SHA extensions.
+ *
+ * @return True if SHA-1 and SHA-256 instructions are supported.
+ *
+ */
+static inline bool cpu_has_shani(void)
+{
+	uint32_t regs[4];
+
+	cpu_cpuid(0, 0, regs);
+	if (regs[0] < 7)
+		return false;
+
+	cpu_cpuid(7, 0, regs);
+	return (regs[1] & CPUID_7_EBX_SHA) != 0;
+}
+
+#else
+
+static inline bool cpu_has_aesni(void)
+{
+	return false;
+}
+
+static inline bool cpu_has_shani(void)
+{
+	return false;
+}
+
+#endif
+
+#endif
@@ -29,38 +29,23 @@
 /** @file crypto.c
  *
  * Cryptographic functions library.
+ *
+ * Hash functions are computed incrementally using a context holding
+ * the interim hash value and a partial block. SHA-1 and SHA-256 use
+ * the SHA extensions instructions if the processor supports them.
  */
 
-#include <assert.h>
-#include <str.h>
 #include <macros.h>
 #include <errno.h>
-#include <byteorder.h>
-#include <limits.h>
+#include <mem.h>
 #include "crypto.h"
+#include "cpu.h"
 
-/** Hash function procedure definition. */
-typedef void (*hash_fnc_t)(uint32_t *, uint32_t *);
-
-/** Length of HMAC block. */
-#define HMAC_BLOCK_LENGTH  64
-
-/** Ceiling for uint32_t. */
-#define ceil_uint32(val) \
-	(((val) - (uint32_t) (val)) > 0 ? \
-	(uint32_t) ((val) + 1) : (uint32_t) (val))
-
-/** Floor for uint32_t. */
-#define floor_uint32(val) \
-	(((val) - (uint32_t) (val)) < 0 ? \
-	(uint32_t) ((val) - 1) : (uint32_t) (val))
-
-/** Pick value at specified index from array or zero if out of bounds. */
-#define get_at(input, size, i) \
-	((i) < (size) ? (input[i]) : 0)
+/** Length of MD5, SHA-1 and SHA-256 block. */
+#define HASH_BLOCK_LENGTH  64
 
 /** Init values used in SHA1 and MD5 functions. */
-static const uint32_t hash_init[] = {
+static const uint32_t hash_init_values[] = {
 	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
 };
 
@@ -92,95 +77,751 @@ static const uint32_t md5_sbox[] = {
 	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
 };
 
+/** Init values used in SHA-256 function. */
+static const uint32_t sha256_init[] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/** Round constants for SHA-256 algorithm. */
+static const uint32_t sha256_k[] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/** Init values used in SHA-512 function. */
+static const uint64_t sha512_init[] = {
+	0x6a09e667f3bcc908, 0xbb67ae8584caa73b,
+	0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+	0x510e527fade682d1, 0x9b05688c2b3e6c1f,
+	0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+};
+
+/** Round constants for SHA-512 algorithm. */
+static const uint64_t sha512_k[] = {
+	0x428a2f98d728ae22, 0x7137449123ef65cd,
+	0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+	0x3956c25bf348b538, 0x59f111f1b605d019,
+	0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+	0xd807aa98a3030242, 0x12835b0145706fbe,
+	0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+	0x72be5d74f27b896f, 0x80deb1fe3b1696b1,
+	0x9bdc06a725c71235, 0xc19bf174cf692694,
+	0xe49b69c19ef14ad2, 0xefbe4786384f25e3,
+	0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+	0x2de92c6f592b0275, 0x4a7484aa6ea6e483,
+	0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+	0x983e5152ee66dfab, 0xa831c66d2db43210,
+	0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+	0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+	0x06ca6351e003826f, 0x142929670a0e6e70,
+	0x27b70a8546d22ffc, 0x2e1b21385c26c926,
+	0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+	0x650a73548baf63de, 0x766a0abb3c77b2a8,
+	0x81c2c92e47edaee6, 0x92722c851482353b,
+	0xa2bfe8a14cf10364, 0xa81a664bbc423001,
+	0xc24b8b70d0f89791, 0xc76c51a30654be30,
+	0xd192e819d6ef5218, 0xd69906245565a910,
+	0xf40e35855771202a, 0x106aa07032bbd1b8,
+	0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+	0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+	0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb,
+	0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+	0x748f82ee5defb2fc, 0x78a5636f43172f60,
+	0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+	0x90befffa23631e28, 0xa4506cebde82bde9,
+	0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+	0xca273eceea26619c, 0xd186b8c721c0c207,
+	0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+	0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+	0x113f9804bef90dae, 0x1b710b35131c471b,
+	0x28db77f523047d84, 0x32caab7b40c72493,
+	0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+	0x4cc5d4becb3e42b6, 0x597f299cfc657e2a,
+	0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
+/* Right rotation for uint64_t. */
+#define rotr_uint64(val, shift) \
+	(((val) >> shift) | ((val) << (64 - shift)))
+
+/** Load little-endian word. */
+static inline uint32_t load_le32(const uint8_t *data)
+{
+	return ((uint32_t) data[3] << 24) | ((uint32_t) data[2] << 16) |
+	    ((uint32_t) data[1] << 8) | ((uint32_t) data[0]);
+}
+
+/** Load big-endian word. */
+static inline uint32_t load_be32(const uint8_t *data)
+{
+	return ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) |
+	    ((uint32_t) data[2] << 8) | ((uint32_t) data[3]);
+}
+
+/** Load big-endian double word. */
+static inline uint64_t load_be64(const uint8_t *data)
+{
+	return ((uint64_t) load_be32(data) << 32) | load_be32(data + 4);
+}
+
+/** Store little-endian word. */
+static inline void store_le32(uint8_t *data, uint32_t val)
+{
+	data[0] = val;
+	data[1] = val >> 8;
+	data[2] = val >> 16;
+	data[3] = val >> 24;
+}
+
+/** Store big-endian word. */
+static inline void store_be32(uint8_t *data, uint32_t val)
+{
+	data[0] = val >> 24;
+	data[1] = val >> 16;
+	data[2] = val >> 8;
+	data[3] = val;
+}
+
+/** Store big-endian double word. */
+static inline void store_be64(uint8_t *data, uint64_t val)
+{
+	store_be32(data, val >> 32);
+	store_be32(data + 4, val);
+}
+
 /** Working procedure of MD5 cryptographic hash function.
  *
- * @param h         Working array with interim hash parts values.
- * @param sched_arr Input array with scheduled values from input string.
+ * @param h      Working array with interim hash parts values.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
  *
  */
-static void md5_proc(uint32_t *h, uint32_t *sched_arr)
+static void md5_proc(uint32_t *h, const uint8_t *data, size_t blocks)
 {
 	uint32_t f, g, temp;
 	uint32_t w[HASH_MD5 / 4];
+	uint32_t sched_arr[16];
 
-	memcpy(w, h, (HASH_MD5 / 4) * sizeof(uint32_t));
-
-	for (size_t k = 0; k < 64; k++) {
-		if (k < 16) {
-			f = (w[1] & w[2]) | (~w[1] & w[3]);
-			g = k;
-		} else if ((k >= 16) && (k < 32)) {
-			f = (w[1] & w[3]) | (w[2] & ~w[3]);
-			g = (5 * k + 1) % 16;
-		} else if ((k >= 32) && (k < 48)) {
-			f = w[1] ^ w[2] ^ w[3];
-			g = (3 * k + 5) % 16;
-		} else {
-			f = w[2] ^ (w[1] | ~w[3]);
-			g = 7 * k % 16;
+	for (size_t i = 0; i < blocks; i++) {
+		for (size_t k = 0; k < 16; k++)
+			sched_arr[k] = load_le32(data + 4 * k);
+
+		memcpy(w, h, (HASH_MD5 / 4) * sizeof(uint32_t));
+
+		for (size_t k = 0; k < 64; k++) {
+			if (k < 16) {
+				f = (w[1] & w[2]) | (~w[1] & w[3]);
+				g = k;
+			} else if ((k >= 16) && (k < 32)) {
+				f = (w[1] & w[3]) | (w[2] & ~w[3]);
+				g = (5 * k + 1) % 16;
+			} else if ((k >= 32) && (k < 48)) {
+				f = w[1] ^ w[2] ^ w[3];
+				g = (3 * k + 5) % 16;
+			} else {
+				f = w[2] ^ (w[1] | ~w[3]);
+				g = 7 * k % 16;
+			}
+
+			temp = w[3];
+			w[3] = w[2];
+			w[2] = w[1];
+			w[1] += rotl_uint32(w[0] + f + md5_sbox[k] +
+			    sched_arr[g], md5_shift[k]);
+			w[0] = temp;
 		}
 
-		temp = w[3];
-		w[3] = w[2];
-		w[2] = w[1];
-		w[1] += rotl_uint32(w[0] + f + md5_sbox[k] +
-		    uint32_t_byteorder_swap(sched_arr[g]),
-		    md5_shift[k]);
-		w[0] = temp;
-	}
+		for (uint8_t k = 0; k < HASH_MD5 / 4; k++)
+			h[k] += w[k];
 
-	for (uint8_t k = 0; k < HASH_MD5 / 4; k++)
-		h[k] += w[k];
+		data += HASH_BLOCK_LENGTH;
+	}
 }
 
 /** Working procedure of SHA-1 cryptographic hash function.
  *
- * @param h         Working array with interim hash parts values.
- * @param sched_arr Input array with scheduled values from input string.
+ * @param h      Working array with interim hash parts values.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
  *
  */
-static void sha1_proc(uint32_t *h, uint32_t *sched_arr)
+static void sha1_proc(uint32_t *h, const uint8_t *data, size_t blocks)
 {
 	uint32_t f, cf, temp;
 	uint32_t w[HASH_SHA1 / 4];
+	uint32_t sched_arr[80];
+
+	for (size_t i = 0; i < blocks; i++) {
+		for (size_t k = 0; k < 16; k++)
+			sched_arr[k] = load_be32(data + 4 * k);
+
+		for (size_t k = 16; k < 80; k++) {
+			sched_arr[k] = rotl_uint32(
+			    sched_arr[k - 3] ^
+			    sched_arr[k - 8] ^
+			    sched_arr[k - 14] ^
+			    sched_arr[k - 16],
+			    1);
+		}
+
+		memcpy(w, h, (HASH_SHA1 / 4) * sizeof(uint32_t));
+
+		for (size_t k = 0; k < 80; k++) {
+			if (k < 20) {
+				f = (w[1] & w[2]) | (~w[1] & w[3]);
+				cf = 0x5A827999;
+			} else if ((k >= 20) && (k < 40)) {
+				f = w[1] ^ w[2] ^ w[3];
+				cf = 0x6ed9eba1;
+			} else if ((k >= 40) && (k < 60)) {
+				f = (w[1] & w[2]) | (w[1] & w[3]) | (w[2] & w[3]);
+				cf = 0x8f1bbcdc;
+			} else {
+				f = w[1] ^ w[2] ^ w[3];
+				cf = 0xca62c1d6;
+			}
+
+			temp = rotl_uint32(w[0], 5) + f + w[4] + cf + sched_arr[k];
 
-	for (size_t k = 16; k < 80; k++) {
-		sched_arr[k] = rotl_uint32(
-		    sched_arr[k - 3] ^
-		    sched_arr[k - 8] ^
-		    sched_arr[k - 14] ^
-		    sched_arr[k - 16],
-		    1);
+			w[4] = w[3];
+			w[3] = w[2];
+			w[2] = rotl_uint32(w[1], 30);
+			w[1] = w[0];
+			w[0] = temp;
+		}
+
+		for (uint8_t k = 0; k < HASH_SHA1 / 4; k++)
+			h[k] += w[k];
+
+		data += HASH_BLOCK_LENGTH;
 	}
+}
+
+/** Working procedure of SHA-256 cryptographic hash function.
+ *
+ * @param h      Working array with interim hash parts values.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
+ *
+ */
+static void sha256_proc(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+	uint32_t w[HASH_SHA256 / 4];
+	uint32_t sched_arr[64];
 
-	memcpy(w, h, (HASH_SHA1 / 4) * sizeof(uint32_t));
-
-	for (size_t k = 0; k < 80; k++) {
-		if (k < 20) {
-			f = (w[1] & w[2]) | (~w[1] & w[3]);
-			cf = 0x5A827999;
-		} else if ((k >= 20) && (k < 40)) {
-			f = w[1] ^ w[2] ^ w[3];
-			cf = 0x6ed9eba1;
-		} else if ((k >= 40) && (k < 60)) {
-			f = (w[1] & w[2]) | (w[1] & w[3]) | (w[2] & w[3]);
-			cf = 0x8f1bbcdc;
-		} else {
-			f = w[1] ^ w[2] ^ w[3];
-			cf = 0xca62c1d6;
+	for (size_t i = 0; i < blocks; i++) {
+		for (size_t k = 0; k < 16; k++)
+			sched_arr[k] = load_be32(data + 4 * k);
+
+		for (size_t k = 16; k < 64; k++) {
+			uint32_t s0 = rotr_uint32(sched_arr[k - 15], 7) ^
+			    rotr_uint32(sched_arr[k - 15], 18) ^
+			    (sched_arr[k - 15] >> 3);
+			uint32_t s1 = rotr_uint32(sched_arr[k - 2], 17) ^
+			    rotr_uint32(sched_arr[k - 2], 19) ^
+			    (sched_arr[k - 2] >> 10);
+
+			sched_arr[k] = sched_arr[k - 16] + s0 +
+			    sched_arr[k - 7] + s1;
+		}
+
+		memcpy(w, h, (HASH_SHA256 / 4) * sizeof(uint32_t));
+
+		for (size_t k = 0; k < 64; k++) {
+			uint32_t s1 = rotr_uint32(w[4], 6) ^
+			    rotr_uint32(w[4], 11) ^ rotr_uint32(w[4], 25);
+			uint32_t ch = (w[4] & w[5]) ^ (~w[4] & w[6]);
+			uint32_t temp1 = w[7] + s1 + ch + sha256_k[k] +
+			    sched_arr[k];
+			uint32_t s0 = rotr_uint32(w[0], 2) ^
+			    rotr_uint32(w[0], 13) ^ rotr_uint32(w[0], 22);
+			uint32_t maj = (w[0] & w[1]) ^ (w[0] & w[2]) ^
+			    (w[1] & w[2]);
+			uint32_t temp2 = s0 + maj;
+
+			w[7] = w[6];
+			w[6] = w[5];
+			w[5] = w[4];
+			w[4] = w[3] + temp1;
+			w[3] = w[2];
+			w[2] = w[1];
+			w[1] = w[0];
+			w[0] = temp1 + temp2;
 		}
 
-		temp = rotl_uint32(w[0], 5) + f + w[4] + cf + sched_arr[k];
+		for (uint8_t k = 0; k < HASH_SHA256 / 4; k++)
+			h[k] += w[k];
 
-		w[4] = w[3];
-		w[3] = w[2];
-		w[2] = rotl_uint32(w[1], 30);
-		w[1] = w[0];
-		w[0] = temp;
+		data += HASH_BLOCK_LENGTH;
 	}
+}
 
-	for (uint8_t k = 0; k < HASH_SHA1 / 4; k++)
-		h[k] += w[k];
+/** Working procedure of SHA-512 cryptographic hash function.
+ *
+ * @param h      Working array with interim hash parts values.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
+ *
+ */
+static void sha512_proc(uint64_t *h, const uint8_t *data, size_t blocks)
+{
+	uint64_t w[HASH_SHA512 / 8];
+	uint64_t sched_arr[80];
+
+	for (size_t i = 0; i < blocks; i++) {
+		for (size_t k = 0; k < 16; k++)
+			sched_arr[k] = load_be64(data + 8 * k);
+
+		for (size_t k = 16; k < 80; k++) {
+			uint64_t s0 = rotr_uint64(sched_arr[k - 15], 1) ^
+			    rotr_uint64(sched_arr[k - 15], 8) ^
+			    (sched_arr[k - 15] >> 7);
+			uint64_t s1 = rotr_uint64(sched_arr[k - 2], 19) ^
+			    rotr_uint64(sched_arr[k - 2], 61) ^
+			    (sched_arr[k - 2] >> 6);
+
+			sched_arr[k] = sched_arr[k - 16] + s0 +
+			    sched_arr[k - 7] + s1;
+		}
+
+		memcpy(w, h, (HASH_SHA512 / 8) * sizeof(uint64_t));
+
+		for (size_t k = 0; k < 80; k++) {
+			uint64_t s1 = rotr_uint64(w[4], 14) ^
+			    rotr_uint64(w[4], 18) ^ rotr_uint64(w[4], 41);
+			uint64_t ch = (w[4] & w[5]) ^ (~w[4] & w[6]);
+			uint64_t temp1 = w[7] + s1 + ch + sha512_k[k] +
+			    sched_arr[k];
+			uint64_t s0 = rotr_uint64(w[0], 28) ^
+			    rotr_uint64(w[0], 34) ^ rotr_uint64(w[0], 39);
+			uint64_t maj = (w[0] & w[1]) ^ (w[0] & w[2]) ^
+			    (w[1] & w[2]);
+			uint64_t temp2 = s0 + maj;
+
+			w[7] = w[6];
+			w[6] = w[5];
+			w[5] = w[4];
+			w[4] = w[3] + temp1;
+			w[3] = w[2];
+			w[2] = w[1];
+			w[1] = w[0];
+			w[0] = temp1 + temp2;
+		}
+
+		for (uint8_t k = 0; k < HASH_SHA512 / 8; k++)
+			h[k] += w[k];
+
+		data += 2 * HASH_BLOCK_LENGTH;
+	}
+}
+
+#ifdef __x86_64__
+
+/** Four 32-bit lanes held in an XMM register. */
+typedef uint32_t xmm_t __attribute__((vector_size(16)));
+
+/** Load four big-endian words into vector lanes 0 to 3. */
+static inline xmm_t xmm_load_be(const uint8_t *data)
+{
+	return (xmm_t) {
+		load_be32(data), load_be32(data + 4),
+		load_be32(data + 8), load_be32(data + 12)
+	};
+}
+
+/** Load four big-endian words into vector lanes 3 to 0. */
+static inline xmm_t xmm_load_be_rev(const uint8_t *data)
+{
+	return (xmm_t) {
+		load_be32(data + 12), load_be32(data + 8),
+		load_be32(data + 4), load_be32(data)
+	};
+}
+
+/** Perform four rounds of SHA-1 with round function selected by @a func. */
+static inline xmm_t sha1_rnds4(xmm_t abcd, xmm_t e, unsigned int func)
+{
+	switch (func) {
+	case 0:
+		asm ("sha1rnds4 $0, %[e], %[abcd]\n"
+		    : [abcd] "+x" (abcd) : [e] "x" (e));
+		break;
+	case 1:
+		asm ("sha1rnds4 $1, %[e], %[abcd]\n"
+		    : [abcd] "+x" (abcd) : [e] "x" (e));
+		break;
+	case 2:
+		asm ("sha1rnds4 $2, %[e], %[abcd]\n"
+		    : [abcd] "+x" (abcd) : [e] "x" (e));
+		break;
+	default:
+		asm ("sha1rnds4 $3, %[e], %[abcd]\n"
+		    : [abcd] "+x" (abcd) : [e] "x" (e));
+		break;
+	}
+
+	return abcd;
+}
+
+/** Compute next SHA-1 state variable E and add it to scheduled words. */
+static inline xmm_t sha1_nexte(xmm_t e, xmm_t msg)
+{
+	asm ("sha1nexte %[msg], %[e]\n" : [e] "+x" (e) : [msg] "x" (msg));
+	return e;
+}
+
+/** Perform intermediate SHA-1 message schedule calculation. */
+static inline xmm_t sha1_msg1(xmm_t a, xmm_t b)
+{
+	asm ("sha1msg1 %[b], %[a]\n" : [a] "+x" (a) : [b] "x" (b));
+	return a;
+}
+
+/** Perform final SHA-1 message schedule calculation. */
+static inline xmm_t sha1_msg2(xmm_t a, xmm_t b)
+{
+	asm ("sha1msg2 %[b], %[a]\n" : [a] "+x" (a) : [b] "x" (b));
+	return a;
+}
+
+/** Perform two rounds of SHA-256 (the message is taken from XMM0). */
+static inline xmm_t sha256_rnds2(xmm_t cdgh, xmm_t abef, xmm_t msg)
+{
+	asm ("sha256rnds2 %[msg], %[abef], %[cdgh]\n"
+	    : [cdgh] "+x" (cdgh) : [abef] "x" (abef), [msg] "Yz" (msg));
+	return cdgh;
+}
+
+/** Perform intermediate SHA-256 message schedule calculation. */
+static inline xmm_t sha256_msg1(xmm_t a, xmm_t b)
+{
+	asm ("sha256msg1 %[b], %[a]\n" : [a] "+x" (a) : [b] "x" (b));
+	return a;
+}
+
+/** Perform final SHA-256 message schedule calculation. */
+static inline xmm_t sha256_msg2(xmm_t a, xmm_t b)
+{
+	asm ("sha256msg2 %[b], %[a]\n" : [a] "+x" (a) : [b] "x" (b));
+	return a;
+}
+
+/** SHA-1 using the SHA extensions instructions.
+ *
+ * @param h      Working array with interim hash parts values.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
+ *
+ */
+static void sha1_proc_shani(uint32_t *h, const uint8_t *data, size_t blocks)
+{
+	xmm_t abcd = { h[3], h[2], h[1], h[0] };
+	xmm_t e0 = { 0, 0, 0, h[4] };
+	xmm_t e[2];
+	xmm_t msg[4];
+
+	for (size_t i = 0; i < blocks; i++) {
+		xmm_t abcd_save = abcd;
+		xmm_t e0_save = e0;
+
+		for (size_t k = 0; k < 4; k++)
+			msg[k] = xmm_load_be_rev(data + 16 * k);
+
+		e[0] = e0 + msg[0];
+
+		for (unsigned int k = 0; k < 20; k++) {
+			if (k > 0)
+				e[k % 2] = sha1_nexte(e[k % 2], msg[k % 4]);
+
+			e[(k + 1) % 2] = abcd;
+
+			if ((k >= 3) && (k <= 18))
+				msg[(k + 1) % 4] = sha1_msg2(msg[(k + 1) % 4],
+				    msg[k % 4]);
+
+			abcd = sha1_rnds4(abcd, e[k % 2], k / 5);
+
+			if ((k >= 1) && (k <= 16))
+				msg[(k - 1) % 4] = sha1_msg1(msg[(k - 1) % 4],
+				    msg[k % 4]);
+
+			if ((k >= 2) && (k <= 17))
+				msg[(k - 2) % 4] ^= msg[k % 4];
+		}
+
+		e0 = sha1_nexte(e[0], e0_save);
+		abcd += abcd_save;
+
+		data += HASH_BLOCK_LENGTH;
+	}
+
+	h[0] = abcd[3];
+	h[1] = abcd[2];
+	h[2] = abcd[1];
+	h[3] = abcd[0];
+	h[4] = e0[3];
+}
+
+/** SHA-256 using the SHA extensions instructions.
+ *
+ * @param h      Working array with interim hash parts values.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
+ *
+ */
+static void sha256_proc_shani(uint32_t *h, const uint8_t *data,
+    size_t blocks)
+{
+	xmm_t abef = { h[5], h[4], h[1], h[0] };
+	xmm_t cdgh = { h[7], h[6], h[3], h[2] };
+	xmm_t msg[4];
+
+	for (size_t i = 0; i < blocks; i++) {
+		xmm_t abef_save = abef;
+		xmm_t cdgh_save = cdgh;
+
+		for (size_t k = 0; k < 4; k++)
+			msg[k] = xmm_load_be(data + 16 * k);
+
+		for (unsigned int k = 0; k < 16; k++) {
+			xmm_t wk = msg[k % 4] + (xmm_t) {
+				sha256_k[4 * k], sha256_k[4 * k + 1],
+				sha256_k[4 * k + 2], sha256_k[4 * k + 3]
+			};
+
+			cdgh = sha256_rnds2(cdgh, abef, wk);
+
+			if ((k >= 3) && (k <= 14)) {
+				/* Words W[t-7] from the two previous groups */
+				xmm_t w7 = __builtin_shuffle(msg[(k - 1) % 4],
+				    msg[k % 4], (xmm_t) { 1, 2, 3, 4 });
+
+				msg[(k + 1) % 4] = sha256_msg2(
+				    msg[(k + 1) % 4] + w7, msg[k % 4]);
+			}
+
+			wk = __builtin_shuffle(wk, (xmm_t) { 2, 3, 0, 0 });
+			abef = sha256_rnds2(abef, cdgh, wk);
+
+			if ((k >= 1) && (k <= 12))
+				msg[(k - 1) % 4] = sha256_msg1(msg[(k - 1) % 4],
+				    msg[k % 4]);
+		}
+
+		abef += abef_save;
+		cdgh += cdgh_save;
+
+		data += HASH_BLOCK_LENGTH;
+	}
+
+	h[0] = abef[3];
+	h[1] = abef[2];
+	h[2] = cdgh[3];
+	h[3] = cdgh[2];
+	h[4] = abef[1];
+	h[5] = abef[0];
+	h[6] = cdgh[1];
+	h[7] = cdgh[0];
+}
+
+#endif
+
+/** Get length of block processed by hash function.
+ *
+ * @param func Hash function.
+ *
+ * @return Block length in bytes.
+ *
+ */
+static size_t hash_block_length(hash_func_t func)
+{
+	return (func == HASH_SHA512) ? 2 * HASH_BLOCK_LENGTH :
+	    HASH_BLOCK_LENGTH;
+}
+
+/** Process complete blocks of data.
+ *
+ * @param ctx    Hash context.
+ * @param data   Input blocks.
+ * @param blocks Number of input blocks.
+ *
+ */
+static void hash_blocks(hash_ctx_t *ctx, const uint8_t *data, size_t blocks)
+{
+	switch (ctx->func) {
+	case HASH_MD5:
+		md5_proc(ctx->state.h32, data, blocks);
+		break;
+	case HASH_SHA1:
+#ifdef __x86_64__
+		if (ctx->shani) {
+			sha1_proc_shani(ctx->state.h32, data, blocks);
+			break;
+		}
+#endif
+		sha1_proc(ctx->state.h32, data, blocks);
+		break;
+	case HASH_SHA256:
+#ifdef __x86_64__
+		if (ctx->shani) {
+			sha256_proc_shani(ctx->state.h32, data, blocks);
+			break;
+		}
+#endif
+		sha256_proc(ctx->state.h32, data, blocks);
+		break;
+	case HASH_SHA512:
+		sha512_proc(ctx->state.h64, data, blocks);
+		break;
+	}
+}
+
+/** Initialize incremental hash computation.
+ *
+ * @param ctx      Hash context to be initialized.
+ * @param hash_sel Hash function selector.
+ *
+ * @return EINVAL when the hash function is not supported,
+ *         otherwise EOK.
+ *
+ */
+errno_t hash_init(hash_ctx_t *ctx, hash_func_t hash_sel)
+{
+	switch (hash_sel) {
+	case HASH_MD5:
+	case HASH_SHA1:
+		memcpy(ctx->state.h32, hash_init_values, hash_sel);
+		break;
+	case HASH_SHA256:
+		memcpy(ctx->state.h32, sha256_init, sizeof(sha256_init));
+		break;
+	case HASH_SHA512:
+		memcpy(ctx->state.h64, sha512_init, sizeof(sha512_init));
+		break;
+	default:
+		return EINVAL;
+	}
+
+	ctx->func = hash_sel;
+	ctx->buffer_len = 0;
+	ctx->length = 0;
+	ctx->shani = ((hash_sel == HASH_SHA1) || (hash_sel == HASH_SHA256)) &&
+	    cpu_has_shani();
+
+	return EOK;
+}
+
+/** Add data to incremental hash computation.
+ *
+ * @param ctx  Hash context.
+ * @param data Input data.
+ * @param size Size of input data.
+ *
+ */
+void hash_update(hash_ctx_t *ctx, const void *data, size_t size)
+{
+	const uint8_t *input = data;
+	const size_t block_len = hash_block_length(ctx->func);
+
+	ctx->length += size;
+
+	if (ctx->buffer_len > 0) {
+		size_t fill = min(block_len - ctx->buffer_len, size);
+
+		memcpy(ctx->buffer + ctx->buffer_len, input, fill);
+		ctx->buffer_len += fill;
+		input += fill;
+		size -= fill;
+
+		if (ctx->buffer_len < block_len)
+			return;
+
+		hash_blocks(ctx, ctx->buffer, 1);
+		ctx->buffer_len = 0;
+	}
+
+	/* Process complete blocks directly from the input */
+	size_t blocks = size / block_len;
+	if (blocks > 0) {
+		hash_blocks(ctx, input, blocks);
+		input += blocks * block_len;
+		size -= blocks * block_len;
+	}
+
+	if (size > 0) {
+		memcpy(ctx->buffer, input, size);
+		ctx->buffer_len = size;
+	}
+}
+
+/** Finish incremental hash computation.
+ *
+ * The context has to be initialized again before further use.
+ *
+ * @param ctx    Hash context.
+ * @param output Output buffer for hash result (length given
+ *               by the hash function selector).
+ *
+ */
+void hash_final(hash_ctx_t *ctx, uint8_t *output)
+{
+	const size_t block_len = hash_block_length(ctx->func);
+	const size_t len_size = (ctx->func == HASH_SHA512) ? 16 : 8;
+	const uint64_t bits_size = ctx->length * 8;
+
+	ctx->buffer[ctx->buffer_len++] = 0x80;
+
+	if (ctx->buffer_len > block_len - len_size) {
+		memset(ctx->buffer + ctx->buffer_len, 0,
+		    block_len - ctx->buffer_len);
+		hash_blocks(ctx, ctx->buffer, 1);
+		ctx->buffer_len = 0;
+	}
+
+	memset(ctx->buffer + ctx->buffer_len, 0, block_len - ctx->buffer_len);
+
+	if (ctx->func == HASH_MD5) {
+		store_le32(ctx->buffer + block_len - 8, bits_size);
+		store_le32(ctx->buffer + block_len - 4, bits_size >> 32);
+	} else {
+		store_be64(ctx->buffer + block_len - 8, bits_size);
+		if (ctx->func == HASH_SHA512)
+			store_be64(ctx->buffer + block_len - 16, ctx->length >> 61);
+	}
+
+	hash_blocks(ctx, ctx->buffer, 1);
+
+	/* Copy hash parts into final result. */
+	switch (ctx->func) {
+	case HASH_MD5:
+		for (size_t i = 0; i < HASH_MD5 / 4; i++)
+			store_le32(output + 4 * i, ctx->state.h32[i]);
+		break;
+	case HASH_SHA1:
+	case HASH_SHA256:
+		for (size_t i = 0; i < ctx->func / 4; i++)
+			store_be32(output + 4 * i, ctx->state.h32[i]);
+		break;
+	case HASH_SHA512:
+		for (size_t i = 0; i < HASH_SHA512 / 8; i++)
+			store_be64(output + 8 * i, ctx->state.h64[i]);
+		break;
+	}
 }
 
 /** Create hash based on selected algorithm.
@@ -190,15 +831,15 @@ static void sha1_proc(uint32_t *h, uint32_t *sched_arr)
  * @param output     Result hash byte sequence.
  * @param hash_sel   Hash function selector.
  *
- * @return EINVAL when input not specified,
- *         ENOMEM when pointer for output hash result
+ * @return EINVAL when input not specified or hash function
+ *         not supported, ENOMEM when pointer for output hash result
  *         is not allocated, otherwise EOK.
  *
  */
 errno_t create_hash(uint8_t *input, size_t input_size, uint8_t *output,
     hash_func_t hash_sel)
 {
-	assert(input_size < SSIZE_MAX);
+	hash_ctx_t ctx;
 
 	if (!input)
 		return EINVAL;
@@ -206,55 +847,104 @@ errno_t create_hash(uint8_t *input, size_t input_size, uint8_t *output,
 	if (!output)
 		return ENOMEM;
 
-	hash_fnc_t hash_func = (hash_sel == HASH_MD5) ? md5_proc : sha1_proc;
+	errno_t rc = hash_init(&ctx, hash_sel);
+	if (rc != EOK)
+		return rc;
 
-	/* Prepare scheduled input. */
-	uint8_t work_input[input_size + 1];
-	memcpy(work_input, input, input_size);
-	work_input[input_size] = 0x80;
+	hash_update(&ctx, input, input_size);
+	hash_final(&ctx, output);
 
-	// FIXME: double?
-	size_t blocks = ceil_uint32((((double) input_size + 1) / 4 + 2) / 16);
-	uint32_t work_arr[blocks * 16];
-	for (size_t i = 0; i < blocks; i++) {
-		for (size_t j = 0; j < 16; j++) {
-			work_arr[i * 16 + j] =
-			    (get_at(work_input, input_size + 1, i * 64 + j * 4) << 24) |
-			    (get_at(work_input, input_size + 1, i * 64 + j * 4 + 1) << 16) |
-			    (get_at(work_input, input_size + 1, i * 64 + j * 4 + 2) << 8) |
-			    get_at(work_input, input_size + 1, i * 64 + j * 4 + 3);
-		}
-	}
+	return EOK;
+}
+
+/** Initialize incremental HMAC computation.
+ *
+ * The hash states after processing the inner and outer key pads
+ * are precomputed so that the context can be used for computing
+ * HMAC of any number of messages without processing the key again.
+ *
+ * @param ctx      HMAC context to be initialized.
+ * @param key      Cryptographic key sequence.
+ * @param key_size Size of key sequence.
+ * @param hash_sel Hash function selector.
+ *
+ * @return EINVAL when key not specified or hash function
+ *         not supported, otherwise EOK.
+ *
+ */
+errno_t hmac_init(hmac_ctx_t *ctx, const uint8_t *key, size_t key_size,
+    hash_func_t hash_sel)
+{
+	uint8_t work_key[HASH_MAX_BLOCK_LENGTH];
+	uint8_t key_pad[HASH_MAX_BLOCK_LENGTH];
 
-	uint64_t bits_size = (uint64_t) (input_size * 8);
-	if (hash_sel == HASH_MD5)
-		bits_size = uint64_t_byteorder_swap(bits_size);
+	if (!key)
+		return EINVAL;
 
-	work_arr[(blocks - 1) * 16 + 14] = bits_size >> 32;
-	work_arr[(blocks - 1) * 16 + 15] = bits_size & 0xffffffff;
+	errno_t rc = hash_init(&ctx->inner_init, hash_sel);
+	if (rc != EOK)
+		return rc;
 
-	/* Hash computation. */
-	uint32_t h[hash_sel / 4];
-	memcpy(h, hash_init, (hash_sel / 4) * sizeof(uint32_t));
-	uint32_t sched_arr[80];
-	for (size_t i = 0; i < blocks; i++) {
-		for (size_t k = 0; k < 16; k++)
-			sched_arr[k] = work_arr[i * 16 + k];
+	const size_t block_len = hash_block_length(hash_sel);
+	memset(work_key, 0, block_len);
 
-		hash_func(h, sched_arr);
-	}
+	if (key_size > block_len) {
+		hash_update(&ctx->inner_init, key, key_size);
+		hash_final(&ctx->inner_init, work_key);
+		(void) hash_init(&ctx->inner_init, hash_sel);
+	} else
+		memcpy(work_key, key, key_size);
 
-	/* Copy hash parts into final result. */
-	for (size_t i = 0; i < hash_sel / 4; i++) {
-		if (hash_sel == HASH_SHA1)
-			h[i] = uint32_t_byteorder_swap(h[i]);
+	ctx->outer_init = ctx->inner_init;
 
-		memcpy(output + i * sizeof(uint32_t), &h[i], sizeof(uint32_t));
-	}
+	for (size_t i = 0; i < block_len; i++)
+		key_pad[i] = work_key[i] ^ 0x36;
+
+	hash_update(&ctx->inner_init, key_pad, block_len);
+
+	for (size_t i = 0; i < block_len; i++)
+		key_pad[i] = work_key[i] ^ 0x5c;
 
+	hash_update(&ctx->outer_init, key_pad, block_len);
+
+	ctx->inner = ctx->inner_init;
 	return EOK;
 }
 
+/** Add message data to incremental HMAC computation.
+ *
+ * @param ctx  HMAC context.
+ * @param msg  Message data.
+ * @param size Size of message data.
+ *
+ */
+void hmac_update(hmac_ctx_t *ctx, const void *msg, size_t size)
+{
+	hash_update(&ctx->inner, msg, size);
+}
+
+/** Finish incremental HMAC computation.
+ *
+ * The context is reset to compute HMAC of another message
+ * with the same key.
+ *
+ * @param ctx  HMAC context.
+ * @param hash Output buffer for HMAC result (length given
+ *             by the hash function selector).
+ *
+ */
+void hmac_final(hmac_ctx_t *ctx, uint8_t *hash)
+{
+	uint8_t temp_hash[HASH_MAX_LENGTH];
+	hash_ctx_t outer = ctx->outer_init;
+
+	hash_final(&ctx->inner, temp_hash);
+	hash_update(&outer, temp_hash, ctx->inner.func);
+	hash_final(&outer, hash);
+
+	ctx->inner = ctx->inner_init;
+}
+
 /** Hash-based message authentication code.
  *
  * @param key      Cryptographic key sequence.
@@ -272,39 +962,85 @@ errno_t create_hash(uint8_t *input, size_t input_size, uint8_t *output,
 errno_t hmac(uint8_t *key, size_t key_size, uint8_t *msg, size_t msg_size,
     uint8_t *hash, hash_func_t hash_sel)
 {
+	hmac_ctx_t ctx;
+
 	if ((!key) || (!msg))
 		return EINVAL;
 
 	if (!hash)
 		return ENOMEM;
 
-	uint8_t work_key[HMAC_BLOCK_LENGTH];
-	uint8_t o_key_pad[HMAC_BLOCK_LENGTH];
-	uint8_t i_key_pad[HMAC_BLOCK_LENGTH];
-	uint8_t temp_hash[hash_sel];
-	memset(work_key, 0, HMAC_BLOCK_LENGTH);
+	errno_t rc = hmac_init(&ctx, key, key_size, hash_sel);
+	if (rc != EOK)
+		return rc;
 
-	if (key_size > HMAC_BLOCK_LENGTH)
-		create_hash(key, key_size, work_key, hash_sel);
-	else
-		memcpy(work_key, key, key_size);
+	hmac_update(&ctx, msg, msg_size);
+	hmac_final(&ctx, hash);
 
-	for (size_t i = 0; i < HMAC_BLOCK_LENGTH; i++) {
-		o_key_pad[i] = work_key[i] ^ 0x5c;
-		i_key_pad[i] = work_key[i] ^ 0x36;
-	}
+	return EOK;
+}
 
-	uint8_t temp_work[HMAC_BLOCK_LENGTH + max(msg_size, hash_sel)];
-	memcpy(temp_work, i_key_pad, HMAC_BLOCK_LENGTH);
-	memcpy(temp_work + HMAC_BLOCK_LENGTH, msg, msg_size);
+/** Password-Based Key Derivation Function 2.
+ *
+ * As defined in RFC 2898 with a selectable HMAC hash function.
+ * The password is processed only once, all iterations reuse
+ * the precomputed HMAC context.
+ *
+ * @param hash_sel   Hash function selector.
+ * @param pass       Password sequence.
+ * @param pass_size  Password sequence length.
+ * @param salt       Salt sequence to be used with password.
+ * @param salt_size  Salt sequence length.
+ * @param iterations Number of iterations.
+ * @param output     Output parameter for derived key.
+ * @param output_len Length of derived key.
+ *
+ * @return EINVAL when pass or salt not specified, number of
+ *         iterations is zero or hash function not supported,
+ *         ENOMEM when pointer for output is not allocated,
+ *         otherwise EOK.
+ *
+ */
+errno_t pbkdf2_hmac(hash_func_t hash_sel, const uint8_t *pass,
+    size_t pass_size, const uint8_t *salt, size_t salt_size,
+    unsigned int iterations, uint8_t *output, size_t output_len)
+{
+	hmac_ctx_t ctx;
+	uint8_t work_hmac[HASH_MAX_LENGTH];
+	uint8_t xor_hmac[HASH_MAX_LENGTH];
+	uint8_t be_i[4];
 
-	create_hash(temp_work, HMAC_BLOCK_LENGTH + msg_size, temp_hash,
-	    hash_sel);
+	if ((!pass) || (!salt) || (iterations == 0))
+		return EINVAL;
+
+	if (!output)
+		return ENOMEM;
+
+	errno_t rc = hmac_init(&ctx, pass, pass_size, hash_sel);
+	if (rc != EOK)
+		return rc;
 
-	memcpy(temp_work, o_key_pad, HMAC_BLOCK_LENGTH);
-	memcpy(temp_work + HMAC_BLOCK_LENGTH, temp_hash, hash_sel);
+	for (uint32_t i = 1; output_len > 0; i++) {
+		store_be32(be_i, i);
 
-	create_hash(temp_work, HMAC_BLOCK_LENGTH + hash_sel, hash, hash_sel);
+		hmac_update(&ctx, salt, salt_size);
+		hmac_update(&ctx, be_i, 4);
+		hmac_final(&ctx, work_hmac);
+		memcpy(xor_hmac, work_hmac, hash_sel);
+
+		for (unsigned int k = 1; k < iterations; k++) {
+			hmac_update(&ctx, work_hmac, hash_sel);
+			hmac_final(&ctx, work_hmac);
+
+			for (size_t t = 0; t < hash_sel; t++)
+				xor_hmac[t] ^= work_hmac[t];
+		}
+
+		size_t len = min(output_len, (size_t) hash_sel);
+		memcpy(output, xor_hmac, len);
+		output += len;
+		output_len -= len;
+	}
 
 	return EOK;
 }
@@ -328,40 +1064,6 @@ errno_t hmac(uint8_t *key, size_t key_size, uint8_t *msg, size_t msg_size,
 errno_t pbkdf2(uint8_t *pass, size_t pass_size, uint8_t *salt, size_t salt_size,
     uint8_t *hash)
 {
-	if ((!pass) || (!salt))
-		return EINVAL;
-
-	if (!hash)
-		return ENOMEM;
-
-	uint8_t work_salt[salt_size + 4];
-	memcpy(work_salt, salt, salt_size);
-	uint8_t work_hmac[HASH_SHA1];
-	uint8_t temp_hmac[HASH_SHA1];
-	uint8_t xor_hmac[HASH_SHA1];
-	uint8_t temp_hash[HASH_SHA1 * 2];
-
-	for (size_t i = 0; i < 2; i++) {
-		uint32_t be_i = host2uint32_t_be(i + 1);
-
-		memcpy(work_salt + salt_size, &be_i, 4);
-		hmac(pass, pass_size, work_salt, salt_size + 4,
-		    work_hmac, HASH_SHA1);
-		memcpy(xor_hmac, work_hmac, HASH_SHA1);
-
-		for (size_t k = 1; k < 4096; k++) {
-			memcpy(temp_hmac, work_hmac, HASH_SHA1);
-			hmac(pass, pass_size, temp_hmac, HASH_SHA1,
-			    work_hmac, HASH_SHA1);
-
-			for (size_t t = 0; t < HASH_SHA1; t++)
-				xor_hmac[t] ^= work_hmac[t];
-		}
-
-		memcpy(temp_hash + i * HASH_SHA1, xor_hmac, HASH_SHA1);
-	}
-
-	memcpy(hash, temp_hash, PBKDF2_KEY_LENGTH);
-
-	return EOK;
+	return pbkdf2_hmac(HASH_SHA1, pass, pass_size, salt, salt_size, 4096,
+	    hash, PBKDF2_KEY_LENGTH);
 }
@@ -30,12 +30,33 @@
 #define LIBCRYPTO_H
 
 #include <errno.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #define AES_CIPHER_LENGTH  16
 #define PBKDF2_KEY_LENGTH  32
 
+/** Maximal number of AES rounds (AES-256). */
+#define AES_MAX_ROUNDS  14
+
+/** AES cipher context with expanded key schedule. */
+typedef struct {
+	/** Encryption round keys. */
+	uint32_t enc_key[4 * (AES_MAX_ROUNDS + 1)];
+	/** Decryption round keys (equivalent inverse cipher). */
+	uint32_t dec_key[4 * (AES_MAX_ROUNDS + 1)];
+	/** Number of rounds. */
+	unsigned rounds;
+	/** Use AES-NI instructions. */
+	bool aesni;
+#ifdef __x86_64__
+	/** Round keys in the byte order used by AES-NI. */
+	uint8_t aesni_enc_key[16 * (AES_MAX_ROUNDS + 1)];
+	uint8_t aesni_dec_key[16 * (AES_MAX_ROUNDS + 1)];
+#endif
+} aes_ctx_t;
+
 /* Left rotation for uint32_t. */
 #define rotl_uint32(val, shift) \
 	(((val) << shift) | ((val) >> (32 - shift)))
@@ -47,14 +68,80 @@
 /** Hash function selector and also result hash length indicator. */
 typedef enum {
 	HASH_MD5 =  16,
-	HASH_SHA1 = 20
+	HASH_SHA1 = 20,
+	HASH_SHA256 = 32,
+	HASH_SHA512 = 64
 } hash_func_t;
 
+/** Maximal length of hash result. */
+#define HASH_MAX_LENGTH  64
+
+/** Maximal length of block processed by hash function (SHA-512). */
+#define HASH_MAX_BLOCK_LENGTH  128
+
+/** Incremental hash computation context. */
+typedef struct {
+	/** Hash function. */
+	hash_func_t func;
+	/** Interim hash value. */
+	union {
+		uint32_t h32[8];
+		uint64_t h64[8];
+	} state;
+	/** Buffered data not forming a complete block yet. */
+	uint8_t buffer[HASH_MAX_BLOCK_LENGTH];
+	/** Number of bytes in buffer. */
+	size_t buffer_len;
+	/** Total number of bytes hashed. */
+	uint64_t length;
+	/** Use SHA extensions instructions. */
+	bool shani;
+} hash_ctx_t;
+
+/** Incremental HMAC computation context. */
+typedef struct {
+	/** Hash state after processing the inner key pad. */
+	hash_ctx_t inner_init;
+	/** Hash state after processing the outer key pad. */
+	hash_ctx_t outer_init;
+	/** Hash state of the current message. */
+	hash_ctx_t inner;
+} hmac_ctx_t;
+
 extern errno_t rc4(uint8_t *, size_t, uint8_t *, size_t, size_t, uint8_t *);
 extern errno_t aes_encrypt(uint8_t *, uint8_t *, uint8_t *);
 extern errno_t aes_decrypt(uint8_t *, uint8_t *, uint8_t *);
+extern errno_t aes_init(aes_ctx_t *, const uint8_t *, size_t);
+extern void aes_encrypt_block(aes_ctx_t *, const uint8_t *, uint8_t *);
+extern void aes_decrypt_block(aes_ctx_t *, const uint8_t *, uint8_t *);
+extern errno_t aes_cbc_encrypt(aes_ctx_t *, uint8_t *, const uint8_t *,
+    uint8_t *, size_t);
+extern errno_t aes_cbc_decrypt(aes_ctx_t *, uint8_t *, const uint8_t *,
+    uint8_t *, size_t);
+extern void aes_ctr_crypt(aes_ctx_t *, uint8_t *, const uint8_t *,
+    uint8_t *, size_t);
+extern errno_t aes_ccm_encrypt(aes_ctx_t *, const uint8_t *, size_t,
+    const uint8_t *, size_t, const uint8_t *, uint8_t *, size_t,
+    uint8_t *, size_t);
+extern errno_t aes_ccm_decrypt(aes_ctx_t *, const uint8_t *, size_t,
+    const uint8_t *, size_t, const uint8_t *, uint8_t *, size_t,
+    const uint8_t *, size_t);
+extern errno_t aes_gcm_encrypt(aes_ctx_t *, const uint8_t *, size_t,
+    const uint8_t *, size_t, const uint8_t *, uint8_t *, size_t,
+    uint8_t *, size_t);
+extern errno_t aes_gcm_decrypt(aes_ctx_t *, const uint8_t *, size_t,
+    const uint8_t *, size_t, const uint8_t *, uint8_t *, size_t,
+    const uint8_t *, size_t);
+extern errno_t hash_init(hash_ctx_t *, hash_func_t);
+extern void hash_update(hash_ctx_t *, const void *, size_t);
+extern void hash_final(hash_ctx_t *, uint8_t *);
 extern errno_t create_hash(uint8_t *, size_t, uint8_t *, hash_func_t);
+extern errno_t hmac_init(hmac_ctx_t *, const uint8_t *, size_t, hash_func_t);
+extern void hmac_update(hmac_ctx_t *, const void *, size_t);
+extern void hmac_final(hmac_ctx_t *, uint8_t *);
 extern errno_t hmac(uint8_t *, size_t, uint8_t *, size_t, uint8_t *, hash_func_t);
+extern errno_t pbkdf2_hmac(hash_func_t, const uint8_t *, size_t,
+    const uint8_t *, size_t, unsigned int, uint8_t *, size_t);
 extern errno_t pbkdf2(uint8_t *, size_t, uint8_t *, size_t, uint8_t *);
 
 extern uint16_t crc16_ibm(uint16_t crc, uint8_t *buf, size_t len);
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../crypto.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(aes);
+
+#define MAX_DATA  64
+
+/** Decode hexadecimal test vector */
+static size_t hex_decode(const char *hex, uint8_t *data)
+{
+	size_t len = 0;
+
+	while ((hex[0] != 0) && (hex[1] != 0)) {
+		uint8_t val = 0;
+
+		for (unsigned i = 0; i < 2; i++) {
+			char c = hex[i];
+			val <<= 4;
+
+			if ((c >= '0') && (c <= '9'))
+				val |= c - '0';
+			else
+				val |= c - 'a' + 10;
+		}
+
+		data[len++] = val;
+		hex += 2;
+	}
+
+	return len;
+}
+
+/** Encrypt and decrypt single block (FIPS 197 appendix C) */
+static void block_check(const char *key_hex, const char *cipher_hex)
+{
+	uint8_t key[32];
+	uint8_t plain[16];
+	uint8_t cipher[16];
+	uint8_t buf[16];
+	aes_ctx_t ctx;
+
+	size_t key_len = hex_decode(key_hex, key);
+	hex_decode("00112233445566778899aabbccddeeff", plain);
+	hex_decode(cipher_hex, cipher);
+
+	errno_t rc = aes_init(&ctx, key, key_len);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	aes_encrypt_block(&ctx, plain, buf);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, cipher, 16));
+
+	aes_decrypt_block(&ctx, buf, buf);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, plain, 16));
+}
+
+PCUT_TEST(block_128)
+{
+	block_check("000102030405060708090a0b0c0d0e0f",
+	    "69c4e0d86a7b0430d8cdb78070b4c55a");
+}
+
+PCUT_TEST(block_192)
+{
+	block_check("000102030405060708090a0b0c0d0e0f1011121314151617",
+	    "dda97ca4864cdfe06eaf70a0ec0d7191");
+}
+
+PCUT_TEST(block_256)
+{
+	block_check("000102030405060708090a0b0c0d0e0f"
+	    "101112131415161718191a1b1c1d1e1f",
+	    "8ea2b7ca516745bfeafc49904b496089");
+}
+
+PCUT_TEST(invalid_key)
+{
+	uint8_t key[32];
+	aes_ctx_t ctx;
+
+	memset(key, 0, sizeof(key));
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, aes_init(&ctx, key, 20));
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, aes_init(&ctx, NULL, 16));
+}
+
+PCUT_TEST(compat)
+{
+	uint8_t key[16];
+	uint8_t plain[16];
+	uint8_t cipher[16];
+	uint8_t buf[16];
+
+	hex_decode("000102030405060708090a0b0c0d0e0f", key);
+	hex_decode("00112233445566778899aabbccddeeff", plain);
+	hex_decode("69c4e0d86a7b0430d8cdb78070b4c55a", cipher);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_encrypt(key, plain, buf));
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, cipher, 16));
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_decrypt(key, cipher, buf));
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, plain, 16));
+}
+
+/** NIST SP 800-38A test key and plaintext */
+static const char *sp800_38a_key = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char *sp800_38a_plain =
+    "6bc1bee22e409f96e93d7e117393172a"
+    "ae2d8a571e03ac9c9eb76fac45af8e51"
+    "30c81c46a35ce411e5fbc1191a0a52ef"
+    "f69f2445df4f9b17ad2b417be66c3710";
+
+PCUT_TEST(cbc)
+{
+	uint8_t key[16];
+	uint8_t iv[16];
+	uint8_t plain[MAX_DATA];
+	uint8_t cipher[MAX_DATA];
+	uint8_t buf[MAX_DATA];
+	aes_ctx_t ctx;
+
+	hex_decode(sp800_38a_key, key);
+	size_t size = hex_decode(sp800_38a_plain, plain);
+	hex_decode("7649abac8119b246cee98e9b12e9197d"
+	    "5086cb9b507219ee95db113a917678b2"
+	    "73bed6b8e3c1743b7116e69e22229516"
+	    "3ff1caa1681fac09120eca307586e1a7", cipher);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_init(&ctx, key, 16));
+
+	hex_decode("000102030405060708090a0b0c0d0e0f", iv);
+	PCUT_ASSERT_ERRNO_VAL(EOK,
+	    aes_cbc_encrypt(&ctx, iv, plain, buf, size));
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, cipher, size));
+
+	/* Decrypt in place and in two chained calls */
+	hex_decode("000102030405060708090a0b0c0d0e0f", iv);
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_cbc_decrypt(&ctx, iv, buf, buf, 32));
+	PCUT_ASSERT_ERRNO_VAL(EOK,
+	    aes_cbc_decrypt(&ctx, iv, buf + 32, buf + 32, size - 32));
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, plain, size));
+
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, aes_cbc_encrypt(&ctx, iv, plain, buf, 15));
+}
+
+PCUT_TEST(ctr)
+{
+	uint8_t key[16];
+	uint8_t counter[16];
+	uint8_t plain[MAX_DATA];
+	uint8_t cipher[MAX_DATA];
+	uint8_t buf[MAX_DATA];
+	aes_ctx_t ctx;
+
+	hex_decode(sp800_38a_key, key);
+	size_t size = hex_decode(sp800_38a_plain, plain);
+	hex_decode("874d6191b620e3261bef6864990db6ce"
+	    "9806f66b7970fdff8617187bb9fffdff"
+	    "5ae4df3edbd5d35e5b4f09020db03eab"
+	    "1e031dda2fbe03d1792170a0f3009cee", cipher);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_init(&ctx, key, 16));
+
+	hex_decode("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", counter);
+	aes_ctr_crypt(&ctx, counter, plain, buf, size);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, cipher, size));
+
+	/* Partial last block */
+	hex_decode("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", counter);
+	aes_ctr_crypt(&ctx, counter, cipher, buf, size - 5);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, plain, size - 5));
+}
+
+/** Check CCM mode against NIST SP 800-38C example */
+static void ccm_check(const char *nonce_hex, const char *aad_hex,
+    const char *plain_hex, const char *cipher_hex, size_t tag_len)
+{
+	uint8_t key[16];
+	uint8_t nonce[16];
+	uint8_t aad[MAX_DATA];
+	uint8_t plain[MAX_DATA];
+	uint8_t cipher[MAX_DATA];
+	uint8_t buf[MAX_DATA];
+	uint8_t tag[16];
+	aes_ctx_t ctx;
+
+	hex_decode("404142434445464748494a4b4c4d4e4f", key);
+	size_t nonce_len = hex_decode(nonce_hex, nonce);
+	size_t aad_len = hex_decode(aad_hex, aad);
+	size_t size = hex_decode(plain_hex, plain);
+	hex_decode(cipher_hex, cipher);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_init(&ctx, key, 16));
+
+	errno_t rc = aes_ccm_encrypt(&ctx, nonce, nonce_len, aad, aad_len,
+	    plain, buf, size, tag, tag_len);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, cipher, size));
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(tag, cipher + size, tag_len));
+
+	rc = aes_ccm_decrypt(&ctx, nonce, nonce_len, aad, aad_len,
+	    cipher, buf, size, cipher + size, tag_len);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, plain, size));
+
+	/* Corrupted ciphertext has to be rejected */
+	cipher[0] ^= 1;
+	rc = aes_ccm_decrypt(&ctx, nonce, nonce_len, aad, aad_len,
+	    cipher, buf, size, cipher + size, tag_len);
+	PCUT_ASSERT_ERRNO_VAL(EBADCHECKSUM, rc);
+}
+
+PCUT_TEST(ccm_example1)
+{
+	ccm_check("10111213141516", "0001020304050607", "20212223",
+	    "7162015b4dac255d", 4);
+}
+
+PCUT_TEST(ccm_example2)
+{
+	ccm_check("1011121314151617", "000102030405060708090a0b0c0d0e0f",
+	    "202122232425262728292a2b2c2d2e2f",
+	    "d2a1f0e051ea5f62081a7792073d593d1fc64fbfaccd", 6);
+}
+
+PCUT_TEST(ccm_example3)
+{
+	ccm_check("101112131415161718191a1b",
+	    "000102030405060708090a0b0c0d0e0f10111213",
+	    "202122232425262728292a2b2c2d2e2f3031323334353637",
+	    "e3b201a9f5b71a7a9b1ceaeccd97e70b6176aad9a4428aa5"
+	    "484392fbc1b09951", 8);
+}
+
+/** Check GCM mode against test cases from the GCM specification */
+static void gcm_check(const char *key_hex, const char *iv_hex,
+    const char *aad_hex, const char *plain_hex, const char *cipher_hex,
+    const char *tag_hex)
+{
+	uint8_t key[32];
+	uint8_t iv[MAX_DATA];
+	uint8_t aad[MAX_DATA];
+	uint8_t plain[MAX_DATA];
+	uint8_t cipher[MAX_DATA];
+	uint8_t buf[MAX_DATA];
+	uint8_t expected_tag[16];
+	uint8_t tag[16];
+	aes_ctx_t ctx;
+
+	size_t key_len = hex_decode(key_hex, key);
+	size_t iv_len = hex_decode(iv_hex, iv);
+	size_t aad_len = hex_decode(aad_hex, aad);
+	size_t size = hex_decode(plain_hex, plain);
+	hex_decode(cipher_hex, cipher);
+	hex_decode(tag_hex, expected_tag);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, aes_init(&ctx, key, key_len));
+
+	errno_t rc = aes_gcm_encrypt(&ctx, iv, iv_len, aad, aad_len,
+	    plain, buf, size, tag, 16);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, cipher, size));
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(tag, expected_tag, 16));
+
+	rc = aes_gcm_decrypt(&ctx, iv, iv_len, aad, aad_len,
+	    cipher, buf, size, expected_tag, 16);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(buf, plain, size));
+
+	/* Corrupted tag has to be rejected */
+	expected_tag[15] ^= 1;
+	rc = aes_gcm_decrypt(&ctx, iv, iv_len, aad, aad_len,
+	    cipher, buf, size, expected_tag, 16);
+	PCUT_ASSERT_ERRNO_VAL(EBADCHECKSUM, rc);
+}
+
+PCUT_TEST(gcm_case2)
+{
+	gcm_check("00000000000000000000000000000000",
+	    "000000000000000000000000", "",
+	    "00000000000000000000000000000000",
+	    "0388dace60b6a392f328c2b971b2fe78",
+	    "ab6e47d42cec13bdf53a67b21257bddf");
+}
+
+PCUT_TEST(gcm_case4)
+{
+	gcm_check("feffe9928665731c6d6a8f9467308308",
+	    "cafebabefacedbaddecaf888",
+	    "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+	    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d"
+	    "8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657"
+	    "ba637b39",
+	    "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e23"
+	    "29aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac97"
+	    "3d58e091",
+	    "5bc94fbc3221a5db94fae95ae7121a47");
+}
+
+PCUT_TEST(gcm_case6)
+{
+	gcm_check("feffe9928665731c6d6a8f9467308308",
+	    "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2"
+	    "a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57"
+	    "a637b39b",
+	    "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+	    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d"
+	    "8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657"
+	    "ba637b39",
+	    "8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3c"
+	    "ca7e2ca701e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca41703"
+	    "4c34aee5",
+	    "619cc5aefffe0bfa462af43c1699d050");
+}
+
+PCUT_TEST(gcm_case16)
+{
+	gcm_check("feffe9928665731c6d6a8f9467308308"
+	    "feffe9928665731c6d6a8f9467308308",
+	    "cafebabefacedbaddecaf888",
+	    "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+	    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d"
+	    "8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657"
+	    "ba637b39",
+	    "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd"
+	    "2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0a"
+	    "bcc9f662",
+	    "76fc6ece0f4e1768cddf8853bb2d551b");
+}
+
+PCUT_EXPORT(aes);
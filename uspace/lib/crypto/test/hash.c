@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <macros.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <str.h>
+#include "../crypto.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(hash);
+
+/** Decode hexadecimal test vector */
+static size_t hex_decode(const char *hex, uint8_t *data)
+{
+	size_t len = 0;
+
+	while ((hex[0] != 0) && (hex[1] != 0)) {
+		uint8_t val = 0;
+
+		for (unsigned i = 0; i < 2; i++) {
+			char c = hex[i];
+			val <<= 4;
+
+			if ((c >= '0') && (c <= '9'))
+				val |= c - '0';
+			else
+				val |= c - 'a' + 10;
+		}
+
+		data[len++] = val;
+		hex += 2;
+	}
+
+	return len;
+}
+
+/** Check hash of a string both at once and split into small parts */
+static void hash_check(hash_func_t func, const char *msg,
+    const char *expected_hex)
+{
+	uint8_t expected[HASH_MAX_LENGTH];
+	uint8_t out[HASH_MAX_LENGTH];
+	hash_ctx_t ctx;
+
+	hex_decode(expected_hex, expected);
+
+	errno_t rc = create_hash((uint8_t *) msg, str_size(msg), out, func);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, func));
+
+	rc = hash_init(&ctx, func);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	for (size_t i = 0; i < str_size(msg); i += 3)
+		hash_update(&ctx, msg + i, min(3, str_size(msg) - i));
+
+	hash_final(&ctx, out);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, func));
+}
+
+PCUT_TEST(md5)
+{
+	hash_check(HASH_MD5, "", "d41d8cd98f00b204e9800998ecf8427e");
+	hash_check(HASH_MD5, "abc", "900150983cd24fb0d6963f7d28e17f72");
+	hash_check(HASH_MD5, "12345678901234567890123456789012345678901234"
+	    "567890123456789012345678901234567890",
+	    "57edf4a22be3c955ac49da2e2107b67a");
+}
+
+PCUT_TEST(sha1)
+{
+	hash_check(HASH_SHA1, "abc",
+	    "a9993e364706816aba3e25717850c26c9cd0d89d");
+	hash_check(HASH_SHA1,
+	    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	    "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+}
+
+PCUT_TEST(sha256)
+{
+	hash_check(HASH_SHA256, "",
+	    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	hash_check(HASH_SHA256, "abc",
+	    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	hash_check(HASH_SHA256,
+	    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+PCUT_TEST(sha512)
+{
+	hash_check(HASH_SHA512, "abc",
+	    "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+	    "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+	hash_check(HASH_SHA512,
+	    "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+	    "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+	    "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+	    "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909");
+}
+
+PCUT_TEST(sha256_million)
+{
+	uint8_t expected[HASH_SHA256];
+	uint8_t out[HASH_SHA256];
+	uint8_t data[1000];
+	hash_ctx_t ctx;
+
+	hex_decode("cdc76e5c9914fb9281a1c7e284d73e67"
+	    "f1809a48a497200e046d39ccc7112cd0", expected);
+	memset(data, 'a', sizeof(data));
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, hash_init(&ctx, HASH_SHA256));
+
+	for (size_t i = 0; i < 1000; i++)
+		hash_update(&ctx, data, sizeof(data));
+
+	hash_final(&ctx, out);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, HASH_SHA256));
+}
+
+/** Check HMAC of a string (RFC 2202 and RFC 4231 test case 2) */
+static void hmac_check(hash_func_t func, const char *expected_hex)
+{
+	const char *key = "Jefe";
+	const char *msg = "what do ya want for nothing?";
+	uint8_t expected[HASH_MAX_LENGTH];
+	uint8_t out[HASH_MAX_LENGTH];
+	hmac_ctx_t ctx;
+
+	hex_decode(expected_hex, expected);
+
+	errno_t rc = hmac((uint8_t *) key, str_size(key), (uint8_t *) msg,
+	    str_size(msg), out, func);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, func));
+
+	/* The context has to be reusable after finishing */
+	rc = hmac_init(&ctx, (const uint8_t *) key, str_size(key), func);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	for (unsigned i = 0; i < 2; i++) {
+		hmac_update(&ctx, msg, 5);
+		hmac_update(&ctx, msg + 5, str_size(msg) - 5);
+		hmac_final(&ctx, out);
+		PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, func));
+	}
+}
+
+PCUT_TEST(hmac)
+{
+	hmac_check(HASH_MD5, "750c783e6ab0b503eaa86e310a5db738");
+	hmac_check(HASH_SHA1, "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+	hmac_check(HASH_SHA256,
+	    "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+	hmac_check(HASH_SHA512,
+	    "164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea250554"
+	    "9758bf75c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737");
+}
+
+PCUT_TEST(hmac_long_key)
+{
+	uint8_t key[131];
+	uint8_t expected[HASH_SHA256];
+	uint8_t out[HASH_SHA256];
+	const char *msg = "Test Using Larger Than Block-Size Key - "
+	    "Hash Key First";
+
+	/* RFC 4231 test case 6 */
+	memset(key, 0xaa, sizeof(key));
+	hex_decode("60e431591ee0b67f0d8a26aacbf5b77f"
+	    "8e0bc6213728c5140546040f0ee37f54", expected);
+
+	errno_t rc = hmac(key, sizeof(key), (uint8_t *) msg, str_size(msg),
+	    out, HASH_SHA256);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, HASH_SHA256));
+}
+
+PCUT_TEST(pbkdf2_sha1)
+{
+	uint8_t expected[25];
+	uint8_t out[25];
+
+	/* RFC 6070 */
+	hex_decode("3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038",
+	    expected);
+
+	errno_t rc = pbkdf2_hmac(HASH_SHA1,
+	    (const uint8_t *) "passwordPASSWORDpassword", 24,
+	    (const uint8_t *) "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36,
+	    4096, out, sizeof(out));
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, sizeof(out)));
+}
+
+PCUT_TEST(pbkdf2_wpa)
+{
+	uint8_t expected[PBKDF2_KEY_LENGTH];
+	uint8_t out[PBKDF2_KEY_LENGTH];
+
+	/* IEEE 802.11i passphrase to PSK mapping test vector */
+	hex_decode("f42c6fc52df0ebef9ebb4b90b38a5f90"
+	    "2e83fe1b135a70e23aed762e9710a12e", expected);
+
+	errno_t rc = pbkdf2((uint8_t *) "password", 8, (uint8_t *) "IEEE", 4,
+	    out);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, expected, PBKDF2_KEY_LENGTH));
+}
+
+PCUT_EXPORT(hash);
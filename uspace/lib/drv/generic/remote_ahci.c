@@ -47,7 +47,8 @@ typedef enum {
 	IPC_M_AHCI_GET_NUM_BLOCKS,
 	IPC_M_AHCI_GET_BLOCK_SIZE,
 	IPC_M_AHCI_READ_BLOCKS,
-	IPC_M_AHCI_WRITE_BLOCKS
+	IPC_M_AHCI_WRITE_BLOCKS,
+	IPC_M_AHCI_GET_QUEUE_DEPTH
 } ahci_iface_funcs_t;
 
 #define MAX_NAME_LENGTH  1024
@@ -140,6 +141,24 @@ errno_t ahci_get_block_size(async_sess_t *sess, size_t *blocks_size)
 	return rc;
 }
 
+errno_t ahci_get_queue_depth(async_sess_t *sess, size_t *qdepth)
+{
+	async_exch_t *exch = async_exchange_begin(sess);
+	if (!exch)
+		return EINVAL;
+
+	sysarg_t qd;
+	errno_t rc = async_req_1_1(exch, DEV_IFACE_ID(AHCI_DEV_IFACE),
+	    IPC_M_AHCI_GET_QUEUE_DEPTH, &qd);
+
+	async_exchange_end(exch);
+
+	if (rc == EOK)
+		*qdepth = (size_t) qd;
+
+	return rc;
+}
+
 errno_t ahci_read_blocks(async_sess_t *sess, uint64_t blocknum, size_t count,
     void *buf)
 {
@@ -186,6 +205,7 @@ static void remote_ahci_get_num_blocks(ddf_fun_t *, void *, ipc_call_t *);
 static void remote_ahci_get_block_size(ddf_fun_t *, void *, ipc_call_t *);
 static void remote_ahci_read_blocks(ddf_fun_t *, void *, ipc_call_t *);
 static void remote_ahci_write_blocks(ddf_fun_t *, void *, ipc_call_t *);
+static void remote_ahci_get_queue_depth(ddf_fun_t *, void *, ipc_call_t *);
 
 /** Remote AHCI interface operations. */
 static const remote_iface_func_ptr_t remote_ahci_iface_ops [] = {
@@ -193,7 +213,8 @@ static const remote_iface_func_ptr_t remote_ahci_iface_ops [] = {
 	[IPC_M_AHCI_GET_NUM_BLOCKS] = remote_ahci_get_num_blocks,
 	[IPC_M_AHCI_GET_BLOCK_SIZE] = remote_ahci_get_block_size,
 	[IPC_M_AHCI_READ_BLOCKS] = remote_ahci_read_blocks,
-	[IPC_M_AHCI_WRITE_BLOCKS] = remote_ahci_write_blocks
+	[IPC_M_AHCI_WRITE_BLOCKS] = remote_ahci_write_blocks,
+	[IPC_M_AHCI_GET_QUEUE_DEPTH] = remote_ahci_get_queue_depth
 };
 
 /** Remote AHCI interface structure.
@@ -274,6 +295,25 @@ static void remote_ahci_get_block_size(ddf_fun_t *fun, void *iface,
 		async_answer_1(call, EOK, blocks);
 }
 
+static void remote_ahci_get_queue_depth(ddf_fun_t *fun, void *iface,
+    ipc_call_t *call)
+{
+	const ahci_iface_t *ahci_iface = (ahci_iface_t *) iface;
+
+	if (ahci_iface->get_queue_depth == NULL) {
+		async_answer_0(call, ENOTSUP);
+		return;
+	}
+
+	size_t qdepth;
+	const errno_t ret = ahci_iface->get_queue_depth(fun, &qdepth);
+
+	if (ret != EOK)
+		async_answer_0(call, ret);
+	else
+		async_answer_1(call, EOK, qdepth);
+}
+
 void remote_ahci_read_blocks(ddf_fun_t *fun, void *iface, ipc_call_t *call)
 {
 	const ahci_iface_t *ahci_iface = (ahci_iface_t *) iface;
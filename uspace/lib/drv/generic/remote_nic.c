@@ -93,17 +93,29 @@ typedef enum {
  * @param[in] dev_sess
  * @param[in] data     Frame data
  * @param[in] size     Frame size in bytes
+ * @param[in] offload  Checksum/segmentation work requested from the NIC
+ *                     or NULL if the frame is complete
  *
  * @return EOK If the operation was successfully completed
  *
  */
-errno_t nic_send_frame(async_sess_t *dev_sess, void *data, size_t size)
+errno_t nic_send_frame(async_sess_t *dev_sess, void *data, size_t size,
+    const inet_offload_t *offload)
 {
+	sysarg_t arg1 = 0;
+	sysarg_t arg2 = 0;
+
+	if (offload != NULL) {
+		arg1 = offload->flags | ((sysarg_t) offload->gso_size << 16);
+		arg2 = offload->csum_start |
+		    ((sysarg_t) offload->csum_offset << 16);
+	}
+
 	async_exch_t *exch = async_exchange_begin(dev_sess);
 
 	ipc_call_t answer;
-	aid_t req = async_send_1(exch, DEV_IFACE_ID(NIC_DEV_IFACE),
-	    NIC_SEND_MESSAGE, &answer);
+	aid_t req = async_send_3(exch, DEV_IFACE_ID(NIC_DEV_IFACE),
+	    NIC_SEND_MESSAGE, arg1, arg2, &answer);
 	errno_t retval = async_data_write_start(exch, data, size);
 
 	async_exchange_end(exch);
@@ -1244,7 +1256,7 @@ errno_t nic_offload_set(async_sess_t *dev_sess, uint32_t mask, uint32_t active)
 {
 	async_exch_t *exch = async_exchange_begin(dev_sess);
 	errno_t rc = async_req_3_0(exch, DEV_IFACE_ID(NIC_DEV_IFACE),
-	    NIC_AUTONEG_RESTART, (sysarg_t) mask, (sysarg_t) active);
+	    NIC_OFFLOAD_SET, (sysarg_t) mask, (sysarg_t) active);
 	async_exchange_end(exch);
 
 	return rc;
@@ -1343,15 +1355,22 @@ static void remote_nic_send_frame(ddf_fun_t *dev, void *iface,
 
 	void *data;
 	size_t size;
+	inet_offload_t offload;
 	errno_t rc;
 
+	offload.flags = ipc_get_arg2(call) & 0xffff;
+	offload.gso_size = (ipc_get_arg2(call) >> 16) & 0xffff;
+	offload.csum_start = ipc_get_arg3(call) & 0xffff;
+	offload.csum_offset = (ipc_get_arg3(call) >> 16) & 0xffff;
+
 	rc = async_data_write_accept(&data, false, 0, 0, 0, &size);
 	if (rc != EOK) {
 		async_answer_0(call, EINVAL);
 		return;
 	}
 
-	rc = nic_iface->send_frame(dev, data, size);
+	rc = nic_iface->send_frame(dev, data, size,
+	    offload.flags != 0 ? &offload : NULL);
 	async_answer_0(call, rc);
 	free(data);
 }
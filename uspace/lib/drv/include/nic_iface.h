@@ -38,6 +38,7 @@
 #include <async.h>
 #include <nic/nic.h>
 #include <ipc/common.h>
+#include <types/inet.h>
 
 typedef enum {
 	NIC_EV_ADDR_CHANGED = IPC_FIRST_USER_METHOD,
@@ -45,7 +46,8 @@ typedef enum {
 	NIC_EV_DEVICE_STATE
 } nic_event_t;
 
-extern errno_t nic_send_frame(async_sess_t *, void *, size_t);
+extern errno_t nic_send_frame(async_sess_t *, void *, size_t,
+    const inet_offload_t *);
 extern errno_t nic_callback_create(async_sess_t *, async_port_handler_t, void *);
 extern errno_t nic_get_state(async_sess_t *, nic_device_state_t *);
 extern errno_t nic_set_state(async_sess_t *, nic_device_state_t);
@@ -39,11 +39,13 @@
 #include <ipc/services.h>
 #include <nic/nic.h>
 #include <time.h>
+#include <types/inet.h>
 #include "../ddf/driver.h"
 
 typedef struct nic_iface {
 	/** Mandatory methods */
-	errno_t (*send_frame)(ddf_fun_t *, void *, size_t);
+	errno_t (*send_frame)(ddf_fun_t *, void *, size_t,
+	    const inet_offload_t *);
 	errno_t (*callback_create)(ddf_fun_t *);
 	errno_t (*get_state)(ddf_fun_t *, nic_device_state_t *);
 	errno_t (*set_state)(ddf_fun_t *, nic_device_state_t);
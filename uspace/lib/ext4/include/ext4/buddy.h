@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libext4
+ * @{
+ */
+
+#ifndef LIBEXT4_BUDDY_H_
+#define LIBEXT4_BUDDY_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Highest order of free chunks tracked by the buddy bitmaps */
+#define EXT4_BUDDY_MAX_ORDER  15
+
+/** In-memory buddy representation of a block group bitmap.
+ *
+ * Bitmap of order k has one bit per aligned chunk of 2^k blocks.
+ * The bit is set if all blocks of the chunk are free. Order 0
+ * is the inverted on-disk block bitmap.
+ */
+typedef struct ext4_buddy {
+	/** Number of blocks covered */
+	uint32_t blocks;
+	/** Highest order with a bitmap */
+	unsigned max_order;
+	/** Number of free blocks */
+	uint32_t free;
+	/** Free chunk bitmaps of all orders */
+	uint8_t *map[EXT4_BUDDY_MAX_ORDER + 1];
+	/** Number of free chunks of each order */
+	uint32_t count[EXT4_BUDDY_MAX_ORDER + 1];
+} ext4_buddy_t;
+
+extern errno_t ext4_buddy_init(ext4_buddy_t *, const uint8_t *, uint32_t);
+extern void ext4_buddy_fini(ext4_buddy_t *);
+extern bool ext4_buddy_is_free(ext4_buddy_t *, uint32_t);
+extern void ext4_buddy_mark_used(ext4_buddy_t *, uint32_t, uint32_t);
+extern void ext4_buddy_mark_free(ext4_buddy_t *, uint32_t, uint32_t);
+extern uint32_t ext4_buddy_free_run(ext4_buddy_t *, uint32_t, uint32_t);
+extern bool ext4_buddy_find(ext4_buddy_t *, uint32_t, uint32_t, uint32_t *,
+    uint32_t *);
+
+#endif
+
+/**
+ * @}
+ */
@@ -35,10 +35,26 @@
 #define LIBEXT4_FSTYPES_H_
 
 #include <adt/list.h>
+#include <fibril_synch.h>
 #include <libfs.h>
 #include <loc.h>
 #include "ext4/types.h"
 
+/**
+ * Data appended to a file which have no blocks allocated yet.
+ */
+typedef struct ext4_delalloc {
+	link_t link;
+	fs_index_t index;
+	/** Logical block the data start at */
+	uint32_t iblock;
+	/** Number of buffered bytes */
+	size_t size;
+	/** Size of the buffer, multiple of block size */
+	size_t capacity;
+	uint8_t *data;
+} ext4_delalloc_t;
+
 /**
  * Type for holding an instance of mounted partition.
  */
@@ -47,6 +63,11 @@ typedef struct ext4_instance {
 	service_id_t service_id;
 	ext4_filesystem_t *filesystem;
 	unsigned int open_nodes_count;
+	/** Files with delayed allocation of appended data */
+	list_t delalloc;
+	/** Total size of delayed allocation buffers */
+	size_t delalloc_size;
+	fibril_mutex_t delalloc_lock;
 } ext4_instance_t;
 
 /**
@@ -35,7 +35,11 @@
 #ifndef LIBEXT4_TYPES_H_
 #define LIBEXT4_TYPES_H_
 
+#include <adt/hash_table.h>
+#include <adt/list.h>
 #include <block.h>
+#include <fibril_synch.h>
+#include "ext4/buddy.h"
 
 /*
  * Structure of the super block
@@ -227,11 +231,168 @@ typedef struct ext4_superblock {
 	EXT4_FEATURE_RO_COMPAT_GDT_CSUM | \
 	EXT4_FEATURE_RO_COMPAT_EXTRA_ISIZE)
 
+/*
+ * Window of blocks reserved for future allocations of an i-node
+ */
+typedef struct ext4_prealloc {
+	link_t link;
+	uint32_t inode;   /* I-node owning the window */
+	uint32_t iblock;  /* Logical block the window continues at */
+	uint32_t fblock;  /* Physical block mapped to iblock */
+	uint32_t count;   /* Number of blocks left in the window */
+} ext4_prealloc_t;
+
+/*
+ * State of the multi-block allocator
+ */
+typedef struct ext4_mballoc {
+	fibril_mutex_t lock;
+	uint32_t group_count;
+	ext4_buddy_t **buddy;  /* Buddy bitmaps of groups, loaded on demand */
+	list_t prealloc;       /* Windows reserved for i-nodes */
+} ext4_mballoc_t;
+
+/*
+ * JBD2 journal (on-disk structures are big-endian)
+ */
+#define EXT4_JOURNAL_MAGIC  0xC03B3998
+
+#define EXT4_JOURNAL_DESCRIPTOR_BLOCK  1
+#define EXT4_JOURNAL_COMMIT_BLOCK      2
+#define EXT4_JOURNAL_SUPERBLOCK_V1     3
+#define EXT4_JOURNAL_SUPERBLOCK_V2     4
+#define EXT4_JOURNAL_REVOKE_BLOCK      5
+
+#define EXT4_JOURNAL_FLAG_ESCAPE     0x1  /* Block had magic at offset 0 */
+#define EXT4_JOURNAL_FLAG_SAME_UUID  0x2  /* UUID not stored after the tag */
+#define EXT4_JOURNAL_FLAG_DELETED    0x4
+#define EXT4_JOURNAL_FLAG_LAST_TAG   0x8  /* Last tag in the descriptor */
+
+#define EXT4_JOURNAL_FEATURE_COMPAT_CHECKSUM        0x0001
+
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_REVOKE        0x0001
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT         0x0002
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_ASYNC_COMMIT  0x0004
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_CSUM_V2       0x0008
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_CSUM_V3       0x0010
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_FAST_COMMIT   0x0020
+
+#define EXT4_JOURNAL_FEATURE_INCOMPAT_SUPP \
+	(EXT4_JOURNAL_FEATURE_INCOMPAT_REVOKE | \
+	EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT | \
+	EXT4_JOURNAL_FEATURE_INCOMPAT_ASYNC_COMMIT)
+
+typedef struct ext4_journal_header {
+	uint32_t magic;
+	uint32_t block_type;
+	uint32_t sequence;            /* Transaction ID */
+} __attribute__((packed)) ext4_journal_header_t;
+
+typedef struct ext4_journal_sb {
+	ext4_journal_header_t header;
+	uint32_t block_size;          /* Journal device block size */
+	uint32_t max_len;             /* Total blocks in the journal */
+	uint32_t first;               /* First block of log information */
+	uint32_t sequence;            /* First commit ID expected in the log */
+	uint32_t start;               /* Block number of the start of the log */
+	uint32_t error;               /* Error value, as set by journal abort */
+	uint32_t features_compatible;
+	uint32_t features_incompatible;
+	uint32_t features_read_only;
+	uint8_t uuid[16];             /* UUID of the journal */
+	uint32_t nr_users;            /* Number of file systems sharing the log */
+	uint32_t dyn_super;           /* Block number of dynamic superblock copy */
+	uint32_t max_transaction;     /* Limit of journal blocks per transaction */
+	uint32_t max_trans_data;      /* Limit of data blocks per transaction */
+	uint8_t checksum_type;
+	uint8_t padding2[3];
+	uint32_t padding[42];
+	uint32_t checksum;
+	uint8_t users[16 * 48];       /* IDs of file systems sharing the log */
+} __attribute__((packed)) ext4_journal_sb_t;
+
+typedef struct ext4_journal_block_tag {
+	uint32_t block_lo;            /* Home location of the logged block */
+	uint16_t checksum;
+	uint16_t flags;
+	uint32_t block_hi;            /* Only with INCOMPAT_64BIT */
+} __attribute__((packed)) ext4_journal_block_tag_t;
+
+typedef struct ext4_journal_revoke_header {
+	ext4_journal_header_t header;
+	uint32_t count;               /* Bytes used in the block */
+} __attribute__((packed)) ext4_journal_revoke_header_t;
+
+typedef struct ext4_journal_commit_header {
+	ext4_journal_header_t header;
+	uint8_t checksum_type;
+	uint8_t checksum_size;
+	uint8_t padding[2];
+	uint32_t checksum[8];
+	uint64_t commit_sec;
+	uint32_t commit_nsec;
+} __attribute__((packed)) ext4_journal_commit_header_t;
+
+/*
+ * Block tracked by the journal
+ */
+typedef struct ext4_journal_block {
+	ht_link_t link;
+	uint64_t lba;      /* File system block address */
+	uint32_t tid;      /* Transaction which revoked the block (replay) */
+	block_t *block;    /* Block pinned by the running transaction */
+} ext4_journal_block_t;
+
+/*
+ * Run of journal blocks stored consecutively on the device
+ */
+typedef struct ext4_journal_run {
+	uint32_t lblock;   /* First block relative to the journal */
+	uint64_t pblock;   /* First physical block */
+	uint32_t count;    /* Number of blocks in the run */
+} ext4_journal_run_t;
+
+/*
+ * State of the journal
+ */
+typedef struct ext4_journal {
+	struct ext4_filesystem *fs;
+	fibril_mutex_t lock;
+	fibril_condvar_t cv;          /* Signalled when a handle or commit ends */
+	fibril_condvar_t thread_cv;   /* Wakes up the commit fibril */
+	ext4_journal_run_t *runs;
+	size_t run_count;
+	uint32_t block_size;
+	uint32_t first;               /* First block of the log */
+	uint32_t max_len;             /* Total number of journal blocks */
+	uint32_t head;                /* Next log block to be written */
+	uint32_t start;               /* Start of the log on disk (0 if empty) */
+	uint32_t sequence;            /* ID of the running transaction */
+	uint32_t features_incompatible;
+	size_t tag_size;
+	uint8_t uuid[16];
+	unsigned handles;             /* Operations in progress */
+	bool committing;
+	bool commit_pending;          /* Commit when the last handle ends */
+	bool active;                  /* Transactions are being recorded */
+	bool stop;                    /* Commit fibril should terminate */
+	bool thread_running;
+	hash_table_t trans;           /* Blocks pinned by the running transaction */
+	size_t trans_count;
+	size_t trans_max;
+	hash_table_t revoke;          /* Blocks revoked by the running transaction */
+	size_t revoke_count;
+	hash_table_t logged;          /* Blocks in the live part of the log */
+	list_t inodes;                /* I-node references in use */
+} ext4_journal_t;
+
 typedef struct ext4_filesystem {
 	service_id_t device;
 	ext4_superblock_t *superblock;
 	aoff64_t inode_block_limits[4];
 	aoff64_t inode_blocks_per_level[4];
+	ext4_mballoc_t mballoc;
+	ext4_journal_t *journal;      /* NULL if the volume is not journalled */
 } ext4_filesystem_t;
 
 /** Size of buffer for volume name. To hold 16 latin-1 chars encoded as UTF-8
@@ -388,6 +549,7 @@ typedef struct ext4_inode {
 #define EXT4_INODE_ROOT_INDEX  2
 
 typedef struct ext4_inode_ref {
+	link_t link;            /* Link in the journal list of references */
 	block_t *block;         /* Reference to a block containing this inode */
 	ext4_inode_t *inode;
 	ext4_filesystem_t *fs;
@@ -537,6 +699,9 @@ typedef struct ext4_extent_path {
 
 #define EXT4_EXTENT_MAGIC  0xF30A
 
+/* Extents longer than this are uninitialized (preallocated) */
+#define EXT4_EXTENT_MAX_INIT_LEN  (1 << 15)
+
 #define	EXT4_EXTENT_FIRST(header) \
 	((ext4_extent_t *) (((void *) (header)) + sizeof(ext4_extent_header_t)))
 
@@ -33,19 +33,111 @@
 /**
  * @file  balloc.c
  * @brief Physical block allocator.
+ *
+ * Free space of each block group is tracked by buddy bitmaps built
+ * from the on-disk block bitmap when the group is first used. Data
+ * allocations of regular files reserve a window of blocks following
+ * the allocated ones, so that files written concurrently do not
+ * interleave on the disk. The windows exist only in memory, the
+ * on-disk bitmap marks only blocks really allocated.
  */
 
 #include <errno.h>
+#include <macros.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include "ext4/balloc.h"
 #include "ext4/bitmap.h"
 #include "ext4/block_group.h"
+#include "ext4/buddy.h"
 #include "ext4/filesystem.h"
 #include "ext4/inode.h"
+#include "ext4/journal.h"
 #include "ext4/superblock.h"
 #include "ext4/types.h"
 
+/** Initial size of the preallocation window in bytes */
+#define EXT4_BALLOC_PREALLOC_MIN  (64 * 1024)
+
+/** Maximum size of the preallocation window in bytes */
+#define EXT4_BALLOC_PREALLOC_MAX  (8 * 1024 * 1024)
+
+static void ext4_balloc_buddy_free(ext4_filesystem_t *, uint32_t, uint32_t);
+
+/** Initialize block allocator.
+ *
+ * @param fs Filesystem
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_balloc_init(ext4_filesystem_t *fs)
+{
+	ext4_mballoc_t *mb = &fs->mballoc;
+
+	fibril_mutex_initialize(&mb->lock);
+	list_initialize(&mb->prealloc);
+
+	mb->group_count =
+	    ext4_superblock_get_block_group_count(fs->superblock);
+	mb->buddy = calloc(mb->group_count, sizeof(ext4_buddy_t *));
+	if (mb->buddy == NULL)
+		return ENOMEM;
+
+	return EOK;
+}
+
+/** Finalize block allocator.
+ *
+ * All preallocation windows are dropped.
+ *
+ * @param fs Filesystem
+ *
+ */
+void ext4_balloc_fini(ext4_filesystem_t *fs)
+{
+	ext4_mballoc_t *mb = &fs->mballoc;
+
+	list_foreach_safe(mb->prealloc, cur, next) {
+		ext4_prealloc_t *pa = list_get_instance(cur, ext4_prealloc_t,
+		    link);
+		list_remove(&pa->link);
+		free(pa);
+	}
+
+	for (uint32_t i = 0; i < mb->group_count; i++) {
+		if (mb->buddy[i] != NULL) {
+			ext4_buddy_fini(mb->buddy[i]);
+			free(mb->buddy[i]);
+		}
+	}
+
+	free(mb->buddy);
+	mb->buddy = NULL;
+}
+
+/** Revoke freed blocks from the journal.
+ *
+ * @param fs    File system
+ * @param first First freed block
+ * @param count Number of freed blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_balloc_revoke(ext4_filesystem_t *fs, uint32_t first,
+    uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		errno_t rc = ext4_journal_revoke(fs, first + i);
+		if (rc != EOK)
+			return rc;
+	}
+
+	return EOK;
+}
+
 /** Free block.
  *
  * @param inode_ref  Inode, where the block is allocated
@@ -80,9 +172,18 @@ errno_t ext4_balloc_free_block(ext4_inode_ref_t *inode_ref, uint32_t block_addr)
 		return rc;
 	}
 
+	/* Logged copies of the blocks must not overwrite their new content */
+	rc = ext4_balloc_revoke(fs, block_addr, 1);
+	if (rc != EOK) {
+		block_put(bitmap_block);
+		ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc;
+	}
+
 	/* Modify bitmap */
 	ext4_bitmap_free_bit(bitmap_block->data, index_in_group);
 	bitmap_block->dirty = true;
+	ext4_balloc_buddy_free(fs, block_addr, 1);
 
 	/* Release block with bitmap */
 	rc = block_put(bitmap_block);
@@ -153,9 +254,18 @@ static errno_t ext4_balloc_free_blocks_internal(ext4_inode_ref_t *inode_ref,
 		return rc;
 	}
 
+	/* Logged copies of the blocks must not overwrite their new content */
+	rc = ext4_balloc_revoke(fs, first, count);
+	if (rc != EOK) {
+		block_put(bitmap_block);
+		ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc;
+	}
+
 	/* Modify bitmap */
 	ext4_bitmap_free_bits(bitmap_block->data, index_in_group_first, count);
 	bitmap_block->dirty = true;
+	ext4_balloc_buddy_free(fs, first, count);
 
 	/* Release block with bitmap */
 	rc = block_put(bitmap_block);
@@ -312,7 +422,7 @@ static errno_t ext4_balloc_find_goal(ext4_inode_ref_t *inode_ref, uint32_t *goal
 		if (rc != EOK)
 			return rc;
 
-		if (goal != 0) {
+		if (*goal != 0) {
 			(*goal)++;
 			return EOK;
 		}
@@ -335,282 +445,492 @@ static errno_t ext4_balloc_find_goal(ext4_inode_ref_t *inode_ref, uint32_t *goal
 	return ext4_filesystem_put_block_group_ref(bg_ref);
 }
 
-/** Data block allocation algorithm.
+/** Return blocks to the buddy bitmaps.
  *
- * @param inode_ref Inode to allocate block for
- * @param fblock    Allocated block address
+ * Allocator lock must be held.
  *
- * @return Error code
+ * @param fs    Filesystem
+ * @param first First block to return
+ * @param count Number of blocks, all in the same block group
  *
  */
-errno_t ext4_balloc_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t *fblock)
+static void ext4_balloc_unreserve(ext4_filesystem_t *fs, uint32_t first,
+    uint32_t count)
 {
-	uint32_t allocated_block = 0;
+	ext4_superblock_t *sb = fs->superblock;
+	uint32_t bgid = ext4_filesystem_blockaddr2group(sb, first);
 
-	uint32_t bitmap_block_addr;
-	block_t *bitmap_block;
-	uint32_t rel_block_idx = 0;
-	uint32_t free_blocks;
-	uint32_t goal;
-	uint32_t block_size;
+	/* Bitmaps not loaded yet will be built from the on-disk bitmap */
+	ext4_buddy_t *buddy = fs->mballoc.buddy[bgid];
+	if (buddy == NULL)
+		return;
 
-	/* Find GOAL */
-	errno_t rc = ext4_balloc_find_goal(inode_ref, &goal);
-	if (rc != EOK)
-		return rc;
-
-	ext4_superblock_t *sb = inode_ref->fs->superblock;
+	ext4_buddy_mark_free(buddy,
+	    ext4_filesystem_blockaddr2_index_in_group(sb, first), count);
+}
 
-	/* Load block group number for goal and relative index */
-	uint32_t block_group = ext4_filesystem_blockaddr2group(sb, goal);
-	uint32_t index_in_group =
-	    ext4_filesystem_blockaddr2_index_in_group(sb, goal);
+/** Update buddy bitmaps after blocks were freed.
+ *
+ * @param fs    Filesystem
+ * @param first First freed block
+ * @param count Number of blocks, all in the same block group
+ *
+ */
+static void ext4_balloc_buddy_free(ext4_filesystem_t *fs, uint32_t first,
+    uint32_t count)
+{
+	fibril_mutex_lock(&fs->mballoc.lock);
+	ext4_balloc_unreserve(fs, first, count);
+	fibril_mutex_unlock(&fs->mballoc.lock);
+}
 
-	/* Load block group reference */
-	ext4_block_group_ref_t *bg_ref;
-	rc = ext4_filesystem_get_block_group_ref(inode_ref->fs,
-	    block_group, &bg_ref);
-	if (rc != EOK)
-		return rc;
+/** Get buddy bitmaps of block group.
+ *
+ * The bitmaps are built from the on-disk block bitmap on first use.
+ * Allocator lock must be held.
+ *
+ * @param bg_ref Block group
+ * @param rbuddy Output pointer to the buddy bitmaps
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_balloc_get_buddy(ext4_block_group_ref_t *bg_ref,
+    ext4_buddy_t **rbuddy)
+{
+	ext4_filesystem_t *fs = bg_ref->fs;
+	ext4_superblock_t *sb = fs->superblock;
 
-	free_blocks =
-	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
-	if (free_blocks == 0) {
-		/* This group has no free blocks */
-		goto goal_failed;
+	if (fs->mballoc.buddy[bg_ref->index] != NULL) {
+		*rbuddy = fs->mballoc.buddy[bg_ref->index];
+		return EOK;
 	}
 
-	/* Compute indexes */
-	uint32_t first_in_group =
-	    ext4_balloc_get_first_data_block_in_group(sb, bg_ref);
+	ext4_buddy_t *buddy = malloc(sizeof(ext4_buddy_t));
+	if (buddy == NULL)
+		return ENOMEM;
 
-	uint32_t first_in_group_index =
-	    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
+	uint32_t bitmap_block_addr =
+	    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
+	block_t *bitmap_block;
+	errno_t rc = block_get(&bitmap_block, fs->device, bitmap_block_addr,
+	    BLOCK_FLAGS_NONE);
+	if (rc != EOK) {
+		free(buddy);
+		return rc;
+	}
 
-	if (index_in_group < first_in_group_index)
-		index_in_group = first_in_group_index;
+	rc = ext4_buddy_init(buddy, bitmap_block->data,
+	    ext4_superblock_get_blocks_in_group(sb, bg_ref->index));
 
-	/* Load block with bitmap */
-	bitmap_block_addr =
-	    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
+	errno_t rc2 = block_put(bitmap_block);
+	if (rc == EOK && rc2 != EOK) {
+		ext4_buddy_fini(buddy);
+		rc = rc2;
+	}
 
-	rc = block_get(&bitmap_block, inode_ref->fs->device,
-	    bitmap_block_addr, BLOCK_FLAGS_NONE);
 	if (rc != EOK) {
-		ext4_filesystem_put_block_group_ref(bg_ref);
+		free(buddy);
 		return rc;
 	}
 
-	/* Check if goal is free */
-	if (ext4_bitmap_is_free_bit(bitmap_block->data, index_in_group)) {
-		ext4_bitmap_set_bit(bitmap_block->data, index_in_group);
-		bitmap_block->dirty = true;
-		rc = block_put(bitmap_block);
-		if (rc != EOK) {
-			ext4_filesystem_put_block_group_ref(bg_ref);
-			return rc;
-		}
+	fs->mballoc.buddy[bg_ref->index] = buddy;
+	*rbuddy = buddy;
+	return EOK;
+}
 
-		allocated_block =
-		    ext4_filesystem_index_in_group2blockaddr(sb, index_in_group,
-		    block_group);
+/** Find run of free blocks and reserve it in the buddy bitmaps.
+ *
+ * Block groups are searched starting with the group of @a goal.
+ * Allocator lock must be held.
+ *
+ * @param fs      Filesystem
+ * @param goal    Preferred first block
+ * @param want    Requested number of blocks
+ * @param partial Accept runs shorter than requested
+ * @param fblock  Output value for the first block of the run
+ * @param count   Output value for length of the run
+ *
+ * @return Error code, ENOSPC if no suitable run was found
+ *
+ */
+static errno_t ext4_balloc_find_run(ext4_filesystem_t *fs, uint32_t goal,
+    uint32_t want, bool partial, uint32_t *fblock, uint32_t *count)
+{
+	ext4_superblock_t *sb = fs->superblock;
+	ext4_mballoc_t *mb = &fs->mballoc;
+	errno_t rc;
 
-		goto success;
-	}
+	uint32_t goal_group = ext4_filesystem_blockaddr2group(sb, goal);
+	if (goal_group >= mb->group_count)
+		goal_group = 0;
 
-	uint32_t blocks_in_group =
-	    ext4_superblock_get_blocks_in_group(sb, block_group);
+	for (uint32_t i = 0; i < mb->group_count; i++) {
+		uint32_t bgid = (goal_group + i) % mb->group_count;
 
-	uint32_t end_idx = (index_in_group + 63) & ~63;
-	if (end_idx > blocks_in_group)
-		end_idx = blocks_in_group;
+		ext4_block_group_ref_t *bg_ref;
+		rc = ext4_filesystem_get_block_group_ref(fs, bgid, &bg_ref);
+		if (rc != EOK)
+			return rc;
 
-	/* Try to find free block near to goal */
-	for (uint32_t tmp_idx = index_in_group + 1; tmp_idx < end_idx;
-	    ++tmp_idx) {
-		if (ext4_bitmap_is_free_bit(bitmap_block->data, tmp_idx)) {
-			ext4_bitmap_set_bit(bitmap_block->data, tmp_idx);
-			bitmap_block->dirty = true;
-			rc = block_put(bitmap_block);
+		uint32_t free_blocks =
+		    ext4_block_group_get_free_blocks_count(bg_ref->block_group,
+		    sb);
+		if ((free_blocks == 0) || (!partial && free_blocks < want)) {
+			/* Skip the group without loading its bitmap */
+			rc = ext4_filesystem_put_block_group_ref(bg_ref);
 			if (rc != EOK)
 				return rc;
 
-			allocated_block =
-			    ext4_filesystem_index_in_group2blockaddr(sb, tmp_idx,
-			    block_group);
+			continue;
+		}
 
-			goto success;
+		ext4_buddy_t *buddy;
+		rc = ext4_balloc_get_buddy(bg_ref, &buddy);
+		if (rc != EOK) {
+			ext4_filesystem_put_block_group_ref(bg_ref);
+			return rc;
 		}
-	}
 
-	/* Find free BYTE in bitmap */
-	rc = ext4_bitmap_find_free_byte_and_set_bit(bitmap_block->data,
-	    index_in_group, &rel_block_idx, blocks_in_group);
-	if (rc == EOK) {
-		bitmap_block->dirty = true;
-		rc = block_put(bitmap_block);
+		rc = ext4_filesystem_put_block_group_ref(bg_ref);
 		if (rc != EOK)
 			return rc;
 
-		allocated_block =
-		    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-		    block_group);
+		uint32_t index = 0;
+		if (bgid == goal_group)
+			index = ext4_filesystem_blockaddr2_index_in_group(sb, goal);
 
-		goto success;
+		uint32_t start;
+		uint32_t len;
+		if (!ext4_buddy_find(buddy, index, want, &start, &len))
+			continue;
+
+		if (!partial && len < want)
+			continue;
+
+		ext4_buddy_mark_used(buddy, start, len);
+
+		*fblock = ext4_filesystem_index_in_group2blockaddr(sb, start, bgid);
+		*count = len;
+		return EOK;
 	}
 
-	/* Find free bit in bitmap */
-	rc = ext4_bitmap_find_free_bit_and_set(bitmap_block->data,
-	    index_in_group, &rel_block_idx, blocks_in_group);
-	if (rc == EOK) {
-		bitmap_block->dirty = true;
-		rc = block_put(bitmap_block);
-		if (rc != EOK)
-			return rc;
+	return ENOSPC;
+}
 
-		allocated_block =
-		    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-		    block_group);
+/** Drop preallocation window.
+ *
+ * Allocator lock must be held.
+ *
+ * @param fs Filesystem
+ * @param pa Window to drop
+ *
+ */
+static void ext4_balloc_prealloc_drop(ext4_filesystem_t *fs,
+    ext4_prealloc_t *pa)
+{
+	ext4_balloc_unreserve(fs, pa->fblock, pa->count);
+	list_remove(&pa->link);
+	free(pa);
+}
 
-		goto success;
+/** Find preallocation window of i-node.
+ *
+ * Allocator lock must be held.
+ *
+ * @param fs    Filesystem
+ * @param inode I-node number
+ *
+ * @return Window or NULL if the i-node has none
+ *
+ */
+static ext4_prealloc_t *ext4_balloc_prealloc_find(ext4_filesystem_t *fs,
+    uint32_t inode)
+{
+	list_foreach(fs->mballoc.prealloc, link, ext4_prealloc_t, pa) {
+		if (pa->inode == inode)
+			return pa;
 	}
 
-	/* No free block found yet */
-	rc = block_put(bitmap_block);
+	return NULL;
+}
+
+/** Reserve run of free blocks.
+ *
+ * A run of the requested length is preferred. Preallocation windows
+ * are dropped before giving up. Allocator lock must be held.
+ *
+ * @param fs     Filesystem
+ * @param goal   Preferred first block
+ * @param want   Requested number of blocks
+ * @param fblock Output value for the first block of the run
+ * @param count  Output value for length of the run
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_balloc_reserve(ext4_filesystem_t *fs, uint32_t goal,
+    uint32_t want, uint32_t *fblock, uint32_t *count)
+{
+	errno_t rc = ext4_balloc_find_run(fs, goal, want, false, fblock,
+	    count);
+	if (rc != ENOSPC)
+		return rc;
+
+	rc = ext4_balloc_find_run(fs, goal, want, true, fblock, count);
+	if ((rc != ENOSPC) || list_empty(&fs->mballoc.prealloc))
+		return rc;
+
+	/* Use blocks reserved for other i-nodes */
+	list_foreach_safe(fs->mballoc.prealloc, cur, next) {
+		ext4_balloc_prealloc_drop(fs, list_get_instance(cur,
+		    ext4_prealloc_t, link));
+	}
+
+	return ext4_balloc_find_run(fs, goal, want, true, fblock, count);
+}
+
+/** Mark reserved blocks allocated on the disk.
+ *
+ * Updates the block bitmap and free block counters of the block group
+ * and the superblock, and the block count of the i-node.
+ *
+ * @param inode_ref I-node the blocks are allocated for
+ * @param first     First block
+ * @param count     Number of blocks, all in the same block group
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_balloc_commit(ext4_inode_ref_t *inode_ref, uint32_t first,
+    uint32_t count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	ext4_superblock_t *sb = fs->superblock;
+
+	uint32_t block_group = ext4_filesystem_blockaddr2group(sb, first);
+	uint32_t index_in_group =
+	    ext4_filesystem_blockaddr2_index_in_group(sb, first);
+
+	/* Load block group reference */
+	ext4_block_group_ref_t *bg_ref;
+	errno_t rc = ext4_filesystem_get_block_group_ref(fs, block_group,
+	    &bg_ref);
+	if (rc != EOK)
+		return rc;
+
+	/* Load block with bitmap */
+	uint32_t bitmap_block_addr =
+	    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
+	block_t *bitmap_block;
+	rc = block_get(&bitmap_block, fs->device, bitmap_block_addr,
+	    BLOCK_FLAGS_NONE);
 	if (rc != EOK) {
 		ext4_filesystem_put_block_group_ref(bg_ref);
 		return rc;
 	}
 
-goal_failed:
+	/* Modify bitmap */
+	for (uint32_t i = 0; i < count; i++)
+		ext4_bitmap_set_bit(bitmap_block->data, index_in_group + i);
+	bitmap_block->dirty = true;
 
-	rc = ext4_filesystem_put_block_group_ref(bg_ref);
-	if (rc != EOK)
+	/* Release block with bitmap */
+	rc = block_put(bitmap_block);
+	if (rc != EOK) {
+		ext4_filesystem_put_block_group_ref(bg_ref);
 		return rc;
+	}
 
-	/* Try other block groups */
-	uint32_t block_group_count = ext4_superblock_get_block_group_count(sb);
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
 
-	uint32_t bgid = (block_group + 1) % block_group_count;
-	uint32_t count = block_group_count;
+	/* Update superblock free blocks count */
+	uint32_t sb_free_blocks = ext4_superblock_get_free_blocks_count(sb);
+	sb_free_blocks -= count;
+	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
 
-	while (count > 0) {
-		rc = ext4_filesystem_get_block_group_ref(inode_ref->fs, bgid,
-		    &bg_ref);
-		if (rc != EOK)
-			return rc;
+	/* Update inode blocks (different block size!) count */
+	uint64_t ino_blocks =
+	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
+	ino_blocks += count * (block_size / EXT4_INODE_BLOCK_SIZE);
+	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
+	inode_ref->dirty = true;
 
-		free_blocks =
-		    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
-		if (free_blocks == 0) {
-			/* This group has no free blocks */
-			goto next_group;
-		}
+	/* Update block group free blocks count */
+	uint32_t bg_free_blocks =
+	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
+	bg_free_blocks -= count;
+	ext4_block_group_set_free_blocks_count(bg_ref->block_group, sb,
+	    bg_free_blocks);
+	bg_ref->dirty = true;
 
-		/* Load block with bitmap */
-		bitmap_block_addr =
-		    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
+	return ext4_filesystem_put_block_group_ref(bg_ref);
+}
 
-		rc = block_get(&bitmap_block, inode_ref->fs->device,
-		    bitmap_block_addr, 0);
-		if (rc != EOK) {
-			ext4_filesystem_put_block_group_ref(bg_ref);
-			return rc;
-		}
+/** Compute number of blocks to reserve for data allocation.
+ *
+ * Regular files get a window growing with the position in the file,
+ * so that small files do not waste space and large files are laid
+ * out in long extents.
+ *
+ * @param inode_ref I-node to allocate blocks for
+ * @param iblock    Logical block to allocate
+ * @param want      Requested number of blocks
+ *
+ * @return Number of blocks to reserve
+ *
+ */
+static uint32_t ext4_balloc_prealloc_size(ext4_inode_ref_t *inode_ref,
+    uint32_t iblock, uint32_t want)
+{
+	ext4_superblock_t *sb = inode_ref->fs->superblock;
 
-		/* Compute indexes */
-		first_in_group =
-		    ext4_balloc_get_first_data_block_in_group(sb, bg_ref);
-		index_in_group =
-		    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
-		blocks_in_group = ext4_superblock_get_blocks_in_group(sb, bgid);
+	if (!ext4_inode_is_type(sb, inode_ref->inode, EXT4_INODE_MODE_FILE))
+		return want;
 
-		first_in_group_index =
-		    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	uint32_t size = max(EXT4_BALLOC_PREALLOC_MIN / block_size, 1);
+	uint32_t max_size = min(EXT4_BALLOC_PREALLOC_MAX / block_size,
+	    ext4_superblock_get_blocks_per_group(sb));
 
-		if (index_in_group < first_in_group_index)
-			index_in_group = first_in_group_index;
+	while ((size < iblock) && (size < max_size))
+		size *= 2;
 
-		/* Try to find free byte in bitmap */
-		rc = ext4_bitmap_find_free_byte_and_set_bit(bitmap_block->data,
-		    index_in_group, &rel_block_idx, blocks_in_group);
-		if (rc == EOK) {
-			bitmap_block->dirty = true;
-			rc = block_put(bitmap_block);
-			if (rc != EOK) {
-				ext4_filesystem_put_block_group_ref(bg_ref);
-				return rc;
-			}
+	size = min(size, max_size);
+	size = min(size, EXT4_EXTENT_MAX_INIT_LEN);
+	return max(size, want);
+}
 
-			allocated_block =
-			    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-			    bgid);
+/** Allocate single block.
+ *
+ * Used for metadata blocks (indirect blocks, extent tree nodes,
+ * directory blocks). Preallocation windows are not used.
+ *
+ * @param inode_ref Inode to allocate block for
+ * @param fblock    Allocated block address
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_balloc_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t *fblock)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	uint32_t goal;
+	uint32_t block;
+	uint32_t count;
 
-			goto success;
-		}
+	/* Find GOAL */
+	errno_t rc = ext4_balloc_find_goal(inode_ref, &goal);
+	if (rc != EOK)
+		return rc;
 
-		/* Try to find free bit in bitmap */
-		rc = ext4_bitmap_find_free_bit_and_set(bitmap_block->data,
-		    index_in_group, &rel_block_idx, blocks_in_group);
-		if (rc == EOK) {
-			bitmap_block->dirty = true;
-			rc = block_put(bitmap_block);
-			if (rc != EOK) {
-				ext4_filesystem_put_block_group_ref(bg_ref);
-				return rc;
-			}
+	fibril_mutex_lock(&fs->mballoc.lock);
 
-			allocated_block =
-			    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-			    bgid);
+	rc = ext4_balloc_reserve(fs, goal, 1, &block, &count);
+	if (rc == EOK) {
+		rc = ext4_balloc_commit(inode_ref, block, 1);
+		if (rc != EOK)
+			ext4_balloc_unreserve(fs, block, count);
+	}
 
-			goto success;
-		}
+	fibril_mutex_unlock(&fs->mballoc.lock);
 
-		rc = block_put(bitmap_block);
-		if (rc != EOK) {
-			ext4_filesystem_put_block_group_ref(bg_ref);
-			return rc;
-		}
+	if (rc == EOK)
+		*fblock = block;
 
-	next_group:
-		rc = ext4_filesystem_put_block_group_ref(bg_ref);
+	return rc;
+}
+
+/** Allocate run of data blocks.
+ *
+ * Blocks are taken from the preallocation window of the i-node if
+ * the window continues at @a iblock. Otherwise a new run is found and
+ * the blocks beyond the requested ones are kept as a new window.
+ *
+ * @param inode_ref I-node to allocate blocks for
+ * @param iblock    Logical number of the first block
+ * @param goal      Preferred physical block or 0 to compute it
+ * @param want      Requested number of blocks
+ * @param fblock    Output value for the first allocated block
+ * @param count     Output value for number of allocated blocks,
+ *                  at least one and at most @a want
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_balloc_alloc_blocks(ext4_inode_ref_t *inode_ref, uint32_t iblock,
+    uint32_t goal, uint32_t want, uint32_t *fblock, uint32_t *count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	uint32_t block;
+	uint32_t len;
+	uint32_t n;
+	errno_t rc;
+
+	if (goal == 0) {
+		rc = ext4_balloc_find_goal(inode_ref, &goal);
 		if (rc != EOK)
 			return rc;
-
-		/* Goto next group */
-		bgid = (bgid + 1) % block_group_count;
-		count--;
 	}
 
-	return ENOSPC;
+	fibril_mutex_lock(&fs->mballoc.lock);
 
-success:
-	block_size = ext4_superblock_get_block_size(sb);
+	ext4_prealloc_t *pa = ext4_balloc_prealloc_find(fs, inode_ref->index);
+	if ((pa != NULL) && (pa->iblock != iblock)) {
+		/* Not a sequential write, window would only waste space */
+		ext4_balloc_prealloc_drop(fs, pa);
+		pa = NULL;
+	}
 
-	/* Update superblock free blocks count */
-	uint32_t sb_free_blocks = ext4_superblock_get_free_blocks_count(sb);
-	sb_free_blocks--;
-	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
+	if (pa != NULL) {
+		block = pa->fblock;
+		n = min(want, pa->count);
 
-	/* Update inode blocks (different block size!) count */
-	uint64_t ino_blocks =
-	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
-	ino_blocks += block_size / EXT4_INODE_BLOCK_SIZE;
-	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
-	inode_ref->dirty = true;
+		rc = ext4_balloc_commit(inode_ref, block, n);
+		if (rc != EOK)
+			goto out;
+
+		pa->iblock += n;
+		pa->fblock += n;
+		pa->count -= n;
+		if (pa->count == 0) {
+			list_remove(&pa->link);
+			free(pa);
+		}
+	} else {
+		rc = ext4_balloc_reserve(fs, goal,
+		    ext4_balloc_prealloc_size(inode_ref, iblock, want),
+		    &block, &len);
+		if (rc != EOK)
+			goto out;
 
-	/* Update block group free blocks count */
-	uint32_t bg_free_blocks =
-	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
-	bg_free_blocks--;
-	ext4_block_group_set_free_blocks_count(bg_ref->block_group, sb,
-	    bg_free_blocks);
-	bg_ref->dirty = true;
+		n = min(want, len);
 
-	rc = ext4_filesystem_put_block_group_ref(bg_ref);
+		rc = ext4_balloc_commit(inode_ref, block, n);
+		if (rc != EOK) {
+			ext4_balloc_unreserve(fs, block, len);
+			goto out;
+		}
 
-	*fblock = allocated_block;
+		if (len > n) {
+			pa = malloc(sizeof(ext4_prealloc_t));
+			if (pa == NULL) {
+				ext4_balloc_unreserve(fs, block + n, len - n);
+			} else {
+				link_initialize(&pa->link);
+				pa->inode = inode_ref->index;
+				pa->iblock = iblock + n;
+				pa->fblock = block + n;
+				pa->count = len - n;
+				list_append(&pa->link, &fs->mballoc.prealloc);
+			}
+		}
+	}
+
+	*fblock = block;
+	*count = n;
+out:
+	fibril_mutex_unlock(&fs->mballoc.lock);
 	return rc;
 }
 
@@ -618,18 +938,36 @@ success:
  *
  * @param inode_ref Inode to allocate block for
  * @param fblock    Block address to allocate
- * @param free      Output value - if target block is free
+ * @param is_free   Output value - if target block is free
  *
  * @return Error code
  *
  */
 errno_t ext4_balloc_try_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t fblock,
-    bool *free)
+    bool *is_free)
 {
-	errno_t rc;
-
 	ext4_filesystem_t *fs = inode_ref->fs;
 	ext4_superblock_t *sb = fs->superblock;
+	errno_t rc;
+
+	fibril_mutex_lock(&fs->mballoc.lock);
+
+	/* Block may be the next one in the window of the i-node */
+	ext4_prealloc_t *pa = ext4_balloc_prealloc_find(fs, inode_ref->index);
+	if ((pa != NULL) && (pa->fblock == fblock)) {
+		rc = ext4_balloc_commit(inode_ref, fblock, 1);
+		if (rc == EOK) {
+			*is_free = true;
+			pa->iblock++;
+			pa->fblock++;
+			if (--pa->count == 0) {
+				list_remove(&pa->link);
+				free(pa);
+			}
+		}
+
+		goto out;
+	}
 
 	/* Compute indexes */
 	uint32_t block_group = ext4_filesystem_blockaddr2group(sb, fblock);
@@ -640,63 +978,53 @@ errno_t ext4_balloc_try_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t fblock
 	ext4_block_group_ref_t *bg_ref;
 	rc = ext4_filesystem_get_block_group_ref(fs, block_group, &bg_ref);
 	if (rc != EOK)
-		return rc;
+		goto out;
 
-	/* Load block with bitmap */
-	uint32_t bitmap_block_addr =
-	    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
-	block_t *bitmap_block;
-	rc = block_get(&bitmap_block, fs->device, bitmap_block_addr, 0);
+	ext4_buddy_t *buddy;
+	rc = ext4_balloc_get_buddy(bg_ref, &buddy);
 	if (rc != EOK) {
 		ext4_filesystem_put_block_group_ref(bg_ref);
-		return rc;
+		goto out;
 	}
 
-	/* Check if block is free */
-	*free = ext4_bitmap_is_free_bit(bitmap_block->data, index_in_group);
-
-	/* Allocate block if possible */
-	if (*free) {
-		ext4_bitmap_set_bit(bitmap_block->data, index_in_group);
-		bitmap_block->dirty = true;
-	}
-
-	/* Release block with bitmap */
-	rc = block_put(bitmap_block);
-	if (rc != EOK) {
-		/* Error in saving bitmap */
-		ext4_filesystem_put_block_group_ref(bg_ref);
-		return rc;
-	}
+	rc = ext4_filesystem_put_block_group_ref(bg_ref);
+	if (rc != EOK)
+		goto out;
 
-	/* If block is not free, return */
-	if (!(*free))
-		goto terminate;
+	/* Check if block is free */
+	*is_free = ext4_buddy_is_free(buddy, index_in_group);
+	if (!*is_free)
+		goto out;
 
-	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	/* Allocate block */
+	ext4_buddy_mark_used(buddy, index_in_group, 1);
+	rc = ext4_balloc_commit(inode_ref, fblock, 1);
+	if (rc != EOK)
+		ext4_buddy_mark_free(buddy, index_in_group, 1);
 
-	/* Update superblock free blocks count */
-	uint32_t sb_free_blocks = ext4_superblock_get_free_blocks_count(sb);
-	sb_free_blocks--;
-	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
+out:
+	fibril_mutex_unlock(&fs->mballoc.lock);
+	return rc;
+}
 
-	/* Update inode blocks count */
-	uint64_t ino_blocks =
-	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
-	ino_blocks += block_size / EXT4_INODE_BLOCK_SIZE;
-	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
-	inode_ref->dirty = true;
+/** Release preallocation window of i-node.
+ *
+ * Called when the i-node is no longer written to, so that the reserved
+ * blocks can be used by other files.
+ *
+ * @param fs    Filesystem
+ * @param inode I-node number
+ *
+ */
+void ext4_balloc_release_prealloc(ext4_filesystem_t *fs, uint32_t inode)
+{
+	fibril_mutex_lock(&fs->mballoc.lock);
 
-	/* Update block group free blocks count */
-	uint32_t free_blocks =
-	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
-	free_blocks--;
-	ext4_block_group_set_free_blocks_count(bg_ref->block_group,
-	    sb, free_blocks);
-	bg_ref->dirty = true;
+	ext4_prealloc_t *pa = ext4_balloc_prealloc_find(fs, inode);
+	if (pa != NULL)
+		ext4_balloc_prealloc_drop(fs, pa);
 
-terminate:
-	return ext4_filesystem_put_block_group_ref(bg_ref);
+	fibril_mutex_unlock(&fs->mballoc.lock);
 }
 
 /**
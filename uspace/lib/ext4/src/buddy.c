@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libext4
+ * @{
+ */
+/**
+ * @file  buddy.c
+ * @brief Buddy bitmaps of free blocks in a block group.
+ *
+ * The buddy bitmaps are built from the on-disk block bitmap when the
+ * block group is first used by the allocator. They allow finding
+ * a free run of blocks of the requested length without scanning
+ * the on-disk bitmap bit by bit.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "ext4/buddy.h"
+
+static bool buddy_bit_get(uint8_t *map, uint32_t index)
+{
+	return (map[index / 8] & (1 << (index % 8))) != 0;
+}
+
+static void buddy_bit_set(uint8_t *map, uint32_t index)
+{
+	map[index / 8] |= 1 << (index % 8);
+}
+
+static void buddy_bit_clear(uint8_t *map, uint32_t index)
+{
+	map[index / 8] &= ~(1 << (index % 8));
+}
+
+/** Get number of chunks of the given order.
+ *
+ * Chunks not entirely inside the block group are not tracked.
+ *
+ */
+static uint32_t buddy_chunks(ext4_buddy_t *buddy, unsigned order)
+{
+	return buddy->blocks >> order;
+}
+
+/** Update free chunk bit of higher order after its halves changed.
+ *
+ * @param buddy Buddy bitmaps
+ * @param order Order of the chunk, at least 1
+ * @param index Index of the chunk
+ *
+ */
+static void buddy_update(ext4_buddy_t *buddy, unsigned order, uint32_t index)
+{
+	uint8_t *lower = buddy->map[order - 1];
+	bool free = buddy_bit_get(lower, 2 * index) &&
+	    buddy_bit_get(lower, 2 * index + 1);
+	bool was_free = buddy_bit_get(buddy->map[order], index);
+
+	if (free && !was_free) {
+		buddy_bit_set(buddy->map[order], index);
+		buddy->count[order]++;
+	} else if (!free && was_free) {
+		buddy_bit_clear(buddy->map[order], index);
+		buddy->count[order]--;
+	}
+}
+
+/** Initialize buddy bitmaps.
+ *
+ * @param buddy  Buddy bitmaps to initialize
+ * @param bitmap On-disk block bitmap (set bit means used block)
+ * @param blocks Number of blocks in the block group
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_buddy_init(ext4_buddy_t *buddy, const uint8_t *bitmap,
+    uint32_t blocks)
+{
+	unsigned order;
+	size_t size = 0;
+
+	buddy->blocks = blocks;
+	buddy->max_order = 0;
+	while ((buddy->max_order < EXT4_BUDDY_MAX_ORDER) &&
+	    ((blocks >> (buddy->max_order + 1)) > 0))
+		buddy->max_order++;
+
+	for (order = 0; order <= buddy->max_order; order++)
+		size += (buddy_chunks(buddy, order) + 7) / 8;
+
+	uint8_t *data = calloc(1, size);
+	if (data == NULL)
+		return ENOMEM;
+
+	for (order = 0; order <= EXT4_BUDDY_MAX_ORDER; order++) {
+		buddy->count[order] = 0;
+		if (order > buddy->max_order) {
+			buddy->map[order] = NULL;
+			continue;
+		}
+
+		buddy->map[order] = data;
+		data += (buddy_chunks(buddy, order) + 7) / 8;
+	}
+
+	buddy->free = 0;
+	for (uint32_t i = 0; i < blocks; i++) {
+		if ((bitmap[i / 8] & (1 << (i % 8))) == 0) {
+			buddy_bit_set(buddy->map[0], i);
+			buddy->free++;
+		}
+	}
+
+	buddy->count[0] = buddy->free;
+	for (order = 1; order <= buddy->max_order; order++) {
+		uint32_t chunks = buddy_chunks(buddy, order);
+		for (uint32_t i = 0; i < chunks; i++)
+			buddy_update(buddy, order, i);
+	}
+
+	return EOK;
+}
+
+/** Release buddy bitmaps.
+ *
+ * @param buddy Buddy bitmaps
+ *
+ */
+void ext4_buddy_fini(ext4_buddy_t *buddy)
+{
+	/* All orders share one allocation */
+	free(buddy->map[0]);
+	buddy->map[0] = NULL;
+}
+
+/** Check if block is free.
+ *
+ * @param buddy Buddy bitmaps
+ * @param index Index of block in the block group
+ *
+ * @return True if the block is free
+ *
+ */
+bool ext4_buddy_is_free(ext4_buddy_t *buddy, uint32_t index)
+{
+	if (index >= buddy->blocks)
+		return false;
+
+	return buddy_bit_get(buddy->map[0], index);
+}
+
+/** Mark run of blocks used.
+ *
+ * @param buddy Buddy bitmaps
+ * @param first Index of the first block in the block group
+ * @param count Number of blocks
+ *
+ */
+void ext4_buddy_mark_used(ext4_buddy_t *buddy, uint32_t first,
+    uint32_t count)
+{
+	if (count == 0)
+		return;
+
+	uint32_t last = first + count - 1;
+
+	for (unsigned order = 0; order <= buddy->max_order; order++) {
+		uint32_t chunks = buddy_chunks(buddy, order);
+		uint8_t *map = buddy->map[order];
+
+		for (uint32_t i = first >> order;
+		    (i <= (last >> order)) && (i < chunks); i++) {
+			if (buddy_bit_get(map, i)) {
+				buddy_bit_clear(map, i);
+				buddy->count[order]--;
+			}
+		}
+	}
+
+	buddy->free = buddy->count[0];
+}
+
+/** Mark run of blocks free.
+ *
+ * @param buddy Buddy bitmaps
+ * @param first Index of the first block in the block group
+ * @param count Number of blocks
+ *
+ */
+void ext4_buddy_mark_free(ext4_buddy_t *buddy, uint32_t first,
+    uint32_t count)
+{
+	if (count == 0)
+		return;
+
+	uint32_t last = first + count - 1;
+	if (last >= buddy->blocks)
+		last = buddy->blocks - 1;
+
+	for (uint32_t i = first; i <= last; i++) {
+		if (!buddy_bit_get(buddy->map[0], i)) {
+			buddy_bit_set(buddy->map[0], i);
+			buddy->count[0]++;
+		}
+	}
+
+	for (unsigned order = 1; order <= buddy->max_order; order++) {
+		uint32_t chunks = buddy_chunks(buddy, order);
+
+		for (uint32_t i = first >> order;
+		    (i <= (last >> order)) && (i < chunks); i++)
+			buddy_update(buddy, order, i);
+	}
+
+	buddy->free = buddy->count[0];
+}
+
+/** Get length of the free run starting at given block.
+ *
+ * @param buddy Buddy bitmaps
+ * @param first Index of the first block in the block group
+ * @param max   Maximum length of interest
+ *
+ * @return Number of free blocks following @a first (inclusive),
+ *         at most @a max
+ *
+ */
+uint32_t ext4_buddy_free_run(ext4_buddy_t *buddy, uint32_t first,
+    uint32_t max)
+{
+	uint32_t len = 0;
+	uint32_t i = first;
+
+	while ((len < max) && (i < buddy->blocks)) {
+		/* Skip whole bytes of free blocks */
+		if (((i % 8) == 0) && (buddy->map[0][i / 8] == 0xff) &&
+		    (i + 8 <= buddy->blocks)) {
+			len += 8;
+			i += 8;
+			continue;
+		}
+
+		if (!buddy_bit_get(buddy->map[0], i))
+			break;
+
+		len++;
+		i++;
+	}
+
+	return len < max ? len : max;
+}
+
+/** Scan bitmap for a set bit.
+ *
+ * @param map  Bitmap
+ * @param from First bit to check
+ * @param to   Bit after the last bit to check
+ *
+ * @return Index of the first set bit or @a to if there is none
+ *
+ */
+static uint32_t buddy_scan(uint8_t *map, uint32_t from, uint32_t to)
+{
+	uint32_t i = from;
+
+	while (i < to) {
+		/* Skip whole bytes without free chunks */
+		if (((i % 8) == 0) && (i + 8 <= to) && (map[i / 8] == 0)) {
+			i += 8;
+			continue;
+		}
+
+		if (buddy_bit_get(map, i))
+			return i;
+
+		i++;
+	}
+
+	return to;
+}
+
+/** Find free chunk of given order.
+ *
+ * The search starts at the chunk containing @a goal and wraps around
+ * at the end of the block group.
+ *
+ * @param buddy Buddy bitmaps
+ * @param order Order of the chunk
+ * @param goal  Preferred block index
+ *
+ * @return Index of the first block of the chunk or number of blocks
+ *         in the group if there is no free chunk
+ *
+ */
+static uint32_t buddy_find_chunk(ext4_buddy_t *buddy, unsigned order,
+    uint32_t goal)
+{
+	uint32_t chunks = buddy_chunks(buddy, order);
+	uint8_t *map = buddy->map[order];
+	uint32_t start = goal >> order;
+
+	if (start >= chunks)
+		start = 0;
+
+	uint32_t i = buddy_scan(map, start, chunks);
+	if (i == chunks) {
+		i = buddy_scan(map, 0, start);
+		if (i == start)
+			return buddy->blocks;
+	}
+
+	return i << order;
+}
+
+/** Find free run of blocks.
+ *
+ * The run starting at @a goal is preferred if it is long enough. Then
+ * the smallest chunk of order satisfying the request is used, so that
+ * large free areas are not split needlessly. If no such chunk exists,
+ * the longest available run close to @a goal is returned.
+ *
+ * The blocks are not marked used.
+ *
+ * @param buddy Buddy bitmaps
+ * @param goal  Preferred index of the first block
+ * @param want  Requested number of blocks
+ * @param start Output value for index of the first block of the run
+ * @param len   Output value for length of the run, at most @a want
+ *
+ * @return True if some free blocks were found
+ *
+ */
+bool ext4_buddy_find(ext4_buddy_t *buddy, uint32_t goal, uint32_t want,
+    uint32_t *start, uint32_t *len)
+{
+	uint32_t best_start = 0;
+	uint32_t best_len = 0;
+	unsigned order;
+
+	if ((buddy->free == 0) || (want == 0))
+		return false;
+
+	/* Try to continue at the goal */
+	if (ext4_buddy_is_free(buddy, goal)) {
+		best_start = goal;
+		best_len = ext4_buddy_free_run(buddy, goal, want);
+		if (best_len == want)
+			goto found;
+	}
+
+	/* Smallest order covering the request */
+	unsigned want_order = 0;
+	while ((want_order < buddy->max_order) &&
+	    (((uint32_t) 1 << want_order) < want))
+		want_order++;
+
+	for (order = want_order; order <= buddy->max_order; order++) {
+		if (buddy->count[order] == 0)
+			continue;
+
+		uint32_t first = buddy_find_chunk(buddy, order, goal);
+		uint32_t run = ext4_buddy_free_run(buddy, first, want);
+		if (run > best_len) {
+			best_start = first;
+			best_len = run;
+		}
+
+		goto found;
+	}
+
+	/* Request cannot be satisfied, take the largest chunk available */
+	for (order = want_order; order > 0; order--) {
+		if (buddy->count[order - 1] == 0)
+			continue;
+
+		uint32_t first = buddy_find_chunk(buddy, order - 1, goal);
+		uint32_t run = ext4_buddy_free_run(buddy, first, want);
+
+		/* The chunk may be in the middle of a longer run */
+		while ((first > 0) && (run < want) &&
+		    ext4_buddy_is_free(buddy, first - 1)) {
+			first--;
+			run++;
+		}
+
+		if (run > best_len) {
+			best_start = first;
+			best_len = run;
+		}
+
+		break;
+	}
+
+found:
+	if (best_len == 0)
+		return false;
+
+	*start = best_start;
+	*len = best_len;
+	return true;
+}
+
+/**
+ * @}
+ */
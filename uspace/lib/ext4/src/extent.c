@@ -36,6 +36,7 @@
 
 #include <byteorder.h>
 #include <errno.h>
+#include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
 #include "ext4/balloc.h"
@@ -441,6 +442,117 @@ errno_t ext4_extent_find_block(ext4_inode_ref_t *inode_ref, uint32_t iblock,
 	return rc;
 }
 
+/** Find run of physical blocks in the extent tree by logical block number.
+ *
+ * Determines the physical block of @a iblock together with the number
+ * of following logical blocks mapped to consecutive physical blocks,
+ * which allows transferring the whole run at once. Holes and
+ * uninitialized extents are reported with zero physical block and
+ * the number of logical blocks up to the next initialized data.
+ *
+ * @param inode_ref I-node to load blocks from
+ * @param iblock    Logical block number to find
+ * @param fblock    Output value for physical block number
+ * @param count     Output value for number of blocks in the run
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_extent_find_block_run(ext4_inode_ref_t *inode_ref,
+    uint32_t iblock, uint32_t *fblock, uint32_t *count)
+{
+	errno_t rc = EOK;
+	uint64_t inode_size =
+	    ext4_inode_get_size(inode_ref->fs->superblock, inode_ref->inode);
+
+	uint32_t block_size =
+	    ext4_superblock_get_block_size(inode_ref->fs->superblock);
+
+	/* Number of blocks from iblock to the end of i-node */
+	uint64_t blocks = (inode_size + block_size - 1) / block_size;
+	if (iblock >= blocks) {
+		*fblock = 0;
+		*count = 1;
+		return EOK;
+	}
+
+	uint32_t limit = min(blocks, UINT32_MAX);
+	block_t *block = NULL;
+
+	/* Walk through extent tree remembering the bound of the subtree */
+	ext4_extent_header_t *header =
+	    ext4_inode_get_extent_header(inode_ref->inode);
+
+	while (ext4_extent_header_get_depth(header) != 0) {
+		ext4_extent_index_t *index;
+		ext4_extent_binsearch_idx(header, &index, iblock);
+
+		ext4_extent_index_t *last = EXT4_EXTENT_FIRST_INDEX(header) +
+		    ext4_extent_header_get_entries_count(header) - 1;
+		if (index < last) {
+			limit = min(limit,
+			    ext4_extent_index_get_first_block(index + 1));
+		}
+
+		uint64_t child = ext4_extent_index_get_leaf(index);
+
+		if (block != NULL) {
+			rc = block_put(block);
+			if (rc != EOK)
+				return rc;
+		}
+
+		rc = block_get(&block, inode_ref->fs->device, child,
+		    BLOCK_FLAGS_NONE);
+		if (rc != EOK)
+			return rc;
+
+		header = (ext4_extent_header_t *)block->data;
+	}
+
+	ext4_extent_t *extent = NULL;
+	ext4_extent_binsearch(header, &extent, iblock);
+
+	*fblock = 0;
+	*count = limit - iblock;
+
+	if (extent != NULL) {
+		uint32_t first = ext4_extent_get_first_block(extent);
+		uint32_t len = ext4_extent_get_block_count(extent);
+		bool uninit = false;
+
+		if (len > EXT4_EXTENT_MAX_INIT_LEN) {
+			len -= EXT4_EXTENT_MAX_INIT_LEN;
+			uninit = true;
+		}
+
+		ext4_extent_t *last = EXT4_EXTENT_FIRST(header) +
+		    ext4_extent_header_get_entries_count(header) - 1;
+
+		if (iblock < first) {
+			/* Hole before the first extent of the leaf */
+			*count = min(*count, first - iblock);
+		} else if (iblock < first + len) {
+			/* Inside of the extent */
+			if (!uninit)
+				*fblock = ext4_extent_get_start(extent) + iblock - first;
+			*count = min(*count, first + len - iblock);
+		} else if (extent < last) {
+			/* Hole between two extents */
+			*count = min(*count,
+			    ext4_extent_get_first_block(extent + 1) - iblock);
+		}
+	}
+
+	if (*count == 0)
+		*count = 1;
+
+	if (block != NULL)
+		rc = block_put(block);
+
+	return rc;
+}
+
 /** Find extent for specified iblock.
  *
  * This function is used for finding block in the extent tree with
@@ -631,23 +743,33 @@ errno_t ext4_extent_release_blocks_from(ext4_inode_ref_t *inode_ref,
 	while (path_ptr->depth != 0)
 		path_ptr++;
 
-	assert(path_ptr->extent != NULL);
+	/* Nothing is mapped */
+	if (path_ptr->extent == NULL)
+		goto cleanup;
 
-	/* First extent maybe released partially */
+	/*
+	 * First extent maybe released partially. The first block to release
+	 * may also lie in a hole following the extent.
+	 */
 	uint32_t first_iblock =
 	    ext4_extent_get_first_block(path_ptr->extent);
-	uint32_t first_fblock =
-	    ext4_extent_get_start(path_ptr->extent) + iblock_from - first_iblock;
-
 	uint16_t block_count = ext4_extent_get_block_count(path_ptr->extent);
 
-	uint16_t delete_count = block_count -
-	    (ext4_extent_get_start(path_ptr->extent) - first_fblock);
+	uint16_t keep_count = 0;
+	if (iblock_from > first_iblock)
+		keep_count = min(iblock_from - first_iblock, block_count);
+
+	uint32_t first_fblock =
+	    ext4_extent_get_start(path_ptr->extent) + keep_count;
+	uint16_t delete_count = block_count - keep_count;
 
 	/* Release all blocks */
-	rc = ext4_balloc_free_blocks(inode_ref, first_fblock, delete_count);
-	if (rc != EOK)
-		goto cleanup;
+	if (delete_count > 0) {
+		rc = ext4_balloc_free_blocks(inode_ref, first_fblock,
+		    delete_count);
+		if (rc != EOK)
+			goto cleanup;
+	}
 
 	/* Correct counter */
 	block_count -= delete_count;
@@ -948,39 +1070,60 @@ static errno_t ext4_extent_append_extent(ext4_inode_ref_t *inode_ref,
 	return EOK;
 }
 
-/** Append data block to the i-node.
+/** Check that extent path points to the last extent of the tree.
  *
- * This function allocates data block, tries to append it
- * to some existing extent or creates new extents.
- * It includes possible extent tree modifications (splitting).
+ * @param path Path in the extent tree
  *
- * @param inode_ref I-node to append block to
- * @param iblock    Output logical number of newly allocated block
- * @param fblock    Output physical block address of newly allocated block
- *
- * @return Error code
+ * @return True if no extent follows the one on the path
  *
  */
-errno_t ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
-    uint32_t *fblock, bool update_size)
+static bool ext4_extent_path_is_last(ext4_extent_path_t *path)
 {
-	ext4_superblock_t *sb = inode_ref->fs->superblock;
-	uint64_t inode_size = ext4_inode_get_size(sb, inode_ref->inode);
-	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	for (ext4_extent_path_t *path_ptr = path; ; path_ptr++) {
+		uint16_t entries =
+		    ext4_extent_header_get_entries_count(path_ptr->header);
 
-	/* Calculate number of new logical block */
-	uint32_t new_block_idx = 0;
-	if (inode_size > 0) {
-		if ((inode_size % block_size) != 0)
-			inode_size += block_size - (inode_size % block_size);
+		if (path_ptr->depth == 0) {
+			return (path_ptr->extent == NULL) ||
+			    (path_ptr->extent ==
+			    EXT4_EXTENT_FIRST(path_ptr->header) + entries - 1);
+		}
 
-		new_block_idx = inode_size / block_size;
+		if (path_ptr->index !=
+		    EXT4_EXTENT_FIRST_INDEX(path_ptr->header) + entries - 1)
+			return false;
 	}
+}
+
+/** Append run of data blocks to the i-node.
+ *
+ * This function allocates up to @a want data blocks for logical blocks
+ * starting at @a iblock and maps them by extending the last extent or
+ * by creating a new extent. It includes possible extent tree
+ * modifications (splitting). Blocks between the last extent and
+ * @a iblock are left unmapped (sparse). The i-node size is not
+ * changed.
+ *
+ * @param inode_ref I-node to append blocks to
+ * @param iblock    Logical number of the first block, it must follow
+ *                  all blocks mapped by the i-node
+ * @param want      Requested number of blocks
+ * @param fblock    Output physical address of the first allocated block
+ * @param count     Output number of allocated (contiguous) blocks
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_extent_append_blocks(ext4_inode_ref_t *inode_ref, uint32_t iblock,
+    uint32_t want, uint32_t *fblock, uint32_t *count)
+{
+	uint32_t phys_block = 0;
+	uint32_t allocated = 0;
 
 	/* Load the nearest leaf (with extent) */
 	ext4_extent_path_t *path;
 	errno_t rc2;
-	errno_t rc = ext4_extent_find_extent(inode_ref, new_block_idx, &path);
+	errno_t rc = ext4_extent_find_extent(inode_ref, iblock, &path);
 	if (rc != EOK)
 		return rc;
 
@@ -989,80 +1132,82 @@ errno_t ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
 	while (path_ptr->depth != 0)
 		path_ptr++;
 
+	/* Inserting blocks before existing extents is not supported */
+	if (!ext4_extent_path_is_last(path)) {
+		rc = ENOTSUP;
+		goto finish;
+	}
+
 	/* Add new extent to the node if not present */
 	if (path_ptr->extent == NULL)
 		goto append_extent;
 
+	uint32_t first_block = ext4_extent_get_first_block(path_ptr->extent);
 	uint16_t block_count = ext4_extent_get_block_count(path_ptr->extent);
-	uint16_t block_limit = (1 << 15);
 
-	uint32_t phys_block = 0;
-	if (block_count < block_limit) {
-		/* There is space for new block in the extent */
-		if (block_count == 0) {
-			/* Existing extent is empty */
-			rc = ext4_balloc_alloc_block(inode_ref, &phys_block);
-			if (rc != EOK)
-				goto finish;
+	if (block_count == 0) {
+		/* Existing extent is empty */
+		rc = ext4_balloc_alloc_blocks(inode_ref, iblock, 0,
+		    min(want, EXT4_EXTENT_MAX_INIT_LEN), &phys_block, &allocated);
+		if (rc != EOK)
+			goto finish;
 
-			/* Initialize extent */
-			ext4_extent_set_first_block(path_ptr->extent, new_block_idx);
-			ext4_extent_set_start(path_ptr->extent, phys_block);
-			ext4_extent_set_block_count(path_ptr->extent, 1);
+		/* Initialize extent */
+		ext4_extent_set_first_block(path_ptr->extent, iblock);
+		ext4_extent_set_start(path_ptr->extent, phys_block);
+		ext4_extent_set_block_count(path_ptr->extent, allocated);
 
-			/* Update i-node */
-			if (update_size) {
-				ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-				inode_ref->dirty = true;
-			}
+		path_ptr->block->dirty = true;
 
-			path_ptr->block->dirty = true;
+		goto finish;
+	}
 
-			goto finish;
-		} else {
-			/* Existing extent contains some blocks */
-			phys_block = ext4_extent_get_start(path_ptr->extent);
-			phys_block += ext4_extent_get_block_count(path_ptr->extent);
+	/* Uninitialized extents have the length above the limit */
+	uint32_t extent_end = first_block +
+	    (block_count > EXT4_EXTENT_MAX_INIT_LEN ?
+	    block_count - EXT4_EXTENT_MAX_INIT_LEN : block_count);
+	if (iblock < extent_end) {
+		rc = EINVAL;
+		goto finish;
+	}
 
-			/* Check if the following block is free for allocation */
-			bool free;
-			rc = ext4_balloc_try_alloc_block(inode_ref, phys_block, &free);
-			if (rc != EOK)
-				goto finish;
+	if ((block_count < EXT4_EXTENT_MAX_INIT_LEN) && (iblock == extent_end)) {
+		/* Try to continue with the following physical blocks */
+		uint32_t goal = ext4_extent_get_start(path_ptr->extent) +
+		    block_count;
 
-			if (!free) {
-				/* Target is not free, new block must be appended to new extent */
-				goto append_extent;
-			}
+		rc = ext4_balloc_alloc_blocks(inode_ref, iblock, goal,
+		    min(want, (uint32_t) (EXT4_EXTENT_MAX_INIT_LEN -
+		    block_count)),
+		    &phys_block, &allocated);
+		if (rc != EOK)
+			goto finish;
 
+		if (phys_block == goal) {
 			/* Update extent */
-			ext4_extent_set_block_count(path_ptr->extent, block_count + 1);
-
-			/* Update i-node */
-			if (update_size) {
-				ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-				inode_ref->dirty = true;
-			}
-
+			ext4_extent_set_block_count(path_ptr->extent,
+			    block_count + allocated);
 			path_ptr->block->dirty = true;
 
 			goto finish;
 		}
+
+		/* Blocks are not contiguous, they go to a new extent */
+		goto new_extent;
 	}
 
 append_extent:
-	/* Append new extent to the tree */
-	phys_block = 0;
-
-	/* Allocate new data block */
-	rc = ext4_balloc_alloc_block(inode_ref, &phys_block);
+	/* Allocate new data blocks */
+	rc = ext4_balloc_alloc_blocks(inode_ref, iblock, 0,
+	    min(want, EXT4_EXTENT_MAX_INIT_LEN), &phys_block, &allocated);
 	if (rc != EOK)
 		goto finish;
 
-	/* Append extent for new block (includes tree splitting if needed) */
-	rc = ext4_extent_append_extent(inode_ref, path, new_block_idx);
+new_extent:
+	/* Append extent for new blocks (includes tree splitting if needed) */
+	rc = ext4_extent_append_extent(inode_ref, path, iblock);
 	if (rc != EOK) {
-		ext4_balloc_free_block(inode_ref, phys_block);
+		ext4_balloc_free_blocks(inode_ref, phys_block, allocated);
 		goto finish;
 	}
 
@@ -1070,24 +1215,18 @@ append_extent:
 	path_ptr = path + tree_depth;
 
 	/* Initialize newly created extent */
-	ext4_extent_set_block_count(path_ptr->extent, 1);
-	ext4_extent_set_first_block(path_ptr->extent, new_block_idx);
+	ext4_extent_set_block_count(path_ptr->extent, allocated);
+	ext4_extent_set_first_block(path_ptr->extent, iblock);
 	ext4_extent_set_start(path_ptr->extent, phys_block);
 
-	/* Update i-node */
-	if (update_size) {
-		ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-		inode_ref->dirty = true;
-	}
-
 	path_ptr->block->dirty = true;
 
 finish:
 	rc2 = EOK;
 
 	/* Set return values */
-	*iblock = new_block_idx;
 	*fblock = phys_block;
+	*count = allocated;
 
 	/*
 	 * Put loaded blocks
@@ -1107,6 +1246,53 @@ finish:
 	return rc;
 }
 
+/** Append data block to the i-node.
+ *
+ * This function allocates data block, tries to append it
+ * to some existing extent or creates new extents.
+ * It includes possible extent tree modifications (splitting).
+ *
+ * @param inode_ref   I-node to append block to
+ * @param iblock      Output logical number of newly allocated block
+ * @param fblock      Output physical block address of newly allocated block
+ * @param update_size Extend the i-node size by the new block
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
+    uint32_t *fblock, bool update_size)
+{
+	ext4_superblock_t *sb = inode_ref->fs->superblock;
+	uint64_t inode_size = ext4_inode_get_size(sb, inode_ref->inode);
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+
+	/* Calculate number of new logical block */
+	uint32_t new_block_idx = 0;
+	if (inode_size > 0) {
+		if ((inode_size % block_size) != 0)
+			inode_size += block_size - (inode_size % block_size);
+
+		new_block_idx = inode_size / block_size;
+	}
+
+	uint32_t count;
+	errno_t rc = ext4_extent_append_blocks(inode_ref, new_block_idx, 1,
+	    fblock, &count);
+	if (rc != EOK)
+		return rc;
+
+	*iblock = new_block_idx;
+
+	/* Update i-node */
+	if (update_size) {
+		ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
+		inode_ref->dirty = true;
+	}
+
+	return EOK;
+}
+
 /**
  * @}
  */
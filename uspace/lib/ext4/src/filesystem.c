@@ -36,8 +36,10 @@
  * @brief More complex filesystem operations.
  */
 
+#include <assert.h>
 #include <byteorder.h>
 #include <errno.h>
+#include <macros.h>
 #include <mem.h>
 #include <align.h>
 #include <crypto.h>
@@ -53,6 +55,7 @@
 #include "ext4/filesystem.h"
 #include "ext4/ialloc.h"
 #include "ext4/inode.h"
+#include "ext4/journal.h"
 #include "ext4/ops.h"
 #include "ext4/superblock.h"
 
@@ -137,7 +140,45 @@ static errno_t ext4_filesystem_init(ext4_filesystem_t *fs, service_id_t service_
 	if (rc != EOK)
 		goto err_2;
 
+	/* Load journal and replay transactions if not unmounted cleanly */
+	bool replayed;
+	rc = ext4_journal_load(fs, &replayed);
+	if (rc != EOK)
+		goto err_2;
+
+	if (replayed) {
+		/* Recovery bypassed the cache, start over with an empty one */
+		rc = block_cache_fini(fs->device);
+		if (rc != EOK)
+			goto err_3;
+
+		rc = block_cache_init(service_id, block_size, 0, cmode);
+		if (rc != EOK)
+			goto err_3;
+
+		uint32_t features = ext4_superblock_get_features_incompatible(
+		    fs->superblock);
+
+		rc = ext4_superblock_read_direct(fs->device, &temp_superblock);
+		if (rc != EOK)
+			goto err_3;
+
+		free(fs->superblock);
+		fs->superblock = temp_superblock;
+
+		/* Keep the recovery flag as updated by the journal */
+		ext4_superblock_set_features_incompatible(fs->superblock,
+		    features);
+	}
+
+	/* Initialize block allocator */
+	rc = ext4_balloc_init(fs);
+	if (rc != EOK)
+		goto err_3;
+
 	return EOK;
+err_3:
+	ext4_journal_fini(fs);
 err_2:
 	block_cache_fini(fs->device);
 err_1:
@@ -155,6 +196,12 @@ err:
  */
 static void ext4_filesystem_fini(ext4_filesystem_t *fs)
 {
+	/* Release journal and blocks held by the running transaction */
+	ext4_journal_fini(fs);
+
+	/* Release block allocator state */
+	ext4_balloc_fini(fs);
+
 	/* Release memory space for superblock */
 	free(fs->superblock);
 
@@ -445,6 +492,11 @@ errno_t ext4_filesystem_open(ext4_instance_t *inst, service_id_t service_id,
 	if (rc != EOK)
 		goto error;
 
+	/* Start journalling (marks the volume as needing recovery) */
+	rc = ext4_journal_activate(fs);
+	if (rc != EOK)
+		goto error;
+
 	/* Mark system as mounted */
 	ext4_superblock_set_state(fs->superblock, EXT4_SUPERBLOCK_STATE_ERROR_FS);
 	rc = ext4_superblock_write_direct(fs->device, fs->superblock);
@@ -481,9 +533,14 @@ error:
  */
 errno_t ext4_filesystem_close(ext4_filesystem_t *fs)
 {
+	/* Commit all changes and leave the journal empty */
+	errno_t rc = ext4_journal_shutdown(fs);
+	if (rc != EOK)
+		return rc;
+
 	/* Write the superblock to the device */
 	ext4_superblock_set_state(fs->superblock, EXT4_SUPERBLOCK_STATE_VALID_FS);
-	errno_t rc = ext4_superblock_write_direct(fs->device, fs->superblock);
+	rc = ext4_superblock_write_direct(fs->device, fs->superblock);
 	if (rc != EOK)
 		return rc;
 
@@ -521,6 +578,11 @@ static errno_t ext4_filesystem_check_features(ext4_filesystem_t *fs,
 	incompatible_features =
 	    ext4_superblock_get_features_incompatible(fs->superblock);
 	incompatible_features &= ~EXT4_FEATURE_INCOMPAT_SUPP;
+
+	/* Journal recovery is done when the journal is loaded */
+	if (ext4_superblock_has_feature_compatible(fs->superblock,
+	    EXT4_FEATURE_COMPAT_HAS_JOURNAL))
+		incompatible_features &= ~EXT4_FEATURE_INCOMPAT_RECOVER;
 	if (incompatible_features > 0)
 		return ENOTSUP;
 
@@ -1179,6 +1241,9 @@ errno_t ext4_filesystem_get_inode_ref(ext4_filesystem_t *fs, uint32_t index,
 	newref->fs = fs;
 	newref->dirty = false;
 
+	/* Let the journal commit in-place changes of the i-node */
+	ext4_journal_inode_get(newref);
+
 	*ref = newref;
 
 	return EOK;
@@ -1193,6 +1258,8 @@ errno_t ext4_filesystem_get_inode_ref(ext4_filesystem_t *fs, uint32_t index,
  */
 errno_t ext4_filesystem_put_inode_ref(ext4_inode_ref_t *ref)
 {
+	ext4_journal_inode_put(ref);
+
 	/* Check if reference modified */
 	if (ref->dirty) {
 		/* Mark block dirty for writing changes to physical device */
@@ -1689,6 +1756,71 @@ errno_t ext4_filesystem_get_inode_data_block_index(ext4_inode_ref_t *inode_ref,
 	return EOK;
 }
 
+/** Get run of consecutive physical blocks for the block logical address.
+ *
+ * Finds the physical block of @a iblock and the number of following
+ * logical blocks (at most @a max_count) which are stored in consecutive
+ * physical blocks, or which are all unallocated (the physical block
+ * is then zero).
+ *
+ * @param inode_ref I-node to read block address from
+ * @param iblock    Logical index of the first block
+ * @param max_count Maximal number of blocks to examine (at least 1)
+ * @param fblock    Output pointer for the first physical block address
+ * @param count     Output pointer for the number of blocks in the run
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_filesystem_get_inode_data_block_run(ext4_inode_ref_t *inode_ref,
+    aoff64_t iblock, uint32_t max_count, uint32_t *fblock, uint32_t *count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+
+	assert(max_count > 0);
+
+	/* Handle i-node using extents */
+	if ((ext4_superblock_has_feature_incompatible(fs->superblock,
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
+	    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
+		errno_t rc = ext4_extent_find_block_run(inode_ref, iblock,
+		    fblock, count);
+		if (rc != EOK)
+			return rc;
+
+		*count = min(*count, max_count);
+		return EOK;
+	}
+
+	/* Extend the run block by block for indirect block mapping */
+	uint32_t first;
+	errno_t rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+	    iblock, &first);
+	if (rc != EOK)
+		return rc;
+
+	uint32_t cnt = 1;
+	while (cnt < max_count) {
+		uint32_t next;
+		rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+		    iblock + cnt, &next);
+		if (rc != EOK)
+			return rc;
+
+		if (first == 0) {
+			if (next != 0)
+				break;
+		} else if (next != first + cnt)
+			break;
+
+		cnt++;
+	}
+
+	*fblock = first;
+	*count = cnt;
+	return EOK;
+}
+
 /** Set physical block address for the block logical address into the i-node.
  *
  * @param inode_ref I-node to set block address to
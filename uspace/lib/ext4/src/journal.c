@@ -0,0 +1,1595 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libext4
+ * @{
+ */
+/**
+ * @file  journal.c
+ * @brief JBD2 compatible metadata journal.
+ *
+ * Metadata blocks modified by file system operations are pinned in the
+ * block cache (see block_cache_set_dirty_hook()) until the running
+ * transaction commits. The commit writes copies of all blocks of the
+ * transaction to the log in one sequential write, followed by the commit
+ * block, and only then the blocks are written to their home locations.
+ * File data are not journalled, they always reach the device before the
+ * transaction referring to them commits (ordered mode).
+ *
+ * The log uses the on-disk format of JBD2 so that a volume which was not
+ * unmounted cleanly can be recovered by e2fsck as well as by this driver.
+ */
+
+#include <assert.h>
+#include <byteorder.h>
+#include <errno.h>
+#include <fibril.h>
+#include <macros.h>
+#include <mem.h>
+#include <qsort.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ext4/filesystem.h"
+#include "ext4/inode.h"
+#include "ext4/journal.h"
+#include "ext4/superblock.h"
+
+/** Passes of the journal recovery */
+typedef enum {
+	EXT4_JOURNAL_PASS_SCAN,
+	EXT4_JOURNAL_PASS_REVOKE,
+	EXT4_JOURNAL_PASS_REPLAY
+} ext4_journal_pass_t;
+
+static size_t journal_block_key_hash(const void *key)
+{
+	const uint64_t *lba = key;
+	return *lba;
+}
+
+static size_t journal_block_hash(const ht_link_t *item)
+{
+	ext4_journal_block_t *jb =
+	    hash_table_get_inst(item, ext4_journal_block_t, link);
+	return jb->lba;
+}
+
+static bool journal_block_key_equal(const void *key, const ht_link_t *item)
+{
+	const uint64_t *lba = key;
+	ext4_journal_block_t *jb =
+	    hash_table_get_inst(item, ext4_journal_block_t, link);
+	return jb->lba == *lba;
+}
+
+static void journal_block_remove_callback(ht_link_t *item)
+{
+	ext4_journal_block_t *jb =
+	    hash_table_get_inst(item, ext4_journal_block_t, link);
+	free(jb);
+}
+
+/** Operations of sets of block numbers (logged and revoked blocks) */
+static hash_table_ops_t journal_block_ops = {
+	.hash = journal_block_hash,
+	.key_hash = journal_block_key_hash,
+	.key_equal = journal_block_key_equal,
+	.equal = NULL,
+	.remove_callback = journal_block_remove_callback
+};
+
+/** Operations of the running transaction (entries hold a block reference) */
+static hash_table_ops_t journal_trans_ops = {
+	.hash = journal_block_hash,
+	.key_hash = journal_block_key_hash,
+	.key_equal = journal_block_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+/** Translate journal block to the device block.
+ *
+ * @param journal Journal
+ * @param lblock  Block relative to the start of the journal
+ * @param pblock  Output device block address
+ * @param count   Output number of journal blocks stored consecutively
+ *                from @a lblock
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_bmap(ext4_journal_t *journal, uint32_t lblock,
+    uint64_t *pblock, uint32_t *count)
+{
+	size_t lo = 0;
+	size_t hi = journal->run_count;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		ext4_journal_run_t *run = &journal->runs[mid];
+
+		if (lblock < run->lblock) {
+			hi = mid;
+		} else if (lblock >= run->lblock + run->count) {
+			lo = mid + 1;
+		} else {
+			*pblock = run->pblock + (lblock - run->lblock);
+			*count = run->count - (lblock - run->lblock);
+			return EOK;
+		}
+	}
+
+	return EIO;
+}
+
+/** Read one journal block.
+ *
+ * @param journal Journal
+ * @param lblock  Block relative to the start of the journal
+ * @param buf     Buffer of the block size
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_read(ext4_journal_t *journal, uint32_t lblock,
+    void *buf)
+{
+	uint64_t pblock;
+	uint32_t count;
+
+	errno_t rc = ext4_journal_bmap(journal, lblock, &pblock, &count);
+	if (rc != EOK)
+		return rc;
+
+	return block_read_range(journal->fs->device, pblock, 1, buf);
+}
+
+/** Write consecutive journal blocks.
+ *
+ * Blocks stored consecutively on the device are written by a single
+ * request.
+ *
+ * @param journal Journal
+ * @param lblock  First block relative to the start of the journal
+ * @param cnt     Number of blocks
+ * @param buf     Data to be written
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_write(ext4_journal_t *journal, uint32_t lblock,
+    uint32_t cnt, const void *buf)
+{
+	const uint8_t *data = buf;
+
+	while (cnt > 0) {
+		uint64_t pblock;
+		uint32_t count;
+
+		errno_t rc = ext4_journal_bmap(journal, lblock, &pblock, &count);
+		if (rc != EOK)
+			return rc;
+
+		count = min(count, cnt);
+		rc = block_write_range(journal->fs->device, pblock, count, data);
+		if (rc != EOK)
+			return rc;
+
+		lblock += count;
+		cnt -= count;
+		data += count * journal->block_size;
+	}
+
+	return EOK;
+}
+
+/** Make sure all data written so far are on persistent storage.
+ *
+ * @param journal Journal
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_flush(ext4_journal_t *journal)
+{
+	errno_t rc = block_sync_cache(journal->fs->device, 0, 0);
+
+	/* Devices without a volatile write cache need not support flushing */
+	if (rc == ENOTSUP)
+		return EOK;
+
+	return rc;
+}
+
+/** Get the log block following @a lblock.
+ *
+ * @param journal Journal
+ * @param lblock  Block relative to the start of the journal
+ *
+ * @return Next block of the circular log
+ *
+ */
+static uint32_t ext4_journal_next(ext4_journal_t *journal, uint32_t lblock)
+{
+	lblock++;
+	if (lblock >= journal->max_len)
+		lblock = journal->first;
+
+	return lblock;
+}
+
+/** Fill in header of a journal block.
+ *
+ * @param header Header to fill in
+ * @param type   Block type
+ * @param tid    Transaction ID
+ *
+ */
+static void ext4_journal_header_init(ext4_journal_header_t *header,
+    uint32_t type, uint32_t tid)
+{
+	header->magic = host2uint32_t_be(EXT4_JOURNAL_MAGIC);
+	header->block_type = host2uint32_t_be(type);
+	header->sequence = host2uint32_t_be(tid);
+}
+
+/** Update start of the log in the journal superblock.
+ *
+ * @param journal Journal
+ * @param start   First block of the log or zero if the log is empty
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_update_sb(ext4_journal_t *journal, uint32_t start)
+{
+	ext4_journal_sb_t *jsb = malloc(journal->block_size);
+	if (jsb == NULL)
+		return ENOMEM;
+
+	errno_t rc = ext4_journal_read(journal, 0, jsb);
+	if (rc != EOK)
+		goto out;
+
+	jsb->sequence = host2uint32_t_be(journal->sequence);
+	jsb->start = host2uint32_t_be(start);
+	if (uint32_t_be2host(jsb->header.block_type) ==
+	    EXT4_JOURNAL_SUPERBLOCK_V2) {
+		jsb->features_incompatible =
+		    host2uint32_t_be(journal->features_incompatible);
+	}
+
+	rc = ext4_journal_write(journal, 0, 1, jsb);
+	if (rc != EOK)
+		goto out;
+
+	journal->start = start;
+out:
+	free(jsb);
+	return rc;
+}
+
+/** Remember revocation of a block found in the log.
+ *
+ * @param revoked Set of revoked blocks
+ * @param lba     Revoked block
+ * @param tid     Transaction which revoked the block
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_set_revoked(hash_table_t *revoked, uint64_t lba,
+    uint32_t tid)
+{
+	ht_link_t *link = hash_table_find(revoked, &lba);
+	if (link != NULL) {
+		ext4_journal_block_t *jb =
+		    hash_table_get_inst(link, ext4_journal_block_t, link);
+		if (tid > jb->tid)
+			jb->tid = tid;
+		return EOK;
+	}
+
+	ext4_journal_block_t *jb = malloc(sizeof(ext4_journal_block_t));
+	if (jb == NULL)
+		return ENOMEM;
+
+	jb->lba = lba;
+	jb->tid = tid;
+	jb->block = NULL;
+	hash_table_insert(revoked, &jb->link);
+	return EOK;
+}
+
+/** Process revoke block during recovery.
+ *
+ * @param journal Journal
+ * @param buf     Revoke block
+ * @param tid     Transaction ID of the block
+ * @param revoked Set of revoked blocks to be updated
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_scan_revoke(ext4_journal_t *journal,
+    uint8_t *buf, uint32_t tid, hash_table_t *revoked)
+{
+	ext4_journal_revoke_header_t *header =
+	    (ext4_journal_revoke_header_t *) buf;
+	size_t size = min(uint32_t_be2host(header->count), journal->block_size);
+	size_t rec_size = (journal->features_incompatible &
+	    EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT) ? 8 : 4;
+
+	for (size_t offset = sizeof(ext4_journal_revoke_header_t);
+	    offset + rec_size <= size; offset += rec_size) {
+		uint64_t lba;
+		if (rec_size == 8) {
+			uint64_t value;
+			memcpy(&value, buf + offset, sizeof(value));
+			lba = uint64_t_be2host(value);
+		} else {
+			uint32_t value;
+			memcpy(&value, buf + offset, sizeof(value));
+			lba = uint32_t_be2host(value);
+		}
+
+		errno_t rc = ext4_journal_set_revoked(revoked, lba, tid);
+		if (rc != EOK)
+			return rc;
+	}
+
+	return EOK;
+}
+
+/** Process descriptor block during recovery.
+ *
+ * @param journal Journal
+ * @param pass    Recovery pass
+ * @param buf     Descriptor block
+ * @param tid     Transaction ID of the block
+ * @param revoked Set of revoked blocks
+ * @param pos     Position of the descriptor, updated to the position of
+ *                the block following the logged data blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_scan_descriptor(ext4_journal_t *journal,
+    ext4_journal_pass_t pass, uint8_t *buf, uint32_t tid,
+    hash_table_t *revoked, uint32_t *pos)
+{
+	uint8_t *data = NULL;
+	uint32_t dpos = ext4_journal_next(journal, *pos);
+	size_t offset = sizeof(ext4_journal_header_t);
+	bool last = false;
+	errno_t rc = EOK;
+
+	if (pass == EXT4_JOURNAL_PASS_REPLAY) {
+		data = malloc(journal->block_size);
+		if (data == NULL)
+			return ENOMEM;
+	}
+
+	while (!last && offset + journal->tag_size <= journal->block_size) {
+		ext4_journal_block_tag_t *tag =
+		    (ext4_journal_block_tag_t *) (buf + offset);
+		uint16_t flags = uint16_t_be2host(tag->flags);
+
+		uint64_t lba = uint32_t_be2host(tag->block_lo);
+		if (journal->features_incompatible &
+		    EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT)
+			lba |= (uint64_t) uint32_t_be2host(tag->block_hi) << 32;
+
+		offset += journal->tag_size;
+		if ((flags & EXT4_JOURNAL_FLAG_SAME_UUID) == 0)
+			offset += sizeof(journal->uuid);
+		last = (flags & EXT4_JOURNAL_FLAG_LAST_TAG) != 0;
+
+		if (pass == EXT4_JOURNAL_PASS_REPLAY) {
+			/* Skip blocks revoked by this or a later transaction */
+			ht_link_t *link = hash_table_find(revoked, &lba);
+			ext4_journal_block_t *jb = (link != NULL) ?
+			    hash_table_get_inst(link, ext4_journal_block_t,
+			    link) : NULL;
+
+			if (jb == NULL || jb->tid < tid) {
+				rc = ext4_journal_read(journal, dpos, data);
+				if (rc != EOK)
+					break;
+
+				if (flags & EXT4_JOURNAL_FLAG_ESCAPE) {
+					uint32_t magic =
+					    host2uint32_t_be(EXT4_JOURNAL_MAGIC);
+					memcpy(data, &magic, sizeof(magic));
+				}
+
+				rc = block_write_range(journal->fs->device, lba,
+				    1, data);
+				if (rc != EOK)
+					break;
+			}
+		}
+
+		dpos = ext4_journal_next(journal, dpos);
+	}
+
+	free(data);
+	*pos = dpos;
+	return rc;
+}
+
+/** Run one pass of the journal recovery.
+ *
+ * The scan pass finds the end of the log (the first transaction which
+ * did not commit), the revoke pass collects revoked blocks and the replay
+ * pass writes logged blocks of committed transactions to their home
+ * locations.
+ *
+ * @param journal Journal
+ * @param pass    Recovery pass
+ * @param start   First block of the log
+ * @param tid     ID of the first transaction in the log
+ * @param end_tid ID of the first transaction which did not commit
+ *                (output of the scan pass, input of the other passes)
+ * @param revoked Set of revoked blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_recovery_pass(ext4_journal_t *journal,
+    ext4_journal_pass_t pass, uint32_t start, uint32_t tid,
+    uint32_t *end_tid, hash_table_t *revoked)
+{
+	uint8_t *buf = malloc(journal->block_size);
+	if (buf == NULL)
+		return ENOMEM;
+
+	uint32_t pos = start;
+	uint32_t scanned = 0;
+	errno_t rc = EOK;
+
+	while (scanned < journal->max_len) {
+		if (pass != EXT4_JOURNAL_PASS_SCAN && tid == *end_tid)
+			break;
+
+		rc = ext4_journal_read(journal, pos, buf);
+		if (rc != EOK)
+			break;
+
+		ext4_journal_header_t *header = (ext4_journal_header_t *) buf;
+		if (uint32_t_be2host(header->magic) != EXT4_JOURNAL_MAGIC ||
+		    uint32_t_be2host(header->sequence) != tid)
+			break;
+
+		uint32_t prev = pos;
+		uint32_t type = uint32_t_be2host(header->block_type);
+		if (type == EXT4_JOURNAL_DESCRIPTOR_BLOCK) {
+			rc = ext4_journal_scan_descriptor(journal, pass, buf,
+			    tid, revoked, &pos);
+		} else if (type == EXT4_JOURNAL_COMMIT_BLOCK) {
+			tid++;
+			pos = ext4_journal_next(journal, pos);
+		} else if (type == EXT4_JOURNAL_REVOKE_BLOCK) {
+			if (pass == EXT4_JOURNAL_PASS_REVOKE)
+				rc = ext4_journal_scan_revoke(journal, buf, tid,
+				    revoked);
+			pos = ext4_journal_next(journal, pos);
+		} else {
+			break;
+		}
+
+		if (rc != EOK)
+			break;
+
+		scanned += (pos > prev) ? pos - prev :
+		    pos - journal->first + journal->max_len - prev;
+	}
+
+	if (pass == EXT4_JOURNAL_PASS_SCAN)
+		*end_tid = tid;
+
+	free(buf);
+	return rc;
+}
+
+/** Replay committed transactions of the log.
+ *
+ * @param journal Journal
+ * @param start   First block of the log
+ * @param tid     ID of the first transaction in the log
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_recover(ext4_journal_t *journal, uint32_t start,
+    uint32_t tid)
+{
+	hash_table_t revoked;
+	uint32_t end_tid;
+
+	if (!hash_table_create(&revoked, 0, 0, &journal_block_ops))
+		return ENOMEM;
+
+	errno_t rc = ext4_journal_recovery_pass(journal,
+	    EXT4_JOURNAL_PASS_SCAN, start, tid, &end_tid, &revoked);
+	if (rc != EOK)
+		goto out;
+
+	rc = ext4_journal_recovery_pass(journal, EXT4_JOURNAL_PASS_REVOKE,
+	    start, tid, &end_tid, &revoked);
+	if (rc != EOK)
+		goto out;
+
+	rc = ext4_journal_recovery_pass(journal, EXT4_JOURNAL_PASS_REPLAY,
+	    start, tid, &end_tid, &revoked);
+	if (rc != EOK)
+		goto out;
+
+	rc = ext4_journal_flush(journal);
+	if (rc != EOK)
+		goto out;
+
+	/* Continue after the last transaction seen in the log */
+	journal->sequence = end_tid + 1;
+out:
+	hash_table_destroy(&revoked);
+	return rc;
+}
+
+/** Build map of the journal blocks.
+ *
+ * @param journal   Journal
+ * @param inode_ref Journal i-node
+ * @param blocks    Number of journal blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_map(ext4_journal_t *journal,
+    ext4_inode_ref_t *inode_ref, uint32_t blocks)
+{
+	size_t size = 8;
+	uint32_t lblock = 0;
+
+	journal->runs = malloc(size * sizeof(ext4_journal_run_t));
+	if (journal->runs == NULL)
+		return ENOMEM;
+
+	while (lblock < blocks) {
+		uint32_t fblock;
+		uint32_t count;
+
+		errno_t rc = ext4_filesystem_get_inode_data_block_run(inode_ref,
+		    lblock, blocks - lblock, &fblock, &count);
+		if (rc != EOK)
+			return rc;
+
+		/* The journal must not have holes */
+		if (fblock == 0)
+			return EIO;
+
+		if (journal->run_count == size) {
+			ext4_journal_run_t *runs = realloc(journal->runs,
+			    2 * size * sizeof(ext4_journal_run_t));
+			if (runs == NULL)
+				return ENOMEM;
+
+			journal->runs = runs;
+			size *= 2;
+		}
+
+		ext4_journal_run_t *run = &journal->runs[journal->run_count++];
+		run->lblock = lblock;
+		run->pblock = fblock;
+		run->count = count;
+
+		lblock += count;
+	}
+
+	return EOK;
+}
+
+/** Release memory used by the journal.
+ *
+ * @param journal Journal
+ *
+ */
+static void ext4_journal_free(ext4_journal_t *journal)
+{
+	hash_table_destroy(&journal->trans);
+	hash_table_destroy(&journal->logged);
+	hash_table_destroy(&journal->revoke);
+	free(journal->runs);
+	free(journal);
+}
+
+/** Load journal of the file system and recover it if needed.
+ *
+ * The journal is recovered by writing the logged blocks directly to
+ * the device, so the caller must discard the content of the block cache
+ * if @a replayed is set on return.
+ *
+ * If the volume has no journal which could be written by this driver,
+ * fs->journal is left NULL and the volume is used without journalling.
+ *
+ * @param fs       File system
+ * @param replayed Output flag whether any transactions were replayed
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_journal_load(ext4_filesystem_t *fs, bool *replayed)
+{
+	ext4_superblock_t *sb = fs->superblock;
+	ext4_journal_sb_t *jsb = NULL;
+	ext4_inode_ref_t *inode_ref;
+	errno_t rc;
+
+	*replayed = false;
+	fs->journal = NULL;
+
+	bool recover = ext4_superblock_has_feature_incompatible(sb,
+	    EXT4_FEATURE_INCOMPAT_RECOVER);
+
+	if (!ext4_superblock_has_feature_compatible(sb,
+	    EXT4_FEATURE_COMPAT_HAS_JOURNAL))
+		return recover ? ENOTSUP : EOK;
+
+	/* External journal devices are not supported */
+	uint32_t inum = ext4_superblock_get_journal_inode_number(sb);
+	if (inum == 0 || ext4_superblock_has_feature_incompatible(sb,
+	    EXT4_FEATURE_INCOMPAT_JOURNAL_DEV))
+		return recover ? ENOTSUP : EOK;
+
+	ext4_journal_t *journal = calloc(1, sizeof(ext4_journal_t));
+	if (journal == NULL)
+		return ENOMEM;
+
+	journal->fs = fs;
+	journal->block_size = ext4_superblock_get_block_size(sb);
+	fibril_mutex_initialize(&journal->lock);
+	fibril_condvar_initialize(&journal->cv);
+	fibril_condvar_initialize(&journal->thread_cv);
+	list_initialize(&journal->inodes);
+
+	if (!hash_table_create(&journal->trans, 0, 0, &journal_trans_ops)) {
+		free(journal);
+		return ENOMEM;
+	}
+
+	if (!hash_table_create(&journal->logged, 0, 0, &journal_block_ops)) {
+		hash_table_destroy(&journal->trans);
+		free(journal);
+		return ENOMEM;
+	}
+
+	if (!hash_table_create(&journal->revoke, 0, 0, &journal_block_ops)) {
+		hash_table_destroy(&journal->logged);
+		hash_table_destroy(&journal->trans);
+		free(journal);
+		return ENOMEM;
+	}
+
+	/* Map journal blocks to the device */
+	rc = ext4_filesystem_get_inode_ref(fs, inum, &inode_ref);
+	if (rc != EOK)
+		goto error;
+
+	uint64_t size = ext4_inode_get_size(sb, inode_ref->inode);
+	rc = ext4_journal_map(journal, inode_ref, size / journal->block_size);
+	ext4_filesystem_put_inode_ref(inode_ref);
+	if (rc != EOK)
+		goto error;
+
+	jsb = malloc(journal->block_size);
+	if (jsb == NULL) {
+		rc = ENOMEM;
+		goto error;
+	}
+
+	rc = ext4_journal_read(journal, 0, jsb);
+	if (rc != EOK)
+		goto error;
+
+	/* Check the journal superblock */
+	uint32_t type = uint32_t_be2host(jsb->header.block_type);
+	journal->max_len = uint32_t_be2host(jsb->max_len);
+	journal->first = uint32_t_be2host(jsb->first);
+
+	if (uint32_t_be2host(jsb->header.magic) != EXT4_JOURNAL_MAGIC ||
+	    (type != EXT4_JOURNAL_SUPERBLOCK_V1 &&
+	    type != EXT4_JOURNAL_SUPERBLOCK_V2) ||
+	    uint32_t_be2host(jsb->block_size) != journal->block_size ||
+	    journal->max_len > size / journal->block_size ||
+	    journal->first == 0 || journal->first >= journal->max_len) {
+		rc = EIO;
+		goto error;
+	}
+
+	/* Check whether the log is written in a format known to us */
+	bool supported = true;
+	if (type == EXT4_JOURNAL_SUPERBLOCK_V2) {
+		journal->features_incompatible =
+		    uint32_t_be2host(jsb->features_incompatible);
+		if ((uint32_t_be2host(jsb->features_compatible) &
+		    EXT4_JOURNAL_FEATURE_COMPAT_CHECKSUM) ||
+		    (journal->features_incompatible &
+		    ~EXT4_JOURNAL_FEATURE_INCOMPAT_SUPP))
+			supported = false;
+	}
+
+	journal->tag_size = (journal->features_incompatible &
+	    EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT) ? 12 : 8;
+	memcpy(journal->uuid, jsb->uuid, sizeof(journal->uuid));
+	journal->sequence = uint32_t_be2host(jsb->sequence);
+	journal->start = uint32_t_be2host(jsb->start);
+
+	/* Replay transactions left by an unclean unmount */
+	if (journal->start != 0) {
+		if (!supported) {
+			rc = ENOTSUP;
+			goto error;
+		}
+
+		rc = ext4_journal_recover(journal, journal->start,
+		    journal->sequence);
+		if (rc != EOK)
+			goto error;
+
+		rc = ext4_journal_update_sb(journal, 0);
+		if (rc != EOK)
+			goto error;
+
+		*replayed = true;
+	}
+
+	/* The volume is consistent now */
+	ext4_superblock_set_features_incompatible(sb,
+	    ext4_superblock_get_features_incompatible(sb) &
+	    ~EXT4_FEATURE_INCOMPAT_RECOVER);
+
+	/*
+	 * Do not write logs we could not replay ourselves. Revoke records
+	 * need a version 2 journal superblock and blocks above 2^32 need
+	 * 64-bit tags.
+	 */
+	if (!supported || type != EXT4_JOURNAL_SUPERBLOCK_V2 ||
+	    (ext4_superblock_get_blocks_count(sb) > UINT32_MAX &&
+	    (journal->features_incompatible &
+	    EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT) == 0)) {
+		free(jsb);
+		ext4_journal_free(journal);
+		return EOK;
+	}
+
+	journal->head = journal->first;
+	journal->trans_max = min(EXT4_JOURNAL_TRANS_MAX, journal->max_len / 4);
+
+	free(jsb);
+	fs->journal = journal;
+	return EOK;
+error:
+	free(jsb);
+	ext4_journal_free(journal);
+	return rc;
+}
+
+/** Pin block in the running transaction.
+ *
+ * @param journal Journal
+ * @param block   Modified block
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_pin(ext4_journal_t *journal, block_t *block)
+{
+	/*
+	 * The block was freed and reused within the running transaction.
+	 * Its revoke record would prevent the new content from being
+	 * replayed, so it has to be cancelled.
+	 */
+	ht_link_t *link = hash_table_find(&journal->revoke, &block->lba);
+	if (link != NULL) {
+		hash_table_remove_item(&journal->revoke, link);
+		journal->revoke_count--;
+	}
+
+	if (hash_table_find(&journal->trans, &block->lba) != NULL)
+		return EOK;
+
+	ext4_journal_block_t *jb = malloc(sizeof(ext4_journal_block_t));
+	if (jb == NULL)
+		return ENOMEM;
+
+	/* The extra reference prevents the cache from writing the block */
+	errno_t rc = block_get(&jb->block, journal->fs->device, block->lba,
+	    BLOCK_FLAGS_NOREAD);
+	if (rc != EOK) {
+		free(jb);
+		return rc;
+	}
+
+	jb->lba = block->lba;
+	jb->tid = journal->sequence;
+	hash_table_insert(&journal->trans, &jb->link);
+	journal->trans_count++;
+
+	if (journal->trans_count >= journal->trans_max &&
+	    !journal->commit_pending) {
+		journal->commit_pending = true;
+		fibril_condvar_signal(&journal->thread_cv);
+	}
+
+	return EOK;
+}
+
+/** Hook called by the block cache when a modified block is released.
+ *
+ * If the block cannot be pinned, the error is returned from block_put()
+ * so that the file system operation fails instead of silently losing
+ * the protection of the journal.
+ *
+ * @param arg   Journal
+ * @param block Modified block
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_dirty_hook(void *arg, block_t *block)
+{
+	ext4_journal_t *journal = arg;
+	errno_t rc = EOK;
+
+	fibril_mutex_lock(&journal->lock);
+	if (journal->active)
+		rc = ext4_journal_pin(journal, block);
+	fibril_mutex_unlock(&journal->lock);
+
+	return rc;
+}
+
+static bool ext4_journal_collect(ht_link_t *item, void *arg)
+{
+	ext4_journal_block_t ***next = arg;
+
+	**next = hash_table_get_inst(item, ext4_journal_block_t, link);
+	(*next)++;
+	return true;
+}
+
+static int ext4_journal_block_cmp(const void *a, const void *b)
+{
+	const ext4_journal_block_t *jba = *(ext4_journal_block_t * const *) a;
+	const ext4_journal_block_t *jbb = *(ext4_journal_block_t * const *) b;
+
+	if (jba->lba < jbb->lba)
+		return -1;
+	if (jba->lba > jbb->lba)
+		return 1;
+	return 0;
+}
+
+/** Write blocks of the running transaction to their home locations.
+ *
+ * Used when the transaction cannot be logged. The log is emptied first
+ * so that older transactions are not replayed over the blocks.
+ *
+ * @param journal Journal
+ * @param blocks  Blocks of the transaction
+ * @param count   Number of blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_write_through(ext4_journal_t *journal,
+    ext4_journal_block_t **blocks, size_t count)
+{
+	errno_t rc = ext4_journal_flush(journal);
+	if (rc != EOK)
+		return rc;
+
+	if (journal->start != 0) {
+		rc = ext4_journal_update_sb(journal, 0);
+		if (rc != EOK)
+			return rc;
+	}
+
+	hash_table_clear(&journal->logged);
+	journal->head = journal->first;
+
+	uint8_t *copy = malloc(journal->block_size);
+	if (copy == NULL)
+		return ENOMEM;
+
+	for (size_t i = 0; i < count; i++) {
+		memcpy(copy, blocks[i]->block->data, journal->block_size);
+		rc = block_write_range(journal->fs->device, blocks[i]->lba, 1,
+		    copy);
+		if (rc != EOK)
+			break;
+	}
+
+	free(copy);
+	return rc;
+}
+
+/** Write the running transaction to the log and checkpoint it.
+ *
+ * @param journal Journal
+ * @param blocks  Blocks of the transaction sorted by address
+ * @param count   Number of blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_write_trans(ext4_journal_t *journal,
+    ext4_journal_block_t **blocks, size_t count)
+{
+	uint32_t bsize = journal->block_size;
+	uint32_t tid = journal->sequence;
+	bool is_64bit = (journal->features_incompatible &
+	    EXT4_JOURNAL_FEATURE_INCOMPAT_64BIT) != 0;
+
+	/* Compute the size of the transaction in the log */
+	size_t tags_per_desc = (bsize - sizeof(ext4_journal_header_t) -
+	    sizeof(journal->uuid)) / journal->tag_size;
+	size_t rec_size = is_64bit ? 8 : 4;
+	size_t recs_per_revoke = (bsize -
+	    sizeof(ext4_journal_revoke_header_t)) / rec_size;
+
+	size_t desc_count = (count + tags_per_desc - 1) / tags_per_desc;
+	size_t revoke_count = (journal->revoke_count + recs_per_revoke - 1) /
+	    recs_per_revoke;
+	size_t log_count = desc_count + count + revoke_count;
+
+	/* One more block is needed for the commit block */
+	if (log_count + 1 > journal->max_len - journal->first)
+		return ext4_journal_write_through(journal, blocks, count);
+
+	uint8_t *log = malloc((log_count + 1) * bsize);
+	uint8_t **copies = malloc(count * sizeof(uint8_t *));
+	ext4_journal_block_t **revoked = malloc(max(journal->revoke_count, 1) *
+	    sizeof(ext4_journal_block_t *));
+	if (log == NULL || copies == NULL || revoked == NULL) {
+		free(log);
+		free(copies);
+		free(revoked);
+		return ext4_journal_write_through(journal, blocks, count);
+	}
+
+	ext4_journal_block_t **rnext = revoked;
+	hash_table_apply(&journal->revoke, ext4_journal_collect, &rnext);
+
+	errno_t rc;
+
+	/*
+	 * Start the log over if the transaction does not fit before its end.
+	 * All earlier transactions are checkpointed at this point.
+	 */
+	if (journal->head + log_count + 1 > journal->max_len ||
+	    journal->start == 0) {
+		if (journal->head + log_count + 1 > journal->max_len)
+			journal->head = journal->first;
+
+		rc = ext4_journal_flush(journal);
+		if (rc != EOK)
+			goto out;
+
+		rc = ext4_journal_update_sb(journal, journal->head);
+		if (rc != EOK)
+			goto out;
+
+		hash_table_clear(&journal->logged);
+	}
+
+	/* Descriptor blocks followed by copies of the logged blocks */
+	uint8_t *next = log;
+	for (size_t i = 0; i < count; i += tags_per_desc) {
+		uint8_t *desc = next;
+		size_t cnt = min(tags_per_desc, count - i);
+		size_t offset = sizeof(ext4_journal_header_t);
+
+		memset(desc, 0, bsize);
+		ext4_journal_header_init((ext4_journal_header_t *) desc,
+		    EXT4_JOURNAL_DESCRIPTOR_BLOCK, tid);
+		next += bsize;
+
+		for (size_t k = 0; k < cnt; k++) {
+			ext4_journal_block_t *jb = blocks[i + k];
+			ext4_journal_block_tag_t *tag =
+			    (ext4_journal_block_tag_t *) (desc + offset);
+			uint16_t flags = 0;
+			uint32_t magic;
+
+			memcpy(next, jb->block->data, bsize);
+			copies[i + k] = next;
+
+			/* Logged data must not look like a journal block */
+			memcpy(&magic, next, sizeof(magic));
+			if (uint32_t_be2host(magic) == EXT4_JOURNAL_MAGIC) {
+				flags |= EXT4_JOURNAL_FLAG_ESCAPE;
+				memset(next, 0, sizeof(magic));
+			}
+
+			if (k > 0)
+				flags |= EXT4_JOURNAL_FLAG_SAME_UUID;
+			if (k == cnt - 1)
+				flags |= EXT4_JOURNAL_FLAG_LAST_TAG;
+
+			tag->block_lo = host2uint32_t_be(jb->lba & UINT32_MAX);
+			tag->flags = host2uint16_t_be(flags);
+			if (is_64bit)
+				tag->block_hi = host2uint32_t_be(jb->lba >> 32);
+
+			offset += journal->tag_size;
+			if (k == 0) {
+				memcpy(desc + offset, journal->uuid,
+				    sizeof(journal->uuid));
+				offset += sizeof(journal->uuid);
+			}
+
+			next += bsize;
+		}
+	}
+
+	/* Revoke records */
+	for (size_t i = 0; i < journal->revoke_count; i += recs_per_revoke) {
+		ext4_journal_revoke_header_t *header =
+		    (ext4_journal_revoke_header_t *) next;
+		size_t cnt = min(recs_per_revoke, journal->revoke_count - i);
+		size_t offset = sizeof(ext4_journal_revoke_header_t);
+
+		memset(next, 0, bsize);
+		ext4_journal_header_init(&header->header,
+		    EXT4_JOURNAL_REVOKE_BLOCK, tid);
+
+		for (size_t k = 0; k < cnt; k++) {
+			if (is_64bit) {
+				uint64_t value =
+				    host2uint64_t_be(revoked[i + k]->lba);
+				memcpy(next + offset, &value, sizeof(value));
+			} else {
+				uint32_t value =
+				    host2uint32_t_be(revoked[i + k]->lba);
+				memcpy(next + offset, &value, sizeof(value));
+			}
+
+			offset += rec_size;
+		}
+
+		header->count = host2uint32_t_be(offset);
+		next += bsize;
+	}
+
+	/* Commit block */
+	ext4_journal_commit_header_t *commit =
+	    (ext4_journal_commit_header_t *) next;
+	struct timespec now;
+
+	getrealtime(&now);
+	memset(next, 0, bsize);
+	ext4_journal_header_init(&commit->header, EXT4_JOURNAL_COMMIT_BLOCK,
+	    tid);
+	commit->commit_sec = host2uint64_t_be(now.tv_sec);
+	commit->commit_nsec = host2uint32_t_be(now.tv_nsec);
+
+	/*
+	 * The log is written in one sequential request. The commit block
+	 * is written only after the rest of the transaction is stable.
+	 */
+	rc = ext4_journal_write(journal, journal->head, log_count, log);
+	if (rc != EOK)
+		goto out;
+
+	rc = ext4_journal_flush(journal);
+	if (rc != EOK)
+		goto out;
+
+	rc = ext4_journal_write(journal, journal->head + log_count, 1, next);
+	if (rc != EOK)
+		goto out;
+
+	rc = ext4_journal_flush(journal);
+	if (rc != EOK)
+		goto out;
+
+	/* The transaction is committed */
+	journal->head += log_count + 1;
+	journal->sequence++;
+
+	/* Checkpoint: write the blocks home in runs of consecutive blocks */
+	size_t i = 0;
+	while (i < count) {
+		size_t j = i + 1;
+
+		memcpy(copies[i], blocks[i]->block->data, sizeof(uint32_t));
+		while (j < count && blocks[j]->lba == blocks[j - 1]->lba + 1 &&
+		    copies[j] == copies[j - 1] + bsize) {
+			memcpy(copies[j], blocks[j]->block->data,
+			    sizeof(uint32_t));
+			j++;
+		}
+
+		rc = block_write_range(journal->fs->device, blocks[i]->lba,
+		    j - i, copies[i]);
+		if (rc != EOK)
+			goto out;
+
+		i = j;
+	}
+out:
+	free(revoked);
+	free(copies);
+	free(log);
+	return rc;
+}
+
+/** Commit the running transaction.
+ *
+ * Must be called with the journal lock held and outside of a handle.
+ *
+ * @param journal Journal
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_journal_commit_locked(ext4_journal_t *journal)
+{
+	errno_t rc = EOK;
+
+	while (journal->committing)
+		fibril_condvar_wait(&journal->cv, &journal->lock);
+
+	/* Wait for operations in progress to finish */
+	journal->committing = true;
+	while (journal->handles > 0)
+		fibril_condvar_wait(&journal->cv, &journal->lock);
+
+	journal->commit_pending = false;
+
+	/* Add i-nodes modified in place by references being held */
+	list_foreach(journal->inodes, link, ext4_inode_ref_t, ref) {
+		if (!ref->dirty)
+			continue;
+
+		ref->block->dirty = true;
+		if (ext4_journal_pin(journal, ref->block) == EOK)
+			ref->dirty = false;
+	}
+
+	size_t count = journal->trans_count;
+	if (count == 0 && journal->revoke_count == 0)
+		goto out;
+
+	ext4_journal_block_t **blocks =
+	    malloc(max(count, 1) * sizeof(ext4_journal_block_t *));
+	if (blocks == NULL) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	ext4_journal_block_t **next = blocks;
+	hash_table_apply(&journal->trans, ext4_journal_collect, &next);
+	qsort(blocks, count, sizeof(ext4_journal_block_t *),
+	    ext4_journal_block_cmp);
+
+	uint32_t tid = journal->sequence;
+	rc = ext4_journal_write_trans(journal, blocks, count);
+
+	/*
+	 * Release the pinned blocks. Blocks that were not written home
+	 * are still dirty and rejoin the new transaction.
+	 */
+	hash_table_clear(&journal->trans);
+	journal->trans_count = 0;
+	if (rc == EOK || journal->sequence != tid) {
+		hash_table_clear(&journal->revoke);
+		journal->revoke_count = 0;
+	}
+
+	fibril_mutex_unlock(&journal->lock);
+	for (size_t i = 0; i < count; i++)
+		block_put(blocks[i]->block);
+	fibril_mutex_lock(&journal->lock);
+
+	/* Remember blocks in the live part of the log for revoking */
+	for (size_t i = 0; i < count; i++) {
+		if (journal->sequence != tid && journal->start != 0 &&
+		    hash_table_find(&journal->logged, &blocks[i]->lba) == NULL) {
+			blocks[i]->block = NULL;
+			hash_table_insert(&journal->logged, &blocks[i]->link);
+		} else {
+			free(blocks[i]);
+		}
+	}
+
+	free(blocks);
+out:
+	journal->committing = false;
+	fibril_condvar_broadcast(&journal->cv);
+	return rc;
+}
+
+/** Fibril committing the running transaction periodically.
+ *
+ * @param arg Journal
+ *
+ * @return EOK
+ *
+ */
+static errno_t ext4_journal_thread(void *arg)
+{
+	ext4_journal_t *journal = arg;
+
+	fibril_mutex_lock(&journal->lock);
+
+	while (!journal->stop) {
+		errno_t rc = fibril_condvar_wait_timeout(&journal->thread_cv,
+		    &journal->lock, EXT4_JOURNAL_COMMIT_INTERVAL);
+		if (journal->stop)
+			break;
+
+		if (rc != ETIMEOUT && !journal->commit_pending)
+			continue;
+
+		/* The last handle to end commits the transaction */
+		if (journal->handles > 0) {
+			journal->commit_pending = true;
+			continue;
+		}
+
+		(void) ext4_journal_commit_locked(journal);
+	}
+
+	journal->thread_running = false;
+	fibril_condvar_broadcast(&journal->cv);
+	fibril_mutex_unlock(&journal->lock);
+	return EOK;
+}
+
+/** Stop the commit fibril and stop recording transactions.
+ *
+ * Must be called with the journal lock held.
+ *
+ * @param journal Journal
+ *
+ */
+static void ext4_journal_stop_locked(ext4_journal_t *journal)
+{
+	journal->stop = true;
+	fibril_condvar_signal(&journal->thread_cv);
+	while (journal->thread_running)
+		fibril_condvar_wait(&journal->cv, &journal->lock);
+
+	journal->active = false;
+}
+
+/** Start recording transactions.
+ *
+ * From now on the volume needs recovery unless it is unmounted
+ * cleanly by ext4_journal_shutdown().
+ *
+ * @param fs File system
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_journal_activate(ext4_filesystem_t *fs)
+{
+	ext4_journal_t *journal = fs->journal;
+	if (journal == NULL)
+		return EOK;
+
+	/* Revoke records may be written */
+	journal->features_incompatible |= EXT4_JOURNAL_FEATURE_INCOMPAT_REVOKE;
+
+	fid_t fid = fibril_create(ext4_journal_thread, journal);
+	if (fid == 0)
+		return ENOMEM;
+
+	errno_t rc = block_cache_set_dirty_hook(fs->device,
+	    ext4_journal_dirty_hook, journal);
+	if (rc != EOK) {
+		fibril_destroy(fid);
+		return rc;
+	}
+
+	journal->active = true;
+	journal->stop = false;
+	journal->thread_running = true;
+	fibril_add_ready(fid);
+
+	ext4_superblock_set_features_incompatible(fs->superblock,
+	    ext4_superblock_get_features_incompatible(fs->superblock) |
+	    EXT4_FEATURE_INCOMPAT_RECOVER);
+
+	return EOK;
+}
+
+/** Commit all changes and mark the journal empty.
+ *
+ * @param fs File system
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_journal_shutdown(ext4_filesystem_t *fs)
+{
+	ext4_journal_t *journal = fs->journal;
+	if (journal == NULL || !journal->active)
+		return EOK;
+
+	fibril_mutex_lock(&journal->lock);
+
+	errno_t rc = ext4_journal_commit_locked(journal);
+	if (rc != EOK) {
+		fibril_mutex_unlock(&journal->lock);
+		return rc;
+	}
+
+	rc = ext4_journal_flush(journal);
+	if (rc != EOK) {
+		fibril_mutex_unlock(&journal->lock);
+		return rc;
+	}
+
+	rc = ext4_journal_update_sb(journal, 0);
+	if (rc != EOK) {
+		fibril_mutex_unlock(&journal->lock);
+		return rc;
+	}
+
+	ext4_journal_stop_locked(journal);
+	fibril_mutex_unlock(&journal->lock);
+
+	(void) block_cache_set_dirty_hook(fs->device, NULL, NULL);
+
+	ext4_superblock_set_features_incompatible(fs->superblock,
+	    ext4_superblock_get_features_incompatible(fs->superblock) &
+	    ~EXT4_FEATURE_INCOMPAT_RECOVER);
+
+	return EOK;
+}
+
+/** Release the journal.
+ *
+ * Blocks still held by the running transaction are handed back to the
+ * block cache. To leave the journal consistent, ext4_journal_shutdown()
+ * must be called before.
+ *
+ * @param fs File system
+ *
+ */
+void ext4_journal_fini(ext4_filesystem_t *fs)
+{
+	ext4_journal_t *journal = fs->journal;
+	if (journal == NULL)
+		return;
+
+	fibril_mutex_lock(&journal->lock);
+	if (journal->thread_running)
+		ext4_journal_stop_locked(journal);
+	journal->active = false;
+	fibril_mutex_unlock(&journal->lock);
+
+	(void) block_cache_set_dirty_hook(fs->device, NULL, NULL);
+
+	size_t count = journal->trans_count;
+	ext4_journal_block_t **blocks =
+	    malloc(max(count, 1) * sizeof(ext4_journal_block_t *));
+	if (blocks != NULL) {
+		ext4_journal_block_t **next = blocks;
+		hash_table_apply(&journal->trans, ext4_journal_collect, &next);
+		hash_table_clear(&journal->trans);
+
+		for (size_t i = 0; i < count; i++) {
+			block_put(blocks[i]->block);
+			free(blocks[i]);
+		}
+
+		free(blocks);
+	}
+
+	ext4_journal_free(journal);
+	fs->journal = NULL;
+}
+
+/** Check whether changes of the file system are being journalled.
+ *
+ * @param fs File system
+ *
+ * @return True if the journal is active
+ *
+ */
+bool ext4_journal_is_active(ext4_filesystem_t *fs)
+{
+	return fs->journal != NULL && fs->journal->active;
+}
+
+/** Begin an operation which has to be committed atomically.
+ *
+ * Handles must not be nested.
+ *
+ * @param fs File system
+ *
+ */
+void ext4_journal_begin(ext4_filesystem_t *fs)
+{
+	ext4_journal_t *journal = fs->journal;
+	if (journal == NULL)
+		return;
+
+	fibril_mutex_lock(&journal->lock);
+	while (journal->committing)
+		fibril_condvar_wait(&journal->cv, &journal->lock);
+	journal->handles++;
+	fibril_mutex_unlock(&journal->lock);
+}
+
+/** End an operation started by ext4_journal_begin().
+ *
+ * If the running transaction is due to be committed, the last operation
+ * to end commits it.
+ *
+ * @param fs File system
+ *
+ * @return Error code of the commit
+ *
+ */
+errno_t ext4_journal_end(ext4_filesystem_t *fs)
+{
+	ext4_journal_t *journal = fs->journal;
+	errno_t rc = EOK;
+
+	if (journal == NULL)
+		return EOK;
+
+	fibril_mutex_lock(&journal->lock);
+	assert(journal->handles > 0);
+	journal->handles--;
+
+	if (journal->handles == 0) {
+		fibril_condvar_broadcast(&journal->cv);
+		if (journal->commit_pending && journal->active)
+			rc = ext4_journal_commit_locked(journal);
+	}
+
+	fibril_mutex_unlock(&journal->lock);
+	return rc;
+}
+
+/** Commit the running transaction.
+ *
+ * Must not be called inside a handle.
+ *
+ * @param fs File system
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_journal_commit(ext4_filesystem_t *fs)
+{
+	ext4_journal_t *journal = fs->journal;
+	errno_t rc = EOK;
+
+	if (journal == NULL)
+		return EOK;
+
+	fibril_mutex_lock(&journal->lock);
+	if (journal->active)
+		rc = ext4_journal_commit_locked(journal);
+	fibril_mutex_unlock(&journal->lock);
+
+	return rc;
+}
+
+/** Record that a block was freed.
+ *
+ * If the block is present in the log, a revoke record prevents the logged
+ * copy from being replayed over new content of the block.
+ *
+ * @param fs  File system
+ * @param lba Freed block
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_journal_revoke(ext4_filesystem_t *fs, uint64_t lba)
+{
+	ext4_journal_t *journal = fs->journal;
+	errno_t rc = EOK;
+
+	if (journal == NULL)
+		return EOK;
+
+	fibril_mutex_lock(&journal->lock);
+
+	if (!journal->active ||
+	    hash_table_find(&journal->revoke, &lba) != NULL ||
+	    (hash_table_find(&journal->logged, &lba) == NULL &&
+	    hash_table_find(&journal->trans, &lba) == NULL))
+		goto out;
+
+	ext4_journal_block_t *jb = malloc(sizeof(ext4_journal_block_t));
+	if (jb == NULL) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	jb->lba = lba;
+	jb->tid = journal->sequence;
+	jb->block = NULL;
+	hash_table_insert(&journal->revoke, &jb->link);
+	journal->revoke_count++;
+out:
+	fibril_mutex_unlock(&journal->lock);
+	return rc;
+}
+
+/** Start tracking an i-node reference.
+ *
+ * I-nodes are modified in place while the reference is held, so the
+ * commit has to include i-nodes of all references being held.
+ *
+ * @param ref I-node reference
+ *
+ */
+void ext4_journal_inode_get(ext4_inode_ref_t *ref)
+{
+	ext4_journal_t *journal = ref->fs->journal;
+
+	link_initialize(&ref->link);
+	if (journal == NULL)
+		return;
+
+	fibril_mutex_lock(&journal->lock);
+	list_append(&ref->link, &journal->inodes);
+	fibril_mutex_unlock(&journal->lock);
+}
+
+/** Stop tracking an i-node reference.
+ *
+ * @param ref I-node reference
+ *
+ */
+void ext4_journal_inode_put(ext4_inode_ref_t *ref)
+{
+	ext4_journal_t *journal = ref->fs->journal;
+	if (journal == NULL)
+		return;
+
+	fibril_mutex_lock(&journal->lock);
+	if (link_in_use(&ref->link))
+		list_remove(&ref->link);
+	fibril_mutex_unlock(&journal->lock);
+}
+
+/**
+ * @}
+ */
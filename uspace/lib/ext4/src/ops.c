@@ -37,6 +37,7 @@
 
 #include <adt/hash_table.h>
 #include <adt/hash.h>
+#include <align.h>
 #include <errno.h>
 #include <fibril_synch.h>
 #include <libfs.h>
@@ -50,6 +51,7 @@
 #include "ext4/directory_index.h"
 #include "ext4/extent.h"
 #include "ext4/inode.h"
+#include "ext4/journal.h"
 #include "ext4/ops.h"
 #include "ext4/filesystem.h"
 #include "ext4/fstypes.h"
@@ -61,6 +63,8 @@ static errno_t ext4_read_directory(ipc_call_t *, aoff64_t, size_t,
     ext4_instance_t *, ext4_inode_ref_t *, size_t *);
 static errno_t ext4_read_file(ipc_call_t *, aoff64_t, size_t, ext4_instance_t *,
     ext4_inode_ref_t *, size_t *);
+static errno_t ext4_readdir(service_id_t, fs_index_t, aoff64_t,
+    fs_readdir_t *);
 static bool ext4_is_dots(const uint8_t *, size_t);
 static errno_t ext4_instance_get(service_id_t, ext4_instance_t **);
 
@@ -129,6 +133,377 @@ static hash_table_ops_t open_nodes_ops = {
 	.remove_callback = NULL,
 };
 
+/*
+ * Delayed allocation
+ *
+ * Data appended to a file are kept in memory and the blocks for them
+ * are allocated only when the data are flushed. The whole buffer then
+ * gets a few long extents instead of one block allocated per write
+ * request. The data are flushed when the file is read, truncated,
+ * synced or closed, when a write does not continue the buffered data,
+ * and on unmount.
+ */
+
+/** Maximum amount of data buffered for one file */
+#define EXT4_DELALLOC_MAX  (1024 * 1024)
+
+/** Maximum amount of data buffered for all files of the instance */
+#define EXT4_DELALLOC_LIMIT  (8 * 1024 * 1024)
+
+/** Find delayed allocation buffer of i-node.
+ *
+ * Delayed allocation lock of the instance must be held.
+ *
+ * @param inst  Instance
+ * @param index I-node number
+ *
+ * @return Buffer or NULL if there is none
+ *
+ */
+static ext4_delalloc_t *ext4_delalloc_find(ext4_instance_t *inst,
+    fs_index_t index)
+{
+	list_foreach(inst->delalloc, link, ext4_delalloc_t, da) {
+		if (da->index == index)
+			return da;
+	}
+
+	return NULL;
+}
+
+/** Destroy delayed allocation buffer.
+ *
+ * @param inst Instance
+ * @param da   Buffer to destroy
+ *
+ */
+static void ext4_delalloc_destroy(ext4_instance_t *inst, ext4_delalloc_t *da)
+{
+	list_remove(&da->link);
+	inst->delalloc_size -= da->capacity;
+	free(da->data);
+	free(da);
+}
+
+/** Allocate blocks for buffered data and write them.
+ *
+ * The i-node size is extended to cover the written data.
+ *
+ * @param inst       Instance
+ * @param inode_ref  I-node the data belong to
+ * @param da         Delayed allocation buffer
+ * @param whole_only Write only whole blocks and keep the rest buffered
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_delalloc_write_out(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref, ext4_delalloc_t *da, bool whole_only)
+{
+	ext4_superblock_t *sb = inst->filesystem->superblock;
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	errno_t rc = EOK;
+
+	size_t blocks;
+	if (whole_only) {
+		blocks = da->size / block_size;
+	} else {
+		/* Pad the last block with zeros */
+		blocks = ROUND_UP(da->size, block_size) / block_size;
+		if (blocks * block_size > da->size) {
+			memset(da->data + da->size, 0,
+			    blocks * block_size - da->size);
+		}
+	}
+
+	size_t done = 0;
+	while (done < blocks) {
+		uint32_t fblock;
+		uint32_t count;
+		rc = ext4_extent_append_blocks(inode_ref, da->iblock + done,
+		    blocks - done, &fblock, &count);
+		if (rc != EOK)
+			break;
+
+		rc = block_write_range(inst->service_id, fblock, count,
+		    da->data + done * block_size);
+		if (rc != EOK)
+			break;
+
+		done += count;
+	}
+
+	/* Extend the file over the written data */
+	uint64_t end = (uint64_t) da->iblock * block_size +
+	    min(done * block_size, da->size);
+	if (end > ext4_inode_get_size(sb, inode_ref->inode)) {
+		ext4_inode_set_size(inode_ref->inode, end);
+		inode_ref->dirty = true;
+	}
+
+	if (rc != EOK)
+		return rc;
+
+	/* Move the partial block to the beginning of the buffer */
+	size_t bytes = min(done * block_size, da->size);
+	memmove(da->data, da->data + bytes, da->size - bytes);
+	da->iblock += done;
+	da->size -= bytes;
+
+	return EOK;
+}
+
+/** Flush delayed allocation buffer of i-node.
+ *
+ * @param inst      Instance
+ * @param inode_ref I-node to flush
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_delalloc_flush(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref)
+{
+	errno_t rc = EOK;
+
+	fibril_mutex_lock(&inst->delalloc_lock);
+
+	ext4_delalloc_t *da = ext4_delalloc_find(inst, inode_ref->index);
+	if (da != NULL) {
+		rc = ext4_delalloc_write_out(inst, inode_ref, da, false);
+		ext4_delalloc_destroy(inst, da);
+	}
+
+	fibril_mutex_unlock(&inst->delalloc_lock);
+	return rc;
+}
+
+/** Flush delayed allocation buffers of all i-nodes.
+ *
+ * @param inst Instance
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_delalloc_flush_all(ext4_instance_t *inst)
+{
+	errno_t rc = EOK;
+
+	fibril_mutex_lock(&inst->delalloc_lock);
+
+	list_foreach_safe(inst->delalloc, cur, next) {
+		ext4_delalloc_t *da = list_get_instance(cur, ext4_delalloc_t,
+		    link);
+
+		ext4_inode_ref_t *inode_ref;
+		errno_t rc2 = ext4_filesystem_get_inode_ref(inst->filesystem,
+		    da->index, &inode_ref);
+		if (rc2 == EOK) {
+			rc2 = ext4_delalloc_write_out(inst, inode_ref, da, false);
+			errno_t rc3 = ext4_filesystem_put_inode_ref(inode_ref);
+			if (rc2 == EOK)
+				rc2 = rc3;
+		}
+
+		if (rc == EOK)
+			rc = rc2;
+
+		ext4_delalloc_destroy(inst, da);
+	}
+
+	fibril_mutex_unlock(&inst->delalloc_lock);
+	return rc;
+}
+
+/** Drop delayed allocation buffer of i-node.
+ *
+ * Used when the i-node is destroyed.
+ *
+ * @param inst  Instance
+ * @param index I-node number
+ *
+ */
+static void ext4_delalloc_discard(ext4_instance_t *inst, fs_index_t index)
+{
+	fibril_mutex_lock(&inst->delalloc_lock);
+
+	ext4_delalloc_t *da = ext4_delalloc_find(inst, index);
+	if (da != NULL)
+		ext4_delalloc_destroy(inst, da);
+
+	fibril_mutex_unlock(&inst->delalloc_lock);
+}
+
+/** Get size of file including data buffered for delayed allocation.
+ *
+ * @param inst      Instance
+ * @param inode_ref I-node
+ *
+ * @return File size
+ *
+ */
+static aoff64_t ext4_delalloc_size(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref)
+{
+	ext4_superblock_t *sb = inst->filesystem->superblock;
+	aoff64_t size = ext4_inode_get_size(sb, inode_ref->inode);
+
+	fibril_mutex_lock(&inst->delalloc_lock);
+
+	ext4_delalloc_t *da = ext4_delalloc_find(inst, inode_ref->index);
+	if (da != NULL) {
+		size = max(size, (aoff64_t) da->iblock *
+		    ext4_superblock_get_block_size(sb) + da->size);
+	}
+
+	fibril_mutex_unlock(&inst->delalloc_lock);
+	return size;
+}
+
+/** Check if write can start delayed allocation buffer.
+ *
+ * Only appending to an extent-mapped regular file at block boundary
+ * is buffered.
+ *
+ * @param inst      Instance
+ * @param inode_ref I-node to write to
+ * @param pos       Position of the write
+ * @param len       Length of the write
+ *
+ * @return True if the write can be buffered
+ *
+ */
+static bool ext4_delalloc_can_start(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref, aoff64_t pos, size_t len)
+{
+	ext4_superblock_t *sb = inst->filesystem->superblock;
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+
+	if (!ext4_inode_is_type(sb, inode_ref->inode, EXT4_INODE_MODE_FILE))
+		return false;
+
+	if ((!ext4_superblock_has_feature_incompatible(sb,
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)) ||
+	    (!ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS)))
+		return false;
+
+	if ((pos != ext4_inode_get_size(sb, inode_ref->inode)) ||
+	    (pos % block_size != 0) || (len > EXT4_DELALLOC_MAX))
+		return false;
+
+	if (inst->delalloc_size + ROUND_UP(len, block_size) >
+	    EXT4_DELALLOC_LIMIT)
+		return false;
+
+	/* Blocks might have been allocated past the end of file */
+	uint32_t fblock;
+	errno_t rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+	    pos / block_size, &fblock);
+	return (rc == EOK) && (fblock == 0);
+}
+
+/** Buffer data written to a file for delayed allocation.
+ *
+ * @param inst      Instance
+ * @param inode_ref I-node to write to
+ * @param pos       Position of the write
+ * @param data      Data to write
+ * @param len       Length of the data
+ * @param nsize     Output value - new size of the file
+ *
+ * @return EOK if the data were buffered, ENOENT if they have to be
+ *         written directly, other error code on failure of flushing
+ *         previously buffered data
+ *
+ */
+static errno_t ext4_delalloc_write(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref, aoff64_t pos, const uint8_t *data,
+    size_t len, aoff64_t *nsize)
+{
+	ext4_superblock_t *sb = inst->filesystem->superblock;
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	errno_t rc = EOK;
+
+	fibril_mutex_lock(&inst->delalloc_lock);
+
+	ext4_delalloc_t *da = ext4_delalloc_find(inst, inode_ref->index);
+	if (da != NULL) {
+		aoff64_t end = (aoff64_t) da->iblock * block_size + da->size;
+
+		if ((pos == end) && (da->size + len > EXT4_DELALLOC_MAX)) {
+			/* Buffer is full, write out all whole blocks */
+			rc = ext4_delalloc_write_out(inst, inode_ref, da, true);
+			if (rc != EOK) {
+				ext4_delalloc_destroy(inst, da);
+				goto out;
+			}
+		}
+
+		if ((pos != end) || (da->size + len > EXT4_DELALLOC_MAX)) {
+			/* Not a continuation of the buffered data */
+			rc = ext4_delalloc_write_out(inst, inode_ref, da, false);
+			ext4_delalloc_destroy(inst, da);
+			if (rc != EOK)
+				goto out;
+
+			da = NULL;
+		}
+	}
+
+	if (da == NULL) {
+		if (!ext4_delalloc_can_start(inst, inode_ref, pos, len)) {
+			rc = ENOENT;
+			goto out;
+		}
+
+		da = calloc(1, sizeof(ext4_delalloc_t));
+		if (da == NULL) {
+			rc = ENOENT;
+			goto out;
+		}
+
+		link_initialize(&da->link);
+		da->index = inode_ref->index;
+		da->iblock = pos / block_size;
+		list_append(&da->link, &inst->delalloc);
+	}
+
+	size_t needed = ROUND_UP(da->size + len, block_size);
+	if (needed > da->capacity) {
+		/* Grow the buffer geometrically up to the limit */
+		size_t capacity = max(needed, 2 * da->capacity);
+		capacity = min(capacity, ROUND_UP(EXT4_DELALLOC_MAX, block_size));
+
+		uint8_t *buf = NULL;
+		if (inst->delalloc_size - da->capacity + capacity <=
+		    EXT4_DELALLOC_LIMIT)
+			buf = realloc(da->data, capacity);
+
+		if (buf == NULL) {
+			/* Out of budget, write directly */
+			rc = ext4_delalloc_write_out(inst, inode_ref, da, false);
+			ext4_delalloc_destroy(inst, da);
+			if (rc == EOK)
+				rc = ENOENT;
+			goto out;
+		}
+
+		inst->delalloc_size += capacity - da->capacity;
+		da->data = buf;
+		da->capacity = capacity;
+	}
+
+	memcpy(da->data + da->size, data, len);
+	da->size += len;
+
+	*nsize = max(ext4_inode_get_size(sb, inode_ref->inode),
+	    (aoff64_t) da->iblock * block_size + da->size);
+
+out:
+	fibril_mutex_unlock(&inst->delalloc_lock);
+	return rc;
+}
+
 /** Basic initialization of the driver.
  *
  * This is only needed to create the hash table
@@ -450,7 +825,13 @@ errno_t ext4_create_node(fs_node_t **rfn, service_id_t service_id, int flags)
 
 	/* Allocate new i-node in filesystem */
 	ext4_inode_ref_t *inode_ref;
+	ext4_journal_begin(inst->filesystem);
 	rc = ext4_filesystem_alloc_inode(inst->filesystem, &inode_ref, flags);
+	errno_t rc2 = ext4_journal_end(inst->filesystem);
+	if (rc == EOK && rc2 != EOK) {
+		ext4_filesystem_put_inode_ref(inode_ref);
+		rc = rc2;
+	}
 	if (rc != EOK) {
 		free(enode);
 		free(fs_node);
@@ -501,29 +882,34 @@ errno_t ext4_destroy_node(fs_node_t *fn)
 
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_inode_ref_t *inode_ref = enode->inode_ref;
+	ext4_filesystem_t *fs = inode_ref->fs;
+
+	ext4_journal_begin(fs);
+
+	/* Drop data which have no blocks allocated yet */
+	ext4_delalloc_discard(enode->instance, inode_ref->index);
+	ext4_balloc_release_prealloc(fs, inode_ref->index);
 
 	/* Release data blocks */
 	rc = ext4_filesystem_truncate_inode(inode_ref, 0);
-	if (rc != EOK) {
-		ext4_node_put(fn);
-		return rc;
-	}
-
-	/*
-	 * TODO: Sset real deletion time when it will be supported.
-	 * Temporary set fake deletion time.
-	 */
-	ext4_inode_set_deletion_time(inode_ref->inode, 0xdeadbeef);
-	inode_ref->dirty = true;
+	if (rc == EOK) {
+		/*
+		 * TODO: Sset real deletion time when it will be supported.
+		 * Temporary set fake deletion time.
+		 */
+		ext4_inode_set_deletion_time(inode_ref->inode, 0xdeadbeef);
+		inode_ref->dirty = true;
 
-	/* Free inode */
-	rc = ext4_filesystem_free_inode(inode_ref);
-	if (rc != EOK) {
-		ext4_node_put(fn);
-		return rc;
+		/* Free inode */
+		rc = ext4_filesystem_free_inode(inode_ref);
 	}
 
-	return ext4_node_put(fn);
+	errno_t rc2 = ext4_journal_end(fs);
+	if (rc == EOK)
+		rc = rc2;
+
+	rc2 = ext4_node_put(fn);
+	return rc == EOK ? rc2 : rc;
 }
 
 /** Link the specfied node to directory.
@@ -535,7 +921,8 @@ errno_t ext4_destroy_node(fs_node_t *fn)
  * @return Error code
  *
  */
-errno_t ext4_link(fs_node_t *pfn, fs_node_t *cfn, const char *name)
+static errno_t ext4_link_core(fs_node_t *pfn, fs_node_t *cfn,
+    const char *name)
 {
 	/* Check maximum name length */
 	if (str_size(name) > EXT4_DIRECTORY_FILENAME_LEN)
@@ -599,6 +986,28 @@ errno_t ext4_link(fs_node_t *pfn, fs_node_t *cfn, const char *name)
 	return EOK;
 }
 
+/** Link the specfied node to directory.
+ *
+ * A wrapper for link_core operation running as one journal handle.
+ *
+ * @param pfn  Parent node to link in
+ * @param cfn  Node to be linked
+ * @param name Name which will be assigned to directory entry
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_link(fs_node_t *pfn, fs_node_t *cfn, const char *name)
+{
+	ext4_filesystem_t *fs = EXT4_NODE(pfn)->instance->filesystem;
+
+	ext4_journal_begin(fs);
+	errno_t rc = ext4_link_core(pfn, cfn, name);
+	errno_t rc2 = ext4_journal_end(fs);
+
+	return rc == EOK ? rc2 : rc;
+}
+
 /** Unlink node from specified directory.
  *
  * @param pfn  Parent node to delete node from
@@ -608,7 +1017,8 @@ errno_t ext4_link(fs_node_t *pfn, fs_node_t *cfn, const char *name)
  * @return Error code
  *
  */
-errno_t ext4_unlink(fs_node_t *pfn, fs_node_t *cfn, const char *name)
+static errno_t ext4_unlink_core(fs_node_t *pfn, fs_node_t *cfn,
+    const char *name)
 {
 	bool has_children;
 	errno_t rc = ext4_has_children(&has_children, cfn);
@@ -671,6 +1081,28 @@ errno_t ext4_unlink(fs_node_t *pfn, fs_node_t *cfn, const char *name)
 	return EOK;
 }
 
+/** Unlink node from specified directory.
+ *
+ * A wrapper for unlink_core operation running as one journal handle.
+ *
+ * @param pfn  Parent node to delete node from
+ * @param cfn  Child node to be unlinked from directory
+ * @param name Name of entry that will be removed
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_unlink(fs_node_t *pfn, fs_node_t *cfn, const char *name)
+{
+	ext4_filesystem_t *fs = EXT4_NODE(pfn)->instance->filesystem;
+
+	ext4_journal_begin(fs);
+	errno_t rc = ext4_unlink_core(pfn, cfn, name);
+	errno_t rc2 = ext4_journal_end(fs);
+
+	return rc == EOK ? rc2 : rc;
+}
+
 /** Check if specified node has children.
  *
  * For files is response allways false and check is executed only for directories.
@@ -750,8 +1182,7 @@ fs_index_t ext4_index_get(fs_node_t *fn)
 aoff64_t ext4_size_get(fs_node_t *fn)
 {
 	ext4_node_t *enode = EXT4_NODE(fn);
-	ext4_superblock_t *sb = enode->instance->filesystem->superblock;
-	return ext4_inode_get_size(sb, enode->inode_ref->inode);
+	return ext4_delalloc_size(enode->instance, enode->inode_ref);
 }
 
 /** Get number of links to specified node.
@@ -951,6 +1382,9 @@ static errno_t ext4_mounted(service_id_t service_id, const char *opts,
 	link_initialize(&inst->link);
 	inst->service_id = service_id;
 	inst->open_nodes_count = 0;
+	list_initialize(&inst->delalloc);
+	inst->delalloc_size = 0;
+	fibril_mutex_initialize(&inst->delalloc_lock);
 
 	/* Initialize the filesystem */
 	aoff64_t rnsize;
@@ -987,6 +1421,15 @@ static errno_t ext4_unmounted(service_id_t service_id)
 	if (rc != EOK)
 		return rc;
 
+	/* Allocate blocks for all buffered data */
+	ext4_journal_begin(inst->filesystem);
+	rc = ext4_delalloc_flush_all(inst);
+	errno_t rc2 = ext4_journal_end(inst->filesystem);
+	if (rc == EOK)
+		rc = rc2;
+	if (rc != EOK)
+		return rc;
+
 	fibril_mutex_lock(&open_nodes_lock);
 
 	if (inst->open_nodes_count != 0) {
@@ -1053,6 +1496,18 @@ static errno_t ext4_read(service_id_t service_id, fs_index_t index, aoff64_t pos
 	/* Read from i-node by type */
 	if (ext4_inode_is_type(inst->filesystem->superblock, inode_ref->inode,
 	    EXT4_INODE_MODE_FILE)) {
+		/* Buffered data must be on the disk to be read */
+		ext4_journal_begin(inst->filesystem);
+		rc = ext4_delalloc_flush(inst, inode_ref);
+		errno_t rc2 = ext4_journal_end(inst->filesystem);
+		if (rc == EOK)
+			rc = rc2;
+		if (rc != EOK) {
+			async_answer_0(&call, rc);
+			ext4_filesystem_put_inode_ref(inode_ref);
+			return rc;
+		}
+
 		rc = ext4_read_file(&call, pos, size, inst, inode_ref,
 		    rbytes);
 	} else if (ext4_inode_is_type(inst->filesystem->superblock,
@@ -1180,6 +1635,79 @@ errno_t ext4_read_directory(ipc_call_t *call, aoff64_t pos, size_t size,
 	}
 }
 
+/** Read a batch of directory entries.
+ *
+ * Walks the directory from @a pos and hands every live entry other than
+ * dot and dotdot to libfs until the reply buffer is full.
+ *
+ * @param service_id Device to read data from
+ * @param index      Number of the directory node
+ * @param pos        Position to start reading from
+ * @param rd         Batch being assembled
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_readdir(service_id_t service_id, fs_index_t index,
+    aoff64_t pos, fs_readdir_t *rd)
+{
+	ext4_instance_t *inst;
+	errno_t rc = ext4_instance_get(service_id, &inst);
+	if (rc != EOK)
+		return rc;
+
+	ext4_inode_ref_t *inode_ref;
+	rc = ext4_filesystem_get_inode_ref(inst->filesystem, index, &inode_ref);
+	if (rc != EOK)
+		return rc;
+
+	ext4_superblock_t *sb = inst->filesystem->superblock;
+	if (!ext4_inode_is_type(sb, inode_ref->inode,
+	    EXT4_INODE_MODE_DIRECTORY)) {
+		ext4_filesystem_put_inode_ref(inode_ref);
+		return ENOTDIR;
+	}
+
+	ext4_directory_iterator_t it;
+	rc = ext4_directory_iterator_init(&it, inode_ref, pos);
+	if (rc != EOK) {
+		ext4_filesystem_put_inode_ref(inode_ref);
+		return rc;
+	}
+
+	char name[EXT4_DIRECTORY_FILENAME_LEN + 1];
+	while (it.current != NULL) {
+		uint32_t child = ext4_directory_entry_ll_get_inode(it.current);
+		uint16_t name_size =
+		    ext4_directory_entry_ll_get_name_length(sb, it.current);
+		bool live = (child != 0) &&
+		    !ext4_is_dots(it.current->name, name_size);
+
+		if (live) {
+			memcpy(name, it.current->name, name_size);
+			name[name_size] = '\0';
+		}
+
+		rc = ext4_directory_iterator_next(&it);
+		if (rc != EOK)
+			break;
+
+		if (!live)
+			continue;
+
+		/* A full buffer just ends this batch */
+		if (fs_readdir_add(rd, name, child, it.current_offset) != EOK)
+			break;
+	}
+
+	errno_t rc2 = ext4_directory_iterator_fini(&it);
+	if (rc == EOK)
+		rc = rc2;
+
+	rc2 = ext4_filesystem_put_inode_ref(inode_ref);
+	return rc == EOK ? rc2 : rc;
+}
+
 /** Read data from file.
  *
  * @param call      IPC call
@@ -1205,68 +1733,134 @@ errno_t ext4_read_file(ipc_call_t *call, aoff64_t pos, size_t size,
 		return EOK;
 	}
 
-	/* For now, we only read data from one block at a time */
+	/* Handle end of file and limit of the data transfer */
+	size = min(size, DATA_XFER_LIMIT);
+	if (pos + size > file_size)
+		size = file_size - pos;
+
+	uint8_t *buffer = malloc(size);
+	if (buffer == NULL) {
+		async_answer_0(call, ENOMEM);
+		return ENOMEM;
+	}
+
 	uint32_t block_size = ext4_superblock_get_block_size(sb);
-	aoff64_t file_block = pos / block_size;
-	uint32_t offset_in_block = pos % block_size;
-	uint32_t bytes = min(block_size - offset_in_block, size);
+	size_t done = 0;
+	errno_t rc = EOK;
+
+	while (done < size) {
+		aoff64_t file_block = (pos + done) / block_size;
+		uint32_t offset_in_block = (pos + done) % block_size;
+		size_t left = size - done;
+
+		/* Map as many blocks of the request as possible at once */
+		uint32_t fs_block;
+		uint32_t count;
+		rc = ext4_filesystem_get_inode_data_block_run(inode_ref,
+		    file_block, (offset_in_block + left + block_size - 1) /
+		    block_size, &fs_block, &count);
+		if (rc != EOK)
+			break;
+
+		size_t bytes = min((size_t) count * block_size - offset_in_block,
+		    left);
+
+		if (fs_block == 0) {
+			/*
+			 * Sparse file - the blocks are not allocated for
+			 * the file and read as zeros.
+			 */
+			memset(buffer + done, 0, bytes);
+		} else if ((offset_in_block == 0) && (bytes >= block_size)) {
+			/* Transfer whole blocks directly from the device */
+			size_t blocks = bytes / block_size;
+			bytes = blocks * block_size;
+
+			rc = block_read_range(inst->service_id, fs_block, blocks,
+			    buffer + done);
+			if (rc != EOK)
+				break;
+		} else {
+			/* Partial block goes through the block cache */
+			bytes = min(block_size - offset_in_block, left);
+
+			block_t *block;
+			rc = block_get(&block, inst->service_id, fs_block,
+			    BLOCK_FLAGS_NONE);
+			if (rc != EOK)
+				break;
 
-	/* Handle end of file */
-	if (pos + bytes > file_size)
-		bytes = file_size - pos;
+			memcpy(buffer + done, block->data + offset_in_block, bytes);
+
+			rc = block_put(block);
+			if (rc != EOK)
+				break;
+		}
+
+		done += bytes;
+	}
 
-	/* Get the real block number */
-	uint32_t fs_block;
-	errno_t rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
-	    file_block, &fs_block);
 	if (rc != EOK) {
+		free(buffer);
 		async_answer_0(call, rc);
 		return rc;
 	}
 
-	/*
-	 * Check for sparse file.
-	 * If ext4_filesystem_get_inode_data_block_index returned
-	 * fs_block == 0, it means that the given block is not allocated for the
-	 * file and we need to return a buffer of zeros
-	 */
-	uint8_t *buffer;
-	if (fs_block == 0) {
-		buffer = malloc(bytes);
-		if (buffer == NULL) {
-			async_answer_0(call, ENOMEM);
-			return ENOMEM;
-		}
+	rc = async_data_read_finalize(call, buffer, size);
+	free(buffer);
+
+	if (rc != EOK)
+		return rc;
 
-		memset(buffer, 0, bytes);
+	*rbytes = size;
+	return EOK;
+}
 
-		rc = async_data_read_finalize(call, buffer, bytes);
-		*rbytes = bytes;
+/** Allocate data blocks for logical blocks of a file.
+ *
+ * In i-nodes using extents the blocks can only be appended after
+ * the last mapped block, the blocks in between are left unmapped.
+ *
+ * @param inode_ref I-node to allocate the blocks for
+ * @param iblock    Logical number of the first block
+ * @param want      Requested number of blocks
+ * @param fblock    Output value for the first allocated physical block
+ * @param count     Output value for number of allocated blocks
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_write_alloc_blocks(ext4_inode_ref_t *inode_ref,
+    uint32_t iblock, uint32_t want, uint32_t *fblock, uint32_t *count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	errno_t rc;
+
+	if ((ext4_superblock_has_feature_incompatible(fs->superblock,
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
+	    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
+		rc = ext4_extent_append_blocks(inode_ref, iblock, want,
+		    fblock, count);
+		if (rc == ENOTSUP) {
+			/* Filling holes inside the file is not supported */
+			rc = EIO;
+		}
 
-		free(buffer);
 		return rc;
 	}
 
-	/* Usual case - we need to read a block from device */
-	block_t *block;
-	rc = block_get(&block, inst->service_id, fs_block, BLOCK_FLAGS_NONE);
-	if (rc != EOK) {
-		async_answer_0(call, rc);
+	rc = ext4_balloc_alloc_blocks(inode_ref, iblock, 0, 1, fblock, count);
+	if (rc != EOK)
 		return rc;
-	}
 
-	assert(offset_in_block + bytes <= block_size);
-	rc = async_data_read_finalize(call, block->data + offset_in_block, bytes);
+	rc = ext4_filesystem_set_inode_data_block_index(inode_ref,
+	    iblock, *fblock);
 	if (rc != EOK) {
-		block_put(block);
+		ext4_balloc_free_block(inode_ref, *fblock);
 		return rc;
 	}
 
-	rc = block_put(block);
-	if (rc != EOK)
-		return rc;
-
-	*rbytes = bytes;
+	inode_ref->dirty = true;
 	return EOK;
 }
 
@@ -1300,107 +1894,137 @@ static errno_t ext4_write(service_id_t service_id, fs_index_t index, aoff64_t po
 
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_filesystem_t *fs = enode->instance->filesystem;
+	ext4_inode_ref_t *inode_ref = enode->inode_ref;
 
 	uint32_t block_size = ext4_superblock_get_block_size(fs->superblock);
 
-	/* Prevent writing to more than one block */
-	uint32_t bytes = min(len, block_size - (pos % block_size));
-
-	int flags = BLOCK_FLAGS_NONE;
-	if (bytes == block_size)
-		flags = BLOCK_FLAGS_NOREAD;
-
-	uint32_t iblock =  pos / block_size;
-	uint32_t fblock;
+	/* Receive all the data at once */
+	len = min(len, DATA_XFER_LIMIT);
+	uint8_t *buffer = malloc(len);
+	if (buffer == NULL) {
+		rc = ENOMEM;
+		async_answer_0(&call, rc);
+		goto exit;
+	}
 
-	/* Load inode */
-	ext4_inode_ref_t *inode_ref = enode->inode_ref;
-	rc = ext4_filesystem_get_inode_data_block_index(inode_ref, iblock,
-	    &fblock);
+	rc = async_data_write_finalize(&call, buffer, len);
 	if (rc != EOK) {
-		async_answer_0(&call, rc);
+		free(buffer);
 		goto exit;
 	}
 
-	/* Check for sparse file */
-	if (fblock == 0) {
-		if ((ext4_superblock_has_feature_incompatible(fs->superblock,
-		    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
-		    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
-			uint32_t last_iblock =
-			    ext4_inode_get_size(fs->superblock, inode_ref->inode) /
-			    block_size;
-
-			while (last_iblock < iblock) {
-				rc = ext4_extent_append_block(inode_ref, &last_iblock,
-				    &fblock, true);
-				if (rc != EOK) {
-					async_answer_0(&call, rc);
-					goto exit;
-				}
-			}
+	ext4_journal_begin(fs);
 
-			rc = ext4_extent_append_block(inode_ref, &last_iblock,
-			    &fblock, false);
-			if (rc != EOK) {
-				async_answer_0(&call, rc);
-				goto exit;
-			}
-		} else {
-			rc = ext4_balloc_alloc_block(inode_ref, &fblock);
-			if (rc != EOK) {
-				async_answer_0(&call, rc);
-				goto exit;
-			}
+	/* Appended data are only buffered */
+	rc = ext4_delalloc_write(enode->instance, inode_ref, pos, buffer, len,
+	    nsize);
+	if (rc != ENOENT) {
+		free(buffer);
+		if (rc == EOK)
+			*wbytes = len;
+		goto end;
+	}
 
-			rc = ext4_filesystem_set_inode_data_block_index(inode_ref,
-			    iblock, fblock);
-			if (rc != EOK) {
-				ext4_balloc_free_block(inode_ref, fblock);
-				async_answer_0(&call, rc);
-				goto exit;
-			}
+	size_t done = 0;
+
+	/* Logical blocks allocated by this write */
+	uint32_t fresh_first = 0;
+	uint32_t fresh_end = 0;
+
+	rc = EOK;
+	while (done < len) {
+		uint32_t iblock = (pos + done) / block_size;
+		uint32_t offset_in_block = (pos + done) % block_size;
+		size_t left = len - done;
+
+		uint32_t fblock;
+		uint32_t count;
+		uint32_t want = (offset_in_block + left + block_size - 1) /
+		    block_size;
+		rc = ext4_filesystem_get_inode_data_block_run(inode_ref, iblock,
+		    want, &fblock, &count);
+		if (rc != EOK)
+			break;
+
+		if (fblock == 0) {
+			rc = ext4_write_alloc_blocks(inode_ref, iblock,
+			    min(want, count), &fblock, &count);
+			if (rc != EOK)
+				break;
+
+			fresh_first = iblock;
+			fresh_end = iblock + count;
 		}
 
-		flags = BLOCK_FLAGS_NOREAD;
-		inode_ref->dirty = true;
-	}
+		/* Newly allocated block must not be read from the device */
+		bool fresh = (iblock >= fresh_first) && (iblock < fresh_end);
 
-	/* Load target block */
-	block_t *write_block;
-	rc = block_get(&write_block, service_id, fblock, flags);
-	if (rc != EOK) {
-		async_answer_0(&call, rc);
-		goto exit;
-	}
+		size_t bytes;
+		if ((offset_in_block == 0) && (left >= block_size)) {
+			/* Transfer whole blocks directly to the device */
+			size_t blocks = min(count, left / block_size);
+			bytes = blocks * block_size;
 
-	if (flags == BLOCK_FLAGS_NOREAD)
-		memset(write_block->data, 0, block_size);
+			rc = block_write_range(service_id, fblock, blocks,
+			    buffer + done);
+			if (rc != EOK)
+				break;
+		} else {
+			/* Partial block goes through the block cache */
+			bytes = min(block_size - offset_in_block, left);
 
-	rc = async_data_write_finalize(&call, write_block->data +
-	    (pos % block_size), bytes);
-	if (rc != EOK) {
-		block_put(write_block);
-		goto exit;
-	}
+			block_t *write_block;
+			rc = block_get(&write_block, service_id, fblock,
+			    fresh ? BLOCK_FLAGS_NOREAD : BLOCK_FLAGS_NONE);
+			if (rc != EOK)
+				break;
 
-	write_block->dirty = true;
+			if (fresh)
+				memset(write_block->data, 0, block_size);
+
+			memcpy(write_block->data + offset_in_block,
+			    buffer + done, bytes);
+
+			/*
+			 * With the journal, data must be on the device before
+			 * the transaction referring to them commits.
+			 */
+			if (ext4_journal_is_active(fs)) {
+				rc = block_write_range(service_id, fblock, 1,
+				    write_block->data);
+			} else {
+				write_block->dirty = true;
+			}
 
-	rc = block_put(write_block);
-	if (rc != EOK)
-		goto exit;
+			rc2 = block_put(write_block);
+			if (rc == EOK)
+				rc = rc2;
+			if (rc != EOK)
+				break;
+		}
 
-	/* Do some counting */
-	uint32_t old_inode_size = ext4_inode_get_size(fs->superblock,
-	    inode_ref->inode);
-	if (pos + bytes > old_inode_size) {
-		ext4_inode_set_size(inode_ref->inode, pos + bytes);
+		done += bytes;
+	}
+
+	free(buffer);
+
+	/* Extend the file over the written data */
+	if (pos + done > ext4_inode_get_size(fs->superblock, inode_ref->inode)) {
+		ext4_inode_set_size(inode_ref->inode, pos + done);
 		inode_ref->dirty = true;
 	}
 
+	/* Report partial success if some data were written */
+	if (done > 0)
+		rc = EOK;
+
 	*nsize = ext4_inode_get_size(fs->superblock, inode_ref->inode);
-	*wbytes = bytes;
+	*wbytes = done;
 
+end:
+	rc2 = ext4_journal_end(fs);
+	if (rc == EOK)
+		rc = rc2;
 exit:
 	rc2 = ext4_node_put(fn);
 	return rc == EOK ? rc2 : rc;
@@ -1428,13 +2052,23 @@ static errno_t ext4_truncate(service_id_t service_id, fs_index_t index,
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_inode_ref_t *inode_ref = enode->inode_ref;
 
-	rc = ext4_filesystem_truncate_inode(inode_ref, new_size);
-	errno_t const rc2 = ext4_node_put(fn);
+	ext4_journal_begin(inode_ref->fs);
+	rc = ext4_delalloc_flush(enode->instance, inode_ref);
+	if (rc == EOK)
+		rc = ext4_filesystem_truncate_inode(inode_ref, new_size);
+	errno_t rc2 = ext4_journal_end(inode_ref->fs);
+	if (rc == EOK)
+		rc = rc2;
+
+	rc2 = ext4_node_put(fn);
 
 	return rc == EOK ? rc2 : rc;
 }
 
 /** Close file.
+ *
+ * Buffered data are written and the blocks reserved for the file
+ * are released.
  *
  * @param service_id Device identifier
  * @param index      I-node number
@@ -1444,7 +2078,23 @@ static errno_t ext4_truncate(service_id_t service_id, fs_index_t index,
  */
 static errno_t ext4_close(service_id_t service_id, fs_index_t index)
 {
-	return EOK;
+	fs_node_t *fn;
+	errno_t rc = ext4_node_get(&fn, service_id, index);
+	if (rc != EOK)
+		return rc;
+
+	ext4_node_t *enode = EXT4_NODE(fn);
+	ext4_filesystem_t *fs = enode->instance->filesystem;
+
+	ext4_journal_begin(fs);
+	rc = ext4_delalloc_flush(enode->instance, enode->inode_ref);
+	ext4_balloc_release_prealloc(fs, index);
+	errno_t rc2 = ext4_journal_end(fs);
+	if (rc == EOK)
+		rc = rc2;
+
+	rc2 = ext4_node_put(fn);
+	return rc == EOK ? rc2 : rc;
 }
 
 /** Destroy node specified by index.
@@ -1480,9 +2130,22 @@ static errno_t ext4_sync(service_id_t service_id, fs_index_t index)
 		return rc;
 
 	ext4_node_t *enode = EXT4_NODE(fn);
+	ext4_filesystem_t *fs = enode->instance->filesystem;
+
+	ext4_journal_begin(fs);
+	rc = ext4_delalloc_flush(enode->instance, enode->inode_ref);
 	enode->inode_ref->dirty = true;
+	errno_t rc2 = ext4_journal_end(fs);
+	if (rc == EOK)
+		rc = rc2;
 
-	return ext4_node_put(fn);
+	rc2 = ext4_node_put(fn);
+	if (rc == EOK)
+		rc = rc2;
+
+	/* Make the changes durable */
+	rc2 = ext4_journal_commit(fs);
+	return rc == EOK ? rc2 : rc;
 }
 
 /** VFS operations
@@ -1493,6 +2156,7 @@ vfs_out_ops_t ext4_ops = {
 	.mounted = ext4_mounted,
 	.unmounted = ext4_unmounted,
 	.read = ext4_read,
+	.readdir = ext4_readdir,
 	.write = ext4_write,
 	.truncate = ext4_truncate,
 	.close = ext4_close,
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ext4/buddy.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+#include <string.h>
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(buddy);
+
+#define GROUP_BLOCKS  4096
+
+/** On-disk style block bitmap (set bit means used) */
+static uint8_t bitmap[GROUP_BLOCKS / 8];
+
+static void bitmap_set(uint32_t first, uint32_t count)
+{
+	for (uint32_t i = first; i < first + count; i++)
+		bitmap[i / 8] |= 1 << (i % 8);
+}
+
+/** Empty group has one free chunk of the highest order */
+PCUT_TEST(init_empty)
+{
+	ext4_buddy_t buddy;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+
+	PCUT_ASSERT_INT_EQUALS(12, buddy.max_order);
+	PCUT_ASSERT_INT_EQUALS(GROUP_BLOCKS, buddy.free);
+	PCUT_ASSERT_INT_EQUALS(1, buddy.count[12]);
+	PCUT_ASSERT_INT_EQUALS(2, buddy.count[11]);
+	PCUT_ASSERT_INT_EQUALS(GROUP_BLOCKS, buddy.count[0]);
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Used blocks from the on-disk bitmap split the free chunks */
+PCUT_TEST(init_used)
+{
+	ext4_buddy_t buddy;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	bitmap_set(0, 3);
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+
+	PCUT_ASSERT_INT_EQUALS(GROUP_BLOCKS - 3, buddy.free);
+	PCUT_ASSERT_FALSE(ext4_buddy_is_free(&buddy, 2));
+	PCUT_ASSERT_TRUE(ext4_buddy_is_free(&buddy, 3));
+	PCUT_ASSERT_INT_EQUALS(0, buddy.count[12]);
+	PCUT_ASSERT_INT_EQUALS(1, buddy.count[11]);
+	PCUT_ASSERT_INT_EQUALS(1023, buddy.count[2]);
+	PCUT_ASSERT_INT_EQUALS(2046, buddy.count[1]);
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Group size which is not a power of two */
+PCUT_TEST(init_partial_group)
+{
+	ext4_buddy_t buddy;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, 100));
+
+	PCUT_ASSERT_INT_EQUALS(6, buddy.max_order);
+	PCUT_ASSERT_INT_EQUALS(100, buddy.free);
+	PCUT_ASSERT_INT_EQUALS(1, buddy.count[6]);
+	PCUT_ASSERT_INT_EQUALS(3, buddy.count[5]);
+	PCUT_ASSERT_FALSE(ext4_buddy_is_free(&buddy, 100));
+	PCUT_ASSERT_INT_EQUALS(4, ext4_buddy_free_run(&buddy, 96, 10));
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Marking blocks free restores the chunk counters */
+PCUT_TEST(mark_used_free)
+{
+	ext4_buddy_t buddy;
+	uint32_t count[EXT4_BUDDY_MAX_ORDER + 1];
+
+	memset(bitmap, 0, sizeof(bitmap));
+	bitmap_set(1000, 10);
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+	memcpy(count, buddy.count, sizeof(count));
+
+	ext4_buddy_mark_used(&buddy, 17, 300);
+	PCUT_ASSERT_INT_EQUALS(GROUP_BLOCKS - 310, buddy.free);
+	PCUT_ASSERT_INT_EQUALS(0, ext4_buddy_free_run(&buddy, 17, 10));
+	PCUT_ASSERT_INT_EQUALS(17, ext4_buddy_free_run(&buddy, 0, 100));
+
+	ext4_buddy_mark_free(&buddy, 17, 300);
+	PCUT_ASSERT_INT_EQUALS(GROUP_BLOCKS - 10, buddy.free);
+	for (unsigned i = 0; i <= buddy.max_order; i++)
+		PCUT_ASSERT_INT_EQUALS(count[i], buddy.count[i]);
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Free run at the goal is preferred */
+PCUT_TEST(find_goal)
+{
+	ext4_buddy_t buddy;
+	uint32_t start, len;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	bitmap_set(0, 77);
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+
+	PCUT_ASSERT_TRUE(ext4_buddy_find(&buddy, 77, 40, &start, &len));
+	PCUT_ASSERT_INT_EQUALS(77, start);
+	PCUT_ASSERT_INT_EQUALS(40, len);
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Aligned chunk is used if the goal is taken */
+PCUT_TEST(find_chunk)
+{
+	ext4_buddy_t buddy;
+	uint32_t start, len;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	bitmap_set(0, 77);
+	bitmap_set(80, 1);
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+
+	PCUT_ASSERT_TRUE(ext4_buddy_find(&buddy, 77, 40, &start, &len));
+	PCUT_ASSERT_INT_EQUALS(128, start);
+	PCUT_ASSERT_INT_EQUALS(40, len);
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Longest run is returned if the request cannot be satisfied */
+PCUT_TEST(find_fragmented)
+{
+	ext4_buddy_t buddy;
+	uint32_t start, len;
+
+	/* Every eighth block is used */
+	memset(bitmap, 0x01, sizeof(bitmap));
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+	PCUT_ASSERT_INT_EQUALS(0, buddy.count[3]);
+
+	PCUT_ASSERT_TRUE(ext4_buddy_find(&buddy, 1000, 64, &start, &len));
+	PCUT_ASSERT_INT_EQUALS(7, len);
+	PCUT_ASSERT_INT_EQUALS(1, start % 8);
+
+	ext4_buddy_fini(&buddy);
+}
+
+/** Full group */
+PCUT_TEST(find_full)
+{
+	ext4_buddy_t buddy;
+	uint32_t start, len;
+
+	memset(bitmap, 0xff, sizeof(bitmap));
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+	PCUT_ASSERT_FALSE(ext4_buddy_find(&buddy, 0, 1, &start, &len));
+
+	ext4_buddy_mark_free(&buddy, 4095, 1);
+	PCUT_ASSERT_TRUE(ext4_buddy_find(&buddy, 0, 8, &start, &len));
+	PCUT_ASSERT_INT_EQUALS(4095, start);
+	PCUT_ASSERT_INT_EQUALS(1, len);
+
+	ext4_buddy_fini(&buddy);
+}
+
+#define WRITERS  4
+#define WRITER_BLOCKS  256
+
+/** Simulate interleaved appending writers.
+ *
+ * Each writer appends one block at a time with goal right after its
+ * last block. Blocks are taken from a window reserved for the writer,
+ * a new window is found when the current one is used up.
+ *
+ * @param window Number of blocks reserved at once
+ *
+ * @return Maximum number of extents of a file
+ *
+ */
+static unsigned fragmentation(uint32_t window)
+{
+	ext4_buddy_t buddy;
+	uint32_t next[WRITERS];
+	uint32_t left[WRITERS];
+	unsigned extents[WRITERS];
+	unsigned max_extents = 0;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	PCUT_ASSERT_ERRNO_VAL(EOK, ext4_buddy_init(&buddy, bitmap, GROUP_BLOCKS));
+
+	for (unsigned w = 0; w < WRITERS; w++) {
+		next[w] = 0;
+		left[w] = 0;
+		extents[w] = 0;
+	}
+
+	for (unsigned b = 0; b < WRITER_BLOCKS; b++) {
+		for (unsigned w = 0; w < WRITERS; w++) {
+			if (left[w] == 0) {
+				uint32_t start, len;
+
+				PCUT_ASSERT_TRUE(ext4_buddy_find(&buddy, next[w],
+				    window, &start, &len));
+				ext4_buddy_mark_used(&buddy, start, len);
+
+				if ((b == 0) || (start != next[w]))
+					extents[w]++;
+
+				next[w] = start;
+				left[w] = len;
+			}
+
+			next[w]++;
+			left[w]--;
+		}
+	}
+
+	for (unsigned w = 0; w < WRITERS; w++) {
+		if (extents[w] > max_extents)
+			max_extents = extents[w];
+	}
+
+	ext4_buddy_fini(&buddy);
+	return max_extents;
+}
+
+/** Reserving windows keeps interleaved files contiguous */
+PCUT_TEST(fragmentation)
+{
+	PCUT_ASSERT_INT_EQUALS(WRITER_BLOCKS, fragmentation(1));
+	PCUT_ASSERT_TRUE(fragmentation(16) <= WRITER_BLOCKS / 16);
+	PCUT_ASSERT_INT_EQUALS(1, fragmentation(WRITER_BLOCKS));
+}
+
+PCUT_EXPORT(buddy);
@@ -36,6 +36,7 @@
 
 #include "libfs.h"
 #include <macros.h>
+#include <align.h>
 #include <errno.h>
 #include <async.h>
 #include <as.h>
@@ -70,11 +71,32 @@ static libfs_ops_t *libfs_ops = NULL;
 
 static char fs_name[FS_NAME_MAXLEN + 1];
 
+struct fs_readdir {
+	/** Buffer for the entry records. */
+	uint8_t *buf;
+	/** Size of the buffer. */
+	size_t size;
+	/** Number of bytes used in the buffer. */
+	size_t used;
+	/** Number of entries in the buffer. */
+	size_t count;
+	/** Directory position following the last entry in the buffer. */
+	aoff64_t pos;
+	/** Service ID of the file system. */
+	service_id_t service_id;
+	/** Whether the attributes of the entries are requested. */
+	bool stat;
+	/** An entry did not fit into the buffer. */
+	bool full;
+};
+
 static void libfs_link(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_lookup(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_stat(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_open_node(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_statfs(libfs_ops_t *, fs_handle_t, ipc_call_t *);
+static void libfs_stat_fill(libfs_ops_t *, fs_handle_t, service_id_t,
+    fs_index_t, fs_node_t *, vfs_stat_t *);
 
 static void vfs_out_fsprobe(ipc_call_t *req)
 {
@@ -166,6 +188,66 @@ static void vfs_out_read(ipc_call_t *req)
 		async_answer_0(req, rc);
 }
 
+static void vfs_out_readdir(ipc_call_t *req, bool stat)
+{
+	service_id_t service_id = (service_id_t) ipc_get_arg1(req);
+	fs_index_t index = (fs_index_t) ipc_get_arg2(req);
+	aoff64_t pos = (aoff64_t) MERGE_LOUP32(ipc_get_arg3(req),
+	    ipc_get_arg4(req));
+	fs_readdir_t rd;
+	errno_t rc;
+
+	ipc_call_t call;
+	size_t size;
+	if (!async_data_read_receive(&call, &size)) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(req, EINVAL);
+		return;
+	}
+
+	if (vfs_out_ops->readdir == NULL) {
+		async_answer_0(&call, ENOTSUP);
+		async_answer_0(req, ENOTSUP);
+		return;
+	}
+
+	rd.buf = malloc(size);
+	if (rd.buf == NULL) {
+		async_answer_0(&call, ENOMEM);
+		async_answer_0(req, ENOMEM);
+		return;
+	}
+
+	rd.size = size;
+	rd.used = 0;
+	rd.count = 0;
+	rd.pos = pos;
+	rd.service_id = service_id;
+	rd.stat = stat;
+	rd.full = false;
+
+	rc = vfs_out_ops->readdir(service_id, index, pos, &rd);
+	if (rc == EOK && rd.count == 0 && rd.full) {
+		/* Not even the first entry fits, do not report end. */
+		rc = ELIMIT;
+	}
+
+	/*
+	 * Return the entries gathered so far even if the enumeration failed
+	 * half way. The error will be reported by the next request.
+	 */
+	if (rc != EOK && rd.count == 0) {
+		free(rd.buf);
+		async_answer_0(&call, rc);
+		async_answer_0(req, rc);
+		return;
+	}
+
+	async_data_read_finalize(&call, rd.buf, rd.used);
+	free(rd.buf);
+	async_answer_3(req, EOK, rd.count, LOWER32(rd.pos), UPPER32(rd.pos));
+}
+
 static void vfs_out_write(ipc_call_t *req)
 {
 	service_id_t service_id = (service_id_t) ipc_get_arg1(req);
@@ -313,6 +395,12 @@ static void vfs_connection(ipc_call_t *icall, void *arg)
 		case VFS_OUT_READ:
 			vfs_out_read(&call);
 			break;
+		case VFS_OUT_READDIR:
+			vfs_out_readdir(&call, false);
+			break;
+		case VFS_OUT_READDIR_STAT:
+			vfs_out_readdir(&call, true);
+			break;
 		case VFS_OUT_WRITE:
 			vfs_out_write(&call);
 			break;
@@ -433,6 +521,60 @@ void fs_node_initialize(fs_node_t *fn)
 	memset(fn, 0, sizeof(fs_node_t));
 }
 
+/** Add a directory entry to a batched directory read.
+ *
+ * Called by the readdir() operation of the file system for each entry,
+ * in directory order.
+ *
+ * @param rd       Batched directory read context.
+ * @param name     Name of the entry.
+ * @param index    Index of the node the entry refers to.
+ * @param next_pos Directory position following the entry.
+ *
+ * @return EOK if the entry was added, ELIMIT if there is no more room for
+ *         it. In the latter case the file system should stop enumerating
+ *         and return EOK.
+ */
+errno_t fs_readdir_add(fs_readdir_t *rd, const char *name, fs_index_t index,
+    aoff64_t next_pos)
+{
+	size_t nsize = str_size(name) + 1;
+	size_t reclen = ALIGN_UP(sizeof(vfs_dirent_t) + nsize,
+	    VFS_DIRENT_ALIGN);
+	vfs_dirent_t *d;
+
+	if (rd->size - rd->used < reclen) {
+		rd->full = true;
+		return ELIMIT;
+	}
+
+	d = (vfs_dirent_t *) (rd->buf + rd->used);
+	memset(d, 0, sizeof(vfs_dirent_t));
+	d->next_pos = next_pos;
+	d->reclen = reclen;
+	d->stat.fs_handle = reg.fs_handle;
+	d->stat.service_id = rd->service_id;
+	d->stat.index = index;
+	memcpy(d->name, name, nsize);
+
+	if (rd->stat) {
+		fs_node_t *fn;
+
+		if (libfs_ops->node_get(&fn, rd->service_id, index) == EOK &&
+		    fn != NULL) {
+			libfs_stat_fill(libfs_ops, reg.fs_handle,
+			    rd->service_id, index, fn, &d->stat);
+			libfs_ops->node_put(fn);
+			d->has_stat = true;
+		}
+	}
+
+	rd->used += reclen;
+	rd->count++;
+	rd->pos = next_pos;
+	return EOK;
+}
+
 static char plb_get_char(unsigned pos)
 {
 	return reg.plb_ro[pos % PLB_SIZE];
@@ -733,16 +875,7 @@ void libfs_stat(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
 	}
 
 	vfs_stat_t stat;
-	memset(&stat, 0, sizeof(vfs_stat_t));
-
-	stat.fs_handle = fs_handle;
-	stat.service_id = service_id;
-	stat.index = index;
-	stat.lnkcnt = ops->lnkcnt_get(fn);
-	stat.is_file = ops->is_file(fn);
-	stat.is_directory = ops->is_directory(fn);
-	stat.size = ops->size_get(fn);
-	stat.service = ops->service_get(fn);
+	libfs_stat_fill(ops, fs_handle, service_id, index, fn, &stat);
 
 	ops->node_put(fn);
 
@@ -750,6 +883,31 @@ void libfs_stat(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
 	async_answer_0(req, EOK);
 }
 
+/** Fill in the attributes of a node.
+ *
+ * @param ops        libfs operations of the file system.
+ * @param fs_handle  File system handle.
+ * @param service_id Service ID of the file system instance.
+ * @param index      Index of the node.
+ * @param fn         The node.
+ * @param stat       Place to store the attributes.
+ */
+static void libfs_stat_fill(libfs_ops_t *ops, fs_handle_t fs_handle,
+    service_id_t service_id, fs_index_t index, fs_node_t *fn,
+    vfs_stat_t *stat)
+{
+	memset(stat, 0, sizeof(vfs_stat_t));
+
+	stat->fs_handle = fs_handle;
+	stat->service_id = service_id;
+	stat->index = index;
+	stat->lnkcnt = ops->lnkcnt_get(fn);
+	stat->is_file = ops->is_file(fn);
+	stat->is_directory = ops->is_directory(fn);
+	stat->size = ops->size_get(fn);
+	stat->service = ops->service_get(fn);
+}
+
 void libfs_statfs(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
 {
 	service_id_t service_id = (service_id_t) ipc_get_arg1(req);
@@ -831,7 +989,11 @@ void libfs_open_node(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
 	(void) ops->node_put(fn);
 }
 
-static FIBRIL_MUTEX_INITIALIZE(instances_mutex);
+/*
+ * Instances are looked up on every request but created and destroyed only
+ * on mount and unmount, so lookups share the lock.
+ */
+static FIBRIL_RWLOCK_INITIALIZE(instances_lock);
 static LIST_INITIALIZE(instances_list);
 
 typedef struct {
@@ -850,10 +1012,10 @@ errno_t fs_instance_create(service_id_t service_id, void *data)
 	inst->service_id = service_id;
 	inst->data = data;
 
-	fibril_mutex_lock(&instances_mutex);
+	fibril_rwlock_write_lock(&instances_lock);
 	list_foreach(instances_list, link, fs_instance_t, cur) {
 		if (cur->service_id == service_id) {
-			fibril_mutex_unlock(&instances_mutex);
+			fibril_rwlock_write_unlock(&instances_lock);
 			free(inst);
 			return EEXIST;
 		}
@@ -861,46 +1023,46 @@ errno_t fs_instance_create(service_id_t service_id, void *data)
 		/* keep the list sorted */
 		if (cur->service_id < service_id) {
 			list_insert_before(&inst->link, &cur->link);
-			fibril_mutex_unlock(&instances_mutex);
+			fibril_rwlock_write_unlock(&instances_lock);
 			return EOK;
 		}
 	}
 	list_append(&inst->link, &instances_list);
-	fibril_mutex_unlock(&instances_mutex);
+	fibril_rwlock_write_unlock(&instances_lock);
 
 	return EOK;
 }
 
 errno_t fs_instance_get(service_id_t service_id, void **idp)
 {
-	fibril_mutex_lock(&instances_mutex);
+	fibril_rwlock_read_lock(&instances_lock);
 
 	list_foreach(instances_list, link, fs_instance_t, inst) {
 		if (inst->service_id == service_id) {
 			*idp = inst->data;
-			fibril_mutex_unlock(&instances_mutex);
+			fibril_rwlock_read_unlock(&instances_lock);
 			return EOK;
 		}
 	}
 
-	fibril_mutex_unlock(&instances_mutex);
+	fibril_rwlock_read_unlock(&instances_lock);
 	return ENOENT;
 }
 
 errno_t fs_instance_destroy(service_id_t service_id)
 {
-	fibril_mutex_lock(&instances_mutex);
+	fibril_rwlock_write_lock(&instances_lock);
 
 	list_foreach(instances_list, link, fs_instance_t, inst) {
 		if (inst->service_id == service_id) {
 			list_remove(&inst->link);
-			fibril_mutex_unlock(&instances_mutex);
+			fibril_rwlock_write_unlock(&instances_lock);
 			free(inst);
 			return EOK;
 		}
 	}
 
-	fibril_mutex_unlock(&instances_mutex);
+	fibril_rwlock_write_unlock(&instances_lock);
 	return ENOENT;
 }
 
@@ -41,6 +41,9 @@
 #include <async.h>
 #include <loc.h>
 
+/** Context of a batched directory read, see fs_readdir_add(). */
+typedef struct fs_readdir fs_readdir_t;
+
 typedef struct {
 	errno_t (*fsprobe)(service_id_t, vfs_fs_probe_info_t *);
 	errno_t (*mounted)(service_id_t, const char *, fs_index_t *, aoff64_t *);
@@ -52,6 +55,11 @@ typedef struct {
 	errno_t (*close)(service_id_t, fs_index_t);
 	errno_t (*destroy)(service_id_t, fs_index_t);
 	errno_t (*sync)(service_id_t, fs_index_t);
+	/*
+	 * Optional. Enumerate entries of a directory starting at the given
+	 * position, passing each of them to fs_readdir_add() until it fails.
+	 */
+	errno_t (*readdir)(service_id_t, fs_index_t, aoff64_t, fs_readdir_t *);
 } vfs_out_ops_t;
 
 typedef struct {
@@ -99,6 +107,9 @@ extern errno_t fs_register(async_sess_t *, vfs_info_t *, vfs_out_ops_t *,
 
 extern void fs_node_initialize(fs_node_t *);
 
+extern errno_t fs_readdir_add(fs_readdir_t *, const char *, fs_index_t,
+    aoff64_t);
+
 extern errno_t fs_instance_create(service_id_t, void *);
 extern errno_t fs_instance_get(service_id_t, void **);
 extern errno_t fs_instance_destroy(service_id_t);
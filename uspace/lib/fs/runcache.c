@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libfs
+ * @{
+ */
+/**
+ * @file
+ * Per-node cache of contiguous cluster runs.
+ */
+
+#include "runcache.h"
+#include <assert.h>
+#include <errno.h>
+#include <mem.h>
+#include <stdlib.h>
+
+/** Initialize an empty run cache.
+ *
+ * @param rc	Run cache.
+ */
+void fs_runcache_init(fs_runcache_t *rc)
+{
+	fibril_mutex_initialize(&rc->lock);
+	rc->runs = NULL;
+	rc->count = 0;
+	rc->size = 0;
+}
+
+/** Forget all runs and free the memory used by the run cache.
+ *
+ * The cache is left empty and can be used again.
+ *
+ * @param rc	Run cache.
+ */
+void fs_runcache_fini(fs_runcache_t *rc)
+{
+	free(rc->runs);
+	rc->runs = NULL;
+	rc->count = 0;
+	rc->size = 0;
+}
+
+/** Find the last run starting at or before a file cluster.
+ *
+ * @param rc	Run cache.
+ * @param fcl	File cluster index.
+ *
+ * @return	Index of the run or -1 if there is no such run.
+ */
+static int fs_runcache_search(fs_runcache_t *rc, uint32_t fcl)
+{
+	int lo = 0;
+	int hi = (int) rc->count - 1;
+	int res = -1;
+
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (rc->runs[mid].fcl <= fcl) {
+			res = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return res;
+}
+
+/** Find the cached cluster closest to a file cluster.
+ *
+ * Returns the mapping of @a fcl if it is cached. Otherwise returns the
+ * mapping of the nearest cached file cluster preceding @a fcl, from which
+ * the caller can continue walking the chain.
+ *
+ * @param rc	Run cache.
+ * @param fcl	File cluster index to look up.
+ * @param rfcl	Place to store the file cluster index that was found.
+ * @param rdcl	Place to store the device cluster number of @a rfcl.
+ *
+ * @return	EOK on success, ENOENT if no cluster at or before @a fcl
+ *		is cached.
+ */
+errno_t fs_runcache_find(fs_runcache_t *rc, uint32_t fcl, uint32_t *rfcl,
+    uint32_t *rdcl)
+{
+	fs_clrun_t *run;
+	uint32_t off;
+	int i;
+
+	fibril_mutex_lock(&rc->lock);
+	i = fs_runcache_search(rc, fcl);
+	if (i < 0) {
+		fibril_mutex_unlock(&rc->lock);
+		return ENOENT;
+	}
+
+	run = &rc->runs[i];
+	off = fcl - run->fcl;
+	if (off >= run->len)
+		off = run->len - 1;
+
+	*rfcl = run->fcl + off;
+	*rdcl = run->dcl + off;
+	fibril_mutex_unlock(&rc->lock);
+	return EOK;
+}
+
+/** Drop every other run to make room in a full run cache.
+ *
+ * Thinning out the runs uniformly keeps the distance which needs to be
+ * walked from the nearest cached run bounded across the whole file.
+ *
+ * @param rc	Run cache.
+ */
+static void fs_runcache_thin(fs_runcache_t *rc)
+{
+	unsigned i;
+
+	for (i = 0; 2 * i < rc->count; i++)
+		rc->runs[i] = rc->runs[2 * i];
+	rc->count = i;
+}
+
+/** Forget the mappings of file clusters beyond a new end of file.
+ *
+ * The caller must hold the run cache lock.
+ *
+ * @param rc	Run cache.
+ * @param ncl	Number of file clusters which remain mapped.
+ */
+static void fs_runcache_cut(fs_runcache_t *rc, uint32_t ncl)
+{
+	fs_clrun_t *run;
+
+	while (rc->count > 0) {
+		run = &rc->runs[rc->count - 1];
+		if (run->fcl < ncl) {
+			if (ncl - run->fcl < run->len)
+				run->len = ncl - run->fcl;
+			break;
+		}
+		rc->count--;
+	}
+}
+
+/** Remember the mapping of one file cluster with the lock held.
+ *
+ * @param rc	Run cache.
+ * @param fcl	File cluster index.
+ * @param dcl	Device cluster number of @a fcl.
+ *
+ * @return	EOK on success or ENOMEM.
+ */
+static errno_t fs_runcache_insert(fs_runcache_t *rc, uint32_t fcl,
+    uint32_t dcl)
+{
+	fs_clrun_t *run;
+	int i;
+
+	i = fs_runcache_search(rc, fcl);
+	if (i >= 0) {
+		run = &rc->runs[i];
+		if (fcl - run->fcl < run->len) {
+			if (run->dcl + (fcl - run->fcl) == dcl)
+				return EOK;
+			/* Stale mapping, forget the rest of the chain. */
+			fs_runcache_cut(rc, fcl);
+			i = fs_runcache_search(rc, fcl);
+		}
+	}
+
+	if (i >= 0) {
+		run = &rc->runs[i];
+		if (run->fcl + run->len == fcl && run->dcl + run->len == dcl) {
+			run->len++;
+			if ((unsigned) i + 1 < rc->count &&
+			    rc->runs[i + 1].fcl == fcl + 1 &&
+			    rc->runs[i + 1].dcl == dcl + 1) {
+				run->len += rc->runs[i + 1].len;
+				memmove(&rc->runs[i + 1], &rc->runs[i + 2],
+				    (rc->count - i - 2) * sizeof(fs_clrun_t));
+				rc->count--;
+			}
+			return EOK;
+		}
+	}
+
+	if ((unsigned) i + 1 < rc->count && rc->runs[i + 1].fcl == fcl + 1 &&
+	    rc->runs[i + 1].dcl == dcl + 1) {
+		run = &rc->runs[i + 1];
+		run->fcl--;
+		run->dcl--;
+		run->len++;
+		return EOK;
+	}
+
+	if (rc->count == FS_RUNCACHE_MAX_RUNS) {
+		fs_runcache_thin(rc);
+		i = fs_runcache_search(rc, fcl);
+	}
+
+	if (rc->count == rc->size) {
+		unsigned nsize = rc->size ? 2 * rc->size : 8;
+		fs_clrun_t *nruns;
+
+		nruns = realloc(rc->runs, nsize * sizeof(fs_clrun_t));
+		if (nruns == NULL)
+			return ENOMEM;
+		rc->runs = nruns;
+		rc->size = nsize;
+	}
+
+	memmove(&rc->runs[i + 2], &rc->runs[i + 1],
+	    (rc->count - i - 1) * sizeof(fs_clrun_t));
+	run = &rc->runs[i + 1];
+	run->fcl = fcl;
+	run->dcl = dcl;
+	run->len = 1;
+	rc->count++;
+
+	return EOK;
+}
+
+/** Remember the mapping of one file cluster.
+ *
+ * The mapping is merged with the adjacent runs if it extends them.
+ *
+ * @param rc	Run cache.
+ * @param fcl	File cluster index.
+ * @param dcl	Device cluster number of @a fcl.
+ *
+ * @return	EOK on success or ENOMEM. A failure to remember the mapping
+ *		does not invalidate the cache.
+ */
+errno_t fs_runcache_add(fs_runcache_t *rc, uint32_t fcl, uint32_t dcl)
+{
+	errno_t rc_add;
+
+	fibril_mutex_lock(&rc->lock);
+	rc_add = fs_runcache_insert(rc, fcl, dcl);
+	fibril_mutex_unlock(&rc->lock);
+	return rc_add;
+}
+
+/** Forget the mappings of file clusters beyond a new end of file.
+ *
+ * @param rc	Run cache.
+ * @param ncl	Number of file clusters which remain mapped.
+ */
+void fs_runcache_truncate(fs_runcache_t *rc, uint32_t ncl)
+{
+	fibril_mutex_lock(&rc->lock);
+	fs_runcache_cut(rc, ncl);
+	fibril_mutex_unlock(&rc->lock);
+}
+
+/** Find the file cluster index of a device cluster.
+ *
+ * @param rc	Run cache.
+ * @param dcl	Device cluster number.
+ * @param rfcl	Place to store the file cluster index of @a dcl.
+ *
+ * @return	EOK on success, ENOENT if @a dcl is not cached.
+ */
+errno_t fs_runcache_dcl_lookup(fs_runcache_t *rc, uint32_t dcl, uint32_t *rfcl)
+{
+	unsigned i;
+
+	fibril_mutex_lock(&rc->lock);
+	for (i = 0; i < rc->count; i++) {
+		fs_clrun_t *run = &rc->runs[i];
+
+		if (dcl >= run->dcl && dcl - run->dcl < run->len) {
+			*rfcl = run->fcl + (dcl - run->dcl);
+			fibril_mutex_unlock(&rc->lock);
+			return EOK;
+		}
+	}
+	fibril_mutex_unlock(&rc->lock);
+
+	return ENOENT;
+}
+
+/** @}
+ */
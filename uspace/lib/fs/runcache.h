@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libfs
+ * @{
+ */
+/**
+ * @file
+ * Per-node cache of contiguous cluster runs.
+ *
+ * File systems which keep their allocation map as a linked list of clusters
+ * (FAT, exFAT) have to walk the chain from the first cluster of a file in
+ * order to translate a file cluster index into a device cluster number. The
+ * run cache remembers the chain in the form of (file cluster, device cluster,
+ * length) extents so that the translation becomes a binary search and a walk
+ * is only needed for the part of the chain that has not been visited yet.
+ */
+
+#ifndef LIBFS_RUNCACHE_H_
+#define LIBFS_RUNCACHE_H_
+
+#include <errno.h>
+#include <fibril_synch.h>
+#include <stdint.h>
+
+/** Maximum number of runs kept for one node. */
+#define FS_RUNCACHE_MAX_RUNS	1024
+
+/** Contiguous run of clusters. */
+typedef struct {
+	/** Index of the first cluster of the run within the file. */
+	uint32_t fcl;
+	/** Device cluster number of the first cluster of the run. */
+	uint32_t dcl;
+	/** Number of clusters in the run. */
+	uint32_t len;
+} fs_clrun_t;
+
+/** Cluster run cache.
+ *
+ * The runs are sorted by the file cluster index and do not overlap. They do
+ * not need to cover the file completely.
+ */
+typedef struct {
+	/** Serializes concurrent readers of the node which fill the cache. */
+	fibril_mutex_t lock;
+	fs_clrun_t *runs;
+	unsigned count;
+	unsigned size;
+} fs_runcache_t;
+
+extern void fs_runcache_init(fs_runcache_t *);
+extern void fs_runcache_fini(fs_runcache_t *);
+extern errno_t fs_runcache_find(fs_runcache_t *, uint32_t, uint32_t *,
+    uint32_t *);
+extern errno_t fs_runcache_add(fs_runcache_t *, uint32_t, uint32_t);
+extern void fs_runcache_truncate(fs_runcache_t *, uint32_t);
+extern errno_t fs_runcache_dcl_lookup(fs_runcache_t *, uint32_t, uint32_t *);
+
+#endif
+
+/** @}
+ */
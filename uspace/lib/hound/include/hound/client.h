@@ -62,6 +62,7 @@ errno_t hound_context_get_connected_targets(hound_context_t *hound,
 
 errno_t hound_context_connect_target(hound_context_t *hound, const char *target);
 errno_t hound_context_disconnect_target(hound_context_t *hound, const char *target);
+errno_t hound_context_get_stats(hound_context_t *hound, hound_stats_t *stats);
 
 hound_stream_t *hound_stream_create(hound_context_t *hound, unsigned flags,
     pcm_format_t format, size_t bsize);
@@ -70,6 +71,8 @@ void hound_stream_destroy(hound_stream_t *stream);
 errno_t hound_stream_write(hound_stream_t *stream, const void *data, size_t size);
 errno_t hound_stream_read(hound_stream_t *stream, void *data, size_t size);
 errno_t hound_stream_drain(hound_stream_t *stream);
+errno_t hound_stream_get_stats(hound_stream_t *stream,
+    hound_stream_stats_t *stats);
 
 errno_t hound_write_main_stream(hound_context_t *hound,
     const void *data, size_t size);
@@ -52,6 +52,8 @@ typedef enum {
 	HOUND_STREAM_DRAIN_ON_EXIT = 0x1,
 	HOUND_STREAM_IGNORE_UNDERFLOW = 0x2,
 	HOUND_STREAM_IGNORE_OVERFLOW = 0x4,
+	HOUND_STREAM_RESAMPLE_FAST = 0x8,
+	HOUND_STREAM_RESAMPLE_BEST = 0x10,
 } hound_flags_t;
 
 typedef async_sess_t hound_sess_t;
@@ -59,6 +61,34 @@ typedef async_sess_t hound_sess_t;
 typedef struct {
 } *hound_context_id_t;
 
+/** Context statistics */
+typedef struct {
+	/** Number of streams currently attached to the context */
+	size_t streams;
+	/** Mixing periods in which a stream did not have enough data */
+	uint64_t underruns;
+	/** Data buffers dropped because a stream buffer was full */
+	uint64_t overruns;
+	/** Periods in which an output device ran out of data */
+	uint64_t device_underruns;
+	/** Periods mixed after their deadline by output devices */
+	uint64_t device_late;
+} hound_stats_t;
+
+/** Stream statistics */
+typedef struct {
+	/** Mixing periods in which the stream did not have enough data */
+	uint64_t underruns;
+	/** Data buffers dropped because the stream buffer was full */
+	uint64_t overruns;
+	/** Minimal latency (buffered data at mixing time) in usec */
+	usec_t latency_min;
+	/** Average latency in usec */
+	usec_t latency_avg;
+	/** Maximal latency in usec */
+	usec_t latency_max;
+} hound_stream_stats_t;
+
 hound_sess_t *hound_service_connect(const char *service);
 void hound_service_disconnect(hound_sess_t *sess);
 
@@ -68,6 +98,8 @@ errno_t hound_service_unregister_context(hound_sess_t *sess, hound_context_id_t
 
 errno_t hound_service_get_list(hound_sess_t *sess, char ***ids, size_t *count,
     int flags, const char *connection);
+errno_t hound_service_get_stats(hound_sess_t *sess, hound_context_id_t id,
+    hound_stats_t *stats);
 
 /**
  * Wrapper for list queries with no connection parameter.
@@ -91,6 +123,8 @@ errno_t hound_service_disconnect_source_sink(hound_sess_t *sess, const char *sou
 errno_t hound_service_stream_enter(async_exch_t *exch, hound_context_id_t id,
     int flags, pcm_format_t format, size_t bsize);
 errno_t hound_service_stream_drain(async_exch_t *exch);
+errno_t hound_service_stream_get_stats(async_exch_t *exch,
+    hound_stream_stats_t *stats);
 errno_t hound_service_stream_exit(async_exch_t *exch);
 
 errno_t hound_service_stream_write(async_exch_t *exch, const void *data, size_t size);
@@ -123,6 +157,10 @@ typedef struct hound_server_iface {
 	errno_t (*stream_data_write)(void *, void *, size_t);
 	/** Read data from the stream */
 	errno_t (*stream_data_read)(void *, void *, size_t);
+	/** Get context statistics */
+	errno_t (*get_stats)(void *, hound_context_id_t, hound_stats_t *);
+	/** Get stream statistics */
+	errno_t (*get_stream_stats)(void *, hound_stream_stats_t *);
 	void *server;
 } hound_server_iface_t;
 
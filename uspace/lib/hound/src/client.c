@@ -282,6 +282,19 @@ errno_t hound_context_disconnect_target(hound_context_t *hound, const char *targ
 	}
 }
 
+/**
+ * Retrieve mixing statistics of the context.
+ * @param hound Hound context.
+ * @param[out] stats Statistics structure to fill.
+ * @return Error code.
+ */
+errno_t hound_context_get_stats(hound_context_t *hound, hound_stats_t *stats)
+{
+	assert(hound);
+	assert(stats);
+	return hound_service_get_stats(hound->session, hound->id, stats);
+}
+
 /**
  * Create a new stream associated with the context.
  * @param hound Hound context.
@@ -376,6 +389,20 @@ errno_t hound_stream_drain(hound_stream_t *stream)
 	return hound_service_stream_drain(stream->exch);
 }
 
+/**
+ * Retrieve underrun, overrun and latency statistics of a stream.
+ * @param stream The stream to query.
+ * @param[out] stats Statistics structure to fill.
+ * @return Error code.
+ */
+errno_t hound_stream_get_stats(hound_stream_t *stream,
+    hound_stream_stats_t *stats)
+{
+	assert(stream);
+	assert(stats);
+	return hound_service_stream_get_stats(stream->exch, stats);
+}
+
 /**
  * Main stream getter function.
  * @param hound Houndcontext.
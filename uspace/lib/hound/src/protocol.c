@@ -64,6 +64,10 @@ enum ipc_methods {
 	IPC_M_HOUND_STREAM_EXIT,
 	/** Wait until there is no data in the stream */
 	IPC_M_HOUND_STREAM_DRAIN,
+	/** Retrieve context statistics */
+	IPC_M_HOUND_GET_STATS,
+	/** Retrieve statistics of the stream */
+	IPC_M_HOUND_STREAM_GET_STATS,
 };
 
 /** PCM format conversion helper structure */
@@ -162,6 +166,32 @@ errno_t hound_service_unregister_context(hound_sess_t *sess,
 	return ret;
 }
 
+/**
+ * Retrieve statistics of an application context.
+ * @param[in] sess Valid audio session.
+ * @param[in] id Valid context id.
+ * @param[out] stats Statistics structure to fill.
+ * @return Error code.
+ */
+errno_t hound_service_get_stats(hound_sess_t *sess, hound_context_id_t id,
+    hound_stats_t *stats)
+{
+	assert(sess);
+	assert(stats);
+	async_exch_t *exch = async_exchange_begin(sess);
+	aid_t mid = async_send_1(exch, IPC_M_HOUND_GET_STATS,
+	    cap_handle_raw(id), NULL);
+	errno_t ret = async_data_read_start(exch, stats, sizeof(hound_stats_t));
+	async_exchange_end(exch);
+	if (ret != EOK) {
+		async_forget(mid);
+		return ret;
+	}
+
+	async_wait_for(mid, &ret);
+	return ret;
+}
+
 /**
  * Retrieve a list of server side actors.
  * @param[in] sess Valid audio session.
@@ -338,6 +368,28 @@ errno_t hound_service_stream_drain(async_exch_t *exch)
 	return async_req_0_0(exch, IPC_M_HOUND_STREAM_DRAIN);
 }
 
+/**
+ * Retrieve statistics of the stream.
+ * @param exch IPC exchange in STREAM MODE.
+ * @param[out] stats Statistics structure to fill.
+ * @return Error code.
+ */
+errno_t hound_service_stream_get_stats(async_exch_t *exch,
+    hound_stream_stats_t *stats)
+{
+	assert(stats);
+	aid_t mid = async_send_0(exch, IPC_M_HOUND_STREAM_GET_STATS, NULL);
+	errno_t ret = async_data_read_start(exch, stats,
+	    sizeof(hound_stream_stats_t));
+	if (ret != EOK) {
+		async_forget(mid);
+		return ret;
+	}
+
+	async_wait_for(mid, &ret);
+	return ret;
+}
+
 /**
  * Write audio data to a stream.
  * @param exch IPC exchange in STREAM MODE.
@@ -608,8 +660,36 @@ void hound_connection_handler(ipc_call_t *icall, void *arg)
 				}
 			}
 			break;
+		case IPC_M_HOUND_GET_STATS:
+			/* check interface functions */
+			if (!server_iface || !server_iface->get_stats) {
+				async_answer_0(&call, ENOTSUP);
+				break;
+			}
+
+			context = (hound_context_id_t) ipc_get_arg1(&call);
+			hound_stats_t stats;
+			ret = server_iface->get_stats(server_iface->server,
+			    context, &stats);
+
+			ipc_call_t rcall;
+			size_t rsize;
+			if (!async_data_read_receive(&rcall, &rsize)) {
+				async_answer_0(&call, EREFUSED);
+				break;
+			}
+			if (ret != EOK || rsize != sizeof(stats)) {
+				async_answer_0(&rcall, ret != EOK ? ret : EINVAL);
+				async_answer_0(&call, ret != EOK ? ret : EINVAL);
+				break;
+			}
+			ret = async_data_read_finalize(&rcall, &stats,
+			    sizeof(stats));
+			async_answer_0(&call, ret);
+			break;
 		case IPC_M_HOUND_STREAM_EXIT:
 		case IPC_M_HOUND_STREAM_DRAIN:
+		case IPC_M_HOUND_STREAM_GET_STATS:
 			/* Stream exit/drain is only allowed in stream context*/
 			async_answer_0(&call, EINVAL);
 			break;
@@ -627,6 +707,33 @@ void hound_connection_handler(ipc_call_t *icall, void *arg)
 	}
 }
 
+/**
+ * Answer stream statistics request.
+ * @param stream Stream to query.
+ * @param call IPC_M_HOUND_STREAM_GET_STATS call.
+ */
+static void hound_server_stream_stats(void *stream, ipc_call_t *call)
+{
+	hound_stream_stats_t stats;
+	errno_t ret = ENOTSUP;
+	if (server_iface->get_stream_stats)
+		ret = server_iface->get_stream_stats(stream, &stats);
+
+	ipc_call_t rcall;
+	size_t rsize;
+	if (!async_data_read_receive(&rcall, &rsize)) {
+		async_answer_0(call, EREFUSED);
+		return;
+	}
+	if (ret != EOK || rsize != sizeof(stats)) {
+		async_answer_0(&rcall, ret != EOK ? ret : EINVAL);
+		async_answer_0(call, ret != EOK ? ret : EINVAL);
+		return;
+	}
+	ret = async_data_read_finalize(&rcall, &stats, sizeof(stats));
+	async_answer_0(call, ret);
+}
+
 /**
  * Read data and push it to the stream.
  * @param stream target stream, will push data there.
@@ -637,9 +744,15 @@ static void hound_server_read_data(void *stream)
 	size_t size = 0;
 	errno_t ret_answer = EOK;
 
-	/* accept data write or drain */
+	/* accept data write, drain or statistics request */
 	while (async_data_write_receive(&call, &size) ||
-	    (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_DRAIN)) {
+	    (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_DRAIN) ||
+	    (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_GET_STATS)) {
+		if (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_GET_STATS) {
+			hound_server_stream_stats(stream, &call);
+			continue;
+		}
+
 		/* check drain first */
 		if (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_DRAIN) {
 			errno_t ret = ENOTSUP;
@@ -684,9 +797,14 @@ static void hound_server_write_data(void *stream)
 	size_t size = 0;
 	errno_t ret_answer = EOK;
 
-	/* accept data read and drain */
+	/* accept data read, drain and statistics request */
 	while (async_data_read_receive(&call, &size) ||
-	    (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_DRAIN)) {
+	    (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_DRAIN) ||
+	    (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_GET_STATS)) {
+		if (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_GET_STATS) {
+			hound_server_stream_stats(stream, &call);
+			continue;
+		}
 		/* drain does not make much sense but it is allowed */
 		if (ipc_get_imethod(&call) == IPC_M_HOUND_STREAM_DRAIN) {
 			errno_t ret = ENOTSUP;
@@ -40,9 +40,22 @@
 #include <inet/addr.h>
 #include <inet/tcp.h>
 
+#include "parser.h"
 #include "receive-buffer.h"
 
-typedef struct {
+/** How the end of response body is determined */
+typedef enum {
+	/** Response has no body */
+	hbm_none,
+	/** Body size given by Content-Length */
+	hbm_length,
+	/** Chunked transfer coding */
+	hbm_chunked,
+	/** Body ends when server closes the connection */
+	hbm_close
+} http_body_mode_t;
+
+typedef struct http {
 	char *host;
 	uint16_t port;
 	inet_addr_t addr;
@@ -52,12 +65,28 @@ typedef struct {
 
 	size_t buffer_size;
 	receive_buffer_t recv_buffer;
+
+	/** Link to http_pool_t.idle */
+	link_t lpool;
+	/** Connection was taken from a pool */
+	bool reused;
+	/** Server permits another request on this connection */
+	bool keep_alive;
+
+	/** Head of last response (views into recv_buffer) */
+	http_head_t head;
+	/** Body of last response */
+	http_body_mode_t body_mode;
+	/** Remaining body bytes (hbm_length) */
+	uint64_t body_left;
+	/** Chunked decoder (hbm_chunked) */
+	http_chunked_t chunked;
+	/** Whole body of last response has been received */
+	bool body_done;
 } http_t;
 
-typedef struct {
-	uint8_t minor;
-	uint8_t major;
-} http_version_t;
+/** Pool of idle persistent connections */
+typedef struct http_pool http_pool_t;
 
 typedef struct {
 	link_t link;
@@ -131,9 +160,18 @@ extern errno_t http_receive_status(receive_buffer_t *, http_version_t *, uint16_
 extern errno_t http_receive_response(receive_buffer_t *, http_response_t **,
     size_t, unsigned);
 extern void http_response_destroy(http_response_t *);
+extern errno_t http_receive_head(http_t *, bool);
+extern errno_t http_receive_body(http_t *, const void **, size_t *);
 extern errno_t http_close(http_t *);
 extern void http_destroy(http_t *);
 
+extern errno_t http_pool_create(http_pool_t **);
+extern void http_pool_destroy(http_pool_t *);
+extern errno_t http_pool_get(http_pool_t *, const char *, uint16_t, http_t **);
+extern void http_pool_put(http_pool_t *, http_t *);
+extern errno_t http_pool_request(http_pool_t *, const char *, uint16_t,
+    http_request_t *, http_t **);
+
 #endif
 
 /** @}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup http
+ * @{
+ */
+/**
+ * @file
+ */
+
+#ifndef HTTP_PARSER_H_
+#define HTTP_PARSER_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of headers in a response head */
+#define HTTP_HEAD_MAX_HEADERS  64
+
+typedef struct {
+	uint8_t minor;
+	uint8_t major;
+} http_version_t;
+
+/** View of a string in a buffer (not null-terminated) */
+typedef struct {
+	const char *str;
+	size_t len;
+} http_view_t;
+
+/** Header as views into a buffer */
+typedef struct {
+	http_view_t name;
+	http_view_t value;
+} http_header_view_t;
+
+/** Response status line and headers.
+ *
+ * All strings are views into the buffer which was parsed.
+ */
+typedef struct {
+	http_version_t version;
+	uint16_t status;
+	http_view_t message;
+	http_header_view_t headers[HTTP_HEAD_MAX_HEADERS];
+	size_t nheaders;
+} http_head_t;
+
+/** Incremental response head parser */
+typedef struct {
+	/** Number of bytes already searched for end of head */
+	size_t scanned;
+} http_parser_t;
+
+typedef enum {
+	hcs_size,
+	hcs_ext,
+	hcs_size_lf,
+	hcs_data,
+	hcs_data_cr,
+	hcs_data_lf,
+	hcs_trailer,
+	hcs_done
+} http_chunked_state_t;
+
+/** Chunked transfer coding decoder */
+typedef struct {
+	http_chunked_state_t state;
+	/** Size of the current chunk / remaining bytes of chunk data */
+	size_t size;
+	/** Number of digits of chunk size read so far */
+	unsigned ndigits;
+	/** Length of current trailer line */
+	size_t tlen;
+} http_chunked_t;
+
+extern void http_parser_init(http_parser_t *);
+extern errno_t http_parse_response(http_parser_t *, const char *, size_t,
+    http_head_t *, size_t *);
+extern errno_t http_head_find(http_head_t *, const char *, http_view_t *);
+
+extern bool http_view_equal(http_view_t *, const char *);
+extern bool http_view_has_token(http_view_t *, const char *);
+extern errno_t http_view_uint64(http_view_t *, uint64_t *);
+
+extern void http_chunked_init(http_chunked_t *);
+extern errno_t http_chunked_decode(http_chunked_t *, char *, size_t, size_t *,
+    size_t *);
+
+/** Determine if chunked decoder has reached end of body.
+ *
+ * @param chunked Chunked decoder
+ * @return @c true if the last chunk and trailer have been decoded
+ */
+static inline bool http_chunked_done(http_chunked_t *chunked)
+{
+	return chunked->state == hcs_done;
+}
+
+#endif
+
+/** @}
+ */
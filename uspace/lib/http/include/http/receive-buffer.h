@@ -80,6 +80,7 @@ extern errno_t recv_cut(receive_buffer_t *, receive_buffer_mark_t *,
     receive_buffer_mark_t *, void **, size_t *);
 extern errno_t recv_cut_str(receive_buffer_t *, receive_buffer_mark_t *,
     receive_buffer_mark_t *, char **);
+extern errno_t recv_buffer_fill(receive_buffer_t *, size_t *);
 extern errno_t recv_char(receive_buffer_t *, char *, bool);
 extern errno_t recv_buffer(receive_buffer_t *, char *, size_t, size_t *);
 extern errno_t recv_discard(receive_buffer_t *, char, size_t *);
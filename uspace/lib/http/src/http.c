@@ -56,7 +56,7 @@ static errno_t http_receive(void *client_data, void *buf, size_t buf_size,
 
 http_t *http_create(const char *host, uint16_t port)
 {
-	http_t *http = malloc(sizeof(http_t));
+	http_t *http = calloc(1, sizeof(http_t));
 	if (http == NULL)
 		return NULL;
 
@@ -66,11 +66,13 @@ http_t *http_create(const char *host, uint16_t port)
 		return NULL;
 	}
 	http->port = port;
+	link_initialize(&http->lpool);
 
-	http->buffer_size = 4096;
+	http->buffer_size = 16384;
 	errno_t rc = recv_buffer_init(&http->recv_buffer, http->buffer_size,
 	    http_receive, http);
 	if (rc != EOK) {
+		free(http->host);
 		free(http);
 		return NULL;
 	}
@@ -99,14 +101,22 @@ errno_t http_connect(http_t *http)
 		return rc;
 
 	rc = tcp_conn_create(http->tcp, &epp, NULL, NULL, &http->conn);
-	if (rc != EOK)
+	if (rc != EOK) {
+		tcp_destroy(http->tcp);
+		http->tcp = NULL;
 		return rc;
+	}
 
 	rc = tcp_conn_wait_connected(http->conn);
-	if (rc != EOK)
+	if (rc != EOK) {
+		(void) http_close(http);
 		return rc;
+	}
 
-	return rc;
+	recv_reset(&http->recv_buffer);
+	http->keep_alive = false;
+	http->body_done = false;
+	return EOK;
 }
 
 errno_t http_close(http_t *http)
@@ -126,6 +136,7 @@ void http_destroy(http_t *http)
 {
 	(void) http_close(http);
 	recv_buffer_fini(&http->recv_buffer);
+	free(http->host);
 	free(http);
 }
 
@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup http
+ * @{
+ */
+/**
+ * @file Response parser working directly on the receive buffer.
+ *
+ * The parser does not allocate memory nor copy data. Status message,
+ * header names and values are returned as views into the parsed buffer.
+ */
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <macros.h>
+#include <mem.h>
+#include <str.h>
+
+#include <http/ctype.h>
+#include <http/parser.h>
+
+/** Initialize response head parser.
+ *
+ * @param parser Parser
+ */
+void http_parser_init(http_parser_t *parser)
+{
+	parser->scanned = 0;
+}
+
+/** Find end of line.
+ *
+ * @param p   Start of line
+ * @param end End of data
+ * @param leol Place to store length of line terminator (1 or 2)
+ * @return Pointer to end of line contents
+ */
+static const char *http_line_end(const char *p, const char *end,
+    size_t *leol)
+{
+	const char *nl;
+
+	nl = memchr(p, '\n', end - p);
+	assert(nl != NULL);
+
+	if (nl > p && nl[-1] == '\r') {
+		*leol = 2;
+		return nl - 1;
+	}
+
+	*leol = 1;
+	return nl;
+}
+
+/** Trim trailing whitespace from view. */
+static void http_view_rtrim(http_view_t *view)
+{
+	while (view->len > 0 && (view->str[view->len - 1] == ' ' ||
+	    view->str[view->len - 1] == '\t'))
+		--view->len;
+}
+
+/** Parse decimal number of at most @a maxd digits. */
+static errno_t http_parse_digits(const char **pp, const char *end,
+    unsigned maxd, unsigned *rval)
+{
+	const char *p = *pp;
+	unsigned val = 0;
+	unsigned nd = 0;
+
+	while (p < end && isdigit(*p) && nd < maxd) {
+		val = val * 10 + (*p - '0');
+		++p;
+		++nd;
+	}
+
+	if (nd == 0)
+		return HTTP_EPARSE;
+
+	*pp = p;
+	*rval = val;
+	return EOK;
+}
+
+/** Parse status line.
+ *
+ * @param p    Start of line
+ * @param eol  End of line contents
+ * @param head Response head to fill in
+ */
+static errno_t http_parse_status(const char *p, const char *eol,
+    http_head_t *head)
+{
+	unsigned major, minor, status;
+	errno_t rc;
+
+	if (eol - p < 5 || memcmp(p, "HTTP/", 5) != 0)
+		return HTTP_EPARSE;
+	p += 5;
+
+	rc = http_parse_digits(&p, eol, 3, &major);
+	if (rc != EOK)
+		return rc;
+
+	if (p >= eol || *p != '.')
+		return HTTP_EPARSE;
+	++p;
+
+	rc = http_parse_digits(&p, eol, 3, &minor);
+	if (rc != EOK)
+		return rc;
+
+	if (p >= eol || *p != ' ')
+		return HTTP_EPARSE;
+	++p;
+
+	rc = http_parse_digits(&p, eol, 3, &status);
+	if (rc != EOK)
+		return rc;
+
+	if (major > UINT8_MAX || minor > UINT8_MAX || status < 100)
+		return HTTP_EPARSE;
+
+	/* Reason phrase may be empty, even the space may be missing */
+	if (p < eol) {
+		if (*p != ' ')
+			return HTTP_EPARSE;
+		++p;
+	}
+
+	head->version.major = major;
+	head->version.minor = minor;
+	head->status = status;
+	head->message.str = p;
+	head->message.len = eol - p;
+	return EOK;
+}
+
+/** Parse header line.
+ *
+ * @param p    Start of line
+ * @param eol  End of line contents
+ * @param head Response head to add header to
+ */
+static errno_t http_parse_header(const char *p, const char *eol,
+    http_head_t *head)
+{
+	http_header_view_t *hdr;
+	const char *colon;
+
+	/* Obsolete line folding continues value of previous header */
+	if (*p == ' ' || *p == '\t') {
+		if (head->nheaders == 0)
+			return HTTP_EPARSE;
+
+		hdr = &head->headers[head->nheaders - 1];
+		hdr->value.len = eol - hdr->value.str;
+		http_view_rtrim(&hdr->value);
+		return EOK;
+	}
+
+	colon = p;
+	while (colon < eol && is_token(*colon))
+		++colon;
+
+	if (colon == p || colon >= eol || *colon != ':')
+		return HTTP_EPARSE;
+
+	if (head->nheaders >= HTTP_HEAD_MAX_HEADERS)
+		return ELIMIT;
+
+	hdr = &head->headers[head->nheaders++];
+	hdr->name.str = p;
+	hdr->name.len = colon - p;
+
+	p = colon + 1;
+	while (p < eol && (*p == ' ' || *p == '\t'))
+		++p;
+
+	hdr->value.str = p;
+	hdr->value.len = eol - p;
+	http_view_rtrim(&hdr->value);
+	return EOK;
+}
+
+/** Parse response head.
+ *
+ * The parser can be called repeatedly as more data arrives, each time
+ * with all data received since the start of the response. Data which
+ * was already searched for end of head is not searched again.
+ *
+ * @param parser    Parser
+ * @param buf       Received data, starting with the status line
+ * @param size      Size of received data
+ * @param head      Response head to fill in, strings point to @a buf
+ * @param rconsumed Place to store size of the head (including the empty
+ *                  line terminating it)
+ * @return EOK on success, EAGAIN if the head is not complete yet,
+ *         HTTP_EPARSE if the head is malformed, ELIMIT if there are
+ *         too many headers
+ */
+errno_t http_parse_response(http_parser_t *parser, const char *buf,
+    size_t size, http_head_t *head, size_t *rconsumed)
+{
+	const char *end = buf + size;
+	const char *p;
+	const char *nl;
+	const char *eol;
+	size_t leol;
+	errno_t rc;
+
+	/* Find the empty line terminating the head */
+	p = buf + parser->scanned;
+	while (true) {
+		nl = memchr(p, '\n', end - p);
+		if (nl == NULL) {
+			parser->scanned = size;
+			return EAGAIN;
+		}
+
+		/* Need to see what follows the line break */
+		if (nl + 1 >= end)
+			break;
+
+		if (nl[1] == '\n') {
+			end = nl + 2;
+			goto found;
+		}
+
+		if (nl[1] == '\r') {
+			if (nl + 2 >= end)
+				break;
+			if (nl[2] == '\n') {
+				end = nl + 3;
+				goto found;
+			}
+		}
+
+		p = nl + 1;
+	}
+
+	parser->scanned = nl - buf;
+	return EAGAIN;
+found:
+	/* Parse complete head in one pass */
+	head->nheaders = 0;
+
+	p = buf;
+	eol = http_line_end(p, end, &leol);
+	rc = http_parse_status(p, eol, head);
+	if (rc != EOK)
+		return rc;
+	p = eol + leol;
+
+	while (true) {
+		eol = http_line_end(p, end, &leol);
+		if (eol == p)
+			break;
+
+		rc = http_parse_header(p, eol, head);
+		if (rc != EOK)
+			return rc;
+
+		p = eol + leol;
+	}
+
+	*rconsumed = end - buf;
+	return EOK;
+}
+
+/** Compare view with string, ignoring case.
+ *
+ * @param view View
+ * @param str  String
+ * @return @c true if equal
+ */
+bool http_view_equal(http_view_t *view, const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < view->len; i++) {
+		if (str[i] == '\0' ||
+		    tolower((unsigned char) view->str[i]) !=
+		    tolower((unsigned char) str[i]))
+			return false;
+	}
+
+	return str[i] == '\0';
+}
+
+/** Determine if comma-separated list contains token, ignoring case.
+ *
+ * @param view  Header value
+ * @param token Token to look for
+ * @return @c true if @a token is in the list
+ */
+bool http_view_has_token(http_view_t *view, const char *token)
+{
+	const char *p = view->str;
+	const char *end = view->str + view->len;
+	http_view_t elem;
+
+	while (p < end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+			++p;
+
+		elem.str = p;
+		while (p < end && *p != ',')
+			++p;
+
+		elem.len = p - elem.str;
+		http_view_rtrim(&elem);
+		if (elem.len > 0 && http_view_equal(&elem, token))
+			return true;
+	}
+
+	return false;
+}
+
+/** Convert view to decimal number.
+ *
+ * @param view View
+ * @param rval Place to store value
+ * @return EOK on success, HTTP_EPARSE if not a number, EOVERFLOW on
+ *         overflow
+ */
+errno_t http_view_uint64(http_view_t *view, uint64_t *rval)
+{
+	uint64_t val = 0;
+	size_t i;
+
+	if (view->len == 0)
+		return HTTP_EPARSE;
+
+	for (i = 0; i < view->len; i++) {
+		if (!isdigit(view->str[i]))
+			return HTTP_EPARSE;
+
+		if (val > (UINT64_MAX - 9) / 10)
+			return EOVERFLOW;
+
+		val = val * 10 + (view->str[i] - '0');
+	}
+
+	*rval = val;
+	return EOK;
+}
+
+/** Find header in response head.
+ *
+ * @param head  Response head
+ * @param name  Header name (compared case-insensitively)
+ * @param value Place to store value of the first matching header
+ * @return EOK on success, HTTP_EMISSING_HEADER if not found
+ */
+errno_t http_head_find(http_head_t *head, const char *name, http_view_t *value)
+{
+	size_t i;
+
+	for (i = 0; i < head->nheaders; i++) {
+		if (http_view_equal(&head->headers[i].name, name)) {
+			*value = head->headers[i].value;
+			return EOK;
+		}
+	}
+
+	return HTTP_EMISSING_HEADER;
+}
+
+/** Initialize chunked transfer coding decoder.
+ *
+ * @param chunked Decoder
+ */
+void http_chunked_init(http_chunked_t *chunked)
+{
+	chunked->state = hcs_size;
+	chunked->size = 0;
+	chunked->ndigits = 0;
+	chunked->tlen = 0;
+}
+
+/** Get value of hexadecimal digit or -1. */
+static int http_xdigit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/** Decode chunked transfer coding in place.
+ *
+ * Chunk data contained in @a buf is moved to the start of @a buf and
+ * chunk framing is removed. Framing can be split at any point between
+ * calls. All of @a buf is consumed unless the end of body is reached.
+ *
+ * @param chunked   Decoder
+ * @param buf       Received data
+ * @param size      Size of received data
+ * @param rdecoded  Place to store number of decoded data bytes at the
+ *                  start of @a buf
+ * @param rconsumed Place to store number of bytes of @a buf consumed
+ * @return EOK on success, HTTP_EPARSE if the coding is malformed
+ */
+errno_t http_chunked_decode(http_chunked_t *chunked, char *buf, size_t size,
+    size_t *rdecoded, size_t *rconsumed)
+{
+	size_t in = 0;
+	size_t out = 0;
+	size_t n;
+	int d;
+	char c;
+
+	while (in < size && chunked->state != hcs_done) {
+		if (chunked->state == hcs_data) {
+			n = min(chunked->size, size - in);
+			if (out != in)
+				memmove(buf + out, buf + in, n);
+			in += n;
+			out += n;
+			chunked->size -= n;
+			if (chunked->size == 0)
+				chunked->state = hcs_data_cr;
+			continue;
+		}
+
+		c = buf[in++];
+
+		switch (chunked->state) {
+		case hcs_size:
+			d = http_xdigit(c);
+			if (d >= 0) {
+				if (chunked->size > (SIZE_MAX >> 4))
+					return HTTP_EPARSE;
+				chunked->size = (chunked->size << 4) | d;
+				++chunked->ndigits;
+				break;
+			}
+
+			if (chunked->ndigits == 0)
+				return HTTP_EPARSE;
+
+			if (c == ';' || c == ' ' || c == '\t')
+				chunked->state = hcs_ext;
+			else if (c == '\r')
+				chunked->state = hcs_size_lf;
+			else if (c == '\n')
+				goto size_done;
+			else
+				return HTTP_EPARSE;
+			break;
+		case hcs_ext:
+			/* Ignore chunk extensions */
+			if (c == '\n')
+				goto size_done;
+			break;
+		case hcs_size_lf:
+			if (c != '\n')
+				return HTTP_EPARSE;
+size_done:
+			chunked->ndigits = 0;
+			if (chunked->size == 0) {
+				/* Last chunk, trailer follows */
+				chunked->tlen = 0;
+				chunked->state = hcs_trailer;
+			} else {
+				chunked->state = hcs_data;
+			}
+			break;
+		case hcs_data_cr:
+			if (c == '\r')
+				chunked->state = hcs_data_lf;
+			else if (c == '\n')
+				chunked->state = hcs_size;
+			else
+				return HTTP_EPARSE;
+			break;
+		case hcs_data_lf:
+			if (c != '\n')
+				return HTTP_EPARSE;
+			chunked->state = hcs_size;
+			break;
+		case hcs_trailer:
+			/* Trailer fields are ignored, empty line ends body */
+			if (c == '\n') {
+				if (chunked->tlen == 0)
+					chunked->state = hcs_done;
+				chunked->tlen = 0;
+			} else if (c != '\r') {
+				++chunked->tlen;
+			}
+			break;
+		case hcs_data:
+		case hcs_done:
+			assert(false);
+			break;
+		}
+	}
+
+	*rdecoded = out;
+	*rconsumed = in;
+	return EOK;
+}
+
+/** @}
+ */
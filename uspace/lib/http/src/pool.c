@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup http
+ * @{
+ */
+/**
+ * @file Pool of persistent client connections.
+ *
+ * Connections whose last response was received completely and which
+ * the server agreed to keep open are kept in the pool and reused for
+ * subsequent requests to the same host and port.
+ */
+
+#include <adt/list.h>
+#include <errno.h>
+#include <fibril_synch.h>
+#include <stdlib.h>
+#include <str.h>
+
+#include <http/http.h>
+
+/** Maximum number of idle connections kept in a pool */
+#define HTTP_POOL_MAX_IDLE 8
+
+struct http_pool {
+	/** Protects idle list */
+	fibril_mutex_t lock;
+	/** Idle connections, most recently used first */
+	list_t idle;
+	/** Number of entries in @c idle */
+	size_t nidle;
+};
+
+/** Create connection pool.
+ *
+ * @param rpool Place to store pointer to new pool
+ * @return EOK on success, ENOMEM if out of memory
+ */
+errno_t http_pool_create(http_pool_t **rpool)
+{
+	http_pool_t *pool;
+
+	pool = calloc(1, sizeof(http_pool_t));
+	if (pool == NULL)
+		return ENOMEM;
+
+	fibril_mutex_initialize(&pool->lock);
+	list_initialize(&pool->idle);
+	*rpool = pool;
+	return EOK;
+}
+
+/** Destroy connection pool, closing all idle connections.
+ *
+ * @param pool Connection pool or @c NULL
+ */
+void http_pool_destroy(http_pool_t *pool)
+{
+	http_t *http;
+
+	if (pool == NULL)
+		return;
+
+	while (!list_empty(&pool->idle)) {
+		http = list_get_instance(list_first(&pool->idle), http_t,
+		    lpool);
+		list_remove(&http->lpool);
+		http_destroy(http);
+	}
+
+	free(pool);
+}
+
+/** Create and connect a new connection. */
+static errno_t http_pool_connect(const char *host, uint16_t port,
+    http_t **rhttp)
+{
+	http_t *http;
+	errno_t rc;
+
+	http = http_create(host, port);
+	if (http == NULL)
+		return ENOMEM;
+
+	rc = http_connect(http);
+	if (rc != EOK) {
+		http_destroy(http);
+		return rc;
+	}
+
+	http->reused = false;
+	*rhttp = http;
+	return EOK;
+}
+
+/** Get connection to host from pool.
+ *
+ * An idle connection to the same host and port is reused if available,
+ * otherwise a new connection is established.
+ *
+ * @param pool  Connection pool
+ * @param host  Host name
+ * @param port  Port number
+ * @param rhttp Place to store pointer to connection
+ * @return EOK on success or an error code
+ */
+errno_t http_pool_get(http_pool_t *pool, const char *host, uint16_t port,
+    http_t **rhttp)
+{
+	fibril_mutex_lock(&pool->lock);
+
+	list_foreach(pool->idle, lpool, http_t, http) {
+		if (http->port == port && str_casecmp(http->host, host) == 0) {
+			list_remove(&http->lpool);
+			--pool->nidle;
+			fibril_mutex_unlock(&pool->lock);
+
+			http->reused = true;
+			*rhttp = http;
+			return EOK;
+		}
+	}
+
+	fibril_mutex_unlock(&pool->lock);
+	return http_pool_connect(host, port, rhttp);
+}
+
+/** Return connection to pool.
+ *
+ * The connection is kept for reuse only if the server permits it and
+ * the whole response body has been received. Otherwise it is closed.
+ * If the pool is full, the least recently used connection is closed.
+ *
+ * @param pool Connection pool
+ * @param http Connection
+ */
+void http_pool_put(http_pool_t *pool, http_t *http)
+{
+	http_t *old = NULL;
+
+	if (http->conn == NULL || !http->keep_alive || !http->body_done) {
+		http_destroy(http);
+		return;
+	}
+
+	fibril_mutex_lock(&pool->lock);
+
+	if (pool->nidle >= HTTP_POOL_MAX_IDLE) {
+		old = list_get_instance(list_last(&pool->idle), http_t,
+		    lpool);
+		list_remove(&old->lpool);
+		--pool->nidle;
+	}
+
+	list_prepend(&http->lpool, &pool->idle);
+	++pool->nidle;
+
+	fibril_mutex_unlock(&pool->lock);
+
+	if (old != NULL)
+		http_destroy(old);
+}
+
+/** Send request and receive response head using a pooled connection.
+ *
+ * If sending the request or receiving the head fails on a reused
+ * connection (the server may have closed it while idle), an idempotent
+ * request is retried once on a new connection.
+ *
+ * @param pool  Connection pool
+ * @param host  Host name
+ * @param port  Port number
+ * @param req   Request
+ * @param rhttp Place to store pointer to connection. The response head
+ *              is in @c http->head, the body is read using
+ *              http_receive_body(). Return the connection using
+ *              http_pool_put().
+ * @return EOK on success or an error code
+ */
+errno_t http_pool_request(http_pool_t *pool, const char *host, uint16_t port,
+    http_request_t *req, http_t **rhttp)
+{
+	bool head_request;
+	bool idempotent;
+	http_t *http;
+	errno_t rc;
+
+	head_request = str_cmp(req->method, "HEAD") == 0;
+	idempotent = head_request || str_cmp(req->method, "GET") == 0;
+
+	rc = http_pool_get(pool, host, port, &http);
+	if (rc != EOK)
+		return rc;
+
+	rc = http_send_request(http, req);
+	if (rc == EOK)
+		rc = http_receive_head(http, head_request);
+
+	if (rc != EOK && http->reused && idempotent) {
+		http_destroy(http);
+
+		rc = http_pool_connect(host, port, &http);
+		if (rc != EOK)
+			return rc;
+
+		rc = http_send_request(http, req);
+		if (rc == EOK)
+			rc = http_receive_head(http, head_request);
+	}
+
+	if (rc != EOK) {
+		http_destroy(http);
+		return rc;
+	}
+
+	*rhttp = http;
+	return EOK;
+}
+
+/** @}
+ */
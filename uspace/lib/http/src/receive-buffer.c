@@ -144,35 +144,64 @@ errno_t recv_cut_str(receive_buffer_t *rb, receive_buffer_mark_t *a, receive_buf
 	return EOK;
 }
 
+/** Receive more data into the buffer.
+ *
+ * Received data is appended after any unconsumed data. The buffer is
+ * only compacted when there is no free space left at its end, and never
+ * past the lowest mark.
+ *
+ * @param rb Receive buffer
+ * @param nrecv Place to store number of bytes received (zero on end
+ *              of stream)
+ * @return EOK on success, ELIMIT if the buffer is full and cannot be
+ *         compacted or an error code
+ */
+errno_t recv_buffer_fill(receive_buffer_t *rb, size_t *nrecv)
+{
+	if (rb->out == rb->in && list_empty(&rb->marks)) {
+		/* Nothing to keep, start from the beginning */
+		rb->in = rb->out = 0;
+	}
+
+	size_t free = rb->size - rb->in;
+	if (free == 0) {
+		size_t min_mark = rb->out;
+		list_foreach(rb->marks, link, receive_buffer_mark_t, mark) {
+			min_mark = min(min_mark, mark->offset);
+		}
+
+		if (min_mark == 0)
+			return ELIMIT;
+
+		memmove(rb->buffer, rb->buffer + min_mark, rb->in - min_mark);
+		rb->in -= min_mark;
+		rb->out -= min_mark;
+		free = rb->size - rb->in;
+		list_foreach(rb->marks, link, receive_buffer_mark_t, mark) {
+			mark->offset -= min_mark;
+		}
+	}
+
+	errno_t rc = rb->receive(rb->client_data, rb->buffer + rb->in, free,
+	    nrecv);
+	if (rc != EOK)
+		return rc;
+
+	rb->in += *nrecv;
+	return EOK;
+}
+
 /** Receive one character (with buffering) */
 errno_t recv_char(receive_buffer_t *rb, char *c, bool consume)
 {
 	if (rb->out == rb->in) {
-		size_t free = rb->size - rb->in;
-		if (free == 0) {
-			size_t min_mark = rb->size;
-			list_foreach(rb->marks, link, receive_buffer_mark_t, mark) {
-				min_mark = min(min_mark, mark->offset);
-			}
-
-			if (min_mark == 0)
-				return ELIMIT;
-
-			size_t new_in = rb->in - min_mark;
-			memmove(rb->buffer, rb->buffer + min_mark, new_in);
-			rb->out = rb->in = new_in;
-			free = rb->size - rb->in;
-			list_foreach(rb->marks, link, receive_buffer_mark_t, mark) {
-				mark->offset -= min_mark;
-			}
-		}
-
 		size_t nrecv;
-		errno_t rc = rb->receive(rb->client_data, rb->buffer + rb->in, free, &nrecv);
+		errno_t rc = recv_buffer_fill(rb, &nrecv);
 		if (rc != EOK)
 			return rc;
 
-		rb->in = nrecv;
+		if (nrecv == 0)
+			return EIO;
 	}
 
 	*c = rb->buffer[rb->out];
@@ -220,6 +220,199 @@ error:
 	return rc;
 }
 
+/** Determine how the body of the received response is delimited. */
+static errno_t http_head_body_mode(http_t *http, bool head_request)
+{
+	http_head_t *head = &http->head;
+	http_view_t value;
+	uint64_t length;
+	errno_t rc;
+
+	http->body_left = 0;
+
+	if (head_request || head->status / 100 == 1 || head->status == 204 ||
+	    head->status == 304) {
+		http->body_mode = hbm_none;
+		return EOK;
+	}
+
+	rc = http_head_find(head, "Transfer-Encoding", &value);
+	if (rc == EOK && http_view_has_token(&value, "chunked")) {
+		http->body_mode = hbm_chunked;
+		http_chunked_init(&http->chunked);
+		return EOK;
+	}
+
+	rc = http_head_find(head, "Content-Length", &value);
+	if (rc == EOK) {
+		rc = http_view_uint64(&value, &length);
+		if (rc != EOK)
+			return HTTP_EPARSE;
+
+		http->body_mode = hbm_length;
+		http->body_left = length;
+		return EOK;
+	}
+
+	http->body_mode = hbm_close;
+	return EOK;
+}
+
+/** Receive response head.
+ *
+ * The head is parsed directly in the receive buffer, @c http->head
+ * contains views into it which remain valid until the body is received
+ * or another response is received. Interim (1xx) responses other than
+ * 101 Switching Protocols are skipped.
+ *
+ * @param http HTTP connection
+ * @param head_request @c true if the request was HEAD (response has no body)
+ * @return EOK on success, EIO if the connection was closed before the
+ *         head was complete, HTTP_EPARSE if the head is malformed or an
+ *         error code
+ */
+errno_t http_receive_head(http_t *http, bool head_request)
+{
+	receive_buffer_t *rb = &http->recv_buffer;
+	http_head_t *head = &http->head;
+	http_parser_t parser;
+	http_view_t value;
+	size_t consumed;
+	size_t nrecv;
+	bool found;
+	errno_t rc;
+
+	http->keep_alive = false;
+	http->body_done = false;
+
+	while (true) {
+		http_parser_init(&parser);
+
+		while (true) {
+			rc = http_parse_response(&parser, rb->buffer + rb->out,
+			    rb->in - rb->out, head, &consumed);
+			if (rc != EAGAIN)
+				break;
+
+			rc = recv_buffer_fill(rb, &nrecv);
+			if (rc != EOK)
+				return rc;
+			if (nrecv == 0)
+				return EIO;
+		}
+
+		if (rc != EOK)
+			return rc;
+
+		rb->out += consumed;
+
+		if (head->status / 100 != 1 || head->status == 101)
+			break;
+	}
+
+	rc = http_head_body_mode(http, head_request);
+	if (rc != EOK)
+		return rc;
+
+	found = http_head_find(head, "Connection", &value) == EOK;
+	if (head->version.major > 1 ||
+	    (head->version.major == 1 && head->version.minor >= 1))
+		http->keep_alive = !(found && http_view_has_token(&value, "close"));
+	else
+		http->keep_alive = found && http_view_has_token(&value, "keep-alive");
+
+	if (http->body_mode == hbm_close)
+		http->keep_alive = false;
+
+	if (http->body_mode == hbm_none ||
+	    (http->body_mode == hbm_length && http->body_left == 0))
+		http->body_done = true;
+
+	return EOK;
+}
+
+/** Receive part of response body.
+ *
+ * Data is returned as a view into the receive buffer, valid until the
+ * next call. Chunked transfer coding is removed in place.
+ *
+ * @param http HTTP connection
+ * @param data Place to store pointer to body data
+ * @param size Place to store size of body data, zero at end of body
+ * @return EOK on success, EIO if the connection was closed before the
+ *         end of body, HTTP_EPARSE on malformed chunked coding or an
+ *         error code
+ */
+errno_t http_receive_body(http_t *http, const void **data, size_t *size)
+{
+	receive_buffer_t *rb = &http->recv_buffer;
+	size_t decoded;
+	size_t consumed;
+	size_t nrecv;
+	size_t avail;
+	char *p;
+	errno_t rc;
+
+	while (!http->body_done) {
+		if (rb->out == rb->in) {
+			rc = recv_buffer_fill(rb, &nrecv);
+			if (rc != EOK)
+				return rc;
+
+			if (nrecv == 0) {
+				if (http->body_mode != hbm_close)
+					return EIO;
+
+				http->body_done = true;
+				break;
+			}
+		}
+
+		p = rb->buffer + rb->out;
+		avail = rb->in - rb->out;
+
+		switch (http->body_mode) {
+		case hbm_length:
+			avail = min(avail, http->body_left);
+			http->body_left -= avail;
+			if (http->body_left == 0)
+				http->body_done = true;
+			rb->out += avail;
+			*data = p;
+			*size = avail;
+			return EOK;
+		case hbm_close:
+			rb->out += avail;
+			*data = p;
+			*size = avail;
+			return EOK;
+		case hbm_chunked:
+			rc = http_chunked_decode(&http->chunked, p, avail,
+			    &decoded, &consumed);
+			if (rc != EOK)
+				return rc;
+
+			rb->out += consumed;
+			if (http_chunked_done(&http->chunked))
+				http->body_done = true;
+
+			if (decoded > 0) {
+				*data = p;
+				*size = decoded;
+				return EOK;
+			}
+			break;
+		case hbm_none:
+			http->body_done = true;
+			break;
+		}
+	}
+
+	*data = NULL;
+	*size = 0;
+	return EOK;
+}
+
 void http_response_destroy(http_response_t *resp)
 {
 	free(resp->message);
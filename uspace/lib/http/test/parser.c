@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <http/parser.h>
+#include <macros.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <str.h>
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(parser);
+
+/** Response head, followed by the start of the body */
+#define TEST_HEAD \
+	"HTTP/1.1 200 OK\r\n" \
+	"Content-Type: text/plain\r\n" \
+	"Transfer-Encoding:  chunked \t\r\n" \
+	"Connection: keep-alive\r\n" \
+	"\r\n"
+#define TEST_RESP TEST_HEAD "5\r\nHello"
+
+/** Chunked body with an extension and a trailer */
+#define TEST_BODY \
+	"5\r\nHello\r\n" \
+	"7;ext=1\r\n, world\r\n" \
+	"1a\r\nabcdefghijklmnopqrstuvwxyz\r\n" \
+	"0\r\n" \
+	"Trailer: x\r\n" \
+	"\r\n"
+/** Start of next response on the same connection */
+#define TEST_NEXT "HTTP/1.1 204 No Content\r\n"
+#define TEST_DECODED "Hello, worldabcdefghijklmnopqrstuvwxyz"
+
+static const char test_resp[] = TEST_RESP;
+static const char test_chunked[] = TEST_BODY TEST_NEXT;
+
+enum {
+	test_head_size = sizeof(TEST_HEAD) - 1,
+	test_resp_size = sizeof(TEST_RESP) - 1,
+	test_body_size = sizeof(TEST_BODY) - 1,
+	test_chunked_size = sizeof(TEST_BODY TEST_NEXT) - 1,
+	test_decoded_size = sizeof(TEST_DECODED) - 1
+};
+
+static const size_t one_byte[] = { 1 };
+static const size_t arbitrary[] = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3 };
+
+/** Check the parsed test response head. */
+static void test_check_head(http_head_t *head)
+{
+	http_view_t value;
+	errno_t rc;
+
+	PCUT_ASSERT_INT_EQUALS(1, head->version.major);
+	PCUT_ASSERT_INT_EQUALS(1, head->version.minor);
+	PCUT_ASSERT_INT_EQUALS(200, head->status);
+	PCUT_ASSERT_TRUE(http_view_equal(&head->message, "OK"));
+	PCUT_ASSERT_INT_EQUALS(3, head->nheaders);
+
+	rc = http_head_find(head, "content-type", &value);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(http_view_equal(&value, "text/plain"));
+
+	/* Surrounding whitespace is not part of the value */
+	rc = http_head_find(head, "Transfer-Encoding", &value);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(http_view_equal(&value, "chunked"));
+
+	rc = http_head_find(head, "Content-Length", &value);
+	PCUT_ASSERT_ERRNO_VAL(HTTP_EMISSING_HEADER, rc);
+}
+
+/** Parse test response received in pieces of the given sizes.
+ *
+ * The parser is called again with all data received so far after each
+ * piece, as the receive buffer does.
+ *
+ * @param pieces  Piece sizes, used cyclically
+ * @param npieces Number of entries in @a pieces
+ */
+static void test_parse_pieces(const size_t *pieces, size_t npieces)
+{
+	http_parser_t parser;
+	http_head_t head;
+	size_t size;
+	size_t consumed;
+	size_t i;
+	errno_t rc;
+
+	http_parser_init(&parser);
+	size = 0;
+	i = 0;
+
+	while (true) {
+		size = min(size + pieces[i++ % npieces], (size_t) test_resp_size);
+		rc = http_parse_response(&parser, test_resp, size, &head,
+		    &consumed);
+		if (size < test_head_size) {
+			PCUT_ASSERT_ERRNO_VAL(EAGAIN, rc);
+			PCUT_ASSERT_TRUE(parser.scanned <= size);
+			continue;
+		}
+
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		break;
+	}
+
+	/* Body data following the head is not consumed */
+	PCUT_ASSERT_INT_EQUALS(test_head_size, consumed);
+	test_check_head(&head);
+}
+
+/** Decode test body received in pieces of the given sizes.
+ *
+ * Each piece is decoded in place in a separate buffer, as it would be
+ * in the receive buffer.
+ *
+ * @param pieces  Piece sizes, used cyclically
+ * @param npieces Number of entries in @a pieces
+ */
+static void test_chunked_pieces(const size_t *pieces, size_t npieces)
+{
+	http_chunked_t chunked;
+	char buf[test_chunked_size];
+	char out[test_decoded_size];
+	size_t pos;
+	size_t outlen;
+	size_t n;
+	size_t decoded;
+	size_t consumed;
+	size_t i;
+	errno_t rc;
+
+	http_chunked_init(&chunked);
+	pos = 0;
+	outlen = 0;
+	i = 0;
+
+	while (!http_chunked_done(&chunked)) {
+		PCUT_ASSERT_TRUE(pos < test_chunked_size);
+
+		n = min(pieces[i++ % npieces], test_chunked_size - pos);
+		memcpy(buf, test_chunked + pos, n);
+
+		rc = http_chunked_decode(&chunked, buf, n, &decoded, &consumed);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		PCUT_ASSERT_TRUE(decoded <= consumed);
+		PCUT_ASSERT_TRUE(outlen + decoded <= test_decoded_size);
+
+		/* Whole piece is consumed unless the body ends in it */
+		if (!http_chunked_done(&chunked))
+			PCUT_ASSERT_INT_EQUALS(n, consumed);
+
+		memcpy(out + outlen, buf, decoded);
+		outlen += decoded;
+		pos += consumed;
+	}
+
+	/* The next response is left in the buffer */
+	PCUT_ASSERT_INT_EQUALS(test_body_size, pos);
+	PCUT_ASSERT_INT_EQUALS(test_decoded_size, outlen);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(out, TEST_DECODED, outlen));
+}
+
+/** Decode test body split into two pieces at @a cut. */
+static void test_chunked_cut(size_t cut)
+{
+	size_t pieces[2];
+
+	pieces[0] = cut;
+	pieces[1] = test_chunked_size;
+	test_chunked_pieces(pieces, 2);
+}
+
+/** Get offset of @a str in the test body plus @a delta. */
+static size_t test_body_off(const char *str, size_t delta)
+{
+	const char *p;
+
+	p = str_str(test_chunked, str);
+	PCUT_ASSERT_NOT_NULL(p);
+	return (p - test_chunked) + delta;
+}
+
+/** Response head in one piece */
+PCUT_TEST(response_whole)
+{
+	const size_t whole[] = { test_resp_size };
+
+	test_parse_pieces(whole, 1);
+}
+
+/** Response head received one byte at a time */
+PCUT_TEST(response_one_byte)
+{
+	test_parse_pieces(one_byte, 1);
+}
+
+/** Response head received in pieces of arbitrary sizes */
+PCUT_TEST(response_arbitrary)
+{
+	size_t size;
+
+	test_parse_pieces(arbitrary, sizeof(arbitrary) / sizeof(arbitrary[0]));
+
+	for (size = 2; size < test_resp_size; size++)
+		test_parse_pieces(&size, 1);
+}
+
+/** Searching resumes where it stopped, also within the final CRLF CRLF */
+PCUT_TEST(response_resume)
+{
+	http_parser_t parser;
+	http_head_t head;
+	size_t consumed;
+	size_t cut;
+	errno_t rc;
+
+	for (cut = 1; cut < test_head_size; cut++) {
+		http_parser_init(&parser);
+
+		rc = http_parse_response(&parser, test_resp, cut, &head,
+		    &consumed);
+		PCUT_ASSERT_ERRNO_VAL(EAGAIN, rc);
+		PCUT_ASSERT_TRUE(parser.scanned <= cut);
+
+		/* Data up to the last line break need not be searched again */
+		if (cut > sizeof("HTTP/1.1 200 OK\r\n"))
+			PCUT_ASSERT_TRUE(parser.scanned > 0);
+
+		rc = http_parse_response(&parser, test_resp, test_resp_size,
+		    &head, &consumed);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		PCUT_ASSERT_INT_EQUALS(test_head_size, consumed);
+		test_check_head(&head);
+	}
+}
+
+/** Head using bare LF line terminators */
+PCUT_TEST(response_bare_lf)
+{
+	const char *resp = "HTTP/1.0 404 Not Found\nServer: test\n\nbody";
+	http_parser_t parser;
+	http_head_t head;
+	http_view_t value;
+	size_t consumed;
+	size_t size;
+	errno_t rc;
+
+	http_parser_init(&parser);
+	for (size = 1; size < str_size(resp); size++) {
+		rc = http_parse_response(&parser, resp, size, &head, &consumed);
+		if (rc != EAGAIN)
+			break;
+	}
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(str_size(resp) - 4, size);
+	PCUT_ASSERT_INT_EQUALS(size, consumed);
+	PCUT_ASSERT_INT_EQUALS(0, head.version.minor);
+	PCUT_ASSERT_INT_EQUALS(404, head.status);
+	PCUT_ASSERT_TRUE(http_view_equal(&head.message, "Not Found"));
+
+	rc = http_head_find(&head, "server", &value);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(http_view_equal(&value, "test"));
+}
+
+/** Malformed status line */
+PCUT_TEST(response_malformed)
+{
+	const char *resp = "HTTP/1.1 OK\r\n\r\n";
+	http_parser_t parser;
+	http_head_t head;
+	size_t consumed;
+	errno_t rc;
+
+	http_parser_init(&parser);
+	rc = http_parse_response(&parser, resp, str_size(resp), &head,
+	    &consumed);
+	PCUT_ASSERT_ERRNO_VAL(HTTP_EPARSE, rc);
+}
+
+/** Chunked body in one piece */
+PCUT_TEST(chunked_whole)
+{
+	test_chunked_cut(test_chunked_size);
+}
+
+/** Chunked body received one byte at a time */
+PCUT_TEST(chunked_one_byte)
+{
+	test_chunked_pieces(one_byte, 1);
+}
+
+/** Chunked body received in pieces of arbitrary sizes */
+PCUT_TEST(chunked_arbitrary)
+{
+	size_t size;
+
+	test_chunked_pieces(arbitrary, sizeof(arbitrary) / sizeof(arbitrary[0]));
+
+	for (size = 2; size < test_chunked_size; size++)
+		test_chunked_pieces(&size, 1);
+}
+
+/** Chunked body split mid-size-line, mid-CRLF and mid-trailer */
+PCUT_TEST(chunked_split)
+{
+	size_t cut;
+
+	/* Between digits of chunk size */
+	test_chunked_cut(test_body_off("1a\r\n", 1));
+	/* Within chunk extension */
+	test_chunked_cut(test_body_off(";ext", 2));
+	/* Between CR and LF after chunk size */
+	test_chunked_cut(test_body_off("7;ext=1\r\n", 8));
+	/* Between CR and LF after chunk data */
+	test_chunked_cut(test_body_off("Hello\r\n", 6));
+	/* Within trailer field */
+	test_chunked_cut(test_body_off("Trailer", 3));
+	/* Between CR and LF of the empty line ending the body */
+	test_chunked_cut(test_body_size - 1);
+
+	/* And every other position */
+	for (cut = 1; cut < test_chunked_size; cut++)
+		test_chunked_cut(cut);
+}
+
+/** Malformed chunked coding */
+PCUT_TEST(chunked_malformed)
+{
+	http_chunked_t chunked;
+	char buf[16];
+	size_t decoded;
+	size_t consumed;
+	errno_t rc;
+
+	/* Chunk data not followed by CRLF */
+	http_chunked_init(&chunked);
+	memcpy(buf, "5\r\nHelloX", 10);
+	rc = http_chunked_decode(&chunked, buf, 10, &decoded, &consumed);
+	PCUT_ASSERT_ERRNO_VAL(HTTP_EPARSE, rc);
+
+	/* Missing chunk size */
+	http_chunked_init(&chunked);
+	memcpy(buf, "\r\n", 2);
+	rc = http_chunked_decode(&chunked, buf, 2, &decoded, &consumed);
+	PCUT_ASSERT_ERRNO_VAL(HTTP_EPARSE, rc);
+}
+
+PCUT_EXPORT(parser);
@@ -36,7 +36,8 @@
  * Allocates port numbers from IETF port number ranges.
  */
 
-#include <adt/list.h>
+#include <adt/hash.h>
+#include <adt/hash_table.h>
 #include <errno.h>
 #include <inet/endpoint.h>
 #include <nettl/portrng.h>
@@ -45,6 +46,53 @@
 
 #include <io/log.h>
 
+static size_t portrng_port_key_hash(const void *key)
+{
+	return hash_mix(*(const uint16_t *) key);
+}
+
+static size_t portrng_port_hash(const ht_link_t *item)
+{
+	portrng_port_t *port = hash_table_get_inst(item, portrng_port_t, lprng);
+	return hash_mix(port->pn);
+}
+
+static bool portrng_port_key_equal(const void *key, const ht_link_t *item)
+{
+	portrng_port_t *port = hash_table_get_inst(item, portrng_port_t, lprng);
+	return port->pn == *(const uint16_t *) key;
+}
+
+static void portrng_port_remove_callback(ht_link_t *item)
+{
+	free(hash_table_get_inst(item, portrng_port_t, lprng));
+}
+
+static hash_table_ops_t portrng_port_ops = {
+	.hash = portrng_port_hash,
+	.key_hash = portrng_port_key_hash,
+	.key_equal = portrng_port_key_equal,
+	.equal = NULL,
+	.remove_callback = portrng_port_remove_callback
+};
+
+/** Find allocated port.
+ *
+ * @param pr   Port range
+ * @param pnum Port number
+ * @return Port or @c NULL if @a pnum is not allocated
+ */
+static portrng_port_t *portrng_port_find(portrng_t *pr, uint16_t pnum)
+{
+	ht_link_t *link;
+
+	link = hash_table_find(&pr->used, &pnum);
+	if (link == NULL)
+		return NULL;
+
+	return hash_table_get_inst(link, portrng_port_t, lprng);
+}
+
 /** Create port range.
  *
  * @param rpr Place to store pointer to new port range
@@ -60,7 +108,12 @@ errno_t portrng_create(portrng_t **rpr)
 	if (pr == NULL)
 		return ENOMEM;
 
-	list_initialize(&pr->used);
+	if (!hash_table_create(&pr->used, 0, 0, &portrng_port_ops)) {
+		free(pr);
+		return ENOMEM;
+	}
+
+	pr->dyn_next = inet_port_dyn_lo;
 	*rpr = pr;
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_create() - end");
 	return EOK;
@@ -73,7 +126,8 @@ errno_t portrng_create(portrng_t **rpr)
 void portrng_destroy(portrng_t *pr)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_destroy()");
-	assert(list_empty(&pr->used));
+	assert(hash_table_empty(&pr->used));
+	hash_table_destroy(&pr->used);
 	free(pr);
 }
 
@@ -97,32 +151,32 @@ errno_t portrng_alloc(portrng_t *pr, uint16_t pnum, void *arg,
 {
 	portrng_port_t *p;
 	uint32_t i;
-	bool found;
+	uint16_t pn;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_alloc() - begin");
 
 	if (pnum == inet_port_any) {
-
+		/*
+		 * Continue after the last allocated dynamic port so that
+		 * recently freed port numbers are not reused immediately.
+		 */
+		pn = pr->dyn_next;
 		for (i = inet_port_dyn_lo; i <= inet_port_dyn_hi; i++) {
-			log_msg(LOG_DEFAULT, LVL_DEBUG2, "trying %" PRIu32, i);
-			found = false;
-			list_foreach(pr->used, lprng, portrng_port_t, port) {
-				if (port->pn == pnum) {
-					found = true;
-					break;
-				}
-			}
-
-			if (!found) {
-				pnum = i;
+			if (portrng_port_find(pr, pn) == NULL) {
+				pnum = pn;
 				break;
 			}
+
+			pn = (pn < inet_port_dyn_hi) ? pn + 1 : inet_port_dyn_lo;
 		}
 
 		if (pnum == inet_port_any) {
 			/* No free port found */
 			return ENOENT;
 		}
+
+		pr->dyn_next = (pnum < inet_port_dyn_hi) ? pnum + 1 :
+		    inet_port_dyn_lo;
 		log_msg(LOG_DEFAULT, LVL_DEBUG2, "selected %" PRIu16, pnum);
 	} else {
 		log_msg(LOG_DEFAULT, LVL_DEBUG2, "user asked for %" PRIu16, pnum);
@@ -133,11 +187,9 @@ errno_t portrng_alloc(portrng_t *pr, uint16_t pnum, void *arg,
 			return EINVAL;
 		}
 
-		list_foreach(pr->used, lprng, portrng_port_t, port) {
-			if (port->pn == pnum) {
-				log_msg(LOG_DEFAULT, LVL_DEBUG2, "port already used");
-				return EEXIST;
-			}
+		if (portrng_port_find(pr, pnum) != NULL) {
+			log_msg(LOG_DEFAULT, LVL_DEBUG2, "port already used");
+			return EEXIST;
 		}
 	}
 
@@ -147,7 +199,7 @@ errno_t portrng_alloc(portrng_t *pr, uint16_t pnum, void *arg,
 
 	p->pn = pnum;
 	p->arg = arg;
-	list_append(&p->lprng, &pr->used);
+	hash_table_insert(&pr->used, &p->lprng);
 	*apnum = pnum;
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_alloc() - end OK pn=%" PRIu16,
 	    pnum);
@@ -164,14 +216,14 @@ errno_t portrng_alloc(portrng_t *pr, uint16_t pnum, void *arg,
  */
 errno_t portrng_find_port(portrng_t *pr, uint16_t pnum, void **rarg)
 {
-	list_foreach(pr->used, lprng, portrng_port_t, port) {
-		if (port->pn == pnum) {
-			*rarg = port->arg;
-			return EOK;
-		}
-	}
+	portrng_port_t *port;
 
-	return ENOENT;
+	port = portrng_port_find(pr, pnum);
+	if (port == NULL)
+		return ENOENT;
+
+	*rarg = port->arg;
+	return EOK;
 }
 
 /** Free port in port range.
@@ -181,21 +233,14 @@ errno_t portrng_find_port(portrng_t *pr, uint16_t pnum, void **rarg)
  */
 void portrng_free_port(portrng_t *pr, uint16_t pnum)
 {
+	portrng_port_t *port;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_free_port(%u)", pnum);
-	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_free_port() - begin");
-	list_foreach(pr->used, lprng, portrng_port_t, port) {
-		log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_free_port - check port %u", port->pn);
-		if (port->pn == pnum) {
-			log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_free_port - OK");
-			list_remove(&port->lprng);
-			free(port);
-			log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_free_port() - end");
-			return;
-		}
-	}
 
-	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_free_port - FAIL");
-	assert(false);
+	port = portrng_port_find(pr, pnum);
+	assert(port != NULL);
+
+	hash_table_remove_item(&pr->used, &port->lprng);
 }
 
 /** Determine if port range is empty.
@@ -206,7 +251,7 @@ void portrng_free_port(portrng_t *pr, uint16_t pnum)
 bool portrng_empty(portrng_t *pr)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "portrng_empty()");
-	return list_empty(&pr->used);
+	return hash_table_empty(&pr->used);
 }
 
 /**
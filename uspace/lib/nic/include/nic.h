@@ -68,6 +68,8 @@ typedef struct {
 	link_t link;
 	void *data;
 	size_t size;
+	/** INET_OFFLOAD_* flags describing work already done by the NIC */
+	uint16_t offload;
 } nic_frame_t;
 
 typedef list_t nic_frame_list_t;
@@ -84,6 +86,20 @@ typedef list_t nic_frame_list_t;
  */
 typedef void (*send_frame_handler)(nic_t *, void *, size_t);
 
+/**
+ * Handler for writing frame data which still needs checksum completion
+ * or segmentation by the NIC device. Same semantics as send_frame_handler.
+ * The implementation is optional, frames without offload requests are
+ * always passed to send_frame_handler.
+ *
+ * @param nic_data
+ * @param data		Pointer to frame data
+ * @param size		Size of frame data in bytes
+ * @param offload	Requested offload operations
+ */
+typedef void (*send_frame_offload_handler)(nic_t *, void *, size_t,
+    const inet_offload_t *);
+
 /**
  * The handler for transitions between driver states.
  * If the handler returns error code, the transition between
@@ -218,6 +234,8 @@ extern void nic_driver_implement(driver_ops_t *, ddf_dev_ops_t *,
 extern errno_t nic_get_resources(nic_t *, hw_res_list_parsed_t *);
 extern void nic_set_specific(nic_t *, void *);
 extern void nic_set_send_frame_handler(nic_t *, send_frame_handler);
+extern void nic_set_send_frame_offload_handler(nic_t *,
+    send_frame_offload_handler);
 extern void nic_set_state_change_handlers(nic_t *,
     state_change_handler, state_change_handler, state_change_handler);
 extern void nic_set_filtering_change_handlers(nic_t *,
@@ -126,6 +126,11 @@ struct nic {
 	 * Called with the main_lock locked for reading.
 	 */
 	send_frame_handler send_frame;
+	/**
+	 * Function sending frames with pending offload requests.
+	 * Optional, called with the main_lock locked for reading.
+	 */
+	send_frame_offload_handler send_frame_offload;
 	/**
 	 * Event handler called when device goes to the ACTIVE state.
 	 * The implementation is optional.
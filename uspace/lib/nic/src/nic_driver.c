@@ -160,6 +160,20 @@ void nic_set_send_frame_handler(nic_t *nic_data, send_frame_handler sffunc)
 	nic_data->send_frame = sffunc;
 }
 
+/**
+ * Setup handler for frames which request checksum or segmentation offload.
+ * Drivers calling this should advertise the corresponding capabilities
+ * in their offload_probe method. Must be called only in add_device.
+ *
+ * @param nic_data
+ * @param sfofunc	Function handling offloaded send_frame requests
+ */
+void nic_set_send_frame_offload_handler(nic_t *nic_data,
+    send_frame_offload_handler sfofunc)
+{
+	nic_data->send_frame_offload = sfofunc;
+}
+
 /**
  * Setup event handlers for transitions between driver states.
  * This function can be called only in the add_device handler.
@@ -287,6 +301,7 @@ nic_frame_t *nic_alloc_frame(nic_t *nic_data, size_t size)
 	}
 
 	frame->size = size;
+	frame->offload = 0;
 	return frame;
 }
 
@@ -544,7 +559,7 @@ void nic_received_frame(nic_t *nic_data, nic_frame_t *frame)
 		}
 		fibril_rwlock_write_unlock(&nic_data->stats_lock);
 		nic_ev_received(nic_data->client_session, frame->data,
-		    frame->size);
+		    frame->size, frame->offload);
 	} else {
 		switch (frame_type) {
 		case NIC_FRAME_UNICAST:
@@ -612,6 +627,7 @@ static nic_t *nic_create(ddf_dev_t *dev)
 	nic_data->poll_mode = NIC_POLL_IMMEDIATE;
 	nic_data->default_poll_mode = NIC_POLL_IMMEDIATE;
 	nic_data->send_frame = NULL;
+	nic_data->send_frame_offload = NULL;
 	nic_data->on_activating = NULL;
 	nic_data->on_going_down = NULL;
 	nic_data->on_stopping = NULL;
@@ -165,11 +165,14 @@ errno_t nic_set_state_impl(ddf_fun_t *fun, nic_device_state_t state)
  * @param	fun
  * @param	data	Frame data
  * @param 	size	Frame size in bytes
+ * @param	offload	Requested offload operations or NULL
  *
  * @return EOK		If the message was sent
  * @return EBUSY	If the device is not in state when the frame can be sent.
+ * @return ENOTSUP	If offload was requested but the driver cannot do it.
  */
-errno_t nic_send_frame_impl(ddf_fun_t *fun, void *data, size_t size)
+errno_t nic_send_frame_impl(ddf_fun_t *fun, void *data, size_t size,
+    const inet_offload_t *offload)
 {
 	nic_t *nic_data = nic_get_from_ddf_fun(fun);
 
@@ -179,7 +182,17 @@ errno_t nic_send_frame_impl(ddf_fun_t *fun, void *data, size_t size)
 		return EBUSY;
 	}
 
-	nic_data->send_frame(nic_data, data, size);
+	if (offload != NULL && offload->flags != 0) {
+		if (nic_data->send_frame_offload == NULL) {
+			fibril_rwlock_read_unlock(&nic_data->main_lock);
+			return ENOTSUP;
+		}
+
+		nic_data->send_frame_offload(nic_data, data, size, offload);
+	} else {
+		nic_data->send_frame(nic_data, data, size);
+	}
+
 	fibril_rwlock_read_unlock(&nic_data->main_lock);
 	return EOK;
 }
@@ -102,6 +102,8 @@ errno_t pcm_format_convert_and_mix(void *dst, size_t dst_size, const void *src,
 errno_t pcm_format_mix(void *dst, const void *src, size_t size, const pcm_format_t *f);
 errno_t pcm_format_convert(pcm_format_t a, void *srca, size_t sizea,
     pcm_format_t b, void *srcb, size_t *sizeb);
+float pcm_format_get_sample(const void *buffer, size_t size, unsigned frame,
+    unsigned channel, const pcm_format_t *f);
 
 #endif
 
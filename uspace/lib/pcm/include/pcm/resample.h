@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup audio
+ * @brief PCM sample rate conversion
+ * @{
+ */
+/** @file
+ */
+
+#ifndef PCM_RESAMPLE_H_
+#define PCM_RESAMPLE_H_
+
+#include <errno.h>
+#include <stddef.h>
+#include <pcm/format.h>
+
+/** Maximum number of precomputed filter phases */
+#define PCM_RESAMPLE_MAX_PHASES  512
+
+/** Resampler quality presets */
+typedef enum {
+	/** Short filter, cheapest, audible aliasing on some material */
+	PCM_RESAMPLE_FAST,
+	/** Reasonable trade-off, used by default */
+	PCM_RESAMPLE_MEDIUM,
+	/** Long filter with steep roll-off */
+	PCM_RESAMPLE_BEST,
+} pcm_resample_quality_t;
+
+/** Polyphase FIR sample rate converter */
+typedef struct {
+	/** Format of the input data */
+	pcm_format_t src_format;
+	/** Output sampling rate */
+	unsigned dst_rate;
+	/** Selected quality preset */
+	pcm_resample_quality_t quality;
+	/** Interpolation factor (reduced output rate) */
+	unsigned up;
+	/** Decimation factor (reduced input rate) */
+	unsigned down;
+	/** Filter length of a single phase */
+	unsigned taps;
+	/** Number of precomputed phases */
+	unsigned phases;
+	/** Filter coefficients, @c phases rows of @c taps each */
+	float *coefs;
+	/** Input history, two copies of @c taps samples per channel */
+	float *history;
+	/** Write position in the history */
+	unsigned hpos;
+	/** Current phase, 0 .. up - 1 */
+	unsigned phase;
+	/** Input frames to consume before the next output frame */
+	size_t pending;
+} pcm_resampler_t;
+
+errno_t pcm_resampler_init(pcm_resampler_t *r, const pcm_format_t *src,
+    unsigned dst_rate, pcm_resample_quality_t quality);
+void pcm_resampler_fini(pcm_resampler_t *r);
+void pcm_resampler_reset(pcm_resampler_t *r);
+size_t pcm_resampler_process(pcm_resampler_t *r, const void *src,
+    size_t src_size, size_t *src_used, float *dst, size_t dst_frames);
+size_t pcm_resampler_src_frames(const pcm_resampler_t *r, size_t dst_frames);
+
+/**
+ * Check whether a resampler instance can be used for given conversion.
+ * @param r Initialized resampler.
+ * @param src Input data format.
+ * @param dst_rate Output sampling rate.
+ * @return True if @p r converts from @p src to @p dst_rate.
+ */
+static inline bool pcm_resampler_matches(const pcm_resampler_t *r,
+    const pcm_format_t *src, unsigned dst_rate)
+{
+	return pcm_format_same(&r->src_format, src) && r->dst_rate == dst_rate;
+}
+
+#endif
+
+/**
+ * @}
+ */
@@ -144,9 +144,11 @@ do { \
 	case PCM_SAMPLE_SINT24_LE:
 	case PCM_SAMPLE_UINT24_BE:
 	case PCM_SAMPLE_SINT24_BE:
-	case PCM_SAMPLE_FLOAT32:
 	default:
 		break;
+	case PCM_SAMPLE_FLOAT32:
+		SET_NULL(float, le, 0);
+		break;
 	}
 #undef SET_NULL
 }
@@ -252,11 +254,13 @@ do { \
 	case PCM_SAMPLE_SINT32_BE:
 		LOOP_ADD(int32_t, be, INT32_MIN, INT32_MAX);
 		break;
+	case PCM_SAMPLE_FLOAT32:
+		LOOP_ADD(float, le, -1.0f, 1.0f);
+		break;
 	case PCM_SAMPLE_UINT24_LE:
 	case PCM_SAMPLE_SINT24_LE:
 	case PCM_SAMPLE_UINT24_BE:
 	case PCM_SAMPLE_SINT24_BE:
-	case PCM_SAMPLE_FLOAT32:
 	default:
 		return ENOTSUP;
 	}
@@ -321,17 +325,33 @@ do { \
 	case PCM_SAMPLE_SINT24_32_BE:
 	case PCM_SAMPLE_SINT32_BE:
 		GET(int32_t, le, INT32_MIN, INT32_MAX);
+	case PCM_SAMPLE_FLOAT32:
+		GET(float, le, -1.0f, 1.0f);
 	case PCM_SAMPLE_UINT24_LE:
 	case PCM_SAMPLE_SINT24_LE:
 	case PCM_SAMPLE_UINT24_BE:
 	case PCM_SAMPLE_SINT24_BE:
-	case PCM_SAMPLE_FLOAT32:
 	default:
 		break;
 	}
 	return 0;
 #undef GET
 }
+
+/**
+ * Read one sample and normalize it to float <-1,1>.
+ * @param buffer Audio data
+ * @param size Size of the buffer
+ * @param frame Index of the frame to read
+ * @param channel Channel within the frame
+ * @param f Pointer to a format descriptor
+ * @return Normalized sample <-1,1>, 0.0 if the data could not be read
+ */
+float pcm_format_get_sample(const void *buffer, size_t size, unsigned frame,
+    unsigned channel, const pcm_format_t *f)
+{
+	return get_normalized_sample(buffer, size, frame, channel, f);
+}
 /**
  * @}
  */
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup audio
+ * @brief PCM sample rate conversion
+ * @{
+ */
+/** @file
+ *
+ * Rational ratio polyphase resampler. The conversion ratio is reduced to
+ * up/down and output samples are computed by a windowed sinc FIR filter
+ * whose coefficients are precomputed for every interpolation phase, so
+ * producing one output sample costs @c taps multiply-adds per channel.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <macros.h>
+#include <math.h>
+#include <mem.h>
+#include <stdlib.h>
+
+#include "format.h"
+#include "resample.h"
+
+/** Quality preset parameters */
+static const struct {
+	/** Filter length of a single phase */
+	unsigned taps;
+	/** Cut-off frequency relative to the lower Nyquist frequency */
+	float rolloff;
+} presets[] = {
+	[PCM_RESAMPLE_FAST] = { .taps = 8, .rolloff = 0.85f },
+	[PCM_RESAMPLE_MEDIUM] = { .taps = 16, .rolloff = 0.91f },
+	[PCM_RESAMPLE_BEST] = { .taps = 32, .rolloff = 0.95f },
+};
+
+/** Greatest common divisor helper. */
+static unsigned gcd(unsigned a, unsigned b)
+{
+	while (b != 0) {
+		const unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/**
+ * Windowed sinc low-pass kernel.
+ * @param x Distance from the center in input samples.
+ * @param half Half of the filter length.
+ * @param fc Cut-off frequency relative to the input Nyquist frequency.
+ * @return Filter coefficient.
+ */
+static float kernel(float x, float half, float fc)
+{
+	if (x <= -half || x >= half)
+		return 0.0f;
+	/* Blackman window */
+	const float n = (x + half) / (2.0f * half);
+	const float w = 0.42f - 0.5f * cosf(2.0f * M_PI * n) +
+	    0.08f * cosf(4.0f * M_PI * n);
+	const float arg = M_PI * fc * x;
+	const float sinc = (x == 0.0f) ? 1.0f : sinf(arg) / arg;
+	return fc * sinc * w;
+}
+
+/**
+ * Precompute filter coefficients for all phases.
+ * @param r Resampler with taps, phases, up and down set.
+ */
+static void compute_coefs(pcm_resampler_t *r)
+{
+	const float half = r->taps / 2;
+	float fc = presets[r->quality].rolloff;
+	if (r->down > r->up)
+		fc = fc * r->up / r->down;
+
+	for (unsigned p = 0; p < r->phases; ++p) {
+		float *row = r->coefs + p * r->taps;
+		const float frac = (float) p / r->phases;
+		float sum = 0.0f;
+		for (unsigned j = 0; j < r->taps; ++j) {
+			/* Oldest sample first, output lies between taps/2-1 and taps/2 */
+			row[j] = kernel(half - 1.0f - j + frac, half, fc);
+			sum += row[j];
+		}
+		/* Normalize DC gain of every phase to 1 */
+		if (sum != 0.0f) {
+			for (unsigned j = 0; j < r->taps; ++j)
+				row[j] /= sum;
+		}
+	}
+}
+
+/**
+ * Initialize resampler.
+ * @param r Resampler structure to initialize.
+ * @param src Format of the input data.
+ * @param dst_rate Requested output sampling rate.
+ * @param quality Quality preset.
+ * @return Error code.
+ *
+ * The output is always interleaved float samples with the same number of
+ * channels as the input.
+ */
+errno_t pcm_resampler_init(pcm_resampler_t *r, const pcm_format_t *src,
+    unsigned dst_rate, pcm_resample_quality_t quality)
+{
+	assert(r);
+	assert(src);
+	if (src->channels == 0 || src->sampling_rate == 0 || dst_rate == 0)
+		return EINVAL;
+	if (quality > PCM_RESAMPLE_BEST)
+		return EINVAL;
+
+	const unsigned div = gcd(src->sampling_rate, dst_rate);
+	r->src_format = *src;
+	r->dst_rate = dst_rate;
+	r->quality = quality;
+	r->up = dst_rate / div;
+	r->down = src->sampling_rate / div;
+	r->taps = presets[quality].taps;
+	r->phases = min(r->up, PCM_RESAMPLE_MAX_PHASES);
+
+	r->coefs = malloc(sizeof(float) * r->phases * r->taps);
+	r->history = malloc(sizeof(float) * 2 * r->taps * src->channels);
+	if (!r->coefs || !r->history) {
+		free(r->coefs);
+		free(r->history);
+		r->coefs = NULL;
+		r->history = NULL;
+		return ENOMEM;
+	}
+	compute_coefs(r);
+	pcm_resampler_reset(r);
+	return EOK;
+}
+
+/**
+ * Release resources claimed by the resampler.
+ * @param r Initialized resampler.
+ */
+void pcm_resampler_fini(pcm_resampler_t *r)
+{
+	assert(r);
+	free(r->coefs);
+	free(r->history);
+	r->coefs = NULL;
+	r->history = NULL;
+}
+
+/**
+ * Forget all buffered input.
+ * @param r Initialized resampler.
+ *
+ * The first output sample after reset corresponds to the first input
+ * sample pushed afterwards.
+ */
+void pcm_resampler_reset(pcm_resampler_t *r)
+{
+	assert(r);
+	memset(r->history, 0,
+	    sizeof(float) * 2 * r->taps * r->src_format.channels);
+	r->hpos = 0;
+	r->phase = 0;
+	r->pending = r->taps / 2 + 1;
+}
+
+/**
+ * Append one input frame to the history.
+ * @param r Resampler.
+ * @param src Input buffer.
+ * @param size Size of the input buffer.
+ * @param frame Index of the frame to append.
+ */
+static void push_frame(pcm_resampler_t *r, const void *src, size_t size,
+    size_t frame)
+{
+	const unsigned len = 2 * r->taps;
+	for (unsigned c = 0; c < r->src_format.channels; ++c) {
+		float *h = r->history + c * len;
+		const float s =
+		    pcm_format_get_sample(src, size, frame, c, &r->src_format);
+		h[r->hpos] = s;
+		h[r->hpos + r->taps] = s;
+	}
+	r->hpos = (r->hpos + 1) % r->taps;
+}
+
+/**
+ * Convert audio data.
+ * @param r Resampler.
+ * @param src Input buffer in the resampler's source format.
+ * @param src_size Size of the input buffer, whole frames.
+ * @param[out] src_used Number of input bytes consumed.
+ * @param dst Output buffer, interleaved float samples.
+ * @param dst_frames Capacity of the output buffer in frames.
+ * @return Number of frames written to @p dst.
+ *
+ * Conversion stops when either the input is exhausted or the output
+ * buffer is full. Input that was consumed but not yet fully used for
+ * output is kept in the resampler's history.
+ */
+size_t pcm_resampler_process(pcm_resampler_t *r, const void *src,
+    size_t src_size, size_t *src_used, float *dst, size_t dst_frames)
+{
+	assert(r);
+	assert(src_used);
+	const unsigned channels = r->src_format.channels;
+	const size_t frame_size = pcm_format_frame_size(&r->src_format);
+	const size_t src_frames = src_size / frame_size;
+	size_t in = 0;
+	size_t out = 0;
+
+	while (out < dst_frames) {
+		if (r->pending > 0) {
+			if (in == src_frames)
+				break;
+			push_frame(r, src, src_size, in++);
+			--r->pending;
+			continue;
+		}
+
+		const unsigned row = (r->phases == r->up) ? r->phase :
+		    (unsigned) (((unsigned long long) r->phase * r->phases) /
+		    r->up);
+		const float *coefs = r->coefs + row * r->taps;
+		for (unsigned c = 0; c < channels; ++c) {
+			const float *h =
+			    r->history + c * 2 * r->taps + r->hpos;
+			float acc = 0.0f;
+			for (unsigned j = 0; j < r->taps; ++j)
+				acc += h[j] * coefs[j];
+			dst[out * channels + c] = acc;
+		}
+		++out;
+
+		r->phase += r->down;
+		r->pending = r->phase / r->up;
+		r->phase %= r->up;
+	}
+	*src_used = in * frame_size;
+	return out;
+}
+
+/**
+ * Compute number of input frames needed to produce given output.
+ * @param r Resampler.
+ * @param dst_frames Requested number of output frames.
+ * @return Number of input frames.
+ */
+size_t pcm_resampler_src_frames(const pcm_resampler_t *r, size_t dst_frames)
+{
+	assert(r);
+	if (dst_frames == 0)
+		return 0;
+	return r->pending + (r->phase +
+	    (unsigned long long) (dst_frames - 1) * r->down) / r->up;
+}
+
+/**
+ * @}
+ */
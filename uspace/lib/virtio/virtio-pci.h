@@ -63,6 +63,11 @@
 
 #define VIRTIO_F_VERSION_1	1
 
+/** Driver can use descriptors with the VIRTQ_DESC_F_INDIRECT flag set */
+#define VIRTIO_F_RING_INDIRECT_DESC	(1U << 28)
+/** Enables the used_event and avail_event fields */
+#define VIRTIO_F_RING_EVENT_IDX		(1U << 29)
+
 /** Common configuration structure layout according to VIRTIO version 1.0 */
 typedef struct virtio_pci_common_cfg {
 	ioport32_t device_feature_select;
@@ -151,6 +156,20 @@ typedef struct {
 	virtq_used_t *used;
 	uint16_t used_last_idx;
 
+	/**
+	 * Driver's copy of the available ring index and its value when the
+	 * device was last notified
+	 */
+	uint16_t avail_idx;
+	uint16_t avail_kicked_idx;
+
+	/** VIRTIO_F_RING_EVENT_IDX was negotiated */
+	bool event_idx;
+	/** Driver-written used_event at the end of the available ring */
+	ioport16_t *used_event;
+	/** Device-written avail_event at the end of the used ring */
+	ioport16_t *avail_event;
+
 	/** Address of the queue's notification register */
 	ioport16_t *notify;
 } virtq_t;
@@ -179,6 +198,9 @@ typedef struct {
 	/** Device-specific configuration */
 	void *device_cfg;
 
+	/** Features accepted by both the driver and the device (bits 0-31) */
+	uint32_t features;
+
 	/** Virtqueues */
 	virtq_t *queues;
 } virtio_dev_t;
@@ -191,6 +213,10 @@ extern void virtio_virtq_desc_set(virtio_dev_t *vdev, uint16_t, uint16_t,
     uint64_t, uint32_t, uint16_t, uint16_t);
 extern uint16_t virtio_virtq_desc_get_next(virtio_dev_t *vdev, uint16_t,
     uint16_t);
+extern void virtio_virtq_desc_set_indirect(virtio_dev_t *, uint16_t, uint16_t,
+    uintptr_t, uint16_t);
+extern void virtio_indirect_desc_set(virtq_desc_t *, uint16_t, uint64_t,
+    uint32_t, uint16_t, uint16_t);
 
 extern void virtio_create_desc_free_list(virtio_dev_t *, uint16_t, uint16_t,
     uint16_t *);
@@ -198,6 +224,8 @@ extern uint16_t virtio_alloc_desc(virtio_dev_t *, uint16_t, uint16_t *);
 extern void virtio_free_desc(virtio_dev_t *, uint16_t, uint16_t *, uint16_t);
 
 extern void virtio_virtq_produce_available(virtio_dev_t *, uint16_t, uint16_t);
+extern void virtio_virtq_add_available(virtio_dev_t *, uint16_t, uint16_t);
+extern void virtio_virtq_kick(virtio_dev_t *, uint16_t);
 extern bool virtio_virtq_consume_used(virtio_dev_t *, uint16_t, uint16_t *,
     uint32_t *);
 
@@ -205,6 +233,8 @@ extern errno_t virtio_virtq_setup(virtio_dev_t *, uint16_t, uint16_t);
 extern void virtio_virtq_teardown(virtio_dev_t *, uint16_t);
 
 extern errno_t virtio_device_setup_start(virtio_dev_t *, uint32_t);
+extern errno_t virtio_device_setup_negotiate(virtio_dev_t *, uint32_t,
+    uint32_t);
 extern void virtio_device_setup_fail(virtio_dev_t *);
 extern void virtio_device_setup_finalize(virtio_dev_t *);
 
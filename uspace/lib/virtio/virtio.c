@@ -113,6 +113,36 @@ uint16_t virtio_virtq_desc_get_next(virtio_dev_t *vdev, uint16_t num,
 	return pio_read_le16(&d->next);
 }
 
+/** Make a virtqueue descriptor refer to a table of indirect descriptors
+ *
+ * @param vdev[in]    VIRTIO device.
+ * @param num[in]     Index of the virtqueue.
+ * @param descno[in]  Descriptor in the virtqueue.
+ * @param table[in]   Physical address of the indirect descriptor table.
+ * @param count[in]   Number of descriptors in the table.
+ */
+void virtio_virtq_desc_set_indirect(virtio_dev_t *vdev, uint16_t num,
+    uint16_t descno, uintptr_t table, uint16_t count)
+{
+	virtio_virtq_desc_set(vdev, num, descno, table,
+	    count * sizeof(virtq_desc_t), VIRTQ_DESC_F_INDIRECT, 0);
+}
+
+/** Set a descriptor in a table of indirect descriptors
+ *
+ * The table itself must reside in DMA memory. Descriptors in the table are
+ * chained by their index in the table.
+ */
+void virtio_indirect_desc_set(virtq_desc_t *table, uint16_t descno,
+    uint64_t addr, uint32_t len, uint16_t flags, uint16_t next)
+{
+	virtq_desc_t *d = &table[descno];
+	pio_write_le64(&d->addr, addr);
+	pio_write_le32(&d->len, len);
+	pio_write_le16(&d->flags, flags);
+	pio_write_le16(&d->next, next);
+}
+
 /** Create free descriptor list from the unused VIRTIO descriptors
  *
  * @param vdev[in]   VIRTIO device for which the free list will be created.
@@ -170,33 +200,138 @@ void virtio_free_desc(virtio_dev_t *vdev, uint16_t num, uint16_t *head,
 	fibril_mutex_unlock(&q->lock);
 }
 
+static void virtq_add_available(virtq_t *q, uint16_t descno)
+{
+	uint16_t idx = q->avail_idx;
+	pio_write_le16(&q->avail->ring[idx % q->queue_size], descno);
+	write_barrier();
+	q->avail_idx = idx + 1;
+	pio_write_le16(&q->avail->idx, q->avail_idx);
+}
+
+static void virtq_kick(virtq_t *q, uint16_t num)
+{
+	uint16_t old_idx = q->avail_kicked_idx;
+	uint16_t new_idx = q->avail_idx;
+	bool notify;
+
+	if (old_idx == new_idx)
+		return;
+
+	/* Publish the available index before looking at what the device wants */
+	memory_barrier();
+
+	if (q->event_idx) {
+		/*
+		 * Notify only if the device asked to be notified about one of
+		 * the entries added since the last notification.
+		 */
+		uint16_t event = pio_read_le16(q->avail_event);
+		notify = (uint16_t) (new_idx - event - 1) <
+		    (uint16_t) (new_idx - old_idx);
+	} else {
+		notify = !(pio_read_le16(&q->used->flags) &
+		    VIRTQ_USED_F_NO_NOTIFY);
+	}
+
+	q->avail_kicked_idx = new_idx;
+	if (notify)
+		pio_write_le16(q->notify, num);
+}
+
+/** Make a descriptor chain available to the device and notify the device
+ *
+ * @param vdev[in]    VIRTIO device.
+ * @param num[in]     Index of the virtqueue.
+ * @param descno[in]  Head of the descriptor chain.
+ */
 void virtio_virtq_produce_available(virtio_dev_t *vdev, uint16_t num,
     uint16_t descno)
 {
 	virtq_t *q = &vdev->queues[num];
 
 	fibril_mutex_lock(&q->lock);
-	uint16_t idx = pio_read_le16(&q->avail->idx);
-	pio_write_le16(&q->avail->ring[idx % q->queue_size], descno);
-	write_barrier();
-	pio_write_le16(&q->avail->idx, idx + 1);
-	write_barrier();
-	pio_write_le16(q->notify, num);
+	virtq_add_available(q, descno);
+	virtq_kick(q, num);
 	fibril_mutex_unlock(&q->lock);
 }
 
+/** Make a descriptor chain available to the device without notifying it
+ *
+ * Several chains can be added this way and the device notified only once
+ * by virtio_virtq_kick().
+ *
+ * @param vdev[in]    VIRTIO device.
+ * @param num[in]     Index of the virtqueue.
+ * @param descno[in]  Head of the descriptor chain.
+ */
+void virtio_virtq_add_available(virtio_dev_t *vdev, uint16_t num,
+    uint16_t descno)
+{
+	virtq_t *q = &vdev->queues[num];
+
+	fibril_mutex_lock(&q->lock);
+	virtq_add_available(q, descno);
+	fibril_mutex_unlock(&q->lock);
+}
+
+/** Notify the device about the descriptor chains added since the last kick
+ *
+ * The notification is skipped if the device does not want it.
+ *
+ * @param vdev[in]  VIRTIO device.
+ * @param num[in]   Index of the virtqueue.
+ */
+void virtio_virtq_kick(virtio_dev_t *vdev, uint16_t num)
+{
+	virtq_t *q = &vdev->queues[num];
+
+	fibril_mutex_lock(&q->lock);
+	virtq_kick(q, num);
+	fibril_mutex_unlock(&q->lock);
+}
+
+/** Consume one entry of the used ring
+ *
+ * With VIRTIO_F_RING_EVENT_IDX, the device is asked for the next interrupt
+ * only once the used ring has been drained so that completions arriving
+ * while the driver is still consuming do not raise more interrupts.
+ *
+ * @param vdev[in]     VIRTIO device.
+ * @param num[in]      Index of the virtqueue.
+ * @param descno[out]  Head of the used descriptor chain.
+ * @param len[out]     Number of bytes written by the device.
+ *
+ * @return  True if an entry was consumed, false if the used ring is empty.
+ */
 bool virtio_virtq_consume_used(virtio_dev_t *vdev, uint16_t num,
     uint16_t *descno, uint32_t *len)
 {
 	virtq_t *q = &vdev->queues[num];
 
 	fibril_mutex_lock(&q->lock);
-	uint16_t last_idx = q->used_last_idx % q->queue_size;
-	if (last_idx == (pio_read_le16(&q->used->idx) % q->queue_size)) {
-		fibril_mutex_unlock(&q->lock);
-		return false;
+	if (q->used_last_idx == pio_read_le16(&q->used->idx)) {
+		if (!q->event_idx) {
+			fibril_mutex_unlock(&q->lock);
+			return false;
+		}
+
+		/*
+		 * Ask for an interrupt on the next completion and check again
+		 * for a completion which raced with the update.
+		 */
+		pio_write_le16(q->used_event, q->used_last_idx);
+		memory_barrier();
+		if (q->used_last_idx == pio_read_le16(&q->used->idx)) {
+			fibril_mutex_unlock(&q->lock);
+			return false;
+		}
 	}
 
+	/* Read the entry only after seeing the index */
+	read_barrier();
+
+	uint16_t last_idx = q->used_last_idx % q->queue_size;
 	*descno = (uint16_t) pio_read_le32(&q->used->ring[last_idx].id);
 	*len = pio_read_le32(&q->used->ring[last_idx].len);
 
@@ -258,6 +393,11 @@ errno_t virtio_virtq_setup(virtio_dev_t *vdev, uint16_t num, uint16_t size)
 	q->avail = q->virt + avail_offset;
 	q->used = q->virt + used_offset;
 	q->used_last_idx = 0;
+	q->avail_idx = 0;
+	q->avail_kicked_idx = 0;
+	q->event_idx = (vdev->features & VIRTIO_F_RING_EVENT_IDX) != 0;
+	q->used_event = &q->avail->ring[size];
+	q->avail_event = (ioport16_t *) &q->used->ring[size];
 
 	memset(q->virt, 0, q->size);
 
@@ -301,6 +441,22 @@ void virtio_virtq_teardown(virtio_dev_t *vdev, uint16_t num)
  * specification, steps 1 - 6.
  */
 errno_t virtio_device_setup_start(virtio_dev_t *vdev, uint32_t features)
+{
+	return virtio_device_setup_negotiate(vdev, features, 0);
+}
+
+/**
+ * Perform device initialization steps 1 - 6 accepting optional features.
+ *
+ * @param vdev[in]      VIRTIO device.
+ * @param features[in]  Features the driver requires.
+ * @param optional[in]  Features the driver can use if the device offers
+ *                      them.
+ *
+ * The negotiated features are stored in vdev->features.
+ */
+errno_t virtio_device_setup_negotiate(virtio_dev_t *vdev, uint32_t features,
+    uint32_t optional)
 {
 	virtio_pci_common_cfg_t *cfg = vdev->common_cfg;
 
@@ -329,7 +485,7 @@ errno_t virtio_device_setup_start(virtio_dev_t *vdev, uint32_t features)
 
 	if (features != (features & device_features))
 		return ENOTSUP;
-	features &= device_features;
+	features |= optional & device_features;
 
 	if (reserved_features != (reserved_features & device_reserved_features))
 		return ENOTSUP;
@@ -343,6 +499,7 @@ errno_t virtio_device_setup_start(virtio_dev_t *vdev, uint32_t features)
 
 	ddf_msg(LVL_NOTE, "accepted features %x, reserved features %x",
 	    features, reserved_features);
+	vdev->features = features;
 
 	/* 5. Set FEATURES_OK */
 	status |= VIRTIO_DEV_STATUS_FEATURES_OK;
@@ -39,6 +39,9 @@
 #include "audio_data.h"
 #include "log.h"
 
+/** Number of frames converted in one resampling step */
+#define RESAMPLE_CHUNK_FRAMES  256
+
 /**
  * Create reference counted buffer out of ordinary data buffer.
  * @param data audio buffer. The memory passed will be freed eventually.
@@ -186,6 +189,25 @@ void audio_pipe_init(audio_pipe_t *pipe)
 	fibril_mutex_initialize(&pipe->guard);
 	pipe->frames = 0;
 	pipe->bytes = 0;
+	pipe->resampler = NULL;
+	pipe->resample_buffer = NULL;
+	pipe->quality = PCM_RESAMPLE_MEDIUM;
+}
+
+/**
+ * Release sample rate converter of a pipe.
+ * @param pipe The audio pipe.
+ */
+static void audio_pipe_release_resampler(audio_pipe_t *pipe)
+{
+	assert(pipe);
+	if (pipe->resampler) {
+		pcm_resampler_fini(pipe->resampler);
+		free(pipe->resampler);
+	}
+	free(pipe->resample_buffer);
+	pipe->resampler = NULL;
+	pipe->resample_buffer = NULL;
 }
 
 /**
@@ -199,6 +221,72 @@ void audio_pipe_fini(audio_pipe_t *pipe)
 		audio_data_t *adata = audio_pipe_pop(pipe);
 		audio_data_unref(adata);
 	}
+	audio_pipe_release_resampler(pipe);
+}
+
+/**
+ * Set quality of sample rate conversion.
+ * @param pipe The audio pipe.
+ * @param quality Resampler quality preset.
+ *
+ * Takes effect the next time the pipe needs to (re)create its converter.
+ */
+void audio_pipe_set_quality(audio_pipe_t *pipe, pcm_resample_quality_t quality)
+{
+	assert(pipe);
+	fibril_mutex_lock(&pipe->guard);
+	pipe->quality = quality;
+	fibril_mutex_unlock(&pipe->guard);
+}
+
+/**
+ * Check whether data has to be resampled.
+ * @param src Source data format.
+ * @param dst Target data format.
+ * @return True if the sampling rates differ.
+ */
+static inline bool needs_resampling(const pcm_format_t *src,
+    const pcm_format_t *dst)
+{
+	return src->sampling_rate != 0 && dst->sampling_rate != 0 &&
+	    src->sampling_rate != dst->sampling_rate;
+}
+
+/**
+ * Make sure the pipe has converter for the given conversion.
+ * @param pipe The audio pipe, guard must be held.
+ * @param src Source data format.
+ * @param dst_rate Target sampling rate.
+ * @return Error code.
+ */
+static errno_t audio_pipe_get_resampler(audio_pipe_t *pipe,
+    const pcm_format_t *src, unsigned dst_rate)
+{
+	assert(pipe);
+	if (pipe->resampler &&
+	    pcm_resampler_matches(pipe->resampler, src, dst_rate))
+		return EOK;
+
+	audio_pipe_release_resampler(pipe);
+	pcm_resampler_t *r = malloc(sizeof(pcm_resampler_t));
+	float *buffer =
+	    malloc(sizeof(float) * RESAMPLE_CHUNK_FRAMES * src->channels);
+	if (!r || !buffer) {
+		free(r);
+		free(buffer);
+		return ENOMEM;
+	}
+	const errno_t ret = pcm_resampler_init(r, src, dst_rate, pipe->quality);
+	if (ret != EOK) {
+		free(r);
+		free(buffer);
+		return ret;
+	}
+	log_verbose("Resampling %uHz -> %uHz, %u taps", src->sampling_rate,
+	    dst_rate, r->taps);
+	pipe->resampler = r;
+	pipe->resample_buffer = buffer;
+	return EOK;
 }
 
 /**
@@ -273,6 +361,56 @@ size_t audio_pipe_mix_data(audio_pipe_t *pipe, void *data,
 		/* Get audio chunk metadata */
 		const size_t src_frame_size =
 		    pcm_format_frame_size(&alink->adata->format);
+
+		/*
+		 * Drop incomplete trailing frame, it can be neither converted
+		 * nor resampled and would stall the pipe.
+		 */
+		if (audio_data_link_remain_size(alink) < src_frame_size) {
+			pipe->bytes -= audio_data_link_remain_size(alink);
+			list_remove(&alink->link);
+			audio_data_link_destroy(alink);
+			continue;
+		}
+
+		if (needs_resampling(&alink->adata->format, f)) {
+			if (audio_pipe_get_resampler(pipe,
+			    &alink->adata->format, f->sampling_rate) != EOK) {
+				log_error("Failed to create resampler");
+				break;
+			}
+			const pcm_format_t rf = {
+				.channels = alink->adata->format.channels,
+				.sampling_rate = f->sampling_rate,
+				.sample_format = PCM_SAMPLE_FLOAT32,
+			};
+			size_t used = 0;
+			const size_t frames = pcm_resampler_process(
+			    pipe->resampler, audio_data_link_start(alink),
+			    audio_data_link_remain_size(alink), &used,
+			    pipe->resample_buffer,
+			    min(needed_frames, RESAMPLE_CHUNK_FRAMES));
+			const size_t dst_copy_size = frames * dst_frame_size;
+
+			if (frames > 0) {
+				pcm_format_convert_and_mix(data, dst_copy_size,
+				    pipe->resample_buffer,
+				    frames * pcm_format_frame_size(&rf), &rf, f);
+			}
+
+			needed_frames -= frames;
+			copied_size += dst_copy_size;
+			data += dst_copy_size;
+			alink->position += used;
+			pipe->bytes -= used;
+			pipe->frames -= used / src_frame_size;
+			if (audio_data_link_remain_size(alink) == 0) {
+				list_remove(&alink->link);
+				audio_data_link_destroy(alink);
+			}
+			continue;
+		}
+
 		const size_t available_frames =
 		    audio_data_link_available_frames(alink);
 		const size_t copy_frames = min(available_frames, needed_frames);
@@ -304,6 +442,38 @@ size_t audio_pipe_mix_data(audio_pipe_t *pipe, void *data,
 	return copied_size;
 }
 
+/**
+ * Compute amount of source data needed to fill target buffer.
+ * @param pipe The pipe that should provide data.
+ * @param size Target buffer size.
+ * @param src Source data format.
+ * @param dst Target data format.
+ * @return Size of source data in bytes.
+ */
+size_t audio_pipe_src_size(audio_pipe_t *pipe, size_t size,
+    const pcm_format_t *src, const pcm_format_t *dst)
+{
+	assert(pipe);
+	const size_t frames = pcm_format_size_to_frames(size, dst);
+	size_t src_frames = frames;
+
+	if (needs_resampling(src, dst)) {
+		fibril_mutex_lock(&pipe->guard);
+		if (pipe->resampler && pcm_resampler_matches(pipe->resampler,
+		    src, dst->sampling_rate)) {
+			src_frames = pcm_resampler_src_frames(pipe->resampler,
+			    frames);
+		} else {
+			/* Round up, converter priming is not accounted for */
+			src_frames = ((unsigned long long) frames *
+			    src->sampling_rate + dst->sampling_rate - 1) /
+			    dst->sampling_rate;
+		}
+		fibril_mutex_unlock(&pipe->guard);
+	}
+	return src_frames * pcm_format_frame_size(src);
+}
+
 /**
  * @}
  */
@@ -41,6 +41,7 @@
 #include <errno.h>
 #include <fibril_synch.h>
 #include <pcm/format.h>
+#include <pcm/resample.h>
 
 /** Reference counted audio buffer */
 typedef struct {
@@ -64,6 +65,12 @@ typedef struct {
 	size_t frames;
 	/** List access synchronization */
 	fibril_mutex_t guard;
+	/** Sample rate converter, created on first rate mismatch */
+	pcm_resampler_t *resampler;
+	/** Converted data waiting to be mixed */
+	float *resample_buffer;
+	/** Resampling quality preset */
+	pcm_resample_quality_t quality;
 } audio_pipe_t;
 
 audio_data_t *audio_data_create(void *data, size_t size,
@@ -73,12 +80,16 @@ void audio_data_unref(audio_data_t *adata);
 
 void audio_pipe_init(audio_pipe_t *pipe);
 void audio_pipe_fini(audio_pipe_t *pipe);
+void audio_pipe_set_quality(audio_pipe_t *pipe,
+    pcm_resample_quality_t quality);
 
 errno_t audio_pipe_push(audio_pipe_t *pipe, audio_data_t *data);
 audio_data_t *audio_pipe_pop(audio_pipe_t *pipe);
 
 size_t audio_pipe_mix_data(audio_pipe_t *pipe, void *buffer, size_t size,
     const pcm_format_t *f);
+size_t audio_pipe_src_size(audio_pipe_t *pipe, size_t size,
+    const pcm_format_t *src, const pcm_format_t *dst);
 
 /**
  * Total bytes getter.
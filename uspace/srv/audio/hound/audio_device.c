@@ -39,6 +39,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <loc.h>
+#include <macros.h>
 #include <stdbool.h>
 #include <str.h>
 #include <str_error.h>
@@ -47,16 +48,23 @@
 #include "audio_device.h"
 #include "log.h"
 
-/* hardwired to provide ~21ms per fragment */
+/* Fallback if the format is not known, ~21ms per fragment */
 #define BUFFER_PARTS   16
 
+/* Target length of one mixing period */
+#define PERIOD_USEC   5000
+
+/* Number of fragments mixed ahead of the playback position */
+#define MIN_LEAD_FRAGMENTS   2
+
 static errno_t device_sink_connection_callback(audio_sink_t *sink, bool new);
 static errno_t device_source_connection_callback(audio_source_t *source, bool new);
 static void device_event_callback(ipc_call_t *icall, void *arg);
 static errno_t device_check_format(audio_sink_t *sink);
-static errno_t get_buffer(audio_device_t *dev);
+static errno_t get_buffer(audio_device_t *dev, const pcm_format_t *f);
 static errno_t release_buffer(audio_device_t *dev);
 static void advance_buffer(audio_device_t *dev, size_t size);
+static void mix_fragment(audio_device_t *dev);
 static inline bool is_running(audio_device_t *dev)
 {
 	assert(dev);
@@ -94,6 +102,10 @@ errno_t audio_device_init(audio_device_t *dev, service_id_t id, const char *name
 	dev->buffer.size = 0;
 	dev->buffer.fragment_size = 0;
 
+	dev->sched.lead = MIN_LEAD_FRAGMENTS;
+	dev->sched.underruns = 0;
+	dev->sched.late = 0;
+
 	log_verbose("Initialized device (%p) '%s' with id %" PRIun ".",
 	    dev, dev->name, dev->id);
 
@@ -159,7 +171,7 @@ static errno_t device_sink_connection_callback(audio_sink_t *sink, bool new)
 	if (new && list_count(&sink->connections) == 1) {
 		log_verbose("First connection on device sink '%s'", sink->name);
 
-		errno_t ret = get_buffer(dev);
+		errno_t ret = get_buffer(dev, &dev->sink.format);
 		if (ret != EOK) {
 			log_error("Failed to get device buffer: %s",
 			    str_error(ret));
@@ -169,16 +181,15 @@ static errno_t device_sink_connection_callback(audio_sink_t *sink, bool new)
 		    device_event_callback, dev);
 
 		/*
-		 * Fill the buffer first. Fill the first two fragments,
-		 * so that we stay one fragment ahead
+		 * Fill the buffer first. Fill the first lead fragments,
+		 * so that we stay ahead of the playback position.
 		 */
 		pcm_format_silence(dev->buffer.base, dev->buffer.size,
 		    &dev->sink.format);
-		//TODO add underrun detection.
-		const size_t size = dev->buffer.fragment_size * 2;
-		/* We never cross the end of the buffer here */
-		audio_sink_mix_inputs(&dev->sink, dev->buffer.position, size);
-		advance_buffer(dev, size);
+		dev->sched.lead = MIN_LEAD_FRAGMENTS;
+		for (unsigned i = 0; i < dev->sched.lead; ++i)
+			mix_fragment(dev);
+		getuptime(&dev->sched.last);
 
 		const unsigned frames = dev->buffer.fragment_size /
 		    pcm_format_frame_size(&dev->sink.format);
@@ -221,7 +232,7 @@ static errno_t device_source_connection_callback(audio_source_t *source, bool ne
 	assert(source);
 	audio_device_t *dev = source->private_data;
 	if (new && list_count(&source->connections) == 1) {
-		errno_t ret = get_buffer(dev);
+		errno_t ret = get_buffer(dev, &dev->source.format);
 		if (ret != EOK) {
 			log_error("Failed to get device buffer: %s",
 			    str_error(ret));
@@ -231,7 +242,7 @@ static errno_t device_source_connection_callback(audio_source_t *source, bool ne
 		//TODO set and test format
 
 		const unsigned frames = dev->buffer.fragment_size /
-		    pcm_format_frame_size(&dev->sink.format);
+		    pcm_format_frame_size(&dev->source.format);
 		ret = audio_pcm_start_capture_fragment(dev->sess, frames,
 		    dev->source.format.channels,
 		    dev->source.format.sampling_rate,
@@ -277,15 +288,38 @@ static void device_event_callback(ipc_call_t *icall, void *arg)
 		switch (ipc_get_imethod(&call)) {
 		case PCM_EVENT_FRAMES_PLAYED:
 			getuptime(&time1);
-			//TODO add underrun detection.
-			/* We never cross the end of the buffer here */
-			audio_sink_mix_inputs(&dev->sink, dev->buffer.position,
-			    dev->buffer.fragment_size);
-			advance_buffer(dev, dev->buffer.fragment_size);
+			const usec_t period = pcm_format_size_to_usec(
+			    dev->buffer.fragment_size, &dev->sink.format);
+			const usec_t since_last =
+			    NSEC2USEC(ts_sub_diff(&time1, &dev->sched.last));
+			dev->sched.last = time1;
+			mix_fragment(dev);
+			/*
+			 * Everything mixed ahead was consumed before we got
+			 * here, the device played stale data. Mix one more
+			 * fragment to keep a longer lead from now on.
+			 */
+			if (since_last > period * dev->sched.lead) {
+				++dev->sched.underruns;
+				const unsigned fragments = dev->buffer.size /
+				    dev->buffer.fragment_size;
+				if (dev->sched.lead < fragments / 2) {
+					mix_fragment(dev);
+					++dev->sched.lead;
+				}
+				log_warning("Underrun on device '%s' (%" PRIu64
+				    " total), lead %u fragment(s)", dev->name,
+				    dev->sched.underruns, dev->sched.lead);
+			}
 			struct timespec time2;
 			getuptime(&time2);
-			log_verbose("Time to mix sources: %lld\n",
-			    NSEC2USEC(ts_sub_diff(&time2, &time1)));
+			const usec_t mix_time =
+			    NSEC2USEC(ts_sub_diff(&time2, &time1));
+			/* Deadline is the start of the next period */
+			if (mix_time > period)
+				++dev->sched.late;
+			log_verbose("Time to mix sources: %lld/%lld\n",
+			    mix_time, period);
 			break;
 		case PCM_EVENT_CAPTURE_TERMINATED:
 			log_verbose("Capture terminated");
@@ -339,12 +373,50 @@ static errno_t device_check_format(audio_sink_t *sink)
 	    &sink->format.sampling_rate, &sink->format.sample_format);
 }
 
+/**
+ * Compute fragment size for the given buffer and format.
+ * @param size Size of the device buffer.
+ * @param f Audio format.
+ * @return Fragment size in bytes.
+ *
+ * Fragments tile the buffer exactly and are as close to PERIOD_USEC as the
+ * buffer size allows.
+ */
+static size_t get_fragment_size(size_t size, const pcm_format_t *f)
+{
+	if (pcm_format_is_any(f) || f->sampling_rate == 0)
+		return size / BUFFER_PARTS;
+
+	const size_t frame_size = pcm_format_frame_size(f);
+	const size_t frames = size / frame_size;
+	const size_t period_frames = max(1ULL,
+	    (unsigned long long) f->sampling_rate * PERIOD_USEC / 1000000);
+	size_t parts = max(frames / period_frames, 2 * MIN_LEAD_FRAGMENTS);
+	while (parts > 2 * MIN_LEAD_FRAGMENTS && frames % parts != 0)
+		--parts;
+	return (frames / parts) * frame_size;
+}
+
+/**
+ * Mix one fragment of data at the current buffer position.
+ * @param dev Audio device.
+ */
+static void mix_fragment(audio_device_t *dev)
+{
+	assert(dev);
+	/* We never cross the end of the buffer here */
+	audio_sink_mix_inputs(&dev->sink, dev->buffer.position,
+	    dev->buffer.fragment_size);
+	advance_buffer(dev, dev->buffer.fragment_size);
+}
+
 /**
  * Get access to device buffer.
  * @param dev Audio device.
+ * @param f Format of the data to be transferred.
  * @return Error code.
  */
-static errno_t get_buffer(audio_device_t *dev)
+static errno_t get_buffer(audio_device_t *dev, const pcm_format_t *f)
 {
 	assert(dev);
 	if (!dev->sess) {
@@ -363,7 +435,10 @@ static errno_t get_buffer(audio_device_t *dev)
 	    &preferred_size);
 	if (ret == EOK) {
 		dev->buffer.size = preferred_size;
-		dev->buffer.fragment_size = dev->buffer.size / BUFFER_PARTS;
+		dev->buffer.fragment_size = get_fragment_size(dev->buffer.size,
+		    f);
+		log_verbose("Device buffer %zu bytes, fragment %zu bytes",
+		    dev->buffer.size, dev->buffer.fragment_size);
 		dev->buffer.position = dev->buffer.base;
 	}
 	return ret;
@@ -41,6 +41,8 @@
 #include <fibril_synch.h>
 #include <errno.h>
 #include <ipc/loc.h>
+#include <stdint.h>
+#include <time.h>
 #include <audio_pcm_iface.h>
 
 #include "audio_source.h"
@@ -63,6 +65,17 @@ typedef struct {
 		void *position;
 		size_t fragment_size;
 	} buffer;
+	/** Playback period scheduling */
+	struct {
+		/** Number of fragments mixed ahead of the playback position */
+		unsigned lead;
+		/** Time of the last period event */
+		struct timespec last;
+		/** Number of periods in which the device ran out of data */
+		uint64_t underruns;
+		/** Number of periods mixed after their deadline */
+		uint64_t late;
+	} sched;
 	/** Capture device abstraction. */
 	audio_source_t source;
 	/** Playback device abstraction. */
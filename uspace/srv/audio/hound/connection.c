@@ -106,12 +106,18 @@ errno_t connection_add_source_data(connection_t *connection, void *data,
 	assert(connection);
 	if (!data)
 		return EBADMEM;
-	const size_t needed_frames = pcm_format_size_to_frames(size, &format);
+	/* Source may run at a different rate, ask in its own units */
+	const pcm_format_t *src_format = &connection->source->format;
+	const size_t src_size = pcm_format_is_any(src_format) ? size :
+	    audio_pipe_src_size(&connection->fifo, size, src_format, &format);
+	const size_t needed_frames = pcm_format_is_any(src_format) ?
+	    pcm_format_size_to_frames(size, &format) :
+	    pcm_format_size_to_frames(src_size, src_format);
 	if (needed_frames > audio_pipe_frames(&connection->fifo) &&
 	    connection->source->update_available_data) {
 		log_debug("Asking source to provide more data");
 		connection->source->update_available_data(
-		    connection->source, size);
+		    connection->source, src_size);
 	}
 	log_verbose("Data available after update: %zu",
 	    audio_pipe_bytes(&connection->fifo));
@@ -248,6 +248,29 @@ hound_ctx_t *hound_get_ctx_by_id(hound_t *hound, hound_context_id_t id)
 	return res;
 }
 
+/**
+ * Sum playback scheduling counters of all devices.
+ * @param hound The hound structure.
+ * @param[out] underruns Periods in which a device ran out of data.
+ * @param[out] late Periods mixed after their deadline.
+ */
+void hound_get_device_stats(hound_t *hound, uint64_t *underruns,
+    uint64_t *late)
+{
+	assert(hound);
+	assert(underruns);
+	assert(late);
+
+	*underruns = 0;
+	*late = 0;
+	fibril_mutex_lock(&hound->list_guard);
+	list_foreach(hound->devices, link, audio_device_t, dev) {
+		*underruns += dev->sched.underruns;
+		*late += dev->sched.late;
+	}
+	fibril_mutex_unlock(&hound->list_guard);
+}
+
 /**
  * Add a new device.
  * @param hound The hound structure.
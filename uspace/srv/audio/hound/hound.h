@@ -68,6 +68,8 @@ errno_t hound_init(hound_t *hound);
 errno_t hound_add_ctx(hound_t *hound, hound_ctx_t *ctx);
 errno_t hound_remove_ctx(hound_t *hound, hound_ctx_t *ctx);
 hound_ctx_t *hound_get_ctx_by_id(hound_t *hound, hound_context_id_t id);
+void hound_get_device_stats(hound_t *hound, uint64_t *underruns,
+    uint64_t *late);
 
 errno_t hound_add_device(hound_t *hound, service_id_t id, const char *name);
 errno_t hound_add_source(hound_t *hound, audio_source_t *source);
@@ -36,6 +36,7 @@
 
 #include <macros.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <str_error.h>
 
@@ -62,6 +63,8 @@ hound_ctx_t *hound_record_ctx_get(const char *name)
 		list_initialize(&ctx->streams);
 		fibril_mutex_initialize(&ctx->guard);
 		ctx->source = NULL;
+		ctx->retired.underruns = 0;
+		ctx->retired.overruns = 0;
 		ctx->sink = malloc(sizeof(audio_sink_t));
 		if (!ctx->sink) {
 			free(ctx);
@@ -93,6 +96,8 @@ hound_ctx_t *hound_playback_ctx_get(const char *name)
 		list_initialize(&ctx->streams);
 		fibril_mutex_initialize(&ctx->guard);
 		ctx->sink = NULL;
+		ctx->retired.underruns = 0;
+		ctx->retired.overruns = 0;
 		ctx->source = malloc(sizeof(audio_source_t));
 		if (!ctx->source) {
 			free(ctx);
@@ -171,6 +176,17 @@ typedef struct hound_ctx_stream {
 	fibril_mutex_t guard;
 	/** buffer status change condition */
 	fibril_condvar_t change;
+	/** Number of mixing periods the stream could not fill */
+	uint64_t underruns;
+	/** Number of data buffers dropped because the fifo was full */
+	uint64_t overruns;
+	/** Latency statistics, buffered data at mixing time */
+	struct {
+		usec_t min;
+		usec_t max;
+		uint64_t sum;
+		uint64_t count;
+	} latency;
 } hound_ctx_stream_t;
 
 /**
@@ -209,6 +225,7 @@ static errno_t stream_push_data(hound_ctx_stream_t *stream, audio_data_t *adata)
 	if (stream->allowed_size &&
 	    (audio_pipe_bytes(&stream->fifo) + adata->size >
 	    stream->allowed_size)) {
+		++stream->overruns;
 		fibril_mutex_unlock(&stream->guard);
 		return EOVERFLOW;
 
@@ -232,6 +249,8 @@ static inline void stream_remove(hound_ctx_t *ctx, hound_ctx_stream_t *stream)
 	assert(stream);
 	fibril_mutex_lock(&ctx->guard);
 	list_remove(&stream->link);
+	ctx->retired.underruns += stream->underruns;
+	ctx->retired.overruns += stream->overruns;
 	fibril_mutex_unlock(&ctx->guard);
 }
 
@@ -257,6 +276,18 @@ hound_ctx_stream_t *hound_ctx_create_stream(hound_ctx_t *ctx, int flags,
 		stream->flags = flags;
 		stream->format = format;
 		stream->allowed_size = buffer_size;
+		stream->underruns = 0;
+		stream->overruns = 0;
+		stream->latency.min = 0;
+		stream->latency.max = 0;
+		stream->latency.sum = 0;
+		stream->latency.count = 0;
+		if (flags & HOUND_STREAM_RESAMPLE_FAST)
+			audio_pipe_set_quality(&stream->fifo,
+			    PCM_RESAMPLE_FAST);
+		if (flags & HOUND_STREAM_RESAMPLE_BEST)
+			audio_pipe_set_quality(&stream->fifo,
+			    PCM_RESAMPLE_BEST);
 		stream_append(ctx, stream);
 		log_verbose("CTX: %p added stream; flags:%#x ch: %u r:%u f:%s",
 		    ctx, flags, format.channels, format.sampling_rate,
@@ -283,6 +314,12 @@ void hound_ctx_destroy_stream(hound_ctx_stream_t *stream)
 		    stream->allowed_size, stream->flags,
 		    stream->format.channels, stream->format.sampling_rate,
 		    pcm_sample_format_str(stream->format.sample_format));
+		log_verbose("CTX: %p stream stats: underruns: %" PRIu64
+		    " overruns: %" PRIu64 " latency: %lld/%" PRIu64 "/%lld us",
+		    stream->ctx, stream->underruns, stream->overruns,
+		    stream->latency.min, stream->latency.count ?
+		    stream->latency.sum / stream->latency.count : 0,
+		    stream->latency.max);
 		audio_pipe_fini(&stream->fifo);
 		free(stream);
 	}
@@ -361,12 +398,70 @@ size_t hound_ctx_stream_add_self(hound_ctx_stream_t *stream, void *data,
 {
 	assert(stream);
 	fibril_mutex_lock(&stream->guard);
+	const usec_t latency =
+	    pcm_format_size_to_usec(audio_pipe_bytes(&stream->fifo),
+	    &stream->format);
+	if (stream->latency.count == 0 || latency < stream->latency.min)
+		stream->latency.min = latency;
+	if (latency > stream->latency.max)
+		stream->latency.max = latency;
+	stream->latency.sum += latency;
+	++stream->latency.count;
+
 	const size_t ret = audio_pipe_mix_data(&stream->fifo, data, size, f);
+	if (ret != size && !(stream->flags & HOUND_STREAM_IGNORE_UNDERFLOW))
+		++stream->underruns;
 	fibril_condvar_signal(&stream->change);
 	fibril_mutex_unlock(&stream->guard);
 	return ret;
 }
 
+/**
+ * Collect underrun and overrun counters of all streams of a context.
+ * @param ctx Hound context.
+ * @param[out] stats Statistics structure to fill.
+ *
+ * Device counters are not filled in, they are not tied to a context.
+ */
+void hound_ctx_get_stats(hound_ctx_t *ctx, hound_stats_t *stats)
+{
+	assert(ctx);
+	assert(stats);
+
+	fibril_mutex_lock(&ctx->guard);
+	stats->streams = list_count(&ctx->streams);
+	stats->underruns = ctx->retired.underruns;
+	stats->overruns = ctx->retired.overruns;
+	list_foreach(ctx->streams, link, hound_ctx_stream_t, stream) {
+		fibril_mutex_lock(&stream->guard);
+		stats->underruns += stream->underruns;
+		stats->overruns += stream->overruns;
+		fibril_mutex_unlock(&stream->guard);
+	}
+	fibril_mutex_unlock(&ctx->guard);
+}
+
+/**
+ * Retrieve statistics of a single stream.
+ * @param stream Hound context stream.
+ * @param[out] stats Statistics structure to fill.
+ */
+void hound_ctx_stream_get_stats(hound_ctx_stream_t *stream,
+    hound_stream_stats_t *stats)
+{
+	assert(stream);
+	assert(stats);
+
+	fibril_mutex_lock(&stream->guard);
+	stats->underruns = stream->underruns;
+	stats->overruns = stream->overruns;
+	stats->latency_min = stream->latency.min;
+	stats->latency_max = stream->latency.max;
+	stats->latency_avg = stream->latency.count ?
+	    stream->latency.sum / stream->latency.count : 0;
+	fibril_mutex_unlock(&stream->guard);
+}
+
 /**
  * Block until the stream's buffer is empty.
  * @param stream Target stream.
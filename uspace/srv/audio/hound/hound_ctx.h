@@ -55,6 +55,11 @@ typedef struct {
 	audio_sink_t *sink;
 	/** List access synchronization */
 	fibril_mutex_t guard;
+	/** Counters accumulated from already destroyed streams */
+	struct {
+		uint64_t underruns;
+		uint64_t overruns;
+	} retired;
 } hound_ctx_t;
 
 typedef struct hound_ctx_stream hound_ctx_stream_t;
@@ -76,6 +81,9 @@ errno_t hound_ctx_stream_read(hound_ctx_stream_t *stream, void *buffer, size_t s
 size_t hound_ctx_stream_add_self(hound_ctx_stream_t *stream, void *data,
     size_t size, const pcm_format_t *f);
 void hound_ctx_stream_drain(hound_ctx_stream_t *stream);
+void hound_ctx_get_stats(hound_ctx_t *ctx, hound_stats_t *stats);
+void hound_ctx_stream_get_stats(hound_ctx_stream_t *stream,
+    hound_stream_stats_t *stats);
 
 #endif
 
@@ -151,6 +151,26 @@ static errno_t iface_stream_data_write(void *stream, void *buffer, size_t size)
 	return hound_ctx_stream_write(stream, buffer, size);
 }
 
+static errno_t iface_get_stats(void *server, hound_context_id_t id,
+    hound_stats_t *stats)
+{
+	assert(server);
+	hound_ctx_t *ctx = hound_get_ctx_by_id(server, id);
+	if (!ctx)
+		return ENOENT;
+	hound_ctx_get_stats(ctx, stats);
+	hound_get_device_stats(server, &stats->device_underruns,
+	    &stats->device_late);
+	return EOK;
+}
+
+static errno_t iface_get_stream_stats(void *stream,
+    hound_stream_stats_t *stats)
+{
+	hound_ctx_stream_get_stats(stream, stats);
+	return EOK;
+}
+
 hound_server_iface_t hound_iface = {
 	.add_context = iface_add_context,
 	.rem_context = iface_rem_context,
@@ -163,5 +183,7 @@ hound_server_iface_t hound_iface = {
 	.drain_stream = iface_drain_stream,
 	.stream_data_write = iface_stream_data_write,
 	.stream_data_read = iface_stream_data_read,
+	.get_stats = iface_get_stats,
+	.get_stream_stats = iface_get_stream_stats,
 	.server = NULL,
 };
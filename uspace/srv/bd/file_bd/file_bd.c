@@ -42,7 +42,7 @@
 #include <async.h>
 #include <as.h>
 #include <bd_srv.h>
-#include <fibril_synch.h>
+#include <ipc/bd.h>
 #include <loc.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -52,6 +52,7 @@
 #include <task.h>
 #include <macros.h>
 #include <str.h>
+#include <vfs/vfs.h>
 
 #define NAME "file_bd"
 
@@ -59,11 +60,11 @@
 
 static size_t block_size;
 static aoff64_t num_blocks;
-static FILE *img;
+/** Image file handle. Transfers use explicit positions, so they can overlap. */
+static int img;
 
 static service_id_t service_id;
 static bd_srvs_t bd_srvs;
-static fibril_mutex_t dev_lock;
 
 static void print_usage(void);
 static errno_t file_bd_init(const char *fname);
@@ -75,6 +76,7 @@ static errno_t file_bd_read_blocks(bd_srv_t *, aoff64_t, size_t, void *, size_t)
 static errno_t file_bd_write_blocks(bd_srv_t *, aoff64_t, size_t, const void *, size_t);
 static errno_t file_bd_get_block_size(bd_srv_t *, size_t *);
 static errno_t file_bd_get_num_blocks(bd_srv_t *, aoff64_t *);
+static errno_t file_bd_get_queue_depth(bd_srv_t *, size_t *);
 
 static bd_ops_t file_bd_ops = {
 	.open = file_bd_open,
@@ -82,7 +84,8 @@ static bd_ops_t file_bd_ops = {
 	.read_blocks = file_bd_read_blocks,
 	.write_blocks = file_bd_write_blocks,
 	.get_block_size = file_bd_get_block_size,
-	.get_num_blocks = file_bd_get_num_blocks
+	.get_num_blocks = file_bd_get_num_blocks,
+	.get_queue_depth = file_bd_get_queue_depth
 };
 
 int main(int argc, char **argv)
@@ -181,24 +184,19 @@ static errno_t file_bd_init(const char *fname)
 		return rc;
 	}
 
-	img = fopen(fname, "rb+");
-	if (img == NULL)
-		return EINVAL;
-
-	if (fseek(img, 0, SEEK_END) != 0) {
-		fclose(img);
-		return EIO;
-	}
+	rc = vfs_lookup_open(fname, WALK_REGULAR, MODE_READ | MODE_WRITE,
+	    &img);
+	if (rc != EOK)
+		return rc;
 
-	off64_t img_size = ftell(img);
-	if (img_size < 0) {
-		fclose(img);
+	vfs_stat_t stat;
+	rc = vfs_stat(img, &stat);
+	if (rc != EOK) {
+		vfs_put(img);
 		return EIO;
 	}
 
-	num_blocks = img_size / block_size;
-
-	fibril_mutex_initialize(&dev_lock);
+	num_blocks = stat.size / block_size;
 
 	return EOK;
 }
@@ -237,24 +235,12 @@ static errno_t file_bd_read_blocks(bd_srv_t *bd, uint64_t ba, size_t cnt, void *
 		return ELIMIT;
 	}
 
-	fibril_mutex_lock(&dev_lock);
-
-	clearerr(img);
-	if (fseek(img, ba * block_size, SEEK_SET) < 0) {
-		fibril_mutex_unlock(&dev_lock);
-		return EIO;
-	}
-
-	n_rd = fread(buf, block_size, cnt, img);
-
-	if (ferror(img)) {
-		fibril_mutex_unlock(&dev_lock);
+	aoff64_t pos = ba * block_size;
+	errno_t rc = vfs_read(img, &pos, buf, cnt * block_size, &n_rd);
+	if (rc != EOK)
 		return EIO;	/* Read error */
-	}
-
-	fibril_mutex_unlock(&dev_lock);
 
-	if (n_rd < cnt)
+	if (n_rd < cnt * block_size)
 		return EINVAL;	/* Read beyond end of device */
 
 	return EOK;
@@ -277,27 +263,10 @@ static errno_t file_bd_write_blocks(bd_srv_t *bd, uint64_t ba, size_t cnt,
 		return ELIMIT;
 	}
 
-	fibril_mutex_lock(&dev_lock);
-
-	clearerr(img);
-	if (fseek(img, ba * block_size, SEEK_SET) < 0) {
-		fibril_mutex_unlock(&dev_lock);
-		return EIO;
-	}
-
-	n_wr = fwrite(buf, block_size, cnt, img);
-
-	if (ferror(img) || n_wr < cnt) {
-		fibril_mutex_unlock(&dev_lock);
+	aoff64_t pos = ba * block_size;
+	errno_t rc = vfs_write(img, &pos, buf, cnt * block_size, &n_wr);
+	if (rc != EOK || n_wr < cnt * block_size)
 		return EIO;	/* Write error */
-	}
-
-	if (fflush(img) != 0) {
-		fibril_mutex_unlock(&dev_lock);
-		return EIO;
-	}
-
-	fibril_mutex_unlock(&dev_lock);
 
 	return EOK;
 }
@@ -316,6 +285,13 @@ static errno_t file_bd_get_num_blocks(bd_srv_t *bd, aoff64_t *rnb)
 	return EOK;
 }
 
+/** Get number of transfers which can be in progress at the same time. */
+static errno_t file_bd_get_queue_depth(bd_srv_t *bd, size_t *rqd)
+{
+	*rqd = BD_QUEUE_DEPTH_MAX;
+	return EOK;
+}
+
 /**
  * @}
  */
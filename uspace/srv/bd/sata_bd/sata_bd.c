@@ -65,6 +65,7 @@ static errno_t sata_bd_read_blocks(bd_srv_t *, aoff64_t, size_t, void *, size_t)
 static errno_t sata_bd_write_blocks(bd_srv_t *, aoff64_t, size_t, const void *, size_t);
 static errno_t sata_bd_get_block_size(bd_srv_t *, size_t *);
 static errno_t sata_bd_get_num_blocks(bd_srv_t *, aoff64_t *);
+static errno_t sata_bd_get_queue_depth(bd_srv_t *, size_t *);
 
 static bd_ops_t sata_bd_ops = {
 	.open = sata_bd_open,
@@ -72,7 +73,8 @@ static bd_ops_t sata_bd_ops = {
 	.read_blocks = sata_bd_read_blocks,
 	.write_blocks = sata_bd_write_blocks,
 	.get_block_size = sata_bd_get_block_size,
-	.get_num_blocks = sata_bd_get_num_blocks
+	.get_num_blocks = sata_bd_get_num_blocks,
+	.get_queue_depth = sata_bd_get_queue_depth
 };
 
 static sata_bd_dev_t *bd_srv_sata(bd_srv_t *bd)
@@ -242,6 +244,14 @@ static errno_t sata_bd_get_num_blocks(bd_srv_t *bd, aoff64_t *rnb)
 	return EOK;
 }
 
+/** Get number of requests the device can execute concurrently. */
+static errno_t sata_bd_get_queue_depth(bd_srv_t *bd, size_t *rqd)
+{
+	sata_bd_dev_t *sbd = bd_srv_sata(bd);
+
+	return ahci_get_queue_depth(sbd->sess, rqd);
+}
+
 int main(int argc, char **argv)
 {
 	errno_t rc;
@@ -68,6 +68,13 @@ static errno_t vbds_bd_write_blocks(bd_srv_t *, aoff64_t, size_t, const void *,
     size_t);
 static errno_t vbds_bd_get_block_size(bd_srv_t *, size_t *);
 static errno_t vbds_bd_get_num_blocks(bd_srv_t *, aoff64_t *);
+static errno_t vbds_bd_get_queue_depth(bd_srv_t *, size_t *);
+static errno_t vbds_bd_pool_share(bd_srv_t *, bd_pool_t *);
+static void vbds_bd_pool_unshare(bd_srv_t *, bd_pool_t *);
+static errno_t vbds_bd_pool_read_blocks(bd_srv_t *, aoff64_t, size_t,
+    bd_pool_t *, size_t);
+static errno_t vbds_bd_pool_write_blocks(bd_srv_t *, aoff64_t, size_t,
+    bd_pool_t *, size_t);
 
 static errno_t vbds_bsa_translate(vbds_part_t *, aoff64_t, size_t, aoff64_t *);
 
@@ -90,7 +97,12 @@ static bd_ops_t vbds_bd_ops = {
 	.sync_cache = vbds_bd_sync_cache,
 	.write_blocks = vbds_bd_write_blocks,
 	.get_block_size = vbds_bd_get_block_size,
-	.get_num_blocks = vbds_bd_get_num_blocks
+	.get_num_blocks = vbds_bd_get_num_blocks,
+	.get_queue_depth = vbds_bd_get_queue_depth,
+	.pool_share = vbds_bd_pool_share,
+	.pool_unshare = vbds_bd_pool_unshare,
+	.pool_read_blocks = vbds_bd_pool_read_blocks,
+	.pool_write_blocks = vbds_bd_pool_write_blocks
 };
 
 /** Provide disk access to liblabel */
@@ -1068,6 +1080,113 @@ static errno_t vbds_bd_get_num_blocks(bd_srv_t *bd, aoff64_t *rnb)
 	return EOK;
 }
 
+static errno_t vbds_bd_get_queue_depth(bd_srv_t *bd, size_t *rqd)
+{
+	vbds_part_t *part = bd_srv_part(bd);
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "vbds_bd_get_queue_depth()");
+
+	/* Partition transfers are passed through to the disk */
+	fibril_rwlock_read_lock(&part->lock);
+	rc = block_get_queue_depth(part->disk->svc_id, rqd);
+	fibril_rwlock_read_unlock(&part->lock);
+
+	return rc;
+}
+
+/** Share a client memory pool with the disk.
+ *
+ * Pool transfers are then passed to the disk with translated block
+ * addresses and the data never pass through vbd. If the disk does not
+ * support pools the data are copied to/from the pool here.
+ * pool->arg holds the ID of the pool at the disk plus one or zero if the
+ * pool is not shared with the disk.
+ */
+static errno_t vbds_bd_pool_share(bd_srv_t *bd, bd_pool_t *pool)
+{
+	vbds_part_t *part = bd_srv_part(bd);
+	unsigned id;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "vbds_bd_pool_share()");
+
+	pool->arg = 0;
+	fibril_rwlock_read_lock(&part->lock);
+	if (block_pool_attach(part->disk->svc_id, pool->addr, &id) == EOK)
+		pool->arg = id + 1;
+	fibril_rwlock_read_unlock(&part->lock);
+
+	return EOK;
+}
+
+static void vbds_bd_pool_unshare(bd_srv_t *bd, bd_pool_t *pool)
+{
+	vbds_part_t *part = bd_srv_part(bd);
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "vbds_bd_pool_unshare()");
+
+	if (pool->arg == 0)
+		return;
+
+	fibril_rwlock_read_lock(&part->lock);
+	(void) block_pool_detach(part->disk->svc_id, pool->arg - 1);
+	fibril_rwlock_read_unlock(&part->lock);
+}
+
+static errno_t vbds_bd_pool_read_blocks(bd_srv_t *bd, aoff64_t ba, size_t cnt,
+    bd_pool_t *pool, size_t off)
+{
+	vbds_part_t *part = bd_srv_part(bd);
+	aoff64_t gba;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "vbds_bd_pool_read_blocks()");
+	fibril_rwlock_read_lock(&part->lock);
+
+	if (vbds_bsa_translate(part, ba, cnt, &gba) != EOK) {
+		fibril_rwlock_read_unlock(&part->lock);
+		return ELIMIT;
+	}
+
+	if (pool->arg != 0) {
+		rc = block_pool_read(part->disk->svc_id, gba, cnt,
+		    pool->arg - 1, off);
+	} else {
+		rc = block_read_direct(part->disk->svc_id, gba, cnt,
+		    pool->addr + off);
+	}
+
+	fibril_rwlock_read_unlock(&part->lock);
+	return rc;
+}
+
+static errno_t vbds_bd_pool_write_blocks(bd_srv_t *bd, aoff64_t ba, size_t cnt,
+    bd_pool_t *pool, size_t off)
+{
+	vbds_part_t *part = bd_srv_part(bd);
+	aoff64_t gba;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "vbds_bd_pool_write_blocks()");
+	fibril_rwlock_read_lock(&part->lock);
+
+	if (vbds_bsa_translate(part, ba, cnt, &gba) != EOK) {
+		fibril_rwlock_read_unlock(&part->lock);
+		return ELIMIT;
+	}
+
+	if (pool->arg != 0) {
+		rc = block_pool_write(part->disk->svc_id, gba, cnt,
+		    pool->arg - 1, off);
+	} else {
+		rc = block_write_direct(part->disk->svc_id, gba, cnt,
+		    pool->addr + off);
+	}
+
+	fibril_rwlock_read_unlock(&part->lock);
+	return rc;
+}
+
 void vbds_bd_conn(ipc_call_t *icall, void *arg)
 {
 	vbds_part_t *part;
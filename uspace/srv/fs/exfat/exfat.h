@@ -37,6 +37,7 @@
 #include "exfat_fat.h"
 #include <fibril_synch.h>
 #include <libfs.h>
+#include <runcache.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "../../vfs/vfs.h"
@@ -151,16 +152,14 @@ typedef struct exfat_node {
 	bool			fragmented;
 
 	/*
-	 * Cache of the node's last and "current" cluster to avoid some
-	 * unnecessary FAT walks.
+	 * Cache of the node's last cluster and of the cluster runs visited so
+	 * far to avoid some unnecessary FAT walks.
 	 */
 	/* Node's last cluster in FAT. */
 	bool		lastc_cached_valid;
 	exfat_cluster_t	lastc_cached_value;
-	/* Node's "current" cluster, i.e. where the last I/O took place. */
-	bool		currc_cached_valid;
-	aoff64_t	currc_cached_bn;
-	exfat_cluster_t	currc_cached_value;
+	/* Runs of the node's clusters visited so far. */
+	fs_runcache_t	runs;
 } exfat_node_t;
 
 extern vfs_out_ops_t exfat_ops;
@@ -110,6 +110,49 @@ exfat_cluster_walk(exfat_bs_t *bs, service_id_t service_id,
 	return EOK;
 }
 
+/** Translate a file cluster index of a fragmented node to a cluster number.
+ *
+ * The walk starts at the nearest cluster remembered in the node's run cache
+ * and all clusters visited on the way are added to the cache.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		exFAT node.
+ * @param fcl		Index of the cluster within the node.
+ * @param clp		Place to store the cluster number.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t
+exfat_node_cluster_get(exfat_bs_t *bs, exfat_node_t *nodep, uint32_t fcl,
+    exfat_cluster_t *clp)
+{
+	exfat_cluster_t c;
+	uint32_t cfcl;
+	errno_t rc;
+
+	if (fs_runcache_find(&nodep->runs, fcl, &cfcl, &c) != EOK) {
+		cfcl = 0;
+		c = nodep->firstc;
+		(void) fs_runcache_add(&nodep->runs, cfcl, c);
+	}
+
+	while (cfcl < fcl) {
+		rc = exfat_get_cluster(bs, nodep->idx->service_id, c, &c);
+		if (rc != EOK)
+			return rc;
+
+		if (c < EXFAT_CLST_FIRST || c == EXFAT_CLST_EOF ||
+		    c == EXFAT_CLST_BAD)
+			return EIO;
+
+		cfcl++;
+		(void) fs_runcache_add(&nodep->runs, cfcl, c);
+	}
+
+	*clp = c;
+	return EOK;
+}
+
 /** Read block from file located on a exFAT file system.
  *
  * @param block		Pointer to a block pointer for storing result.
@@ -124,49 +167,39 @@ errno_t
 exfat_block_get(block_t **block, exfat_bs_t *bs, exfat_node_t *nodep,
     aoff64_t bn, int flags)
 {
-	exfat_cluster_t firstc = nodep->firstc;
-	exfat_cluster_t currc = 0;
-	aoff64_t relbn = bn;
+	exfat_cluster_t c;
 	errno_t rc;
 
 	if (!nodep->size)
 		return ELIMIT;
 
-	if (nodep->fragmented) {
-		if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
-		    nodep->lastc_cached_valid) {
-			/*
-			 * This is a request to read a block within the last cluster
-			 * when fortunately we have the last cluster number cached.
-			 */
-			return block_get(block, nodep->idx->service_id, DATA_FS(bs) +
-			    (nodep->lastc_cached_value - EXFAT_CLST_FIRST) * SPC(bs) +
-			    (bn % SPC(bs)), flags);
-		}
+	if (!nodep->fragmented) {
+		return exfat_block_get_by_clst(block, bs,
+		    nodep->idx->service_id, false, nodep->firstc, NULL, bn,
+		    flags);
+	}
 
-		if (nodep->currc_cached_valid && bn >= nodep->currc_cached_bn) {
-			/*
-			 * We can start with the cluster cached by the previous call to
-			 * fat_block_get().
-			 */
-			firstc = nodep->currc_cached_value;
-			relbn -= (nodep->currc_cached_bn / SPC(bs)) * SPC(bs);
-		}
+	if (nodep->firstc < EXFAT_CLST_FIRST ||
+	    nodep->firstc > DATA_CNT(bs) + 2)
+		return ELIMIT;
+
+	if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
+	    nodep->lastc_cached_valid) {
+		/*
+		 * This is a request to read a block within the last cluster
+		 * when fortunately we have the last cluster number cached.
+		 */
+		return block_get(block, nodep->idx->service_id, DATA_FS(bs) +
+		    (nodep->lastc_cached_value - EXFAT_CLST_FIRST) * SPC(bs) +
+		    (bn % SPC(bs)), flags);
 	}
 
-	rc = exfat_block_get_by_clst(block, bs, nodep->idx->service_id,
-	    nodep->fragmented, firstc, &currc, relbn, flags);
+	rc = exfat_node_cluster_get(bs, nodep, bn / SPC(bs), &c);
 	if (rc != EOK)
 		return rc;
 
-	/*
-	 * Update the "current" cluster cache.
-	 */
-	nodep->currc_cached_valid = true;
-	nodep->currc_cached_bn = bn;
-	nodep->currc_cached_value = currc;
-
-	return rc;
+	return block_get(block, nodep->idx->service_id, DATA_FS(bs) +
+	    (c - EXFAT_CLST_FIRST) * SPC(bs) + (bn % SPC(bs)), flags);
 }
 
 /** Read block from file located on a exFAT file system.
@@ -446,8 +479,16 @@ errno_t exfat_chop_clusters(exfat_bs_t *bs, exfat_node_t *nodep, exfat_cluster_t
 	 * Invalidate cached cluster numbers.
 	 */
 	nodep->lastc_cached_valid = false;
-	if (nodep->currc_cached_value != lcl)
-		nodep->currc_cached_valid = false;
+	if (lcl == 0) {
+		fs_runcache_fini(&nodep->runs);
+	} else {
+		uint32_t fcl;
+
+		if (fs_runcache_dcl_lookup(&nodep->runs, lcl, &fcl) == EOK)
+			fs_runcache_truncate(&nodep->runs, fcl + 1);
+		else
+			fs_runcache_fini(&nodep->runs);
+	}
 
 	if (lcl == 0) {
 		/* The node will have zero size and no clusters allocated. */
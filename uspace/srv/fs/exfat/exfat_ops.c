@@ -109,9 +109,7 @@ static void exfat_node_initialize(exfat_node_t *node)
 	node->fragmented = false;
 	node->lastc_cached_valid = false;
 	node->lastc_cached_value = 0;
-	node->currc_cached_valid = false;
-	node->currc_cached_bn = 0;
-	node->currc_cached_value = 0;
+	fs_runcache_init(&node->runs);
 }
 
 static errno_t exfat_node_sync(exfat_node_t *node)
@@ -200,6 +198,7 @@ restart:
 				return rc;
 		}
 		nodep->idx->nodep = NULL;
+		fs_runcache_fini(&nodep->runs);
 		free(nodep->bp);
 		free(nodep);
 
@@ -238,12 +237,14 @@ static errno_t exfat_node_get_new(exfat_node_t **nodepp)
 				idxp_tmp->nodep = NULL;
 				fibril_mutex_unlock(&nodep->lock);
 				fibril_mutex_unlock(&idxp_tmp->lock);
+				fs_runcache_fini(&nodep->runs);
 				free(nodep->bp);
 				free(nodep);
 				return rc;
 			}
 		}
 		idxp_tmp->nodep = NULL;
+		fs_runcache_fini(&nodep->runs);
 		fibril_mutex_unlock(&nodep->lock);
 		fibril_mutex_unlock(&idxp_tmp->lock);
 		fn = FS_NODE(nodep);
@@ -616,6 +617,7 @@ errno_t exfat_node_put(fs_node_t *fn)
 	}
 	fibril_mutex_unlock(&nodep->lock);
 	if (destroy) {
+		fs_runcache_fini(&nodep->runs);
 		free(nodep->bp);
 		free(nodep);
 	}
@@ -710,6 +712,7 @@ errno_t exfat_destroy_node(fs_node_t *fn)
 	}
 
 	exfat_idx_destroy(nodep->idx);
+	fs_runcache_fini(&nodep->runs);
 	free(nodep->bp);
 	free(nodep);
 	return rc;
@@ -812,9 +815,18 @@ errno_t exfat_unlink(fs_node_t *pfn, fs_node_t *cfn, const char *nm)
 	if (rc != EOK)
 		goto error;
 
-	/* remove the index structure from the position hash */
+	fibril_mutex_unlock(&childp->idx->lock);
+
+	/*
+	 * Remove the index structure from the position hash. The index
+	 * structure must not be locked here, see the lock order in
+	 * exfat_idx.c. The position does not change meanwhile as VFS does
+	 * not run link and unlink operations concurrently.
+	 */
 	exfat_idx_hashout(childp->idx);
+
 	/* clear position information */
+	fibril_mutex_lock(&childp->idx->lock);
 	childp->idx->pfc = 0;
 	childp->idx->pdi = 0;
 	fibril_mutex_unlock(&childp->idx->lock);
@@ -1075,6 +1087,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 	uint32_t clusters;
 	rc = exfat_clusters_get(&clusters, bs, service_id, rootp->firstc);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		(void) block_cache_fini(service_id);
 		block_fini(service_id);
@@ -1089,6 +1102,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 	exfat_dentry_t *de;
 	rc = exfat_directory_open(rootp, &di);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		(void) block_cache_fini(service_id);
 		block_fini(service_id);
@@ -1099,6 +1113,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 	/* Initialize the bitmap node. */
 	rc = exfat_directory_find(&di, EXFAT_DENTRY_BITMAP, &de);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		(void) block_cache_fini(service_id);
 		block_fini(service_id);
@@ -1109,6 +1124,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 	rc = exfat_node_get_new_by_pos(&bitmapp, service_id, rootp->firstc,
 	    di.pos);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		(void) block_cache_fini(service_id);
 		block_fini(service_id);
@@ -1129,6 +1145,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 	/* Initialize the uctable node. */
 	rc = exfat_directory_seek(&di, 0);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		free(bitmapp);
 		(void) block_cache_fini(service_id);
@@ -1139,6 +1156,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 
 	rc = exfat_directory_find(&di, EXFAT_DENTRY_UCTABLE, &de);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		free(bitmapp);
 		(void) block_cache_fini(service_id);
@@ -1150,6 +1168,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 	rc = exfat_node_get_new_by_pos(&uctablep, service_id, rootp->firstc,
 	    di.pos);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		free(bitmapp);
 		(void) block_cache_fini(service_id);
@@ -1173,6 +1192,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 		rc = exfat_directory_read_vollabel(&di, info->label,
 		    FS_LABEL_MAXLEN + 1);
 		if (rc != EOK) {
+			fs_runcache_fini(&rootp->runs);
 			free(rootp);
 			free(bitmapp);
 			free(uctablep);
@@ -1185,6 +1205,7 @@ static errno_t exfat_fs_open(service_id_t service_id, enum cache_mode cmode,
 
 	rc = exfat_directory_close(&di);
 	if (rc != EOK) {
+		fs_runcache_fini(&rootp->runs);
 		free(rootp);
 		free(bitmapp);
 		free(uctablep);
@@ -1436,6 +1457,74 @@ exfat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
 	return rc;
 }
 
+static errno_t
+exfat_readdir(service_id_t service_id, fs_index_t index, aoff64_t pos,
+    fs_readdir_t *rd)
+{
+	char name[EXFAT_FILENAME_LEN + 1];
+	exfat_file_dentry_t df;
+	exfat_stream_dentry_t ds;
+	exfat_directory_t di;
+	exfat_node_t *nodep;
+	fs_node_t *fn;
+	errno_t rc, rc2;
+
+	rc = exfat_node_get(&fn, service_id, index);
+	if (rc != EOK)
+		return rc;
+	if (!fn)
+		return ENOENT;
+	nodep = EXFAT_NODE(fn);
+
+	if (nodep->type != EXFAT_DIRECTORY) {
+		(void) exfat_node_put(fn);
+		return ENOTDIR;
+	}
+
+	rc = exfat_directory_open(nodep, &di);
+	if (rc != EOK) {
+		(void) exfat_node_put(fn);
+		return rc;
+	}
+
+	/* Positions have the same meaning as in exfat_read(). */
+	rc = exfat_directory_seek(&di, pos);
+	while (rc == EOK) {
+		rc = exfat_directory_read_file(&di, name, EXFAT_FILENAME_LEN,
+		    &df, &ds);
+		if (rc != EOK)
+			break;
+
+		aoff64_t o = di.pos % (BPS(di.bs) / sizeof(exfat_dentry_t));
+		exfat_idx_t *idx = exfat_idx_get_by_pos(service_id,
+		    nodep->firstc, di.bnum * DPS(di.bs) + o);
+		if (!idx) {
+			rc = ENOMEM;
+			break;
+		}
+		fs_index_t cindex = idx->index;
+		fibril_mutex_unlock(&idx->lock);
+
+		if (fs_readdir_add(rd, name, cindex, di.pos + 1) != EOK)
+			break;
+
+		rc = exfat_directory_next(&di);
+	}
+
+	if (rc == ENOENT) {
+		/* End of the directory. */
+		rc = EOK;
+	}
+
+	rc2 = exfat_directory_close(&di);
+	if (rc == EOK)
+		rc = rc2;
+	rc2 = exfat_node_put(fn);
+	if (rc == EOK)
+		rc = rc2;
+	return rc;
+}
+
 static errno_t exfat_close(service_id_t service_id, fs_index_t index)
 {
 	return EOK;
@@ -1617,6 +1706,7 @@ vfs_out_ops_t exfat_ops = {
 	.mounted = exfat_mounted,
 	.unmounted = exfat_unmounted,
 	.read = exfat_read,
+	.readdir = exfat_readdir,
 	.write = exfat_write,
 	.truncate = exfat_truncate,
 	.close = exfat_close,
@@ -42,6 +42,7 @@
 #include <ns.h>
 #include <async.h>
 #include <errno.h>
+#include <fibril.h>
 #include <str_error.h>
 #include <task.h>
 #include <stdio.h>
@@ -88,6 +89,12 @@ int main(int argc, char **argv)
 		goto err;
 	}
 
+	/*
+	 * Requests for different nodes and instances do not share locks, let
+	 * them run in parallel.
+	 */
+	fibril_enable_multithreaded();
+
 	printf(NAME ": Accepting connections\n");
 	task_retval(0);
 	async_manager();
@@ -37,6 +37,7 @@
 #include "fat_fat.h"
 #include <fibril_synch.h>
 #include <libfs.h>
+#include <runcache.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <macros.h>
@@ -243,20 +244,30 @@ typedef struct fat_node {
 	bool			dirty;
 
 	/*
-	 * Cache of the node's last and "current" cluster to avoid some
-	 * unnecessary FAT walks.
+	 * Cache of the node's last cluster and of the cluster runs visited so far
+	 * to avoid some unnecessary FAT walks.
 	 */
 	/* Node's last cluster in FAT. */
 	bool		lastc_cached_valid;
 	fat_cluster_t	lastc_cached_value;
-	/* Node's "current" cluster, i.e. where the last I/O took place. */
-	bool		currc_cached_valid;
-	aoff64_t	currc_cached_bn;
-	fat_cluster_t	currc_cached_value;
+	/* Runs of the node's clusters visited so far. */
+	fs_runcache_t	runs;
 } fat_node_t;
 
-typedef struct {
+typedef struct fat_instance {
 	bool lfn_enabled;
+	/** Serializes cluster allocation on this file system instance. */
+	fibril_mutex_t alloc_lock;
+	/**
+	 * In-memory map of free clusters built at mount time, one bit per
+	 * cluster with set bits marking free clusters. NULL if the map could
+	 * not be built, in which case FAT1 is scanned on allocation.
+	 */
+	uint32_t *free_map;
+	/** Number of free clusters in free_map. */
+	uint32_t free_count;
+	/** Cluster where the next-fit search for a free cluster starts. */
+	fat_cluster_t free_hint;
 } fat_instance_t;
 
 extern vfs_out_ops_t fat_ops;
@@ -54,8 +54,10 @@
 
 /**
  * The fat_alloc_lock mutex protects all copies of the File Allocation Table
- * during allocation of clusters. The lock does not have to be held durring
- * deallocation of clusters.
+ * during allocation of clusters on devices without a mounted instance.
+ * Mounted instances use their own alloc_lock, which also protects the free
+ * cluster map. The lock does not have to be held durring deallocation of
+ * clusters, except for updating the free cluster map.
  */
 static FIBRIL_MUTEX_INITIALIZE(fat_alloc_lock);
 
@@ -112,6 +114,51 @@ fat_cluster_walk(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc,
 	return EOK;
 }
 
+/** Translate a file cluster index of a node to a cluster number.
+ *
+ * The walk starts at the nearest cluster remembered in the node's run cache
+ * and all clusters visited on the way are added to the cache.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param fcl		Index of the cluster within the node.
+ * @param clp		Place to store the cluster number.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t
+fat_node_cluster_get(fat_bs_t *bs, fat_node_t *nodep, uint32_t fcl,
+    fat_cluster_t *clp)
+{
+	fat_cluster_t clst_last1 = FAT_CLST_LAST1(bs);
+	fat_cluster_t clst_bad = FAT_CLST_BAD(bs);
+	fat_cluster_t c;
+	uint32_t cfcl;
+	errno_t rc;
+
+	if (fs_runcache_find(&nodep->runs, fcl, &cfcl, &c) != EOK) {
+		cfcl = 0;
+		c = nodep->firstc;
+		(void) fs_runcache_add(&nodep->runs, cfcl, c);
+	}
+
+	while (cfcl < fcl) {
+		/* read FAT1 */
+		rc = fat_get_cluster(bs, nodep->idx->service_id, FAT1, c, &c);
+		if (rc != EOK)
+			return rc;
+
+		if (c < FAT_CLST_FIRST || c >= clst_last1 || c == clst_bad)
+			return EIO;
+
+		cfcl++;
+		(void) fs_runcache_add(&nodep->runs, cfcl, c);
+	}
+
+	*clp = c;
+	return EOK;
+}
+
 /** Read block from file located on a FAT file system.
  *
  * @param block		Pointer to a block pointer for storing result.
@@ -126,16 +173,17 @@ errno_t
 fat_block_get(block_t **block, struct fat_bs *bs, fat_node_t *nodep,
     aoff64_t bn, int flags)
 {
-	fat_cluster_t firstc = nodep->firstc;
-	fat_cluster_t currc = 0;
-	aoff64_t relbn = bn;
+	fat_cluster_t c;
 	errno_t rc;
 
 	if (!nodep->size)
 		return ELIMIT;
 
-	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT)
-		goto fall_through;
+	if (nodep->firstc == FAT_CLST_RES0 ||
+	    (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT)) {
+		return _fat_block_get(block, bs, nodep->idx->service_id,
+		    nodep->firstc, NULL, bn, flags);
+	}
 
 	if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
 	    nodep->lastc_cached_valid) {
@@ -147,29 +195,50 @@ fat_block_get(block_t **block, struct fat_bs *bs, fat_node_t *nodep,
 		    CLBN2PBN(bs, nodep->lastc_cached_value, bn), flags);
 	}
 
-	if (nodep->currc_cached_valid && bn >= nodep->currc_cached_bn) {
-		/*
-		 * We can start with the cluster cached by the previous call to
-		 * fat_block_get().
-		 */
-		firstc = nodep->currc_cached_value;
-		relbn -= (nodep->currc_cached_bn / SPC(bs)) * SPC(bs);
-	}
-
-fall_through:
-	rc = _fat_block_get(block, bs, nodep->idx->service_id, firstc,
-	    &currc, relbn, flags);
+	rc = fat_node_cluster_get(bs, nodep, bn / SPC(bs), &c);
 	if (rc != EOK)
 		return rc;
 
-	/*
-	 * Update the "current" cluster cache.
-	 */
-	nodep->currc_cached_valid = true;
-	nodep->currc_cached_bn = bn;
-	nodep->currc_cached_value = currc;
+	return block_get(block, nodep->idx->service_id, CLBN2PBN(bs, c, bn),
+	    flags);
+}
 
-	return rc;
+/** Read the blocks of a file cluster into the block cache.
+ *
+ * Sequential reads are served one block at a time. When such a read
+ * reaches the beginning of a cluster, the blocks of the whole cluster are
+ * read ahead so that they are fetched by concurrent device requests.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param bn		Block number.
+ *
+ * @return		EOK on success or an error code.
+ */
+errno_t
+fat_block_readahead(struct fat_bs *bs, fat_node_t *nodep, aoff64_t bn)
+{
+	fat_cluster_t c;
+	aoff64_t nblocks;
+	errno_t rc;
+
+	if (SPC(bs) <= 1 || bn % SPC(bs) != 0)
+		return EOK;
+
+	if (!nodep->size || nodep->firstc == FAT_CLST_RES0 ||
+	    (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT))
+		return EOK;
+
+	nblocks = ROUND_UP(nodep->size, BPS(bs)) / BPS(bs);
+	if (bn >= nblocks)
+		return EOK;
+
+	rc = fat_node_cluster_get(bs, nodep, bn / SPC(bs), &c);
+	if (rc != EOK)
+		return rc;
+
+	return block_readahead(nodep->idx->service_id, CLBN2PBN(bs, c, bn),
+	    min(SPC(bs), nblocks - bn));
 }
 
 /** Read block from file located on a FAT file system.
@@ -654,12 +723,249 @@ errno_t fat_alloc_shadow_clusters(fat_bs_t *bs, service_id_t service_id,
 	return EOK;
 }
 
+/** Get the file system instance of a device.
+ *
+ * @param service_id	Device service ID of the file system.
+ *
+ * @return		Instance or NULL if the file system is not mounted.
+ */
+static fat_instance_t *fat_instance_get(service_id_t service_id)
+{
+	void *data;
+
+	if (fs_instance_get(service_id, &data) != EOK)
+		return NULL;
+
+	return (fat_instance_t *) data;
+}
+
+/** Mark a cluster as free in the free cluster map. */
+static void fat_free_map_set(fat_instance_t *instance, fat_cluster_t clst)
+{
+	instance->free_map[clst / 32] |= (uint32_t) 1 << (clst % 32);
+}
+
+/** Mark a cluster as used in the free cluster map. */
+static void fat_free_map_clear(fat_instance_t *instance, fat_cluster_t clst)
+{
+	instance->free_map[clst / 32] &= ~((uint32_t) 1 << (clst % 32));
+}
+
+/** Find the first free cluster in a range of the free cluster map.
+ *
+ * @param instance	File system instance.
+ * @param clst		First cluster of the range.
+ * @param end		Cluster following the last cluster of the range.
+ *
+ * @return		Number of the free cluster or @a end if there is
+ *			no free cluster in the range.
+ */
+static fat_cluster_t fat_free_map_next(fat_instance_t *instance,
+    fat_cluster_t clst, fat_cluster_t end)
+{
+	uint32_t word;
+
+	while (clst < end) {
+		word = instance->free_map[clst / 32] >> (clst % 32);
+		if (word == 0) {
+			/* Skip the rest of a fully used word. */
+			clst = ALIGN_DOWN(clst, 32) + 32;
+			continue;
+		}
+
+		while ((word & 1) == 0) {
+			word >>= 1;
+			clst++;
+		}
+		return min(clst, end);
+	}
+
+	return end;
+}
+
+/** Build the in-memory map of free clusters.
+ *
+ * Scans FAT1 once and records which clusters are free so that allocations
+ * do not need to read the FAT.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Device service ID of the file system.
+ * @param instance	File system instance which will own the map.
+ *
+ * @return		EOK on success or an error code.
+ */
+errno_t fat_free_map_init(fat_bs_t *bs, service_id_t service_id,
+    fat_instance_t *instance)
+{
+	fat_cluster_t end = CC(bs) + 2;
+	fat_cluster_t clst;
+	fat_cluster_t value;
+	uint32_t *map;
+	uint32_t free_count = 0;
+	errno_t rc;
+
+	map = calloc((end + 31) / 32, sizeof(uint32_t));
+	if (!map)
+		return ENOMEM;
+
+	instance->free_map = map;
+
+	if (FAT_IS_FAT12(bs)) {
+		for (clst = FAT_CLST_FIRST; clst < end; clst++) {
+			rc = fat_get_cluster(bs, service_id, FAT1, clst,
+			    &value);
+			if (rc != EOK)
+				goto error;
+			if (value == FAT_CLST_RES0) {
+				fat_free_map_set(instance, clst);
+				free_count++;
+			}
+		}
+	} else {
+		/*
+		 * Read FAT1 in large chunks directly from the device. The
+		 * block cache is still empty at mount time.
+		 */
+		size_t csize = FAT_CLST_SIZE(bs);
+		size_t per_sec = BPS(bs) / csize;
+		size_t chunk = 128;
+		size_t sec, i, n;
+		uint8_t *buf;
+
+		buf = malloc(chunk * BPS(bs));
+		if (!buf) {
+			rc = ENOMEM;
+			goto error;
+		}
+
+		clst = 0;
+		for (sec = 0; sec < SF(bs) && clst < end; sec += n) {
+			n = min(chunk, SF(bs) - sec);
+			rc = block_read_direct(service_id, RSCNT(bs) + sec, n,
+			    buf);
+			if (rc != EOK) {
+				free(buf);
+				goto error;
+			}
+
+			for (i = 0; i < n * per_sec && clst < end; i++, clst++) {
+				if (clst < FAT_CLST_FIRST)
+					continue;
+				if (FAT_IS_FAT32(bs)) {
+					value = uint32_t_le2host(
+					    ((uint32_t *) buf)[i]) & FAT32_MASK;
+				} else {
+					value = uint16_t_le2host(
+					    ((uint16_t *) buf)[i]);
+				}
+				if (value == FAT_CLST_RES0) {
+					fat_free_map_set(instance, clst);
+					free_count++;
+				}
+			}
+		}
+
+		free(buf);
+	}
+
+	instance->free_count = free_count;
+	instance->free_hint = FAT_CLST_FIRST;
+	return EOK;
+
+error:
+	fat_free_map_fini(instance);
+	return rc;
+}
+
+/** Destroy the in-memory map of free clusters.
+ *
+ * @param instance	File system instance.
+ */
+void fat_free_map_fini(fat_instance_t *instance)
+{
+	free(instance->free_map);
+	instance->free_map = NULL;
+	instance->free_count = 0;
+}
+
+/** Pick free clusters from the free cluster map.
+ *
+ * The search starts where the previous one ended (next-fit) so that
+ * subsequent allocations tend to form contiguous runs.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param instance	File system instance.
+ * @param nclsts	Number of clusters to allocate.
+ * @param lifo		Array where the clusters are stored in reverse order.
+ *
+ * @return		EOK on success or ENOSPC.
+ */
+static errno_t fat_free_map_alloc(fat_bs_t *bs, fat_instance_t *instance,
+    unsigned nclsts, fat_cluster_t *lifo)
+{
+	fat_cluster_t end = CC(bs) + 2;
+	fat_cluster_t clst = instance->free_hint;
+	unsigned found;
+
+	if (instance->free_count < nclsts)
+		return ENOSPC;
+
+	if (clst < FAT_CLST_FIRST || clst >= end)
+		clst = FAT_CLST_FIRST;
+
+	for (found = 0; found < nclsts; found++) {
+		clst = fat_free_map_next(instance, clst, end);
+		if (clst == end)
+			clst = fat_free_map_next(instance, FAT_CLST_FIRST, end);
+		assert(clst != end);
+
+		fat_free_map_clear(instance, clst);
+		lifo[nclsts - 1 - found] = clst;
+		clst++;
+	}
+
+	instance->free_count -= nclsts;
+	instance->free_hint = clst;
+	return EOK;
+}
+
+/** Search FAT1 for free clusters.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Device service ID of the file system.
+ * @param nclsts	Number of clusters to allocate.
+ * @param lifo		Array where the clusters are stored in reverse order.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t fat_free_scan(fat_bs_t *bs, service_id_t service_id,
+    unsigned nclsts, fat_cluster_t *lifo)
+{
+	unsigned found = 0;
+	fat_cluster_t clst;
+	fat_cluster_t value = 0;
+	errno_t rc;
+
+	for (clst = FAT_CLST_FIRST; clst < CC(bs) + 2 && found < nclsts;
+	    clst++) {
+		rc = fat_get_cluster(bs, service_id, FAT1, clst, &value);
+		if (rc != EOK)
+			return rc;
+
+		if (value == FAT_CLST_RES0)
+			lifo[nclsts - 1 - found++] = clst;
+	}
+
+	return found == nclsts ? EOK : ENOSPC;
+}
+
 /** Allocate clusters in all copies of FAT.
  *
  * This function will attempt to allocate the requested number of clusters in
  * all instances of the FAT.  The FAT will be altered so that the allocated
  * clusters form an independent chain (i.e. a chain which does not belong to any
- * file yet).
+ * file yet). The clusters are chained in ascending order so that runs of
+ * adjacent free clusters become contiguous runs of the file.
  *
  * @param bs		Buffer holding the boot sector of the file system.
  * @param service_id	Device service ID of the file system.
@@ -676,62 +982,59 @@ fat_alloc_clusters(fat_bs_t *bs, service_id_t service_id, unsigned nclsts,
     fat_cluster_t *mcl, fat_cluster_t *lcl)
 {
 	fat_cluster_t *lifo;    /* stack for storing free cluster numbers */
-	unsigned found = 0;     /* top of the free cluster number stack */
-	fat_cluster_t clst;
-	fat_cluster_t value = 0;
 	fat_cluster_t clst_last1 = FAT_CLST_LAST1(bs);
-	errno_t rc = EOK;
+	fat_instance_t *instance;
+	fibril_mutex_t *lock;
+	unsigned c;
+	errno_t rc;
 
 	lifo = (fat_cluster_t *) malloc(nclsts * sizeof(fat_cluster_t));
 	if (!lifo)
 		return ENOMEM;
 
-	/*
-	 * Search FAT1 for unused clusters.
-	 */
-	fibril_mutex_lock(&fat_alloc_lock);
-	for (clst = FAT_CLST_FIRST; clst < CC(bs) + 2 && found < nclsts;
-	    clst++) {
-		rc = fat_get_cluster(bs, service_id, FAT1, clst, &value);
-		if (rc != EOK)
-			break;
+	instance = fat_instance_get(service_id);
+	lock = instance ? &instance->alloc_lock : &fat_alloc_lock;
 
-		if (value == FAT_CLST_RES0) {
-			/*
-			 * The cluster is free. Put it into our stack
-			 * of found clusters and mark it as non-free.
-			 */
-			lifo[found] = clst;
-			rc = fat_set_cluster(bs, service_id, FAT1, clst,
-			    (found == 0) ?  clst_last1 : lifo[found - 1]);
-			if (rc != EOK)
-				break;
+	fibril_mutex_lock(lock);
+	if (instance && instance->free_map)
+		rc = fat_free_map_alloc(bs, instance, nclsts, lifo);
+	else
+		rc = fat_free_scan(bs, service_id, nclsts, lifo);
+	if (rc != EOK)
+		goto out;
 
-			found++;
-		}
+	for (c = 0; c < nclsts; c++) {
+		rc = fat_set_cluster(bs, service_id, FAT1, lifo[c],
+		    (c == 0) ? clst_last1 : lifo[c - 1]);
+		if (rc != EOK)
+			break;
 	}
 
-	if (rc == EOK && found == nclsts) {
+	if (rc == EOK) {
 		rc = fat_alloc_shadow_clusters(bs, service_id, lifo, nclsts);
 		if (rc == EOK) {
-			*mcl = lifo[found - 1];
+			*mcl = lifo[nclsts - 1];
 			*lcl = lifo[0];
-			free(lifo);
-			fibril_mutex_unlock(&fat_alloc_lock);
-			return EOK;
+			goto out;
 		}
 	}
 
 	/* If something wrong - free the clusters */
-	while (found--) {
-		(void) fat_set_cluster(bs, service_id, FAT1, lifo[found],
+	while (c--) {
+		(void) fat_set_cluster(bs, service_id, FAT1, lifo[c],
 		    FAT_CLST_RES0);
 	}
 
-	free(lifo);
-	fibril_mutex_unlock(&fat_alloc_lock);
+	if (instance && instance->free_map) {
+		for (c = 0; c < nclsts; c++)
+			fat_free_map_set(instance, lifo[c]);
+		instance->free_count += nclsts;
+	}
 
-	return ENOSPC;
+out:
+	free(lifo);
+	fibril_mutex_unlock(lock);
+	return rc;
 }
 
 /** Free clusters forming a cluster chain in all copies of FAT.
@@ -748,6 +1051,7 @@ fat_free_clusters(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc)
 	unsigned fatno;
 	fat_cluster_t nextc = 0;
 	fat_cluster_t clst_bad = FAT_CLST_BAD(bs);
+	fat_instance_t *instance = fat_instance_get(service_id);
 	errno_t rc;
 
 	/* Mark all clusters in the chain as free in all copies of FAT. */
@@ -765,6 +1069,13 @@ fat_free_clusters(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc)
 				return rc;
 		}
 
+		if (instance && instance->free_map) {
+			fibril_mutex_lock(&instance->alloc_lock);
+			fat_free_map_set(instance, firstc);
+			instance->free_count++;
+			fibril_mutex_unlock(&instance->alloc_lock);
+		}
+
 		firstc = nextc;
 	}
 
@@ -837,8 +1148,16 @@ errno_t fat_chop_clusters(fat_bs_t *bs, fat_node_t *nodep, fat_cluster_t lcl)
 	 * Invalidate cached cluster numbers.
 	 */
 	nodep->lastc_cached_valid = false;
-	if (nodep->currc_cached_value != lcl)
-		nodep->currc_cached_valid = false;
+	if (lcl == FAT_CLST_RES0) {
+		fs_runcache_fini(&nodep->runs);
+	} else {
+		uint32_t fcl;
+
+		if (fs_runcache_dcl_lookup(&nodep->runs, lcl, &fcl) == EOK)
+			fs_runcache_truncate(&nodep->runs, fcl + 1);
+		else
+			fs_runcache_fini(&nodep->runs);
+	}
 
 	if (lcl == FAT_CLST_RES0) {
 		/* The node will have zero size and no clusters allocated. */
@@ -61,6 +61,9 @@ typedef struct {
 	link_t link;
 	service_id_t service_id;
 
+	/** Mutex protecting the index allocator of this instance. */
+	fibril_mutex_t lock;
+
 	/** Next unassigned index. */
 	fs_index_t next;
 	/** Number of remaining unassigned indices. */
@@ -70,8 +73,8 @@ typedef struct {
 	list_t freed_list;
 } unused_t;
 
-/** Mutex protecting the list of unused structures. */
-static FIBRIL_MUTEX_INITIALIZE(unused_lock);
+/** Lock protecting the list of unused structures. */
+static FIBRIL_RWLOCK_INITIALIZE(unused_lock);
 
 /** List of unused structures. */
 static LIST_INITIALIZE(unused_list);
@@ -80,35 +83,69 @@ static void unused_initialize(unused_t *u, service_id_t service_id)
 {
 	link_initialize(&u->link);
 	u->service_id = service_id;
+	fibril_mutex_initialize(&u->lock);
 	u->next = 0;
 	u->remaining = ((uint64_t)((fs_index_t)-1)) + 1;
 	list_initialize(&u->freed_list);
 }
 
+/** Find the unused structure of an instance.
+ *
+ * @param service_id	Service ID of the instance.
+ * @param lock		If true, the structure is returned with its mutex
+ *			held. Otherwise the caller must hold unused_lock.
+ */
 static unused_t *unused_find(service_id_t service_id, bool lock)
 {
+	unused_t *found = NULL;
+
 	if (lock)
-		fibril_mutex_lock(&unused_lock);
+		fibril_rwlock_read_lock(&unused_lock);
 
 	list_foreach(unused_list, link, unused_t, u) {
-		if (u->service_id == service_id)
-			return u;
+		if (u->service_id == service_id) {
+			found = u;
+			break;
+		}
 	}
 
-	if (lock)
-		fibril_mutex_unlock(&unused_lock);
-	return NULL;
+	/*
+	 * The structure cannot go away while the instance is mounted, so it is
+	 * safe to drop the list lock before taking the per-instance mutex.
+	 */
+	if (lock) {
+		fibril_rwlock_read_unlock(&unused_lock);
+		if (found)
+			fibril_mutex_lock(&found->lock);
+	}
+
+	return found;
 }
 
-/** Mutex protecting the up_hash and ui_hash. */
-static FIBRIL_MUTEX_INITIALIZE(used_lock);
+/** Number of independently locked shards of each index hash. */
+#define IDX_SHARDS	16
+
+/**
+ * One shard of a hash of used fat_idx_t structures. Lookups in a shard
+ * proceed in parallel, insertions and removals are exclusive.
+ *
+ * Lock order: a shard lock is taken before the lock of an index structure
+ * found in it, and a shard of the position hash before a shard of the
+ * index hash. Callers of fat_idx_hashin(), fat_idx_hashout() and
+ * fat_idx_destroy() must therefore not hold the lock of the index
+ * structure.
+ */
+typedef struct {
+	fibril_rwlock_t lock;
+	hash_table_t table;
+} idx_shard_t;
 
 /**
  * Global hash table of all used fat_idx_t structures.
  * The index structures are hashed by the service_id, parent node's first
  * cluster and index within the parent directory.
  */
-static hash_table_t up_hash;
+static idx_shard_t up_hash[IDX_SHARDS];
 
 typedef struct {
 	service_id_t service_id;
@@ -156,11 +193,21 @@ static hash_table_ops_t uph_ops = {
 	.remove_callback = NULL,
 };
 
+static idx_shard_t *up_shard(const pos_key_t *key)
+{
+	return &up_hash[pos_key_hash(key) % IDX_SHARDS];
+}
+
+static idx_shard_t *up_shard_of(fat_idx_t *fidx)
+{
+	return &up_hash[pos_hash(&fidx->uph_link) % IDX_SHARDS];
+}
+
 /**
  * Global hash table of all used fat_idx_t structures.
  * The index structures are hashed by the service_id and index.
  */
-static hash_table_t ui_hash;
+static idx_shard_t ui_hash[IDX_SHARDS];
 
 typedef struct {
 	service_id_t service_id;
@@ -202,6 +249,16 @@ static hash_table_ops_t uih_ops = {
 	.remove_callback = idx_remove_callback,
 };
 
+static idx_shard_t *ui_shard(const idx_key_t *key)
+{
+	return &ui_hash[idx_key_hash(key) % IDX_SHARDS];
+}
+
+static idx_shard_t *ui_shard_of(fat_idx_t *fidx)
+{
+	return &ui_hash[idx_hash(&fidx->uih_link) % IDX_SHARDS];
+}
+
 /** Allocate a VFS index which is not currently in use. */
 static bool fat_index_alloc(service_id_t service_id, fs_index_t *index)
 {
@@ -220,7 +277,7 @@ static bool fat_index_alloc(service_id_t service_id, fs_index_t *index)
 			 */
 			*index = u->next++;
 			--u->remaining;
-			fibril_mutex_unlock(&unused_lock);
+			fibril_mutex_unlock(&u->lock);
 			return true;
 		}
 	} else {
@@ -233,7 +290,7 @@ static bool fat_index_alloc(service_id_t service_id, fs_index_t *index)
 			list_remove(&f->link);
 			free(f);
 		}
-		fibril_mutex_unlock(&unused_lock);
+		fibril_mutex_unlock(&u->lock);
 		return true;
 	}
 	/*
@@ -241,7 +298,7 @@ static bool fat_index_alloc(service_id_t service_id, fs_index_t *index)
 	 * theoretically still possible (e.g. too many open unlinked nodes or
 	 * too many zero-sized nodes).
 	 */
-	fibril_mutex_unlock(&unused_lock);
+	fibril_mutex_unlock(&u->lock);
 	return false;
 }
 
@@ -291,7 +348,7 @@ static void fat_index_free(service_id_t service_id, fs_index_t index)
 				if (lnk->prev != &u->freed_list.head)
 					try_coalesce_intervals(lnk->prev, lnk,
 					    lnk);
-				fibril_mutex_unlock(&unused_lock);
+				fibril_mutex_unlock(&u->lock);
 				return;
 			}
 			if (f->last == index - 1) {
@@ -299,7 +356,7 @@ static void fat_index_free(service_id_t service_id, fs_index_t index)
 				if (lnk->next != &u->freed_list.head)
 					try_coalesce_intervals(lnk, lnk->next,
 					    lnk);
-				fibril_mutex_unlock(&unused_lock);
+				fibril_mutex_unlock(&u->lock);
 				return;
 			}
 			if (index > f->first) {
@@ -310,7 +367,7 @@ static void fat_index_free(service_id_t service_id, fs_index_t index)
 				n->first = index;
 				n->last = index;
 				list_insert_before(&n->link, lnk);
-				fibril_mutex_unlock(&unused_lock);
+				fibril_mutex_unlock(&u->lock);
 				return;
 			}
 
@@ -324,7 +381,7 @@ static void fat_index_free(service_id_t service_id, fs_index_t index)
 		n->last = index;
 		list_append(&n->link, &u->freed_list);
 	}
-	fibril_mutex_unlock(&unused_lock);
+	fibril_mutex_unlock(&u->lock);
 }
 
 static errno_t fat_idx_create(fat_idx_t **fidxp, service_id_t service_id)
@@ -354,16 +411,15 @@ errno_t fat_idx_get_new(fat_idx_t **fidxp, service_id_t service_id)
 	fat_idx_t *fidx;
 	errno_t rc;
 
-	fibril_mutex_lock(&used_lock);
 	rc = fat_idx_create(&fidx, service_id);
-	if (rc != EOK) {
-		fibril_mutex_unlock(&used_lock);
+	if (rc != EOK)
 		return rc;
-	}
 
-	hash_table_insert(&ui_hash, &fidx->uih_link);
+	idx_shard_t *shard = ui_shard_of(fidx);
+	fibril_rwlock_write_lock(&shard->lock);
+	hash_table_insert(&shard->table, &fidx->uih_link);
 	fibril_mutex_lock(&fidx->lock);
-	fibril_mutex_unlock(&used_lock);
+	fibril_rwlock_write_unlock(&shard->lock);
 
 	*fidxp = fidx;
 	return EOK;
@@ -380,8 +436,21 @@ fat_idx_get_by_pos(service_id_t service_id, fat_cluster_t pfc, unsigned pdi)
 		.pdi = pdi,
 	};
 
-	fibril_mutex_lock(&used_lock);
-	ht_link_t *l = hash_table_find(&up_hash, &pos_key);
+	idx_shard_t *shard = up_shard(&pos_key);
+
+	/* Most lookups hit, try that without excluding other readers. */
+	fibril_rwlock_read_lock(&shard->lock);
+	ht_link_t *l = hash_table_find(&shard->table, &pos_key);
+	if (l) {
+		fidx = hash_table_get_inst(l, fat_idx_t, uph_link);
+		fibril_mutex_lock(&fidx->lock);
+		fibril_rwlock_read_unlock(&shard->lock);
+		return fidx;
+	}
+	fibril_rwlock_read_unlock(&shard->lock);
+
+	fibril_rwlock_write_lock(&shard->lock);
+	l = hash_table_find(&shard->table, &pos_key);
 	if (l) {
 		fidx = hash_table_get_inst(l, fat_idx_t, uph_link);
 	} else {
@@ -389,34 +458,42 @@ fat_idx_get_by_pos(service_id_t service_id, fat_cluster_t pfc, unsigned pdi)
 
 		rc = fat_idx_create(&fidx, service_id);
 		if (rc != EOK) {
-			fibril_mutex_unlock(&used_lock);
+			fibril_rwlock_write_unlock(&shard->lock);
 			return NULL;
 		}
 
 		fidx->pfc = pfc;
 		fidx->pdi = pdi;
 
-		hash_table_insert(&up_hash, &fidx->uph_link);
-		hash_table_insert(&ui_hash, &fidx->uih_link);
+		hash_table_insert(&shard->table, &fidx->uph_link);
+
+		idx_shard_t *ushard = ui_shard_of(fidx);
+		fibril_rwlock_write_lock(&ushard->lock);
+		hash_table_insert(&ushard->table, &fidx->uih_link);
+		fibril_rwlock_write_unlock(&ushard->lock);
 	}
 	fibril_mutex_lock(&fidx->lock);
-	fibril_mutex_unlock(&used_lock);
+	fibril_rwlock_write_unlock(&shard->lock);
 
 	return fidx;
 }
 
 void fat_idx_hashin(fat_idx_t *idx)
 {
-	fibril_mutex_lock(&used_lock);
-	hash_table_insert(&up_hash, &idx->uph_link);
-	fibril_mutex_unlock(&used_lock);
+	idx_shard_t *shard = up_shard_of(idx);
+
+	fibril_rwlock_write_lock(&shard->lock);
+	hash_table_insert(&shard->table, &idx->uph_link);
+	fibril_rwlock_write_unlock(&shard->lock);
 }
 
 void fat_idx_hashout(fat_idx_t *idx)
 {
-	fibril_mutex_lock(&used_lock);
-	hash_table_remove_item(&up_hash, &idx->uph_link);
-	fibril_mutex_unlock(&used_lock);
+	idx_shard_t *shard = up_shard_of(idx);
+
+	fibril_rwlock_write_lock(&shard->lock);
+	hash_table_remove_item(&shard->table, &idx->uph_link);
+	fibril_rwlock_write_unlock(&shard->lock);
 }
 
 fat_idx_t *
@@ -429,13 +506,15 @@ fat_idx_get_by_index(service_id_t service_id, fs_index_t index)
 		.index = index,
 	};
 
-	fibril_mutex_lock(&used_lock);
-	ht_link_t *l = hash_table_find(&ui_hash, &idx_key);
+	idx_shard_t *shard = ui_shard(&idx_key);
+
+	fibril_rwlock_read_lock(&shard->lock);
+	ht_link_t *l = hash_table_find(&shard->table, &idx_key);
 	if (l) {
 		fidx = hash_table_get_inst(l, fat_idx_t, uih_link);
 		fibril_mutex_lock(&fidx->lock);
 	}
-	fibril_mutex_unlock(&used_lock);
+	fibril_rwlock_read_unlock(&shard->lock);
 
 	return fidx;
 }
@@ -453,14 +532,16 @@ void fat_idx_destroy(fat_idx_t *idx)
 
 	assert(idx->pfc == FAT_CLST_RES0);
 
-	fibril_mutex_lock(&used_lock);
+	idx_shard_t *shard = ui_shard(&idx_key);
+
+	fibril_rwlock_write_lock(&shard->lock);
 	/*
 	 * Since we can only free unlinked nodes, the index structure is not
 	 * present in the position hash (uph). We therefore hash it out from
 	 * the index hash only.
 	 */
-	hash_table_remove(&ui_hash, &idx_key);
-	fibril_mutex_unlock(&used_lock);
+	hash_table_remove(&shard->table, &idx_key);
+	fibril_rwlock_write_unlock(&shard->lock);
 	/* Release the VFS index. */
 	fat_index_free(idx_key.service_id, idx_key.index);
 	/* The index structure itself is freed in idx_remove_callback(). */
@@ -468,21 +549,37 @@ void fat_idx_destroy(fat_idx_t *idx)
 
 errno_t fat_idx_init(void)
 {
-	if (!hash_table_create(&up_hash, 0, 0, &uph_ops))
-		return ENOMEM;
-	if (!hash_table_create(&ui_hash, 0, 0, &uih_ops)) {
-		hash_table_destroy(&up_hash);
-		return ENOMEM;
+	unsigned i;
+
+	for (i = 0; i < IDX_SHARDS; i++) {
+		fibril_rwlock_initialize(&up_hash[i].lock);
+		fibril_rwlock_initialize(&ui_hash[i].lock);
+		if (!hash_table_create(&up_hash[i].table, 0, 0, &uph_ops))
+			goto error;
+		if (!hash_table_create(&ui_hash[i].table, 0, 0, &uih_ops)) {
+			hash_table_destroy(&up_hash[i].table);
+			goto error;
+		}
 	}
 	return EOK;
+
+error:
+	while (i-- > 0) {
+		hash_table_destroy(&up_hash[i].table);
+		hash_table_destroy(&ui_hash[i].table);
+	}
+	return ENOMEM;
 }
 
 void fat_idx_fini(void)
 {
-	/* We assume the hash tables are empty. */
-	assert(hash_table_empty(&up_hash) && hash_table_empty(&ui_hash));
-	hash_table_destroy(&up_hash);
-	hash_table_destroy(&ui_hash);
+	for (unsigned i = 0; i < IDX_SHARDS; i++) {
+		/* We assume the hash tables are empty. */
+		assert(hash_table_empty(&up_hash[i].table) &&
+		    hash_table_empty(&ui_hash[i].table));
+		hash_table_destroy(&up_hash[i].table);
+		hash_table_destroy(&ui_hash[i].table);
+	}
 }
 
 errno_t fat_idx_init_by_service_id(service_id_t service_id)
@@ -494,24 +591,30 @@ errno_t fat_idx_init_by_service_id(service_id_t service_id)
 	if (!u)
 		return ENOMEM;
 	unused_initialize(u, service_id);
-	fibril_mutex_lock(&unused_lock);
+	fibril_rwlock_write_lock(&unused_lock);
 	if (!unused_find(service_id, false)) {
 		list_append(&u->link, &unused_list);
 	} else {
 		free(u);
 		rc = EEXIST;
 	}
-	fibril_mutex_unlock(&unused_lock);
+	fibril_rwlock_write_unlock(&unused_lock);
 	return rc;
 }
 
+/** Argument of the per-instance removal callbacks. */
+typedef struct {
+	service_id_t service_id;
+	hash_table_t *table;
+} rm_arg_t;
+
 static bool rm_pos_service_id(ht_link_t *item, void *arg)
 {
-	service_id_t service_id = *(service_id_t *)arg;
+	rm_arg_t *rm = arg;
 	fat_idx_t *fidx = hash_table_get_inst(item, fat_idx_t, uph_link);
 
-	if (fidx->service_id == service_id) {
-		hash_table_remove_item(&up_hash, item);
+	if (fidx->service_id == rm->service_id) {
+		hash_table_remove_item(rm->table, item);
 	}
 
 	return true;
@@ -519,11 +622,11 @@ static bool rm_pos_service_id(ht_link_t *item, void *arg)
 
 static bool rm_idx_service_id(ht_link_t *item, void *arg)
 {
-	service_id_t service_id = *(service_id_t *)arg;
+	rm_arg_t *rm = arg;
 	fat_idx_t *fidx = hash_table_get_inst(item, fat_idx_t, uih_link);
 
-	if (fidx->service_id == service_id) {
-		hash_table_remove_item(&ui_hash, item);
+	if (fidx->service_id == rm->service_id) {
+		hash_table_remove_item(rm->table, item);
 	}
 
 	return true;
@@ -536,18 +639,30 @@ void fat_idx_fini_by_service_id(service_id_t service_id)
 	 * Process up_hash first and ui_hash second because the index structure
 	 * is actually removed in idx_remove_callback().
 	 */
-	fibril_mutex_lock(&used_lock);
-	hash_table_apply(&up_hash, rm_pos_service_id, &service_id);
-	hash_table_apply(&ui_hash, rm_idx_service_id, &service_id);
-	fibril_mutex_unlock(&used_lock);
+	rm_arg_t rm;
+
+	rm.service_id = service_id;
+	for (unsigned i = 0; i < IDX_SHARDS; i++) {
+		fibril_rwlock_write_lock(&up_hash[i].lock);
+		rm.table = &up_hash[i].table;
+		hash_table_apply(rm.table, rm_pos_service_id, &rm);
+		fibril_rwlock_write_unlock(&up_hash[i].lock);
+	}
+	for (unsigned i = 0; i < IDX_SHARDS; i++) {
+		fibril_rwlock_write_lock(&ui_hash[i].lock);
+		rm.table = &ui_hash[i].table;
+		hash_table_apply(rm.table, rm_idx_service_id, &rm);
+		fibril_rwlock_write_unlock(&ui_hash[i].lock);
+	}
 
 	/*
 	 * Free the unused and freed structures for this instance.
 	 */
-	unused_t *u = unused_find(service_id, true);
+	fibril_rwlock_write_lock(&unused_lock);
+	unused_t *u = unused_find(service_id, false);
 	assert(u);
 	list_remove(&u->link);
-	fibril_mutex_unlock(&unused_lock);
+	fibril_rwlock_write_unlock(&unused_lock);
 
 	while (!list_empty(&u->freed_list)) {
 		freed_t *f;
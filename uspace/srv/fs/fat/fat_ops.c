@@ -108,9 +108,7 @@ static void fat_node_initialize(fat_node_t *node)
 	node->dirty = false;
 	node->lastc_cached_valid = false;
 	node->lastc_cached_value = 0;
-	node->currc_cached_valid = false;
-	node->currc_cached_bn = 0;
-	node->currc_cached_value = 0;
+	fs_runcache_init(&node->runs);
 }
 
 static errno_t fat_node_sync(fat_node_t *node)
@@ -192,6 +190,7 @@ restart:
 				return rc;
 		}
 		nodep->idx->nodep = NULL;
+		fs_runcache_fini(&nodep->runs);
 		free(nodep->bp);
 		free(nodep);
 
@@ -230,12 +229,14 @@ static errno_t fat_node_get_new(fat_node_t **nodepp)
 				idxp_tmp->nodep = NULL;
 				fibril_mutex_unlock(&nodep->lock);
 				fibril_mutex_unlock(&idxp_tmp->lock);
+				fs_runcache_fini(&nodep->runs);
 				free(nodep->bp);
 				free(nodep);
 				return rc;
 			}
 		}
 		idxp_tmp->nodep = NULL;
+		fs_runcache_fini(&nodep->runs);
 		fibril_mutex_unlock(&nodep->lock);
 		fibril_mutex_unlock(&idxp_tmp->lock);
 		fn = FS_NODE(nodep);
@@ -476,6 +477,7 @@ errno_t fat_node_put(fs_node_t *fn)
 	}
 	fibril_mutex_unlock(&nodep->lock);
 	if (destroy) {
+		fs_runcache_fini(&nodep->runs);
 		free(nodep->bp);
 		free(nodep);
 	}
@@ -569,6 +571,7 @@ errno_t fat_destroy_node(fs_node_t *fn)
 	}
 
 	fat_idx_destroy(nodep->idx);
+	fs_runcache_fini(&nodep->runs);
 	free(nodep->bp);
 	free(nodep);
 	return rc;
@@ -730,9 +733,18 @@ errno_t fat_unlink(fs_node_t *pfn, fs_node_t *cfn, const char *nm)
 	if (rc != EOK)
 		goto error;
 
-	/* remove the index structure from the position hash */
+	fibril_mutex_unlock(&childp->idx->lock);
+
+	/*
+	 * Remove the index structure from the position hash. The index
+	 * structure must not be locked here, see the lock order in fat_idx.c.
+	 * The position does not change meanwhile as VFS does not run link
+	 * and unlink operations concurrently.
+	 */
 	fat_idx_hashout(childp->idx);
+
 	/* clear position information */
+	fibril_mutex_lock(&childp->idx->lock);
 	childp->idx->pfc = FAT_CLST_RES0;
 	childp->idx->pdi = 0;
 	fibril_mutex_unlock(&childp->idx->lock);
@@ -1024,6 +1036,7 @@ static errno_t fat_fs_open(service_id_t service_id, enum cache_mode cmode,
 
 static void fat_fs_close(service_id_t service_id, fs_node_t *rfn)
 {
+	fs_runcache_fini(&FAT_NODE(rfn)->runs);
 	free(rfn->data);
 	free(rfn);
 	(void) block_cache_fini(service_id);
@@ -1088,6 +1101,10 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 	if (!instance)
 		return ENOMEM;
 	instance->lfn_enabled = true;
+	fibril_mutex_initialize(&instance->alloc_lock);
+	instance->free_map = NULL;
+	instance->free_count = 0;
+	instance->free_hint = FAT_CLST_FIRST;
 
 	/* Parse mount options. */
 	char *mntopts = (char *) opts;
@@ -1105,12 +1122,20 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 		return rc;
 	}
 
+	/*
+	 * Build the map of free clusters. If this fails, allocations fall
+	 * back to scanning FAT1.
+	 */
+	(void) fat_free_map_init(block_bb_get(service_id), service_id,
+	    instance);
+
 	fibril_mutex_lock(&ridxp->lock);
 
 	rc = fs_instance_create(service_id, instance);
 	if (rc != EOK) {
 		fibril_mutex_unlock(&ridxp->lock);
 		fat_fs_close(service_id, rfn);
+		fat_free_map_fini(instance);
 		free(instance);
 		return rc;
 	}
@@ -1125,6 +1150,8 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 
 static errno_t fat_update_fat32_fsinfo(service_id_t service_id)
 {
+	fat_instance_t *instance;
+	void *data;
 	fat_bs_t *bs;
 	fat32_fsinfo_t *info;
 	block_t *b;
@@ -1147,8 +1174,16 @@ static errno_t fat_update_fat32_fsinfo(service_id_t service_id)
 		return EINVAL;
 	}
 
-	/* For now, invalidate the counter. */
-	info->free_clusters = host2uint16_t_le(-1);
+	if (fs_instance_get(service_id, &data) == EOK &&
+	    ((fat_instance_t *) data)->free_map != NULL) {
+		instance = (fat_instance_t *) data;
+		info->free_clusters = host2uint32_t_le(instance->free_count);
+		info->last_allocated_cluster =
+		    host2uint32_t_le(instance->free_hint);
+	} else {
+		/* Without the free cluster map, invalidate the counter. */
+		info->free_clusters = host2uint32_t_le(-1);
+	}
 
 	b->dirty = true;
 	return block_put(b);
@@ -1200,6 +1235,7 @@ static errno_t fat_unmounted(service_id_t service_id)
 	void *data;
 	if (fs_instance_get(service_id, &data) == EOK) {
 		fs_instance_destroy(service_id);
+		fat_free_map_fini((fat_instance_t *) data);
 		free(data);
 	}
 
@@ -1247,6 +1283,7 @@ fat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
 		} else {
 			bytes = min(len, BPS(bs) - pos % BPS(bs));
 			bytes = min(bytes, nodep->size - pos);
+			(void) fat_block_readahead(bs, nodep, pos / BPS(bs));
 			rc = fat_block_get(&b, bs, nodep, pos / BPS(bs),
 			    BLOCK_FLAGS_NONE);
 			if (rc != EOK) {
@@ -1316,6 +1353,67 @@ fat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
 	return rc;
 }
 
+static errno_t
+fat_readdir(service_id_t service_id, fs_index_t index, aoff64_t pos,
+    fs_readdir_t *rd)
+{
+	char name[FAT_LFN_NAME_SIZE];
+	fs_node_t *fn;
+	fat_node_t *nodep;
+	fat_dentry_t *d;
+	fat_directory_t di;
+	errno_t rc, rc2;
+
+	rc = fat_node_get(&fn, service_id, index);
+	if (rc != EOK)
+		return rc;
+	if (!fn)
+		return ENOENT;
+	nodep = FAT_NODE(fn);
+
+	rc = fat_directory_open(nodep, &di);
+	if (rc != EOK) {
+		(void) fat_node_put(fn);
+		return rc == EINVAL ? ENOTDIR : rc;
+	}
+
+	/* Positions have the same meaning as in fat_read(). */
+	rc = fat_directory_seek(&di, pos);
+	while (rc == EOK) {
+		rc = fat_directory_read(&di, name, &d);
+		if (rc != EOK)
+			break;
+
+		aoff64_t o = di.pos % (BPS(di.bs) / sizeof(fat_dentry_t));
+		fat_idx_t *idx = fat_idx_get_by_pos(service_id,
+		    nodep->firstc, di.bnum * DPS(di.bs) + o);
+		if (!idx) {
+			rc = ENOMEM;
+			break;
+		}
+		fs_index_t cindex = idx->index;
+		fibril_mutex_unlock(&idx->lock);
+
+		if (fs_readdir_add(rd, name, cindex, di.pos + 1) != EOK)
+			break;
+
+		rc = fat_directory_next(&di);
+	}
+
+	if (rc == ENOENT) {
+		/* End of the directory. */
+		rc = EOK;
+	}
+
+	rc2 = fat_directory_close(&di);
+	if (rc == EOK)
+		rc = rc2;
+	rc2 = fat_node_put(fn);
+	if (rc == EOK)
+		rc = rc2;
+	return rc;
+}
+
 static errno_t
 fat_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
     size_t *wbytes, aoff64_t *nsize)
@@ -1563,6 +1661,7 @@ vfs_out_ops_t fat_ops = {
 	.mounted = fat_mounted,
 	.unmounted = fat_unmounted,
 	.read = fat_read,
+	.readdir = fat_readdir,
 	.write = fat_write,
 	.truncate = fat_truncate,
 	.close = fat_close,
@@ -45,6 +45,7 @@
 #include <ns.h>
 #include <async.h>
 #include <errno.h>
+#include <fibril.h>
 #include <str_error.h>
 #include <stdio.h>
 #include <task.h>
@@ -95,6 +96,12 @@ int main(int argc, char **argv)
 		return rc;
 	}
 
+	/*
+	 * Requests for different nodes and instances do not share locks, let
+	 * them run in parallel.
+	 */
+	fibril_enable_multithreaded();
+
 	printf("%s: Accepting connections\n", NAME);
 	task_retval(0);
 	async_manager();
@@ -49,6 +49,7 @@
 #include <stddef.h>
 #include <adt/hash_table.h>
 #include <adt/hash.h>
+#include <fibril_synch.h>
 #include <as.h>
 #include <libfs.h>
 
@@ -137,6 +138,13 @@ libfs_ops_t tmpfs_libfs_ops = {
 /** Hash table of all TMPFS nodes. */
 hash_table_t nodes;
 
+/**
+ * Lock protecting the nodes hash table and tmpfs_next_index. The contents
+ * of the nodes are protected by the VFS, which never lets conflicting
+ * requests for the same node or namespace reach the server concurrently.
+ */
+static FIBRIL_RWLOCK_INITIALIZE(nodes_lock);
+
 /*
  * Implementation of hash table interface for the nodes hash table.
  */
@@ -248,7 +256,9 @@ static bool rm_service_id_nodes(ht_link_t *item, void *arg)
 
 static void tmpfs_instance_done(service_id_t service_id)
 {
+	fibril_rwlock_write_lock(&nodes_lock);
 	hash_table_apply(&nodes, rm_service_id_nodes, &service_id);
+	fibril_rwlock_write_unlock(&nodes_lock);
 }
 
 errno_t tmpfs_match(fs_node_t **rfn, fs_node_t *pfn, const char *component)
@@ -273,7 +283,9 @@ errno_t tmpfs_node_get(fs_node_t **rfn, service_id_t service_id, fs_index_t inde
 		.index = index
 	};
 
+	fibril_rwlock_read_lock(&nodes_lock);
 	ht_link_t *lnk = hash_table_find(&nodes, &key);
+	fibril_rwlock_read_unlock(&nodes_lock);
 
 	if (lnk) {
 		tmpfs_node_t *nodep;
@@ -320,10 +332,6 @@ errno_t tmpfs_create_node(fs_node_t **rfn, service_id_t service_id, int lflag)
 
 	rc = tmpfs_root_get(&rootfn, service_id);
 	assert(rc == EOK);
-	if (!rootfn)
-		nodep->index = TMPFS_SOME_ROOT;
-	else
-		nodep->index = tmpfs_next_index++;
 
 	nodep->service_id = service_id;
 	if (lflag & L_DIRECTORY)
@@ -331,8 +339,15 @@ errno_t tmpfs_create_node(fs_node_t **rfn, service_id_t service_id, int lflag)
 	else
 		nodep->type = TMPFS_FILE;
 
+	fibril_rwlock_write_lock(&nodes_lock);
+	if (!rootfn)
+		nodep->index = TMPFS_SOME_ROOT;
+	else
+		nodep->index = tmpfs_next_index++;
+
 	/* Insert the new node into the nodes hash table. */
 	hash_table_insert(&nodes, &nodep->nh_link);
+	fibril_rwlock_write_unlock(&nodes_lock);
 	*rfn = FS_NODE(nodep);
 	return EOK;
 }
@@ -344,7 +359,9 @@ errno_t tmpfs_destroy_node(fs_node_t *fn)
 	assert(!nodep->lnkcnt);
 	assert(list_empty(&nodep->cs_list));
 
+	fibril_rwlock_write_lock(&nodes_lock);
 	hash_table_remove_item(&nodes, &nodep->nh_link);
+	fibril_rwlock_write_unlock(&nodes_lock);
 
 	/*
 	 * The nodes_remove_callback() function takes care of the actual
@@ -473,7 +490,9 @@ static errno_t tmpfs_read(service_id_t service_id, fs_index_t index, aoff64_t po
 		.index = index
 	};
 
+	fibril_rwlock_read_lock(&nodes_lock);
 	ht_link_t *hlp = hash_table_find(&nodes, &key);
+	fibril_rwlock_read_unlock(&nodes_lock);
 	if (!hlp)
 		return ENOENT;
 
@@ -523,6 +542,45 @@ static errno_t tmpfs_read(service_id_t service_id, fs_index_t index, aoff64_t po
 	return EOK;
 }
 
+static errno_t tmpfs_readdir(service_id_t service_id, fs_index_t index,
+    aoff64_t pos, fs_readdir_t *rd)
+{
+	/*
+	 * Lookup the respective TMPFS node.
+	 */
+	node_key_t key = {
+		.service_id = service_id,
+		.index = index
+	};
+
+	fibril_rwlock_read_lock(&nodes_lock);
+	ht_link_t *hlp = hash_table_find(&nodes, &key);
+	fibril_rwlock_read_unlock(&nodes_lock);
+	if (!hlp)
+		return ENOENT;
+
+	tmpfs_node_t *nodep = hash_table_get_inst(hlp, tmpfs_node_t, nh_link);
+	if (nodep->type != TMPFS_DIRECTORY)
+		return ENOTDIR;
+
+	/* Position the same way as tmpfs_read() does. */
+	link_t *lnk = list_nth(&nodep->cs_list, pos);
+
+	while (lnk != NULL) {
+		tmpfs_dentry_t *dentryp = list_get_instance(lnk,
+		    tmpfs_dentry_t, link);
+
+		if (fs_readdir_add(rd, dentryp->name, dentryp->node->index,
+		    pos + 1) != EOK)
+			break;
+
+		pos++;
+		lnk = list_next(lnk, &nodep->cs_list);
+	}
+
+	return EOK;
+}
+
 static errno_t
 tmpfs_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
     size_t *wbytes, aoff64_t *nsize)
@@ -535,7 +593,9 @@ tmpfs_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
 		.index = index
 	};
 
+	fibril_rwlock_read_lock(&nodes_lock);
 	ht_link_t *hlp = hash_table_find(&nodes, &key);
+	fibril_rwlock_read_unlock(&nodes_lock);
 
 	if (!hlp)
 		return ENOENT;
@@ -598,7 +658,9 @@ static errno_t tmpfs_truncate(service_id_t service_id, fs_index_t index,
 		.index = index
 	};
 
+	fibril_rwlock_read_lock(&nodes_lock);
 	ht_link_t *hlp = hash_table_find(&nodes, &key);
+	fibril_rwlock_read_unlock(&nodes_lock);
 	if (!hlp)
 		return ENOENT;
 	tmpfs_node_t *nodep = hash_table_get_inst(hlp, tmpfs_node_t, nh_link);
@@ -635,7 +697,9 @@ static errno_t tmpfs_destroy(service_id_t service_id, fs_index_t index)
 		.index = index
 	};
 
+	fibril_rwlock_read_lock(&nodes_lock);
 	ht_link_t *hlp = hash_table_find(&nodes, &key);
+	fibril_rwlock_read_unlock(&nodes_lock);
 	if (!hlp)
 		return ENOENT;
 	tmpfs_node_t *nodep = hash_table_get_inst(hlp, tmpfs_node_t,
@@ -657,6 +721,7 @@ vfs_out_ops_t tmpfs_ops = {
 	.mounted = tmpfs_mounted,
 	.unmounted = tmpfs_unmounted,
 	.read = tmpfs_read,
+	.readdir = tmpfs_readdir,
 	.write = tmpfs_write,
 	.truncate = tmpfs_truncate,
 	.close = tmpfs_close,
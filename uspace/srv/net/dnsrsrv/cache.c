@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup dnsrsrv
+ * @{
+ */
+/**
+ * @file Cache of query answers
+ *
+ * Positive answers are kept for the TTL given by the server, negative
+ * answers for the TTL derived from the SOA record (RFC 2308). Expired
+ * positive answers are kept a while longer so that they can be served
+ * if the server cannot be reached (RFC 8767). When the cache is full,
+ * the least recently used answer is evicted.
+ */
+
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fibril_synch.h>
+#include <io/log.h>
+#include <macros.h>
+#include <stdlib.h>
+#include <str.h>
+#include <time.h>
+#include "cache.h"
+#include "dns_type.h"
+
+/** Upper bound on time to keep an answer (s) */
+#define DNS_CACHE_TTL_MAX (24 * 60 * 60)
+
+/** How long an expired positive answer can be served (s) */
+#define DNS_CACHE_STALE_MAX (24 * 60 * 60)
+
+/** Cache lookup key */
+typedef struct {
+	const char *name;
+	dns_qtype_t qtype;
+} dns_cache_key_t;
+
+static hash_table_t cache;
+/** Cache entries, most recently used first */
+static LIST_INITIALIZE(cache_lru);
+static FIBRIL_MUTEX_INITIALIZE(cache_lock);
+
+/** Compute hash of query name and type.
+ *
+ * Domain names are compared case-insensitively.
+ */
+static size_t dns_cache_hash(const char *name, dns_qtype_t qtype)
+{
+	size_t hash = qtype;
+
+	while (*name != '\0') {
+		hash = hash_combine(hash, tolower((unsigned char) *name));
+		++name;
+	}
+
+	return hash;
+}
+
+static size_t dns_cache_key_hash(const void *key)
+{
+	const dns_cache_key_t *ckey = key;
+	return dns_cache_hash(ckey->name, ckey->qtype);
+}
+
+static size_t dns_cache_entry_hash(const ht_link_t *item)
+{
+	dns_cache_entry_t *entry = hash_table_get_inst(item,
+	    dns_cache_entry_t, lhash);
+	return dns_cache_hash(entry->name, entry->qtype);
+}
+
+static bool dns_cache_key_equal(const void *key, const ht_link_t *item)
+{
+	const dns_cache_key_t *ckey = key;
+	dns_cache_entry_t *entry = hash_table_get_inst(item,
+	    dns_cache_entry_t, lhash);
+
+	return entry->qtype == ckey->qtype &&
+	    str_casecmp(entry->name, ckey->name) == 0;
+}
+
+static void dns_cache_entry_remove(ht_link_t *item)
+{
+	dns_cache_entry_t *entry = hash_table_get_inst(item,
+	    dns_cache_entry_t, lhash);
+
+	list_remove(&entry->llru);
+	free(entry->name);
+	free(entry->info.cname);
+	free(entry);
+}
+
+static hash_table_ops_t dns_cache_ops = {
+	.hash = dns_cache_entry_hash,
+	.key_hash = dns_cache_key_hash,
+	.key_equal = dns_cache_key_equal,
+	.equal = NULL,
+	.remove_callback = dns_cache_entry_remove
+};
+
+/** Initialize cache.
+ *
+ * @return EOK on success or ENOMEM if out of memory
+ */
+errno_t dns_cache_init(void)
+{
+	if (!hash_table_create(&cache, 0, 0, &dns_cache_ops))
+		return ENOMEM;
+
+	return EOK;
+}
+
+/** Finalize cache. */
+void dns_cache_fini(void)
+{
+	hash_table_destroy(&cache);
+}
+
+/** Look up answer in cache.
+ *
+ * @param name    Queried name
+ * @param qtype   Query type
+ * @param stale   Also return a positive answer which has expired
+ *                (but not for longer than DNS_CACHE_STALE_MAX)
+ * @param info    Host information to fill in for a positive answer,
+ *                the caller is responsible for freeing @c info->cname
+ * @param rstatus Place to store EOK for a positive answer or error code
+ *                of a negative answer
+ *
+ * @return EOK if answer was found, ENOENT if not, ENOMEM if out of memory
+ */
+errno_t dns_cache_lookup(const char *name, dns_qtype_t qtype, bool stale,
+    dns_host_info_t *info, errno_t *rstatus)
+{
+	dns_cache_key_t key;
+	dns_cache_entry_t *entry;
+	struct timespec now;
+	struct timespec limit;
+	ht_link_t *link;
+
+	key.name = name;
+	key.qtype = qtype;
+
+	getuptime(&now);
+
+	fibril_mutex_lock(&cache_lock);
+
+	link = hash_table_find(&cache, &key);
+	if (link == NULL) {
+		fibril_mutex_unlock(&cache_lock);
+		return ENOENT;
+	}
+
+	entry = hash_table_get_inst(link, dns_cache_entry_t, lhash);
+
+	if (ts_gteq(&now, &entry->expires)) {
+		limit = entry->expires;
+		ts_add_diff(&limit, SEC2NSEC(DNS_CACHE_STALE_MAX));
+
+		if (entry->status != EOK || ts_gteq(&now, &limit)) {
+			/* Not usable any more */
+			hash_table_remove_item(&cache, &entry->lhash);
+			fibril_mutex_unlock(&cache_lock);
+			return ENOENT;
+		}
+
+		if (!stale) {
+			/* Keep for serving stale */
+			fibril_mutex_unlock(&cache_lock);
+			return ENOENT;
+		}
+	}
+
+	if (entry->status == EOK) {
+		info->cname = str_dup(entry->info.cname);
+		if (info->cname == NULL) {
+			fibril_mutex_unlock(&cache_lock);
+			return ENOMEM;
+		}
+
+		info->addr = entry->info.addr;
+	}
+
+	*rstatus = entry->status;
+
+	list_remove(&entry->llru);
+	list_prepend(&entry->llru, &cache_lru);
+
+	fibril_mutex_unlock(&cache_lock);
+	return EOK;
+}
+
+/** Insert answer into cache.
+ *
+ * Any previous answer to the same query is replaced. Answers with zero
+ * TTL are not cached.
+ *
+ * @param name   Queried name
+ * @param qtype  Query type
+ * @param status EOK for a positive answer, error code for a negative answer
+ * @param info   Host information (positive answer only)
+ * @param ttl    Time to live (s)
+ */
+void dns_cache_insert(const char *name, dns_qtype_t qtype, errno_t status,
+    dns_host_info_t *info, uint32_t ttl)
+{
+	dns_cache_key_t key;
+	dns_cache_entry_t *entry;
+	link_t *link;
+
+	if (ttl == 0)
+		return;
+
+	entry = calloc(1, sizeof(dns_cache_entry_t));
+	if (entry == NULL)
+		return;
+
+	entry->name = str_dup(name);
+	if (entry->name == NULL) {
+		free(entry);
+		return;
+	}
+
+	if (status == EOK) {
+		entry->info.cname = str_dup(info->cname);
+		if (entry->info.cname == NULL) {
+			free(entry->name);
+			free(entry);
+			return;
+		}
+
+		entry->info.addr = info->addr;
+	}
+
+	entry->qtype = qtype;
+	entry->status = status;
+	getuptime(&entry->expires);
+	ts_add_diff(&entry->expires, SEC2NSEC(min(ttl, DNS_CACHE_TTL_MAX)));
+
+	key.name = name;
+	key.qtype = qtype;
+
+	fibril_mutex_lock(&cache_lock);
+
+	(void) hash_table_remove(&cache, &key);
+
+	if (hash_table_size(&cache) >= DNS_CACHE_MAX_ENTRIES) {
+		link = list_last(&cache_lru);
+		hash_table_remove_item(&cache, &list_get_instance(link,
+		    dns_cache_entry_t, llru)->lhash);
+	}
+
+	hash_table_insert(&cache, &entry->lhash);
+	list_prepend(&entry->llru, &cache_lru);
+
+	fibril_mutex_unlock(&cache_lock);
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "dns_cache_insert: '%s' type %u "
+	    "ttl %" PRIu32, name, qtype, ttl);
+}
+
+/** Remove all answers from cache. */
+void dns_cache_flush(void)
+{
+	fibril_mutex_lock(&cache_lock);
+	hash_table_clear(&cache);
+	fibril_mutex_unlock(&cache_lock);
+}
+
+/** Get number of cached answers. */
+size_t dns_cache_count(void)
+{
+	size_t count;
+
+	fibril_mutex_lock(&cache_lock);
+	count = hash_table_size(&cache);
+	fibril_mutex_unlock(&cache_lock);
+
+	return count;
+}
+
+/** @}
+ */
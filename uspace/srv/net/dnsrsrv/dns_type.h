@@ -36,11 +36,13 @@
 #ifndef DNS_TYPE_H
 #define DNS_TYPE_H
 
+#include <adt/hash_table.h>
 #include <adt/list.h>
 #include <inet/inet.h>
 #include <inet/addr.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 #include "dns_std.h"
 
 /** Encoded DNS PDU */
@@ -118,6 +120,24 @@ typedef struct {
 	inet_addr_t addr;
 } dns_host_info_t;
 
+/** Cached answer to a query */
+typedef struct {
+	/** Link to cache hash table */
+	ht_link_t lhash;
+	/** Link to cache LRU list */
+	link_t llru;
+	/** Queried name */
+	char *name;
+	/** Query type */
+	dns_qtype_t qtype;
+	/** EOK for a positive answer, error code for a negative answer */
+	errno_t status;
+	/** Host information (positive answer only) */
+	dns_host_info_t info;
+	/** Time when the answer expires */
+	struct timespec expires;
+} dns_cache_entry_t;
+
 typedef struct {
 } dnsr_client_t;
 
@@ -33,21 +33,102 @@
  * @file
  */
 
+#include <adt/list.h>
 #include <errno.h>
+#include <fibril.h>
+#include <fibril_synch.h>
 #include <io/log.h>
+#include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
 #include <str.h>
+#include <time.h>
+#include "cache.h"
 #include "dns_msg.h"
 #include "dns_std.h"
 #include "dns_type.h"
 #include "query.h"
 #include "transport.h"
 
+/** Negative answer TTL if the server does not provide SOA (s) */
+#define DNS_NEG_TTL_DEFAULT 60
+
+/** Upper bound on negative answer TTL (s) */
+#define DNS_NEG_TTL_MAX (3 * 60 * 60)
+
+/** Query in progress, other identical queries wait for its result */
+typedef struct {
+	link_t lpending;
+	/** Queried name */
+	char *name;
+	/** Query type */
+	dns_qtype_t qtype;
+	/** Query has finished */
+	bool done;
+	/** Result of the query */
+	errno_t rc;
+	/** Host information (if @c rc is EOK) */
+	dns_host_info_t info;
+	/** Number of queries waiting for the result */
+	unsigned waiters;
+	fibril_condvar_t done_cv;
+} dns_pending_t;
+
+/** Query of one address family run in parallel with another one */
+typedef struct {
+	const char *name;
+	dns_qtype_t qtype;
+	dns_host_info_t info;
+	errno_t rc;
+	bool done;
+	fibril_mutex_t lock;
+	fibril_condvar_t cv;
+} dns_parallel_t;
+
 static uint16_t msg_id;
 
+/** Queries in progress */
+static LIST_INITIALIZE(pending_list); /* of dns_pending_t */
+static FIBRIL_MUTEX_INITIALIZE(pending_lock);
+
+static dnsr_stats_t stats;
+static FIBRIL_MUTEX_INITIALIZE(stats_lock);
+
+/** Determine TTL of a negative answer (RFC 2308 section 5).
+ *
+ * @param amsg Answer message
+ * @return TTL in seconds
+ */
+static uint32_t dns_neg_ttl(dns_message_t *amsg)
+{
+	uint32_t minimum;
+
+	list_foreach(amsg->authority, msg, dns_rr_t, rr) {
+		/* MINIMUM is the last of five 32-bit fields ending SOA RDATA */
+		if (rr->rtype == DTYPE_SOA && rr->rclass == DC_IN &&
+		    rr->rdata_size >= 5 * sizeof(uint32_t)) {
+			minimum = dns_uint32_t_decode((uint8_t *) rr->rdata +
+			    rr->rdata_size - sizeof(uint32_t), sizeof(uint32_t));
+			return min(min(rr->ttl, minimum), DNS_NEG_TTL_MAX);
+		}
+	}
+
+	return DNS_NEG_TTL_DEFAULT;
+}
+
+/** Query name server.
+ *
+ * @param name  Name to look up
+ * @param qtype Query type (DTYPE_A or DTYPE_AAAA)
+ * @param info  Host information to fill in
+ * @param rttl  Place to store TTL of the answer (positive or negative)
+ *
+ * @return EOK on success, ENOENT if the server answered that there
+ *         is no such record, EIO if the server did not answer or
+ *         reported a failure, ENOMEM if out of memory
+ */
 static errno_t dns_name_query(const char *name, dns_qtype_t qtype,
-    dns_host_info_t *info)
+    dns_host_info_t *info, uint32_t *rttl)
 {
 	/* Start with the caller-provided name */
 	char *sname = str_dup(name);
@@ -98,6 +179,18 @@ static errno_t dns_name_query(const char *name, dns_qtype_t qtype,
 		return rc;
 	}
 
+	if (amsg->rcode != RC_OK && amsg->rcode != RC_NAME_ERR) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "server failure %u",
+		    amsg->rcode);
+		dns_message_destroy(msg);
+		dns_message_destroy(amsg);
+		free(sname);
+		return EIO;
+	}
+
+	/* The answer is valid for the shortest TTL along the CNAME chain */
+	uint32_t ttl = UINT32_MAX;
+
 	list_foreach(amsg->answer, msg, dns_rr_t, rr) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, " - '%s' %u/%u, dsize %zu",
 		    rr->name, rr->rtype, rr->rclass, rr->rdata_size);
@@ -129,6 +222,7 @@ static errno_t dns_name_query(const char *name, dns_qtype_t qtype,
 			/* Continue looking for the more canonical name */
 			free(sname);
 			sname = cname;
+			ttl = min(ttl, rr->ttl);
 		}
 
 		if ((qtype == DTYPE_A) && (rr->rtype == DTYPE_A) &&
@@ -146,6 +240,7 @@ static errno_t dns_name_query(const char *name, dns_qtype_t qtype,
 
 			inet_addr_set(dns_uint32_t_decode(rr->rdata, rr->rdata_size),
 			    &info->addr);
+			*rttl = min(ttl, rr->ttl);
 
 			dns_message_destroy(msg);
 			dns_message_destroy(amsg);
@@ -171,6 +266,7 @@ static errno_t dns_name_query(const char *name, dns_qtype_t qtype,
 			dns_addr128_t_decode(rr->rdata, rr->rdata_size, addr);
 
 			inet_addr_set6(addr, &info->addr);
+			*rttl = min(ttl, rr->ttl);
 
 			dns_message_destroy(msg);
 			dns_message_destroy(amsg);
@@ -182,11 +278,247 @@ static errno_t dns_name_query(const char *name, dns_qtype_t qtype,
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "'%s' not resolved, fail", sname);
 
+	*rttl = dns_neg_ttl(amsg);
+
 	dns_message_destroy(msg);
 	dns_message_destroy(amsg);
 	free(sname);
 
-	return EIO;
+	return ENOENT;
+}
+
+/** Account query in statistics.
+ *
+ * @param start Time when the query started
+ * @param hit   @c true if the query was answered from cache
+ * @param count Counter to increment
+ */
+static void dns_stats_account(struct timespec *start, bool hit,
+    uint64_t *count)
+{
+	struct timespec now;
+	usec_t usec;
+
+	getuptime(&now);
+	usec = NSEC2USEC(ts_sub_diff(&now, start));
+
+	fibril_mutex_lock(&stats_lock);
+	++stats.queries;
+	++*count;
+	if (hit)
+		stats.hit_usec += usec;
+	else
+		stats.miss_usec += usec;
+	fibril_mutex_unlock(&stats_lock);
+}
+
+/** Find query in progress.
+ *
+ * @param name  Queried name
+ * @param qtype Query type
+ * @return Query in progress or @c NULL
+ */
+static dns_pending_t *dns_pending_find(const char *name, dns_qtype_t qtype)
+{
+	assert(fibril_mutex_is_locked(&pending_lock));
+
+	list_foreach(pending_list, lpending, dns_pending_t, pending) {
+		if (pending->qtype == qtype &&
+		    str_casecmp(pending->name, name) == 0)
+			return pending;
+	}
+
+	return NULL;
+}
+
+/** Drop reference to query in progress.
+ *
+ * @param pending Query which has finished
+ */
+static void dns_pending_release(dns_pending_t *pending)
+{
+	assert(fibril_mutex_is_locked(&pending_lock));
+
+	if (--pending->waiters > 0)
+		return;
+
+	free(pending->name);
+	free(pending->info.cname);
+	free(pending);
+}
+
+/** Look up name, using the cache and joining identical queries.
+ *
+ * @param name  Name to look up
+ * @param qtype Query type (DTYPE_A or DTYPE_AAAA)
+ * @param info  Host information to fill in
+ *
+ * @return EOK on success, ENOENT if there is no such record or
+ *         an error code
+ */
+static errno_t dns_name_query_cached(const char *name, dns_qtype_t qtype,
+    dns_host_info_t *info)
+{
+	dns_pending_t *pending;
+	struct timespec start;
+	errno_t status;
+	uint32_t ttl;
+	errno_t rc;
+
+	getuptime(&start);
+
+	rc = dns_cache_lookup(name, qtype, false, info, &status);
+	if (rc == EOK) {
+		dns_stats_account(&start, true, status == EOK ? &stats.hits :
+		    &stats.neg_hits);
+		return status;
+	}
+
+	fibril_mutex_lock(&pending_lock);
+
+	pending = dns_pending_find(name, qtype);
+	if (pending != NULL) {
+		/* Wait for the identical query to finish */
+		++pending->waiters;
+		while (!pending->done)
+			fibril_condvar_wait(&pending->done_cv, &pending_lock);
+
+		rc = pending->rc;
+		if (rc == EOK) {
+			info->cname = str_dup(pending->info.cname);
+			if (info->cname == NULL)
+				rc = ENOMEM;
+			info->addr = pending->info.addr;
+		}
+
+		dns_pending_release(pending);
+		fibril_mutex_unlock(&pending_lock);
+
+		dns_stats_account(&start, false, &stats.coalesced);
+		return rc;
+	}
+
+	pending = calloc(1, sizeof(dns_pending_t));
+	if (pending == NULL) {
+		fibril_mutex_unlock(&pending_lock);
+		return ENOMEM;
+	}
+
+	pending->name = str_dup(name);
+	if (pending->name == NULL) {
+		free(pending);
+		fibril_mutex_unlock(&pending_lock);
+		return ENOMEM;
+	}
+
+	pending->qtype = qtype;
+	pending->waiters = 1;
+	fibril_condvar_initialize(&pending->done_cv);
+	list_append(&pending->lpending, &pending_list);
+	fibril_mutex_unlock(&pending_lock);
+
+	rc = dns_name_query(name, qtype, &pending->info, &ttl);
+	if (rc == EOK || rc == ENOENT) {
+		dns_cache_insert(name, qtype, rc, &pending->info, ttl);
+		dns_stats_account(&start, false, &stats.misses);
+	} else if (rc != ENOMEM &&
+	    dns_cache_lookup(name, qtype, true, &pending->info, &status) ==
+	    EOK) {
+		/* Server failed, serve stale answer */
+		log_msg(LOG_DEFAULT, LVL_NOTE, "Serving stale answer for "
+		    "'%s'.", name);
+		rc = status;
+		dns_stats_account(&start, false, &stats.stale);
+	} else {
+		dns_stats_account(&start, false, &stats.misses);
+	}
+
+	if (rc == EOK) {
+		info->cname = str_dup(pending->info.cname);
+		if (info->cname == NULL)
+			rc = ENOMEM;
+		info->addr = pending->info.addr;
+	}
+
+	fibril_mutex_lock(&pending_lock);
+	list_remove(&pending->lpending);
+	pending->rc = rc;
+	pending->done = true;
+	fibril_condvar_broadcast(&pending->done_cv);
+	dns_pending_release(pending);
+	fibril_mutex_unlock(&pending_lock);
+
+	return rc;
+}
+
+/** Fibril running a query in parallel.
+ *
+ * @param arg Parallel query
+ */
+static errno_t dns_parallel_fibril(void *arg)
+{
+	dns_parallel_t *pq = (dns_parallel_t *) arg;
+	errno_t rc;
+
+	rc = dns_name_query_cached(pq->name, pq->qtype, &pq->info);
+
+	fibril_mutex_lock(&pq->lock);
+	pq->rc = rc;
+	pq->done = true;
+	fibril_condvar_broadcast(&pq->cv);
+	fibril_mutex_unlock(&pq->lock);
+
+	return EOK;
+}
+
+/** Look up IPv6 and IPv4 address of name in parallel.
+ *
+ * An IPv6 address is preferred.
+ *
+ * @param name Name to look up
+ * @param info Host information to fill in
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t dns_name_query_any(const char *name, dns_host_info_t *info)
+{
+	dns_parallel_t pq;
+	fid_t fid;
+	errno_t rc;
+
+	memset(&pq, 0, sizeof(pq));
+	pq.name = name;
+	pq.qtype = DTYPE_A;
+	fibril_mutex_initialize(&pq.lock);
+	fibril_condvar_initialize(&pq.cv);
+
+	fid = fibril_create(dns_parallel_fibril, &pq);
+	if (fid == 0) {
+		rc = dns_name_query_cached(name, DTYPE_AAAA, info);
+		if (rc != EOK)
+			rc = dns_name_query_cached(name, DTYPE_A, info);
+		return rc;
+	}
+
+	fibril_add_ready(fid);
+
+	rc = dns_name_query_cached(name, DTYPE_AAAA, info);
+
+	fibril_mutex_lock(&pq.lock);
+	while (!pq.done)
+		fibril_condvar_wait(&pq.cv, &pq.lock);
+	fibril_mutex_unlock(&pq.lock);
+
+	if (rc == EOK) {
+		if (pq.rc == EOK)
+			free(pq.info.cname);
+		return EOK;
+	}
+
+	if (pq.rc == EOK)
+		*info = pq.info;
+
+	return pq.rc;
 }
 
 errno_t dns_name2host(const char *name, dns_host_info_t **rinfo, ip_ver_t ver)
@@ -199,22 +531,22 @@ errno_t dns_name2host(const char *name, dns_host_info_t **rinfo, ip_ver_t ver)
 
 	switch (ver) {
 	case ip_any:
-		rc = dns_name_query(name, DTYPE_AAAA, info);
-
-		if (rc != EOK)
-			rc = dns_name_query(name, DTYPE_A, info);
-
+		rc = dns_name_query_any(name, info);
 		break;
 	case ip_v4:
-		rc = dns_name_query(name, DTYPE_A, info);
+		rc = dns_name_query_cached(name, DTYPE_A, info);
 		break;
 	case ip_v6:
-		rc = dns_name_query(name, DTYPE_AAAA, info);
+		rc = dns_name_query_cached(name, DTYPE_AAAA, info);
 		break;
 	default:
 		rc = EINVAL;
 	}
 
+	/* Name not found */
+	if (rc == ENOENT)
+		rc = EIO;
+
 	if (rc == EOK)
 		*rinfo = info;
 	else
@@ -229,5 +561,19 @@ void dns_hostinfo_destroy(dns_host_info_t *info)
 	free(info);
 }
 
+/** Get resolver statistics.
+ *
+ * @param rstats Place to store statistics
+ */
+void dns_get_stats(dnsr_stats_t *rstats)
+{
+	fibril_mutex_lock(&stats_lock);
+	*rstats = stats;
+	fibril_mutex_unlock(&stats_lock);
+
+	rstats->entries = dns_cache_count();
+	rstats->max_entries = DNS_CACHE_MAX_ENTRIES;
+}
+
 /** @}
  */
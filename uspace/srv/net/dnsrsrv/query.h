@@ -37,10 +37,12 @@
 #define QUERY_H
 
 #include <inet/addr.h>
+#include <types/inet/dnsr.h>
 #include "dns_type.h"
 
 extern errno_t dns_name2host(const char *, dns_host_info_t **, ip_ver_t);
 extern void dns_hostinfo_destroy(dns_host_info_t *);
+extern void dns_get_stats(dnsr_stats_t *);
 
 #endif
 
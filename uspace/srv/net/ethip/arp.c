@@ -149,7 +149,7 @@ static errno_t arp_send_packet(ethip_nic_t *nic, arp_eth_packet_t *packet)
 		return rc;
 	}
 
-	rc = ethip_nic_send(nic, fdata, fsize);
+	rc = ethip_nic_send(nic, fdata, fsize, NULL);
 	free(fdata);
 	free(pdata);
 
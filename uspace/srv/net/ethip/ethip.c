@@ -37,6 +37,7 @@
  */
 
 #include <async.h>
+#include <byteorder.h>
 #include <errno.h>
 #include <inet/iplink_srv.h>
 #include <io/log.h>
@@ -52,11 +53,17 @@
 
 #define NAME "ethip"
 
+/** Number of buffers in the pool of received frames */
+#define ETHIP_POOL_COUNT 256
+/** Size of buffer in the pool of received frames */
+#define ETHIP_POOL_BUF_SIZE 2048
+
 static errno_t ethip_open(iplink_srv_t *srv);
 static errno_t ethip_close(iplink_srv_t *srv);
 static errno_t ethip_send(iplink_srv_t *srv, iplink_sdu_t *sdu);
 static errno_t ethip_send6(iplink_srv_t *srv, iplink_sdu6_t *sdu);
 static errno_t ethip_get_mtu(iplink_srv_t *srv, size_t *mtu);
+static errno_t ethip_get_offload(iplink_srv_t *srv, uint32_t *offload);
 static errno_t ethip_get_mac48(iplink_srv_t *srv, addr48_t *mac);
 static errno_t ethip_set_mac48(iplink_srv_t *srv, addr48_t *mac);
 static errno_t ethip_addr_add(iplink_srv_t *srv, inet_addr_t *addr);
@@ -70,6 +77,7 @@ static iplink_ops_t ethip_iplink_ops = {
 	.send = ethip_send,
 	.send6 = ethip_send6,
 	.get_mtu = ethip_get_mtu,
+	.get_offload = ethip_get_offload,
 	.get_mac48 = ethip_get_mac48,
 	.set_mac48 = ethip_set_mac48,
 	.addr_add = ethip_addr_add,
@@ -107,6 +115,14 @@ errno_t ethip_iplink_init(ethip_nic_t *nic)
 	nic->iplink.ops = &ethip_iplink_ops;
 	nic->iplink.arg = nic;
 
+	/* Without a pool received frames are copied to the client */
+	rc = pbuf_pool_create(ETHIP_POOL_COUNT, ETHIP_POOL_BUF_SIZE,
+	    &nic->pool);
+	if (rc == EOK)
+		iplink_srv_set_pool(&nic->iplink, nic->pool);
+	else
+		log_msg(LOG_DEFAULT, LVL_WARN, "Failed creating packet pool.");
+
 	if (asprintf(&svc_name, "net/eth%u", ++link_num) < 0) {
 		log_msg(LOG_DEFAULT, LVL_ERROR, "Out of memory.");
 		rc = ENOMEM;
@@ -169,6 +185,20 @@ static errno_t ethip_close(iplink_srv_t *srv)
 	return EOK;
 }
 
+/** Rebase offload request of an IP packet onto the Ethernet frame.
+ *
+ * @param offload Offload request relative to the IP packet
+ * @return Offload request relative to the frame or @c NULL if none
+ */
+static inet_offload_t *ethip_offload(inet_offload_t *offload)
+{
+	if (offload->flags == 0)
+		return NULL;
+
+	offload->csum_start += sizeof(eth_header_t);
+	return offload;
+}
+
 static errno_t ethip_send(iplink_srv_t *srv, iplink_sdu_t *sdu)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_send()");
@@ -194,7 +224,7 @@ static errno_t ethip_send(iplink_srv_t *srv, iplink_sdu_t *sdu)
 	if (rc != EOK)
 		return rc;
 
-	rc = ethip_nic_send(nic, data, size);
+	rc = ethip_nic_send(nic, data, size, ethip_offload(&sdu->offload));
 	free(data);
 
 	return rc;
@@ -219,13 +249,14 @@ static errno_t ethip_send6(iplink_srv_t *srv, iplink_sdu6_t *sdu)
 	if (rc != EOK)
 		return rc;
 
-	rc = ethip_nic_send(nic, data, size);
+	rc = ethip_nic_send(nic, data, size, ethip_offload(&sdu->offload));
 	free(data);
 
 	return rc;
 }
 
-errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size)
+errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size,
+    uint16_t offload)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_received(): srv=%p", srv);
 	ethip_nic_t *nic = (ethip_nic_t *) srv->arg;
@@ -240,6 +271,7 @@ errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size)
 	}
 
 	iplink_recv_sdu_t sdu;
+	sdu.offload = offload;
 
 	switch (frame.etype_len) {
 	case ETYPE_ARP:
@@ -268,6 +300,47 @@ errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size)
 	return rc;
 }
 
+/** Process frame received into a packet buffer.
+ *
+ * IP packets are passed to the IP link client by reference, with the
+ * Ethernet header stripped in place. Other frames are processed
+ * by ethip_received(). The reference to @a pbuf is consumed.
+ *
+ * @param srv     IP link server
+ * @param pbuf    Received frame
+ * @param offload NIC_OFFLOAD_* flags
+ *
+ * @return EOK on success or an error code
+ */
+errno_t ethip_received_pbuf(iplink_srv_t *srv, pbuf_t *pbuf,
+    uint16_t offload)
+{
+	eth_header_t *hdr;
+	errno_t rc;
+
+	if (pbuf->len < sizeof(eth_header_t)) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "PDU too short (%" PRIu32 ")",
+		    pbuf->len);
+		pbuf_release(pbuf);
+		return EINVAL;
+	}
+
+	hdr = (eth_header_t *) pbuf_data(pbuf);
+
+	switch (uint16_t_be2host(hdr->etype_len)) {
+	case ETYPE_IP:
+		(void) pbuf_pull(pbuf, sizeof(eth_header_t));
+		return iplink_ev_recv_pbuf(srv, pbuf, ip_v4, offload);
+	case ETYPE_IPV6:
+		(void) pbuf_pull(pbuf, sizeof(eth_header_t));
+		return iplink_ev_recv_pbuf(srv, pbuf, ip_v6, offload);
+	default:
+		rc = ethip_received(srv, pbuf_data(pbuf), pbuf->len, offload);
+		pbuf_release(pbuf);
+		return rc;
+	}
+}
+
 static errno_t ethip_get_mtu(iplink_srv_t *srv, size_t *mtu)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_get_mtu()");
@@ -275,6 +348,16 @@ static errno_t ethip_get_mtu(iplink_srv_t *srv, size_t *mtu)
 	return EOK;
 }
 
+static errno_t ethip_get_offload(iplink_srv_t *srv, uint32_t *offload)
+{
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_get_offload()");
+
+	ethip_nic_t *nic = (ethip_nic_t *) srv->arg;
+	*offload = nic->offload;
+
+	return EOK;
+}
+
 static errno_t ethip_get_mac48(iplink_srv_t *srv, addr48_t *mac)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_get_mac48()");
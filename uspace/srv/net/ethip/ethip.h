@@ -40,6 +40,7 @@
 #include <adt/list.h>
 #include <async.h>
 #include <inet/iplink_srv.h>
+#include <inet/pbuf.h>
 #include <inet/addr.h>
 #include <loc.h>
 #include <stddef.h>
@@ -62,6 +63,12 @@ typedef struct ethip_nic {
 	/** MAC address */
 	addr48_t mac_addr;
 
+	/** Offload capabilities of the NIC (IPLINK_OFFLOAD_* flags) */
+	uint32_t offload;
+
+	/** Pool of received frames shared with the IP link client or @c NULL */
+	pbuf_pool_t *pool;
+
 	/**
 	 * List of IP addresses configured on this link
 	 * (of the type ethip_link_addr_t)
@@ -116,7 +123,8 @@ typedef struct {
 } ethip_atrans_t;
 
 extern errno_t ethip_iplink_init(ethip_nic_t *);
-extern errno_t ethip_received(iplink_srv_t *, void *, size_t);
+extern errno_t ethip_received(iplink_srv_t *, void *, size_t, uint16_t);
+extern errno_t ethip_received_pbuf(iplink_srv_t *, pbuf_t *, uint16_t);
 
 #endif
 
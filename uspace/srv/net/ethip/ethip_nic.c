@@ -138,6 +138,8 @@ static void ethip_nic_delete(ethip_nic_t *nic)
 	if (nic->svc_name != NULL)
 		free(nic->svc_name);
 
+	pbuf_pool_destroy(nic->pool);
+
 	free(nic);
 }
 
@@ -146,6 +148,40 @@ static void ethip_link_addr_delete(ethip_link_addr_t *laddr)
 	free(laddr);
 }
 
+/** Determine which IP link offloads the NIC can perform.
+ *
+ * Missing support for offload probing is not an error, the link
+ * simply advertises no offload capabilities.
+ */
+static void ethip_nic_probe_offload(ethip_nic_t *nic)
+{
+	uint32_t supported;
+	uint32_t active;
+	errno_t rc;
+
+	nic->offload = 0;
+
+	rc = nic_offload_probe(nic->sess, &supported, &active);
+	if (rc != EOK)
+		return;
+
+	if ((supported & NIC_OFFLOAD_TX_CSUM) != 0)
+		nic->offload |= IPLINK_OFFLOAD_TX_CSUM;
+	if ((supported & NIC_OFFLOAD_RX_CSUM) != 0)
+		nic->offload |= IPLINK_OFFLOAD_RX_CSUM;
+
+	/* Segmentation needs the NIC to also fill in checksums */
+	if ((supported & NIC_OFFLOAD_TX_CSUM) != 0) {
+		if ((supported & NIC_OFFLOAD_TSO4) != 0)
+			nic->offload |= IPLINK_OFFLOAD_TSO4;
+		if ((supported & NIC_OFFLOAD_TSO6) != 0)
+			nic->offload |= IPLINK_OFFLOAD_TSO6;
+	}
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "NIC '%s' offload capabilities 0x%"
+	    PRIx32, nic->svc_name, nic->offload);
+}
+
 static errno_t ethip_nic_open(service_id_t sid)
 {
 	bool in_list = false;
@@ -194,6 +230,8 @@ static errno_t ethip_nic_open(service_id_t sid)
 
 	addr48(nic_address.address, nic->mac_addr);
 
+	ethip_nic_probe_offload(nic);
+
 	rc = nic_set_state(nic->sess, NIC_STATE_ACTIVE);
 	if (rc != EOK) {
 		log_msg(LOG_DEFAULT, LVL_ERROR, "Error activating NIC '%s'.",
@@ -258,15 +296,50 @@ static void ethip_nic_addr_changed(ethip_nic_t *nic, ipc_call_t *call)
 
 static void ethip_nic_received(ethip_nic_t *nic, ipc_call_t *call)
 {
+	ipc_call_t data_call;
+	pbuf_t pbuf;
 	errno_t rc;
 	void *data;
 	size_t size;
+	uint16_t offload = ipc_get_arg1(call);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_nic_received() nic=%p", nic);
 
-	rc = async_data_write_accept(&data, false, 0, 0, 0, &size);
+	if (!async_data_write_receive(&data_call, &size)) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "data_write_receive() failed");
+		async_answer_0(&data_call, EINVAL);
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	/* Receive the frame directly into a buffer shared with the client */
+	if (nic->pool != NULL &&
+	    pbuf_alloc(nic->pool, 0, size, &pbuf) == EOK) {
+		rc = async_data_write_finalize(&data_call, pbuf_data(&pbuf),
+		    size);
+		if (rc != EOK) {
+			pbuf_release(&pbuf);
+			async_answer_0(call, rc);
+			return;
+		}
+
+		rc = ethip_received_pbuf(&nic->iplink, &pbuf, offload);
+		async_answer_0(call, rc);
+		return;
+	}
+
+	data = malloc(size);
+	if (data == NULL) {
+		async_answer_0(&data_call, ENOMEM);
+		async_answer_0(call, ENOMEM);
+		return;
+	}
+
+	rc = async_data_write_finalize(&data_call, data, size);
 	if (rc != EOK) {
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "data_write_accept() failed");
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "data_write_finalize() failed");
+		free(data);
+		async_answer_0(call, rc);
 		return;
 	}
 
@@ -274,7 +347,7 @@ static void ethip_nic_received(ethip_nic_t *nic, ipc_call_t *call)
 	    size);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "call ethip_received");
-	rc = ethip_received(&nic->iplink, data, size);
+	rc = ethip_received(&nic->iplink, data, size, offload);
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "free data");
 	free(data);
 
@@ -349,11 +422,12 @@ ethip_nic_t *ethip_nic_find_by_iplink_sid(service_id_t iplink_sid)
 	return NULL;
 }
 
-errno_t ethip_nic_send(ethip_nic_t *nic, void *data, size_t size)
+errno_t ethip_nic_send(ethip_nic_t *nic, void *data, size_t size,
+    const inet_offload_t *offload)
 {
 	errno_t rc;
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_nic_send(size=%zu)", size);
-	rc = nic_send_frame(nic->sess, data, size);
+	rc = nic_send_frame(nic->sess, data, size, offload);
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "nic_send_frame -> %s", str_error_name(rc));
 	return rc;
 }
@@ -110,6 +110,7 @@ static errno_t icmp_recv_echo_request(inet_dgram_t *dgram)
 	rdgram.tos = ICMP_TOS;
 	rdgram.data = reply;
 	rdgram.size = size;
+	memset(&rdgram.offload, 0, sizeof(rdgram.offload));
 
 	rc = inet_route_packet(&rdgram, IP_PROTO_ICMP, INET_TTL_MAX, 0);
 
@@ -168,6 +169,7 @@ errno_t icmp_ping_send(uint16_t ident, inetping_sdu_t *sdu)
 	dgram.tos = ICMP_TOS;
 	dgram.data = rdata;
 	dgram.size = rsize;
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
 
 	errno_t rc = inet_route_packet(&dgram, IP_PROTO_ICMP, INET_TTL_MAX, 0);
 
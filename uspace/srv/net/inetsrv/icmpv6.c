@@ -83,6 +83,7 @@ static errno_t icmpv6_recv_echo_request(inet_dgram_t *dgram)
 	rdgram.tos = 0;
 	rdgram.data = reply;
 	rdgram.size = size;
+	memset(&rdgram.offload, 0, sizeof(rdgram.offload));
 
 	icmpv6_phdr_t phdr;
 
@@ -181,6 +182,7 @@ errno_t icmpv6_ping_send(uint16_t ident, inetping_sdu_t *sdu)
 	dgram.tos = 0;
 	dgram.data = rdata;
 	dgram.size = rsize;
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
 
 	icmpv6_phdr_t phdr;
 
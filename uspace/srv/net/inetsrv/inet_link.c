@@ -34,6 +34,7 @@
  * @brief
  */
 
+#include <align.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <str_error.h>
@@ -41,11 +42,14 @@
 #include <inet/iplink.h>
 #include <io/log.h>
 #include <loc.h>
+#include <macros.h>
+#include <mem.h>
 #include <stdlib.h>
 #include <str.h>
 #include "addrobj.h"
 #include "inetsrv.h"
 #include "inet_link.h"
+#include "inet_std.h"
 #include "pdu.h"
 
 static bool first_link = true;
@@ -111,6 +115,8 @@ static errno_t inet_iplink_recv(iplink_t *iplink, iplink_recv_sdu_t *sdu, ip_ver
 		return rc;
 	}
 
+	packet.offload = sdu->offload;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_iplink_recv: link_id=%zu", packet.link_id);
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "call inet_recv_packet()");
 	rc = inet_recv_packet(&packet);
@@ -197,6 +203,10 @@ errno_t inet_link_open(service_id_t sid)
 		goto error;
 	}
 
+	rc = iplink_get_offload(ilink->iplink, &ilink->offload);
+	if (rc != EOK)
+		ilink->offload = 0;
+
 	/*
 	 * Get the MAC address of the link. If the link has a MAC
 	 * address, we assume that it supports NDP.
@@ -296,6 +306,96 @@ error:
 	return rc;
 }
 
+/** Complete transport checksum of a datagram in software.
+ *
+ * Used when the transport protocol left the checksum to be completed
+ * by a lower layer, but the link cannot do it.
+ *
+ * @param dgram Datagram
+ * @param proto Protocol
+ */
+static void inet_link_csum_complete(inet_dgram_t *dgram, uint8_t proto)
+{
+	uint8_t *cfield;
+	uint16_t chksum;
+
+	if (dgram->offload.csum_offset + sizeof(uint16_t) > dgram->size)
+		return;
+
+	/* Checksum field holds the pseudo-header sum */
+	chksum = inet_checksum_calc(INET_CHECKSUM_INIT, dgram->data,
+	    dgram->size);
+	if (chksum == 0 && proto == IP_PROTO_UDP)
+		chksum = 0xffff;
+
+	cfield = (uint8_t *) dgram->data + dgram->offload.csum_offset;
+	cfield[0] = chksum >> 8;
+	cfield[1] = chksum & 0xff;
+
+	dgram->offload.flags &= ~(INET_OFFLOAD_CSUM | INET_OFFLOAD_TSO);
+}
+
+/** Decide which offload requests of a datagram are passed to the link.
+ *
+ * Requests the link cannot honour are completed in software. A TCP
+ * segment exceeding the MTU is handed to the link in one piece when
+ * the link can segment it, otherwise it is fragmented as usual.
+ *
+ * @param ilink    Internet link
+ * @param dgram    Datagram
+ * @param proto    Protocol
+ * @param hdr_size Size of IP header
+ * @param tso      Link capability needed for segmentation offload
+ * @param offload  Place to store offload request for the link
+ *
+ * @return Maximum PDU size to use when encoding the datagram
+ */
+static size_t inet_link_offload(inet_link_t *ilink, inet_dgram_t *dgram,
+    uint8_t proto, size_t hdr_size, uint32_t tso, inet_offload_t *offload)
+{
+	size_t size = hdr_size + dgram->size;
+	size_t thdr_size;
+
+	memset(offload, 0, sizeof(inet_offload_t));
+
+	if ((dgram->offload.flags & INET_OFFLOAD_CSUM) == 0)
+		return ilink->def_mtu;
+
+	if (size > ilink->def_mtu && size <= UINT16_MAX &&
+	    proto == IP_PROTO_TCP && dgram->size > 12 &&
+	    (dgram->offload.flags & INET_OFFLOAD_TSO) != 0 &&
+	    (ilink->offload & tso) != 0) {
+		/* Data offset field of the TCP header */
+		thdr_size = (((uint8_t *) dgram->data)[12] >> 4) *
+		    sizeof(uint32_t);
+		if (hdr_size + thdr_size < ilink->def_mtu) {
+			offload->flags = INET_OFFLOAD_CSUM | INET_OFFLOAD_TSO;
+			offload->csum_start = hdr_size;
+			offload->csum_offset = dgram->offload.csum_offset;
+			offload->gso_size = ilink->def_mtu - hdr_size -
+			    thdr_size;
+			if (dgram->offload.gso_size != 0) {
+				offload->gso_size = min(offload->gso_size,
+				    dgram->offload.gso_size);
+			}
+
+			/* Encode the whole segment as a single packet */
+			return hdr_size + ALIGN_UP(dgram->size, FRAG_OFFS_UNIT);
+		}
+	}
+
+	if (size <= ilink->def_mtu &&
+	    (ilink->offload & IPLINK_OFFLOAD_TX_CSUM) != 0) {
+		offload->flags = INET_OFFLOAD_CSUM;
+		offload->csum_start = hdr_size;
+		offload->csum_offset = dgram->offload.csum_offset;
+		return ilink->def_mtu;
+	}
+
+	inet_link_csum_complete(dgram, proto);
+	return ilink->def_mtu;
+}
+
 /** Send IPv4 datagram over Internet link
  *
  * @param ilink Internet link
@@ -351,6 +451,9 @@ errno_t inet_link_send_dgram(inet_link_t *ilink, addr32_t lsrc, addr32_t ldest,
 	packet.data = dgram->data;
 	packet.size = dgram->size;
 
+	size_t mtu = inet_link_offload(ilink, dgram, proto, sizeof(ip_header_t),
+	    IPLINK_OFFLOAD_TSO4, &sdu.offload);
+
 	errno_t rc;
 	size_t offs = 0;
 
@@ -358,7 +461,7 @@ errno_t inet_link_send_dgram(inet_link_t *ilink, addr32_t lsrc, addr32_t ldest,
 		/* Encode one fragment */
 
 		size_t roffs;
-		rc = inet_pdu_encode(&packet, src_v4, dest_v4, offs, ilink->def_mtu,
+		rc = inet_pdu_encode(&packet, src_v4, dest_v4, offs, mtu,
 		    &sdu.data, &sdu.size, &roffs);
 		if (rc != EOK)
 			return rc;
@@ -424,6 +527,9 @@ errno_t inet_link_send_dgram6(inet_link_t *ilink, addr48_t ldest,
 	packet.data = dgram->data;
 	packet.size = dgram->size;
 
+	size_t mtu = inet_link_offload(ilink, dgram, proto, sizeof(ip6_header_t),
+	    IPLINK_OFFLOAD_TSO6, &sdu6.offload);
+
 	errno_t rc;
 	size_t offs = 0;
 
@@ -431,7 +537,7 @@ errno_t inet_link_send_dgram6(inet_link_t *ilink, addr48_t ldest,
 		/* Encode one fragment */
 
 		size_t roffs;
-		rc = inet_pdu_encode6(&packet, src_v6, dest_v6, offs, ilink->def_mtu,
+		rc = inet_pdu_encode6(&packet, src_v6, dest_v6, offs, mtu,
 		    &sdu6.data, &sdu6.size, &roffs);
 		if (rc != EOK)
 			return rc;
@@ -41,6 +41,10 @@
 
 #define IP6_NEXT_FRAGMENT  44
 
+/** Transport protocols whose checksum inetsrv may need to complete */
+#define IP_PROTO_TCP  6
+#define IP_PROTO_UDP  17
+
 /** IPv4 Datagram header (fixed part) */
 typedef struct {
 	/** Version, Internet Header Length */
@@ -43,6 +43,7 @@
 #include <ipc/inet.h>
 #include <ipc/services.h>
 #include <loc.h>
+#include <mem.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -87,8 +88,12 @@ static errno_t inet_init(void)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_init()");
 
+	errno_t rc = inet_reass_init();
+	if (rc != EOK)
+		return rc;
+
 	port_id_t port;
-	errno_t rc = async_create_port(INTERFACE_INET,
+	rc = async_create_port(INTERFACE_INET,
 	    inet_default_conn, NULL, &port);
 	if (rc != EOK)
 		return rc;
@@ -296,6 +301,12 @@ static void inet_send_srv(inet_client_t *client, ipc_call_t *icall)
 	uint8_t ttl = ipc_get_arg3(icall);
 	int df = ipc_get_arg4(icall);
 
+	/* Transport header starts the datagram */
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
+	dgram.offload.flags = ipc_get_arg5(icall) & 0xff;
+	dgram.offload.csum_offset = (ipc_get_arg5(icall) >> 8) & 0xff;
+	dgram.offload.gso_size = (ipc_get_arg5(icall) >> 16) & 0xffff;
+
 	ipc_call_t call;
 	size_t size;
 	if (!async_data_write_receive(&call, &size)) {
@@ -449,8 +460,8 @@ errno_t inet_ev_recv(inet_client_t *client, inet_dgram_t *dgram)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_ev_recv: iplink=%zu",
 	    dgram->iplink);
 
-	aid_t req = async_send_2(exch, INET_EV_RECV, dgram->tos,
-	    dgram->iplink, &answer);
+	aid_t req = async_send_3(exch, INET_EV_RECV, dgram->tos,
+	    dgram->iplink, dgram->offload.flags, &answer);
 
 	errno_t rc = async_data_write_start(exch, &dgram->src, sizeof(inet_addr_t));
 	if (rc != EOK) {
@@ -525,6 +536,9 @@ errno_t inet_recv_packet(inet_packet_t *packet)
 			dgram.tos = packet->tos;
 			dgram.data = packet->data;
 			dgram.size = packet->size;
+			memset(&dgram.offload, 0, sizeof(dgram.offload));
+			dgram.offload.flags = packet->offload &
+			    INET_OFFLOAD_CSUM_VALID;
 
 			return inet_recv_dgram_local(&dgram, packet->proto);
 		} else {
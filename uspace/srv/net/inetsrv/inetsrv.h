@@ -99,6 +99,8 @@ typedef struct {
 	void *data;
 	/** Packet data size in bytes */
 	size_t size;
+	/** INET_OFFLOAD_* flags reported by the link */
+	uint16_t offload;
 } inet_packet_t;
 
 typedef struct {
@@ -108,6 +110,8 @@ typedef struct {
 	async_sess_t *sess;
 	iplink_t *iplink;
 	size_t def_mtu;
+	/** Offload capabilities of the link (IPLINK_OFFLOAD_* flags) */
+	uint32_t offload;
 	addr48_t mac;
 	bool mac_valid;
 } inet_link_t;
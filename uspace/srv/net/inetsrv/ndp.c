@@ -67,6 +67,7 @@ static errno_t ndp_send_packet(inet_link_t *link, ndp_packet_t *packet)
 {
 	inet_dgram_t dgram;
 	ndp_pdu_encode(packet, &dgram);
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
 
 	inet_link_send_dgram6(link, packet->target_hw_addr, &dgram,
 	    IP_PROTO_ICMPV6, INET6_HOP_LIMIT_MAX, 0);
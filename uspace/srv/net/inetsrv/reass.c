@@ -34,46 +34,185 @@
  * @brief Datagram reassembly.
  */
 
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
 #include <errno.h>
 #include <fibril_synch.h>
 #include <io/log.h>
 #include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
+#include <str_error.h>
+#include <time.h>
 
 #include "inetsrv.h"
 #include "inet_std.h"
 #include "reass.h"
 
+
+/** Maximum number of disjoint received intervals in one datagram */
+#define REASS_IVAL_MAX 32
+
+/** Memory budget for all datagrams being reassembled (bytes) */
+#define REASS_MEM_MAX (1024 * 1024)
+
+/** Reassembly timeout (s), RFC 791 suggests 15 s, RFC 8200 60 s */
+#define REASS_TIMEOUT 30
+
+/** Interval between checks for expired datagrams (usec) */
+#define REASS_SWEEP_INTERVAL 1000000
+
+/** Key identifying a datagram */
+typedef struct {
+	inet_addr_t src;
+	inet_addr_t dest;
+	uint8_t proto;
+	uint32_t ident;
+} reass_key_t;
+
+/** Interval of datagram data which has been received */
+typedef struct {
+	/** Start offset */
+	size_t b;
+	/** End offset (exclusive) */
+	size_t e;
+} reass_ival_t;
+
 /** Datagram being reassembled.
  *
  * Uniquely identified by (source address, destination address, protocol,
  * identification) per RFC 791 sec. 2.3 / Fragmentation.
+ *
+ * Fragment data is copied directly to its place in the datagram buffer.
+ * Which parts of the datagram have been received is tracked as a sorted
+ * array of disjoint intervals.
  */
 typedef struct {
-	link_t map_link;
-	/** List of fragments, @c reass_frag_t */
-	list_t frags;
+	/** Link in datagram map */
+	ht_link_t map_link;
+	/** Link in age list */
+	link_t age_link;
+	/** Datagram key */
+	reass_key_t key;
+	/** Local link ID (of the first fragment) */
+	service_id_t link_id;
+	/** Type of service (of the first fragment) */
+	uint8_t tos;
+	/** Time when reassembly is abandoned */
+	struct timespec expires;
+	/** Datagram data */
+	uint8_t *data;
+	/** Size of @c data buffer */
+	size_t buf_size;
+	/** Total datagram size if known (last fragment received) */
+	size_t size;
+	/** @c true iff the last fragment has been received */
+	bool have_last;
+	/** Received intervals, sorted by offset */
+	reass_ival_t ival[REASS_IVAL_MAX];
+	/** Number of entries in @c ival */
+	size_t nivals;
 } reass_dgram_t;
 
-/** One datagram fragment */
-typedef struct {
-	link_t dgram_link;
-	inet_packet_t packet;
-} reass_frag_t;
-
-/** Datagram map, list of reass_dgram_t */
-static LIST_INITIALIZE(reass_dgram_map);
-/** Protects access to @c reass_dgram_map */
+/** Datagram map, hash table of reass_dgram_t */
+static hash_table_t reass_dgram_map;
+/** Datagrams ordered by time of arrival of their first fragment */
+static LIST_INITIALIZE(reass_dgram_age);
+/** Protects access to @c reass_dgram_map and @c reass_dgram_age */
 static FIBRIL_MUTEX_INITIALIZE(reass_dgram_map_lock);
+/** Timer for discarding expired datagrams */
+static fibril_timer_t *reass_timer;
+/** @c true iff @c reass_timer is set and its handler has not run yet */
+static bool reass_timer_armed;
+/** Memory used by datagrams being reassembled */
+static size_t reass_mem_used;
 
-static reass_dgram_t *reass_dgram_new(void);
 static reass_dgram_t *reass_dgram_get(inet_packet_t *);
 static errno_t reass_dgram_insert_frag(reass_dgram_t *, inet_packet_t *);
 static bool reass_dgram_complete(reass_dgram_t *);
 static void reass_dgram_remove(reass_dgram_t *);
 static errno_t reass_dgram_deliver(reass_dgram_t *);
 static void reass_dgram_destroy(reass_dgram_t *);
+static void reass_timer_set(void);
+
+static size_t reass_addr_hash(const inet_addr_t *addr)
+{
+	size_t hash;
+	size_t i;
+
+	switch (addr->version) {
+	case ip_v4:
+		return addr->addr;
+	case ip_v6:
+		hash = 0;
+		for (i = 0; i < 16; i += 4) {
+			hash = hash_combine(hash, (addr->addr6[i] << 24) |
+			    (addr->addr6[i + 1] << 16) |
+			    (addr->addr6[i + 2] << 8) | addr->addr6[i + 3]);
+		}
+		return hash;
+	default:
+		return 0;
+	}
+}
+
+static size_t reass_key_hash(const void *arg)
+{
+	const reass_key_t *key = (const reass_key_t *) arg;
+	size_t hash;
+
+	hash = reass_addr_hash(&key->src);
+	hash = hash_combine(hash, reass_addr_hash(&key->dest));
+	hash = hash_combine(hash, key->proto);
+	hash = hash_combine(hash, key->ident);
+	return hash_mix(hash);
+}
+
+static size_t reass_dgram_hash(const ht_link_t *item)
+{
+	reass_dgram_t *rdg = hash_table_get_inst(item, reass_dgram_t,
+	    map_link);
+	return reass_key_hash(&rdg->key);
+}
+
+static bool reass_key_equal(const void *arg, const ht_link_t *item)
+{
+	const reass_key_t *key = (const reass_key_t *) arg;
+	reass_dgram_t *rdg = hash_table_get_inst(item, reass_dgram_t,
+	    map_link);
+
+	return key->proto == rdg->key.proto &&
+	    key->ident == rdg->key.ident &&
+	    inet_addr_compare(&key->src, &rdg->key.src) &&
+	    inet_addr_compare(&key->dest, &rdg->key.dest);
+}
+
+static hash_table_ops_t reass_dgram_map_ops = {
+	.hash = reass_dgram_hash,
+	.key_hash = reass_key_hash,
+	.key_equal = reass_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+/** Initialize datagram reassembly.
+ *
+ * @return EOK on success or ENOMEM
+ */
+errno_t inet_reass_init(void)
+{
+	if (!hash_table_create(&reass_dgram_map, 0, 0, &reass_dgram_map_ops))
+		return ENOMEM;
+
+	reass_timer = fibril_timer_create(&reass_dgram_map_lock);
+	if (reass_timer == NULL) {
+		hash_table_destroy(&reass_dgram_map);
+		return ENOMEM;
+	}
+
+	return EOK;
+}
 
 /** Queue packet for datagram reassembly.
  *
@@ -100,8 +239,15 @@ errno_t inet_reass_queue_packet(inet_packet_t *packet)
 
 	/* Insert fragment into the datagram */
 	rc = reass_dgram_insert_frag(rdg, packet);
-	if (rc != EOK)
-		return ENOMEM;
+	if (rc != EOK) {
+		/* Datagram cannot be reassembled, drop it altogether */
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Dropping datagram (%s).",
+		    str_error_name(rc));
+		reass_dgram_remove(rdg);
+		fibril_mutex_unlock(&reass_dgram_map_lock);
+		reass_dgram_destroy(rdg);
+		return rc;
+	}
 
 	/* Check if datagram is complete */
 	if (reass_dgram_complete(rdg)) {
@@ -126,153 +272,224 @@ errno_t inet_reass_queue_packet(inet_packet_t *packet)
  */
 static reass_dgram_t *reass_dgram_get(inet_packet_t *packet)
 {
-	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
+	reass_dgram_t *rdg;
+	reass_key_t key;
+	ht_link_t *link;
 
-	list_foreach(reass_dgram_map, map_link, reass_dgram_t, rdg) {
-		link_t *f1_link = list_first(&rdg->frags);
-		assert(f1_link != NULL);
+	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
 
-		reass_frag_t *f1 = list_get_instance(f1_link, reass_frag_t,
-		    dgram_link);
+	key.src = packet->src;
+	key.dest = packet->dest;
+	key.proto = packet->proto;
+	key.ident = packet->ident;
 
-		if ((inet_addr_compare(&f1->packet.src, &packet->src)) &&
-		    (inet_addr_compare(&f1->packet.dest, &packet->dest)) &&
-		    (f1->packet.proto == packet->proto) &&
-		    (f1->packet.ident == packet->ident)) {
-			/* Match */
-			return rdg;
-		}
-	}
+	link = hash_table_find(&reass_dgram_map, &key);
+	if (link != NULL)
+		return hash_table_get_inst(link, reass_dgram_t, map_link);
 
 	/* No existing reassembly structure. Create a new one. */
-	return reass_dgram_new();
-}
-
-/** Create new datagram reassembly structure.
- *
- * @return New datagram reassembly structure.
- */
-static reass_dgram_t *reass_dgram_new(void)
-{
-	reass_dgram_t *rdg;
-
 	rdg = calloc(1, sizeof(reass_dgram_t));
 	if (rdg == NULL)
 		return NULL;
 
-	list_append(&rdg->map_link, &reass_dgram_map);
-	list_initialize(&rdg->frags);
+	rdg->key = key;
+	rdg->link_id = packet->link_id;
+	rdg->tos = packet->tos;
+	getuptime(&rdg->expires);
+	ts_add_diff(&rdg->expires, SEC2NSEC(REASS_TIMEOUT));
 
-	return rdg;
-}
+	hash_table_insert(&reass_dgram_map, &rdg->map_link);
+	list_append(&rdg->age_link, &reass_dgram_age);
+	reass_mem_used += sizeof(reass_dgram_t);
 
-static reass_frag_t *reass_frag_new(void)
-{
-	reass_frag_t *frag;
-
-	frag = calloc(1, sizeof(reass_frag_t));
-	if (frag == NULL)
-		return NULL;
+	/* Make sure the datagram does not stay around forever */
+	if (list_first(&reass_dgram_age) == &rdg->age_link)
+		reass_timer_set();
 
-	link_initialize(&frag->dgram_link);
-
-	return frag;
+	return rdg;
 }
 
-static errno_t reass_dgram_insert_frag(reass_dgram_t *rdg, inet_packet_t *packet)
+/** Discard oldest datagrams until more memory fits within the budget.
+ *
+ * @param keep		Datagram which must not be discarded
+ * @param size		Amount of memory needed
+ * @return		@c true if @a size bytes fit within the budget
+ */
+static bool reass_mem_reclaim(reass_dgram_t *keep, size_t size)
 {
-	reass_frag_t *frag;
-	void *data_copy;
 	link_t *link;
+	reass_dgram_t *rdg;
 
 	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
 
-	frag = reass_frag_new();
+	link = list_first(&reass_dgram_age);
+	while (reass_mem_used + size > REASS_MEM_MAX && link != NULL) {
+		rdg = list_get_instance(link, reass_dgram_t, age_link);
+		link = list_next(link, &reass_dgram_age);
 
-	/* Clone the packet */
+		if (rdg == keep)
+			continue;
 
-	data_copy = malloc(packet->size);
-	if (data_copy == NULL) {
-		free(frag);
-		return ENOMEM;
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Reassembly memory exhausted, "
+		    "dropping oldest datagram.");
+		reass_dgram_remove(rdg);
+		reass_dgram_destroy(rdg);
 	}
 
-	memcpy(data_copy, packet->data, packet->size);
+	return reass_mem_used + size <= REASS_MEM_MAX;
+}
+
+/** Make sure datagram buffer can hold data up to a given offset.
+ *
+ * @param rdg		Datagram reassembly structure
+ * @param end		End offset of data which needs to fit
+ * @param limit		Maximum datagram size
+ * @return		EOK on success, ENOMEM if out of memory or over budget
+ */
+static errno_t reass_dgram_grow(reass_dgram_t *rdg, size_t end, size_t limit)
+{
+	size_t nsize;
+	uint8_t *ndata;
 
-	frag->packet = *packet;
-	frag->packet.data = data_copy;
+	if (end <= rdg->buf_size)
+		return EOK;
 
 	/*
-	 * XXX Make resource-consuming attacks harder, eliminate any duplicate
-	 * data immediately. Possibly eliminate redundant packet headers.
+	 * Until we know the datagram size, grow geometrically so that
+	 * fragments arriving in order do not cause a reallocation each.
 	 */
+	if (rdg->have_last)
+		nsize = rdg->size;
+	else
+		nsize = min(max(end, 2 * rdg->buf_size), limit);
 
-	/*
-	 * Insert into the list, which is sorted by offs member ascending.
-	 */
+	if (!reass_mem_reclaim(rdg, nsize - rdg->buf_size))
+		return ENOMEM;
 
-	link = list_first(&rdg->frags);
-	while (link != NULL) {
-		reass_frag_t *qf = list_get_instance(link, reass_frag_t,
-		    dgram_link);
+	ndata = realloc(rdg->data, nsize);
+	if (ndata == NULL)
+		return ENOMEM;
 
-		if (qf->packet.offs >= packet->offs)
-			break;
+	reass_mem_used += nsize - rdg->buf_size;
+	rdg->data = ndata;
+	rdg->buf_size = nsize;
+	return EOK;
+}
 
-		link = list_next(link, &rdg->frags);
+/** Record that interval of datagram data has been received.
+ *
+ * @param rdg		Datagram reassembly structure
+ * @param b		Start offset
+ * @param e		End offset (exclusive)
+ * @return		EOK on success, ELIMIT if there are too many holes
+ */
+static errno_t reass_dgram_add_ival(reass_dgram_t *rdg, size_t b, size_t e)
+{
+	size_t i, j;
+
+	/* Find first interval which is not entirely before the new one */
+	i = 0;
+	while (i < rdg->nivals && rdg->ival[i].e < b)
+		++i;
+
+	/* Merge with all intervals the new one overlaps or touches */
+	j = i;
+	while (j < rdg->nivals && rdg->ival[j].b <= e) {
+		b = min(b, rdg->ival[j].b);
+		e = max(e, rdg->ival[j].e);
+		++j;
 	}
 
-	if (link != NULL)
-		list_insert_after(&frag->dgram_link, link);
-	else
-		list_append(&frag->dgram_link, &rdg->frags);
+	if (i == j) {
+		/* No merge, insert a new interval */
+		if (rdg->nivals >= REASS_IVAL_MAX)
+			return ELIMIT;
+
+		memmove(&rdg->ival[i + 1], &rdg->ival[i],
+		    (rdg->nivals - i) * sizeof(reass_ival_t));
+		++rdg->nivals;
+	} else {
+		/* Intervals i..j-1 are replaced by one */
+		memmove(&rdg->ival[i + 1], &rdg->ival[j],
+		    (rdg->nivals - j) * sizeof(reass_ival_t));
+		rdg->nivals -= j - i - 1;
+	}
 
+	rdg->ival[i].b = b;
+	rdg->ival[i].e = e;
 	return EOK;
 }
 
-/** Check if datagram is complete.
+/** Insert fragment into datagram.
  *
  * @param rdg		Datagram reassembly structure
- * @return		@c true if complete, @c false if not
+ * @param packet	Fragment
+ * @return		EOK on success, ENOMEM if out of memory or over
+ *			budget, EINVAL if the fragment is not consistent
+ *			with the rest of the datagram, ELIMIT if the
+ *			datagram would be too large or too fragmented
  */
-static bool reass_dgram_complete(reass_dgram_t *rdg)
+static errno_t reass_dgram_insert_frag(reass_dgram_t *rdg, inet_packet_t *packet)
 {
-	reass_frag_t *frag, *prev;
-	link_t *link;
+	size_t fragoff_limit;
+	size_t end;
+	errno_t rc;
 
 	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
-	assert(!list_empty(&rdg->frags));
 
-	link = list_first(&rdg->frags);
-	assert(link != NULL);
+	/* Upper bound for fragment offset field */
+	fragoff_limit = 1 << (FF_FRAGOFF_h - FF_FRAGOFF_l + 1);
 
-	frag = list_get_instance(link, reass_frag_t,
-	    dgram_link);
+	end = packet->offs + packet->size;
 
-	/* First fragment must be at offset zero */
-	if (frag->packet.offs != 0)
-		return false;
+	/* Verify that total size of datagram is within reasonable bounds */
+	if (end > FRAG_OFFS_UNIT * fragoff_limit)
+		return ELIMIT;
 
-	prev = frag;
+	if (!packet->mf) {
+		/* Last fragment determines datagram size */
+		if (rdg->have_last && rdg->size != end)
+			return EINVAL;
+		if (rdg->nivals > 0 && rdg->ival[rdg->nivals - 1].e > end)
+			return EINVAL;
+
+		rdg->size = end;
+		rdg->have_last = true;
+	} else if (rdg->have_last && end > rdg->size) {
+		return EINVAL;
+	}
 
-	while (true) {
-		link = list_next(link, &rdg->frags);
-		if (link == NULL)
-			break;
+	if (packet->size == 0)
+		return EOK;
+
+	rc = reass_dgram_grow(rdg, end, FRAG_OFFS_UNIT * fragoff_limit);
+	if (rc != EOK)
+		return rc;
 
-		/* Each next fragment must follow immediately or overlap */
-		frag = list_get_instance(link, reass_frag_t, dgram_link);
-		if (frag->packet.offs > prev->packet.offs + prev->packet.size)
-			return false;
+	rc = reass_dgram_add_ival(rdg, packet->offs, end);
+	if (rc != EOK)
+		return rc;
 
-		/* No more fragments - datagram is complete */
-		if (!frag->packet.mf)
-			return true;
+	/*
+	 * Copy data straight to its place. Overlapping fragments overwrite
+	 * what was there before.
+	 */
+	memcpy(rdg->data + packet->offs, packet->data, packet->size);
+	return EOK;
+}
 
-		prev = frag;
-	}
+/** Check if datagram is complete.
+ *
+ * @param rdg		Datagram reassembly structure
+ * @return		@c true if complete, @c false if not
+ */
+static bool reass_dgram_complete(reass_dgram_t *rdg)
+{
+	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
 
-	return false;
+	/* All data up to the last fragment must be received without holes */
+	return rdg->have_last && rdg->nivals == 1 && rdg->ival[0].b == 0 &&
+	    rdg->ival[0].e == rdg->size;
 }
 
 /** Remove datagram from reassembly map.
@@ -282,100 +499,93 @@ static bool reass_dgram_complete(reass_dgram_t *rdg)
 static void reass_dgram_remove(reass_dgram_t *rdg)
 {
 	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
-	list_remove(&rdg->map_link);
+
+	hash_table_remove_item(&reass_dgram_map, &rdg->map_link);
+	list_remove(&rdg->age_link);
+	reass_mem_used -= sizeof(reass_dgram_t) + rdg->buf_size;
 }
 
 /** Deliver complete datagram.
+ *
+ * The datagram buffer is passed on directly, fragment data is not copied
+ * again.
  *
  * @param rdg		Datagram reassembly structure.
  */
 static errno_t reass_dgram_deliver(reass_dgram_t *rdg)
 {
-	size_t dgram_size;
-	size_t fragoff_limit;
 	inet_dgram_t dgram;
-	uint8_t proto;
-	reass_frag_t *frag;
-	errno_t rc;
-
-	/*
-	 * Potentially there could be something beyond the first packet
-	 * that has !MF. Make sure we ignore that.
-	 */
-	frag = NULL;
-	list_foreach(rdg->frags, dgram_link, reass_frag_t, cfrag) {
-		if (!cfrag->packet.mf) {
-			frag = cfrag;
-			break;
-		}
-	}
-
-	assert(frag != NULL);
-	assert(!frag->packet.mf);
-
-	dgram_size = frag->packet.offs + frag->packet.size;
-
-	/* Upper bound for fragment offset field */
-	fragoff_limit = 1 << (FF_FRAGOFF_h - FF_FRAGOFF_l + 1);
-
-	/* Verify that total size of datagram is within reasonable bounds */
-	if (dgram_size > FRAG_OFFS_UNIT * fragoff_limit)
-		return ELIMIT;
-
-	dgram.data = calloc(dgram_size, 1);
-	if (dgram.data == NULL)
-		return ENOMEM;
 
 	/* XXX What if different fragments came from different link? */
-	dgram.iplink = frag->packet.link_id;
-	dgram.size = dgram_size;
-	dgram.src = frag->packet.src;
-	dgram.dest = frag->packet.dest;
-	dgram.tos = frag->packet.tos;
-	proto = frag->packet.proto;
-
-	/* Pull together data from individual fragments */
+	dgram.iplink = rdg->link_id;
+	dgram.size = rdg->size;
+	dgram.src = rdg->key.src;
+	dgram.dest = rdg->key.dest;
+	dgram.tos = rdg->tos;
+	dgram.data = rdg->data;
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
+
+	return inet_recv_dgram_local(&dgram, rdg->key.proto);
+}
 
-	size_t doffs = 0;
+/** Destroy datagram reassembly structure.
+ *
+ * @param rdg		Datagram reassembly structure.
+ */
+static void reass_dgram_destroy(reass_dgram_t *rdg)
+{
+	free(rdg->data);
+	free(rdg);
+}
 
-	list_foreach(rdg->frags, dgram_link, reass_frag_t, cfrag) {
-		size_t cb, ce;
+/** Discard expired datagrams.
+ *
+ * @param arg		Not used
+ */
+static void reass_timer_fun(void *arg)
+{
+	struct timespec now;
+	reass_dgram_t *rdg;
+	link_t *link;
 
-		cb = max(doffs, cfrag->packet.offs);
-		ce = min(dgram_size, cfrag->packet.offs + cfrag->packet.size);
+	fibril_mutex_lock(&reass_dgram_map_lock);
 
-		if (ce > cb) {
-			memcpy(dgram.data + cb,
-			    cfrag->packet.data + cb - cfrag->packet.offs,
-			    ce - cb);
-		}
+	reass_timer_armed = false;
+	getuptime(&now);
 
-		if (!cfrag->packet.mf)
+	while ((link = list_first(&reass_dgram_age)) != NULL) {
+		rdg = list_get_instance(link, reass_dgram_t, age_link);
+		if (!ts_gteq(&now, &rdg->expires))
 			break;
+
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Reassembly timed out, "
+		    "dropping datagram.");
+		reass_dgram_remove(rdg);
+		reass_dgram_destroy(rdg);
 	}
 
-	rc = inet_recv_dgram_local(&dgram, proto);
-	free(dgram.data);
-	return rc;
+	if (!list_empty(&reass_dgram_age))
+		reass_timer_set();
+
+	fibril_mutex_unlock(&reass_dgram_map_lock);
 }
 
-/** Destroy datagram reassembly structure.
+/** Arm timer for discarding expired datagrams.
  *
- * @param rdg		Datagram reassembly structure.
+ * Nothing is done if the timer is already armed. The timer may still be
+ * armed even if all datagrams have been completed since, in which case
+ * the sweep simply finds nothing to discard.
  */
-static void reass_dgram_destroy(reass_dgram_t *rdg)
+static void reass_timer_set(void)
 {
-	while (!list_empty(&rdg->frags)) {
-		link_t *flink = list_first(&rdg->frags);
-		reass_frag_t *frag = list_get_instance(flink, reass_frag_t,
-		    dgram_link);
-
-		list_remove(&frag->dgram_link);
-		free(frag->packet.data);
-		free(frag);
-	}
+	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
 
-	free(rdg);
+	if (reass_timer_armed)
+		return;
+
+	fibril_timer_set_locked(reass_timer, REASS_SWEEP_INTERVAL,
+	    reass_timer_fun, NULL);
+	reass_timer_armed = true;
 }
 
 /** @}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <inet/addr.h>
+#include <io/log.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdlib.h>
+
+#include "../inetsrv.h"
+#include "../reass.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(reass);
+
+enum {
+	test_dgram_size = 64,
+	test_dgrams_max = 4
+};
+
+/** Number of datagrams delivered by reassembly */
+static size_t deliv_cnt;
+/** Sizes of delivered datagrams */
+static size_t deliv_size[test_dgrams_max];
+/** Contents of delivered datagrams */
+static uint8_t deliv_data[test_dgrams_max][test_dgram_size];
+
+static bool reass_initialized;
+
+/** Stands in for the inetsrv function receiving reassembled datagrams */
+errno_t inet_recv_dgram_local(inet_dgram_t *dgram, uint8_t proto)
+{
+	PCUT_ASSERT_TRUE(deliv_cnt < test_dgrams_max);
+	PCUT_ASSERT_TRUE(dgram->size <= test_dgram_size);
+
+	deliv_size[deliv_cnt] = dgram->size;
+	memcpy(deliv_data[deliv_cnt], dgram->data, dgram->size);
+	++deliv_cnt;
+	return EOK;
+}
+
+PCUT_TEST_BEFORE
+{
+	errno_t rc;
+
+	if (!reass_initialized) {
+		/* We will be calling functions that perform logging */
+		rc = log_init("test-inetsrv");
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+		rc = inet_reass_init();
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		reass_initialized = true;
+	}
+
+	deliv_cnt = 0;
+}
+
+/** Fill in a fragment of a test datagram.
+ *
+ * @param packet Packet to fill in
+ * @param ident Datagram identifier
+ * @param data Datagram data
+ * @param offs Offset of the fragment
+ * @param size Size of the fragment
+ * @param last @c true iff this is the last fragment
+ */
+static void test_frag_init(inet_packet_t *packet, uint32_t ident,
+    uint8_t *data, size_t offs, size_t size, bool last)
+{
+	memset(packet, 0, sizeof(inet_packet_t));
+	inet_addr(&packet->src, 10, 0, 0, 1);
+	inet_addr(&packet->dest, 10, 0, 0, 2);
+	packet->proto = 17;
+	packet->ttl = 64;
+	packet->ident = ident;
+	packet->mf = !last;
+	packet->offs = offs;
+	packet->data = data + offs;
+	packet->size = size;
+}
+
+/** Fill test datagram data with a pattern depending on @a seed */
+static void test_data_init(uint8_t *data, uint8_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < test_dgram_size; i++)
+		data[i] = seed + i;
+}
+
+/** Two fragmented datagrams reassembled one right after the other */
+PCUT_TEST(two_dgrams_back_to_back)
+{
+	uint8_t data[2][test_dgram_size];
+	inet_packet_t packet;
+	uint32_t i;
+	errno_t rc;
+
+	for (i = 0; i < 2; i++) {
+		test_data_init(data[i], 0x10 * (i + 1));
+
+		test_frag_init(&packet, 100 + i, data[i], 0,
+		    test_dgram_size / 2, false);
+		rc = inet_reass_queue_packet(&packet);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		PCUT_ASSERT_INT_EQUALS(i, deliv_cnt);
+
+		test_frag_init(&packet, 100 + i, data[i], test_dgram_size / 2,
+		    test_dgram_size / 2, true);
+		rc = inet_reass_queue_packet(&packet);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		PCUT_ASSERT_INT_EQUALS(i + 1, deliv_cnt);
+	}
+
+	for (i = 0; i < 2; i++) {
+		PCUT_ASSERT_INT_EQUALS(test_dgram_size, deliv_size[i]);
+		PCUT_ASSERT_INT_EQUALS(0, memcmp(data[i], deliv_data[i],
+		    test_dgram_size));
+	}
+}
+
+/** Fragments arriving in reverse order, interleaved with another datagram */
+PCUT_TEST(interleaved_reverse)
+{
+	uint8_t data[2][test_dgram_size];
+	inet_packet_t packet;
+	errno_t rc;
+
+	test_data_init(data[0], 0x40);
+	test_data_init(data[1], 0x80);
+
+	test_frag_init(&packet, 200, data[0], test_dgram_size / 2,
+	    test_dgram_size / 2, true);
+	rc = inet_reass_queue_packet(&packet);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_frag_init(&packet, 201, data[1], 0, test_dgram_size / 2, false);
+	rc = inet_reass_queue_packet(&packet);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_frag_init(&packet, 200, data[0], 0, test_dgram_size / 2, false);
+	rc = inet_reass_queue_packet(&packet);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(1, deliv_cnt);
+
+	test_frag_init(&packet, 201, data[1], test_dgram_size / 2,
+	    test_dgram_size / 2, true);
+	rc = inet_reass_queue_packet(&packet);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(2, deliv_cnt);
+
+	PCUT_ASSERT_INT_EQUALS(test_dgram_size, deliv_size[0]);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data[0], deliv_data[0],
+	    test_dgram_size));
+	PCUT_ASSERT_INT_EQUALS(test_dgram_size, deliv_size[1]);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data[1], deliv_data[1],
+	    test_dgram_size));
+}
+
+PCUT_EXPORT(reass);
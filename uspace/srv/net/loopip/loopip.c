@@ -54,6 +54,7 @@ static errno_t loopip_close(iplink_srv_t *srv);
 static errno_t loopip_send(iplink_srv_t *srv, iplink_sdu_t *sdu);
 static errno_t loopip_send6(iplink_srv_t *srv, iplink_sdu6_t *sdu);
 static errno_t loopip_get_mtu(iplink_srv_t *srv, size_t *mtu);
+static errno_t loopip_get_offload(iplink_srv_t *srv, uint32_t *offload);
 static errno_t loopip_get_mac48(iplink_srv_t *srv, addr48_t *mac);
 static errno_t loopip_addr_add(iplink_srv_t *srv, inet_addr_t *addr);
 static errno_t loopip_addr_remove(iplink_srv_t *srv, inet_addr_t *addr);
@@ -66,6 +67,7 @@ static iplink_ops_t loopip_iplink_ops = {
 	.send = loopip_send,
 	.send6 = loopip_send6,
 	.get_mtu = loopip_get_mtu,
+	.get_offload = loopip_get_offload,
 	.get_mac48 = loopip_get_mac48,
 	.addr_add = loopip_addr_add,
 	.addr_remove = loopip_addr_remove
@@ -186,6 +188,9 @@ static errno_t loopip_send(iplink_srv_t *srv, iplink_sdu_t *sdu)
 	memcpy(rqe->sdu.data, sdu->data, sdu->size);
 	rqe->sdu.size = sdu->size;
 
+	/* Data never leaves memory, no need to checksum it */
+	rqe->sdu.offload = INET_OFFLOAD_CSUM_VALID;
+
 	/*
 	 * Insert to receive queue
 	 */
@@ -215,6 +220,9 @@ static errno_t loopip_send6(iplink_srv_t *srv, iplink_sdu6_t *sdu)
 	memcpy(rqe->sdu.data, sdu->data, sdu->size);
 	rqe->sdu.size = sdu->size;
 
+	/* Data never leaves memory, no need to checksum it */
+	rqe->sdu.offload = INET_OFFLOAD_CSUM_VALID;
+
 	/*
 	 * Insert to receive queue
 	 */
@@ -230,6 +238,13 @@ static errno_t loopip_get_mtu(iplink_srv_t *srv, size_t *mtu)
 	return EOK;
 }
 
+static errno_t loopip_get_offload(iplink_srv_t *srv, uint32_t *offload)
+{
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "loopip_get_offload()");
+	*offload = IPLINK_OFFLOAD_TX_CSUM | IPLINK_OFFLOAD_RX_CSUM;
+	return EOK;
+}
+
 static errno_t loopip_get_mac48(iplink_srv_t *src, addr48_t *mac)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "loopip_get_mac48()");
@@ -236,6 +236,7 @@ static errno_t slip_recv_fibril(void *arg)
 	errno_t rc;
 
 	sdu.data = recv_final;
+	sdu.offload = 0;
 
 	while (true) {
 		sdu.size = 0;
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+
+/**
+ * @file Congestion control
+ *
+ * Slow start and congestion avoidance (RFC 5681) with either the NewReno
+ * or the CUBIC (RFC 8312) window growth function. Fast retransmit and
+ * fast recovery are driven by the retransmission queue, this module only
+ * decides how the congestion window grows and by how much it is reduced
+ * upon loss.
+ *
+ * All window sizes are in bytes. CUBIC uses fixed-point arithmetic with
+ * time measured in milliseconds, C = 0.4 and beta = 0.7.
+ */
+
+#include <macros.h>
+#include <stdint.h>
+#include "cc.h"
+#include "tcp_type.h"
+
+/** Upper bound on the congestion window */
+#define TCP_CWND_MAX	(1 << 30)
+
+/** CUBIC multiplicative decrease factor (beta = 7 / 10) */
+#define CUBIC_BETA_NUM	7
+#define CUBIC_BETA_DEN	10
+
+/** Limit on |t - K| (ms) to keep the cubic term within 64 bits */
+#define CUBIC_D_MAX	500000
+
+/** Integer cube root.
+ *
+ * @param a Argument
+ * @return Largest integer r such that r^3 <= a
+ */
+static uint32_t tcp_cc_cbrt(uint64_t a)
+{
+	uint64_t lo, hi, mid;
+
+	/* (2^21)^3 = 2^63 */
+	lo = 0;
+	hi = 1 << 21;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (mid * mid * mid <= a)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+/** Increase congestion window, observing the upper bound. */
+static void tcp_cc_cwnd_inc(tcp_cc_t *cc, uint64_t inc)
+{
+	cc->cwnd = min((uint64_t) cc->cwnd + inc, TCP_CWND_MAX);
+}
+
+/** Initialize congestion control state.
+ *
+ * The initial window is set according to RFC 5681 section 3.1.
+ *
+ * @param cc   Congestion control state
+ * @param alg  Algorithm
+ * @param smss Sender maximum segment size
+ */
+void tcp_cc_init(tcp_cc_t *cc, tcp_cc_alg_t alg, uint32_t smss)
+{
+	cc->alg = alg;
+	cc->smss = smss;
+
+	if (smss > 2190)
+		cc->cwnd = 2 * smss;
+	else if (smss > 1095)
+		cc->cwnd = 3 * smss;
+	else
+		cc->cwnd = 4 * smss;
+
+	cc->ssthresh = TCP_CWND_MAX;
+	cc->w_max = 0;
+	cc->epoch_valid = false;
+}
+
+/** Select congestion control algorithm.
+ *
+ * The current window is kept, the new algorithm takes over from
+ * the next acknowledgement.
+ *
+ * @param cc  Congestion control state
+ * @param alg Algorithm
+ */
+void tcp_cc_set_alg(tcp_cc_t *cc, tcp_cc_alg_t alg)
+{
+	cc->alg = alg;
+	cc->w_max = 0;
+	cc->epoch_valid = false;
+}
+
+/** NewReno congestion avoidance.
+ *
+ * Grow the window by roughly one segment per round-trip time.
+ */
+static void tcp_cc_newreno_ca(tcp_cc_t *cc, uint32_t acked)
+{
+	uint64_t inc;
+
+	inc = (uint64_t) cc->smss * acked / cc->cwnd;
+	tcp_cc_cwnd_inc(cc, max(inc, 1));
+}
+
+/** Start a new CUBIC congestion avoidance epoch. */
+static void tcp_cc_cubic_epoch_start(tcp_cc_t *cc, usec_t now)
+{
+	uint64_t k3;
+
+	cc->epoch_valid = true;
+	cc->epoch = now;
+	cc->epoch_cwnd = cc->cwnd;
+
+	if (cc->cwnd < cc->w_max) {
+		/* K = cbrt((W_max - cwnd) / C), in segments and milliseconds */
+		k3 = (uint64_t) (cc->w_max - cc->cwnd) * 2500 / cc->smss *
+		    1000000;
+		cc->k = tcp_cc_cbrt(k3);
+		cc->origin = cc->w_max;
+	} else {
+		cc->k = 0;
+		cc->origin = cc->cwnd;
+	}
+}
+
+/** CUBIC congestion avoidance.
+ *
+ * @param cc    Congestion control state
+ * @param acked Number of newly acknowledged bytes
+ * @param now   Current time
+ * @param srtt  Smoothed round-trip time
+ */
+static void tcp_cc_cubic_ca(tcp_cc_t *cc, uint32_t acked, usec_t now,
+    usec_t srtt)
+{
+	int64_t d;
+	int64_t w_cubic;
+	uint64_t w_est;
+	uint64_t target;
+	uint64_t inc;
+
+	if (!cc->epoch_valid)
+		tcp_cc_cubic_epoch_start(cc, now);
+
+	/* d = t + RTT - K in milliseconds */
+	d = (now - cc->epoch + srtt) / 1000 - cc->k;
+	d = max(min(d, CUBIC_D_MAX), -CUBIC_D_MAX);
+
+	/* W_cubic(t + RTT) = C (t + RTT - K)^3 + W_max */
+	w_cubic = (int64_t) cc->origin +
+	    d * d * d / 1000 * cc->smss * 4 / 10000000;
+	if (w_cubic < (int64_t) cc->smss)
+		w_cubic = cc->smss;
+
+	/* W_est(t) = W_max * beta + 3 (1 - beta) / (1 + beta) * t / RTT */
+	if (srtt > 0) {
+		w_est = cc->epoch_cwnd + (uint64_t) (now - cc->epoch) * 529 *
+		    cc->smss / (1000 * srtt);
+		if (w_est > (uint64_t) w_cubic) {
+			/* TCP-friendly region */
+			if (w_est > cc->cwnd)
+				tcp_cc_cwnd_inc(cc, w_est - cc->cwnd);
+			return;
+		}
+	}
+
+	target = w_cubic;
+	if (target > cc->cwnd) {
+		/* Concave or convex region, at most 1.5 cwnd per RTT */
+		target = min(target, (uint64_t) cc->cwnd * 3 / 2);
+		inc = (target - cc->cwnd) * acked / cc->cwnd;
+	} else {
+		/* Plateau, grow very slowly */
+		inc = (uint64_t) acked * cc->smss / (100 * (uint64_t) cc->cwnd);
+	}
+
+	tcp_cc_cwnd_inc(cc, inc);
+}
+
+/** Update congestion window after new data was acknowledged.
+ *
+ * Not to be called during fast recovery.
+ *
+ * @param cc    Congestion control state
+ * @param acked Number of newly acknowledged bytes
+ * @param now   Current time
+ * @param srtt  Smoothed round-trip time (zero if not known yet)
+ */
+void tcp_cc_ack(tcp_cc_t *cc, uint32_t acked, usec_t now, usec_t srtt)
+{
+	if (acked == 0)
+		return;
+
+	if (cc->cwnd < cc->ssthresh) {
+		/* Slow start */
+		tcp_cc_cwnd_inc(cc, min(acked, cc->smss));
+		return;
+	}
+
+	switch (cc->alg) {
+	case tcp_cc_newreno:
+		tcp_cc_newreno_ca(cc, acked);
+		break;
+	case tcp_cc_cubic:
+		tcp_cc_cubic_ca(cc, acked, now, srtt);
+		break;
+	}
+}
+
+/** Compute slow start threshold upon loss detection.
+ *
+ * The congestion window itself is adjusted by the caller as part of
+ * fast recovery.
+ *
+ * @param cc     Congestion control state
+ * @param flight Amount of outstanding data
+ */
+void tcp_cc_loss(tcp_cc_t *cc, uint32_t flight)
+{
+	switch (cc->alg) {
+	case tcp_cc_newreno:
+		cc->ssthresh = max(flight / 2, 2 * cc->smss);
+		break;
+	case tcp_cc_cubic:
+		/* Fast convergence */
+		if (cc->cwnd < cc->w_max) {
+			cc->w_max = (uint64_t) cc->cwnd *
+			    (CUBIC_BETA_DEN + CUBIC_BETA_NUM) /
+			    (2 * CUBIC_BETA_DEN);
+		} else {
+			cc->w_max = cc->cwnd;
+		}
+
+		cc->ssthresh = max((uint64_t) cc->cwnd * CUBIC_BETA_NUM /
+		    CUBIC_BETA_DEN, 2 * cc->smss);
+		cc->epoch_valid = false;
+		break;
+	}
+}
+
+/** Update congestion control state after retransmission timeout.
+ *
+ * @param cc     Congestion control state
+ * @param flight Amount of outstanding data
+ */
+void tcp_cc_timeout(tcp_cc_t *cc, uint32_t flight)
+{
+	tcp_cc_loss(cc, flight);
+
+	/* Loss window */
+	cc->cwnd = cc->smss;
+}
+
+/**
+ * @}
+ */
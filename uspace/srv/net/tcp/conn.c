@@ -34,6 +34,8 @@
  * @file TCP connection processing and state machine
  */
 
+#include <adt/hash.h>
+#include <adt/hash_table.h>
 #include <adt/list.h>
 #include <errno.h>
 #include <inet/endpoint.h>
@@ -42,19 +44,44 @@
 #include <nettl/amap.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
 #include "iqueue.h"
+#include "ncsim.h"
 #include "pdu.h"
+#include "ring.h"
 #include "rqueue.h"
+#include "rtt.h"
 #include "segment.h"
 #include "seq_no.h"
+#include "std.h"
 #include "tcp_type.h"
 #include "tqueue.h"
 #include "ucall.h"
 
-#define RCV_BUF_SIZE 4096/*2*/
-#define SND_BUF_SIZE 4096
+/** Initial size of receive and send buffers */
+#define RCV_BUF_SIZE (16 * 1024)
+#define SND_BUF_SIZE (16 * 1024)
+
+/** Limits for receive and send buffer auto-tuning */
+#define RCV_BUF_MAX (4 * 1024 * 1024)
+#define SND_BUF_MAX (4 * 1024 * 1024)
+
+/** Largest window we can advertise if the peer does not scale windows */
+#define RCV_WND_MAX_UNSCALED	UINT16_MAX
+
+/** Shortest interval over which the user read rate is measured */
+#define RCV_SPACE_INTERVAL_MIN	(1000)
+
+/** Delayed ACK timeout (RFC 1122 requires less than 0.5 s) */
+#define DELAYED_ACK_TIMEOUT	(200 * 1000)
+/** Acknowledge at least every second segment (RFC 5681 section 4.2) */
+#define DELAYED_ACK_SEGS	2
+
+/** Maximum segment size we advertise (XXX should be derived from link MTU) */
+#define LOCAL_MSS_V4	1460
+#define LOCAL_MSS_V6	1440
 
 #define MAX_SEGMENT_LIFETIME	(15*1000*1000) //(2*60*1000*1000)
 #define TIME_WAIT_TIMEOUT	(2*MAX_SEGMENT_LIFETIME)
@@ -67,6 +94,10 @@ static FIBRIL_MUTEX_INITIALIZE(conn_list_lock);
 static amap_t *amap;
 /** Taken after tcp_conn_t lock */
 static FIBRIL_MUTEX_INITIALIZE(amap_lock);
+/** Connections with fully specified endpoint pair */
+static hash_table_t conn_table;
+/** Taken after amap_lock for writing, alone for reading */
+static FIBRIL_RWLOCK_INITIALIZE(conn_table_lock);
 
 /** Internal loopback configuration */
 tcp_lb_t tcp_conn_lb = tcp_lb_none;
@@ -77,11 +108,83 @@ static void tcp_conn_tw_timer_clear(tcp_conn_t *);
 static void tcp_transmit_segment(inet_ep2_t *, tcp_segment_t *);
 static void tcp_conn_trim_seg_to_wnd(tcp_conn_t *, tcp_segment_t *);
 static void tcp_reply_rst(inet_ep2_t *, tcp_segment_t *);
+static void tcp_conn_ack_timer_set(tcp_conn_t *);
+static void tcp_conn_ack_timer_clear(tcp_conn_t *);
 
 static tcp_tqueue_cb_t tcp_conn_tqueue_cb = {
 	.transmit_seg = tcp_transmit_segment
 };
 
+/** Compute hash of an IP address. */
+static size_t tcp_addr_hash(const inet_addr_t *addr)
+{
+	size_t hash;
+	size_t i;
+
+	switch (addr->version) {
+	case ip_v4:
+		return addr->addr;
+	case ip_v6:
+		hash = 0;
+		for (i = 0; i < 16; i += 4) {
+			hash = hash_combine(hash, (addr->addr6[i] << 24) |
+			    (addr->addr6[i + 1] << 16) |
+			    (addr->addr6[i + 2] << 8) | addr->addr6[i + 3]);
+		}
+		return hash;
+	default:
+		return 0;
+	}
+}
+
+/** Compute hash of an endpoint pair.
+ *
+ * Only addresses and ports are taken into account.
+ *
+ * @param epp Endpoint pair
+ * @return Hash value
+ */
+size_t tcp_ep2_hash(const inet_ep2_t *epp)
+{
+	size_t hash;
+
+	hash = tcp_addr_hash(&epp->remote.addr);
+	hash = hash_combine(hash, epp->remote.port);
+	hash = hash_combine(hash, tcp_addr_hash(&epp->local.addr));
+	hash = hash_combine(hash, epp->local.port);
+	return hash_mix(hash);
+}
+
+static size_t tcp_conn_table_key_hash(const void *key)
+{
+	return tcp_ep2_hash((const inet_ep2_t *) key);
+}
+
+static size_t tcp_conn_table_hash(const ht_link_t *item)
+{
+	tcp_conn_t *conn = hash_table_get_inst(item, tcp_conn_t, lhash);
+	return tcp_ep2_hash(&conn->ident);
+}
+
+static bool tcp_conn_table_key_equal(const void *key, const ht_link_t *item)
+{
+	const inet_ep2_t *epp = (const inet_ep2_t *) key;
+	tcp_conn_t *conn = hash_table_get_inst(item, tcp_conn_t, lhash);
+
+	return epp->local.port == conn->ident.local.port &&
+	    epp->remote.port == conn->ident.remote.port &&
+	    inet_addr_compare(&epp->local.addr, &conn->ident.local.addr) &&
+	    inet_addr_compare(&epp->remote.addr, &conn->ident.remote.addr);
+}
+
+static hash_table_ops_t tcp_conn_table_ops = {
+	.hash = tcp_conn_table_hash,
+	.key_hash = tcp_conn_table_key_hash,
+	.key_equal = tcp_conn_table_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
 /** Initialize connections. */
 errno_t tcp_conns_init(void)
 {
@@ -93,6 +196,12 @@ errno_t tcp_conns_init(void)
 		return ENOMEM;
 	}
 
+	if (!hash_table_create(&conn_table, 0, 0, &tcp_conn_table_ops)) {
+		amap_destroy(amap);
+		amap = NULL;
+		return ENOMEM;
+	}
+
 	return EOK;
 }
 
@@ -101,10 +210,69 @@ void tcp_conns_fini(void)
 {
 	assert(list_empty(&conn_list));
 
+	hash_table_destroy(&conn_table);
 	amap_destroy(amap);
 	amap = NULL;
 }
 
+/** Add connection to connection table if its identity is fully specified.
+ *
+ * Segments of such connections can be looked up without consulting
+ * the association map. Must be called with amap_lock held.
+ *
+ * @param conn Connection
+ */
+static void tcp_conn_table_insert(tcp_conn_t *conn)
+{
+	assert(fibril_mutex_is_locked(&amap_lock));
+
+	if (inet_addr_is_any(&conn->ident.local.addr) ||
+	    conn->ident.local.port == inet_port_any ||
+	    inet_addr_is_any(&conn->ident.remote.addr) ||
+	    conn->ident.remote.port == inet_port_any)
+		return;
+
+	fibril_rwlock_write_lock(&conn_table_lock);
+	hash_table_insert(&conn_table, &conn->lhash);
+	conn->hashed = true;
+	fibril_rwlock_write_unlock(&conn_table_lock);
+}
+
+/** Remove connection from connection table.
+ *
+ * Must be called with amap_lock held.
+ *
+ * @param conn Connection
+ */
+static void tcp_conn_table_remove(tcp_conn_t *conn)
+{
+	assert(fibril_mutex_is_locked(&amap_lock));
+
+	if (!conn->hashed)
+		return;
+
+	fibril_rwlock_write_lock(&conn_table_lock);
+	hash_table_remove_item(&conn_table, &conn->lhash);
+	conn->hashed = false;
+	fibril_rwlock_write_unlock(&conn_table_lock);
+}
+
+/** Determine window scale shift count we offer to the peer.
+ *
+ * @return Smallest shift count which allows advertising a window
+ *         the size of the largest receive buffer
+ */
+static uint8_t tcp_conn_rcv_wscale(void)
+{
+	uint8_t wscale;
+
+	wscale = 0;
+	while ((RCV_BUF_MAX >> wscale) > UINT16_MAX && wscale < TCP_WSCALE_MAX)
+		++wscale;
+
+	return wscale;
+}
+
 /** Create new connection structure.
  *
  * @param epp		Endpoint pair (will be deeply copied)
@@ -126,6 +294,10 @@ tcp_conn_t *tcp_conn_new(inet_ep2_t *epp)
 	if (conn->tw_timer == NULL)
 		goto error;
 
+	conn->ack_timer = fibril_timer_create(&conn->lock);
+	if (conn->ack_timer == NULL)
+		goto error;
+
 	/* One for the user, one for not being in closed state */
 	refcount_init(&conn->refcnt);
 	refcount_up(&conn->refcnt);
@@ -151,6 +323,11 @@ tcp_conn_t *tcp_conn_new(inet_ep2_t *epp)
 
 	/* Set up receive window. */
 	conn->rcv_wnd = conn->rcv_buf_size;
+	conn->rcv_wscale = tcp_conn_rcv_wscale();
+
+	/* Until the peer tells us its MSS */
+	tcp_cc_init(&conn->cc, tcp_cc_newreno, TCP_DEFAULT_MSS);
+	tcp_rtt_init(&conn->rtt);
 
 	/* Initialize incoming segment queue */
 	tcp_iqueue_init(&conn->incoming, conn);
@@ -191,6 +368,8 @@ error:
 		free(conn->snd_buf);
 	if (conn != NULL && conn->tw_timer != NULL)
 		fibril_timer_destroy(conn->tw_timer);
+	if (conn != NULL && conn->ack_timer != NULL)
+		fibril_timer_destroy(conn->ack_timer);
 	if (conn != NULL)
 		free(conn);
 
@@ -221,12 +400,15 @@ static void tcp_conn_free(tcp_conn_t *conn)
 	list_remove(&conn->link);
 	fibril_mutex_unlock(&conn_list_lock);
 
+	tcp_ring_fini(conn);
 	if (conn->rcv_buf != NULL)
 		free(conn->rcv_buf);
 	if (conn->snd_buf != NULL)
 		free(conn->snd_buf);
 	if (conn->tw_timer != NULL)
 		fibril_timer_destroy(conn->tw_timer);
+	if (conn->ack_timer != NULL)
+		fibril_timer_destroy(conn->ack_timer);
 	free(conn);
 }
 
@@ -293,13 +475,38 @@ void tcp_conn_delete(tcp_conn_t *conn)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_conn_delete(%p)", conn->name, conn);
 
+	/*
+	 * Detach the user callbacks under the connection lock. Receive queue
+	 * fibrils may be processing a segment for this connection right now
+	 * and must not call into the (soon to be freed) user object.
+	 */
+	tcp_conn_lock(conn);
 	assert(conn->deleted == false);
 	conn->deleted = true;
 	conn->cb = NULL;
 	conn->cb_arg = NULL;
+	tcp_conn_unlock(conn);
+
 	tcp_conn_delref(conn);
 }
 
+/** Set user callbacks.
+ *
+ * The connection must be locked. All callbacks are invoked with the
+ * connection lock held, so they can use this function directly.
+ *
+ * @param conn		Connection
+ * @param cb		Callbacks
+ * @param arg		Callback argument
+ */
+void tcp_conn_set_cb(tcp_conn_t *conn, tcp_cb_t *cb, void *arg)
+{
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	conn->cb = cb;
+	conn->cb_arg = arg;
+}
+
 /** Enlist connection.
  *
  * Add connection to the connection map.
@@ -323,6 +530,7 @@ errno_t tcp_conn_add(tcp_conn_t *conn)
 
 	conn->ident = aepp;
 	conn->mapped = true;
+	tcp_conn_table_insert(conn);
 	fibril_mutex_unlock(&amap_lock);
 
 	return EOK;
@@ -338,6 +546,7 @@ static void tcp_conn_remove(tcp_conn_t *conn)
 		return;
 
 	fibril_mutex_lock(&amap_lock);
+	tcp_conn_table_remove(conn);
 	amap_remove(amap, &conn->ident);
 	conn->mapped = false;
 	fibril_mutex_unlock(&amap_lock);
@@ -370,6 +579,53 @@ static void tcp_conn_state_set(tcp_conn_t *conn, tcp_cstate_t nstate)
 	}
 }
 
+/** Get maximum segment size we are able to receive.
+ *
+ * @param conn Connection
+ * @return Maximum segment size
+ */
+uint16_t tcp_conn_local_mss(tcp_conn_t *conn)
+{
+	if (conn->ident.remote.addr.version == ip_v6)
+		return LOCAL_MSS_V6;
+
+	return LOCAL_MSS_V4;
+}
+
+/** Set up sender parameters negotiated by SYN options.
+ *
+ * @param conn Connection
+ * @param seg  SYN segment received from the peer
+ */
+static void tcp_conn_syn_options(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	uint32_t smss;
+
+	smss = seg->mss != 0 ? seg->mss : TCP_DEFAULT_MSS;
+	smss = min(smss, tcp_conn_local_mss(conn));
+
+	tcp_cc_init(&conn->cc, conn->cc.alg, smss);
+	conn->sack_ok = seg->sack_perm;
+
+	/*
+	 * We always offer window scaling and timestamps in SYN and only
+	 * agree to them in SYN-ACK if the peer offered them, so they are
+	 * in use iff the peer's SYN carries them (RFC 7323).
+	 */
+	if (seg->wscale_present) {
+		conn->ws_ok = true;
+		conn->snd_wscale = min(seg->wscale, TCP_WSCALE_MAX);
+	} else {
+		conn->ws_ok = false;
+		conn->snd_wscale = 0;
+		conn->rcv_wscale = 0;
+	}
+
+	conn->ts_ok = seg->ts_present;
+	if (conn->ts_ok)
+		conn->ts_recent = seg->ts_val;
+}
+
 /** Synchronize connection.
  *
  * This is the first step of an active connection attempt,
@@ -383,6 +639,7 @@ void tcp_conn_sync(tcp_conn_t *conn)
 	conn->iss = 1;
 	conn->snd_nxt = conn->iss;
 	conn->snd_una = conn->iss;
+	conn->recover = conn->iss;
 	conn->ap = ap_active;
 
 	tcp_tqueue_ctrl_seg(conn, CTL_SYN);
@@ -429,9 +686,21 @@ tcp_conn_t *tcp_conn_find_ref(inet_ep2_t *epp)
 	errno_t rc;
 	void *arg;
 	tcp_conn_t *conn;
+	ht_link_t *link;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_find_ref(%p)", epp);
 
+	/* Fast path for segments belonging to a known connection */
+	fibril_rwlock_read_lock(&conn_table_lock);
+	link = hash_table_find(&conn_table, epp);
+	if (link != NULL) {
+		conn = hash_table_get_inst(link, tcp_conn_t, lhash);
+		tcp_conn_addref(conn);
+		fibril_rwlock_read_unlock(&conn_table_lock);
+		return conn;
+	}
+	fibril_rwlock_read_unlock(&conn_table_lock);
+
 	fibril_mutex_lock(&amap_lock);
 
 	rc = amap_find_match(amap, epp, &arg);
@@ -511,6 +780,165 @@ bool tcp_conn_got_syn(tcp_conn_t *conn)
 	assert(false);
 }
 
+/** Get send window advertised by a segment.
+ *
+ * @param conn Connection
+ * @param seg  Segment other than SYN (window in SYN is never scaled)
+ * @return     Window size in bytes
+ */
+static uint32_t tcp_conn_seg_wnd(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	return seg->wnd << conn->snd_wscale;
+}
+
+/** Acknowledge received data.
+ *
+ * The ACK is delayed until a second segment arrives or the delayed ACK
+ * timer expires (RFC 5681 section 4.2). While out-of-order data is queued
+ * we ACK immediately so the sender learns quickly that a hole was filled.
+ *
+ * @param conn Connection
+ */
+static void tcp_conn_ack_data(tcp_conn_t *conn)
+{
+	++conn->rcv_unacked;
+
+	if (conn->rcv_unacked >= DELAYED_ACK_SEGS ||
+	    !list_empty(&conn->incoming.list)) {
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+		return;
+	}
+
+	if (conn->rcv_unacked == 1)
+		tcp_conn_ack_timer_set(conn);
+}
+
+/** Acknowledgement has been sent to the peer.
+ *
+ * Called when any segment carrying ACK is transmitted. Cancels
+ * pending delayed ACK.
+ *
+ * @param conn Connection
+ */
+void tcp_conn_ack_sent(tcp_conn_t *conn)
+{
+	if (conn->rcv_unacked == 0)
+		return;
+
+	conn->rcv_unacked = 0;
+	tcp_conn_ack_timer_clear(conn);
+}
+
+/** Determine whether to send a window update after the user read data.
+ *
+ * Receiver side silly window syndrome avoidance (RFC 1122 4.2.3.3):
+ * the window is only advertised once its right edge has moved by at
+ * least one segment or half of the receive buffer.
+ *
+ * @param conn Connection
+ * @return     @c true if window update should be sent
+ */
+bool tcp_conn_wnd_update_needed(tcp_conn_t *conn)
+{
+	uint32_t incr;
+
+	incr = conn->rcv_nxt + conn->rcv_wnd - conn->rcv_adv;
+	if ((incr & (0x1 << 31)) != 0)
+		return false;
+
+	return incr >= min(conn->rcv_buf_size / 2,
+	    (size_t) tcp_conn_local_mss(conn));
+}
+
+/** Receive buffer auto-tuning.
+ *
+ * Measure how much data the user reads per round trip and grow the
+ * receive buffer, and hence the advertised window, to twice that amount.
+ * A flow which the user keeps up with is thus never limited by the
+ * window (dynamic right-sizing).
+ *
+ * @param conn   Connection
+ * @param copied Number of bytes the user has just read
+ */
+void tcp_conn_rcv_buf_tune(tcp_conn_t *conn, size_t copied)
+{
+	usec_t now;
+	usec_t interval;
+	size_t size;
+	size_t size_max;
+	uint8_t *nbuf;
+
+	/* Shared rings have a fixed size */
+	if (conn->ring != NULL)
+		return;
+
+	conn->rcv_space_copied += copied;
+
+	interval = conn->rtt.valid ? conn->rtt.srtt : conn->rtt.rto;
+	interval = max(interval, RCV_SPACE_INTERVAL_MIN);
+
+	now = tcp_rtt_uptime();
+	if (now - conn->rcv_space_start < interval)
+		return;
+
+	size_max = conn->ws_ok ? RCV_BUF_MAX : RCV_WND_MAX_UNSCALED;
+	size = min(2 * conn->rcv_space_copied, size_max);
+
+	if (size > conn->rcv_buf_size) {
+		nbuf = tcp_ring_resize(conn->rcv_buf, conn->rcv_buf_size,
+		    conn->rcv_buf_start, conn->rcv_buf_used, size);
+		if (nbuf != NULL) {
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: receive buffer "
+			    "%zu -> %zu bytes", conn->name, conn->rcv_buf_size,
+			    size);
+			conn->rcv_wnd += size - conn->rcv_buf_size;
+			conn->rcv_buf = nbuf;
+			conn->rcv_buf_size = size;
+			conn->rcv_buf_start = 0;
+		}
+	}
+
+	conn->rcv_space_copied = 0;
+	conn->rcv_space_start = now;
+}
+
+/** Send buffer auto-tuning.
+ *
+ * Grow the send buffer so that it can hold twice the amount of data
+ * we are allowed to have in flight. Otherwise the sender might not
+ * have enough data queued to fill the window as it opens.
+ *
+ * @param conn Connection
+ */
+void tcp_conn_snd_buf_tune(tcp_conn_t *conn)
+{
+	size_t size;
+	uint8_t *nbuf;
+
+	/* Shared rings have a fixed size */
+	if (conn->ring != NULL)
+		return;
+
+	size = 2 * (size_t) min(conn->cc.cwnd, conn->snd_wnd);
+	size = min(size, SND_BUF_MAX);
+	if (size <= conn->snd_buf_size)
+		return;
+
+	nbuf = tcp_ring_resize(conn->snd_buf, conn->snd_buf_size,
+	    conn->snd_buf_start, conn->snd_buf_used, size);
+	if (nbuf == NULL)
+		return;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: send buffer %zu -> %zu bytes",
+	    conn->name, conn->snd_buf_size, size);
+	conn->snd_buf = nbuf;
+	conn->snd_buf_size = size;
+	conn->snd_buf_start = 0;
+
+	/* Wake up senders waiting for buffer space */
+	fibril_condvar_broadcast(&conn->snd_buf_cv);
+}
+
 /** Segment arrived in Listen state.
  *
  * @param conn		Connection
@@ -550,6 +978,9 @@ static void tcp_conn_sa_listen(tcp_conn_t *conn, tcp_segment_t *seg)
 	conn->iss = 1;
 	conn->snd_nxt = conn->iss;
 	conn->snd_una = conn->iss;
+	conn->recover = conn->iss;
+
+	tcp_conn_syn_options(conn, seg);
 
 	/*
 	 * Surprisingly the spec does not deal with initial window setting.
@@ -615,6 +1046,8 @@ static void tcp_conn_sa_syn_sent(tcp_conn_t *conn, tcp_segment_t *seg)
 	conn->rcv_nxt = seg->seq + 1;
 	conn->irs = seg->seq;
 
+	tcp_conn_syn_options(conn, seg);
+
 	if ((seg->ctrl & CTL_ACK) != 0) {
 		conn->snd_una = seg->ack;
 
@@ -662,9 +1095,19 @@ static void tcp_conn_sa_syn_sent(tcp_conn_t *conn, tcp_segment_t *seg)
 static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 {
 	tcp_segment_t *pseg;
+	bool processed;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_sa_seq(%p, %p)", conn, seg);
 
+	/* Discard old duplicates with wrapped sequence numbers (PAWS) */
+	if (seq_no_ts_paws_reject(conn, seg)) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Replying ACK to segment with "
+		    "old timestamp.");
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+		tcp_segment_delete(seg);
+		return;
+	}
+
 	/* Discard unacceptable segments ("old duplicates") */
 	if (!seq_no_segment_acceptable(conn, seg)) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "Replying ACK to unacceptable segment.");
@@ -673,6 +1116,9 @@ static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 		return;
 	}
 
+	if (seq_no_ts_recent_update(conn, seg))
+		conn->ts_recent = seg->ts_val;
+
 	/* Queue for processing */
 	tcp_iqueue_insert_seg(&conn->incoming, seg);
 
@@ -682,8 +1128,18 @@ static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 	 *
 	 * XXX Need to return ACK for unacceptable segments
 	 */
-	while (tcp_iqueue_get_ready_seg(&conn->incoming, &pseg) == EOK)
+	processed = false;
+	while (tcp_iqueue_get_ready_seg(&conn->incoming, &pseg) == EOK) {
 		tcp_conn_seg_process(conn, pseg);
+		processed = true;
+	}
+
+	/*
+	 * Segment is out of order. Send a duplicate ACK immediately
+	 * so that the sender can detect the loss (RFC 5681 4.2).
+	 */
+	if (!processed && conn->cstate != st_closed)
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
 }
 
 /** Process segment RST field.
@@ -811,6 +1267,8 @@ static cproc_t tcp_conn_seg_proc_ack_sr(tcp_conn_t *conn, tcp_segment_t *seg)
  */
 static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 {
+	bool dup_ack = false;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_seg_proc_ack_est(%p, %p)", conn, seg);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "SEG.ACK=%u, SND.UNA=%u, SND.NXT=%u",
@@ -827,15 +1285,29 @@ static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 			tcp_segment_delete(seg);
 			return cp_done;
 		} else {
-			log_msg(LOG_DEFAULT, LVL_DEBUG, "Ignoring duplicate ACK.");
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "Duplicate ACK.");
+			/* Only pure ACKs with unchanged window count (RFC 5681) */
+			dup_ack = seg->ack == conn->snd_una &&
+			    conn->snd_una != conn->snd_nxt &&
+			    tcp_segment_text_size(seg) == 0 &&
+			    (seg->ctrl & (CTL_SYN | CTL_FIN)) == 0 &&
+			    tcp_conn_seg_wnd(conn, seg) == conn->snd_wnd;
 		}
 	} else {
 		/* Update SND.UNA */
 		conn->snd_una = seg->ack;
+		if (!conn->in_recovery)
+			conn->dupacks = 0;
+
+		/* Every ACK of new data yields an RTT sample (RFC 7323 4.1) */
+		if (conn->ts_ok && seg->ts_present && seg->ts_ecr != 0) {
+			tcp_rtt_sample(&conn->rtt, (usec_t) (uint32_t)
+			    (tcp_rtt_ts_clock() - seg->ts_ecr) * 1000);
+		}
 	}
 
 	if (seq_no_new_wnd_update(conn, seg)) {
-		conn->snd_wnd = seg->wnd;
+		conn->snd_wnd = tcp_conn_seg_wnd(conn, seg);
 		conn->snd_wl1 = seg->seq;
 		conn->snd_wl2 = seg->ack;
 
@@ -844,6 +1316,14 @@ static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 		    conn->snd_wnd, conn->snd_wl1, conn->snd_wl2);
 	}
 
+	tcp_tqueue_sack_received(conn, seg);
+
+	if (dup_ack)
+		tcp_tqueue_dup_ack(conn);
+
+	/* Keep enough data buffered to fill the congestion window */
+	tcp_conn_snd_buf_tune(conn);
+
 	/*
 	 * Prune acked segments from retransmission queue and
 	 * possibly transmit more data.
@@ -1055,19 +1535,24 @@ static cproc_t tcp_conn_seg_proc_text(tcp_conn_t *conn, tcp_segment_t *seg)
 	/* Trim anything outside our receive window */
 	tcp_conn_trim_seg_to_wnd(conn, seg);
 
+	/* Pick up data the client has read from a shared ring */
+	tcp_ring_rcv_sync(conn);
+
 	/* Determine how many bytes to copy */
 	text_size = tcp_segment_text_size(seg);
 	xfer_size = min(text_size, conn->rcv_buf_size - conn->rcv_buf_used);
 
 	/* Copy data to receive buffer */
-	tcp_segment_text_copy(seg, conn->rcv_buf + conn->rcv_buf_used,
-	    xfer_size);
+	tcp_ring_write(conn->rcv_buf, conn->rcv_buf_size,
+	    (conn->rcv_buf_start + conn->rcv_buf_used) % conn->rcv_buf_size,
+	    seg->data, xfer_size);
 	conn->rcv_buf_used += xfer_size;
 
 	/* Signal to the receive function that new data has arrived */
 	if (xfer_size > 0) {
 		fibril_condvar_broadcast(&conn->rcv_buf_cv);
-		if (conn->cb != NULL && conn->cb->recv_data != NULL)
+		if (tcp_ring_rcv_publish(conn) && conn->cb != NULL &&
+		    conn->cb->recv_data != NULL)
 			conn->cb->recv_data(conn, conn->cb_arg);
 	}
 
@@ -1079,9 +1564,9 @@ static cproc_t tcp_conn_seg_proc_text(tcp_conn_t *conn, tcp_segment_t *seg)
 	/* Update receive window. XXX Not an efficient strategy. */
 	conn->rcv_wnd -= xfer_size;
 
-	/* Send ACK */
+	/* Send or schedule ACK */
 	if (xfer_size > 0)
-		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+		tcp_conn_ack_data(conn);
 
 	if (xfer_size < seg->len) {
 		/* Trim part of segment which we just received */
@@ -1162,7 +1647,8 @@ static cproc_t tcp_conn_seg_proc_fin(tcp_conn_t *conn, tcp_segment_t *seg)
 		/* Add FIN to the receive buffer */
 		conn->rcv_buf_fin = true;
 		fibril_condvar_broadcast(&conn->rcv_buf_cv);
-		if (conn->cb != NULL && conn->cb->recv_data != NULL)
+		if (tcp_ring_rcv_publish(conn) && conn->cb != NULL &&
+		    conn->cb->recv_data != NULL)
 			conn->cb->recv_data(conn, conn->cb_arg);
 
 		tcp_segment_delete(seg);
@@ -1276,6 +1762,7 @@ void tcp_conn_segment_arrived(tcp_conn_t *conn, inet_ep2_t *epp,
 		}
 
 		amap_remove(amap, &oldepp);
+		tcp_conn_table_insert(conn);
 		fibril_mutex_unlock(&amap_lock);
 
 		conn->name = (char *) "a";
@@ -1360,6 +1847,49 @@ void tcp_conn_tw_timer_clear(tcp_conn_t *conn)
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "tcp_conn_tw_timer_clear() end");
 }
 
+/** Delayed ACK timeout handler.
+ *
+ * @param arg	Connection
+ */
+static void ack_timeout_func(void *arg)
+{
+	tcp_conn_t *conn = (tcp_conn_t *) arg;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "ack_timeout_func(%p)", conn);
+
+	tcp_conn_lock(conn);
+
+	if (conn->cstate != st_closed && conn->rcv_unacked > 0) {
+		/* Prevent tcp_conn_ack_sent() from clearing this timer */
+		conn->rcv_unacked = 0;
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+	}
+
+	tcp_conn_unlock(conn);
+	tcp_conn_delref(conn);
+}
+
+/** Start the delayed ACK timer.
+ *
+ * @param conn		Connection
+ */
+static void tcp_conn_ack_timer_set(tcp_conn_t *conn)
+{
+	tcp_conn_addref(conn);
+	fibril_timer_set_locked(conn->ack_timer, DELAYED_ACK_TIMEOUT,
+	    ack_timeout_func, (void *)conn);
+}
+
+/** Clear the delayed ACK timer.
+ *
+ * @param conn		Connection
+ */
+static void tcp_conn_ack_timer_clear(tcp_conn_t *conn)
+{
+	if (fibril_timer_clear_locked(conn->ack_timer) == fts_active)
+		tcp_conn_delref(conn);
+}
+
 /** Trim segment to the receive window.
  *
  * @param conn		Connection
@@ -1410,17 +1940,14 @@ static void tcp_transmit_segment(inet_ep2_t *epp, tcp_segment_t *seg)
 	tcp_segment_dump(seg);
 
 	if (tcp_conn_lb == tcp_lb_segment) {
-		/* Loop back segment */
-#if 0
-		tcp_ncsim_bounce_seg(sp, seg);
-#endif
-
-		/* Reverse the identification */
-		tcp_ep2_flipped(epp, &rident);
-
-		/* Insert segment back into rqueue */
+		/* Loop back segment through network condition simulator */
 		dseg = tcp_segment_dup(seg);
-		tcp_rqueue_insert_seg(&rident, dseg);
+		if (dseg == NULL) {
+			log_msg(LOG_DEFAULT, LVL_WARN, "Not enough memory. Segment dropped.");
+			return;
+		}
+
+		tcp_ncsim_bounce_seg(epp, dseg);
 		return;
 	}
 
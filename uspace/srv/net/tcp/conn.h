@@ -43,6 +43,7 @@ extern errno_t tcp_conns_init(void);
 extern void tcp_conns_fini(void);
 extern tcp_conn_t *tcp_conn_new(inet_ep2_t *);
 extern void tcp_conn_delete(tcp_conn_t *);
+extern void tcp_conn_set_cb(tcp_conn_t *, tcp_cb_t *, void *);
 extern errno_t tcp_conn_add(tcp_conn_t *);
 extern void tcp_conn_reset(tcp_conn_t *conn);
 extern void tcp_conn_sync(tcp_conn_t *);
@@ -53,10 +54,16 @@ extern void tcp_conn_delref(tcp_conn_t *);
 extern void tcp_conn_lock(tcp_conn_t *);
 extern void tcp_conn_unlock(tcp_conn_t *);
 extern bool tcp_conn_got_syn(tcp_conn_t *);
+extern uint16_t tcp_conn_local_mss(tcp_conn_t *);
+extern void tcp_conn_ack_sent(tcp_conn_t *);
+extern bool tcp_conn_wnd_update_needed(tcp_conn_t *);
+extern void tcp_conn_rcv_buf_tune(tcp_conn_t *, size_t);
+extern void tcp_conn_snd_buf_tune(tcp_conn_t *);
 extern void tcp_conn_segment_arrived(tcp_conn_t *, inet_ep2_t *,
     tcp_segment_t *);
 extern void tcp_unexpected_segment(inet_ep2_t *, tcp_segment_t *);
 extern void tcp_ep2_flipped(inet_ep2_t *, inet_ep2_t *);
+extern size_t tcp_ep2_hash(const inet_ep2_t *);
 
 extern tcp_lb_t tcp_conn_lb;
 
@@ -40,7 +40,9 @@
 #include <inet/inet.h>
 #include <mem.h>
 #include <io/log.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <str_error.h>
 
 #include "inet.h"
 #include "pdu.h"
@@ -111,6 +113,7 @@ static errno_t tcp_inet_ev_recv(inet_dgram_t *dgram)
 
 	pdu->src = dgram->src;
 	pdu->dest = dgram->dest;
+	pdu->offload = dgram->offload.flags;
 
 	tcp_received_pdu(pdu);
 	tcp_pdu_delete(pdu);
@@ -143,6 +146,9 @@ void tcp_transmit_pdu(tcp_pdu_t *pdu)
 	dgram.tos = 0;
 	dgram.data = pdu_raw;
 	dgram.size = pdu_raw_size;
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
+	dgram.offload.flags = pdu->offload;
+	dgram.offload.csum_offset = offsetof(tcp_header_t, checksum);
 
 	rc = inet_send(&dgram, INET_TTL_MAX, 0);
 	if (rc != EOK)
@@ -156,11 +162,14 @@ static void tcp_received_pdu(tcp_pdu_t *pdu)
 {
 	tcp_segment_t *dseg;
 	inet_ep2_t rident;
+	errno_t rc;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_received_pdu()");
 
-	if (tcp_pdu_decode(pdu, &rident, &dseg) != EOK) {
-		log_msg(LOG_DEFAULT, LVL_WARN, "Not enough memory. PDU dropped.");
+	rc = tcp_pdu_decode(pdu, &rident, &dseg);
+	if (rc != EOK) {
+		log_msg(LOG_DEFAULT, LVL_WARN, "Failed decoding PDU (%s). "
+		    "PDU dropped.", str_error_name(rc));
 		return;
 	}
 
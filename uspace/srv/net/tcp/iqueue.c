@@ -186,6 +186,41 @@ errno_t tcp_iqueue_get_ready_seg(tcp_iqueue_t *iqueue, tcp_segment_t **seg)
 	return EOK;
 }
 
+/** Describe queued out-of-order data as SACK blocks.
+ *
+ * Adjacent and overlapping segments are merged into a single block.
+ * Blocks are produced in sequence number order.
+ *
+ * @param iqueue	Incoming queue
+ * @param blk		Array to fill in
+ * @param max		Maximum number of blocks
+ * @return		Number of blocks filled in
+ */
+size_t tcp_iqueue_sack_blocks(tcp_iqueue_t *iqueue, tcp_sack_block_t *blk,
+    size_t max)
+{
+	size_t cnt;
+
+	cnt = 0;
+
+	list_foreach(iqueue->list, link, tcp_iqueue_entry_t, iqe) {
+		if (iqe->seg->len == 0)
+			continue;
+
+		if (cnt > 0 && seq_no_sack_merge(&blk[cnt - 1], iqe->seg))
+			continue;
+
+		if (cnt == max)
+			break;
+
+		blk[cnt].start = iqe->seg->seq;
+		blk[cnt].end = iqe->seg->seq + iqe->seg->len;
+		++cnt;
+	}
+
+	return cnt;
+}
+
 /**
  * @}
  */
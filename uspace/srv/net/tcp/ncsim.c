@@ -33,9 +33,10 @@
 /**
  * @file Network condition simulator
  *
- * Simulate network conditions for testing the reliability implementation:
- *    - variable latency
- *    - frame drop
+ * Simulate network conditions for testing the reliability implementation
+ * and for benchmarking loss recovery and congestion control:
+ *    - constant and variable latency
+ *    - random segment drop
  */
 
 #include <adt/list.h>
@@ -43,8 +44,10 @@
 #include <errno.h>
 #include <inet/endpoint.h>
 #include <io/log.h>
+#include <macros.h>
 #include <stdlib.h>
 #include <fibril.h>
+#include <time.h>
 #include "conn.h"
 #include "ncsim.h"
 #include "rqueue.h"
@@ -54,6 +57,8 @@
 static list_t sim_queue;
 static fibril_mutex_t sim_queue_lock;
 static fibril_condvar_t sim_queue_cv;
+static tcp_ncsim_cfg_t sim_cfg;
+static tcp_ncsim_stats_t sim_stats;
 
 /** Initialize segment receive queue. */
 void tcp_ncsim_init(void)
@@ -61,12 +66,41 @@ void tcp_ncsim_init(void)
 	list_initialize(&sim_queue);
 	fibril_mutex_initialize(&sim_queue_lock);
 	fibril_condvar_initialize(&sim_queue_cv);
+	sim_cfg.loss_ppm = 0;
+	sim_cfg.delay = 0;
+	sim_cfg.jitter = 0;
+}
+
+/** Set simulated network conditions.
+ *
+ * Also resets statistics.
+ *
+ * @param cfg	Network conditions
+ */
+void tcp_ncsim_set_cfg(tcp_ncsim_cfg_t *cfg)
+{
+	fibril_mutex_lock(&sim_queue_lock);
+	sim_cfg = *cfg;
+	sim_stats.segs = 0;
+	sim_stats.dropped = 0;
+	fibril_mutex_unlock(&sim_queue_lock);
+}
+
+/** Get simulator statistics.
+ *
+ * @param stats	Place to store statistics
+ */
+void tcp_ncsim_get_stats(tcp_ncsim_stats_t *stats)
+{
+	fibril_mutex_lock(&sim_queue_lock);
+	*stats = sim_stats;
+	fibril_mutex_unlock(&sim_queue_lock);
 }
 
 /** Bounce segment through simulator into receive queue.
  *
  * @param epp	Endpoint pair, oriented for transmission
- * @param seg	Segment
+ * @param seg	Segment (ownership transferred)
  */
 void tcp_ncsim_bounce_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 {
@@ -74,48 +108,62 @@ void tcp_ncsim_bounce_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 	tcp_squeue_entry_t *old_qe;
 	inet_ep2_t rident;
 	link_t *link;
+	usec_t delay;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_ncsim_bounce_seg()");
-	tcp_ep2_flipped(epp, &rident);
-	tcp_rqueue_insert_seg(&rident, seg);
-	return;
 
-	if (0 /*rand() % 4 == 3*/) {
+	fibril_mutex_lock(&sim_queue_lock);
+	++sim_stats.segs;
+
+	if (sim_cfg.loss_ppm > 0 && (uint64_t) rand() * 1000000 /
+	    ((uint64_t) RAND_MAX + 1) < sim_cfg.loss_ppm) {
 		/* Drop segment */
-		log_msg(LOG_DEFAULT, LVL_ERROR, "NCSim dropping segment");
+		++sim_stats.dropped;
+		fibril_mutex_unlock(&sim_queue_lock);
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim dropping segment");
 		tcp_segment_delete(seg);
 		return;
 	}
 
+	delay = sim_cfg.delay;
+	if (sim_cfg.jitter > 0)
+		delay += (uint64_t) rand() * sim_cfg.jitter /
+		    ((uint64_t) RAND_MAX + 1);
+
+	if (delay == 0) {
+		fibril_mutex_unlock(&sim_queue_lock);
+		tcp_ep2_flipped(epp, &rident);
+		tcp_rqueue_insert_seg(&rident, seg);
+		return;
+	}
+
 	sqe = calloc(1, sizeof(tcp_squeue_entry_t));
 	if (sqe == NULL) {
+		fibril_mutex_unlock(&sim_queue_lock);
 		log_msg(LOG_DEFAULT, LVL_ERROR, "Failed allocating SQE.");
+		tcp_segment_delete(seg);
 		return;
 	}
 
-	sqe->delay = rand() % (1000 * 1000);
+	getuptime(&sqe->due);
+	ts_add_diff(&sqe->due, USEC2NSEC(delay));
 	sqe->epp = *epp;
 	sqe->seg = seg;
 
-	fibril_mutex_lock(&sim_queue_lock);
-
-	link = list_first(&sim_queue);
-	while (link != NULL && sqe->delay > 0) {
+	/* Keep queue sorted by delivery time */
+	link = list_last(&sim_queue);
+	while (link != NULL) {
 		old_qe = list_get_instance(link, tcp_squeue_entry_t, link);
-		if (sqe->delay < old_qe->delay)
+		if (ts_gteq(&sqe->due, &old_qe->due))
 			break;
 
-		sqe->delay -= old_qe->delay;
-
-		link = link->next;
-		if (link == &sim_queue.head)
-			link = NULL;
+		link = list_prev(link, &sim_queue);
 	}
 
 	if (link != NULL)
 		list_insert_after(&sqe->link, link);
 	else
-		list_append(&sqe->link, &sim_queue);
+		list_prepend(&sqe->link, &sim_queue);
 
 	fibril_condvar_broadcast(&sim_queue_cv);
 	fibril_mutex_unlock(&sim_queue_lock);
@@ -127,24 +175,31 @@ static errno_t tcp_ncsim_fibril(void *arg)
 	link_t *link;
 	tcp_squeue_entry_t *sqe;
 	inet_ep2_t rident;
-	errno_t rc;
+	struct timespec now;
+	nsec_t wait;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_ncsim_fibril()");
 
 	while (true) {
 		fibril_mutex_lock(&sim_queue_lock);
 
-		while (list_empty(&sim_queue))
-			fibril_condvar_wait(&sim_queue_cv, &sim_queue_lock);
+		while (true) {
+			while (list_empty(&sim_queue))
+				fibril_condvar_wait(&sim_queue_cv, &sim_queue_lock);
 
-		do {
 			link = list_first(&sim_queue);
 			sqe = list_get_instance(link, tcp_squeue_entry_t, link);
 
+			getuptime(&now);
+			if (ts_gteq(&now, &sqe->due))
+				break;
+
+			/* Sleep until due or until an earlier segment is queued */
 			log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim - Sleep");
-			rc = fibril_condvar_wait_timeout(&sim_queue_cv,
-			    &sim_queue_lock, sqe->delay);
-		} while (rc != ETIMEOUT);
+			wait = ts_sub_diff(&sqe->due, &now);
+			(void) fibril_condvar_wait_timeout(&sim_queue_cv,
+			    &sim_queue_lock, max(NSEC2USEC(wait), 1));
+		}
 
 		list_remove(link);
 		fibril_mutex_unlock(&sim_queue_lock);
@@ -125,7 +125,8 @@ static void tcp_header_encode_flags(tcp_control_t ctl, uint16_t doff_flags0,
 	*rdoff_flags = doff_flags;
 }
 
-static void tcp_header_setup(inet_ep2_t *epp, tcp_segment_t *seg, tcp_header_t *hdr)
+static void tcp_header_setup(inet_ep2_t *epp, tcp_segment_t *seg,
+    tcp_header_t *hdr, size_t hdr_size)
 {
 	uint16_t doff_flags;
 	uint16_t doff;
@@ -135,7 +136,7 @@ static void tcp_header_setup(inet_ep2_t *epp, tcp_segment_t *seg, tcp_header_t *
 	hdr->seq = host2uint32_t_be(seg->seq);
 	hdr->ack = host2uint32_t_be(seg->ack);
 
-	doff = (sizeof(tcp_header_t) / sizeof(uint32_t)) << DF_DATA_OFFSET_l;
+	doff = (hdr_size / sizeof(uint32_t)) << DF_DATA_OFFSET_l;
 	tcp_header_encode_flags(seg->ctrl, doff, &doff_flags);
 
 	hdr->doff_flags = host2uint16_t_be(doff_flags);
@@ -190,18 +191,206 @@ static void tcp_header_decode(tcp_header_t *hdr, tcp_segment_t *seg)
 	seg->up = uint16_t_be2host(hdr->urg_ptr);
 }
 
+/** Store 16-bit value in network byte order at unaligned address. */
+static void tcp_opt_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v & 0xff;
+}
+
+/** Store 32-bit value in network byte order at unaligned address. */
+static void tcp_opt_put32(uint8_t *p, uint32_t v)
+{
+	tcp_opt_put16(p, v >> 16);
+	tcp_opt_put16(p + 2, v & 0xffff);
+}
+
+/** Load 16-bit value in network byte order from unaligned address. */
+static uint16_t tcp_opt_get16(uint8_t *p)
+{
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+/** Load 32-bit value in network byte order from unaligned address. */
+static uint32_t tcp_opt_get32(uint8_t *p)
+{
+	return ((uint32_t)tcp_opt_get16(p) << 16) | tcp_opt_get16(p + 2);
+}
+
+/** Compute size of encoded options of a segment.
+ *
+ * Every option is padded with NOPs to a multiple of four bytes.
+ */
+static size_t tcp_options_size(tcp_segment_t *seg)
+{
+	size_t size;
+
+	size = 0;
+	if (seg->mss != 0)
+		size += OPT_MAX_SEG_SIZE_LEN;
+	if (seg->wscale_present)
+		size += 1 + OPT_WND_SCALE_LEN;
+	if (seg->ts_present)
+		size += 2 + OPT_TIMESTAMPS_LEN;
+	if (seg->sack_perm)
+		size += 2 + OPT_SACK_PERMITTED_LEN;
+	if (seg->sack_cnt > 0) {
+		size += 2 + OPT_SACK_HDR_LEN +
+		    seg->sack_cnt * OPT_SACK_BLOCK_LEN;
+	}
+
+	return size;
+}
+
+/** Encode segment options.
+ *
+ * @param seg Segment
+ * @param opt Buffer of tcp_options_size() bytes
+ */
+static void tcp_options_encode(tcp_segment_t *seg, uint8_t *opt)
+{
+	unsigned i;
+
+	if (seg->mss != 0) {
+		opt[0] = OPT_MAX_SEG_SIZE;
+		opt[1] = OPT_MAX_SEG_SIZE_LEN;
+		tcp_opt_put16(opt + 2, seg->mss);
+		opt += OPT_MAX_SEG_SIZE_LEN;
+	}
+
+	if (seg->wscale_present) {
+		opt[0] = OPT_NOP;
+		opt[1] = OPT_WND_SCALE;
+		opt[2] = OPT_WND_SCALE_LEN;
+		opt[3] = seg->wscale;
+		opt += 1 + OPT_WND_SCALE_LEN;
+	}
+
+	if (seg->ts_present) {
+		opt[0] = OPT_NOP;
+		opt[1] = OPT_NOP;
+		opt[2] = OPT_TIMESTAMPS;
+		opt[3] = OPT_TIMESTAMPS_LEN;
+		tcp_opt_put32(opt + 4, seg->ts_val);
+		tcp_opt_put32(opt + 8, seg->ts_ecr);
+		opt += 2 + OPT_TIMESTAMPS_LEN;
+	}
+
+	if (seg->sack_perm) {
+		opt[0] = OPT_NOP;
+		opt[1] = OPT_NOP;
+		opt[2] = OPT_SACK_PERMITTED;
+		opt[3] = OPT_SACK_PERMITTED_LEN;
+		opt += 2 + OPT_SACK_PERMITTED_LEN;
+	}
+
+	if (seg->sack_cnt > 0) {
+		opt[0] = OPT_NOP;
+		opt[1] = OPT_NOP;
+		opt[2] = OPT_SACK;
+		opt[3] = OPT_SACK_HDR_LEN + seg->sack_cnt * OPT_SACK_BLOCK_LEN;
+		opt += 2 + OPT_SACK_HDR_LEN;
+
+		for (i = 0; i < seg->sack_cnt; i++) {
+			tcp_opt_put32(opt, seg->sack[i].start);
+			tcp_opt_put32(opt + 4, seg->sack[i].end);
+			opt += OPT_SACK_BLOCK_LEN;
+		}
+	}
+}
+
+/** Decode segment options.
+ *
+ * Unknown options are skipped, parsing stops at a malformed option.
+ *
+ * @param opt  Options
+ * @param size Size of options in bytes
+ * @param seg  Segment to fill in
+ */
+static void tcp_options_decode(uint8_t *opt, size_t size, tcp_segment_t *seg)
+{
+	size_t i;
+	size_t olen;
+	unsigned n;
+
+	i = 0;
+	while (i < size) {
+		if (opt[i] == OPT_END_LIST)
+			break;
+
+		if (opt[i] == OPT_NOP) {
+			++i;
+			continue;
+		}
+
+		if (i + 1 >= size)
+			break;
+
+		olen = opt[i + 1];
+		if (olen < 2 || i + olen > size)
+			break;
+
+		switch (opt[i]) {
+		case OPT_MAX_SEG_SIZE:
+			if (olen == OPT_MAX_SEG_SIZE_LEN)
+				seg->mss = tcp_opt_get16(opt + i + 2);
+			break;
+		case OPT_WND_SCALE:
+			if (olen == OPT_WND_SCALE_LEN) {
+				seg->wscale_present = true;
+				seg->wscale = opt[i + 2];
+			}
+			break;
+		case OPT_TIMESTAMPS:
+			if (olen == OPT_TIMESTAMPS_LEN) {
+				seg->ts_present = true;
+				seg->ts_val = tcp_opt_get32(opt + i + 2);
+				seg->ts_ecr = tcp_opt_get32(opt + i + 6);
+			}
+			break;
+		case OPT_SACK_PERMITTED:
+			if (olen == OPT_SACK_PERMITTED_LEN)
+				seg->sack_perm = true;
+			break;
+		case OPT_SACK:
+			n = (olen - OPT_SACK_HDR_LEN) / OPT_SACK_BLOCK_LEN;
+			seg->sack_cnt = 0;
+			while (n > 0 && seg->sack_cnt < TCP_SACK_BLOCKS_MAX) {
+				seg->sack[seg->sack_cnt].start = tcp_opt_get32(opt +
+				    i + OPT_SACK_HDR_LEN +
+				    seg->sack_cnt * OPT_SACK_BLOCK_LEN);
+				seg->sack[seg->sack_cnt].end = tcp_opt_get32(opt +
+				    i + OPT_SACK_HDR_LEN +
+				    seg->sack_cnt * OPT_SACK_BLOCK_LEN + 4);
+				++seg->sack_cnt;
+				--n;
+			}
+			break;
+		default:
+			break;
+		}
+
+		i += olen;
+	}
+}
+
 static errno_t tcp_header_encode(inet_ep2_t *epp, tcp_segment_t *seg,
     void **header, size_t *size)
 {
 	tcp_header_t *hdr;
+	size_t hdr_size;
+
+	hdr_size = sizeof(tcp_header_t) + tcp_options_size(seg);
+	assert(hdr_size <= TCP_HEADER_MAX_SIZE);
 
-	hdr = calloc(1, sizeof(tcp_header_t));
+	hdr = calloc(1, hdr_size);
 	if (hdr == NULL)
 		return ENOMEM;
 
-	tcp_header_setup(epp, seg, hdr);
+	tcp_header_setup(epp, seg, hdr, hdr_size);
+	tcp_options_encode(seg, (uint8_t *)(hdr + 1));
 	*header = hdr;
-	*size = sizeof(tcp_header_t);
+	*size = hdr_size;
 
 	return EOK;
 }
@@ -260,10 +449,10 @@ void tcp_pdu_delete(tcp_pdu_t *pdu)
 	free(pdu);
 }
 
-static uint16_t tcp_pdu_checksum_calc(tcp_pdu_t *pdu)
+/** Compute checksum of the pseudo-header of a PDU. */
+static uint16_t tcp_pdu_phdr_checksum_calc(tcp_pdu_t *pdu)
 {
 	uint16_t cs_phdr;
-	uint16_t cs_headers;
 	tcp_phdr_t phdr;
 	tcp_phdr6_t phdr6;
 
@@ -281,6 +470,15 @@ static uint16_t tcp_pdu_checksum_calc(tcp_pdu_t *pdu)
 		assert(false);
 	}
 
+	return cs_phdr;
+}
+
+static uint16_t tcp_pdu_checksum_calc(tcp_pdu_t *pdu)
+{
+	uint16_t cs_phdr;
+	uint16_t cs_headers;
+
+	cs_phdr = tcp_pdu_phdr_checksum_calc(pdu);
 	cs_headers = tcp_checksum_calc(cs_phdr, pdu->header, pdu->header_size);
 	return tcp_checksum_calc(cs_headers, pdu->text, pdu->text_size);
 }
@@ -293,12 +491,23 @@ static void tcp_pdu_set_checksum(tcp_pdu_t *pdu, uint16_t checksum)
 	hdr->checksum = host2uint16_t_be(checksum);
 }
 
-/** Decode incoming PDU */
+/** Decode incoming PDU
+ *
+ * The checksum is verified unless the link already did so or
+ * the PDU was produced locally with checksum offload.
+ *
+ * @return EOK on success, EINVAL on bad checksum, ENOMEM if out of memory
+ */
 errno_t tcp_pdu_decode(tcp_pdu_t *pdu, inet_ep2_t *epp, tcp_segment_t **seg)
 {
 	tcp_segment_t *nseg;
 	tcp_header_t *hdr;
 
+	if ((pdu->offload & (INET_OFFLOAD_CSUM |
+	    INET_OFFLOAD_CSUM_VALID)) == 0 &&
+	    tcp_pdu_checksum_calc(pdu) != 0)
+		return EINVAL;
+
 	nseg = tcp_segment_make_data(0, pdu->text, pdu->text_size);
 	if (nseg == NULL)
 		return ENOMEM;
@@ -306,6 +515,12 @@ errno_t tcp_pdu_decode(tcp_pdu_t *pdu, inet_ep2_t *epp, tcp_segment_t **seg)
 	tcp_header_decode(pdu->header, nseg);
 	nseg->len += seq_no_control_len(nseg->ctrl);
 
+	if (pdu->header_size > sizeof(tcp_header_t)) {
+		tcp_options_decode((uint8_t *)pdu->header +
+		    sizeof(tcp_header_t), pdu->header_size -
+		    sizeof(tcp_header_t), nseg);
+	}
+
 	hdr = (tcp_header_t *)pdu->header;
 
 	epp->local.port = uint16_t_be2host(hdr->dest_port);
@@ -317,12 +532,15 @@ errno_t tcp_pdu_decode(tcp_pdu_t *pdu, inet_ep2_t *epp, tcp_segment_t **seg)
 	return EOK;
 }
 
-/** Encode outgoing PDU */
+/** Encode outgoing PDU
+ *
+ * Only the pseudo-header sum is stored in the checksum field, completing
+ * the checksum is left to the NIC or the IP layer (INET_OFFLOAD_CSUM).
+ */
 errno_t tcp_pdu_encode(inet_ep2_t *epp, tcp_segment_t *seg, tcp_pdu_t **pdu)
 {
 	tcp_pdu_t *npdu;
 	size_t text_size;
-	uint16_t checksum;
 	errno_t rc;
 
 	npdu = tcp_pdu_new();
@@ -348,9 +566,10 @@ errno_t tcp_pdu_encode(inet_ep2_t *epp, tcp_segment_t *seg, tcp_pdu_t **pdu)
 	npdu->text_size = text_size;
 	memcpy(npdu->text, seg->data, text_size);
 
-	/* Checksum calculation */
-	checksum = tcp_pdu_checksum_calc(npdu);
-	tcp_pdu_set_checksum(npdu, checksum);
+	/* Partial checksum, to be completed over header and text */
+	tcp_pdu_set_checksum(npdu,
+	    (uint16_t) ~tcp_pdu_phdr_checksum_calc(npdu));
+	npdu->offload = INET_OFFLOAD_CSUM | INET_OFFLOAD_TSO;
 
 	*pdu = npdu;
 	return EOK;
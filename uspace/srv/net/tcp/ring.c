@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+
+/**
+ * @file Circular data buffers and rings shared with the client
+ *
+ * Connection send and receive buffers are circular. Normally they are
+ * private to the server and the client copies data in and out through
+ * IPC messages. A client can instead share a memory area with us
+ * (see tcp_ring_area_t) and the buffers are then placed in that area.
+ * The client produces data directly into the send buffer and consumes
+ * data directly from the receive buffer, and the two sides only exchange
+ * the producer and consumer counters.
+ */
+
+#include <as.h>
+#include <assert.h>
+#include <errno.h>
+#include <io/log.h>
+#include <macros.h>
+#include <mem.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "ring.h"
+#include "tcp_type.h"
+
+/** Write data to a circular buffer.
+ *
+ * @param buf  Buffer
+ * @param size Buffer size
+ * @param pos  Offset in buffer where to start writing
+ * @param data Data
+ * @param n    Number of bytes to write
+ */
+void tcp_ring_write(uint8_t *buf, size_t size, size_t pos, const void *data,
+    size_t n)
+{
+	size_t n1;
+
+	assert(pos < size);
+	assert(n <= size);
+
+	n1 = min(n, size - pos);
+	memcpy(buf + pos, data, n1);
+	memcpy(buf, (const uint8_t *)data + n1, n - n1);
+}
+
+/** Read data from a circular buffer.
+ *
+ * @param buf  Buffer
+ * @param size Buffer size
+ * @param pos  Offset in buffer where to start reading
+ * @param data Destination
+ * @param n    Number of bytes to read
+ */
+void tcp_ring_read(const uint8_t *buf, size_t size, size_t pos, void *data,
+    size_t n)
+{
+	size_t n1;
+
+	assert(pos < size);
+	assert(n <= size);
+
+	n1 = min(n, size - pos);
+	memcpy(data, buf + pos, n1);
+	memcpy((uint8_t *)data + n1, buf, n - n1);
+}
+
+/** Grow a private circular buffer.
+ *
+ * The used part of the buffer starts at offset zero in the new buffer.
+ *
+ * @param buf   Buffer
+ * @param size  Buffer size
+ * @param start Offset of the first used byte
+ * @param used  Number of bytes used
+ * @param nsize New buffer size
+ *
+ * @return New buffer or @c NULL if out of memory (@a buf is kept)
+ */
+uint8_t *tcp_ring_resize(uint8_t *buf, size_t size, size_t start, size_t used,
+    size_t nsize)
+{
+	uint8_t *nbuf;
+
+	assert(nsize >= used);
+
+	nbuf = malloc(nsize);
+	if (nbuf == NULL)
+		return NULL;
+
+	tcp_ring_read(buf, size, start, nbuf, used);
+	free(buf);
+	return nbuf;
+}
+
+/** Move connection buffers to an area shared with the client.
+ *
+ * Any data already in the private buffers is moved to the shared rings.
+ * The receive window can only grow, so the rings must not be smaller than
+ * the current receive buffer.
+ *
+ * @param conn  Connection
+ * @param ring  Shared area of at least TCP_RING_AREA_SIZE(@a rsize) bytes
+ * @param rsize Size of each ring, a power of two
+ *
+ * @return EOK on success, EINVAL if @a rsize is not valid, EBUSY if
+ *         the connection already uses shared rings or has more data
+ *         buffered than fits in them
+ */
+errno_t tcp_ring_attach(tcp_conn_t *conn, tcp_ring_area_t *ring, size_t rsize)
+{
+	uint8_t *snd_buf;
+	uint8_t *rcv_buf;
+
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	if (rsize < TCP_RING_SIZE_MIN || rsize > TCP_RING_SIZE_MAX ||
+	    (rsize & (rsize - 1)) != 0)
+		return EINVAL;
+
+	if (conn->ring != NULL || conn->rcv_buf_size > rsize ||
+	    conn->snd_buf_used > rsize)
+		return EBUSY;
+
+	snd_buf = (uint8_t *)ring + TCP_RING_DATA_OFF;
+	rcv_buf = snd_buf + rsize;
+
+	tcp_ring_read(conn->snd_buf, conn->snd_buf_size, conn->snd_buf_start,
+	    snd_buf, conn->snd_buf_used);
+	tcp_ring_read(conn->rcv_buf, conn->rcv_buf_size, conn->rcv_buf_start,
+	    rcv_buf, conn->rcv_buf_used);
+	free(conn->snd_buf);
+	free(conn->rcv_buf);
+
+	conn->snd_buf = snd_buf;
+	conn->snd_buf_size = rsize;
+	conn->snd_buf_start = 0;
+	conn->rcv_buf = rcv_buf;
+	conn->rcv_wnd += rsize - conn->rcv_buf_size;
+	conn->rcv_buf_size = rsize;
+	conn->rcv_buf_start = 0;
+
+	conn->ring = ring;
+	conn->ring_snd_prod = conn->snd_buf_used;
+	conn->ring_rcv_cons = 0;
+
+	atomic_store(&ring->snd.prod, conn->snd_buf_used);
+	atomic_store(&ring->snd.cons, 0);
+	atomic_store(&ring->snd.want_data, 1);
+	atomic_store(&ring->snd.want_space, 0);
+	atomic_store(&ring->snd.fin, 0);
+
+	atomic_store(&ring->rcv.prod, conn->rcv_buf_used);
+	atomic_store(&ring->rcv.cons, 0);
+	/*
+	 * The client may only read when notified via the data_avail
+	 * callback, so the first data must be announced.
+	 */
+	atomic_store(&ring->rcv.want_data, 1);
+	atomic_store(&ring->rcv.want_space, 0);
+	atomic_store(&ring->rcv.fin, conn->rcv_buf_fin ? 1 : 0);
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: using shared rings of %zu bytes",
+	    conn->name, rsize);
+	return EOK;
+}
+
+/** Release the area shared with the client.
+ *
+ * @param conn Connection
+ */
+void tcp_ring_fini(tcp_conn_t *conn)
+{
+	if (conn->ring == NULL)
+		return;
+
+	as_area_destroy(conn->ring);
+	conn->ring = NULL;
+	conn->snd_buf = NULL;
+	conn->rcv_buf = NULL;
+}
+
+/** Account for data the client has consumed from the receive ring.
+ *
+ * @param conn Connection
+ */
+void tcp_ring_rcv_sync(tcp_conn_t *conn)
+{
+	uint32_t cons;
+	uint32_t n;
+
+	if (conn->ring == NULL)
+		return;
+
+	cons = atomic_load_explicit(&conn->ring->rcv.cons,
+	    memory_order_acquire);
+	n = cons - conn->ring_rcv_cons;
+	if (n == 0 || n > conn->rcv_buf_used)
+		return;
+
+	conn->ring_rcv_cons = cons;
+	conn->rcv_buf_start = (conn->rcv_buf_start + n) % conn->rcv_buf_size;
+	conn->rcv_buf_used -= n;
+	conn->rcv_wnd += n;
+}
+
+/** Make data and FIN in the receive buffer visible to the client.
+ *
+ * If the receive ring is getting full, the client is asked to ring the
+ * doorbell as it consumes data so that we can open the window.
+ *
+ * @param conn Connection
+ * @return @c true if the client should be notified (the client waits for
+ *         data or the buffer is not shared)
+ */
+bool tcp_ring_rcv_publish(tcp_conn_t *conn)
+{
+	tcp_ring_ctl_t *ctl;
+
+	if (conn->ring == NULL)
+		return true;
+
+	ctl = &conn->ring->rcv;
+	atomic_store_explicit(&ctl->prod, conn->ring_rcv_cons +
+	    conn->rcv_buf_used, memory_order_release);
+	if (conn->rcv_buf_fin)
+		atomic_store_explicit(&ctl->fin, 1, memory_order_release);
+
+	if (conn->rcv_buf_used >= conn->rcv_buf_size / 2) {
+		atomic_store(&ctl->want_space, 1);
+		tcp_ring_rcv_sync(conn);
+	}
+
+	return atomic_exchange(&ctl->want_data, 0) != 0;
+}
+
+/** Account for data the client has produced into the send ring.
+ *
+ * @param conn Connection
+ */
+void tcp_ring_snd_sync(tcp_conn_t *conn)
+{
+	uint32_t prod;
+	uint32_t n;
+
+	if (conn->ring == NULL || conn->snd_buf_fin)
+		return;
+
+	prod = atomic_load_explicit(&conn->ring->snd.prod,
+	    memory_order_acquire);
+	n = prod - conn->ring_snd_prod;
+	if (n == 0 || n > conn->snd_buf_size - conn->snd_buf_used)
+		return;
+
+	conn->ring_snd_prod = prod;
+	conn->snd_buf_used += n;
+}
+
+/** Return space in the send ring to the client.
+ *
+ * Notifies the client if it waits for free space.
+ *
+ * @param conn Connection
+ */
+void tcp_ring_snd_publish(tcp_conn_t *conn)
+{
+	tcp_ring_ctl_t *ctl;
+
+	if (conn->ring == NULL)
+		return;
+
+	ctl = &conn->ring->snd;
+	atomic_store_explicit(&ctl->cons, conn->ring_snd_prod -
+	    conn->snd_buf_used, memory_order_release);
+
+	if (atomic_exchange(&ctl->want_space, 0) != 0 && conn->cb != NULL &&
+	    conn->cb->send_space != NULL)
+		conn->cb->send_space(conn, conn->cb_arg);
+}
+
+/** Ask the client to ring the doorbell when it produces more data.
+ *
+ * Called when the send buffer is empty.
+ *
+ * @param conn Connection
+ * @return @c true if the client has produced more data meanwhile
+ */
+bool tcp_ring_snd_arm(tcp_conn_t *conn)
+{
+	if (conn->ring == NULL || conn->snd_buf_fin)
+		return false;
+
+	atomic_store(&conn->ring->snd.want_data, 1);
+	tcp_ring_snd_sync(conn);
+	return conn->snd_buf_used > 0;
+}
+
+/** @}
+ */
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+/** @file Circular data buffers and rings shared with the client
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "tcp_type.h"
+
+extern void tcp_ring_write(uint8_t *, size_t, size_t, const void *, size_t);
+extern void tcp_ring_read(const uint8_t *, size_t, size_t, void *, size_t);
+extern uint8_t *tcp_ring_resize(uint8_t *, size_t, size_t, size_t, size_t);
+
+extern errno_t tcp_ring_attach(tcp_conn_t *, tcp_ring_area_t *, size_t);
+extern void tcp_ring_fini(tcp_conn_t *);
+extern void tcp_ring_rcv_sync(tcp_conn_t *);
+extern bool tcp_ring_rcv_publish(tcp_conn_t *);
+extern void tcp_ring_snd_sync(tcp_conn_t *);
+extern void tcp_ring_snd_publish(tcp_conn_t *);
+extern bool tcp_ring_snd_arm(tcp_conn_t *);
+
+#endif
+
+/** @}
+ */
@@ -32,6 +32,9 @@
 
 /**
  * @file Global segment receive queue
+ *
+ * The queue is split into shards by connection, each processed by
+ * a separate fibril.
  */
 
 #include <adt/prodcons.h>
@@ -47,8 +50,18 @@
 #include "tcp_type.h"
 #include "ucall.h"
 
-static prodcons_t rqueue;
-static bool fibril_active;
+/** Number of receive queue shards, each processed by its own fibril */
+#define RQUEUE_SHARDS 4
+
+/** Receive queue shard */
+typedef struct {
+	/** Queue of tcp_rqueue_entry_t */
+	prodcons_t queue;
+	/** Handler fibril is running */
+	bool fibril_active;
+} tcp_rqueue_shard_t;
+
+static tcp_rqueue_shard_t rqueue[RQUEUE_SHARDS];
 static fibril_mutex_t lock;
 static fibril_condvar_t cv;
 static tcp_rqueue_cb_t *rqueue_cb;
@@ -56,63 +69,98 @@ static tcp_rqueue_cb_t *rqueue_cb;
 /** Initialize segment receive queue. */
 void tcp_rqueue_init(tcp_rqueue_cb_t *rcb)
 {
-	prodcons_initialize(&rqueue);
+	unsigned i;
+
+	for (i = 0; i < RQUEUE_SHARDS; i++) {
+		prodcons_initialize(&rqueue[i].queue);
+		rqueue[i].fibril_active = false;
+	}
+
 	fibril_mutex_initialize(&lock);
 	fibril_condvar_initialize(&cv);
-	fibril_active = false;
 	rqueue_cb = rcb;
 }
 
+/** Insert entry into receive queue shard.
+ *
+ * @param shard Shard
+ * @param epp   Endpoint pair, oriented for reception
+ * @param seg   Segment (ownership transferred to rqueue) or @c NULL
+ *              to terminate the shard's handler fibril
+ */
+static void tcp_rqueue_shard_insert(tcp_rqueue_shard_t *shard,
+    inet_ep2_t *epp, tcp_segment_t *seg)
+{
+	tcp_rqueue_entry_t *rqe;
+
+	rqe = calloc(1, sizeof(tcp_rqueue_entry_t));
+	if (rqe == NULL) {
+		log_msg(LOG_DEFAULT, LVL_ERROR, "Failed allocating RQE.");
+		return;
+	}
+
+	rqe->epp = *epp;
+	rqe->seg = seg;
+
+	prodcons_produce(&shard->queue, &rqe->link);
+}
+
 /** Finalize segment receive queue. */
 void tcp_rqueue_fini(void)
 {
 	inet_ep2_t epp;
+	unsigned i;
+	bool active;
 
 	inet_ep2_init(&epp);
-	tcp_rqueue_insert_seg(&epp, NULL);
+	for (i = 0; i < RQUEUE_SHARDS; i++)
+		tcp_rqueue_shard_insert(&rqueue[i], &epp, NULL);
 
 	fibril_mutex_lock(&lock);
-	while (fibril_active)
-		fibril_condvar_wait(&cv, &lock);
+	do {
+		active = false;
+		for (i = 0; i < RQUEUE_SHARDS; i++)
+			active = active || rqueue[i].fibril_active;
+		if (active)
+			fibril_condvar_wait(&cv, &lock);
+	} while (active);
 	fibril_mutex_unlock(&lock);
 }
 
 /** Insert segment into receive queue.
+ *
+ * Segments are distributed among shards by endpoint pair so that
+ * segments of one connection are always processed in order by the same
+ * fibril while different connections can be processed in parallel.
  *
  * @param epp	Endpoint pair, oriented for reception
  * @param seg	Segment (ownership transferred to rqueue)
  */
 void tcp_rqueue_insert_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 {
-	tcp_rqueue_entry_t *rqe;
-
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "tcp_rqueue_insert_seg()");
 
 	if (seg != NULL)
 		tcp_segment_dump(seg);
 
-	rqe = calloc(1, sizeof(tcp_rqueue_entry_t));
-	if (rqe == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Failed allocating RQE.");
-		return;
-	}
-
-	rqe->epp = *epp;
-	rqe->seg = seg;
-
-	prodcons_produce(&rqueue, &rqe->link);
+	tcp_rqueue_shard_insert(&rqueue[tcp_ep2_hash(epp) % RQUEUE_SHARDS],
+	    epp, seg);
 }
 
-/** Receive queue handler fibril. */
+/** Receive queue handler fibril.
+ *
+ * @param arg Receive queue shard
+ */
 static errno_t tcp_rqueue_fibril(void *arg)
 {
+	tcp_rqueue_shard_t *shard = (tcp_rqueue_shard_t *) arg;
 	link_t *link;
 	tcp_rqueue_entry_t *rqe;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_rqueue_fibril()");
 
 	while (true) {
-		link = prodcons_consume(&rqueue);
+		link = prodcons_consume(&shard->queue);
 		rqe = list_get_instance(link, tcp_rqueue_entry_t, link);
 
 		if (rqe->seg == NULL) {
@@ -128,28 +176,32 @@ static errno_t tcp_rqueue_fibril(void *arg)
 
 	/* Finished */
 	fibril_mutex_lock(&lock);
-	fibril_active = false;
+	shard->fibril_active = false;
 	fibril_mutex_unlock(&lock);
 	fibril_condvar_broadcast(&cv);
 
 	return 0;
 }
 
-/** Start receive queue handler fibril. */
+/** Start receive queue handler fibrils. */
 void tcp_rqueue_fibril_start(void)
 {
 	fid_t fid;
+	unsigned i;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_rqueue_fibril_start()");
 
-	fid = fibril_create(tcp_rqueue_fibril, NULL);
-	if (fid == 0) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Failed creating rqueue fibril.");
-		return;
-	}
+	for (i = 0; i < RQUEUE_SHARDS; i++) {
+		fid = fibril_create(tcp_rqueue_fibril, &rqueue[i]);
+		if (fid == 0) {
+			log_msg(LOG_DEFAULT, LVL_ERROR, "Failed creating "
+			    "rqueue fibril.");
+			return;
+		}
 
-	fibril_add_ready(fid);
-	fibril_active = true;
+		rqueue[i].fibril_active = true;
+		fibril_add_ready(fid);
+	}
 }
 
 /**
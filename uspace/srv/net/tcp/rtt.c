@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+
+/**
+ * @file Round-trip time estimation
+ *
+ * Smoothed RTT and RTT variation estimator and retransmission timeout
+ * computation as specified by RFC 6298. Karn's rule (no samples from
+ * retransmitted segments) is enforced by the caller.
+ */
+
+#include <macros.h>
+#include <stdint.h>
+#include <time.h>
+#include "rtt.h"
+#include "tcp_type.h"
+
+/** Initial retransmission timeout */
+#define TCP_RTO_INIT	(1000 * 1000)
+/** Lower bound on the retransmission timeout */
+#define TCP_RTO_MIN	(1000 * 1000)
+/** Upper bound on the retransmission timeout */
+#define TCP_RTO_MAX	(60 * 1000 * 1000)
+/** Clock granularity */
+#define TCP_RTT_G	1000
+
+/** Get current time for RTT measurement and congestion control.
+ *
+ * @return Time since boot in microseconds
+ */
+usec_t tcp_rtt_uptime(void)
+{
+	struct timespec ts;
+
+	getuptime(&ts);
+	return SEC2USEC(ts.tv_sec) + NSEC2USEC(ts.tv_nsec);
+}
+
+/** Get timestamp clock value (RFC 7323 section 5.4).
+ *
+ * The clock ticks once per millisecond and wraps around.
+ *
+ * @return Timestamp clock value
+ */
+uint32_t tcp_rtt_ts_clock(void)
+{
+	return (uint32_t) (tcp_rtt_uptime() / 1000);
+}
+
+/** Compute retransmission timeout from the current estimates. */
+static void tcp_rtt_rto_update(tcp_rtt_t *rtt)
+{
+	usec_t rto;
+
+	rto = rtt->srtt + max(TCP_RTT_G, 4 * rtt->rttvar);
+	rtt->rto = min(max(rto, TCP_RTO_MIN), TCP_RTO_MAX);
+}
+
+/** Initialize RTT estimator.
+ *
+ * @param rtt RTT estimator
+ */
+void tcp_rtt_init(tcp_rtt_t *rtt)
+{
+	rtt->valid = false;
+	rtt->srtt = 0;
+	rtt->rttvar = 0;
+	rtt->rto = TCP_RTO_INIT;
+}
+
+/** Feed an RTT measurement to the estimator.
+ *
+ * @param rtt RTT estimator
+ * @param r   Measured round-trip time
+ */
+void tcp_rtt_sample(tcp_rtt_t *rtt, usec_t r)
+{
+	usec_t delta;
+
+	if (!rtt->valid) {
+		/* First measurement */
+		rtt->srtt = r;
+		rtt->rttvar = r / 2;
+		rtt->valid = true;
+	} else {
+		/* RTTVAR := 3/4 RTTVAR + 1/4 |SRTT - R'| */
+		delta = rtt->srtt > r ? rtt->srtt - r : r - rtt->srtt;
+		rtt->rttvar = (3 * rtt->rttvar + delta) / 4;
+		/* SRTT := 7/8 SRTT + 1/8 R' */
+		rtt->srtt = (7 * rtt->srtt + r) / 8;
+	}
+
+	tcp_rtt_rto_update(rtt);
+}
+
+/** Back off retransmission timer after it expired.
+ *
+ * @param rtt RTT estimator
+ */
+void tcp_rtt_backoff(tcp_rtt_t *rtt)
+{
+	rtt->rto = min(2 * rtt->rto, TCP_RTO_MAX);
+}
+
+/**
+ * @}
+ */
@@ -74,6 +74,15 @@ tcp_segment_t *tcp_segment_dup(tcp_segment_t *seg)
 	scopy->len = seg->len;
 	scopy->wnd = seg->wnd;
 	scopy->up = seg->up;
+	scopy->mss = seg->mss;
+	scopy->sack_perm = seg->sack_perm;
+	scopy->sack_cnt = seg->sack_cnt;
+	memcpy(scopy->sack, seg->sack, sizeof(seg->sack));
+	scopy->wscale_present = seg->wscale_present;
+	scopy->wscale = seg->wscale;
+	scopy->ts_present = seg->ts_present;
+	scopy->ts_val = seg->ts_val;
+	scopy->ts_ecr = seg->ts_ecr;
 
 	tsize = tcp_segment_text_size(seg);
 	scopy->data = calloc(tsize, 1);
@@ -131,8 +140,11 @@ tcp_segment_t *tcp_segment_make_rst(tcp_segment_t *seg)
 	return rseg;
 }
 
-/** Create a control segment.
+/** Create a data segment.
  *
+ * @param ctrl	Control flags
+ * @param data	Segment text or @c NULL to leave it for the caller to fill in
+ * @param size	Text size
  * @return	Segment
  */
 tcp_segment_t *tcp_segment_make_data(tcp_control_t ctrl, void *data,
@@ -153,7 +165,8 @@ tcp_segment_t *tcp_segment_make_data(tcp_control_t ctrl, void *data,
 		return NULL;
 	}
 
-	memcpy(seg->data, data, size);
+	if (data != NULL)
+		memcpy(seg->data, data, size);
 
 	return seg;
 }
@@ -254,6 +267,18 @@ void tcp_segment_dump(tcp_segment_t *seg)
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - len = %" PRIu32, seg->len);
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - wnd = %" PRIu32, seg->wnd);
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - up = %" PRIu32, seg->up);
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - mss = %u", (unsigned)seg->mss);
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - sack_perm = %d", (int)seg->sack_perm);
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - sack_cnt = %u",
+	    (unsigned)seg->sack_cnt);
+	if (seg->wscale_present) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG2, " - wscale = %u",
+		    (unsigned)seg->wscale);
+	}
+	if (seg->ts_present) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG2, " - ts_val = %" PRIu32
+		    ", ts_ecr = %" PRIu32, seg->ts_val, seg->ts_ecr);
+	}
 }
 
 /**
@@ -147,6 +147,98 @@ bool seq_no_segment_acked(tcp_conn_t *conn, tcp_segment_t *seg, uint32_t ack)
 	return seq_no_lt_le(seg->seq, seg->seq + seg->len, ack);
 }
 
+/** Determine whether sequence number has been acknowledged.
+ *
+ * Uses the same best-effort comparison as seq_no_ack_duplicate().
+ *
+ * @param conn Connection
+ * @param sn   Sequence number
+ *
+ * @return @c true if SN <= SND.UNA, @c false otherwise
+ */
+bool seq_no_acked(tcp_conn_t *conn, uint32_t sn)
+{
+	uint32_t diff;
+
+	diff = sn - conn->snd_una;
+	return diff == 0 || (diff & (0x1 << 31)) != 0;
+}
+
+/** Determine whether segment is fully covered by a SACK block.
+ *
+ * @param seg  Segment
+ * @param blk  SACK block
+ *
+ * @return @c true if segment is covered by the block, @c false otherwise
+ */
+bool seq_no_segment_sacked(tcp_segment_t *seg, tcp_sack_block_t *blk)
+{
+	assert(seg->len > 0);
+	return seq_no_le_lt(blk->start, seg->seq, blk->end) &&
+	    seq_no_lt_le(seg->seq, seg->seq + seg->len, blk->end);
+}
+
+/** Try merging segment into SACK block.
+ *
+ * The segment can be merged if it starts within or right after the block.
+ *
+ * @param blk  SACK block, right edge is extended if needed
+ * @param seg  Segment
+ *
+ * @return @c true if segment was merged, @c false otherwise
+ */
+bool seq_no_sack_merge(tcp_sack_block_t *blk, tcp_segment_t *seg)
+{
+	if (!seq_no_le_lt(blk->start, seg->seq, blk->end + 1))
+		return false;
+
+	if (seq_no_lt_le(blk->start, blk->end, seg->seq + seg->len))
+		blk->end = seg->seq + seg->len;
+
+	return true;
+}
+
+/** Determine whether segment fails the PAWS test (RFC 7323 section 5.3).
+ *
+ * A segment whose timestamp is older than TS.Recent is an old duplicate,
+ * even if its sequence number appears to be within the receive window.
+ *
+ * @param conn Connection
+ * @param seg  Segment
+ *
+ * @return @c true if segment should be discarded, @c false otherwise
+ */
+bool seq_no_ts_paws_reject(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	if (!conn->ts_ok || !seg->ts_present || (seg->ctrl & CTL_RST) != 0)
+		return false;
+
+	return ((seg->ts_val - conn->ts_recent) & (0x1 << 31)) != 0;
+}
+
+/** Determine whether segment timestamp should be recorded as TS.Recent.
+ *
+ * Only segments covering Last.ACK.sent are considered, so that the
+ * timestamp echoed back reflects the segment which caused the ACK
+ * (RFC 7323 section 4.3).
+ *
+ * @param conn Connection
+ * @param seg  Segment, already known to pass the PAWS test
+ *
+ * @return @c true if TS.Recent should be updated, @c false otherwise
+ */
+bool seq_no_ts_recent_update(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	uint32_t diff;
+
+	if (!conn->ts_ok || !seg->ts_present)
+		return false;
+
+	/* SEG.SEQ <= Last.ACK.sent */
+	diff = conn->ts_last_ack_sent - seg->seq;
+	return (diff & (0x1 << 31)) == 0;
+}
+
 /** Determine whether initial SYN is acked.
  *
  * @param conn Connection
@@ -43,6 +43,11 @@ extern bool seq_no_ack_duplicate(tcp_conn_t *, uint32_t);
 extern bool seq_no_in_rcv_wnd(tcp_conn_t *, uint32_t);
 extern bool seq_no_new_wnd_update(tcp_conn_t *, tcp_segment_t *);
 extern bool seq_no_segment_acked(tcp_conn_t *, tcp_segment_t *, uint32_t);
+extern bool seq_no_acked(tcp_conn_t *, uint32_t);
+extern bool seq_no_segment_sacked(tcp_segment_t *, tcp_sack_block_t *);
+extern bool seq_no_sack_merge(tcp_sack_block_t *, tcp_segment_t *);
+extern bool seq_no_ts_paws_reject(tcp_conn_t *, tcp_segment_t *);
+extern bool seq_no_ts_recent_update(tcp_conn_t *, tcp_segment_t *);
 extern bool seq_no_syn_acked(tcp_conn_t *);
 extern bool seq_no_segment_ready(tcp_conn_t *, tcp_segment_t *);
 extern bool seq_no_segment_acceptable(tcp_conn_t *, tcp_segment_t *);
@@ -34,6 +34,7 @@
  * @file HelenOS service implementation
  */
 
+#include <as.h>
 #include <async.h>
 #include <errno.h>
 #include <str_error.h>
@@ -58,6 +59,7 @@
 #define MAX_MSG_SIZE DATA_XFER_LIMIT
 
 static void tcp_ev_data(tcp_cconn_t *);
+static void tcp_ev_space(tcp_cconn_t *);
 static void tcp_ev_connected(tcp_cconn_t *);
 static void tcp_ev_conn_failed(tcp_cconn_t *);
 static void tcp_ev_conn_reset(tcp_cconn_t *);
@@ -65,6 +67,7 @@ static void tcp_ev_new_conn(tcp_clst_t *, tcp_cconn_t *);
 
 static void tcp_service_cstate_change(tcp_conn_t *, void *, tcp_cstate_t);
 static void tcp_service_recv_data(tcp_conn_t *, void *);
+static void tcp_service_send_space(tcp_conn_t *, void *);
 static void tcp_service_lst_cstate_change(tcp_conn_t *, void *, tcp_cstate_t);
 
 static errno_t tcp_cconn_create(tcp_client_t *, tcp_conn_t *, tcp_cconn_t **);
@@ -72,13 +75,15 @@ static errno_t tcp_cconn_create(tcp_client_t *, tcp_conn_t *, tcp_cconn_t **);
 /** Connection callbacks to tie us to lower layer */
 static tcp_cb_t tcp_service_cb = {
 	.cstate_change = tcp_service_cstate_change,
-	.recv_data = tcp_service_recv_data
+	.recv_data = tcp_service_recv_data,
+	.send_space = tcp_service_send_space
 };
 
 /** Sentinel connection callbacks to tie us to lower layer */
 static tcp_cb_t tcp_service_lst_cb = {
 	.cstate_change = tcp_service_lst_cstate_change,
-	.recv_data = NULL
+	.recv_data = NULL,
+	.send_space = NULL
 };
 
 /** Connection state has changed.
@@ -150,8 +155,8 @@ static void tcp_service_lst_cstate_change(tcp_conn_t *conn, void *arg,
 			return;
 		}
 
-		/* XXX Is there a race here (i.e. the connection is already active)? */
-		tcp_uc_set_cb(conn, &tcp_service_cb, cconn);
+		/* Callbacks run with the connection locked */
+		tcp_conn_set_cb(conn, &tcp_service_cb, cconn);
 
 		/* New incoming connection */
 		tcp_ev_new_conn(clst, cconn);
@@ -198,6 +203,18 @@ static void tcp_service_recv_data(tcp_conn_t *conn, void *arg)
 	tcp_ev_data(cconn);
 }
 
+/** Space became available in the send ring shared with the client.
+ *
+ * @param conn Connection
+ * @param arg  Client connection
+ */
+static void tcp_service_send_space(tcp_conn_t *conn, void *arg)
+{
+	tcp_cconn_t *cconn = (tcp_cconn_t *)arg;
+
+	tcp_ev_space(cconn);
+}
+
 /** Send 'data' event to client.
  *
  * @param cconn Client connection
@@ -218,6 +235,23 @@ static void tcp_ev_data(tcp_cconn_t *cconn)
 	async_forget(req);
 }
 
+/** Send 'space' event to client.
+ *
+ * @param cconn Client connection
+ */
+static void tcp_ev_space(tcp_cconn_t *cconn)
+{
+	async_exch_t *exch;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_ev_space()");
+
+	exch = async_exchange_begin(cconn->client->sess);
+	aid_t req = async_send_1(exch, TCP_EV_SPACE, cconn->id, NULL);
+	async_exchange_end(exch);
+
+	async_forget(req);
+}
+
 /** Send 'connected' event to client.
  *
  * @param cconn Client connection
@@ -308,18 +342,21 @@ static errno_t tcp_cconn_create(tcp_client_t *client, tcp_conn_t *conn,
 	if (cconn == NULL)
 		return ENOMEM;
 
-	/* Allocate new ID */
-	id = 0;
-	list_foreach (client->cconn, lclient, tcp_cconn_t, cconn) {
-		if (cconn->id >= id)
-			id = cconn->id + 1;
-	}
+	fibril_mutex_lock(&client->lock);
+
+	/* Allocate new ID, skipping IDs still in use after wrap-around */
+	do {
+		id = client->cconn_next_id++;
+	} while (hash_table_find(&client->cconn_id, &id) != NULL);
 
 	cconn->id = id;
 	cconn->client = client;
 	cconn->conn = conn;
 
 	list_append(&cconn->lclient, &client->cconn);
+	hash_table_insert(&client->cconn_id, &cconn->lid);
+	fibril_mutex_unlock(&client->lock);
+
 	*rcconn = cconn;
 	return EOK;
 }
@@ -330,7 +367,13 @@ static errno_t tcp_cconn_create(tcp_client_t *client, tcp_conn_t *conn,
  */
 static void tcp_cconn_destroy(tcp_cconn_t *cconn)
 {
+	tcp_client_t *client = cconn->client;
+
+	fibril_mutex_lock(&client->lock);
 	list_remove(&cconn->lclient);
+	hash_table_remove_item(&client->cconn_id, &cconn->lid);
+	fibril_mutex_unlock(&client->lock);
+
 	free(cconn);
 }
 
@@ -355,18 +398,21 @@ static errno_t tcp_clistener_create(tcp_client_t *client, tcp_conn_t *conn,
 	if (clst == NULL)
 		return ENOMEM;
 
-	/* Allocate new ID */
-	id = 0;
-	list_foreach (client->clst, lclient, tcp_clst_t, clst) {
-		if (clst->id >= id)
-			id = clst->id + 1;
-	}
+	fibril_mutex_lock(&client->lock);
+
+	/* Allocate new ID, skipping IDs still in use after wrap-around */
+	do {
+		id = client->clst_next_id++;
+	} while (hash_table_find(&client->clst_id, &id) != NULL);
 
 	clst->id = id;
 	clst->client = client;
 	clst->conn = conn;
 
 	list_append(&clst->lclient, &client->clst);
+	hash_table_insert(&client->clst_id, &clst->lid);
+	fibril_mutex_unlock(&client->lock);
+
 	*rclst = clst;
 	return EOK;
 }
@@ -377,7 +423,13 @@ static errno_t tcp_clistener_create(tcp_client_t *client, tcp_conn_t *conn,
  */
 static void tcp_clistener_destroy(tcp_clst_t *clst)
 {
+	tcp_client_t *client = clst->client;
+
+	fibril_mutex_lock(&client->lock);
 	list_remove(&clst->lclient);
+	hash_table_remove_item(&client->clst_id, &clst->lid);
+	fibril_mutex_unlock(&client->lock);
+
 	free(clst);
 }
 
@@ -393,14 +445,17 @@ static void tcp_clistener_destroy(tcp_clst_t *clst)
 static errno_t tcp_cconn_get(tcp_client_t *client, sysarg_t id,
     tcp_cconn_t **rcconn)
 {
-	list_foreach (client->cconn, lclient, tcp_cconn_t, cconn) {
-		if (cconn->id == id) {
-			*rcconn = cconn;
-			return EOK;
-		}
-	}
+	ht_link_t *link;
+
+	fibril_mutex_lock(&client->lock);
+	link = hash_table_find(&client->cconn_id, &id);
+	fibril_mutex_unlock(&client->lock);
 
-	return ENOENT;
+	if (link == NULL)
+		return ENOENT;
+
+	*rcconn = hash_table_get_inst(link, tcp_cconn_t, lid);
+	return EOK;
 }
 
 /** Get client listener by ID.
@@ -415,14 +470,17 @@ static errno_t tcp_cconn_get(tcp_client_t *client, sysarg_t id,
 static errno_t tcp_clistener_get(tcp_client_t *client, sysarg_t id,
     tcp_clst_t **rclst)
 {
-	list_foreach (client->clst, lclient, tcp_clst_t, clst) {
-		if (clst->id == id) {
-			*rclst = clst;
-			return EOK;
-		}
-	}
+	ht_link_t *link;
+
+	fibril_mutex_lock(&client->lock);
+	link = hash_table_find(&client->clst_id, &id);
+	fibril_mutex_unlock(&client->lock);
 
-	return ENOENT;
+	if (link == NULL)
+		return ENOENT;
+
+	*rclst = hash_table_get_inst(link, tcp_clst_t, lid);
+	return EOK;
 }
 
 /** Create connection.
@@ -647,6 +705,86 @@ static errno_t tcp_conn_reset_impl(tcp_client_t *client, sysarg_t conn_id)
 	return EOK;
 }
 
+/** Select congestion control algorithm.
+ *
+ * Handle client request to select congestion control algorithm
+ * (with parameters unmarshalled).
+ *
+ * @param client  TCP client
+ * @param conn_id Connection ID
+ * @param alg     Congestion control algorithm
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t tcp_conn_set_cc_impl(tcp_client_t *client, sysarg_t conn_id,
+    sysarg_t alg)
+{
+	tcp_cconn_t *cconn;
+	errno_t rc;
+
+	if (alg != tcp_cc_newreno && alg != tcp_cc_cubic)
+		return EINVAL;
+
+	rc = tcp_cconn_get(client, conn_id, &cconn);
+	if (rc != EOK) {
+		assert(rc == ENOENT);
+		return ENOENT;
+	}
+
+	tcp_uc_set_cc(cconn->conn, (tcp_cc_alg_t) alg);
+	return EOK;
+}
+
+/** Share data rings with client.
+ *
+ * Handle client request to share data rings (with parameters unmarshalled).
+ *
+ * @param client  TCP client
+ * @param conn_id Connection ID
+ * @param ring    Area shared by the client
+ * @param rsize   Size of each data ring
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t tcp_conn_ring_share_impl(tcp_client_t *client,
+    sysarg_t conn_id, tcp_ring_area_t *ring, size_t rsize)
+{
+	tcp_cconn_t *cconn;
+	errno_t rc;
+
+	rc = tcp_cconn_get(client, conn_id, &cconn);
+	if (rc != EOK) {
+		assert(rc == ENOENT);
+		return ENOENT;
+	}
+
+	return tcp_uc_ring_attach(cconn->conn, ring, rsize);
+}
+
+/** Client has advanced the shared data rings.
+ *
+ * Handle client doorbell (with parameters unmarshalled).
+ *
+ * @param client  TCP client
+ * @param conn_id Connection ID
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t tcp_conn_ring_kick_impl(tcp_client_t *client, sysarg_t conn_id)
+{
+	tcp_cconn_t *cconn;
+	errno_t rc;
+
+	rc = tcp_cconn_get(client, conn_id, &cconn);
+	if (rc != EOK) {
+		assert(rc == ENOENT);
+		return ENOENT;
+	}
+
+	tcp_uc_ring_kick(cconn->conn);
+	return EOK;
+}
+
 /** Send data over connection..
  *
  * Handle client request to send data (with parameters unmarshalled).
@@ -936,6 +1074,98 @@ static void tcp_conn_reset_srv(tcp_client_t *client, ipc_call_t *icall)
 	async_answer_0(icall, rc);
 }
 
+/** Select congestion control algorithm.
+ *
+ * Handle client request to select congestion control algorithm.
+ *
+ * @param client TCP client
+ * @param icall  Async request data
+ *
+ */
+static void tcp_conn_set_cc_srv(tcp_client_t *client, ipc_call_t *icall)
+{
+	sysarg_t conn_id;
+	sysarg_t alg;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_set_cc_srv()");
+
+	conn_id = ipc_get_arg1(icall);
+	alg = ipc_get_arg2(icall);
+	rc = tcp_conn_set_cc_impl(client, conn_id, alg);
+	async_answer_0(icall, rc);
+}
+
+/** Share data rings with client.
+ *
+ * Handle client request to share data rings. The client shares a memory
+ * area laid out as described by tcp_ring_area_t which then holds the
+ * connection send and receive buffers.
+ *
+ * @param client TCP client
+ * @param icall  Async request data
+ *
+ */
+static void tcp_conn_ring_share_srv(tcp_client_t *client, ipc_call_t *icall)
+{
+	ipc_call_t call;
+	unsigned int flags;
+	sysarg_t conn_id;
+	size_t rsize;
+	size_t size;
+	void *ring;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_ring_share_srv()");
+
+	conn_id = ipc_get_arg1(icall);
+	rsize = ipc_get_arg2(icall);
+
+	if (!async_share_out_receive(&call, &size, &flags)) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(icall, EINVAL);
+		return;
+	}
+
+	if (rsize > TCP_RING_SIZE_MAX || size < TCP_RING_AREA_SIZE(rsize) ||
+	    (flags & (AS_AREA_READ | AS_AREA_WRITE)) !=
+	    (AS_AREA_READ | AS_AREA_WRITE)) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(icall, EINVAL);
+		return;
+	}
+
+	rc = async_share_out_finalize(&call, &ring);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	rc = tcp_conn_ring_share_impl(client, conn_id, ring, rsize);
+	if (rc != EOK)
+		as_area_destroy(ring);
+
+	async_answer_0(icall, rc);
+}
+
+/** Client has advanced the shared data rings.
+ *
+ * Handle client doorbell. The client does not wait for the answer.
+ *
+ * @param client TCP client
+ * @param icall  Async request data
+ *
+ */
+static void tcp_conn_ring_kick_srv(tcp_client_t *client, ipc_call_t *icall)
+{
+	sysarg_t conn_id;
+	errno_t rc;
+
+	conn_id = ipc_get_arg1(icall);
+	rc = tcp_conn_ring_kick_impl(client, conn_id);
+	async_answer_0(icall, rc);
+}
+
 /** Send data via connection..
  *
  * Handle client request to send data via connection.
@@ -1111,16 +1341,78 @@ static void tcp_conn_recv_wait_srv(tcp_client_t *client, ipc_call_t *icall)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_recv_wait_srv(): OK");
 }
 
+static size_t tcp_client_id_key_hash(const void *key)
+{
+	const sysarg_t *id = key;
+	return *id;
+}
+
+static size_t tcp_cconn_id_hash(const ht_link_t *item)
+{
+	tcp_cconn_t *cconn = hash_table_get_inst(item, tcp_cconn_t, lid);
+	return cconn->id;
+}
+
+static bool tcp_cconn_id_key_equal(const void *key, const ht_link_t *item)
+{
+	const sysarg_t *id = key;
+	tcp_cconn_t *cconn = hash_table_get_inst(item, tcp_cconn_t, lid);
+	return cconn->id == *id;
+}
+
+/** Client connections by ID */
+static hash_table_ops_t tcp_cconn_id_ops = {
+	.hash = tcp_cconn_id_hash,
+	.key_hash = tcp_client_id_key_hash,
+	.key_equal = tcp_cconn_id_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+static size_t tcp_clst_id_hash(const ht_link_t *item)
+{
+	tcp_clst_t *clst = hash_table_get_inst(item, tcp_clst_t, lid);
+	return clst->id;
+}
+
+static bool tcp_clst_id_key_equal(const void *key, const ht_link_t *item)
+{
+	const sysarg_t *id = key;
+	tcp_clst_t *clst = hash_table_get_inst(item, tcp_clst_t, lid);
+	return clst->id == *id;
+}
+
+/** Client listeners by ID */
+static hash_table_ops_t tcp_clst_id_ops = {
+	.hash = tcp_clst_id_hash,
+	.key_hash = tcp_client_id_key_hash,
+	.key_equal = tcp_clst_id_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
 /** Initialize TCP client structure.
  *
  * @param client TCP client
+ * @return EOK on success or ENOMEM if out of memory
  */
-static void tcp_client_init(tcp_client_t *client)
+static errno_t tcp_client_init(tcp_client_t *client)
 {
 	memset(client, 0, sizeof(tcp_client_t));
 	client->sess = NULL;
+	fibril_mutex_initialize(&client->lock);
 	list_initialize(&client->cconn);
 	list_initialize(&client->clst);
+
+	if (!hash_table_create(&client->cconn_id, 0, 0, &tcp_cconn_id_ops))
+		return ENOMEM;
+
+	if (!hash_table_create(&client->clst_id, 0, 0, &tcp_clst_id_ops)) {
+		hash_table_destroy(&client->cconn_id);
+		return ENOMEM;
+	}
+
+	return EOK;
 }
 
 /** Finalize TCP client structure.
@@ -1155,6 +1447,9 @@ static void tcp_client_fini(tcp_client_t *client)
 
 	if (client->sess != NULL)
 		async_hangup(client->sess);
+
+	hash_table_destroy(&client->cconn_id);
+	hash_table_destroy(&client->clst_id);
 }
 
 /** Handle TCP client connection.
@@ -1166,6 +1461,13 @@ static void tcp_client_fini(tcp_client_t *client)
 static void tcp_client_conn(ipc_call_t *icall, void *arg)
 {
 	tcp_client_t client;
+	errno_t rc;
+
+	rc = tcp_client_init(&client);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
 
 	/* Accept the connection */
 	async_accept_0(icall);
@@ -1173,8 +1475,6 @@ static void tcp_client_conn(ipc_call_t *icall, void *arg)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_client_conn() - client=%p",
 	    &client);
 
-	tcp_client_init(&client);
-
 	while (true) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_client_conn: wait req");
 		ipc_call_t call;
@@ -1223,6 +1523,15 @@ static void tcp_client_conn(ipc_call_t *icall, void *arg)
 		case TCP_CONN_RECV_WAIT:
 			tcp_conn_recv_wait_srv(&client, &call);
 			break;
+		case TCP_CONN_SET_CC:
+			tcp_conn_set_cc_srv(&client, &call);
+			break;
+		case TCP_CONN_RING_SHARE:
+			tcp_conn_ring_share_srv(&client, &call);
+			break;
+		case TCP_CONN_RING_KICK:
+			tcp_conn_ring_kick_srv(&client, &call);
+			break;
 		default:
 			async_answer_0(&call, ENOTSUP);
 			break;
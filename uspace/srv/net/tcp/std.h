@@ -109,9 +109,42 @@ enum opt_kind {
 	/** No-operation */
 	OPT_NOP			= 1,
 	/** Maximum segment size */
-	OPT_MAX_SEG_SIZE	= 2
+	OPT_MAX_SEG_SIZE	= 2,
+	/** Window scale */
+	OPT_WND_SCALE		= 3,
+	/** SACK permitted */
+	OPT_SACK_PERMITTED	= 4,
+	/** SACK */
+	OPT_SACK		= 5,
+	/** Timestamps */
+	OPT_TIMESTAMPS		= 8
 };
 
+/** Option lengths */
+enum opt_len {
+	/** Maximum segment size */
+	OPT_MAX_SEG_SIZE_LEN	= 4,
+	/** Window scale */
+	OPT_WND_SCALE_LEN	= 3,
+	/** SACK permitted */
+	OPT_SACK_PERMITTED_LEN	= 2,
+	/** SACK without blocks */
+	OPT_SACK_HDR_LEN	= 2,
+	/** One SACK block */
+	OPT_SACK_BLOCK_LEN	= 8,
+	/** Timestamps */
+	OPT_TIMESTAMPS_LEN	= 10
+};
+
+/** Maximum segment size assumed if the peer does not send the option */
+#define TCP_DEFAULT_MSS		536
+
+/** Largest window scale shift count (RFC 7323 section 2.3) */
+#define TCP_WSCALE_MAX		14
+
+/** Maximum size of TCP header including options */
+#define TCP_HEADER_MAX_SIZE	60
+
 #endif
 
 /** @}
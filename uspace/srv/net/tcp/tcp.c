@@ -36,8 +36,10 @@
 
 #include <async.h>
 #include <errno.h>
+#include <fibril.h>
 #include <io/log.h>
 #include <stdio.h>
+#include <str.h>
 #include <task.h>
 
 #include "conn.h"
@@ -50,16 +52,18 @@
 
 #define NAME       "tcp"
 
+/** Default amount of data transferred by the goodput benchmark (KiB) */
+#define GOODPUT_SIZE 1024
+
 static tcp_rqueue_cb_t tcp_rqueue_cb = {
 	.seg_received = tcp_as_segment_arrived
 };
 
-static errno_t tcp_init(void)
+/** Initialize connection management and internal queues. */
+static errno_t tcp_core_init(void)
 {
 	errno_t rc;
 
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_init()");
-
 	rc = tcp_conns_init();
 	if (rc != EOK) {
 		assert(rc == ENOMEM);
@@ -73,6 +77,19 @@ static errno_t tcp_init(void)
 	tcp_ncsim_init();
 	tcp_ncsim_fibril_start();
 
+	return EOK;
+}
+
+static errno_t tcp_init(void)
+{
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_init()");
+
+	rc = tcp_core_init();
+	if (rc != EOK)
+		return rc;
+
 	if (0)
 		tcp_test();
 
@@ -89,6 +106,87 @@ static errno_t tcp_init(void)
 	return EOK;
 }
 
+static void print_syntax(void)
+{
+	printf("Syntax:\n");
+	printf("  " NAME "                Run as TCP service\n");
+	printf("  " NAME " --goodput [-c newreno|cubic] [-l <loss_ppm>] "
+	    "[-d <delay_ms>]\n");
+	printf("      [-j <jitter_ms>] [-s <size_KiB>]\n");
+	printf("                       Measure goodput over simulated network "
+	    "conditions\n");
+}
+
+/** Run goodput benchmark over the network condition simulator. */
+static int tcp_goodput_main(int argc, char **argv)
+{
+	tcp_ncsim_cfg_t cfg;
+	tcp_cc_alg_t alg;
+	uint64_t val;
+	uint64_t size;
+	int i;
+	errno_t rc;
+
+	alg = tcp_cc_newreno;
+	cfg.loss_ppm = 0;
+	cfg.delay = 0;
+	cfg.jitter = 0;
+	size = GOODPUT_SIZE;
+
+	for (i = 0; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			print_syntax();
+			return 1;
+		}
+
+		if (str_cmp(argv[i], "-c") == 0) {
+			if (str_cmp(argv[i + 1], "newreno") == 0) {
+				alg = tcp_cc_newreno;
+			} else if (str_cmp(argv[i + 1], "cubic") == 0) {
+				alg = tcp_cc_cubic;
+			} else {
+				print_syntax();
+				return 1;
+			}
+			continue;
+		}
+
+		rc = str_uint64_t(argv[i + 1], NULL, 10, true, &val);
+		if (rc != EOK) {
+			print_syntax();
+			return 1;
+		}
+
+		if (str_cmp(argv[i], "-l") == 0) {
+			cfg.loss_ppm = val;
+		} else if (str_cmp(argv[i], "-d") == 0) {
+			cfg.delay = val * 1000;
+		} else if (str_cmp(argv[i], "-j") == 0) {
+			cfg.jitter = val * 1000;
+		} else if (str_cmp(argv[i], "-s") == 0) {
+			size = val;
+		} else {
+			print_syntax();
+			return 1;
+		}
+	}
+
+	rc = tcp_core_init();
+	if (rc != EOK)
+		return 1;
+
+	printf(NAME ": loss %u ppm, delay %lld ms, jitter %lld ms\n",
+	    cfg.loss_ppm, cfg.delay / 1000, cfg.jitter / 1000);
+
+	rc = tcp_test_goodput(&cfg, alg, size * 1024);
+	if (rc != EOK) {
+		printf(NAME ": Transfer failed.\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	errno_t rc;
@@ -101,10 +199,25 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	if (argc >= 2) {
+		if (str_cmp(argv[1], "--goodput") == 0)
+			return tcp_goodput_main(argc - 2, argv + 2);
+
+		print_syntax();
+		return 1;
+	}
+
 	rc = tcp_init();
 	if (rc != EOK)
 		return 1;
 
+	/*
+	 * Segments of different connections are processed by different
+	 * receive queue fibrils under per-connection locks, let them run
+	 * in parallel.
+	 */
+	fibril_enable_multithreaded();
+
 	printf(NAME ": Accepting connections.\n");
 	task_retval(0);
 	async_manager();
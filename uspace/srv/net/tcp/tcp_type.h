@@ -35,6 +35,7 @@
 #ifndef TCP_TYPE_H
 #define TCP_TYPE_H
 
+#include <adt/hash_table.h>
 #include <adt/list.h>
 #include <async.h>
 #include <stdbool.h>
@@ -43,8 +44,12 @@
 #include <refcount.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 #include <inet/addr.h>
 #include <inet/endpoint.h>
+#include <ipc/tcp.h>
+#include <types/inet.h>
+#include <types/inet/tcp.h>
 
 struct tcp_conn;
 
@@ -146,6 +151,7 @@ typedef void (*tcp_cstate_cb_t)(tcp_conn_t *, void *);
 typedef struct {
 	void (*cstate_change)(tcp_conn_t *, void *, tcp_cstate_t);
 	void (*recv_data)(tcp_conn_t *, void *);
+	void (*send_space)(tcp_conn_t *, void *);
 } tcp_cb_t;
 
 /** Data returned by Status user call */
@@ -154,6 +160,17 @@ typedef struct {
 	tcp_cstate_t cstate;
 } tcp_conn_status_t;
 
+/** Maximum number of SACK blocks carried by a segment */
+#define TCP_SACK_BLOCKS_MAX 3
+
+/** SACK block (RFC 2018) */
+typedef struct {
+	/** Left edge (first sequence number in the block) */
+	uint32_t start;
+	/** Right edge (sequence number following the block) */
+	uint32_t end;
+} tcp_sack_block_t;
+
 typedef struct {
 	/** SYN, FIN */
 	tcp_control_t ctrl;
@@ -169,6 +186,25 @@ typedef struct {
 	/** Segment urgent pointer */
 	uint32_t up;
 
+	/** Maximum segment size option or zero if not present */
+	uint16_t mss;
+	/** SACK-permitted option is present */
+	bool sack_perm;
+	/** Number of SACK blocks */
+	uint8_t sack_cnt;
+	/** SACK blocks */
+	tcp_sack_block_t sack[TCP_SACK_BLOCKS_MAX];
+	/** Window scale option is present */
+	bool wscale_present;
+	/** Window scale shift count */
+	uint8_t wscale;
+	/** Timestamps option is present */
+	bool ts_present;
+	/** Timestamp value */
+	uint32_t ts_val;
+	/** Timestamp echo reply */
+	uint32_t ts_ecr;
+
 	/** Segment data, may be moved when trimming segment */
 	void *data;
 	/** Segment data, original pointer used to free data */
@@ -191,11 +227,30 @@ typedef struct {
 /** NCSim queue entry */
 typedef struct {
 	link_t link;
-	usec_t delay;
+	/** Time when the segment should be delivered */
+	struct timespec due;
 	inet_ep2_t epp;
 	tcp_segment_t *seg;
 } tcp_squeue_entry_t;
 
+/** NCSim network conditions */
+typedef struct {
+	/** Probability of dropping a segment in parts per million */
+	unsigned loss_ppm;
+	/** One-way delay */
+	usec_t delay;
+	/** Maximum random delay added to @c delay */
+	usec_t jitter;
+} tcp_ncsim_cfg_t;
+
+/** NCSim statistics */
+typedef struct {
+	/** Segments passed to the simulator */
+	size_t segs;
+	/** Segments dropped */
+	size_t dropped;
+} tcp_ncsim_stats_t;
+
 /** Incoming queue entry */
 typedef struct {
 	link_t link;
@@ -207,6 +262,10 @@ typedef struct {
 	link_t link;
 	tcp_conn_t *conn;
 	tcp_segment_t *seg;
+	/** Segment was selectively acknowledged by the peer */
+	bool sacked;
+	/** Segment has been retransmitted */
+	bool rexmit;
 } tcp_tqueue_entry_t;
 
 /** Retransmission queue callbacks */
@@ -227,6 +286,42 @@ typedef struct {
 	tcp_tqueue_cb_t *cb;
 } tcp_tqueue_t;
 
+/** Round-trip time estimator state (RFC 6298) */
+typedef struct {
+	/** At least one RTT measurement has been made */
+	bool valid;
+	/** Smoothed round-trip time */
+	usec_t srtt;
+	/** Round-trip time variation */
+	usec_t rttvar;
+	/** Retransmission timeout */
+	usec_t rto;
+} tcp_rtt_t;
+
+/** Congestion control state */
+typedef struct {
+	/** Algorithm */
+	tcp_cc_alg_t alg;
+	/** Sender maximum segment size */
+	uint32_t smss;
+	/** Congestion window */
+	uint32_t cwnd;
+	/** Slow start threshold */
+	uint32_t ssthresh;
+	/** CUBIC: Window size just before the last reduction */
+	uint32_t w_max;
+	/** CUBIC: Congestion avoidance epoch has started */
+	bool epoch_valid;
+	/** CUBIC: Start of the current congestion avoidance epoch */
+	usec_t epoch;
+	/** CUBIC: Congestion window at the start of the epoch */
+	uint32_t epoch_cwnd;
+	/** CUBIC: Window size the cubic function plateaus at */
+	uint32_t origin;
+	/** CUBIC: Time to reach @c origin from the start of the epoch (ms) */
+	uint32_t k;
+} tcp_cc_t;
+
 /** Connection */
 struct tcp_conn {
 	char *name;
@@ -241,6 +336,10 @@ struct tcp_conn {
 	inet_ep2_t ident;
 	/** Connection is in association map */
 	bool mapped;
+	/** Link to connection table (if @c ident is fully specified) */
+	ht_link_t lhash;
+	/** Connection is in connection table */
+	bool hashed;
 
 	/** Active or passive connection */
 	acpass_t ap;
@@ -271,10 +370,12 @@ struct tcp_conn {
 	/** Time-Wait timeout timer */
 	fibril_timer_t *tw_timer;
 
-	/** Receive buffer */
+	/** Receive buffer (circular) */
 	uint8_t *rcv_buf;
 	/** Receive buffer size */
 	size_t rcv_buf_size;
+	/** Offset of the first used byte in receive buffer */
+	size_t rcv_buf_start;
 	/** Receive buffer number of bytes used */
 	size_t rcv_buf_used;
 	/** Receive buffer contains FIN */
@@ -282,10 +383,12 @@ struct tcp_conn {
 	/** Receive buffer CV. Broadcast when new data is inserted */
 	fibril_condvar_t rcv_buf_cv;
 
-	/** Send buffer */
+	/** Send buffer (circular) */
 	uint8_t *snd_buf;
 	/** Send buffer size */
 	size_t snd_buf_size;
+	/** Offset of the first used byte in send buffer */
+	size_t snd_buf_start;
 	/** Send buffer number of bytes used */
 	size_t snd_buf_used;
 	/** Send buffer contains FIN */
@@ -293,6 +396,25 @@ struct tcp_conn {
 	/** Send buffer CV. Broadcast when space is made available in buffer */
 	fibril_condvar_t snd_buf_cv;
 
+	/** Area shared with the client holding the buffers or @c NULL */
+	tcp_ring_area_t *ring;
+	/** Receive ring consumer counter last seen */
+	uint32_t ring_rcv_cons;
+	/** Send ring producer counter last seen */
+	uint32_t ring_snd_prod;
+
+	/** Bytes read by the user since @c rcv_space_start */
+	size_t rcv_space_copied;
+	/** Start of the current receive buffer tuning interval */
+	usec_t rcv_space_start;
+
+	/** Delayed ACK timer */
+	fibril_timer_t *ack_timer;
+	/** Number of received segments we have not acknowledged yet */
+	unsigned rcv_unacked;
+	/** Right edge of the receive window last advertised to the peer */
+	uint32_t rcv_adv;
+
 	/** Send unacknowledged */
 	uint32_t snd_una;
 	/** Send next */
@@ -308,6 +430,37 @@ struct tcp_conn {
 	/** Initial send sequence number */
 	uint32_t iss;
 
+	/** Congestion control */
+	tcp_cc_t cc;
+	/** Round-trip time estimation */
+	tcp_rtt_t rtt;
+	/** A segment is being timed to measure RTT */
+	bool rtt_timing;
+	/** Sequence number whose acknowledgement completes the measurement */
+	uint32_t rtt_seq;
+	/** Time when the timed segment was sent */
+	usec_t rtt_start;
+	/** Number of consecutive duplicate ACKs */
+	unsigned dupacks;
+	/** Fast recovery is in progress */
+	bool in_recovery;
+	/** SND.NXT at the time fast recovery was last entered (RFC 6582) */
+	uint32_t recover;
+	/** Both sides agreed to use selective acknowledgements */
+	bool sack_ok;
+	/** Both sides agreed to use window scaling */
+	bool ws_ok;
+	/** Shift count applied to windows advertised by the peer */
+	uint8_t snd_wscale;
+	/** Shift count applied to windows we advertise */
+	uint8_t rcv_wscale;
+	/** Both sides agreed to use timestamps */
+	bool ts_ok;
+	/** Timestamp to echo in the next segment (TS.Recent) */
+	uint32_t ts_recent;
+	/** Acknowledgement number of the last segment sent (Last.ACK.sent) */
+	uint32_t ts_last_ack_sent;
+
 	/** Receive next */
 	uint32_t rcv_nxt;
 	/** Receive window */
@@ -342,6 +495,12 @@ typedef struct {
 	void *text;
 	/** Text size */
 	size_t text_size;
+	/**
+	 * INET_OFFLOAD_* flags. With INET_OFFLOAD_CSUM the checksum field
+	 * only holds the pseudo-header sum, with INET_OFFLOAD_CSUM_VALID
+	 * the checksum was verified by the link.
+	 */
+	uint16_t offload;
 } tcp_pdu_t;
 
 /** TCP client connection */
@@ -353,6 +512,8 @@ typedef struct tcp_cconn {
 	/** Client */
 	struct tcp_client *client;
 	link_t lclient;
+	/** Link to tcp_client_t.cconn_id */
+	ht_link_t lid;
 } tcp_cconn_t;
 
 /** TCP client listener */
@@ -367,16 +528,28 @@ typedef struct tcp_clst {
 	struct tcp_client *client;
 	/** Link to tcp_client_t.clst */
 	link_t lclient;
+	/** Link to tcp_client_t.clst_id */
+	ht_link_t lid;
 } tcp_clst_t;
 
 /** TCP client */
 typedef struct tcp_client {
 	/** Client callback session */
 	async_sess_t *sess;
+	/** Protects connection and listener lists and maps */
+	fibril_mutex_t lock;
 	/** Client's connections */
 	list_t cconn; /* of tcp_cconn_t */
+	/** Client's connections by ID */
+	hash_table_t cconn_id; /* of tcp_cconn_t */
+	/** ID to try first for the next connection */
+	sysarg_t cconn_next_id;
 	/** Client's listeners */
 	list_t clst;
+	/** Client's listeners by ID */
+	hash_table_t clst_id; /* of tcp_clst_t */
+	/** ID to try first for the next listener */
+	sysarg_t clst_next_id;
 } tcp_client_t;
 
 /** Internal loopback type */
@@ -36,9 +36,14 @@
 
 #include <async.h>
 #include <errno.h>
+#include <macros.h>
+#include <mem.h>
 #include <stdio.h>
 #include <fibril.h>
 #include <str.h>
+#include <time.h>
+#include "conn.h"
+#include "ncsim.h"
 #include "tcp_type.h"
 #include "ucall.h"
 
@@ -46,6 +51,20 @@
 
 #define RCV_BUF_SIZE 64
 
+/** Goodput benchmark transfer chunk size */
+#define GOODPUT_CHUNK 1024
+/** Goodput benchmark ports */
+#define GOODPUT_SRV_PORT 5001
+#define GOODPUT_CLI_PORT 5002
+
+/** Goodput benchmark sender */
+typedef struct {
+	/** Connection */
+	tcp_conn_t *conn;
+	/** Number of bytes to send */
+	size_t size;
+} goodput_send_t;
+
 static errno_t test_srv(void *arg)
 {
 	tcp_conn_t *conn;
@@ -122,6 +141,130 @@ static errno_t test_cli(void *arg)
 	return 0;
 }
 
+/** Goodput benchmark sender fibril. */
+static errno_t goodput_sender(void *arg)
+{
+	goodput_send_t *gs = (goodput_send_t *) arg;
+	uint8_t buf[GOODPUT_CHUNK];
+	size_t left;
+	size_t now;
+
+	memset(buf, 0x5a, sizeof(buf));
+
+	left = gs->size;
+	while (left > 0) {
+		now = min(left, sizeof(buf));
+		if (tcp_uc_send(gs->conn, buf, now, 0) != TCP_EOK)
+			break;
+		left -= now;
+	}
+
+	tcp_uc_close(gs->conn);
+	return 0;
+}
+
+/** Measure goodput over the network condition simulator.
+ *
+ * Two connections are set up over internal segment loopback and @a size
+ * bytes are transferred from one to the other with segments bounced
+ * through the simulator configured according to @a cfg.
+ *
+ * @param cfg	Simulated network conditions
+ * @param alg	Congestion control algorithm used by the sender
+ * @param size	Number of bytes to transfer
+ * @return	EOK on success, EIO if transfer failed
+ */
+errno_t tcp_test_goodput(tcp_ncsim_cfg_t *cfg, tcp_cc_alg_t alg, size_t size)
+{
+	tcp_conn_t *sconn;
+	tcp_conn_t *cconn;
+	inet_ep2_t sepp;
+	inet_ep2_t cepp;
+	goodput_send_t gs;
+	struct timespec t0, t1;
+	uint8_t buf[GOODPUT_CHUNK];
+	tcp_ncsim_stats_t stats;
+	size_t total;
+	size_t rcvd;
+	xflags_t xflags;
+	tcp_error_t trc;
+	usec_t elapsed;
+	fid_t fid;
+
+	tcp_conn_lb = tcp_lb_segment;
+	tcp_ncsim_set_cfg(cfg);
+
+	inet_ep2_init(&sepp);
+	inet_addr(&sepp.local.addr, 127, 0, 0, 1);
+	sepp.local.port = GOODPUT_SRV_PORT;
+	inet_addr(&sepp.remote.addr, 127, 0, 0, 1);
+	sepp.remote.port = GOODPUT_CLI_PORT;
+
+	trc = tcp_uc_open(&sepp, ap_passive, tcp_open_nonblock, &sconn);
+	if (trc != TCP_EOK)
+		return EIO;
+	sconn->name = (char *) "S";
+
+	tcp_ep2_flipped(&sepp, &cepp);
+
+	trc = tcp_uc_open(&cepp, ap_active, 0, &cconn);
+	if (trc != TCP_EOK) {
+		tcp_uc_abort(sconn);
+		tcp_uc_delete(sconn);
+		return EIO;
+	}
+	cconn->name = (char *) "C";
+	tcp_uc_set_cc(cconn, alg);
+
+	getuptime(&t0);
+
+	gs.conn = cconn;
+	gs.size = size;
+	fid = fibril_create(goodput_sender, &gs);
+	if (fid == 0) {
+		tcp_uc_abort(cconn);
+		tcp_uc_abort(sconn);
+		tcp_uc_delete(cconn);
+		tcp_uc_delete(sconn);
+		return ENOMEM;
+	}
+
+	fibril_add_ready(fid);
+
+	total = 0;
+	while (true) {
+		tcp_conn_lock(sconn);
+		while (sconn->rcv_buf_used == 0 && !sconn->rcv_buf_fin &&
+		    !sconn->reset) {
+			fibril_condvar_wait(&sconn->rcv_buf_cv, &sconn->lock);
+		}
+		tcp_conn_unlock(sconn);
+
+		trc = tcp_uc_receive(sconn, buf, sizeof(buf), &rcvd, &xflags);
+		if (trc != TCP_EOK)
+			break;
+
+		total += rcvd;
+	}
+
+	getuptime(&t1);
+	elapsed = NSEC2USEC(ts_sub_diff(&t1, &t0));
+	tcp_ncsim_get_stats(&stats);
+
+	printf("%s: %zu bytes in %lld ms, %llu KiB/s, %zu segments, "
+	    "%zu dropped, SRTT %lld us, RTO %lld us\n",
+	    alg == tcp_cc_cubic ? "cubic" : "newreno", total,
+	    elapsed / 1000, elapsed > 0 ?
+	    (unsigned long long) total * 1000000 / 1024 / elapsed : 0,
+	    stats.segs, stats.dropped, cconn->rtt.srtt, cconn->rtt.rto);
+
+	tcp_uc_close(sconn);
+	tcp_uc_delete(cconn);
+	tcp_uc_delete(sconn);
+
+	return total == size ? EOK : EIO;
+}
+
 void tcp_test(void)
 {
 	fid_t srv_fid;
@@ -35,7 +35,11 @@
 #ifndef TEST_H
 #define TEST_H
 
+#include <errno.h>
+#include "tcp_type.h"
+
 extern void tcp_test(void);
+extern errno_t tcp_test_goodput(tcp_ncsim_cfg_t *, tcp_cc_alg_t, size_t);
 
 #endif
 
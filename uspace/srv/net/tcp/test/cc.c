@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pcut/pcut.h>
+
+#include "../cc.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(cc);
+
+/** Test initial window selection (RFC 5681 section 3.1) */
+PCUT_TEST(init_window)
+{
+	tcp_cc_t cc;
+
+	tcp_cc_init(&cc, tcp_cc_newreno, 536);
+	PCUT_ASSERT_INT_EQUALS(4 * 536, cc.cwnd);
+
+	tcp_cc_init(&cc, tcp_cc_newreno, 1460);
+	PCUT_ASSERT_INT_EQUALS(3 * 1460, cc.cwnd);
+
+	tcp_cc_init(&cc, tcp_cc_newreno, 2200);
+	PCUT_ASSERT_INT_EQUALS(2 * 2200, cc.cwnd);
+}
+
+/** Test NewReno slow start and congestion avoidance */
+PCUT_TEST(newreno_ack)
+{
+	tcp_cc_t cc;
+
+	tcp_cc_init(&cc, tcp_cc_newreno, 1460);
+
+	/* Slow start grows by at most SMSS per ACK */
+	tcp_cc_ack(&cc, 1460, 0, 0);
+	PCUT_ASSERT_INT_EQUALS(4 * 1460, cc.cwnd);
+	tcp_cc_ack(&cc, 3000, 0, 0);
+	PCUT_ASSERT_INT_EQUALS(5 * 1460, cc.cwnd);
+
+	/* Congestion avoidance grows by about SMSS per RTT */
+	cc.ssthresh = 5000;
+	cc.cwnd = 14600;
+	tcp_cc_ack(&cc, 1460, 0, 0);
+	PCUT_ASSERT_INT_EQUALS(14600 + 146, cc.cwnd);
+}
+
+/** Test NewReno reaction to loss and retransmission timeout */
+PCUT_TEST(newreno_loss)
+{
+	tcp_cc_t cc;
+
+	tcp_cc_init(&cc, tcp_cc_newreno, 1460);
+	cc.cwnd = 20000;
+
+	tcp_cc_loss(&cc, 20000);
+	PCUT_ASSERT_INT_EQUALS(10000, cc.ssthresh);
+
+	/* ssthresh never goes below 2 * SMSS */
+	tcp_cc_loss(&cc, 1000);
+	PCUT_ASSERT_INT_EQUALS(2 * 1460, cc.ssthresh);
+
+	tcp_cc_timeout(&cc, 8000);
+	PCUT_ASSERT_INT_EQUALS(4000, cc.ssthresh);
+	PCUT_ASSERT_INT_EQUALS(1460, cc.cwnd);
+}
+
+/** Test CUBIC multiplicative decrease and fast convergence */
+PCUT_TEST(cubic_loss)
+{
+	tcp_cc_t cc;
+
+	tcp_cc_init(&cc, tcp_cc_cubic, 1460);
+	cc.cwnd = 100000;
+
+	tcp_cc_loss(&cc, 100000);
+	PCUT_ASSERT_INT_EQUALS(100000, cc.w_max);
+	PCUT_ASSERT_INT_EQUALS(70000, cc.ssthresh);
+
+	/* Loss below the previous W_max releases bandwidth faster */
+	cc.cwnd = 50000;
+	tcp_cc_loss(&cc, 50000);
+	PCUT_ASSERT_INT_EQUALS(42500, cc.w_max);
+	PCUT_ASSERT_INT_EQUALS(35000, cc.ssthresh);
+}
+
+/** Test CUBIC window growth after loss */
+PCUT_TEST(cubic_growth)
+{
+	tcp_cc_t cc;
+	usec_t now;
+	uint32_t prev;
+	uint32_t n, i;
+	int rtt;
+
+	tcp_cc_init(&cc, tcp_cc_cubic, 1460);
+	cc.cwnd = 100000;
+	tcp_cc_loss(&cc, 100000);
+	cc.cwnd = cc.ssthresh;
+
+	/* Acknowledge one full window per 100 ms round trip */
+	now = 0;
+	prev = cc.cwnd;
+	for (rtt = 0; rtt < 60; rtt++) {
+		n = cc.cwnd / 1460;
+		for (i = 0; i < n; i++)
+			tcp_cc_ack(&cc, 1460, now, 100000);
+		now += 100000;
+
+		/* Window never shrinks without loss */
+		PCUT_ASSERT_TRUE(cc.cwnd >= prev);
+		prev = cc.cwnd;
+
+		/* Concave region plateaus just below W_max */
+		if (rtt == 30) {
+			PCUT_ASSERT_TRUE(cc.cwnd > 95000);
+			PCUT_ASSERT_TRUE(cc.cwnd <= 100000);
+		}
+	}
+
+	/* Convex region probes beyond W_max */
+	PCUT_ASSERT_TRUE(cc.cwnd > 105000);
+}
+
+PCUT_EXPORT(cc);
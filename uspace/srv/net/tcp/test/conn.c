@@ -113,6 +113,47 @@ PCUT_TEST(add_find_delete)
 	tcp_conn_delete(conn);
 }
 
+/** Test finding connection with fully specified endpoint pair */
+PCUT_TEST(add_find_full)
+{
+	tcp_conn_t *conn, *cfound;
+	inet_ep2_t epp;
+	errno_t rc;
+
+	inet_ep2_init(&epp);
+	inet_addr(&epp.local.addr, 1, 2, 3, 4);
+	epp.local.port = 1234;
+	inet_addr(&epp.remote.addr, 5, 6, 7, 8);
+	epp.remote.port = 5678;
+
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	rc = tcp_conn_add(conn);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(conn->hashed);
+
+	cfound = tcp_conn_find_ref(&epp);
+	PCUT_ASSERT_EQUALS(conn, cfound);
+	tcp_conn_delref(cfound);
+
+	/* Different remote port */
+	epp.remote.port = 5679;
+	cfound = tcp_conn_find_ref(&epp);
+	PCUT_ASSERT_EQUALS(NULL, cfound);
+
+	tcp_conn_lock(conn);
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+	PCUT_ASSERT_FALSE(conn->hashed);
+
+	epp.remote.port = 5678;
+	cfound = tcp_conn_find_ref(&epp);
+	PCUT_ASSERT_EQUALS(NULL, cfound);
+
+	tcp_conn_delete(conn);
+}
+
 /** Test trying to connect to endpoint that sends RST back */
 PCUT_TEST(connect_rst)
 {
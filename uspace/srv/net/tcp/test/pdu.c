@@ -108,4 +108,106 @@ PCUT_TEST(encdec_data)
 	free(data);
 }
 
+/** Test that PDU with incomplete checksum is rejected unless verified */
+PCUT_TEST(decode_checksum)
+{
+	tcp_segment_t *seg, *dseg;
+	tcp_pdu_t *pdu;
+	inet_ep2_t epp, depp;
+	errno_t rc;
+
+	inet_ep2_init(&epp);
+	inet_addr(&epp.local.addr, 1, 2, 3, 4);
+	inet_addr(&epp.remote.addr, 5, 6, 7, 8);
+	epp.local.port = 1234;
+	epp.remote.port = 80;
+
+	seg = tcp_segment_make_ctrl(CTL_SYN);
+	PCUT_ASSERT_NOT_NULL(seg);
+
+	seg->seq = 20;
+
+	rc = tcp_pdu_encode(&epp, seg, &pdu);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE((pdu->offload & INET_OFFLOAD_CSUM) != 0);
+
+	/* As received from a link which does not verify checksums */
+	pdu->offload = 0;
+	rc = tcp_pdu_decode(pdu, &depp, &dseg);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+
+	/* As received from a link which verified the checksum */
+	pdu->offload = INET_OFFLOAD_CSUM_VALID;
+	rc = tcp_pdu_decode(pdu, &depp, &dseg);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_seg_same(seg, dseg);
+	tcp_segment_delete(dseg);
+	tcp_pdu_delete(pdu);
+	tcp_segment_delete(seg);
+}
+
+/** Test encode/decode round trip for PDU with options */
+PCUT_TEST(encdec_options)
+{
+	tcp_segment_t *seg, *dseg;
+	tcp_pdu_t *pdu;
+	inet_ep2_t epp, depp;
+	errno_t rc;
+
+	inet_ep2_init(&epp);
+	inet_addr(&epp.local.addr, 1, 2, 3, 4);
+	inet_addr(&epp.remote.addr, 5, 6, 7, 8);
+
+	seg = tcp_segment_make_ctrl(CTL_SYN | CTL_ACK);
+	PCUT_ASSERT_NOT_NULL(seg);
+
+	seg->seq = 20;
+	seg->ack = 19;
+	seg->wnd = 18;
+	seg->mss = 1460;
+	seg->sack_perm = true;
+	seg->wscale_present = true;
+	seg->wscale = 7;
+	seg->ts_present = true;
+	seg->ts_val = 0x12345678;
+	seg->ts_ecr = 0x9abcdef0;
+
+	rc = tcp_pdu_encode(&epp, seg, &pdu);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = tcp_pdu_decode(pdu, &depp, &dseg);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_seg_same(seg, dseg);
+	tcp_segment_delete(dseg);
+	tcp_pdu_delete(pdu);
+	tcp_segment_delete(seg);
+
+	seg = tcp_segment_make_ctrl(CTL_ACK);
+	PCUT_ASSERT_NOT_NULL(seg);
+
+	seg->seq = 100;
+	seg->ack = 200;
+	seg->sack[0].start = 300;
+	seg->sack[0].end = 400;
+	seg->sack[1].start = 500;
+	seg->sack[1].end = 600;
+	seg->sack[2].start = 700;
+	seg->sack[2].end = 800;
+	seg->sack_cnt = 3;
+	seg->ts_present = true;
+	seg->ts_val = 1000;
+	seg->ts_ecr = 999;
+
+	rc = tcp_pdu_encode(&epp, seg, &pdu);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = tcp_pdu_decode(pdu, &depp, &dseg);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_seg_same(seg, dseg);
+	tcp_segment_delete(dseg);
+	tcp_pdu_delete(pdu);
+	tcp_segment_delete(seg);
+}
+
 PCUT_EXPORT(pdu);
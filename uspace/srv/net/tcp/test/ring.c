@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <as.h>
+#include <errno.h>
+#include <io/log.h>
+#include <pcut/pcut.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "../conn.h"
+#include "../ring.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(ring);
+
+enum {
+	test_ring_size = 4 * TCP_RING_SIZE_MIN
+};
+
+PCUT_TEST_BEFORE
+{
+	errno_t rc;
+
+	/* We will be calling functions that perform logging */
+	rc = log_init("test-tcp");
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	rc = tcp_conns_init();
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+}
+
+PCUT_TEST_AFTER
+{
+	tcp_conns_fini();
+}
+
+/** Test writing and reading across the end of a circular buffer */
+PCUT_TEST(write_read_wrap)
+{
+	uint8_t buf[8];
+	uint8_t data[5] = { 1, 2, 3, 4, 5 };
+	uint8_t rdata[5];
+	int i;
+
+	tcp_ring_write(buf, sizeof(buf), 6, data, sizeof(data));
+	PCUT_ASSERT_INT_EQUALS(1, buf[6]);
+	PCUT_ASSERT_INT_EQUALS(2, buf[7]);
+	PCUT_ASSERT_INT_EQUALS(3, buf[0]);
+	PCUT_ASSERT_INT_EQUALS(5, buf[2]);
+
+	tcp_ring_read(buf, sizeof(buf), 6, rdata, sizeof(rdata));
+	for (i = 0; i < 5; i++)
+		PCUT_ASSERT_INT_EQUALS(data[i], rdata[i]);
+}
+
+/** Test growing a private circular buffer with wrapped contents */
+PCUT_TEST(resize)
+{
+	uint8_t *buf;
+	int i;
+
+	buf = malloc(8);
+	PCUT_ASSERT_NOT_NULL(buf);
+
+	for (i = 0; i < 6; i++)
+		buf[(5 + i) % 8] = i;
+
+	buf = tcp_ring_resize(buf, 8, 5, 6, 16);
+	PCUT_ASSERT_NOT_NULL(buf);
+	for (i = 0; i < 6; i++)
+		PCUT_ASSERT_INT_EQUALS(i, buf[i]);
+
+	free(buf);
+}
+
+/** Test moving buffers to a shared area and exchanging counters */
+PCUT_TEST(attach_sync)
+{
+	tcp_conn_t *conn;
+	tcp_ring_area_t *ring;
+	uint8_t *snd_data;
+	uint8_t *rcv_data;
+	inet_ep2_t epp;
+	errno_t rc;
+	int i;
+
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	ring = as_area_create(AS_AREA_ANY, TCP_RING_AREA_SIZE(test_ring_size),
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	PCUT_ASSERT_FALSE(ring == AS_MAP_FAILED);
+	snd_data = (uint8_t *)ring + TCP_RING_DATA_OFF;
+	rcv_data = snd_data + test_ring_size;
+
+	tcp_conn_lock(conn);
+
+	/* Data received before the client shared the rings */
+	for (i = 0; i < 10; i++)
+		conn->rcv_buf[i] = i;
+	conn->rcv_buf_used = 10;
+	conn->rcv_wnd -= 10;
+
+	rc = tcp_ring_attach(conn, ring, test_ring_size);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	PCUT_ASSERT_INT_EQUALS(test_ring_size - 10, conn->rcv_wnd);
+	PCUT_ASSERT_INT_EQUALS(10, atomic_load(&ring->rcv.prod));
+	PCUT_ASSERT_INT_EQUALS(1, atomic_load(&ring->snd.want_data));
+	PCUT_ASSERT_INT_EQUALS(1, atomic_load(&ring->rcv.want_data));
+	for (i = 0; i < 10; i++)
+		PCUT_ASSERT_INT_EQUALS(i, rcv_data[i]);
+
+	/* Client reads four bytes */
+	atomic_store(&ring->rcv.cons, 4);
+	tcp_ring_rcv_sync(conn);
+	PCUT_ASSERT_INT_EQUALS(6, conn->rcv_buf_used);
+	PCUT_ASSERT_INT_EQUALS(4, conn->rcv_buf_start);
+	PCUT_ASSERT_INT_EQUALS(test_ring_size - 6, conn->rcv_wnd);
+
+	/* The client is notified of data first, then only when it asks */
+	PCUT_ASSERT_TRUE(tcp_ring_rcv_publish(conn));
+	PCUT_ASSERT_FALSE(tcp_ring_rcv_publish(conn));
+	atomic_store(&ring->rcv.want_data, 1);
+	PCUT_ASSERT_TRUE(tcp_ring_rcv_publish(conn));
+
+	/* Client writes seven bytes */
+	for (i = 0; i < 7; i++)
+		snd_data[i] = i;
+	atomic_store(&ring->snd.prod, 7);
+	tcp_ring_snd_sync(conn);
+	PCUT_ASSERT_INT_EQUALS(7, conn->snd_buf_used);
+
+	/* Bogus counter from the client is ignored */
+	atomic_store(&ring->snd.prod, 7 + 2 * test_ring_size);
+	tcp_ring_snd_sync(conn);
+	PCUT_ASSERT_INT_EQUALS(7, conn->snd_buf_used);
+
+	/* Attaching twice is refused */
+	rc = tcp_ring_attach(conn, ring, test_ring_size);
+	PCUT_ASSERT_ERRNO_VAL(EBUSY, rc);
+
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+	tcp_conn_delete(conn);
+}
+
+/** Test that invalid ring sizes are refused */
+PCUT_TEST(attach_invalid)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+	uint8_t area[TCP_RING_DATA_OFF];
+	errno_t rc;
+
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	tcp_conn_lock(conn);
+
+	/* Not a power of two */
+	rc = tcp_ring_attach(conn, (tcp_ring_area_t *)area,
+	    test_ring_size + 1);
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, rc);
+
+	/* Smaller than the current receive buffer */
+	rc = tcp_ring_attach(conn, (tcp_ring_area_t *)area, TCP_RING_SIZE_MIN);
+	PCUT_ASSERT_ERRNO_VAL(EBUSY, rc);
+
+	PCUT_ASSERT_NULL(conn->ring);
+
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+	tcp_conn_delete(conn);
+}
+
+PCUT_EXPORT(ring);
@@ -39,7 +39,8 @@ PCUT_INIT;
 PCUT_TEST_SUITE(rqueue);
 
 enum {
-	test_seg_max = 10
+	test_seg_max = 10,
+	test_conn_cnt = 3
 };
 
 static void test_seg_received(inet_ep2_t *, tcp_segment_t *);
@@ -126,4 +127,51 @@ PCUT_TEST(multiple_segments)
 
 }
 
+/** Test segments of multiple connections keep per-connection order */
+PCUT_TEST(multiple_conns)
+{
+	tcp_segment_t *seg[test_seg_max];
+	inet_ep2_t epp;
+	uint32_t last[test_conn_cnt];
+	uint32_t cidx;
+	int i;
+
+	tcp_rqueue_init(&rcb);
+	seg_cnt = 0;
+
+	tcp_rqueue_fibril_start();
+
+	for (i = 0; i < test_seg_max; i++) {
+		cidx = i % test_conn_cnt;
+
+		inet_ep2_init(&epp);
+		inet_addr(&epp.local.addr, 10, 0, 0, 1);
+		epp.local.port = 80;
+		inet_addr(&epp.remote.addr, 10, 0, 0, 2);
+		epp.remote.port = 1024 + cidx;
+
+		seg[i] = tcp_segment_make_ctrl(CTL_ACK);
+		PCUT_ASSERT_NOT_NULL(seg[i]);
+		seg[i]->ack = cidx;
+		seg[i]->seq = i;
+		tcp_rqueue_insert_seg(&epp, seg[i]);
+	}
+
+	tcp_rqueue_fini();
+
+	PCUT_ASSERT_INT_EQUALS(test_seg_max, seg_cnt);
+
+	for (cidx = 0; cidx < test_conn_cnt; cidx++)
+		last[cidx] = 0;
+
+	for (i = 0; i < test_seg_max; i++) {
+		cidx = recv_seg[i]->ack;
+		PCUT_ASSERT_TRUE(recv_seg[i]->seq >= last[cidx]);
+		last[cidx] = recv_seg[i]->seq;
+	}
+
+	for (i = 0; i < test_seg_max; i++)
+		tcp_segment_delete(seg[i]);
+}
+
 PCUT_EXPORT(rqueue);
@@ -546,4 +546,55 @@ PCUT_TEST(control_len)
 	    CTL_ACK | CTL_RST));
 }
 
+/** Test seq_no_ts_paws_reject() and seq_no_ts_recent_update() */
+PCUT_TEST(ts_paws)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+	tcp_segment_t *seg;
+
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	seg = tcp_segment_make_ctrl(CTL_ACK);
+	PCUT_ASSERT_NOT_NULL(seg);
+
+	conn->ts_recent = 1000;
+	conn->ts_last_ack_sent = 50;
+	seg->seq = 50;
+	seg->ts_present = true;
+	seg->ts_val = 999;
+
+	/* Timestamps not negotiated */
+	conn->ts_ok = false;
+	PCUT_ASSERT_FALSE(seq_no_ts_paws_reject(conn, seg));
+	PCUT_ASSERT_FALSE(seq_no_ts_recent_update(conn, seg));
+
+	/* Segment is rejected iff SEG.TSval < TS.Recent */
+	conn->ts_ok = true;
+	PCUT_ASSERT_TRUE(seq_no_ts_paws_reject(conn, seg));
+	seg->ts_val = 1000;
+	PCUT_ASSERT_FALSE(seq_no_ts_paws_reject(conn, seg));
+
+	/* Timestamp comparison wraps around */
+	conn->ts_recent = 0xfffffff0;
+	seg->ts_val = 0x10;
+	PCUT_ASSERT_FALSE(seq_no_ts_paws_reject(conn, seg));
+
+	/* RST segments are never rejected */
+	conn->ts_recent = 1000;
+	seg->ts_val = 999;
+	seg->ctrl |= CTL_RST;
+	PCUT_ASSERT_FALSE(seq_no_ts_paws_reject(conn, seg));
+
+	/* TS.Recent is updated iff SEG.SEQ <= Last.ACK.sent */
+	PCUT_ASSERT_TRUE(seq_no_ts_recent_update(conn, seg));
+	seg->seq = 51;
+	PCUT_ASSERT_FALSE(seq_no_ts_recent_update(conn, seg));
+
+	tcp_segment_delete(seg);
+	tcp_conn_delete(conn);
+}
+
 PCUT_EXPORT(seq_no);
@@ -192,9 +192,10 @@ PCUT_TEST(new_data_small_win)
 
 	PCUT_ASSERT_EQUALS(15, conn->snd_nxt);
 	PCUT_ASSERT_EQUALS(25, conn->snd_buf_used);
+	PCUT_ASSERT_EQUALS(5, conn->snd_buf_start);
 	PCUT_ASSERT_FALSE(conn->snd_buf_fin);
 	for (i = 0; i < 25; i++)
-		PCUT_ASSERT_INT_EQUALS(5 + i, conn->snd_buf[i]);
+		PCUT_ASSERT_INT_EQUALS(5 + i, conn->snd_buf[5 + i]);
 
 	tcp_conn_delete(conn);
 	PCUT_ASSERT_EQUALS(1, seg_cnt);
@@ -257,6 +258,94 @@ PCUT_TEST(ack_received)
 	tcp_conn_delete(conn);
 }
 
+/** Test advertising scaled receive window and timestamps */
+PCUT_TEST(wnd_scale_ts)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+
+	/* XXX tqueue can only be created via tcp_conn_new */
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	conn->cstate = st_established;
+	conn->snd_una = 10;
+	conn->snd_nxt = 10;
+	conn->rcv_nxt = 100;
+	conn->rcv_wnd = 1024 * 1024;
+	conn->ws_ok = true;
+	conn->rcv_wscale = 7;
+	conn->ts_ok = true;
+	conn->ts_recent = 1234;
+
+	/* Redirect segment transmission */
+	conn->retransmit.cb = &tqueue_test_cb;
+	seg_cnt = 0;
+
+	tcp_conn_lock(conn);
+	tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+
+	PCUT_ASSERT_EQUALS(1, seg_cnt);
+	PCUT_ASSERT_EQUALS(1024 * 1024 >> 7, trans_seg[0]->wnd);
+	PCUT_ASSERT_TRUE(trans_seg[0]->ts_present);
+	PCUT_ASSERT_EQUALS(1234, trans_seg[0]->ts_ecr);
+
+	/* Last.ACK.sent and advertised window edge are recorded */
+	PCUT_ASSERT_EQUALS(100, conn->ts_last_ack_sent);
+	PCUT_ASSERT_EQUALS(100 + 1024 * 1024, conn->rcv_adv);
+
+	tcp_conn_delete(conn);
+	tcp_segment_delete(trans_seg[0]);
+}
+
+/** Test that the payload leaves room for the timestamp option */
+PCUT_TEST(new_data_mss_opts)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+	int i;
+
+	/* XXX tqueue can only be created via tcp_conn_new */
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	conn->cstate = st_established;
+	conn->snd_una = 10;
+	conn->snd_nxt = 10;
+	conn->snd_wnd = 1024;
+	conn->cc.smss = 100;
+	conn->cc.cwnd = 1024;
+	conn->ts_ok = true;
+	conn->snd_buf_used = 100;
+	conn->snd_buf_fin = false;
+	for (i = 0; i < 100; i++)
+		conn->snd_buf[i] = i;
+
+	/* Redirect segment transmission */
+	conn->retransmit.cb = &tqueue_test_cb;
+	seg_cnt = 0;
+
+	tcp_conn_lock(conn);
+	tcp_tqueue_new_data(conn);
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+
+	/* SMSS less 12 bytes of timestamp option, then the rest */
+	PCUT_ASSERT_EQUALS(2, seg_cnt);
+	PCUT_ASSERT_TRUE(trans_seg[0]->ts_present);
+	PCUT_ASSERT_EQUALS(88, trans_seg[0]->len);
+	PCUT_ASSERT_EQUALS(12, trans_seg[1]->len);
+	PCUT_ASSERT_EQUALS(110, conn->snd_nxt);
+
+	tcp_conn_delete(conn);
+	tcp_segment_delete(trans_seg[0]);
+	tcp_segment_delete(trans_seg[1]);
+}
+
 static void tqueue_test_transmit_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 {
 	trans_seg[seg_cnt++] = tcp_segment_dup(seg);
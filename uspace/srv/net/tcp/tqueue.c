@@ -42,17 +42,24 @@
 #include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
+#include <time.h>
 
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
+#include "iqueue.h"
 #include "ncsim.h"
+#include "ring.h"
 #include "rqueue.h"
+#include "rtt.h"
 #include "segment.h"
 #include "seq_no.h"
+#include "std.h"
 #include "tqueue.h"
 #include "tcp_type.h"
 
-#define RETRANSMIT_TIMEOUT	(2*1000*1000)
+/** Number of duplicate ACKs that trigger fast retransmit */
+#define TCP_DUPACK_THRESH	3
 
 static void retransmit_timeout_func(void *);
 static void tcp_tqueue_timer_set(tcp_conn_t *);
@@ -118,6 +125,7 @@ static void tcp_tqueue_seg(tcp_conn_t *conn, tcp_segment_t *seg)
 {
 	tcp_segment_t *rt_seg;
 	tcp_tqueue_entry_t *tqe;
+	bool was_empty;
 
 	assert(fibril_mutex_is_locked(&conn->lock));
 
@@ -147,10 +155,22 @@ static void tcp_tqueue_seg(tcp_conn_t *conn, tcp_segment_t *seg)
 		tqe->seg = rt_seg;
 		rt_seg->seq = conn->snd_nxt;
 
+		/*
+		 * Time this segment unless a measurement is in progress.
+		 * With timestamps every ACK carries its own measurement.
+		 */
+		if (!conn->rtt_timing && !conn->ts_ok) {
+			conn->rtt_timing = true;
+			conn->rtt_seq = conn->snd_nxt + seg->len;
+			conn->rtt_start = tcp_rtt_uptime();
+		}
+
+		was_empty = list_empty(&conn->retransmit.list);
 		list_append(&tqe->link, &conn->retransmit.list);
 
-		/* Set retransmission timer */
-		tcp_tqueue_timer_set(conn);
+		/* Start retransmission timer unless it is already running */
+		if (was_empty)
+			tcp_tqueue_timer_set(conn);
 	}
 
 	tcp_prepare_transmit_segment(conn, seg);
@@ -172,16 +192,50 @@ static void tcp_prepare_transmit_segment(tcp_conn_t *conn, tcp_segment_t *seg)
 	tcp_conn_transmit_segment(conn, seg);
 }
 
+/** Size of options tcp_conn_transmit_segment() adds to a data segment.
+ *
+ * The SMSS excludes TCP options, so the payload of a segment must be
+ * reduced by the options actually sent in it (RFC 6691, RFC 7323 2).
+ *
+ * @param conn	Connection
+ * @return	Number of option bytes, including padding
+ */
+static size_t tcp_tqueue_data_opts_size(tcp_conn_t *conn)
+{
+	tcp_sack_block_t sack[TCP_SACK_BLOCKS_MAX];
+	size_t sack_cnt;
+	size_t size;
+
+	size = 0;
+	if (conn->ts_ok)
+		size += 2 + OPT_TIMESTAMPS_LEN;
+
+	if (conn->sack_ok) {
+		sack_cnt = tcp_iqueue_sack_blocks(&conn->incoming, sack,
+		    TCP_SACK_BLOCKS_MAX);
+		if (sack_cnt > 0) {
+			size += 2 + OPT_SACK_HDR_LEN +
+			    sack_cnt * OPT_SACK_BLOCK_LEN;
+		}
+	}
+
+	return size;
+}
+
 /** Transmit data from the send buffer.
+ *
+ * Data is sent in segments of at most SMSS bytes, less the options
+ * carried in each segment, for as long as both the send window and
+ * the congestion window allow.
  *
  * @param conn	Connection
  */
 void tcp_tqueue_new_data(tcp_conn_t *conn)
 {
+	uint32_t flight;
 	size_t avail_wnd;
-	size_t xfer_seqlen;
-	size_t snd_buf_seqlen;
 	size_t data_size;
+	size_t opts_size;
 	tcp_control_t ctrl;
 	bool send_fin;
 
@@ -189,52 +243,231 @@ void tcp_tqueue_new_data(tcp_conn_t *conn)
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_new_data()", conn->name);
 
-	/* Number of free sequence numbers in send window */
-	avail_wnd = (conn->snd_una + conn->snd_wnd) - conn->snd_nxt;
-	snd_buf_seqlen = conn->snd_buf_used + (conn->snd_buf_fin ? 1 : 0);
+	while (true) {
+		/* Pick up data the client has written to a shared ring */
+		tcp_ring_snd_sync(conn);
+
+		/* Number of free sequence numbers in send and congestion window */
+		flight = conn->snd_nxt - conn->snd_una;
+		avail_wnd = min(conn->snd_wnd, conn->cc.cwnd);
+		avail_wnd = avail_wnd > flight ? avail_wnd - flight : 0;
+
+		data_size = min(conn->snd_buf_used, avail_wnd);
+		opts_size = tcp_tqueue_data_opts_size(conn);
+		data_size = min(data_size, conn->cc.smss > opts_size ?
+		    conn->cc.smss - opts_size : 1);
+		send_fin = conn->snd_buf_fin && data_size == conn->snd_buf_used &&
+		    data_size < avail_wnd;
+
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: snd_buf_used = %zu, "
+		    "SND.WND = %" PRIu32 ", CWND = %" PRIu32 ", data_size = %zu",
+		    conn->name, conn->snd_buf_used, conn->snd_wnd,
+		    conn->cc.cwnd, data_size);
+
+		if (data_size == 0 && !send_fin) {
+			/* Ask the client to tell us when there is more data */
+			if (conn->snd_buf_used == 0 && tcp_ring_snd_arm(conn))
+				continue;
+			return;
+		}
 
-	xfer_seqlen = min(snd_buf_seqlen, avail_wnd);
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: snd_buf_seqlen = %zu, SND.WND = %" PRIu32 ", "
-	    "xfer_seqlen = %zu", conn->name, snd_buf_seqlen, conn->snd_wnd,
-	    xfer_seqlen);
+		/* XXX Do not always send immediately */
+
+		if (send_fin) {
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Sending out FIN.",
+			    conn->name);
+			/* We are sending out FIN */
+			ctrl = CTL_FIN;
+		} else {
+			ctrl = 0;
+		}
+
+		seg = tcp_segment_make_data(ctrl, NULL, data_size);
+		if (seg == NULL) {
+			log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failure.");
+			return;
+		}
+
+		/* Remove data from send buffer */
+		tcp_ring_read(conn->snd_buf, conn->snd_buf_size,
+		    conn->snd_buf_start, seg->data, data_size);
+		conn->snd_buf_start = (conn->snd_buf_start + data_size) %
+		    conn->snd_buf_size;
+		conn->snd_buf_used -= data_size;
+
+		if (send_fin)
+			conn->snd_buf_fin = false;
+
+		fibril_condvar_broadcast(&conn->snd_buf_cv);
+		tcp_ring_snd_publish(conn);
+
+		if (send_fin)
+			tcp_conn_fin_sent(conn);
+
+		tcp_tqueue_seg(conn, seg);
+		tcp_segment_delete(seg);
+	}
+}
+
+/** Retransmit segment from the retransmission queue.
+ *
+ * @param conn	Connection
+ * @param tqe	Retransmission queue entry
+ */
+static void tcp_tqueue_rexmit(tcp_conn_t *conn, tcp_tqueue_entry_t *tqe)
+{
+	tcp_segment_t *rt_seg;
 
-	if (xfer_seqlen == 0)
+	rt_seg = tcp_segment_dup(tqe->seg);
+	if (rt_seg == NULL) {
+		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failed.");
+		/* XXX Handle properly */
 		return;
+	}
 
-	/* XXX Do not always send immediately */
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmitting segment "
+	    "SEG.SEQ=%" PRIu32, conn->name, rt_seg->seq);
 
-	send_fin = conn->snd_buf_fin && xfer_seqlen == snd_buf_seqlen;
-	data_size = xfer_seqlen - (send_fin ? 1 : 0);
+	/* Karn's rule: no RTT samples from retransmitted segments */
+	conn->rtt_timing = false;
+	tqe->rexmit = true;
 
-	if (send_fin) {
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Sending out FIN.", conn->name);
-		/* We are sending out FIN */
-		ctrl = CTL_FIN;
-	} else {
-		ctrl = 0;
+	tcp_conn_transmit_segment(conn, rt_seg);
+	tcp_segment_delete(rt_seg);
+}
+
+/** Find first segment in the retransmission queue that was not SACKed.
+ *
+ * @param conn		Connection
+ * @param sacked_after	Only return a segment if some later segment
+ *			was SACKed (i.e. it is a hole) and it has not been
+ *			retransmitted yet
+ * @return		Queue entry or @c NULL
+ */
+static tcp_tqueue_entry_t *tcp_tqueue_first_unsacked(tcp_conn_t *conn,
+    bool sacked_after)
+{
+	tcp_tqueue_entry_t *hole = NULL;
+
+	list_foreach(conn->retransmit.list, link, tcp_tqueue_entry_t, tqe) {
+		if (tqe->sacked) {
+			if (hole != NULL)
+				return hole;
+		} else if (hole == NULL && (!sacked_after || !tqe->rexmit)) {
+			if (!sacked_after)
+				return tqe;
+			hole = tqe;
+		}
+	}
+
+	return NULL;
+}
+
+/** Retransmit segments that were outstanding when the retransmission
+ * timer expired, as the congestion window opens (go-back-N).
+ *
+ * @param conn	Connection
+ */
+static void tcp_tqueue_rto_rexmit(tcp_conn_t *conn)
+{
+	uint32_t sent;
+
+	sent = 0;
+	list_foreach(conn->retransmit.list, link, tcp_tqueue_entry_t, tqe) {
+		if (!seq_no_segment_acked(conn, tqe->seg, conn->recover))
+			break;
+		if (tqe->sacked)
+			continue;
+
+		if (!tqe->rexmit) {
+			if (sent + tqe->seg->len > conn->cc.cwnd)
+				break;
+			tcp_tqueue_rexmit(conn, tqe);
+		}
+
+		sent += tqe->seg->len;
+	}
+}
+
+/** Process SACK blocks carried by an incoming segment.
+ *
+ * Mark segments in the retransmission queue covered by the blocks
+ * so that they are skipped by loss recovery.
+ *
+ * @param conn	Connection
+ * @param seg	Incoming segment
+ */
+void tcp_tqueue_sack_received(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	unsigned i;
+
+	if (!conn->sack_ok || seg->sack_cnt == 0)
+		return;
+
+	list_foreach(conn->retransmit.list, link, tcp_tqueue_entry_t, tqe) {
+		for (i = 0; i < seg->sack_cnt; i++) {
+			if (seq_no_segment_sacked(tqe->seg, &seg->sack[i])) {
+				tqe->sacked = true;
+				break;
+			}
+		}
 	}
+}
+
+/** Process duplicate acknowledgement.
+ *
+ * After TCP_DUPACK_THRESH duplicate ACKs perform fast retransmit and enter
+ * fast recovery (RFC 5681, RFC 6582). During fast recovery every further
+ * duplicate ACK inflates the congestion window and, if SACK is in use,
+ * retransmits the next hole.
+ *
+ * @param conn	Connection
+ */
+void tcp_tqueue_dup_ack(tcp_conn_t *conn)
+{
+	tcp_tqueue_entry_t *tqe;
+	link_t *link;
 
-	seg = tcp_segment_make_data(ctrl, conn->snd_buf, data_size);
-	if (seg == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failure.");
+	link = list_first(&conn->retransmit.list);
+	if (link == NULL)
+		return;
+
+	++conn->dupacks;
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: duplicate ACK #%u", conn->name,
+	    conn->dupacks);
+
+	if (conn->in_recovery) {
+		/* Another segment has left the network */
+		conn->cc.cwnd += conn->cc.smss;
+
+		if (conn->sack_ok) {
+			tqe = tcp_tqueue_first_unsacked(conn, true);
+			if (tqe != NULL)
+				tcp_tqueue_rexmit(conn, tqe);
+		}
+
+		tcp_tqueue_new_data(conn);
 		return;
 	}
 
-	/* Remove data from send buffer */
-	memmove(conn->snd_buf, conn->snd_buf + data_size,
-	    conn->snd_buf_used - data_size);
-	conn->snd_buf_used -= data_size;
+	if (conn->dupacks < TCP_DUPACK_THRESH)
+		return;
 
-	if (send_fin)
-		conn->snd_buf_fin = false;
+	/* Do not enter fast recovery twice for the same window */
+	if (!seq_no_acked(conn, conn->recover))
+		return;
 
-	fibril_condvar_broadcast(&conn->snd_buf_cv);
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: fast retransmit", conn->name);
 
-	if (send_fin)
-		tcp_conn_fin_sent(conn);
+	tcp_cc_loss(&conn->cc, conn->snd_nxt - conn->snd_una);
+	conn->in_recovery = true;
+	conn->recover = conn->snd_nxt;
 
-	tcp_tqueue_seg(conn, seg);
-	tcp_segment_delete(seg);
+	tqe = list_get_instance(link, tcp_tqueue_entry_t, link);
+	tcp_tqueue_rexmit(conn, tqe);
+
+	conn->cc.cwnd = conn->cc.ssthresh + TCP_DUPACK_THRESH * conn->cc.smss;
+	tcp_tqueue_new_data(conn);
 }
 
 /** Remove ACKed segments from retransmission queue and possibly transmit
@@ -245,10 +478,16 @@ void tcp_tqueue_new_data(tcp_conn_t *conn)
 void tcp_tqueue_ack_received(tcp_conn_t *conn)
 {
 	link_t *cur, *next;
+	tcp_tqueue_entry_t *tqe;
+	uint32_t acked;
+	uint32_t flight;
+	usec_t now;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_ack_received(%p)", conn->name,
 	    conn);
 
+	acked = 0;
+
 	cur = conn->retransmit.list.head.next;
 
 	while (cur != &conn->retransmit.list.head) {
@@ -260,6 +499,7 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 		if (seq_no_segment_acked(conn, tqe->seg, conn->snd_una)) {
 			/* Remove acknowledged segment */
 			list_remove(cur);
+			acked += tqe->seg->len;
 
 			if ((tqe->seg->ctrl & CTL_FIN) != 0) {
 				log_msg(LOG_DEFAULT, LVL_DEBUG, "Fin has been acked");
@@ -284,6 +524,45 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 	if (list_empty(&conn->retransmit.list))
 		tcp_tqueue_timer_clear(conn);
 
+	now = tcp_rtt_uptime();
+
+	/* Complete RTT measurement */
+	if (conn->rtt_timing && seq_no_acked(conn, conn->rtt_seq)) {
+		tcp_rtt_sample(&conn->rtt, now - conn->rtt_start);
+		conn->rtt_timing = false;
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: SRTT=%lld RTTVAR=%lld RTO=%lld",
+		    conn->name, conn->rtt.srtt, conn->rtt.rttvar, conn->rtt.rto);
+	}
+
+	if (acked > 0 && conn->in_recovery) {
+		if (seq_no_acked(conn, conn->recover)) {
+			/* Full acknowledgement, leave fast recovery */
+			flight = conn->snd_nxt - conn->snd_una;
+			conn->cc.cwnd = min(conn->cc.ssthresh,
+			    max(flight, conn->cc.smss) + conn->cc.smss);
+			conn->in_recovery = false;
+			conn->dupacks = 0;
+		} else {
+			/* Partial acknowledgement, retransmit next hole */
+			tqe = tcp_tqueue_first_unsacked(conn, false);
+			if (tqe != NULL)
+				tcp_tqueue_rexmit(conn, tqe);
+
+			/* Deflate congestion window by the amount acked */
+			conn->cc.cwnd = conn->cc.cwnd > acked ?
+			    conn->cc.cwnd - acked : 0;
+			if (acked >= conn->cc.smss)
+				conn->cc.cwnd += conn->cc.smss;
+			conn->cc.cwnd = max(conn->cc.cwnd, conn->cc.smss);
+		}
+	} else if (acked > 0) {
+		tcp_cc_ack(&conn->cc, acked, now, conn->rtt.srtt);
+
+		/* Still recovering from retransmission timeout */
+		if (!seq_no_acked(conn, conn->recover))
+			tcp_tqueue_rto_rexmit(conn);
+	}
+
 	/* Possibly transmit more data */
 	tcp_tqueue_new_data(conn);
 }
@@ -293,13 +572,47 @@ static void tcp_conn_transmit_segment(tcp_conn_t *conn, tcp_segment_t *seg)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_conn_transmit_segment(%p, %p)",
 	    conn->name, conn, seg);
 
-	seg->wnd = conn->rcv_wnd;
-
 	if ((seg->ctrl & CTL_ACK) != 0)
 		seg->ack = conn->rcv_nxt;
 	else
 		seg->ack = 0;
 
+	if ((seg->ctrl & CTL_SYN) != 0) {
+		/* Window in SYN segments is never scaled (RFC 7323 2.2) */
+		seg->wnd = min(conn->rcv_wnd, UINT16_MAX);
+
+		seg->mss = tcp_conn_local_mss(conn);
+		/* Offer options in SYN, agree in SYN-ACK if the peer offered */
+		seg->sack_perm = (seg->ctrl & CTL_ACK) == 0 || conn->sack_ok;
+		seg->wscale_present = (seg->ctrl & CTL_ACK) == 0 || conn->ws_ok;
+		seg->wscale = conn->rcv_wscale;
+		seg->ts_present = (seg->ctrl & CTL_ACK) == 0 || conn->ts_ok;
+	} else {
+		seg->wnd = min(conn->rcv_wnd >> conn->rcv_wscale, UINT16_MAX);
+		seg->ts_present = conn->ts_ok;
+	}
+
+	if (seg->ts_present) {
+		seg->ts_val = tcp_rtt_ts_clock();
+		seg->ts_ecr = (seg->ctrl & CTL_ACK) != 0 ? conn->ts_recent : 0;
+	}
+
+	if ((seg->ctrl & CTL_ACK) != 0) {
+		/* Remember what we acknowledged and advertised */
+		conn->ts_last_ack_sent = seg->ack;
+		conn->rcv_adv = seg->ack + (seg->wnd <<
+		    ((seg->ctrl & CTL_SYN) != 0 ? 0 : conn->rcv_wscale));
+		tcp_conn_ack_sent(conn);
+	}
+
+	/* Report out-of-order data we are holding */
+	if ((seg->ctrl & (CTL_ACK | CTL_SYN)) == CTL_ACK && conn->sack_ok) {
+		seg->sack_cnt = tcp_iqueue_sack_blocks(&conn->incoming,
+		    seg->sack, TCP_SACK_BLOCKS_MAX);
+	} else {
+		seg->sack_cnt = 0;
+	}
+
 	tcp_tqueue_send_immed(conn, seg);
 }
 
@@ -321,7 +634,6 @@ static void retransmit_timeout_func(void *arg)
 {
 	tcp_conn_t *conn = (tcp_conn_t *) arg;
 	tcp_tqueue_entry_t *tqe;
-	tcp_segment_t *rt_seg;
 	link_t *link;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmit_timeout_func(%p)", conn->name, conn);
@@ -343,22 +655,24 @@ static void retransmit_timeout_func(void *arg)
 		return;
 	}
 
-	tqe = list_get_instance(link, tcp_tqueue_entry_t, link);
-
-	rt_seg = tcp_segment_dup(tqe->seg);
-	if (rt_seg == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failed.");
-		tcp_conn_unlock(conn);
-		tcp_conn_delref(conn);
-		/* XXX Handle properly */
-		return;
+	/* Back off the timer and collapse the congestion window */
+	tcp_rtt_backoff(&conn->rtt);
+	tcp_cc_timeout(&conn->cc, conn->snd_nxt - conn->snd_una);
+	conn->in_recovery = false;
+	conn->dupacks = 0;
+	conn->recover = conn->snd_nxt;
+
+	/* The receiver may have discarded data it has SACKed (RFC 2018) */
+	list_foreach(conn->retransmit.list, link, tcp_tqueue_entry_t, qe) {
+		qe->sacked = false;
+		qe->rexmit = false;
 	}
 
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmitting segment", conn->name);
-	tcp_conn_transmit_segment(tqe->conn, rt_seg);
+	tqe = list_get_instance(link, tcp_tqueue_entry_t, link);
+	tcp_tqueue_rexmit(conn, tqe);
 
 	/* Reset retransmission timer */
-	fibril_timer_set_locked(conn->retransmit.timer, RETRANSMIT_TIMEOUT,
+	fibril_timer_set_locked(conn->retransmit.timer, conn->rtt.rto,
 	    retransmit_timeout_func, (void *) conn);
 
 	tcp_conn_unlock(conn);
@@ -377,7 +691,7 @@ static void tcp_tqueue_timer_set(tcp_conn_t *conn)
 	tcp_tqueue_timer_clear(conn);
 
 	tcp_conn_addref(conn);
-	fibril_timer_set_locked(conn->retransmit.timer, RETRANSMIT_TIMEOUT,
+	fibril_timer_set_locked(conn->retransmit.timer, conn->rtt.rto,
 	    retransmit_timeout_func, (void *) conn);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: tcp_tqueue_timer_set() end", conn->name);
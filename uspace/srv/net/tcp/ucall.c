@@ -39,7 +39,9 @@
 #include <io/log.h>
 #include <macros.h>
 #include <mem.h>
+#include "cc.h"
 #include "conn.h"
+#include "ring.h"
 #include "tcp_type.h"
 #include "tqueue.h"
 #include "ucall.h"
@@ -135,6 +137,12 @@ tcp_error_t tcp_uc_send(tcp_conn_t *conn, void *data, size_t size,
 		return TCP_ENOTEXIST;
 	}
 
+	/* The client writes to the shared ring directly */
+	if (conn->ring != NULL) {
+		tcp_conn_unlock(conn);
+		return TCP_EILLEGAL;
+	}
+
 	if (conn->cstate == st_listen) {
 		/* Change connection to active */
 		tcp_conn_sync(conn);
@@ -162,7 +170,9 @@ tcp_error_t tcp_uc_send(tcp_conn_t *conn, void *data, size_t size,
 		xfer_size = min(size, buf_free);
 
 		/* Copy data to buffer */
-		memcpy(conn->snd_buf + conn->snd_buf_used, data, xfer_size);
+		tcp_ring_write(conn->snd_buf, conn->snd_buf_size,
+		    (conn->snd_buf_start + conn->snd_buf_used) %
+		    conn->snd_buf_size, data, xfer_size);
 		data += xfer_size;
 		conn->snd_buf_used += xfer_size;
 		size -= xfer_size;
@@ -191,6 +201,12 @@ tcp_error_t tcp_uc_receive(tcp_conn_t *conn, void *buf, size_t size,
 		return TCP_ENOTEXIST;
 	}
 
+	/* The client reads from the shared ring directly */
+	if (conn->ring != NULL) {
+		tcp_conn_unlock(conn);
+		return TCP_EILLEGAL;
+	}
+
 	/* Wait for data to become available */
 	while (conn->rcv_buf_used == 0 && !conn->rcv_buf_fin && !conn->reset) {
 		tcp_conn_unlock(conn);
@@ -217,20 +233,25 @@ tcp_error_t tcp_uc_receive(tcp_conn_t *conn, void *buf, size_t size,
 
 	/* Copy data from receive buffer to user buffer */
 	xfer_size = min(size, conn->rcv_buf_used);
-	memcpy(buf, conn->rcv_buf, xfer_size);
+	tcp_ring_read(conn->rcv_buf, conn->rcv_buf_size, conn->rcv_buf_start,
+	    buf, xfer_size);
 	*rcvd = xfer_size;
 
 	/* Remove data from receive buffer */
-	memmove(conn->rcv_buf, conn->rcv_buf + xfer_size, conn->rcv_buf_used -
-	    xfer_size);
+	conn->rcv_buf_start = (conn->rcv_buf_start + xfer_size) %
+	    conn->rcv_buf_size;
 	conn->rcv_buf_used -= xfer_size;
 	conn->rcv_wnd += xfer_size;
 
 	/* TODO */
 	*xflags = 0;
 
+	/* Grow receive buffer if the user keeps up with the peer */
+	tcp_conn_rcv_buf_tune(conn, xfer_size);
+
 	/* Send new size of receive window */
-	tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+	if (tcp_conn_wnd_update_needed(conn))
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_uc_receive() - returning %zu bytes",
 	    conn->name, xfer_size);
@@ -267,6 +288,9 @@ tcp_error_t tcp_uc_close(tcp_conn_t *conn)
 		return TCP_ECLOSING;
 	}
 
+	/* FIN goes after all data the client has written to a shared ring */
+	tcp_ring_snd_sync(conn);
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_uc_close - set snd_buf_fin");
 	conn->snd_buf_fin = true;
 	tcp_tqueue_new_data(conn);
@@ -309,15 +333,80 @@ void tcp_uc_set_cb(tcp_conn_t *conn, tcp_cb_t *cb, void *arg)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_uc_set_cb(%p, %p, %p)",
 	    conn, cb, arg);
 
-	conn->cb = cb;
-	conn->cb_arg = arg;
+	tcp_conn_lock(conn);
+	tcp_conn_set_cb(conn, cb, arg);
+	tcp_conn_unlock(conn);
 }
 
+/** Get user callback argument.
+ *
+ * Only to be used from a callback (i.e. with the connection locked).
+ */
 void *tcp_uc_get_userptr(tcp_conn_t *conn)
 {
 	return conn->cb_arg;
 }
 
+/** Select congestion control algorithm (not in spec). */
+void tcp_uc_set_cc(tcp_conn_t *conn, tcp_cc_alg_t alg)
+{
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_uc_set_cc(%p, %d)", conn, (int) alg);
+
+	tcp_conn_lock(conn);
+	tcp_cc_set_alg(&conn->cc, alg);
+	tcp_conn_unlock(conn);
+}
+
+/** Move connection buffers to memory shared with the user (not in spec).
+ *
+ * @param conn  Connection
+ * @param ring  Shared area
+ * @param rsize Size of each data ring
+ * @return EOK on success or an error code
+ */
+errno_t tcp_uc_ring_attach(tcp_conn_t *conn, tcp_ring_area_t *ring,
+    size_t rsize)
+{
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_uc_ring_attach(%p, %zu)", conn,
+	    rsize);
+
+	tcp_conn_lock(conn);
+	rc = tcp_ring_attach(conn, ring, rsize);
+	tcp_conn_unlock(conn);
+
+	return rc;
+}
+
+/** User has advanced the shared rings (not in spec).
+ *
+ * Send data the user has written and open the receive window for data
+ * the user has read.
+ *
+ * @param conn Connection
+ */
+void tcp_uc_ring_kick(tcp_conn_t *conn)
+{
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "%s: tcp_uc_ring_kick()", conn->name);
+
+	tcp_conn_lock(conn);
+
+	if (conn->ring == NULL || conn->cstate == st_closed) {
+		tcp_conn_unlock(conn);
+		return;
+	}
+
+	tcp_ring_rcv_sync(conn);
+	tcp_tqueue_new_data(conn);
+
+	/* Send new size of receive window */
+	if (tcp_conn_wnd_update_needed(conn))
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
+
+	tcp_conn_unlock(conn);
+}
+
 /*
  * Arriving segments
  */
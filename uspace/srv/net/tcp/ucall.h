@@ -35,6 +35,7 @@
 #ifndef UCALL_H
 #define UCALL_H
 
+#include <errno.h>
 #include <inet/endpoint.h>
 #include <stddef.h>
 #include "tcp_type.h"
@@ -52,6 +53,9 @@ extern void tcp_uc_status(tcp_conn_t *, tcp_conn_status_t *);
 extern void tcp_uc_delete(tcp_conn_t *);
 extern void tcp_uc_set_cb(tcp_conn_t *, tcp_cb_t *, void *);
 extern void *tcp_uc_get_userptr(tcp_conn_t *);
+extern void tcp_uc_set_cc(tcp_conn_t *, tcp_cc_alg_t);
+extern errno_t tcp_uc_ring_attach(tcp_conn_t *, tcp_ring_area_t *, size_t);
+extern void tcp_uc_ring_kick(tcp_conn_t *);
 
 /*
  * Arriving segments
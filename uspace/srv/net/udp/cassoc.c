@@ -36,40 +36,156 @@
  * Ties UDP associations into the namespace of a client
  */
 
+#include <adt/hash_table.h>
+#include <align.h>
 #include <errno.h>
+#include <fibril_synch.h>
 #include <inet/endpoint.h>
 #include <io/log.h>
+#include <ipc/udp.h>
+#include <mem.h>
 #include <stdlib.h>
 
 #include "cassoc.h"
+#include "msg.h"
 #include "udp_type.h"
 
+static size_t udp_cassoc_id_key_hash(const void *key)
+{
+	const sysarg_t *id = key;
+	return *id;
+}
+
+static size_t udp_cassoc_id_hash(const ht_link_t *item)
+{
+	udp_cassoc_t *cassoc = hash_table_get_inst(item, udp_cassoc_t, lid);
+	return cassoc->id;
+}
+
+static bool udp_cassoc_id_key_equal(const void *key, const ht_link_t *item)
+{
+	const sysarg_t *id = key;
+	udp_cassoc_t *cassoc = hash_table_get_inst(item, udp_cassoc_t, lid);
+	return cassoc->id == *id;
+}
+
+/** Client associations by ID */
+static hash_table_ops_t udp_cassoc_id_ops = {
+	.hash = udp_cassoc_id_hash,
+	.key_hash = udp_cassoc_id_key_hash,
+	.key_equal = udp_cassoc_id_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+/** Initialize UDP client structure.
+ *
+ * @param client UDP client
+ * @return EOK on success or ENOMEM if out of memory
+ */
+errno_t udp_client_init(udp_client_t *client)
+{
+	memset(client, 0, sizeof(udp_client_t));
+	client->sess = NULL;
+	fibril_mutex_initialize(&client->lock);
+	list_initialize(&client->cassoc);
+	list_initialize(&client->crcv_queue);
+
+	if (!hash_table_create(&client->cassoc_id, 0, 0, &udp_cassoc_id_ops))
+		return ENOMEM;
+
+	return EOK;
+}
+
+/** Finalize UDP client structure.
+ *
+ * All client associations must have been destroyed.
+ *
+ * @param client UDP client
+ */
+void udp_client_fini(udp_client_t *client)
+{
+	assert(list_empty(&client->cassoc));
+	assert(list_empty(&client->crcv_queue));
+	hash_table_destroy(&client->cassoc_id);
+}
+
+/** Remove entry from client receive queue and free it.
+ *
+ * Must be called with client lock held.
+ *
+ * @param client UDP client
+ * @param rqe    Receive queue entry
+ */
+static void udp_client_rqe_remove(udp_client_t *client,
+    udp_crcv_queue_entry_t *rqe)
+{
+	assert(fibril_mutex_is_locked(&client->lock));
+
+	list_remove(&rqe->link);
+	--rqe->cassoc->rcv_queued;
+	rqe->cassoc->rcv_queued_bytes -= rqe->msg->data_size;
+
+	udp_msg_delete(rqe->msg);
+	free(rqe);
+}
+
 /** Add message to client receive queue.
  *
- * @param cassoc Client association
- * @param epp    Endpoint pair on which message was received
- * @param msg    Message
+ * If the association already has too many messages or bytes queued,
+ * the message is not queued and the association's drop counter is
+ * incremented. A message is always accepted into an empty queue.
  *
- * @return EOK on success, ENOMEM if out of memory
+ * @param cassoc  Client association
+ * @param epp     Endpoint pair on which message was received
+ * @param msg     Message, ownership is transferred on success
+ * @param rnotify Place to store @c true if the client needs to be
+ *                sent a data event
+ *
+ * @return EOK on success, ELIMIT if the queue is full, ENOMEM if out
+ *         of memory
  */
 errno_t udp_cassoc_queue_msg(udp_cassoc_t *cassoc, inet_ep2_t *epp,
-    udp_msg_t *msg)
+    udp_msg_t *msg, bool *rnotify)
 {
+	udp_client_t *client = cassoc->client;
 	udp_crcv_queue_entry_t *rqe;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_cassoc_queue_msg(%p, %p, %p)",
 	    cassoc, epp, msg);
 
+	fibril_mutex_lock(&client->lock);
+
+	if (cassoc->rcv_queued > 0 &&
+	    (cassoc->rcv_queued >= UDP_CASSOC_RCV_MAX ||
+	    cassoc->rcv_queued_bytes + msg->data_size >
+	    UDP_CASSOC_RCV_BYTES_MAX)) {
+		++cassoc->rcv_drops;
+		fibril_mutex_unlock(&client->lock);
+		return ELIMIT;
+	}
+
 	rqe = calloc(1, sizeof(udp_crcv_queue_entry_t));
-	if (rqe == NULL)
+	if (rqe == NULL) {
+		++cassoc->rcv_drops;
+		fibril_mutex_unlock(&client->lock);
 		return ENOMEM;
+	}
 
 	link_initialize(&rqe->link);
 	rqe->epp = *epp;
 	rqe->msg = msg;
 	rqe->cassoc = cassoc;
 
-	list_append(&rqe->link, &cassoc->client->crcv_queue);
+	list_append(&rqe->link, &client->crcv_queue);
+	++cassoc->rcv_queued;
+	cassoc->rcv_queued_bytes += msg->data_size;
+
+	/* Coalesce data events until the client drains the queue */
+	*rnotify = !client->ev_pending;
+	client->ev_pending = true;
+
+	fibril_mutex_unlock(&client->lock);
 	return EOK;
 }
 
@@ -93,29 +209,49 @@ errno_t udp_cassoc_create(udp_client_t *client, udp_assoc_t *assoc,
 	if (cassoc == NULL)
 		return ENOMEM;
 
-	/* Allocate new ID */
-	id = 0;
-	list_foreach (client->cassoc, lclient, udp_cassoc_t, cassoc) {
-		if (cassoc->id >= id)
-			id = cassoc->id + 1;
-	}
+	fibril_mutex_lock(&client->lock);
+
+	/* Allocate new ID, skipping IDs still in use after wrap-around */
+	do {
+		id = client->cassoc_next_id++;
+	} while (hash_table_find(&client->cassoc_id, &id) != NULL);
 
 	cassoc->id = id;
 	cassoc->client = client;
 	cassoc->assoc = assoc;
 
 	list_append(&cassoc->lclient, &client->cassoc);
+	hash_table_insert(&client->cassoc_id, &cassoc->lid);
+	fibril_mutex_unlock(&client->lock);
+
 	*rcassoc = cassoc;
 	return EOK;
 }
 
 /** Destroy client association.
+ *
+ * Messages for the association still in the client receive queue
+ * are discarded.
  *
  * @param cassoc Client association
  */
 void udp_cassoc_destroy(udp_cassoc_t *cassoc)
 {
+	udp_client_t *client = cassoc->client;
+
+	fibril_mutex_lock(&client->lock);
+
+	list_foreach_safe(client->crcv_queue, cur, next) {
+		udp_crcv_queue_entry_t *rqe = list_get_instance(cur,
+		    udp_crcv_queue_entry_t, link);
+		if (rqe->cassoc == cassoc)
+			udp_client_rqe_remove(client, rqe);
+	}
+
 	list_remove(&cassoc->lclient);
+	hash_table_remove_item(&client->cassoc_id, &cassoc->lid);
+	fibril_mutex_unlock(&client->lock);
+
 	free(cassoc);
 }
 
@@ -131,14 +267,129 @@ void udp_cassoc_destroy(udp_cassoc_t *cassoc)
 errno_t udp_cassoc_get(udp_client_t *client, sysarg_t id,
     udp_cassoc_t **rcassoc)
 {
-	list_foreach (client->cassoc, lclient, udp_cassoc_t, cassoc) {
-		if (cassoc->id == id) {
-			*rcassoc = cassoc;
-			return EOK;
-		}
+	ht_link_t *link;
+
+	fibril_mutex_lock(&client->lock);
+	link = hash_table_find(&client->cassoc_id, &id);
+	fibril_mutex_unlock(&client->lock);
+
+	if (link == NULL)
+		return ENOENT;
+
+	*rcassoc = hash_table_get_inst(link, udp_cassoc_t, lid);
+	return EOK;
+}
+
+/** Get next received message.
+ *
+ * The entry remains valid until it is discarded by the client connection
+ * fibril, which is the only one removing entries (apart from destroying
+ * a client association, which is also done by the client connection
+ * fibril).
+ *
+ * @param client UDP Client
+ * @return Pointer to queue entry for next received message or @c NULL
+ *         if the queue is empty. In that case the client will be sent
+ *         a data event for the next message.
+ */
+udp_crcv_queue_entry_t *udp_client_rmsg_first(udp_client_t *client)
+{
+	udp_crcv_queue_entry_t *rqe = NULL;
+	link_t *link;
+
+	fibril_mutex_lock(&client->lock);
+
+	link = list_first(&client->crcv_queue);
+	if (link != NULL)
+		rqe = list_get_instance(link, udp_crcv_queue_entry_t, link);
+	else
+		client->ev_pending = false;
+
+	fibril_mutex_unlock(&client->lock);
+	return rqe;
+}
+
+/** Discard first received message.
+ *
+ * @param client UDP client
+ * @return EOK on success, ENOENT if the receive queue is empty
+ */
+errno_t udp_client_rmsg_discard(udp_client_t *client)
+{
+	link_t *link;
+
+	fibril_mutex_lock(&client->lock);
+
+	link = list_first(&client->crcv_queue);
+	if (link == NULL) {
+		fibril_mutex_unlock(&client->lock);
+		return ENOENT;
+	}
+
+	udp_client_rqe_remove(client, list_get_instance(link,
+	    udp_crcv_queue_entry_t, link));
+
+	fibril_mutex_unlock(&client->lock);
+	return EOK;
+}
+
+/** Move received messages into a batch buffer.
+ *
+ * Messages are stored as a udp_batch_hdr_t followed by message data,
+ * each padded to UDP_BATCH_ALIGN, and removed from the receive queue.
+ * As many complete messages are stored as fit in the buffer. If the
+ * first message does not fit at all, nothing is stored and the client
+ * needs to read it piece-wise.
+ *
+ * @param client UDP client
+ * @param buf    Buffer
+ * @param size   Buffer size
+ * @param rcount Place to store number of messages stored
+ * @param rused  Place to store number of bytes used
+ * @return EOK on success, ENOENT if the receive queue is empty
+ */
+errno_t udp_client_rmsg_pack(udp_client_t *client, void *buf, size_t size,
+    size_t *rcount, size_t *rused)
+{
+	udp_crcv_queue_entry_t *rqe;
+	udp_batch_hdr_t *hdr;
+	size_t count = 0;
+	size_t used = 0;
+	size_t rsize;
+	link_t *link;
+
+	fibril_mutex_lock(&client->lock);
+
+	if (list_empty(&client->crcv_queue)) {
+		client->ev_pending = false;
+		fibril_mutex_unlock(&client->lock);
+		return ENOENT;
 	}
 
-	return ENOENT;
+	while ((link = list_first(&client->crcv_queue)) != NULL) {
+		rqe = list_get_instance(link, udp_crcv_queue_entry_t, link);
+
+		rsize = ALIGN_UP(sizeof(udp_batch_hdr_t) + rqe->msg->data_size,
+		    UDP_BATCH_ALIGN);
+		if (rsize > size - used)
+			break;
+
+		hdr = (udp_batch_hdr_t *) ((uint8_t *) buf + used);
+		hdr->remote = rqe->epp.remote;
+		hdr->assoc_id = rqe->cassoc->id;
+		hdr->size = rqe->msg->data_size;
+		memcpy(hdr + 1, rqe->msg->data, rqe->msg->data_size);
+
+		used += rsize;
+		++count;
+		udp_client_rqe_remove(client, rqe);
+	}
+
+	fibril_mutex_unlock(&client->lock);
+
+	*rcount = count;
+	*rused = used;
+	return EOK;
 }
 
 /**
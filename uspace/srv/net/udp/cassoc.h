@@ -36,12 +36,20 @@
 #define CASSOC_H
 
 #include <errno.h>
+#include <stdbool.h>
 #include "udp_type.h"
 
+errno_t udp_client_init(udp_client_t *);
+void udp_client_fini(udp_client_t *);
 errno_t udp_cassoc_create(udp_client_t *, udp_assoc_t *, udp_cassoc_t **);
 void udp_cassoc_destroy(udp_cassoc_t *);
 errno_t udp_cassoc_get(udp_client_t *, sysarg_t, udp_cassoc_t **);
-errno_t udp_cassoc_queue_msg(udp_cassoc_t *, inet_ep2_t *, udp_msg_t *);
+errno_t udp_cassoc_queue_msg(udp_cassoc_t *, inet_ep2_t *, udp_msg_t *,
+    bool *);
+udp_crcv_queue_entry_t *udp_client_rmsg_first(udp_client_t *);
+errno_t udp_client_rmsg_discard(udp_client_t *);
+errno_t udp_client_rmsg_pack(udp_client_t *, void *, size_t, size_t *,
+    size_t *);
 
 #endif
 
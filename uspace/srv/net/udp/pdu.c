@@ -129,7 +129,8 @@ void udp_pdu_delete(udp_pdu_t *pdu)
 	free(pdu);
 }
 
-static uint16_t udp_pdu_checksum_calc(udp_pdu_t *pdu)
+/** Compute checksum of the pseudo-header of a PDU. */
+static uint16_t udp_pdu_phdr_checksum_calc(udp_pdu_t *pdu)
 {
 	uint16_t cs_phdr;
 	udp_phdr_t phdr;
@@ -149,7 +150,13 @@ static uint16_t udp_pdu_checksum_calc(udp_pdu_t *pdu)
 		assert(false);
 	}
 
-	return udp_checksum_calc(cs_phdr, pdu->data, pdu->data_size);
+	return cs_phdr;
+}
+
+static uint16_t udp_pdu_checksum_calc(udp_pdu_t *pdu)
+{
+	return udp_checksum_calc(udp_pdu_phdr_checksum_calc(pdu), pdu->data,
+	    pdu->data_size);
 }
 
 static void udp_pdu_set_checksum(udp_pdu_t *pdu, uint16_t checksum)
@@ -160,7 +167,14 @@ static void udp_pdu_set_checksum(udp_pdu_t *pdu, uint16_t checksum)
 	hdr->checksum = host2uint16_t_be(checksum);
 }
 
-/** Decode incoming PDU */
+/** Decode incoming PDU
+ *
+ * The checksum is verified if present, unless the link already did so
+ * or the PDU was produced locally with checksum offload.
+ *
+ * @return EOK on success, EINVAL on malformed PDU or bad checksum,
+ *         ENOMEM if out of memory
+ */
 errno_t udp_pdu_decode(udp_pdu_t *pdu, inet_ep2_t *epp, udp_msg_t **msg)
 {
 	udp_msg_t *nmsg;
@@ -186,12 +200,17 @@ errno_t udp_pdu_decode(udp_pdu_t *pdu, inet_ep2_t *epp, udp_msg_t **msg)
 
 	length = uint16_t_be2host(hdr->length);
 	checksum = uint16_t_be2host(hdr->checksum);
-	(void) checksum;
 
 	if (length < sizeof(udp_header_t) ||
 	    length > sizeof(udp_header_t) + text_size)
 		return EINVAL;
 
+	/* Zero checksum means the sender did not compute one */
+	if (checksum != 0 && (pdu->offload & (INET_OFFLOAD_CSUM |
+	    INET_OFFLOAD_CSUM_VALID)) == 0 &&
+	    udp_pdu_checksum_calc(pdu) != 0)
+		return EINVAL;
+
 	nmsg = udp_msg_new();
 	if (nmsg == NULL)
 		return ENOMEM;
@@ -207,12 +226,15 @@ errno_t udp_pdu_decode(udp_pdu_t *pdu, inet_ep2_t *epp, udp_msg_t **msg)
 	return EOK;
 }
 
-/** Encode outgoing PDU */
+/** Encode outgoing PDU
+ *
+ * Only the pseudo-header sum is stored in the checksum field, completing
+ * the checksum is left to the NIC or the IP layer (INET_OFFLOAD_CSUM).
+ */
 errno_t udp_pdu_encode(inet_ep2_t *epp, udp_msg_t *msg, udp_pdu_t **pdu)
 {
 	udp_pdu_t *npdu;
 	udp_header_t *hdr;
-	uint16_t checksum;
 
 	npdu = udp_pdu_new();
 	if (npdu == NULL)
@@ -238,9 +260,10 @@ errno_t udp_pdu_encode(inet_ep2_t *epp, udp_msg_t *msg, udp_pdu_t **pdu)
 	memcpy((uint8_t *)npdu->data + sizeof(udp_header_t), msg->data,
 	    msg->data_size);
 
-	/* Checksum calculation */
-	checksum = udp_pdu_checksum_calc(npdu);
-	udp_pdu_set_checksum(npdu, checksum);
+	/* Partial checksum, to be completed over header and data */
+	udp_pdu_set_checksum(npdu,
+	    (uint16_t) ~udp_pdu_phdr_checksum_calc(npdu));
+	npdu->offload = INET_OFFLOAD_CSUM;
 
 	*pdu = npdu;
 	return EOK;
@@ -34,6 +34,7 @@
  * @file HelenOS service implementation
  */
 
+#include <align.h>
 #include <async.h>
 #include <errno.h>
 #include <inet/endpoint.h>
@@ -90,9 +91,19 @@ static void udp_ev_data(udp_client_t *client)
 static void udp_recv_msg_cassoc(void *arg, inet_ep2_t *epp, udp_msg_t *msg)
 {
 	udp_cassoc_t *cassoc = (udp_cassoc_t *) arg;
+	bool notify;
+	errno_t rc;
+
+	rc = udp_cassoc_queue_msg(cassoc, epp, msg, &notify);
+	if (rc != EOK) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Receive queue full. Message "
+		    "dropped.");
+		udp_msg_delete(msg);
+		return;
+	}
 
-	udp_cassoc_queue_msg(cassoc, epp, msg);
-	udp_ev_data(cassoc->client);
+	if (notify)
+		udp_ev_data(cassoc->client);
 }
 
 /** Create association.
@@ -216,6 +227,11 @@ static errno_t udp_assoc_send_msg_impl(udp_client_t *client, sysarg_t assoc_id,
 	if (rc != EOK)
 		return rc;
 
+	/* Unspecified destination means the association's remote endpoint */
+	if (dest != NULL && inet_addr_is_any(&dest->addr) &&
+	    dest->port == inet_port_any)
+		dest = NULL;
+
 	msg.data = data;
 	msg.data_size = size;
 	rc = udp_assoc_send(cassoc->assoc, dest, &msg);
@@ -391,6 +407,7 @@ static void udp_assoc_send_msg_srv(udp_client_t *client, ipc_call_t *icall)
 	if (data == NULL) {
 		async_answer_0(&call, ENOMEM);
 		async_answer_0(icall, ENOMEM);
+		return;
 	}
 
 	rc = async_data_write_finalize(&call, data, size);
@@ -414,22 +431,6 @@ static void udp_assoc_send_msg_srv(udp_client_t *client, ipc_call_t *icall)
 	free(data);
 }
 
-/** Get next received message.
- *
- * @param client UDP Client
- * @return Pointer to queue entry for next received message
- */
-static udp_crcv_queue_entry_t *udp_rmsg_get_next(udp_client_t *client)
-{
-	link_t *link;
-
-	link = list_first(&client->crcv_queue);
-	if (link == NULL)
-		return NULL;
-
-	return list_get_instance(link, udp_crcv_queue_entry_t, link);
-}
-
 /** Get info on first received message.
  *
  * Handle client request to get information on received message.
@@ -447,7 +448,7 @@ static void udp_rmsg_info_srv(udp_client_t *client, ipc_call_t *icall)
 	errno_t rc;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_rmsg_info_srv()");
-	enext = udp_rmsg_get_next(client);
+	enext = udp_client_rmsg_first(client);
 
 	if (!async_data_read_receive(&call, &size)) {
 		async_answer_0(&call, EREFUSED);
@@ -497,7 +498,7 @@ static void udp_rmsg_read_srv(udp_client_t *client, ipc_call_t *icall)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_rmsg_read_srv()");
 	off = ipc_get_arg1(icall);
 
-	enext = udp_rmsg_get_next(client);
+	enext = udp_client_rmsg_first(client);
 
 	if (!async_data_read_receive(&call, &size)) {
 		async_answer_0(&call, EREFUSED);
@@ -541,23 +542,187 @@ static void udp_rmsg_read_srv(udp_client_t *client, ipc_call_t *icall)
  */
 static void udp_rmsg_discard_srv(udp_client_t *client, ipc_call_t *icall)
 {
-	udp_crcv_queue_entry_t *enext;
+	errno_t rc;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_rmsg_discard_srv()");
 
-	enext = udp_rmsg_get_next(client);
-	if (enext == NULL) {
+	rc = udp_client_rmsg_discard(client);
+	if (rc != EOK) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "usg_rmsg_discard_srv: enext==NULL");
 		async_answer_0(icall, ENOENT);
 		return;
 	}
 
-	list_remove(&enext->link);
-	udp_msg_delete(enext->msg);
-	free(enext);
 	async_answer_0(icall, EOK);
 }
 
+/** Read batch of received messages.
+ *
+ * Handle client request to read as many received messages as fit in
+ * the client's buffer. Messages read are removed from the receive queue.
+ * If the first message does not fit, zero messages are returned and
+ * the client needs to read it using the single-message interface.
+ *
+ * @param client UDP client
+ * @param icall  Async request data
+ *
+ */
+static void udp_rmsg_read_batch_srv(udp_client_t *client, ipc_call_t *icall)
+{
+	ipc_call_t call;
+	size_t size;
+	size_t count;
+	size_t used;
+	void *buf;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_rmsg_read_batch_srv()");
+
+	if (!async_data_read_receive(&call, &size)) {
+		async_answer_0(&call, EREFUSED);
+		async_answer_0(icall, EREFUSED);
+		return;
+	}
+
+	size = min(size, (size_t) MAX_MSG_SIZE);
+	buf = malloc(size);
+	if (buf == NULL) {
+		async_answer_0(&call, ENOMEM);
+		async_answer_0(icall, ENOMEM);
+		return;
+	}
+
+	rc = udp_client_rmsg_pack(client, buf, size, &count, &used);
+	if (rc != EOK) {
+		free(buf);
+		async_answer_0(&call, rc);
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	rc = async_data_read_finalize(&call, buf, used);
+	free(buf);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	async_answer_2(icall, EOK, count, used);
+}
+
+/** Send batch of messages via association.
+ *
+ * Handle client request to send several messages at once. The messages
+ * are passed as a single buffer of udp_batch_hdr_t headers, each followed
+ * by message data. Returns the number of messages sent.
+ *
+ * @param client UDP client
+ * @param icall  Async request data
+ *
+ */
+static void udp_assoc_send_batch_srv(udp_client_t *client, ipc_call_t *icall)
+{
+	ipc_call_t call;
+	udp_batch_hdr_t *hdr;
+	sysarg_t assoc_id;
+	size_t count;
+	size_t size;
+	size_t off;
+	size_t rsize;
+	size_t i;
+	void *buf;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_assoc_send_batch_srv()");
+
+	assoc_id = ipc_get_arg1(icall);
+	count = ipc_get_arg2(icall);
+
+	if (!async_data_write_receive(&call, &size)) {
+		async_answer_0(&call, EREFUSED);
+		async_answer_0(icall, EREFUSED);
+		return;
+	}
+
+	if (size > MAX_MSG_SIZE) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(icall, EINVAL);
+		return;
+	}
+
+	buf = malloc(size);
+	if (buf == NULL) {
+		async_answer_0(&call, ENOMEM);
+		async_answer_0(icall, ENOMEM);
+		return;
+	}
+
+	rc = async_data_write_finalize(&call, buf, size);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		free(buf);
+		return;
+	}
+
+	off = 0;
+	rc = EOK;
+	for (i = 0; i < count; i++) {
+		if (size - off < sizeof(udp_batch_hdr_t)) {
+			rc = EINVAL;
+			break;
+		}
+
+		hdr = (udp_batch_hdr_t *) ((uint8_t *) buf + off);
+		if (hdr->size > size - off - sizeof(udp_batch_hdr_t)) {
+			rc = EINVAL;
+			break;
+		}
+
+		rc = udp_assoc_send_msg_impl(client, assoc_id, &hdr->remote,
+		    hdr + 1, hdr->size);
+		if (rc != EOK)
+			break;
+
+		rsize = ALIGN_UP(sizeof(udp_batch_hdr_t) + hdr->size,
+		    UDP_BATCH_ALIGN);
+		off += min(rsize, size - off);
+	}
+
+	free(buf);
+	async_answer_1(icall, rc, i);
+}
+
+/** Get association statistics.
+ *
+ * Handle client request to get number of queued and dropped messages.
+ *
+ * @param client UDP client
+ * @param icall  Async request data
+ *
+ */
+static void udp_assoc_get_stats_srv(udp_client_t *client, ipc_call_t *icall)
+{
+	udp_cassoc_t *cassoc;
+	sysarg_t queued;
+	sysarg_t drops;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_assoc_get_stats_srv()");
+
+	rc = udp_cassoc_get(client, ipc_get_arg1(icall), &cassoc);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
+
+	fibril_mutex_lock(&client->lock);
+	queued = cassoc->rcv_queued;
+	drops = cassoc->rcv_drops;
+	fibril_mutex_unlock(&client->lock);
+
+	async_answer_2(icall, EOK, queued, drops);
+}
+
 /** Handle UDP client connection.
  *
  * @param icall Connect call data
@@ -568,16 +733,19 @@ static void udp_client_conn(ipc_call_t *icall, void *arg)
 {
 	udp_client_t client;
 	unsigned long n;
+	errno_t rc;
+
+	rc = udp_client_init(&client);
+	if (rc != EOK) {
+		async_answer_0(icall, rc);
+		return;
+	}
 
 	/* Accept the connection */
 	async_accept_0(icall);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_client_conn()");
 
-	client.sess = NULL;
-	list_initialize(&client.cassoc);
-	list_initialize(&client.crcv_queue);
-
 	while (true) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_client_conn: wait req");
 		ipc_call_t call;
@@ -617,6 +785,15 @@ static void udp_client_conn(ipc_call_t *icall, void *arg)
 		case UDP_RMSG_DISCARD:
 			udp_rmsg_discard_srv(&client, &call);
 			break;
+		case UDP_RMSG_READ_BATCH:
+			udp_rmsg_read_batch_srv(&client, &call);
+			break;
+		case UDP_ASSOC_SEND_BATCH:
+			udp_assoc_send_batch_srv(&client, &call);
+			break;
+		case UDP_ASSOC_GET_STATS:
+			udp_assoc_get_stats_srv(&client, &call);
+			break;
 		default:
 			async_answer_0(&call, ENOTSUP);
 			break;
@@ -629,13 +806,19 @@ static void udp_client_conn(ipc_call_t *icall, void *arg)
 	if (n != 0) {
 		log_msg(LOG_DEFAULT, LVL_WARN, "udp_client_conn: "
 		    "Client with %lu active associations closed session.", n);
-		/* XXX Clean up */
 	}
 
-	/* XXX Clean up client receive queue */
+	/* Destroying client associations also cleans up the receive queue */
+	while (!list_empty(&client.cassoc)) {
+		udp_cassoc_t *cassoc = list_get_instance(
+		    list_first(&client.cassoc), udp_cassoc_t, lclient);
+		(void) udp_assoc_destroy_impl(&client, cassoc->id);
+	}
 
 	if (client.sess != NULL)
 		async_hangup(client.sess);
+
+	udp_client_fini(&client);
 }
 
 /** Initialize UDP service.
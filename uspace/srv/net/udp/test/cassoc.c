@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <align.h>
+#include <inet/endpoint.h>
+#include <io/log.h>
+#include <ipc/udp.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdlib.h>
+
+#include "../cassoc.h"
+#include "../msg.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(cassoc);
+
+/** Create message with @a size bytes of data set to @a fill */
+static udp_msg_t *test_msg(size_t size, uint8_t fill)
+{
+	udp_msg_t *msg;
+
+	msg = udp_msg_new();
+	PCUT_ASSERT_NOT_NULL(msg);
+
+	msg->data = malloc(size);
+	PCUT_ASSERT_NOT_NULL(msg->data);
+	memset(msg->data, fill, size);
+	msg->data_size = size;
+	return msg;
+}
+
+PCUT_TEST_BEFORE
+{
+	errno_t rc;
+
+	/* We will be calling functions that perform logging */
+	rc = log_init("test-udp");
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+}
+
+/** Test creating, looking up and destroying client associations */
+PCUT_TEST(create_get_destroy)
+{
+	udp_client_t client;
+	udp_cassoc_t *ca1, *ca2, *ca;
+	errno_t rc;
+
+	rc = udp_client_init(&client);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	rc = udp_cassoc_create(&client, NULL, &ca1);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = udp_cassoc_create(&client, NULL, &ca2);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(ca1->id != ca2->id);
+
+	rc = udp_cassoc_get(&client, ca2->id, &ca);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_EQUALS(ca2, ca);
+
+	udp_cassoc_destroy(ca2);
+	rc = udp_cassoc_get(&client, ca1->id, &ca);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_EQUALS(ca1, ca);
+	rc = udp_cassoc_get(&client, ca1->id + 1, &ca);
+	PCUT_ASSERT_ERRNO_VAL(ENOENT, rc);
+
+	udp_cassoc_destroy(ca1);
+	udp_client_fini(&client);
+}
+
+/** Test that receive queue is bounded and data events are coalesced */
+PCUT_TEST(queue_limit)
+{
+	udp_client_t client;
+	udp_cassoc_t *cassoc;
+	udp_msg_t *msg;
+	inet_ep2_t epp;
+	bool notify;
+	size_t i;
+	errno_t rc;
+
+	rc = udp_client_init(&client);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = udp_cassoc_create(&client, NULL, &cassoc);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	inet_ep2_init(&epp);
+
+	for (i = 0; i < UDP_CASSOC_RCV_MAX; i++) {
+		rc = udp_cassoc_queue_msg(cassoc, &epp, test_msg(1, 0),
+		    &notify);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+		/* Only the first message triggers a data event */
+		PCUT_ASSERT_INT_EQUALS(i == 0, notify);
+	}
+
+	msg = test_msg(1, 0);
+	rc = udp_cassoc_queue_msg(cassoc, &epp, msg, &notify);
+	PCUT_ASSERT_ERRNO_VAL(ELIMIT, rc);
+	udp_msg_delete(msg);
+	PCUT_ASSERT_INT_EQUALS(1, cassoc->rcv_drops);
+	PCUT_ASSERT_INT_EQUALS(UDP_CASSOC_RCV_MAX, cassoc->rcv_queued);
+
+	/* Drain the queue */
+	while (udp_client_rmsg_first(&client) != NULL) {
+		rc = udp_client_rmsg_discard(&client);
+		PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	}
+
+	PCUT_ASSERT_INT_EQUALS(0, cassoc->rcv_queued);
+	PCUT_ASSERT_INT_EQUALS(0, cassoc->rcv_queued_bytes);
+
+	/* Client found the queue empty, next message triggers an event */
+	rc = udp_cassoc_queue_msg(cassoc, &epp, test_msg(1, 0), &notify);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_TRUE(notify);
+
+	/* Destroying client association discards its messages */
+	udp_cassoc_destroy(cassoc);
+	PCUT_ASSERT_NULL(udp_client_rmsg_first(&client));
+	udp_client_fini(&client);
+}
+
+/** Test packing received messages into a batch buffer */
+PCUT_TEST(rmsg_pack)
+{
+	udp_client_t client;
+	udp_cassoc_t *cassoc;
+	udp_batch_hdr_t *hdr;
+	inet_ep2_t epp;
+	uint8_t buf[256];
+	uint8_t *p;
+	size_t count;
+	size_t used;
+	bool notify;
+	errno_t rc;
+
+	rc = udp_client_init(&client);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = udp_cassoc_create(&client, NULL, &cassoc);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	rc = udp_client_rmsg_pack(&client, buf, sizeof(buf), &count, &used);
+	PCUT_ASSERT_ERRNO_VAL(ENOENT, rc);
+
+	inet_ep2_init(&epp);
+	epp.remote.port = 1234;
+
+	rc = udp_cassoc_queue_msg(cassoc, &epp, test_msg(3, 0xaa), &notify);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = udp_cassoc_queue_msg(cassoc, &epp, test_msg(10, 0xbb), &notify);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = udp_cassoc_queue_msg(cassoc, &epp, test_msg(sizeof(buf), 0xcc),
+	    &notify);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	/* The third message does not fit */
+	rc = udp_client_rmsg_pack(&client, buf, sizeof(buf), &count, &used);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(2, count);
+	PCUT_ASSERT_INT_EQUALS(0, used % UDP_BATCH_ALIGN);
+
+	hdr = (udp_batch_hdr_t *) buf;
+	PCUT_ASSERT_INT_EQUALS(cassoc->id, hdr->assoc_id);
+	PCUT_ASSERT_INT_EQUALS(1234, hdr->remote.port);
+	PCUT_ASSERT_INT_EQUALS(3, hdr->size);
+	p = (uint8_t *) (hdr + 1);
+	PCUT_ASSERT_INT_EQUALS(0xaa, p[2]);
+
+	p = buf + ALIGN_UP(sizeof(udp_batch_hdr_t) + 3, UDP_BATCH_ALIGN);
+	hdr = (udp_batch_hdr_t *) p;
+	PCUT_ASSERT_INT_EQUALS(10, hdr->size);
+	p = (uint8_t *) (hdr + 1);
+	PCUT_ASSERT_INT_EQUALS(0xbb, p[9]);
+
+	/* Nothing fits, the message needs to be read piece-wise */
+	rc = udp_client_rmsg_pack(&client, buf, sizeof(buf), &count, &used);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(0, count);
+	PCUT_ASSERT_NOT_NULL(udp_client_rmsg_first(&client));
+
+	rc = udp_client_rmsg_discard(&client);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	udp_cassoc_destroy(cassoc);
+	udp_client_fini(&client);
+}
+
+PCUT_EXPORT(cassoc);
@@ -31,6 +31,7 @@
 PCUT_INIT;
 
 PCUT_IMPORT(assoc);
+PCUT_IMPORT(cassoc);
 PCUT_IMPORT(msg);
 PCUT_IMPORT(pdu);
 
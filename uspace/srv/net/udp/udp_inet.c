@@ -37,6 +37,8 @@
 #include <errno.h>
 #include <inet/inet.h>
 #include <io/log.h>
+#include <mem.h>
+#include <stddef.h>
 
 #include "assoc.h"
 #include "pdu.h"
@@ -65,6 +67,7 @@ static errno_t udp_inet_ev_recv(inet_dgram_t *dgram)
 
 	pdu->src = dgram->src;
 	pdu->dest = dgram->dest;
+	pdu->offload = dgram->offload.flags;
 
 	udp_received_pdu(pdu);
 
@@ -89,6 +92,9 @@ errno_t udp_transmit_pdu(udp_pdu_t *pdu)
 	dgram.tos = 0;
 	dgram.data = pdu->data;
 	dgram.size = pdu->data_size;
+	memset(&dgram.offload, 0, sizeof(dgram.offload));
+	dgram.offload.flags = pdu->offload;
+	dgram.offload.csum_offset = offsetof(udp_header_t, checksum);
 
 	rc = inet_send(&dgram, INET_TTL_MAX, 0);
 	if (rc != EOK)
@@ -106,7 +112,7 @@ static void udp_received_pdu(udp_pdu_t *pdu)
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "udp_received_pdu()");
 
 	if (udp_pdu_decode(pdu, &rident, &dmsg) != EOK) {
-		log_msg(LOG_DEFAULT, LVL_WARN, "Not enough memory. PDU dropped.");
+		log_msg(LOG_DEFAULT, LVL_WARN, "Failed decoding PDU. PDU dropped.");
 		return;
 	}
 
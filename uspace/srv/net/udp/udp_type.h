@@ -35,6 +35,7 @@
 #ifndef UDP_TYPE_H
 #define UDP_TYPE_H
 
+#include <adt/hash_table.h>
 #include <async.h>
 #include <errno.h>
 #include <fibril.h>
@@ -46,9 +47,15 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <inet/addr.h>
+#include <types/inet.h>
 
 #define UDP_FRAGMENT_SIZE 65535
 
+/** Maximum number of messages queued for a client association */
+#define UDP_CASSOC_RCV_MAX 256
+/** Maximum number of message bytes queued for a client association */
+#define UDP_CASSOC_RCV_BYTES_MAX (256 * 1024)
+
 /** UDP error codes */
 typedef enum {
 	UDP_EOK,
@@ -86,6 +93,12 @@ typedef struct {
 	void *data;
 	/** Encoded PDU data size */
 	size_t data_size;
+	/**
+	 * INET_OFFLOAD_* flags. With INET_OFFLOAD_CSUM the checksum field
+	 * only holds the pseudo-header sum, with INET_OFFLOAD_CSUM_VALID
+	 * the checksum was verified by the link.
+	 */
+	uint16_t offload;
 } udp_pdu_t;
 
 /** Functions needed by associations module.
@@ -168,6 +181,14 @@ typedef struct udp_cassoc {
 	/** Client */
 	struct udp_client *client;
 	link_t lclient;
+	/** Link to udp_client_t.cassoc_id */
+	ht_link_t lid;
+	/** Number of messages in client receive queue */
+	size_t rcv_queued;
+	/** Number of message bytes in client receive queue */
+	size_t rcv_queued_bytes;
+	/** Number of messages dropped because the queue was full */
+	uint64_t rcv_drops;
 } udp_cassoc_t;
 
 /** UDP client receive queue entry */
@@ -186,10 +207,21 @@ typedef struct {
 typedef struct udp_client {
 	/** Client callback session */
 	async_sess_t *sess;
+	/** Protects client associations and receive queue */
+	fibril_mutex_t lock;
 	/** Client assocations */
 	list_t cassoc; /* of udp_cassoc_t */
+	/** Client associations by ID */
+	hash_table_t cassoc_id; /* of udp_cassoc_t */
+	/** Next client association ID to allocate */
+	sysarg_t cassoc_next_id;
 	/** Client receive queue */
 	list_t crcv_queue;
+	/**
+	 * Data event was sent and client has not found the receive queue
+	 * empty since. No more events are sent until then.
+	 */
+	bool ev_pending;
 } udp_client_t;
 
 #endif
@@ -510,6 +510,51 @@ errno_t vfs_op_read(int fd, aoff64_t pos, size_t *out_bytes)
 	return vfs_rdwr(fd, pos, true, rdwr_ipc_client, out_bytes);
 }
 
+errno_t vfs_op_readdir(int fd, aoff64_t *pos, unsigned flags,
+    size_t *out_count)
+{
+	vfs_file_t *file = vfs_file_get(fd);
+	if (!file)
+		return EBADF;
+
+	if (!file->open_read || file->node->type != VFS_NODE_DIRECTORY) {
+		vfs_file_put(file);
+		return EINVAL;
+	}
+
+	/*
+	 * Make sure that no one is modifying the namespace while we are
+	 * in readdir().
+	 */
+	fibril_rwlock_read_lock(&file->node->contents_rwlock);
+	fibril_rwlock_read_lock(&namespace_rwlock);
+
+	/*
+	 * Forward the client's IPC_M_DATA_READ to the destination FS server
+	 * so that the entries are copied directly into the client's buffer.
+	 */
+	async_exch_t *exch = vfs_exchange_grab(file->node->fs_handle);
+	ipc_call_t answer;
+	errno_t rc = async_data_read_forward_4_1(exch,
+	    (flags & VFS_READDIR_STAT) ? VFS_OUT_READDIR_STAT : VFS_OUT_READDIR,
+	    file->node->service_id, file->node->index, LOWER32(*pos),
+	    UPPER32(*pos), &answer);
+	vfs_exchange_release(exch);
+
+	fibril_rwlock_read_unlock(&namespace_rwlock);
+	fibril_rwlock_read_unlock(&file->node->contents_rwlock);
+
+	vfs_file_put(file);
+
+	if (rc == EOK) {
+		*out_count = ipc_get_arg1(&answer);
+		*pos = MERGE_LOUP32(ipc_get_arg2(&answer),
+		    ipc_get_arg3(&answer));
+	}
+
+	return rc;
+}
+
 errno_t vfs_op_rename(int basefd, char *old, char *new)
 {
 	vfs_file_t *base_file = vfs_file_get(basefd);